@@ -7,12 +7,14 @@
 #include <unistd.h>
 
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "application/lib/app/application_context.h"
 #include "apps/ledger/services/internal/internal.fidl.h"
 #include "apps/ledger/src/app/erase_remote_repository_operation.h"
 #include "apps/ledger/src/app/ledger_repository_factory_impl.h"
+#include "apps/ledger/src/app/operation_recorder.h"
 #include "apps/ledger/src/backoff/exponential_backoff.h"
 #include "apps/ledger/src/cobalt/cobalt.h"
 #include "apps/ledger/src/environment/environment.h"
@@ -40,6 +42,10 @@ constexpr ftl::TimeDelta kMaxPollingDelay = ftl::TimeDelta::FromSeconds(10);
 constexpr ftl::StringView kNoMinFsFlag = "no_minfs_wait";
 constexpr ftl::StringView kNoPersistedConfig = "no_persisted_config";
 constexpr ftl::StringView kNoNetworkForTesting = "no_network_for_testing";
+constexpr ftl::StringView kRecordOperations = "record_operations";
+constexpr ftl::StringView kEnableSyncCompression = "enable_sync_compression";
+constexpr ftl::StringView kEnableObjectPacks = "enable_object_packs";
+constexpr ftl::StringView kEnableMultiplexedWatch = "enable_multiplexed_watch";
 constexpr ftl::StringView kNoStatisticsReporting =
     "no_statistics_reporting_for_testing";
 constexpr ftl::StringView kTriggerCloudErasedForTesting =
@@ -51,6 +57,11 @@ struct AppParams {
   bool no_network_for_testing = false;
   bool trigger_cloud_erased_for_testing = false;
   bool disable_statistics = false;
+  // If not empty, the operations made on the pages are recorded to this file.
+  std::string operation_trace_path;
+  bool enable_sync_compression = false;
+  bool enable_object_packs = false;
+  bool enable_multiplexed_watch = false;
 };
 
 ftl::AutoCall<ftl::Closure> SetupCobalt(
@@ -102,6 +113,23 @@ class App : public LedgerController,
     if (app_params_.trigger_cloud_erased_for_testing) {
       environment_->SetTriggerCloudErasedForTesting();
     }
+    if (app_params_.enable_sync_compression) {
+      environment_->SetSyncCompressionEnabled();
+    }
+    if (app_params_.enable_object_packs) {
+      environment_->SetObjectPacksEnabled();
+    }
+    if (app_params_.enable_multiplexed_watch) {
+      environment_->SetMultiplexedWatchEnabled();
+    }
+    if (!app_params_.operation_trace_path.empty()) {
+      operation_recorder_ =
+          OperationRecorder::Create(app_params_.operation_trace_path);
+      if (!operation_recorder_) {
+        return false;
+      }
+      environment_->SetOperationRecorder(operation_recorder_.get());
+    }
 
     factory_impl_ = std::make_unique<LedgerRepositoryFactoryImpl>(
         this, environment_.get(), config_persistence_);
@@ -170,6 +198,7 @@ class App : public LedgerController,
   ftl::AutoCall<ftl::Closure> cobalt_cleaner_;
   const LedgerRepositoryFactoryImpl::ConfigPersistence config_persistence_;
   std::unique_ptr<NetworkService> network_service_;
+  std::unique_ptr<OperationRecorder> operation_recorder_;
   std::unique_ptr<Environment> environment_;
   std::unique_ptr<LedgerRepositoryFactoryImpl> factory_impl_;
   fidl::BindingSet<LedgerRepositoryFactory> factory_bindings_;
@@ -221,6 +250,14 @@ int main(int argc, const char** argv) {
       command_line.HasOption(ledger::kTriggerCloudErasedForTesting);
   app_params.disable_statistics =
       command_line.HasOption(ledger::kNoStatisticsReporting);
+  command_line.GetOptionValue(ledger::kRecordOperations.ToString(),
+                              &app_params.operation_trace_path);
+  app_params.enable_sync_compression =
+      command_line.HasOption(ledger::kEnableSyncCompression);
+  app_params.enable_object_packs =
+      command_line.HasOption(ledger::kEnableObjectPacks);
+  app_params.enable_multiplexed_watch =
+      command_line.HasOption(ledger::kEnableMultiplexedWatch);
 
   if (!command_line.HasOption(ledger::kNoMinFsFlag.ToString())) {
     // Poll until /data is persistent. This is need to retrieve the Ledger
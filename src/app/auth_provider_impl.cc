@@ -4,13 +4,62 @@
 
 #include "apps/ledger/src/app/auth_provider_impl.h"
 
+#include <time.h>
+
 #include <utility>
 
 #include "apps/ledger/src/callback/cancellable_helper.h"
+#include "apps/ledger/src/glue/crypto/base64.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/strings/split_string.h"
+
+#include <rapidjson/document.h>
 
 namespace ledger {
 
+namespace {
+// A cached token is not used if it expires in less than this delay, so that
+// it does not expire while in flight.
+constexpr ftl::TimeDelta kExpirationMargin = ftl::TimeDelta::FromSeconds(60);
+// A cached token in use is refreshed this long before it would stop being
+// used.
+constexpr ftl::TimeDelta kRefreshMargin = ftl::TimeDelta::FromSeconds(240);
+
+// Extracts the expiration time from the payload of the given Firebase ID token,
+// which is a JSON Web Token. Returns false if the token cannot be parsed.
+bool GetTokenExpiration(const std::string& id_token,
+                        ftl::TimePoint* expiration) {
+  std::vector<ftl::StringView> parts =
+      ftl::SplitString(id_token, ".", ftl::WhiteSpaceHandling::kKeepWhitespace,
+                       ftl::SplitResult::kSplitWantAll);
+  if (parts.size() != 3) {
+    return false;
+  }
+
+  // The segments of the token are base64url-encoded without padding.
+  std::string encoded_payload = parts[1].ToString();
+  encoded_payload.append((4 - encoded_payload.size() % 4) % 4, '=');
+  std::string payload;
+  if (!glue::Base64UrlDecode(encoded_payload, &payload)) {
+    return false;
+  }
+
+  rapidjson::Document document;
+  document.Parse(payload.c_str(), payload.size());
+  if (document.HasParseError() || !document.IsObject() ||
+      !document.HasMember("exp") || !document["exp"].IsInt64()) {
+    return false;
+  }
+
+  // The expiration time is given in seconds since the epoch.
+  int64_t seconds_left = document["exp"].GetInt64() - time(nullptr);
+  *expiration = ftl::TimePoint::Now() + ftl::TimeDelta::FromSeconds(
+                                            seconds_left);
+  return true;
+}
+}  // namespace
+
 AuthProviderImpl::AuthProviderImpl(
     ftl::RefPtr<ftl::TaskRunner> task_runner,
     std::string api_key,
@@ -29,22 +78,125 @@ ftl::RefPtr<callback::Cancellable> AuthProviderImpl::GetFirebaseToken(
                         "may be unauthenticated.";
   }
   auto cancellable = callback::CancellableImpl::Create([] {});
-  GetToken([callback = cancellable->WrapCallback(callback)](
-      auto status, auto token) { callback(status, token->id_token); });
+  GetCachedToken([callback = cancellable->WrapCallback(callback)](
+      auto status, const auto& token) {
+    callback(status, token ? token->id_token.get() : "");
+  });
   return cancellable;
 }
 
 ftl::RefPtr<callback::Cancellable> AuthProviderImpl::GetFirebaseUserId(
     std::function<void(cloud_sync::AuthStatus, std::string)> callback) {
   auto cancellable = callback::CancellableImpl::Create([] {});
-  GetToken([callback = cancellable->WrapCallback(callback)](
-      auto status, auto token) { callback(status, token->local_id); });
+  GetCachedToken([callback = cancellable->WrapCallback(callback)](
+      auto status, const auto& token) {
+    callback(status, token ? token->local_id.get() : "");
+  });
   return cancellable;
 }
 
+void AuthProviderImpl::InvalidateFirebaseToken(
+    const std::string& firebase_token) {
+  // Ignore the notifications about tokens that were already replaced.
+  if (cached_token_ && cached_token_->id_token.get() == firebase_token) {
+    cached_token_.reset();
+  }
+}
+
+void AuthProviderImpl::GetCachedToken(TokenCallback callback) {
+  if (cached_token_ &&
+      ftl::TimePoint::Now() < cached_token_expiration_ - kExpirationMargin) {
+    ++cache_hits_;
+    cached_token_used_ = true;
+    ReportMetrics();
+    // Keep the callback asynchronous, as for the tokens that are retrieved.
+    task_runner_->PostTask(ftl::MakeCopyable([
+      weak_this = weak_factory_.GetWeakPtr(), callback = std::move(callback)
+    ]() mutable {
+      if (!weak_this) {
+        return;
+      }
+      if (!weak_this->cached_token_) {
+        // The token was invalidated in the meantime.
+        weak_this->GetCachedToken(std::move(callback));
+        return;
+      }
+      callback(cloud_sync::AuthStatus::OK, weak_this->cached_token_);
+    }));
+    return;
+  }
+
+  pending_callbacks_.push_back(std::move(callback));
+  FetchToken();
+}
+
+void AuthProviderImpl::FetchToken() {
+  if (fetch_in_progress_) {
+    return;
+  }
+  fetch_in_progress_ = true;
+  GetToken([this](cloud_sync::AuthStatus status,
+                  modular::auth::FirebaseTokenPtr token) {
+    OnTokenFetched(status, std::move(token));
+  });
+}
+
+void AuthProviderImpl::OnTokenFetched(cloud_sync::AuthStatus status,
+                                      modular::auth::FirebaseTokenPtr token) {
+  fetch_in_progress_ = false;
+  ftl::TimePoint expiration;
+  if (status == cloud_sync::AuthStatus::OK &&
+      GetTokenExpiration(token->id_token, &expiration)) {
+    cached_token_ = token.Clone();
+    cached_token_expiration_ = expiration;
+    cached_token_used_ = false;
+    ScheduleRefresh();
+  } else {
+    // Tokens that do not carry an expiration time are not cached.
+    cached_token_.reset();
+  }
+
+  std::vector<TokenCallback> callbacks;
+  callbacks.swap(pending_callbacks_);
+  auto weak_this = weak_factory_.GetWeakPtr();
+  for (auto& callback : callbacks) {
+    callback(status, token);
+    if (!weak_this) {
+      return;
+    }
+  }
+}
+
+void AuthProviderImpl::ScheduleRefresh() {
+  ftl::TimeDelta delay = cached_token_expiration_ - kExpirationMargin -
+                         kRefreshMargin - ftl::TimePoint::Now();
+  if (delay <= ftl::TimeDelta::Zero()) {
+    // The token is short-lived: it is refreshed upon the first request made
+    // after it stops being used.
+    return;
+  }
+  task_runner_->PostDelayedTask(
+      [
+        weak_this = weak_factory_.GetWeakPtr(),
+        expiration = cached_token_expiration_
+      ] {
+        if (!weak_this || !weak_this->cached_token_ ||
+            weak_this->cached_token_expiration_ != expiration) {
+          // The token was replaced or invalidated.
+          return;
+        }
+        if (weak_this->cached_token_used_) {
+          weak_this->FetchToken();
+        }
+      },
+      delay);
+}
+
 void AuthProviderImpl::GetToken(
     std::function<void(cloud_sync::AuthStatus, modular::auth::FirebaseTokenPtr)>
         callback) {
+  ++provider_calls_;
+  ReportMetrics();
   token_provider_->GetFirebaseAuthToken(
       api_key_, [ this, callback = std::move(callback) ](
                     modular::auth::FirebaseTokenPtr token,
@@ -80,4 +232,9 @@ void AuthProviderImpl::GetToken(
       });
 }
 
+void AuthProviderImpl::ReportMetrics() {
+  TRACE_COUNTER("ledger", "auth_provider", reinterpret_cast<uintptr_t>(this),
+                "cache_hits", cache_hits_, "provider_calls", provider_calls_);
+}
+
 }  // namespace ledger
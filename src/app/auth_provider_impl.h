@@ -8,12 +8,14 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "apps/ledger/src/backoff/backoff.h"
 #include "apps/ledger/src/cloud_sync/public/auth_provider.h"
 #include "apps/modular/services/auth/token_provider.fidl.h"
 #include "lib/ftl/memory/weak_ptr.h"
 #include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ledger {
 
@@ -25,7 +27,10 @@ namespace ledger {
 // the code to work without auth against public instances (e.g. for running
 // benchmarks).
 //
-// This is currently a placeholder that always returns an empty token.
+// The Firebase token is cached until shortly before the expiration time it
+// carries, and shared by all the requests: concurrent requests are served by a
+// single call to the token provider. A token in use is refreshed ahead of its
+// expiration, so that the sync of the pages does not wait for it.
 class AuthProviderImpl : public cloud_sync::AuthProvider {
  public:
   AuthProviderImpl(ftl::RefPtr<ftl::TaskRunner> task_runner,
@@ -42,17 +47,58 @@ class AuthProviderImpl : public cloud_sync::AuthProvider {
       std::function<void(cloud_sync::AuthStatus, std::string)> callback)
       override;
 
+  void InvalidateFirebaseToken(const std::string& firebase_token) override;
+
+  // Number of requests served from the cached token.
+  uint64_t cache_hits() const { return cache_hits_; }
+  // Number of calls made to the token provider.
+  uint64_t provider_calls() const { return provider_calls_; }
+
  private:
+  using TokenCallback =
+      std::function<void(cloud_sync::AuthStatus,
+                         const modular::auth::FirebaseTokenPtr&)>;
+
+  // Calls |callback| with the cached token if it is still valid, or with a
+  // new token otherwise.
+  void GetCachedToken(TokenCallback callback);
+
+  // Retrieves a new token and caches it, unless a retrieval is already in
+  // progress.
+  void FetchToken();
+  void OnTokenFetched(cloud_sync::AuthStatus status,
+                      modular::auth::FirebaseTokenPtr token);
+
+  // Schedules the refresh of the cached token ahead of its expiration.
+  void ScheduleRefresh();
+
   // Retrieves the Firebase token from the token provider, transparently
   // retrying the request until success.
   void GetToken(std::function<void(cloud_sync::AuthStatus,
                                    modular::auth::FirebaseTokenPtr)> callback);
 
+  void ReportMetrics();
+
   ftl::RefPtr<ftl::TaskRunner> task_runner_;
   const std::string api_key_;
   modular::auth::TokenProviderPtr token_provider_;
   const std::unique_ptr<backoff::Backoff> backoff_;
 
+  // Cached token, null if there is none, and the time after which it must no
+  // longer be used.
+  modular::auth::FirebaseTokenPtr cached_token_;
+  ftl::TimePoint cached_token_expiration_;
+  // Whether the cached token was used since it was retrieved. Unused tokens are
+  // not refreshed ahead of their expiration.
+  bool cached_token_used_ = false;
+  // Whether a token is being retrieved from the token provider, and the
+  // requests waiting for it.
+  bool fetch_in_progress_ = false;
+  std::vector<TokenCallback> pending_callbacks_;
+
+  uint64_t cache_hits_ = 0u;
+  uint64_t provider_calls_ = 0u;
+
   // Must be the last member field.
   ftl::WeakPtrFactory<AuthProviderImpl> weak_factory_;
 };
@@ -4,10 +4,13 @@
 
 #include "apps/ledger/src/app/auth_provider_impl.h"
 
+#include <time.h>
+
 #include <utility>
 
 #include "apps/ledger/src/backoff/test/test_backoff.h"
 #include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/glue/crypto/base64.h"
 #include "apps/ledger/src/test/test_with_message_loop.h"
 #include "apps/modular/services/auth/token_provider.fidl.h"
 #include "lib/fidl/cpp/bindings/binding.h"
@@ -17,6 +20,14 @@ namespace ledger {
 
 namespace {
 
+// Returns a Firebase ID token expiring |seconds_left| seconds from now.
+std::string MakeIdToken(int64_t seconds_left) {
+  std::string payload = glue::Base64UrlEncode(
+      "{\"exp\":" + std::to_string(time(nullptr) + seconds_left) + "}");
+  payload.erase(payload.find_last_not_of('=') + 1);
+  return "header." + payload + ".signature";
+}
+
 class TestTokenProvider : public modular::auth::TokenProvider {
  public:
   explicit TestTokenProvider(ftl::RefPtr<ftl::TaskRunner> task_runner)
@@ -179,6 +190,99 @@ TEST_F(AuthProviderImplTest, GetFirebaseUserIdRetryOnError) {
   EXPECT_EQ(1, backoff_->reset_count);
 }
 
+TEST_F(AuthProviderImplTest, CachesToken) {
+  std::string id_token = MakeIdToken(3600);
+  token_provider_.Set(id_token, "some id", "me@example.com");
+
+  for (size_t i = 0; i < 3; ++i) {
+    cloud_sync::AuthStatus auth_status;
+    std::string firebase_token;
+    auth_provider_.GetFirebaseToken(
+        callback::Capture(MakeQuitTask(), &auth_status, &firebase_token));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(cloud_sync::AuthStatus::OK, auth_status);
+    EXPECT_EQ(id_token, firebase_token);
+  }
+
+  std::string firebase_user_id;
+  cloud_sync::AuthStatus auth_status;
+  auth_provider_.GetFirebaseUserId(
+      callback::Capture(MakeQuitTask(), &auth_status, &firebase_user_id));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ("some id", firebase_user_id);
+
+  EXPECT_EQ(1u, auth_provider_.provider_calls());
+  EXPECT_EQ(3u, auth_provider_.cache_hits());
+}
+
+TEST_F(AuthProviderImplTest, CoalescesConcurrentRequests) {
+  std::string id_token = MakeIdToken(3600);
+  token_provider_.Set(id_token, "some id", "me@example.com");
+
+  std::vector<std::string> firebase_tokens;
+  for (size_t i = 0; i < 3; ++i) {
+    auth_provider_.GetFirebaseToken(
+        [this, &firebase_tokens](auto status, auto token) {
+          EXPECT_EQ(cloud_sync::AuthStatus::OK, status);
+          firebase_tokens.push_back(std::move(token));
+          if (firebase_tokens.size() == 3u) {
+            message_loop_.PostQuitTask();
+          }
+        });
+  }
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(std::vector<std::string>(3, id_token), firebase_tokens);
+  EXPECT_EQ(1u, auth_provider_.provider_calls());
+  EXPECT_EQ(0u, auth_provider_.cache_hits());
+}
+
+TEST_F(AuthProviderImplTest, InvalidateToken) {
+  std::string id_token = MakeIdToken(3600);
+  token_provider_.Set(id_token, "some id", "me@example.com");
+
+  cloud_sync::AuthStatus auth_status;
+  std::string firebase_token;
+  auth_provider_.GetFirebaseToken(
+      callback::Capture(MakeQuitTask(), &auth_status, &firebase_token));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1u, auth_provider_.provider_calls());
+
+  // Invalidating a token that is not cached has no effect.
+  auth_provider_.InvalidateFirebaseToken("other token");
+  auth_provider_.GetFirebaseToken(
+      callback::Capture(MakeQuitTask(), &auth_status, &firebase_token));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1u, auth_provider_.provider_calls());
+
+  std::string new_id_token = MakeIdToken(7200);
+  token_provider_.Set(new_id_token, "some id", "me@example.com");
+  auth_provider_.InvalidateFirebaseToken(id_token);
+  auth_provider_.GetFirebaseToken(
+      callback::Capture(MakeQuitTask(), &auth_status, &firebase_token));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(cloud_sync::AuthStatus::OK, auth_status);
+  EXPECT_EQ(new_id_token, firebase_token);
+  EXPECT_EQ(2u, auth_provider_.provider_calls());
+}
+
+TEST_F(AuthProviderImplTest, DoNotCacheExpiringTokens) {
+  // The token expires too soon to be used again, and the other one does not
+  // carry an expiration time.
+  for (const auto& id_token : {MakeIdToken(30), std::string("some token")}) {
+    token_provider_.Set(id_token, "some id", "me@example.com");
+    for (size_t i = 0; i < 2; ++i) {
+      cloud_sync::AuthStatus auth_status;
+      std::string firebase_token;
+      auth_provider_.GetFirebaseToken(
+          callback::Capture(MakeQuitTask(), &auth_status, &firebase_token));
+      EXPECT_FALSE(RunLoopWithTimeout());
+      EXPECT_EQ(id_token, firebase_token);
+    }
+  }
+  EXPECT_EQ(4u, auth_provider_.provider_calls());
+  EXPECT_EQ(0u, auth_provider_.cache_hits());
+}
+
 }  // namespace
 
 }  // namespace ledger
@@ -7,29 +7,47 @@
 #include <vector>
 
 #include "apps/ledger/src/app/diff_utils.h"
-#include "apps/ledger/src/app/fidl/serialization_size.h"
+#include "apps/ledger/src/app/operation_recorder.h"
 #include "apps/ledger/src/app/page_manager.h"
 #include "apps/ledger/src/app/page_utils.h"
 #include "apps/ledger/src/callback/waiter.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/functional/auto_call.h"
 #include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ledger {
 class BranchTracker::PageWatcherContainer {
  public:
-  PageWatcherContainer(coroutine::CoroutineService* coroutine_service,
+  PageWatcherContainer(Environment* environment,
                        PageWatcherPtr watcher,
                        PageManager* page_manager,
                        storage::PageStorage* storage,
+                       DiffCache* diff_cache,
+                       const std::string& diff_prefix,
+                       BranchTracker* branch_tracker,
                        std::unique_ptr<const storage::Commit> base_commit,
-                       std::string key_prefix)
+                       std::string key_prefix,
+                       WatcherOptionsPtr watcher_options)
       : change_in_flight_(false),
         last_commit_(std::move(base_commit)),
-        coroutine_service_(coroutine_service),
+        coroutine_service_(environment->coroutine_service()),
+        task_runner_(environment->main_runner()),
         key_prefix_(std::move(key_prefix)),
         manager_(page_manager),
         storage_(storage),
-        interface_(std::move(watcher)) {
+        diff_cache_(diff_cache),
+        diff_prefix_(diff_prefix),
+        branch_tracker_(branch_tracker),
+        interface_(std::move(watcher)),
+        weak_factory_(this) {
+    FTL_DCHECK(PageUtils::MatchesPrefix(key_prefix_, diff_prefix_));
+    if (watcher_options) {
+      min_delivery_interval_ = ftl::TimeDelta::FromMilliseconds(
+          watcher_options->min_delivery_interval_ms);
+      max_batch_size_ = watcher_options->max_batch_size;
+    }
     interface_.set_connection_error_handler([this] {
       if (handler_) {
         handler_->Continue(true);
@@ -55,10 +73,21 @@ class BranchTracker::PageWatcherContainer {
   }
 
   void UpdateCommit(std::unique_ptr<const storage::Commit> commit) {
-    current_commit_ = std::move(commit);
+    SetPendingCommit(std::move(commit));
     SendCommit();
   }
 
+  // Sets the commit the watcher must be brought to, without sending it yet.
+  void SetPendingCommit(std::unique_ptr<const storage::Commit> commit) {
+    if (current_commit_) {
+      // The previous commit was not sent yet: the next change will go directly
+      // from |last_commit_| to |commit|.
+      branch_tracker_->OnCommitCoalesced();
+    }
+    current_commit_ = std::move(commit);
+    ++pending_commit_count_;
+  }
+
   // Sets a callback to be called when all pending updates are sent. If all
   // updates are already sent, the callback will be called immediately. This
   // callback will only be called once; |SetOnDrainedCallback| should be called
@@ -74,10 +103,55 @@ class BranchTracker::PageWatcherContainer {
       on_drained_ = nullptr;
     }
     on_drained_ = on_drained;
-    if (Drained() && on_drained_) {
+    if (!on_drained_) {
+      return;
+    }
+    if (Drained()) {
       on_drained();
       on_drained_ = nullptr;
+      return;
     }
+    // Changes delayed by the watcher options must not block the transaction.
+    SendCommit();
+  }
+
+  // Sends a commit to the watcher if needed.
+  void SendCommit() {
+    if (change_in_flight_) {
+      return;
+    }
+
+    if (Drained()) {
+      if (on_drained_) {
+        on_drained_();
+        on_drained_ = nullptr;
+      }
+      return;
+    }
+
+    if (ShouldDelayChange()) {
+      return;
+    }
+
+    change_in_flight_ = true;
+    last_delivery_time_ = ftl::TimePoint::Now();
+    pending_commit_count_ = 0u;
+
+    // The diff between the two commits is shared with the other watchers of
+    // this branch.
+    // TODO(etiennej): See LE-74: clean object ownership
+    diff_cache_->GetEntryChanges(
+        *last_commit_, *current_commit_, diff_prefix_,
+        ftl::MakeCopyable([
+          weak_this = weak_factory_.GetWeakPtr(),
+          new_commit = std::move(current_commit_)
+        ](Status status,
+          ftl::RefPtr<diff_utils::EntryChanges> changes) mutable {
+          if (weak_this) {
+            weak_this->OnEntryChanges(status, std::move(changes),
+                                      std::move(new_commit));
+          }
+        }));
   }
 
  private:
@@ -88,63 +162,33 @@ class BranchTracker::PageWatcherContainer {
            last_commit_->GetId() == current_commit_->GetId();
   }
 
-  std::vector<PageChangePtr> PaginateChanges(PageChangePtr change) {
-    std::vector<PageChangePtr> changes;
-
-    // These are initialized to valid values in the first run of the loop.
-    size_t fidl_size = -1;
-    size_t handle_count = -1;
-    size_t timestamp = change->timestamp;
-    auto entries = std::move(change->changes);
-    auto deletions = std::move(change->deleted_keys);
-    for (size_t i = 0, j = 0; i < entries.size() || j < deletions.size();) {
-      bool add_entry =
-          i < entries.size() && (j == deletions.size() ||
-                                 convert::ExtendedStringView(entries[i]->key) <
-                                     convert::ExtendedStringView(deletions[j]));
-      size_t entry_size =
-          add_entry ? fidl_serialization::GetEntrySize(entries[i]->key.size())
-                    : fidl_serialization::GetByteArraySize(deletions[j].size());
-      size_t entry_handle_count = add_entry ? 1 : 0;
-
-      if (changes.empty() ||
-          fidl_size + entry_size > fidl_serialization::kMaxInlineDataSize ||
-          handle_count + entry_handle_count >
-              fidl_serialization::kMaxMessageHandles) {
-        changes.push_back(PageChange::New());
-        changes.back()->timestamp = timestamp;
-        changes.back()->changes = fidl::Array<EntryPtr>::New(0);
-        changes.back()->deleted_keys =
-            fidl::Array<fidl::Array<uint8_t>>::New(0);
-        fidl_size = fidl_serialization::kPageChangeHeaderSize;
-        handle_count = 0u;
-      }
-      fidl_size += entry_size;
-      handle_count += entry_handle_count;
-      if (add_entry) {
-        changes.back()->changes.push_back(std::move(entries[i]));
-        ++i;
-      } else {
-        changes.back()->deleted_keys.push_back(std::move(deletions[j]));
-        ++j;
-      }
-    }
-    return changes;
-  }
-
   void SendChange(PageChangePtr page_change,
                   ResultState state,
                   std::unique_ptr<const storage::Commit> new_commit,
                   ftl::Closure on_done) {
+    // The recorded duration is the time taken by the client to acknowledge
+    // the change.
+    RecordedOperation operation;
+    if (manager_->recorder()) {
+      operation = manager_->recorder()->Start("PageWatcher.OnChange");
+      operation.SetNumber("changes", page_change->changes.size());
+      operation.SetNumber("deleted_keys", page_change->deleted_keys.size());
+      operation.SetNumber("state", static_cast<int64_t>(state));
+    }
     interface_->OnChange(
         std::move(page_change), state, ftl::MakeCopyable([
           this, state, new_commit = std::move(new_commit),
-          on_done = std::move(on_done)
+          on_done = std::move(on_done), operation = std::move(operation)
         ](fidl::InterfaceRequest<PageSnapshot> snapshot_request) mutable {
           if (snapshot_request) {
             manager_->BindPageSnapshot(
                 new_commit->Clone(), std::move(snapshot_request), key_prefix_);
+            if (operation.enabled()) {
+              operation.SetNumber("snapshot",
+                                  manager_->recorder()->last_snapshot_index());
+            }
           }
+          operation.Done();
           if (state != ResultState::COMPLETED &&
               state != ResultState::PARTIAL_COMPLETED) {
             on_done();
@@ -159,81 +203,122 @@ class BranchTracker::PageWatcherContainer {
         }));
   }
 
-  // Sends a commit to the watcher if needed.
-  void SendCommit() {
-    if (change_in_flight_) {
-      return;
+  // Returns true if sending the pending change must wait because of the
+  // watcher options. In that case, schedules the change to be sent later.
+  bool ShouldDelayChange() {
+    if (min_delivery_interval_ == ftl::TimeDelta::Zero() || on_drained_) {
+      return false;
     }
+    if (max_batch_size_ > 0u && pending_commit_count_ >= max_batch_size_) {
+      return false;
+    }
+    ftl::TimeDelta elapsed = ftl::TimePoint::Now() - last_delivery_time_;
+    if (elapsed >= min_delivery_interval_) {
+      return false;
+    }
+    if (!delayed_change_scheduled_) {
+      delayed_change_scheduled_ = true;
+      task_runner_->PostDelayedTask(
+          [weak_this = weak_factory_.GetWeakPtr()] {
+            if (weak_this) {
+              weak_this->delayed_change_scheduled_ = false;
+              weak_this->SendCommit();
+            }
+          },
+          min_delivery_interval_ - elapsed);
+    }
+    return true;
+  }
 
-    if (Drained()) {
-      if (on_drained_) {
-        on_drained_();
-        on_drained_ = nullptr;
-      }
+  void OnEntryChanges(Status status,
+                      ftl::RefPtr<diff_utils::EntryChanges> changes,
+                      std::unique_ptr<const storage::Commit> new_commit) {
+    if (status != Status::OK) {
+      FTL_LOG(ERROR) << "Unable to compute PageChange for Watch update.";
+      AbandonChange(std::move(new_commit));
       return;
     }
 
-    change_in_flight_ = true;
+    std::vector<diff_utils::ChangeRange> pages =
+        diff_utils::PaginateEntryChanges(*changes, key_prefix_);
+    if (pages.empty()) {
+      change_in_flight_ = false;
+      last_commit_.swap(new_commit);
+      SendCommit();
+      return;
+    }
 
-    // TODO(etiennej): See LE-74: clean object ownership
-    diff_utils::ComputePageChange(
-        storage_, *last_commit_, *current_commit_, key_prefix_, key_prefix_,
-        diff_utils::PaginationBehavior::NO_PAGINATION,
-        ftl::MakeCopyable([ this, new_commit = std::move(current_commit_) ](
-            Status status,
-            std::pair<PageChangePtr, std::string> page_change_ptr) mutable {
-          if (status != Status::OK) {
-            // This change notification is abandonned. At the next commit,
-            // we will try again (but not before). The next notification
-            // will cover both this change and the next.
-            FTL_LOG(ERROR) << "Unable to compute PageChange for Watch update.";
-            change_in_flight_ = false;
-            return;
-          }
+    // Pages are split using only the keys of the changes. The values of a page
+    // are read only once the client acknowledged the previous page, so that at
+    // most one message worth of values is held in memory for this watcher.
+    coroutine_service_->StartCoroutine(ftl::MakeCopyable([
+      this, new_commit = std::move(new_commit), changes = std::move(changes),
+      pages = std::move(pages)
+    ](coroutine::CoroutineHandler * handler) mutable {
+      auto guard = ftl::MakeAutoCall([this] { handler_ = nullptr; });
+      FTL_DCHECK(!handler_);
+      handler_ = handler;
+      int64_t timestamp = new_commit->GetTimestamp();
+      for (size_t i = 0; i < pages.size(); ++i) {
+        Status status;
+        PageChangePtr page_change;
+        if (coroutine::SyncCall(
+                handler,
+                [this, timestamp, &changes, range = pages[i]](
+                    std::function<void(Status, PageChangePtr)> callback) {
+                  diff_utils::ComputePageChangeForRange(
+                      storage_, timestamp, changes, range,
+                      std::move(callback));
+                },
+                &status, &page_change)) {
+          return;
+        }
+        if (status != Status::OK) {
+          // The pages already sent are superseded by the next change, which
+          // starts a new sequence from |last_commit_|.
+          FTL_LOG(ERROR) << "Unable to compute PageChange for Watch update.";
+          AbandonChange(std::move(new_commit));
+          return;
+        }
+
+        ResultState state;
+        if (pages.size() == 1) {
+          state = ResultState::COMPLETED;
+        } else if (i == 0) {
+          state = ResultState::PARTIAL_STARTED;
+        } else if (i == pages.size() - 1) {
+          state = ResultState::PARTIAL_COMPLETED;
+        } else {
+          state = ResultState::PARTIAL_CONTINUED;
+        }
+        if (coroutine::SyncCall(
+                handler, ftl::MakeCopyable([
+                  this, change = std::move(page_change), state,
+                  new_commit = new_commit->Clone()
+                ](ftl::Closure on_done) mutable {
+                  SendChange(std::move(change), state, std::move(new_commit),
+                             std::move(on_done));
+                }))) {
+          return;
+        }
+      }
+    }));
+  }
 
-          if (!page_change_ptr.first) {
-            change_in_flight_ = false;
-            last_commit_.swap(new_commit);
-            SendCommit();
-            return;
-          }
-          std::vector<PageChangePtr> paginated_changes =
-              PaginateChanges(std::move(page_change_ptr.first));
-          if (paginated_changes.size() == 1) {
-            SendChange(std::move(paginated_changes[0]), ResultState::COMPLETED,
-                       std::move(new_commit), [] {});
-            return;
-          }
-          coroutine_service_->StartCoroutine(ftl::MakeCopyable([
-            this, new_commit = std::move(new_commit),
-            paginated_changes = std::move(paginated_changes)
-          ](coroutine::CoroutineHandler * handler) mutable {
-            auto guard = ftl::MakeAutoCall([this] { handler_ = nullptr; });
-            FTL_DCHECK(!handler_);
-            handler_ = handler;
-            for (size_t i = 0; i < paginated_changes.size(); ++i) {
-              ResultState state;
-              if (i == 0) {
-                state = ResultState::PARTIAL_STARTED;
-              } else if (i == paginated_changes.size() - 1) {
-                state = ResultState::PARTIAL_COMPLETED;
-              } else {
-                state = ResultState::PARTIAL_CONTINUED;
-              }
-              if (coroutine::SyncCall(
-                      handler, ftl::MakeCopyable([
-                        this, change = std::move(paginated_changes[i]), state,
-                        new_commit = new_commit->Clone()
-                      ](ftl::Closure on_done) mutable {
-                        SendChange(std::move(change), state,
-                                   std::move(new_commit), std::move(on_done));
-
-                      }))) {
-                return;
-              }
-            }
-          }));
-        }));
+  // Abandons the change to |new_commit|. |last_commit_| is left unchanged, and
+  // |new_commit| becomes pending again unless a newer commit arrived in the
+  // meantime, so that the next change sent to the watcher covers this one. It
+  // is sent with the next commit, or when the watcher must be drained.
+  void AbandonChange(std::unique_ptr<const storage::Commit> new_commit) {
+    change_in_flight_ = false;
+    if (!current_commit_) {
+      current_commit_ = std::move(new_commit);
+    }
+    // Do not block a transaction on a change that cannot be computed.
+    if (on_drained_) {
+      on_drained_();
+      on_drained_ = nullptr;
+    }
   }
 
   ftl::Closure on_drained_ = nullptr;
@@ -242,23 +327,45 @@ class BranchTracker::PageWatcherContainer {
   std::unique_ptr<const storage::Commit> last_commit_;
   std::unique_ptr<const storage::Commit> current_commit_;
   coroutine::CoroutineService* coroutine_service_;
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
   coroutine::CoroutineHandler* handler_ = nullptr;
   const std::string key_prefix_;
   PageManager* manager_;
   storage::PageStorage* storage_;
+  DiffCache* diff_cache_;
+  // Common prefix of the keys watched by all watchers of the branch.
+  const std::string& diff_prefix_;
+  BranchTracker* const branch_tracker_;
   PageWatcherPtr interface_;
+
+  // Rate limiting of the changes, as requested by the watcher options.
+  ftl::TimeDelta min_delivery_interval_ = ftl::TimeDelta::Zero();
+  size_t max_batch_size_ = 0u;
+  // Number of commits received since the last change was sent.
+  size_t pending_commit_count_ = 0u;
+  ftl::TimePoint last_delivery_time_;
+  bool delayed_change_scheduled_ = false;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<PageWatcherContainer> weak_factory_;
 };
 
-BranchTracker::BranchTracker(coroutine::CoroutineService* coroutine_service,
+BranchTracker::BranchTracker(Environment* environment,
                              PageManager* manager,
                              storage::PageStorage* storage)
-    : coroutine_service_(coroutine_service),
+    : environment_(environment),
       manager_(manager),
       storage_(storage),
+      diff_cache_(storage),
       transaction_in_progress_(false),
       current_commit_(nullptr),
       weak_factory_(this) {
-  watchers_.set_on_empty([this] { CheckEmpty(); });
+  watchers_.set_on_empty([this] {
+    has_diff_prefix_ = false;
+    diff_prefix_.clear();
+    diff_cache_.Clear();
+    CheckEmpty();
+  });
 }
 
 BranchTracker::~BranchTracker() {
@@ -315,6 +422,7 @@ void BranchTracker::OnNewCommits(
   }
   if (changed) {
     current_commit_ = (*new_current_commit)->Clone();
+    diff_cache_.SetBranchHead(current_commit_id_);
   }
 
   if (!changed || transaction_in_progress_) {
@@ -347,12 +455,18 @@ void BranchTracker::StopTransaction(
   if (commit) {
     current_commit_id_ = commit->GetId();
     current_commit_ = std::move(commit);
+    diff_cache_.SetBranchHead(current_commit_id_);
   }
 
   if (!current_commit_) {
     // current_commit_ has a null value only if OnNewCommits has neven been
     // called. Here we are in the case where a transaction stops, but no new
-    // commits have arrived in between: there is no need to update the watchers.
+    // commits have arrived in between: only the commits pending for watchers
+    // registered during the transaction need to be sent.
+    for (auto& watcher : watchers_) {
+      watcher.SetOnDrainedCallback(nullptr);
+      watcher.SendCommit();
+    }
     return;
   }
 
@@ -365,9 +479,37 @@ void BranchTracker::StopTransaction(
 void BranchTracker::RegisterPageWatcher(
     PageWatcherPtr page_watcher_ptr,
     std::unique_ptr<const storage::Commit> base_commit,
-    std::string key_prefix) {
-  watchers_.emplace(coroutine_service_, std::move(page_watcher_ptr), manager_,
-                    storage_, std::move(base_commit), std::move(key_prefix));
+    std::string key_prefix,
+    WatcherOptionsPtr watcher_options,
+    std::unique_ptr<const storage::Commit> pending_commit) {
+  // Diffs are computed for the longest prefix common to all watchers. It is
+  // only shortened as watchers are added, which keeps it a valid prefix of the
+  // keys of all remaining watchers.
+  if (!has_diff_prefix_) {
+    diff_prefix_ = key_prefix;
+    has_diff_prefix_ = true;
+  } else {
+    size_t common_size = 0;
+    while (common_size < diff_prefix_.size() &&
+           common_size < key_prefix.size() &&
+           diff_prefix_[common_size] == key_prefix[common_size]) {
+      ++common_size;
+    }
+    diff_prefix_.resize(common_size);
+  }
+  PageWatcherContainer& watcher = watchers_.emplace(
+      environment_, std::move(page_watcher_ptr), manager_, storage_,
+      &diff_cache_, diff_prefix_, this, std::move(base_commit),
+      std::move(key_prefix), std::move(watcher_options));
+  if (pending_commit) {
+    // No notification is sent during a transaction: the pending commit is then
+    // sent when the transaction stops.
+    if (transaction_in_progress_) {
+      watcher.SetPendingCommit(std::move(pending_commit));
+    } else {
+      watcher.UpdateCommit(std::move(pending_commit));
+    }
+  }
 }
 
 bool BranchTracker::IsEmpty() {
@@ -382,6 +524,12 @@ void BranchTracker::InitCommitAndSetWatcher(storage::CommitId commit_id) {
   storage_->AddCommitWatcher(this);
 }
 
+void BranchTracker::OnCommitCoalesced() {
+  ++coalesced_commit_count_;
+  TRACE_COUNTER("ledger", "branch_tracker", reinterpret_cast<uintptr_t>(this),
+                "coalesced_commits", coalesced_commit_count_);
+}
+
 void BranchTracker::CheckEmpty() {
   if (on_empty_callback_ && IsEmpty())
     on_empty_callback_();
@@ -6,11 +6,13 @@
 #define APPS_LEDGER_SRC_APP_BRANCH_TRACKER_H_
 
 #include <memory>
+#include <string>
 
 #include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/app/diff_cache.h"
 #include "apps/ledger/src/app/page_snapshot_impl.h"
 #include "apps/ledger/src/callback/auto_cleanable.h"
-#include "apps/ledger/src/coroutine/coroutine.h"
+#include "apps/ledger/src/environment/environment.h"
 #include "apps/ledger/src/storage/public/commit_watcher.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "apps/ledger/src/storage/public/types.h"
@@ -25,7 +27,7 @@ class PageManager;
 // have the same parent, the first one to be received will be tracked.
 class BranchTracker : public storage::CommitWatcher {
  public:
-  BranchTracker(coroutine::CoroutineService* coroutine_service,
+  BranchTracker(Environment* environment,
                 PageManager* manager,
                 storage::PageStorage* storage);
   ~BranchTracker() override;
@@ -37,10 +39,17 @@ class BranchTracker : public storage::CommitWatcher {
   // Returns the head commit of the currently tracked branch.
   const storage::CommitId& GetBranchHeadId();
 
-  // Registers a new PageWatcher interface.
-  void RegisterPageWatcher(PageWatcherPtr page_watcher_ptr,
-                           std::unique_ptr<const storage::Commit> base_commit,
-                           std::string key_prefix);
+  // Registers a new PageWatcher interface, notified of the changes following
+  // |base_commit|. |watcher_options| can be null, in which case changes are
+  // sent as soon as the watcher is ready to receive them. If |pending_commit|
+  // is not null, the watcher is first sent the changes between |base_commit|
+  // and |pending_commit|.
+  void RegisterPageWatcher(
+      PageWatcherPtr page_watcher_ptr,
+      std::unique_ptr<const storage::Commit> base_commit,
+      std::string key_prefix,
+      WatcherOptionsPtr watcher_options = nullptr,
+      std::unique_ptr<const storage::Commit> pending_commit = nullptr);
 
   // Informs the BranchTracker that a transaction is in progress. It first
   // drains all pending Watcher updates, then stops sending them until
@@ -59,6 +68,10 @@ class BranchTracker : public storage::CommitWatcher {
   // Returns true if there are no watchers registered.
   bool IsEmpty();
 
+  // Returns the number of commits that were coalesced with a later one before
+  // being sent to a watcher, each of them sparing a diff computation.
+  uint64_t coalesced_commit_count() const { return coalesced_commit_count_; }
+
  private:
   class PageWatcherContainer;
 
@@ -69,11 +82,20 @@ class BranchTracker : public storage::CommitWatcher {
 
   void InitCommitAndSetWatcher(storage::CommitId commit_id);
 
+  // Called by the watchers when a commit is coalesced with a later one.
+  void OnCommitCoalesced();
+
   void CheckEmpty();
 
-  coroutine::CoroutineService* coroutine_service_;
+  Environment* environment_;
   PageManager* manager_;
   storage::PageStorage* storage_;
+  // Shares diff computations between the watchers. Must outlive |watchers_|.
+  DiffCache diff_cache_;
+  // Longest key prefix common to all registered watchers.
+  std::string diff_prefix_;
+  bool has_diff_prefix_ = false;
+  uint64_t coalesced_commit_count_ = 0u;
   callback::AutoCleanableSet<PageWatcherContainer> watchers_;
   ftl::Closure on_empty_callback_;
 
@@ -0,0 +1,283 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/branch_tracker.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "apps/ledger/src/app/constants.h"
+#include "apps/ledger/src/app/merging/merge_resolver.h"
+#include "apps/ledger/src/app/page_manager.h"
+#include "apps/ledger/src/backoff/exponential_backoff.h"
+#include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/storage/fake/fake_page_storage.h"
+#include "apps/ledger/src/storage/test/commit_empty_impl.h"
+#include "apps/ledger/src/storage/test/page_storage_empty_impl.h"
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+#include "lib/fidl/cpp/bindings/binding.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace ledger {
+namespace {
+
+class TestCommit : public storage::test::CommitEmptyImpl {
+ public:
+  TestCommit(storage::CommitId id, storage::CommitId parent_id)
+      : id_(std::move(id)), parent_id_(std::move(parent_id)) {}
+  ~TestCommit() override = default;
+
+  std::unique_ptr<storage::Commit> Clone() const override {
+    return std::make_unique<TestCommit>(id_, parent_id_);
+  }
+
+  const storage::CommitId& GetId() const override { return id_; }
+
+  std::vector<storage::CommitIdView> GetParentIds() const override {
+    return {parent_id_};
+  }
+
+ private:
+  storage::CommitId id_;
+  storage::CommitId parent_id_;
+};
+
+class TestObject : public storage::Object {
+ public:
+  explicit TestObject(storage::ObjectId id) : id_(std::move(id)) {}
+  ~TestObject() override {}
+
+  storage::ObjectId GetId() const override { return id_; }
+
+  storage::Status GetData(ftl::StringView* data) const override {
+    *data = id_;
+    return storage::Status::OK;
+  }
+
+ private:
+  storage::ObjectId id_;
+};
+
+// PageStorage whose head is "base", and whose diff computations only complete
+// when |RunPendingDiffs| is called, so that the changes sent to the watchers
+// stay in flight until then. Diffs return |changes|. Reading a value fails
+// while |fail_get_object| is true.
+class TestPageStorage : public storage::test::PageStorageEmptyImpl {
+ public:
+  TestPageStorage() {}
+  ~TestPageStorage() override {}
+
+  void GetHeadCommitIds(
+      std::function<void(storage::Status, std::vector<storage::CommitId>)>
+          callback) override {
+    callback(storage::Status::OK, {"base"});
+  }
+
+  storage::Status AddCommitWatcher(
+      storage::CommitWatcher* /*watcher*/) override {
+    return storage::Status::OK;
+  }
+
+  storage::Status RemoveCommitWatcher(
+      storage::CommitWatcher* /*watcher*/) override {
+    return storage::Status::OK;
+  }
+
+  void GetCommitContentsDiff(
+      const storage::Commit& /*base_commit*/,
+      const storage::Commit& /*other_commit*/,
+      std::string /*min_key*/,
+      std::function<bool(storage::EntryChange)> on_next_diff,
+      std::function<void(storage::Status)> on_done) override {
+    ++diff_count;
+    pending_diffs.push_back([
+      this, on_next_diff = std::move(on_next_diff), on_done = std::move(on_done)
+    ] {
+      for (const auto& change : changes) {
+        if (!on_next_diff(change)) {
+          break;
+        }
+      }
+      on_done(storage::Status::OK);
+    });
+  }
+
+  void GetObject(storage::ObjectIdView object_id,
+                 Location /*location*/,
+                 std::function<void(storage::Status,
+                                    std::unique_ptr<const storage::Object>)>
+                     callback) override {
+    if (fail_get_object) {
+      callback(storage::Status::IO_ERROR, nullptr);
+      return;
+    }
+    callback(storage::Status::OK,
+             std::make_unique<TestObject>(object_id.ToString()));
+  }
+
+  void RunPendingDiffs() {
+    std::vector<ftl::Closure> diffs = std::move(pending_diffs);
+    pending_diffs.clear();
+    for (const auto& diff : diffs) {
+      diff();
+    }
+  }
+
+  std::vector<storage::EntryChange> changes;
+  std::vector<ftl::Closure> pending_diffs;
+  int diff_count = 0;
+  bool fail_get_object = false;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(TestPageStorage);
+};
+
+class TestPageWatcher : public PageWatcher {
+ public:
+  TestPageWatcher(fidl::InterfaceRequest<PageWatcher> request,
+                  ftl::Closure on_change)
+      : binding_(this, std::move(request)), on_change_(std::move(on_change)) {}
+  ~TestPageWatcher() override {}
+
+  std::vector<ResultState> result_states;
+
+ private:
+  // PageWatcher:
+  void OnChange(PageChangePtr /*page_change*/,
+                ResultState result_state,
+                const OnChangeCallback& callback) override {
+    result_states.push_back(result_state);
+    callback(nullptr);
+    on_change_();
+  }
+
+  fidl::Binding<PageWatcher> binding_;
+  ftl::Closure on_change_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(TestPageWatcher);
+};
+
+storage::EntryChange MakeDeletion(std::string key) {
+  return storage::EntryChange{
+      storage::Entry{std::move(key), "", storage::KeyPriority::EAGER}, true};
+}
+
+storage::EntryChange MakeUpdate(std::string key) {
+  return storage::EntryChange{
+      storage::Entry{std::move(key), "object_id", storage::KeyPriority::EAGER},
+      false};
+}
+
+class BranchTrackerTest : public test::TestWithMessageLoop {
+ public:
+  BranchTrackerTest()
+      : environment_(mtl::MessageLoop::GetCurrent()->task_runner(), nullptr),
+        page_manager_(CreatePageManager(&environment_)),
+        branch_tracker_(&environment_, page_manager_.get(), &storage_) {}
+  ~BranchTrackerTest() override {}
+
+ protected:
+  void AddCommit(storage::CommitId id, storage::CommitId parent_id) {
+    std::vector<std::unique_ptr<const storage::Commit>> commits;
+    commits.push_back(
+        std::make_unique<TestCommit>(std::move(id), std::move(parent_id)));
+    static_cast<storage::CommitWatcher*>(&branch_tracker_)
+        ->OnNewCommits(commits, storage::ChangeSource::SYNC);
+  }
+
+  // Returns the PageManager the watchers use to bind snapshots.
+  static std::unique_ptr<PageManager> CreatePageManager(
+      Environment* environment) {
+    auto storage = std::make_unique<storage::fake::FakePageStorage>(
+        storage::PageId(kPageIdSize, 'a'));
+    auto resolver = std::make_unique<MergeResolver>(
+        [] {}, environment, storage.get(),
+        std::make_unique<backoff::ExponentialBackoff>(
+            ftl::TimeDelta::FromSeconds(0), 1u,
+            ftl::TimeDelta::FromSeconds(0)));
+    return std::make_unique<PageManager>(environment, std::move(storage),
+                                         nullptr, std::move(resolver));
+  }
+
+  Environment environment_;
+  TestPageStorage storage_;
+  std::unique_ptr<PageManager> page_manager_;
+  BranchTracker branch_tracker_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(BranchTrackerTest);
+};
+
+TEST_F(BranchTrackerTest, CoalesceCommitsWhileChangeInFlight) {
+  Status status = Status::UNKNOWN_ERROR;
+  branch_tracker_.Init(callback::Capture([] {}, &status));
+  ASSERT_EQ(Status::OK, status);
+
+  PageWatcherPtr watcher;
+  auto watcher_request = watcher.NewRequest();
+  branch_tracker_.RegisterPageWatcher(
+      std::move(watcher), std::make_unique<TestCommit>("base", ""), "");
+
+  // The first commit is sent right away.
+  AddCommit("commit1", "base");
+  EXPECT_EQ(1, storage_.diff_count);
+  EXPECT_EQ(0u, branch_tracker_.coalesced_commit_count());
+
+  // While it is in flight, the following commits replace each other.
+  AddCommit("commit2", "commit1");
+  AddCommit("commit3", "commit2");
+  AddCommit("commit4", "commit3");
+  EXPECT_EQ(1, storage_.diff_count);
+  EXPECT_EQ(2u, branch_tracker_.coalesced_commit_count());
+  EXPECT_EQ("commit4", branch_tracker_.GetBranchHeadId());
+}
+
+TEST_F(BranchTrackerTest, ResendChangeAfterErrorInPartialSequence) {
+  Status status = Status::UNKNOWN_ERROR;
+  branch_tracker_.Init(callback::Capture([] {}, &status));
+  ASSERT_EQ(Status::OK, status);
+
+  PageWatcherPtr watcher_ptr;
+  TestPageWatcher watcher(watcher_ptr.NewRequest(), [] {});
+  branch_tracker_.RegisterPageWatcher(
+      std::move(watcher_ptr), std::make_unique<TestCommit>("base", ""), "");
+
+  // The deletions with big keys fill the first page of the change, and the
+  // value of the update, on the second page, cannot be read.
+  for (size_t i = 0; i < 100; ++i) {
+    storage_.changes.push_back(MakeDeletion(
+        ftl::StringPrintf("a%03zu", i) + std::string(1000, 'x')));
+  }
+  storage_.changes.push_back(MakeUpdate("b"));
+  storage_.fail_get_object = true;
+
+  AddCommit("commit1", "base");
+  EXPECT_EQ(1, storage_.diff_count);
+  storage_.RunPendingDiffs();
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(100)));
+  ASSERT_EQ(1u, watcher.result_states.size());
+  EXPECT_EQ(ResultState::PARTIAL_STARTED, watcher.result_states[0]);
+
+  // The abandoned change is still pending: draining the watcher sends it
+  // again, as a new sequence.
+  storage_.fail_get_object = false;
+  bool drained = false;
+  branch_tracker_.StartTransaction([this, &drained] {
+    drained = true;
+    message_loop_.PostQuitTask();
+  });
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_TRUE(drained);
+  ASSERT_EQ(3u, watcher.result_states.size());
+  EXPECT_EQ(ResultState::PARTIAL_STARTED, watcher.result_states[1]);
+  EXPECT_EQ(ResultState::PARTIAL_COMPLETED, watcher.result_states[2]);
+}
+
+}  // namespace
+}  // namespace ledger
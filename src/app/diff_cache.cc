@@ -0,0 +1,80 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/diff_cache.h"
+
+#include <utility>
+
+namespace ledger {
+
+DiffCache::DiffCache(storage::PageStorage* storage)
+    : storage_(storage), weak_factory_(this) {}
+
+DiffCache::~DiffCache() {}
+
+void DiffCache::GetEntryChanges(
+    const storage::Commit& base,
+    const storage::Commit& other,
+    std::string prefix_key,
+    std::function<void(Status, ftl::RefPtr<diff_utils::EntryChanges>)>
+        callback) {
+  DiffKey key(base.GetId(), other.GetId(), prefix_key);
+  if (last_changes_ && key == last_key_) {
+    ++shared_diff_count_;
+    callback(Status::OK, last_changes_);
+    return;
+  }
+
+  auto it = pending_diffs_.find(key);
+  if (it != pending_diffs_.end()) {
+    ++shared_diff_count_;
+    it->second.callbacks.push_back(std::move(callback));
+    return;
+  }
+
+  ++computed_diff_count_;
+  PendingDiff& pending_diff = pending_diffs_[key];
+  // Keep the commits alive until the diff is computed.
+  pending_diff.base = base.Clone();
+  pending_diff.other = other.Clone();
+  pending_diff.callbacks.push_back(std::move(callback));
+  diff_utils::ComputeEntryChanges(
+      storage_, *pending_diff.base, *pending_diff.other, std::move(prefix_key),
+      [ weak_this = weak_factory_.GetWeakPtr(), key ](
+          Status status, ftl::RefPtr<diff_utils::EntryChanges> changes) {
+        if (weak_this) {
+          weak_this->OnDiffComputed(key, status, std::move(changes));
+        }
+      });
+}
+
+void DiffCache::SetBranchHead(const storage::CommitId& head_id) {
+  if (last_changes_ && std::get<1>(last_key_) != head_id) {
+    Clear();
+  }
+}
+
+void DiffCache::Clear() {
+  last_key_ = DiffKey();
+  last_changes_ = nullptr;
+}
+
+void DiffCache::OnDiffComputed(const DiffKey& key,
+                               Status status,
+                               ftl::RefPtr<diff_utils::EntryChanges> changes) {
+  auto it = pending_diffs_.find(key);
+  FTL_DCHECK(it != pending_diffs_.end());
+  auto callbacks = std::move(it->second.callbacks);
+  pending_diffs_.erase(it);
+
+  if (status == Status::OK) {
+    last_key_ = key;
+    last_changes_ = changes;
+  }
+  for (const auto& callback : callbacks) {
+    callback(status, changes);
+  }
+}
+
+}  // namespace ledger
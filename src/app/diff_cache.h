@@ -0,0 +1,89 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_APP_DIFF_CACHE_H_
+#define APPS_LEDGER_SRC_APP_DIFF_CACHE_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/app/diff_utils.h"
+#include "apps/ledger/src/storage/public/commit.h"
+#include "apps/ledger/src/storage/public/page_storage.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/weak_ptr.h"
+
+namespace ledger {
+
+// Computes the changes between pairs of commits, sharing a single diff
+// computation between all requests for the same commits and key prefix.
+// Requests received while a diff is being computed wait for its result, and
+// the most recently computed diff is kept to serve later requests until the
+// head of the branch moves on.
+class DiffCache {
+ public:
+  explicit DiffCache(storage::PageStorage* storage);
+  ~DiffCache();
+
+  // Retrieves the changes between |base| and |other| for the keys starting
+  // with |prefix_key|.
+  void GetEntryChanges(
+      const storage::Commit& base,
+      const storage::Commit& other,
+      std::string prefix_key,
+      std::function<void(Status, ftl::RefPtr<diff_utils::EntryChanges>)>
+          callback);
+
+  // Informs the cache that |head_id| is the new head of the branch. Diffs are
+  // only requested up to the head of the branch, so the kept diff is released
+  // if it leads to another commit.
+  void SetBranchHead(const storage::CommitId& head_id);
+
+  // Releases the kept diff.
+  void Clear();
+
+  // Returns the number of diffs actually computed.
+  uint64_t computed_diff_count() const { return computed_diff_count_; }
+
+  // Returns the number of requests served by a diff computed for another
+  // request.
+  uint64_t shared_diff_count() const { return shared_diff_count_; }
+
+ private:
+  // Base commit id, other commit id and key prefix.
+  using DiffKey = std::tuple<storage::CommitId, storage::CommitId, std::string>;
+
+  struct PendingDiff {
+    std::unique_ptr<const storage::Commit> base;
+    std::unique_ptr<const storage::Commit> other;
+    std::vector<
+        std::function<void(Status, ftl::RefPtr<diff_utils::EntryChanges>)>>
+        callbacks;
+  };
+
+  void OnDiffComputed(const DiffKey& key,
+                      Status status,
+                      ftl::RefPtr<diff_utils::EntryChanges> changes);
+
+  storage::PageStorage* const storage_;
+  std::map<DiffKey, PendingDiff> pending_diffs_;
+  DiffKey last_key_;
+  ftl::RefPtr<diff_utils::EntryChanges> last_changes_;
+  uint64_t computed_diff_count_ = 0u;
+  uint64_t shared_diff_count_ = 0u;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<DiffCache> weak_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(DiffCache);
+};
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_APP_DIFF_CACHE_H_
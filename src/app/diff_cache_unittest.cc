@@ -0,0 +1,187 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/diff_cache.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/storage/test/commit_empty_impl.h"
+#include "apps/ledger/src/storage/test/page_storage_empty_impl.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+
+namespace ledger {
+namespace {
+
+class TestCommit : public storage::test::CommitEmptyImpl {
+ public:
+  explicit TestCommit(storage::CommitId id) : id_(std::move(id)) {}
+  ~TestCommit() override = default;
+
+  std::unique_ptr<storage::Commit> Clone() const override {
+    return std::make_unique<TestCommit>(id_);
+  }
+
+  const storage::CommitId& GetId() const override { return id_; }
+
+ private:
+  storage::CommitId id_;
+};
+
+// PageStorage returning a fixed diff, whose computation only completes when
+// |RunPendingDiffs| is called.
+class DiffCountingPageStorage : public storage::test::PageStorageEmptyImpl {
+ public:
+  DiffCountingPageStorage() {}
+  ~DiffCountingPageStorage() override {}
+
+  void GetCommitContentsDiff(
+      const storage::Commit& /*base_commit*/,
+      const storage::Commit& /*other_commit*/,
+      std::string min_key,
+      std::function<bool(storage::EntryChange)> on_next_diff,
+      std::function<void(storage::Status)> on_done) override {
+    ++diff_count;
+    pending_diffs.push_back([
+      this, min_key = std::move(min_key),
+      on_next_diff = std::move(on_next_diff), on_done = std::move(on_done)
+    ] {
+      for (const auto& change : changes) {
+        if (change.entry.key < min_key) {
+          continue;
+        }
+        if (!on_next_diff(change)) {
+          break;
+        }
+      }
+      on_done(storage::Status::OK);
+    });
+  }
+
+  void RunPendingDiffs() {
+    std::vector<ftl::Closure> diffs = std::move(pending_diffs);
+    pending_diffs.clear();
+    for (const auto& diff : diffs) {
+      diff();
+    }
+  }
+
+  std::vector<storage::EntryChange> changes;
+  std::vector<ftl::Closure> pending_diffs;
+  int diff_count = 0;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(DiffCountingPageStorage);
+};
+
+storage::EntryChange MakeDeletion(std::string key) {
+  return storage::EntryChange{
+      storage::Entry{std::move(key), "", storage::KeyPriority::EAGER}, true};
+}
+
+class DiffCacheTest : public ::testing::Test {
+ public:
+  DiffCacheTest() : base_("base"), other_("other"), diff_cache_(&storage_) {
+    storage_.changes = {MakeDeletion("a1"), MakeDeletion("b1"),
+                        MakeDeletion("b2"), MakeDeletion("c1")};
+  }
+  ~DiffCacheTest() override {}
+
+ protected:
+  TestCommit base_;
+  TestCommit other_;
+  DiffCountingPageStorage storage_;
+  DiffCache diff_cache_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(DiffCacheTest);
+};
+
+TEST_F(DiffCacheTest, ConcurrentRequestsShareComputation) {
+  const size_t kRequestCount = 10;
+  std::vector<Status> statuses(kRequestCount, Status::UNKNOWN_ERROR);
+  std::vector<ftl::RefPtr<diff_utils::EntryChanges>> results(kRequestCount);
+  for (size_t i = 0; i < kRequestCount; ++i) {
+    diff_cache_.GetEntryChanges(
+        base_, other_, "",
+        callback::Capture([] {}, &statuses[i], &results[i]));
+  }
+  EXPECT_EQ(1, storage_.diff_count);
+
+  storage_.RunPendingDiffs();
+  for (size_t i = 0; i < kRequestCount; ++i) {
+    EXPECT_EQ(Status::OK, statuses[i]);
+    ASSERT_TRUE(results[i]);
+    EXPECT_EQ(results[0].get(), results[i].get());
+  }
+  EXPECT_EQ(4u, results[0]->changes().size());
+  EXPECT_EQ(1u, diff_cache_.computed_diff_count());
+  EXPECT_EQ(kRequestCount - 1, diff_cache_.shared_diff_count());
+}
+
+TEST_F(DiffCacheTest, LastDiffIsReused) {
+  Status status;
+  ftl::RefPtr<diff_utils::EntryChanges> first_result;
+  diff_cache_.GetEntryChanges(base_, other_, "",
+                              callback::Capture([] {}, &status, &first_result));
+  storage_.RunPendingDiffs();
+  EXPECT_EQ(Status::OK, status);
+
+  ftl::RefPtr<diff_utils::EntryChanges> second_result;
+  diff_cache_.GetEntryChanges(
+      base_, other_, "", callback::Capture([] {}, &status, &second_result));
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(first_result.get(), second_result.get());
+  EXPECT_EQ(1, storage_.diff_count);
+}
+
+TEST_F(DiffCacheTest, LastDiffIsReleasedWhenHeadMoves) {
+  Status status;
+  ftl::RefPtr<diff_utils::EntryChanges> result;
+  diff_cache_.GetEntryChanges(base_, other_, "",
+                              callback::Capture([] {}, &status, &result));
+  storage_.RunPendingDiffs();
+  EXPECT_EQ(Status::OK, status);
+  ASSERT_TRUE(result);
+  EXPECT_FALSE(result->HasOneRef());
+
+  // The diff leads to the head of the branch: it is kept.
+  diff_cache_.SetBranchHead(other_.GetId());
+  EXPECT_FALSE(result->HasOneRef());
+
+  diff_cache_.SetBranchHead("newer");
+  EXPECT_TRUE(result->HasOneRef());
+
+  diff_cache_.GetEntryChanges(base_, other_, "",
+                              callback::Capture([] {}, &status, &result));
+  EXPECT_EQ(2, storage_.diff_count);
+}
+
+TEST_F(DiffCacheTest, DifferentRequestsAreNotShared) {
+  TestCommit other_base("other_base");
+  Status status;
+  ftl::RefPtr<diff_utils::EntryChanges> result;
+  diff_cache_.GetEntryChanges(base_, other_, "",
+                              callback::Capture([] {}, &status, &result));
+  diff_cache_.GetEntryChanges(other_base, other_, "",
+                              callback::Capture([] {}, &status, &result));
+  diff_cache_.GetEntryChanges(base_, other_, "b",
+                              callback::Capture([] {}, &status, &result));
+  EXPECT_EQ(3, storage_.diff_count);
+  storage_.RunPendingDiffs();
+
+  EXPECT_EQ(Status::OK, status);
+  ASSERT_TRUE(result);
+  ASSERT_EQ(2u, result->changes().size());
+  EXPECT_EQ("b1", result->changes()[0].entry.key);
+  EXPECT_EQ("b2", result->changes()[1].entry.key);
+  EXPECT_EQ(0u, diff_cache_.shared_diff_count());
+}
+
+}  // namespace
+}  // namespace ledger
@@ -4,6 +4,7 @@
 
 #include "apps/ledger/src/app/diff_utils.h"
 
+#include <algorithm>
 #include <limits>
 #include <memory>
 #include <vector>
@@ -18,6 +19,11 @@
 namespace ledger {
 namespace diff_utils {
 
+EntryChanges::EntryChanges(std::vector<storage::EntryChange> changes)
+    : changes_(std::move(changes)) {}
+
+EntryChanges::~EntryChanges() {}
+
 void ComputePageChange(
     storage::PageStorage* storage,
     const storage::Commit& base,
@@ -141,5 +147,144 @@ void ComputePageChange(
                                  std::move(on_next), std::move(on_done));
 }
 
+void ComputeEntryChanges(
+    storage::PageStorage* storage,
+    const storage::Commit& base,
+    const storage::Commit& other,
+    std::string prefix_key,
+    std::function<void(Status, ftl::RefPtr<EntryChanges>)> callback) {
+  auto changes = std::make_unique<std::vector<storage::EntryChange>>();
+
+  // |on_next| is called for each change on the diff.
+  auto on_next = [ prefix_key, changes = changes.get() ](
+      storage::EntryChange change) {
+    if (!PageUtils::MatchesPrefix(change.entry.key, prefix_key)) {
+      return false;
+    }
+    changes->push_back(std::move(change));
+    return true;
+  };
+
+  // |on_done| is called when the full diff is computed.
+  auto on_done = ftl::MakeCopyable([
+    changes = std::move(changes), callback = std::move(callback)
+  ](storage::Status status) mutable {
+    if (status != storage::Status::OK) {
+      FTL_LOG(ERROR) << "Unable to compute diff: " << status;
+      callback(PageUtils::ConvertStatus(status), nullptr);
+      return;
+    }
+    callback(Status::OK, EntryChanges::Create(std::move(*changes)));
+  });
+  storage->GetCommitContentsDiff(base, other, std::move(prefix_key),
+                                 std::move(on_next), std::move(on_done));
+}
+
+namespace {
+
+// Returns the range of changes in |changes| whose key starts with
+// |prefix_key|. Changes are sorted by key, so these changes are contiguous.
+ChangeRange GetPrefixRange(const EntryChanges& changes,
+                           const std::string& prefix_key) {
+  const std::vector<storage::EntryChange>& entries = changes.changes();
+  auto begin = std::lower_bound(
+      entries.begin(), entries.end(), prefix_key,
+      [](const storage::EntryChange& change, const std::string& key) {
+        return change.entry.key < key;
+      });
+  auto end = begin;
+  while (end != entries.end() &&
+         PageUtils::MatchesPrefix(end->entry.key, prefix_key)) {
+    ++end;
+  }
+  return {static_cast<size_t>(begin - entries.begin()),
+          static_cast<size_t>(end - entries.begin())};
+}
+
+}  // namespace
+
+std::vector<ChangeRange> PaginateEntryChanges(const EntryChanges& changes,
+                                              const std::string& prefix_key) {
+  const std::vector<storage::EntryChange>& entries = changes.changes();
+  ChangeRange prefix_range = GetPrefixRange(changes, prefix_key);
+  std::vector<ChangeRange> ranges;
+
+  // These are initialized to valid values in the first run of the loop.
+  size_t fidl_size = -1;
+  size_t handle_count = -1;
+  for (size_t i = prefix_range.begin; i < prefix_range.end; ++i) {
+    const storage::EntryChange& change = entries[i];
+    size_t entry_size =
+        change.deleted
+            ? fidl_serialization::GetByteArraySize(change.entry.key.size())
+            : fidl_serialization::GetEntrySize(change.entry.key.size());
+    size_t entry_handle_count = change.deleted ? 0 : 1;
+    if (ranges.empty() ||
+        fidl_size + entry_size > fidl_serialization::kMaxInlineDataSize ||
+        handle_count + entry_handle_count >
+            fidl_serialization::kMaxMessageHandles) {
+      ranges.push_back({i, i});
+      fidl_size = fidl_serialization::kPageChangeHeaderSize;
+      handle_count = 0u;
+    }
+    fidl_size += entry_size;
+    handle_count += entry_handle_count;
+    ranges.back().end = i + 1;
+  }
+  return ranges;
+}
+
+void ComputePageChangeForRange(
+    storage::PageStorage* storage,
+    int64_t timestamp,
+    ftl::RefPtr<EntryChanges> changes,
+    ChangeRange range,
+    std::function<void(Status, PageChangePtr)> callback) {
+  const std::vector<storage::EntryChange>& entries = changes->changes();
+  FTL_DCHECK(range.begin <= range.end && range.end <= entries.size());
+
+  PageChangePtr page_change = PageChange::New();
+  page_change->timestamp = timestamp;
+  page_change->changes = fidl::Array<EntryPtr>::New(0);
+  page_change->deleted_keys = fidl::Array<fidl::Array<uint8_t>>::New(0);
+
+  auto waiter = callback::Waiter<Status, mx::vmo>::Create(Status::OK);
+  for (size_t i = range.begin; i < range.end; ++i) {
+    const storage::EntryChange& change = entries[i];
+    if (change.deleted) {
+      page_change->deleted_keys.push_back(convert::ToArray(change.entry.key));
+      continue;
+    }
+    EntryPtr entry = Entry::New();
+    entry->key = convert::ToArray(change.entry.key);
+    entry->priority = change.entry.priority == storage::KeyPriority::EAGER
+                          ? Priority::EAGER
+                          : Priority::LAZY;
+    page_change->changes.push_back(std::move(entry));
+    PageUtils::GetPartialReferenceAsBuffer(
+        storage, change.entry.object_id, 0u,
+        std::numeric_limits<int64_t>::max(),
+        storage::PageStorage::Location::LOCAL, Status::OK,
+        waiter->NewCallback());
+  }
+
+  waiter->Finalize(ftl::MakeCopyable([
+    page_change = std::move(page_change), callback = std::move(callback)
+  ](Status status, std::vector<mx::vmo> results) mutable {
+    if (status != Status::OK) {
+      FTL_LOG(ERROR)
+          << "Error while reading changed values when computing PageChange: "
+          << status;
+      callback(status, nullptr);
+      return;
+    }
+    FTL_DCHECK(results.size() == page_change->changes.size());
+    for (size_t i = 0; i < results.size(); i++) {
+      page_change->changes[i]->value = std::move(results[i]);
+    }
+    callback(Status::OK, std::move(page_change));
+  }));
+}
+
 }  // namespace diff_utils
 }  // namespace ledger
@@ -6,10 +6,12 @@
 #define APPS_LEDGER_SRC_APP_DIFF_UTILS_H_
 
 #include <functional>
+#include <vector>
 
 #include "apps/ledger/services/public/ledger.fidl.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
 
 namespace ledger {
 namespace diff_utils {
@@ -39,6 +41,61 @@ void ComputePageChange(
     std::function<void(Status, std::pair<PageChangePtr, std::string>)>
         callback);
 
+// Immutable list of changes between two commits, sorted by key. Computing a
+// diff requires iterating over the trees of both commits, so the list is
+// ref-counted to be shared between all the consumers of the same diff.
+class EntryChanges : public ftl::RefCountedThreadSafe<EntryChanges> {
+ public:
+  inline static ftl::RefPtr<EntryChanges> Create(
+      std::vector<storage::EntryChange> changes) {
+    return AdoptRef(new EntryChanges(std::move(changes)));
+  }
+
+  const std::vector<storage::EntryChange>& changes() const { return changes_; }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(EntryChanges);
+  explicit EntryChanges(std::vector<storage::EntryChange> changes);
+  ~EntryChanges();
+
+  const std::vector<storage::EntryChange> changes_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(EntryChanges);
+};
+
+// Asynchronously computes the list of changes between the two provided
+// commits, for the keys starting with |prefix_key|. Values are not read: the
+// result only contains the object ids of the changed entries.
+void ComputeEntryChanges(
+    storage::PageStorage* storage,
+    const storage::Commit& base,
+    const storage::Commit& other,
+    std::string prefix_key,
+    std::function<void(Status, ftl::RefPtr<EntryChanges>)> callback);
+
+// Range [begin, end) of indices in the list of changes of an |EntryChanges|.
+struct ChangeRange {
+  size_t begin;
+  size_t end;
+};
+
+// Splits the changes of |changes| whose key starts with |prefix_key| into
+// consecutive ranges, each of which fits in a single PageChange FIDL message.
+// Only key sizes are needed for this, so no value is read. Returns an empty
+// vector if no change matches |prefix_key|.
+std::vector<ChangeRange> PaginateEntryChanges(const EntryChanges& changes,
+                                              const std::string& prefix_key);
+
+// Asynchronously creates a PageChange from the changes of |changes| in
+// |range|, reading the values of the changed entries from |storage|.
+// |timestamp| is used as the timestamp of the PageChange.
+void ComputePageChangeForRange(
+    storage::PageStorage* storage,
+    int64_t timestamp,
+    ftl::RefPtr<EntryChanges> changes,
+    ChangeRange range,
+    std::function<void(Status, PageChangePtr)> callback);
+
 }  // namespace diff_utils
 }  // namespace ledger
 
@@ -0,0 +1,113 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/diff_utils.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "apps/ledger/src/app/fidl/serialization_size.h"
+#include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/storage/test/page_storage_empty_impl.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/strings/string_printf.h"
+
+namespace ledger {
+namespace {
+
+storage::EntryChange MakeDeletion(std::string key) {
+  return storage::EntryChange{
+      storage::Entry{std::move(key), "", storage::KeyPriority::EAGER}, true};
+}
+
+storage::EntryChange MakeUpdate(std::string key) {
+  return storage::EntryChange{
+      storage::Entry{std::move(key), "object_id", storage::KeyPriority::EAGER},
+      false};
+}
+
+TEST(DiffUtilsTest, PaginateEntryChanges) {
+  std::vector<storage::EntryChange> changes;
+  // Deletions with big keys exceed the size of a message, and updates exceed
+  // the number of handles of a message.
+  for (size_t i = 0; i < 200; ++i) {
+    changes.push_back(MakeDeletion(
+        ftl::StringPrintf("a%03zu", i) + std::string(1000, 'x')));
+  }
+  for (size_t i = 0; i < 2 * fidl_serialization::kMaxMessageHandles; ++i) {
+    changes.push_back(MakeUpdate(ftl::StringPrintf("b%03zu", i)));
+  }
+  auto entry_changes = diff_utils::EntryChanges::Create(std::move(changes));
+
+  std::vector<diff_utils::ChangeRange> pages =
+      diff_utils::PaginateEntryChanges(*entry_changes, "");
+  ASSERT_GT(pages.size(), 3u);
+  size_t next_begin = 0u;
+  for (const auto& page : pages) {
+    EXPECT_EQ(next_begin, page.begin);
+    EXPECT_LT(page.begin, page.end);
+    size_t fidl_size = fidl_serialization::kPageChangeHeaderSize;
+    size_t handle_count = 0u;
+    for (size_t i = page.begin; i < page.end; ++i) {
+      const storage::EntryChange& change = entry_changes->changes()[i];
+      if (change.deleted) {
+        fidl_size +=
+            fidl_serialization::GetByteArraySize(change.entry.key.size());
+      } else {
+        fidl_size += fidl_serialization::GetEntrySize(change.entry.key.size());
+        ++handle_count;
+      }
+    }
+    EXPECT_LE(fidl_size, fidl_serialization::kMaxInlineDataSize);
+    EXPECT_LE(handle_count, fidl_serialization::kMaxMessageHandles);
+    next_begin = page.end;
+  }
+  EXPECT_EQ(entry_changes->changes().size(), next_begin);
+
+  // Only changes matching the prefix are paginated.
+  pages = diff_utils::PaginateEntryChanges(*entry_changes, "b");
+  ASSERT_EQ(2u, pages.size());
+  EXPECT_EQ(200u, pages[0].begin);
+  EXPECT_EQ(entry_changes->changes().size(), pages[1].end);
+
+  EXPECT_TRUE(diff_utils::PaginateEntryChanges(*entry_changes, "c").empty());
+}
+
+TEST(DiffUtilsTest, ComputePageChangeForRange) {
+  storage::test::PageStorageEmptyImpl storage;
+  auto entry_changes = diff_utils::EntryChanges::Create(
+      {MakeDeletion("a1"), MakeDeletion("b1"), MakeDeletion("b2"),
+       MakeDeletion("c1")});
+
+  std::vector<diff_utils::ChangeRange> pages =
+      diff_utils::PaginateEntryChanges(*entry_changes, "b");
+  ASSERT_EQ(1u, pages.size());
+
+  Status status;
+  PageChangePtr page_change;
+  diff_utils::ComputePageChangeForRange(
+      &storage, 42, entry_changes, pages[0],
+      callback::Capture([] {}, &status, &page_change));
+  EXPECT_EQ(Status::OK, status);
+  ASSERT_TRUE(page_change);
+  EXPECT_EQ(42, page_change->timestamp);
+  EXPECT_EQ(0u, page_change->changes.size());
+  ASSERT_EQ(2u, page_change->deleted_keys.size());
+  EXPECT_EQ("b1", convert::ToString(page_change->deleted_keys[0]));
+  EXPECT_EQ("b2", convert::ToString(page_change->deleted_keys[1]));
+
+  // An empty range gives an empty change.
+  diff_utils::ComputePageChangeForRange(
+      &storage, 42, entry_changes, diff_utils::ChangeRange{4u, 4u},
+      callback::Capture([] {}, &status, &page_change));
+  EXPECT_EQ(Status::OK, status);
+  ASSERT_TRUE(page_change);
+  EXPECT_EQ(0u, page_change->changes.size());
+  EXPECT_EQ(0u, page_change->deleted_keys.size());
+}
+
+}  // namespace
+}  // namespace ledger
@@ -12,6 +12,7 @@
 #include "apps/ledger/src/app/page_utils.h"
 #include "apps/ledger/src/glue/crypto/rand.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/fidl/cpp/bindings/interface_request.h"
 #include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/logging.h"
@@ -29,12 +30,23 @@ class LedgerManager::PageManagerContainer {
     }
   }
 
+  // Sets the callback called when the container is done, without having a
+  // PageManager.
   void set_on_empty(const ftl::Closure& on_empty_callback) {
     on_empty_callback_ = on_empty_callback;
+  };
+
+  // Sets the callback called when the PageManager has no more local clients
+  // nor pending operations. The container is not deleted by itself then.
+  void set_on_page_idle(const ftl::Closure& on_page_idle_callback) {
+    on_page_idle_callback_ = on_page_idle_callback;
     if (page_manager_) {
-      page_manager_->set_on_empty(on_empty_callback);
+      page_manager_->set_on_empty(on_page_idle_callback_);
     }
-  };
+  }
+
+  // Returns the PageManager, or nullptr if it is not available yet.
+  PageManager* page_manager() { return page_manager_.get(); }
 
   // Keeps track of |page| and |callback|. Binds |page| and fires |callback|
   // when a PageManager is available or an error occurs.
@@ -68,12 +80,12 @@ class LedgerManager::PageManagerContainer {
       }
     }
     requests_.clear();
-    if (on_empty_callback_) {
-      if (page_manager_) {
-        page_manager_->set_on_empty(on_empty_callback_);
-      } else {
-        on_empty_callback_();
+    if (page_manager_) {
+      if (on_page_idle_callback_) {
+        page_manager_->set_on_empty(on_page_idle_callback_);
       }
+    } else if (on_empty_callback_) {
+      on_empty_callback_();
     }
   }
 
@@ -84,18 +96,36 @@ class LedgerManager::PageManagerContainer {
       std::pair<fidl::InterfaceRequest<Page>, std::function<void(Status)>>>
       requests_;
   ftl::Closure on_empty_callback_;
+  ftl::Closure on_page_idle_callback_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(PageManagerContainer);
 };
 
+// Storage and sync of a page that no client is connected to.
+struct LedgerManager::BackgroundPageSync {
+  std::unique_ptr<storage::PageStorage> page_storage;
+  // Must be deleted before |page_storage|.
+  std::unique_ptr<cloud_sync::PageSyncContext> page_sync_context;
+  // Set to true once the sync downloaded the backlog of remote commits. The
+  // storage is then kept up to date by the remote watcher.
+  bool backlog_downloaded = false;
+};
+
 LedgerManager::LedgerManager(Environment* environment,
                              std::unique_ptr<storage::LedgerStorage> storage,
-                             std::unique_ptr<cloud_sync::LedgerSync> sync)
+                             std::unique_ptr<cloud_sync::LedgerSync> sync,
+                             size_t max_idle_pages,
+                             uint64_t max_idle_pages_memory,
+                             ftl::TimeDelta idle_page_timeout)
     : environment_(environment),
+      max_idle_pages_(max_idle_pages),
+      max_idle_pages_memory_(max_idle_pages_memory),
+      idle_page_timeout_(idle_page_timeout),
       storage_(std::move(storage)),
       sync_(std::move(sync)),
       ledger_impl_(this),
-      merge_manager_(environment_) {}
+      merge_manager_(environment_),
+      weak_factory_(this) {}
 
 LedgerManager::~LedgerManager() {}
 
@@ -109,6 +139,7 @@ void LedgerManager::GetPage(convert::ExtendedStringView page_id,
   // If we have the page manager ready, just ask for a new page impl.
   auto it = page_managers_.find(page_id);
   if (it != page_managers_.end()) {
+    RemoveIdlePage(page_id);
     it->second.BindPage(std::move(page_request), std::move(callback));
     return;
   }
@@ -116,6 +147,22 @@ void LedgerManager::GetPage(convert::ExtendedStringView page_id,
   PageManagerContainer* container = AddPageManagerContainer(page_id);
   container->BindPage(std::move(page_request), std::move(callback));
 
+  // If the page was synced in the background, its storage is already open.
+  // Once the background sync caught up, the page is bound right away instead
+  // of waiting for the new sync to be scheduled and download the backlog.
+  bool up_to_date = false;
+  std::unique_ptr<storage::PageStorage> page_storage =
+      StopBackgroundSync(page_id, &up_to_date);
+  if (page_storage) {
+    container->SetPageManager(
+        Status::OK,
+        NewPageManager(std::move(page_storage),
+                       up_to_date
+                           ? PageManager::PageStorageState::UP_TO_DATE
+                           : PageManager::PageStorageState::NEEDS_SYNC));
+    return;
+  }
+
   storage_->GetPageStorage(
       page_id.ToString(),
       [ this, page_id = page_id.ToString(), container ](
@@ -143,8 +190,10 @@ void LedgerManager::GetPage(convert::ExtendedStringView page_id,
 Status LedgerManager::DeletePage(convert::ExtendedStringView page_id) {
   auto it = page_managers_.find(page_id);
   if (it != page_managers_.end()) {
+    RemoveIdlePage(page_id);
     page_managers_.erase(it);
   }
+  StopBackgroundSync(page_id);
 
   if (storage_->DeletePageStorage(page_id)) {
     return Status::OK;
@@ -173,11 +222,15 @@ LedgerManager::PageManagerContainer* LedgerManager::AddPageManagerContainer(
                                     std::forward_as_tuple(page_id.ToString()),
                                     std::forward_as_tuple());
   FTL_DCHECK(ret.second);
-  return &ret.first->second;
+  PageManagerContainer* container = &ret.first->second;
+  container->set_on_page_idle(
+      [ this, page_id = page_id.ToString() ] { OnPageIdle(page_id); });
+  return container;
 }
 
 std::unique_ptr<PageManager> LedgerManager::NewPageManager(
-    std::unique_ptr<storage::PageStorage> page_storage) {
+    std::unique_ptr<storage::PageStorage> page_storage,
+    PageManager::PageStorageState page_storage_state) {
   std::unique_ptr<cloud_sync::PageSyncContext> page_sync_context;
   if (sync_) {
     page_sync_context = sync_->CreatePageContext(page_storage.get(), [] {
@@ -187,7 +240,114 @@ std::unique_ptr<PageManager> LedgerManager::NewPageManager(
   }
   return std::make_unique<PageManager>(
       environment_, std::move(page_storage), std::move(page_sync_context),
-      merge_manager_.GetMergeResolver(page_storage.get()));
+      merge_manager_.GetMergeResolver(page_storage.get()), page_storage_state);
+}
+
+void LedgerManager::OnPageIdle(storage::PageIdView page_id) {
+  for (const IdlePage& idle_page : idle_pages_) {
+    if (convert::ExtendedStringView(idle_page.page_id) == page_id) {
+      // The page was already idle, and its sync got back to idle.
+      return;
+    }
+  }
+  idle_pages_.push_front({page_id.ToString(), ftl::TimePoint::Now()});
+  environment_->main_runner()->PostDelayedTask(
+      [weak_this = weak_factory_.GetWeakPtr()] {
+        if (weak_this) {
+          weak_this->EvictIdlePages();
+        }
+      },
+      idle_page_timeout_);
+  EvictIdlePages();
+}
+
+void LedgerManager::RemoveIdlePage(storage::PageIdView page_id) {
+  for (auto it = idle_pages_.begin(); it != idle_pages_.end(); ++it) {
+    if (convert::ExtendedStringView(it->page_id) == page_id) {
+      idle_pages_.erase(it);
+      return;
+    }
+  }
+}
+
+void LedgerManager::EvictIdlePages() {
+  ftl::TimePoint now = ftl::TimePoint::Now();
+  size_t count = 0u;
+  uint64_t memory = 0u;
+  auto it = idle_pages_.begin();
+  while (it != idle_pages_.end()) {
+    auto page_manager_it = page_managers_.find(it->page_id);
+    FTL_DCHECK(page_manager_it != page_managers_.end());
+    uint64_t page_memory =
+        page_manager_it->second.page_manager()->GetApproximateMemoryUsage();
+    if (count < max_idle_pages_ &&
+        memory + page_memory <= max_idle_pages_memory_ &&
+        now - it->idle_since < idle_page_timeout_) {
+      ++count;
+      memory += page_memory;
+      ++it;
+      continue;
+    }
+    storage::PageId page_id = std::move(it->page_id);
+    it = idle_pages_.erase(it);
+    ClosePage(page_id);
+  }
+  TRACE_COUNTER("ledger", "idle_pages", reinterpret_cast<uintptr_t>(this),
+                "count", static_cast<uint64_t>(count), "memory", memory);
+}
+
+void LedgerManager::ClosePage(storage::PageIdView page_id) {
+  auto it = page_managers_.find(page_id);
+  FTL_DCHECK(it != page_managers_.end());
+  if (sync_ && sync_->GetMaxBackgroundSyncedPages() > 0) {
+    // The background sync must start after the sync of the PageManager stops,
+    // and before the PageManager is deleted, as it uses the page storage.
+    StartBackgroundSync(it->second.page_manager()->ReleasePageStorage());
+  }
+  page_managers_.erase(it);
+}
+
+void LedgerManager::StartBackgroundSync(
+    std::unique_ptr<storage::PageStorage> page_storage) {
+  FTL_DCHECK(sync_);
+  auto background_sync = std::make_unique<BackgroundPageSync>();
+  background_sync->page_sync_context = sync_->CreateBackgroundPageContext(
+      page_storage.get(), [] {
+        FTL_LOG(ERROR) << "Background page sync stopped due to unrecoverable "
+                       << "error.";
+      });
+  if (background_sync->page_sync_context) {
+    BackgroundPageSync* background_sync_ptr = background_sync.get();
+    background_sync->page_sync_context->page_sync->SetOnBacklogDownloaded(
+        [background_sync_ptr] {
+          background_sync_ptr->backlog_downloaded = true;
+        });
+    background_sync->page_sync_context->page_sync->Start();
+  }
+  background_sync->page_storage = std::move(page_storage);
+  background_syncs_.push_front(std::move(background_sync));
+
+  while (background_syncs_.size() > sync_->GetMaxBackgroundSyncedPages()) {
+    background_syncs_.pop_back();
+  }
+}
+
+std::unique_ptr<storage::PageStorage> LedgerManager::StopBackgroundSync(
+    storage::PageIdView page_id,
+    bool* up_to_date) {
+  for (auto it = background_syncs_.begin(); it != background_syncs_.end();
+       ++it) {
+    if (convert::ExtendedStringView((*it)->page_storage->GetId()) == page_id) {
+      std::unique_ptr<storage::PageStorage> page_storage =
+          std::move((*it)->page_storage);
+      if (up_to_date) {
+        *up_to_date = (*it)->backlog_downloaded;
+      }
+      background_syncs_.erase(it);
+      return page_storage;
+    }
+  }
+  return nullptr;
 }
 
 void LedgerManager::CheckEmpty() {
@@ -6,19 +6,24 @@
 #define APPS_LEDGER_SRC_APP_LEDGER_MANAGER_H_
 
 #include <functional>
+#include <list>
 #include <map>
 #include <memory>
 #include <type_traits>
 
 #include "apps/ledger/src/app/ledger_impl.h"
 #include "apps/ledger/src/app/merging/ledger_merge_manager.h"
+#include "apps/ledger/src/app/page_manager.h"
 #include "apps/ledger/src/callback/auto_cleanable.h"
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/ledger/src/environment/environment.h"
 #include "apps/ledger/src/storage/public/types.h"
 #include "lib/fidl/cpp/bindings/binding_set.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/memory/weak_ptr.h"
 #include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ledger {
 
@@ -28,11 +33,25 @@ namespace ledger {
 // LedgerManager owns all per-ledger-instance objects: LedgerStorage and a FIDL
 // LedgerImpl. It is safe to delete it at any point - this closes all channels,
 // deletes the LedgerImpl and tears down the storage.
+//
+// Once the last client disconnects from a page, its PageManager is kept idle,
+// so that reopening the page does not open its storage again. At most
+// |max_idle_pages| pages, holding at most |max_idle_pages_memory| bytes, are
+// kept idle, each for at most |idle_page_timeout|, the least recently used ones
+// being closed first.
+//
+// Once closed, the page keeps syncing in the background, so that it is up to
+// date if it is reopened. This is done for the most recently closed pages only,
+// up to the limit given by LedgerSync.
 class LedgerManager : public LedgerImpl::Delegate {
  public:
-  LedgerManager(Environment* environment,
-                std::unique_ptr<storage::LedgerStorage> storage,
-                std::unique_ptr<cloud_sync::LedgerSync> sync);
+  LedgerManager(
+      Environment* environment,
+      std::unique_ptr<storage::LedgerStorage> storage,
+      std::unique_ptr<cloud_sync::LedgerSync> sync,
+      size_t max_idle_pages = 5,
+      uint64_t max_idle_pages_memory = 32 * 1024 * 1024,
+      ftl::TimeDelta idle_page_timeout = ftl::TimeDelta::FromSeconds(60));
   ~LedgerManager();
 
   // Creates a new proxy for the LedgerImpl managed by this LedgerManager.
@@ -52,6 +71,13 @@ class LedgerManager : public LedgerImpl::Delegate {
 
  private:
   class PageManagerContainer;
+  struct BackgroundPageSync;
+
+  // Page kept open while no client is connected to it.
+  struct IdlePage {
+    storage::PageId page_id;
+    ftl::TimePoint idle_since;
+  };
 
   // Creates a page storage for the given |page_id| and completes the
   // PageManagerContainer.
@@ -59,16 +85,44 @@ class LedgerManager : public LedgerImpl::Delegate {
                          PageManagerContainer* container);
 
   // Adds a new PageManagerContainer for |page_id| and configures it so that it
-  // is automatically deleted from |page_managers_| when the last local client
-  // disconnects from the page. Returns the container.
+  // is kept idle when the last local client disconnects from the page. Returns
+  // the container.
   PageManagerContainer* AddPageManagerContainer(storage::PageIdView page_id);
   // Creates a new page manager for the given storage.
   std::unique_ptr<PageManager> NewPageManager(
-      std::unique_ptr<storage::PageStorage> page_storage);
+      std::unique_ptr<storage::PageStorage> page_storage,
+      PageManager::PageStorageState page_storage_state =
+          PageManager::PageStorageState::NEEDS_SYNC);
+
+  // Keeps the page of the given |page_id| open after the last local client
+  // disconnected from it, and closes the idle pages beyond the limits.
+  void OnPageIdle(storage::PageIdView page_id);
+  // Removes the page of the given |page_id| from |idle_pages_|, if present.
+  void RemoveIdlePage(storage::PageIdView page_id);
+  // Closes the idle pages that are beyond the limits or past their timeout.
+  void EvictIdlePages();
+  // Deletes the PageManager of the given |page_id|, and keeps the page syncing
+  // in the background if possible.
+  void ClosePage(storage::PageIdView page_id);
+
+  // Keeps |page_storage| syncing in the background after its page is closed,
+  // stopping the background sync of the least recently closed page if there
+  // are too many.
+  void StartBackgroundSync(std::unique_ptr<storage::PageStorage> page_storage);
+  // Stops the background sync of the page of the given |page_id| and returns
+  // its storage, or returns nullptr if the page is not synced in the
+  // background. |up_to_date| is set to whether the background sync caught up
+  // with the cloud.
+  std::unique_ptr<storage::PageStorage> StopBackgroundSync(
+      storage::PageIdView page_id,
+      bool* up_to_date = nullptr);
 
   void CheckEmpty();
 
   Environment* const environment_;
+  const size_t max_idle_pages_;
+  const uint64_t max_idle_pages_memory_;
+  const ftl::TimeDelta idle_page_timeout_;
   std::unique_ptr<storage::LedgerStorage> storage_;
   std::unique_ptr<cloud_sync::LedgerSync> sync_;
   LedgerImpl ledger_impl_;
@@ -82,8 +136,17 @@ class LedgerManager : public LedgerImpl::Delegate {
                              PageManagerContainer,
                              convert::StringViewComparator>
       page_managers_;
+  // Pages of |page_managers_| that no client is connected to, most recently
+  // used first.
+  std::list<IdlePage> idle_pages_;
+  // Background syncs of the closed pages, most recently closed first. They
+  // must be deleted before |sync_|.
+  std::list<std::unique_ptr<BackgroundPageSync>> background_syncs_;
   ftl::Closure on_empty_callback_;
 
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<LedgerManager> weak_factory_;
+
   FTL_DISALLOW_COPY_AND_ASSIGN(LedgerManager);
 };
 
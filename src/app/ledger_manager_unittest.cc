@@ -10,6 +10,7 @@
 
 #include "apps/ledger/src/app/constants.h"
 #include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/cloud_sync/test/page_sync_empty_impl.h"
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/ledger/src/coroutine/coroutine_impl.h"
 #include "apps/ledger/src/glue/crypto/rand.h"
@@ -54,9 +55,10 @@ class FakeLedgerStorage : public storage::LedgerStorage {
       if (should_get_page_fail) {
         callback(storage::Status::NOT_FOUND, nullptr);
       } else {
-        callback(storage::Status::OK,
-                 std::make_unique<storage::fake::FakePageStorage>(
-                     std::move(page_id)));
+        auto page_storage =
+            std::make_unique<storage::fake::FakePageStorage>(page_id);
+        page_storage->set_approximate_memory_usage(page_memory_usage);
+        callback(storage::Status::OK, std::move(page_storage));
       }
     });
   }
@@ -73,6 +75,7 @@ class FakeLedgerStorage : public storage::LedgerStorage {
   }
 
   bool should_get_page_fail = false;
+  uint64_t page_memory_usage = 0u;
   std::vector<storage::PageId> create_page_calls;
   std::vector<storage::PageId> get_page_calls;
   std::vector<storage::PageId> delete_page_calls;
@@ -83,6 +86,33 @@ class FakeLedgerStorage : public storage::LedgerStorage {
   FTL_DISALLOW_COPY_AND_ASSIGN(FakeLedgerStorage);
 };
 
+// Page sync that is always idle, and that downloads the backlog of remote
+// commits on start if |catch_up| is set.
+class FakePageSync : public cloud_sync::test::PageSyncEmptyImpl {
+ public:
+  explicit FakePageSync(bool catch_up) : catch_up_(catch_up) {}
+
+  void Start() override {
+    if (catch_up_ && on_backlog_downloaded_) {
+      on_backlog_downloaded_();
+    }
+  }
+
+  void SetOnIdle(ftl::Closure /*on_idle*/) override {}
+
+  bool IsIdle() override { return true; }
+
+  void SetOnBacklogDownloaded(ftl::Closure on_backlog_downloaded) override {
+    on_backlog_downloaded_ = std::move(on_backlog_downloaded);
+  }
+
+  void SetSyncWatcher(cloud_sync::SyncStateWatcher* /*watcher*/) override {}
+
+ private:
+  const bool catch_up_;
+  ftl::Closure on_backlog_downloaded_;
+};
+
 class FakeLedgerSync : public cloud_sync::LedgerSync {
  public:
   explicit FakeLedgerSync(ftl::RefPtr<ftl::TaskRunner> task_runner)
@@ -92,12 +122,39 @@ class FakeLedgerSync : public cloud_sync::LedgerSync {
   std::unique_ptr<cloud_sync::PageSyncContext> CreatePageContext(
       storage::PageStorage* /*page_storage*/,
       ftl::Closure /*error_callback*/) override {
-    return nullptr;
+    return NewPageSyncContext();
+  }
+
+  std::unique_ptr<cloud_sync::PageSyncContext> CreateBackgroundPageContext(
+      storage::PageStorage* page_storage,
+      ftl::Closure /*error_callback*/) override {
+    background_synced_pages.push_back(page_storage->GetId());
+    return NewPageSyncContext();
+  }
+
+  size_t GetMaxBackgroundSyncedPages() override {
+    return max_background_synced_pages;
   }
 
   bool called;
+  size_t max_background_synced_pages = 0u;
+  std::vector<storage::PageId> background_synced_pages;
+  // If set, pages are synced with a FakePageSync, which downloads the backlog
+  // of remote commits if |page_syncs_catch_up| is set.
+  bool create_page_syncs = false;
+  bool page_syncs_catch_up = true;
 
  private:
+  std::unique_ptr<cloud_sync::PageSyncContext> NewPageSyncContext() {
+    if (!create_page_syncs) {
+      return nullptr;
+    }
+    auto page_sync_context = std::make_unique<cloud_sync::PageSyncContext>();
+    page_sync_context->page_sync =
+        std::make_unique<FakePageSync>(page_syncs_catch_up);
+    return page_sync_context;
+  }
+
   ftl::RefPtr<ftl::TaskRunner> task_runner_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(FakeLedgerSync);
@@ -122,6 +179,22 @@ class LedgerManagerTest : public test::TestWithMessageLoop {
   }
 
  protected:
+  // Replaces the LedgerManager with one using the given limits on idle pages.
+  void ResetLedgerManager(size_t max_idle_pages,
+                          uint64_t max_idle_pages_memory,
+                          ftl::TimeDelta idle_page_timeout) {
+    std::unique_ptr<FakeLedgerStorage> storage =
+        std::make_unique<FakeLedgerStorage>(message_loop_.task_runner());
+    storage_ptr = storage.get();
+    std::unique_ptr<FakeLedgerSync> sync =
+        std::make_unique<FakeLedgerSync>(message_loop_.task_runner());
+    sync_ptr = sync.get();
+    ledger_manager_ = std::make_unique<LedgerManager>(
+        &environment_, std::move(storage), std::move(sync), max_idle_pages,
+        max_idle_pages_memory, idle_page_timeout);
+    ledger_manager_->BindLedger(ledger.NewRequest());
+  }
+
   ledger::Environment environment_;
   FakeLedgerStorage* storage_ptr;
   FakeLedgerSync* sync_ptr;
@@ -254,5 +327,151 @@ TEST_F(LedgerManagerTest, GetPageDoNotCallTheCloud) {
   EXPECT_FALSE(sync_ptr->called);
 }
 
+// Verifies that the most recently closed pages are synced in the background,
+// and that their storage is reused when they are reopened.
+TEST_F(LedgerManagerTest, BackgroundSyncOfClosedPages) {
+  ResetLedgerManager(0u, 0u, ftl::TimeDelta::Zero());
+  sync_ptr->max_background_synced_pages = 1u;
+  storage::PageId id1 = RandomId();
+  storage::PageId id2 = RandomId();
+
+  PagePtr page;
+  ledger->GetPage(convert::ToArray(id1), page.NewRequest(),
+                  [this](Status) { message_loop_.PostQuitTask(); });
+  EXPECT_FALSE(RunLoopWithTimeout());
+  page.reset();
+  EXPECT_TRUE(RunLoopUntil(
+      [this] { return sync_ptr->background_synced_pages.size() == 1u; }));
+  EXPECT_EQ(id1, sync_ptr->background_synced_pages[0]);
+
+  // Reopening the page does not reopen its storage.
+  storage_ptr->ClearCalls();
+  Status status;
+  ledger->GetPage(convert::ToArray(id1), page.NewRequest(),
+                  callback::Capture(MakeQuitTask(), &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(0u, storage_ptr->get_page_calls.size());
+  page.reset();
+  EXPECT_TRUE(RunLoopUntil(
+      [this] { return sync_ptr->background_synced_pages.size() == 2u; }));
+
+  // Closing another page stops the background sync of the first one.
+  ledger->GetPage(convert::ToArray(id2), page.NewRequest(),
+                  [this](Status) { message_loop_.PostQuitTask(); });
+  EXPECT_FALSE(RunLoopWithTimeout());
+  page.reset();
+  EXPECT_TRUE(RunLoopUntil(
+      [this] { return sync_ptr->background_synced_pages.size() == 3u; }));
+  EXPECT_EQ(id2, sync_ptr->background_synced_pages[2]);
+
+  storage_ptr->ClearCalls();
+  ledger->GetPage(convert::ToArray(id1), page.NewRequest(),
+                  callback::Capture(MakeQuitTask(), &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  ASSERT_EQ(1u, storage_ptr->get_page_calls.size());
+  EXPECT_EQ(id1, storage_ptr->get_page_calls[0]);
+}
+
+// Verifies that reopening a page that caught up with the cloud in the
+// background does not wait for the sync of the page to catch up again.
+TEST_F(LedgerManagerTest, ReopenBackgroundSyncedPageWithoutDelay) {
+  ResetLedgerManager(0u, 0u, ftl::TimeDelta::Zero());
+  sync_ptr->max_background_synced_pages = 1u;
+  sync_ptr->create_page_syncs = true;
+  storage::PageId id = RandomId();
+
+  PagePtr page;
+  Status status;
+  ledger->GetPage(convert::ToArray(id), page.NewRequest(),
+                  callback::Capture(MakeQuitTask(), &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  page.reset();
+  EXPECT_TRUE(RunLoopUntil(
+      [this] { return sync_ptr->background_synced_pages.size() == 1u; }));
+
+  // The sync of the reopened page never downloads the backlog: the page would
+  // only be bound after the sync timeout if it did not reuse the state of the
+  // background sync.
+  sync_ptr->page_syncs_catch_up = false;
+  ledger->GetPage(convert::ToArray(id), page.NewRequest(),
+                  callback::Capture(MakeQuitTask(), &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+}
+
+// Verifies that closed pages are kept open, up to the given number of pages.
+TEST_F(LedgerManagerTest, KeepIdlePagesOpen) {
+  ResetLedgerManager(1u, 1024u, ftl::TimeDelta::FromSeconds(60));
+  sync_ptr->max_background_synced_pages = 1u;
+  storage::PageId id1 = RandomId();
+  storage::PageId id2 = RandomId();
+
+  PagePtr page;
+  ledger->GetPage(convert::ToArray(id1), page.NewRequest(),
+                  [this](Status) { message_loop_.PostQuitTask(); });
+  EXPECT_FALSE(RunLoopWithTimeout());
+  page.reset();
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(100)));
+  EXPECT_TRUE(sync_ptr->background_synced_pages.empty());
+
+  // Reopening the page reuses its PageManager.
+  storage_ptr->ClearCalls();
+  Status status;
+  ledger->GetPage(convert::ToArray(id1), page.NewRequest(),
+                  callback::Capture(MakeQuitTask(), &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(0u, storage_ptr->get_page_calls.size());
+  page.reset();
+
+  // Closing another page closes the least recently used one.
+  ledger->GetPage(convert::ToArray(id2), page.NewRequest(),
+                  [this](Status) { message_loop_.PostQuitTask(); });
+  EXPECT_FALSE(RunLoopWithTimeout());
+  page.reset();
+  EXPECT_TRUE(RunLoopUntil(
+      [this] { return sync_ptr->background_synced_pages.size() == 1u; }));
+  EXPECT_EQ(id1, sync_ptr->background_synced_pages[0]);
+}
+
+// Verifies that the pages kept open are bounded by their memory usage.
+TEST_F(LedgerManagerTest, BoundIdlePagesMemory) {
+  ResetLedgerManager(5u, 150u, ftl::TimeDelta::FromSeconds(60));
+  sync_ptr->max_background_synced_pages = 1u;
+  storage_ptr->page_memory_usage = 100u;
+  storage::PageId id1 = RandomId();
+  storage::PageId id2 = RandomId();
+
+  PagePtr page;
+  for (const storage::PageId& id : {id1, id2}) {
+    ledger->GetPage(convert::ToArray(id), page.NewRequest(),
+                    [this](Status) { message_loop_.PostQuitTask(); });
+    EXPECT_FALSE(RunLoopWithTimeout());
+    page.reset();
+  }
+  EXPECT_TRUE(RunLoopUntil(
+      [this] { return sync_ptr->background_synced_pages.size() == 1u; }));
+  EXPECT_EQ(id1, sync_ptr->background_synced_pages[0]);
+}
+
+// Verifies that the pages kept open are closed after the idle timeout.
+TEST_F(LedgerManagerTest, CloseIdlePagesAfterTimeout) {
+  ResetLedgerManager(5u, 1024u, ftl::TimeDelta::FromMilliseconds(10));
+  sync_ptr->max_background_synced_pages = 1u;
+  storage::PageId id = RandomId();
+
+  PagePtr page;
+  ledger->GetPage(convert::ToArray(id), page.NewRequest(),
+                  [this](Status) { message_loop_.PostQuitTask(); });
+  EXPECT_FALSE(RunLoopWithTimeout());
+  page.reset();
+  EXPECT_TRUE(RunLoopUntil(
+      [this] { return sync_ptr->background_synced_pages.size() == 1u; }));
+  EXPECT_EQ(id, sync_ptr->background_synced_pages[0]);
+}
+
 }  // namespace
 }  // namespace ledger
@@ -36,6 +36,9 @@ cloud_sync::UserConfig GetUserConfig(Environment* environment,
   user_config.user_id = user_id.ToString();
   user_config.user_directory = user_directory.ToString();
   user_config.auth_provider = auth_provider;
+  user_config.use_compression = environment->sync_compression_enabled();
+  user_config.use_object_packs = environment->object_packs_enabled();
+  user_config.use_multiplexed_watch = environment->multiplexed_watch_enabled();
   auto user_firebase = std::make_unique<firebase::FirebaseImpl>(
       environment->network_service(), user_config.server_id,
       cloud_sync::GetFirebasePathForUser(user_config.user_id));
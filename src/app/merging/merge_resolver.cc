@@ -97,14 +97,13 @@ void MergeResolver::CheckConflicts(DelayedStatus delayed_status) {
           // No conflict.
           return;
         }
-        heads.resize(2);
         ResolveConflicts(delayed_status, std::move(heads));
       });
 }
 
 void MergeResolver::ResolveConflicts(DelayedStatus delayed_status,
                                      std::vector<storage::CommitId> heads) {
-  FTL_DCHECK(heads.size() == 2);
+  FTL_DCHECK(heads.size() >= 2);
 
   merge_in_progress_ = true;
   auto cleanup = ftl::MakeAutoCall([this] {
@@ -133,8 +132,18 @@ void MergeResolver::ResolveConflicts(DelayedStatus delayed_status,
     this, delayed_status, cleanup = std::move(cleanup)
   ](storage::Status status,
     std::vector<std::unique_ptr<const storage::Commit>> commits) mutable {
-    FTL_DCHECK(commits.size() == 2);
-    FTL_DCHECK(commits[0]->GetTimestamp() <= commits[1]->GetTimestamp());
+    if (status != storage::Status::OK) {
+      FTL_LOG(ERROR) << "Failed to retrieve head commits.";
+      return;
+    }
+    FTL_DCHECK(commits.size() >= 2);
+    // Always merge the two oldest heads, in the canonical commit order. All
+    // devices seeing the same heads then produce the same merge commit, which
+    // is deduplicated when it is received from the cloud, instead of creating
+    // concurrent merge commits that later need to be merged themselves.
+    std::sort(commits.begin(), commits.end(),
+              storage::Commit::TimestampOrdered);
+    commits.resize(2);
 
     if (commits[0]->GetParentIds().size() == 2 &&
         commits[1]->GetParentIds().size() == 2 &&
@@ -185,11 +194,6 @@ void MergeResolver::ResolveConflicts(DelayedStatus delayed_status,
       return;
     }
 
-    if (status != storage::Status::OK) {
-      FTL_LOG(ERROR) << "Failed to retrieve head commits.";
-      return;
-    }
-
     // Merge the first two commits using the most recent one as the base.
     auto head1 = std::move(commits[0]);
     auto head2 = std::move(commits[1]);
@@ -4,8 +4,10 @@
 
 #include "apps/ledger/src/app/merging/merge_resolver.h"
 
+#include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "apps/ledger/src/app/constants.h"
 #include "apps/ledger/src/app/merging/last_one_wins_merge_strategy.h"
@@ -21,6 +23,8 @@
 #include "gtest/gtest.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/mtl/socket/strings.h"
 #include "lib/mtl/tasks/message_loop.h"
 
 namespace ledger {
@@ -474,5 +478,283 @@ TEST_F(MergeResolverTest, AutomaticallyMergeIdenticalCommits) {
   EXPECT_EQ(0u, merge_strategy_ptr->merge_calls);
 }
 
+// Sync delegate serving the objects of all the devices, the way the cloud
+// serves the objects uploaded by any device.
+class DevicesSyncDelegate : public storage::PageSyncDelegate {
+ public:
+  explicit DevicesSyncDelegate(
+      std::vector<std::unique_ptr<storage::PageStorage>>* devices)
+      : devices_(devices) {}
+  ~DevicesSyncDelegate() override {}
+
+  void GetObject(storage::ObjectIdView object_id,
+                 storage::DownloadPriority /*priority*/,
+                 std::function<void(storage::Status status,
+                                    uint64_t size,
+                                    mx::socket data)> callback) override {
+    for (const auto& device : *devices_) {
+      storage::Status status;
+      std::unique_ptr<const storage::Object> object;
+      device->GetPiece(object_id,
+                       [&status, &object](
+                           storage::Status s,
+                           std::unique_ptr<const storage::Object> o) {
+                         status = s;
+                         object = std::move(o);
+                       });
+      if (status != storage::Status::OK) {
+        continue;
+      }
+      ftl::StringView data;
+      status = object->GetData(&data);
+      if (status != storage::Status::OK) {
+        callback(status, 0u, mx::socket());
+        return;
+      }
+      callback(storage::Status::OK, data.size(),
+               mtl::WriteStringToSocket(data));
+      return;
+    }
+    callback(storage::Status::NOT_FOUND, 0u, mx::socket());
+  }
+
+ private:
+  std::vector<std::unique_ptr<storage::PageStorage>>* const devices_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(DevicesSyncDelegate);
+};
+
+// Simulates several devices concurrently modifying and merging the same page.
+// Each device has its own storage and merge resolver, and commits are
+// exchanged between devices the way the cloud would.
+class MergeConvergenceTest : public ::test::TestWithMessageLoop {
+ public:
+  MergeConvergenceTest()
+      : environment_(message_loop_.task_runner(),
+                     nullptr,
+                     message_loop_.task_runner()),
+        sync_delegate_(&devices_) {}
+  ~MergeConvergenceTest() override {}
+
+ protected:
+  void TearDown() override {
+    resolvers_.clear();
+    devices_.clear();
+    ::test::TestWithMessageLoop::TearDown();
+  }
+
+  void CreateDevices(size_t device_count) {
+    for (size_t i = 0; i < device_count; ++i) {
+      tmp_dirs_.push_back(std::make_unique<files::ScopedTempDir>());
+      auto storage = std::make_unique<storage::PageStorageImpl>(
+          &coroutine_service_, tmp_dirs_.back()->path(),
+          kRootPageId.ToString());
+      storage::Status status;
+      storage->Init(callback::Capture(MakeQuitTask(), &status));
+      ASSERT_FALSE(RunLoopWithTimeout());
+      ASSERT_EQ(storage::Status::OK, status);
+      storage->SetSyncDelegate(&sync_delegate_);
+      devices_.push_back(std::move(storage));
+    }
+  }
+
+  void StartMergeResolvers() {
+    for (const auto& device : devices_) {
+      auto resolver = std::make_unique<MergeResolver>(
+          [] {}, &environment_, device.get(),
+          std::make_unique<test::TestBackoff>(&backoff_count_));
+      resolver->SetMergeStrategy(std::make_unique<LastOneWinsMergeStrategy>());
+      resolvers_.push_back(std::move(resolver));
+    }
+  }
+
+  void PutOnDevice(size_t device, std::string key, std::string value) {
+    storage::PageStorage* storage = devices_[device].get();
+    storage::Status status;
+    std::vector<storage::CommitId> heads;
+    storage->GetHeadCommitIds(
+        callback::Capture(MakeQuitTask(), &status, &heads));
+    ASSERT_FALSE(RunLoopWithTimeout());
+    ASSERT_EQ(storage::Status::OK, status);
+
+    storage::ObjectId object_id;
+    storage->AddObjectFromLocal(
+        storage::DataSource::Create(std::move(value)),
+        callback::Capture(MakeQuitTask(), &status, &object_id));
+    ASSERT_FALSE(RunLoopWithTimeout());
+    ASSERT_EQ(storage::Status::OK, status);
+
+    std::unique_ptr<storage::Journal> journal;
+    storage->StartCommit(heads.front(), storage::JournalType::EXPLICIT,
+                         callback::Capture(MakeQuitTask(), &status, &journal));
+    ASSERT_FALSE(RunLoopWithTimeout());
+    ASSERT_EQ(storage::Status::OK, status);
+    ASSERT_EQ(storage::Status::OK,
+              journal->Put(key, object_id, storage::KeyPriority::EAGER));
+
+    std::unique_ptr<const storage::Commit> commit;
+    storage->CommitJournal(std::move(journal),
+                           callback::Capture(MakeQuitTask(), &status, &commit));
+    ASSERT_FALSE(RunLoopWithTimeout());
+    ASSERT_EQ(storage::Status::OK, status);
+  }
+
+  // Uploads the unsynced commits of all devices, then delivers them to all
+  // the other devices. Each device receives all new commits in a single batch.
+  void SyncAllDevices() {
+    std::vector<std::vector<std::unique_ptr<const storage::Commit>>> uploads;
+    for (const auto& device : devices_) {
+      storage::Status status;
+      std::vector<std::unique_ptr<const storage::Commit>> commits;
+      device->GetUnsyncedCommits(
+          callback::Capture(MakeQuitTask(), &status, &commits));
+      ASSERT_FALSE(RunLoopWithTimeout());
+      ASSERT_EQ(storage::Status::OK, status);
+      for (const auto& commit : commits) {
+        uploaded_commits_.insert(commit->GetId());
+        if (commit->GetParentIds().size() == 2) {
+          merge_commits_.insert(commit->GetId());
+        }
+        ASSERT_EQ(storage::Status::OK,
+                  device->MarkCommitSynced(commit->GetId()));
+      }
+      uploads.push_back(std::move(commits));
+    }
+
+    for (size_t target = 0; target < devices_.size(); ++target) {
+      std::vector<storage::PageStorage::CommitIdAndBytes> ids_and_bytes;
+      for (size_t source = 0; source < devices_.size(); ++source) {
+        if (source == target) {
+          continue;
+        }
+        for (const auto& commit : uploads[source]) {
+          ids_and_bytes.emplace_back(commit->GetId(),
+                                     commit->GetStorageBytes().ToString());
+        }
+      }
+      if (ids_and_bytes.empty()) {
+        continue;
+      }
+      storage::Status status;
+      devices_[target]->AddCommitsFromSync(
+          std::move(ids_and_bytes), callback::Capture(MakeQuitTask(), &status));
+      ASSERT_FALSE(RunLoopWithTimeout());
+      ASSERT_EQ(storage::Status::OK, status);
+    }
+  }
+
+  // Returns whether all devices have a single head commit, and stores it in
+  // |heads|.
+  bool AllDevicesHaveSingleHead(std::vector<storage::CommitId>* heads) {
+    heads->clear();
+    for (const auto& device : devices_) {
+      storage::Status status = storage::Status::INTERNAL_IO_ERROR;
+      std::vector<storage::CommitId> device_heads;
+      device->GetHeadCommitIds(
+          [&status, &device_heads](storage::Status s,
+                                   std::vector<storage::CommitId> ids) {
+            status = s;
+            device_heads = std::move(ids);
+          });
+      if (status != storage::Status::OK || device_heads.size() != 1) {
+        return false;
+      }
+      heads->push_back(std::move(device_heads.front()));
+    }
+    return true;
+  }
+
+  bool AllResolversEmpty() {
+    for (const auto& resolver : resolvers_) {
+      if (!resolver->IsEmpty()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  Environment environment_;
+  coroutine::CoroutineServiceImpl coroutine_service_;
+  std::vector<std::unique_ptr<files::ScopedTempDir>> tmp_dirs_;
+  std::vector<std::unique_ptr<storage::PageStorage>> devices_;
+  DevicesSyncDelegate sync_delegate_;
+  std::vector<std::unique_ptr<MergeResolver>> resolvers_;
+  int backoff_count_ = 0;
+
+  // Commits uploaded to the simulated cloud.
+  std::set<storage::CommitId> uploaded_commits_;
+  std::set<storage::CommitId> merge_commits_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(MergeConvergenceTest);
+};
+
+TEST_F(MergeConvergenceTest, ConcurrentMergesProduceIdenticalCommits) {
+  const size_t kDeviceCount = 5;
+  ASSERT_NO_FATAL_FAILURE(CreateDevices(kDeviceCount));
+
+  // Every device concurrently modifies the page.
+  for (size_t i = 0; i < kDeviceCount; ++i) {
+    ASSERT_NO_FATAL_FAILURE(PutOnDevice(i, ftl::StringPrintf("key%zu", i),
+                                        ftl::StringPrintf("value%zu", i)));
+  }
+  ASSERT_NO_FATAL_FAILURE(SyncAllDevices());
+  EXPECT_EQ(kDeviceCount, uploaded_commits_.size());
+
+  // All devices now have |kDeviceCount| heads and resolve the conflict
+  // concurrently.
+  StartMergeResolvers();
+  std::vector<storage::CommitId> heads;
+  EXPECT_TRUE(RunLoopUntil(
+      [this, &heads] {
+        return AllResolversEmpty() && AllDevicesHaveSingleHead(&heads);
+      },
+      ftl::TimeDelta::FromSeconds(10)));
+
+  // All devices merged the heads in the same order, producing the same merge
+  // commits.
+  ASSERT_EQ(kDeviceCount, heads.size());
+  for (const auto& head : heads) {
+    EXPECT_EQ(heads.front(), head);
+  }
+
+  ASSERT_NO_FATAL_FAILURE(SyncAllDevices());
+  EXPECT_EQ(kDeviceCount - 1, merge_commits_.size());
+  EXPECT_TRUE(AllDevicesHaveSingleHead(&heads));
+  EXPECT_EQ(0, backoff_count_);
+}
+
+TEST_F(MergeConvergenceTest, ConcurrentConflictingWritesConverge) {
+  const size_t kDeviceCount = 4;
+  ASSERT_NO_FATAL_FAILURE(CreateDevices(kDeviceCount));
+  StartMergeResolvers();
+
+  // Devices write to the same key in several rounds, syncing between rounds.
+  const size_t kRoundCount = 3;
+  for (size_t round = 0; round < kRoundCount; ++round) {
+    for (size_t i = 0; i < kDeviceCount; ++i) {
+      ASSERT_NO_FATAL_FAILURE(
+          PutOnDevice(i, "key", ftl::StringPrintf("value%zu-%zu", round, i)));
+    }
+    ASSERT_NO_FATAL_FAILURE(SyncAllDevices());
+    std::vector<storage::CommitId> heads;
+    EXPECT_TRUE(RunLoopUntil(
+        [this, &heads] {
+          return AllResolversEmpty() && AllDevicesHaveSingleHead(&heads);
+        },
+        ftl::TimeDelta::FromSeconds(10)));
+    ASSERT_NO_FATAL_FAILURE(SyncAllDevices());
+  }
+
+  std::vector<storage::CommitId> heads;
+  ASSERT_TRUE(AllDevicesHaveSingleHead(&heads));
+  for (const auto& head : heads) {
+    EXPECT_EQ(heads.front(), head);
+  }
+  // Each round requires |kDeviceCount - 1| merges, which are computed
+  // identically on all devices.
+  EXPECT_EQ(kRoundCount * (kDeviceCount - 1), merge_commits_.size());
+}
+
 }  // namespace
 }  // namespace ledger
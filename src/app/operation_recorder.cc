@@ -0,0 +1,191 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/operation_recorder.h"
+
+#include <fcntl.h>
+
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "apps/ledger/src/glue/crypto/hash.h"
+#include "apps/ledger/src/glue/crypto/rand.h"
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/files/file_descriptor.h"
+#include "lib/ftl/logging.h"
+
+#define FILE_CREATE_MODE 0666
+
+namespace ledger {
+
+namespace {
+// Size of the secret of the key hashes.
+constexpr size_t kSecretSize = 32u;
+}  // namespace
+
+constexpr size_t OperationRecorder::kHashBytesPerKeyByte;
+
+RecordedOperation::RecordedOperation() {}
+
+RecordedOperation::RecordedOperation(OperationRecorder* recorder,
+                                     ftl::StringView method,
+                                     uint64_t page)
+    : recorder_(recorder),
+      method_(method.ToString()),
+      page_(page),
+      start_time_(ftl::TimePoint::Now()) {
+  FTL_DCHECK(recorder_);
+}
+
+RecordedOperation::RecordedOperation(RecordedOperation&& other)
+    : recorder_(other.recorder_),
+      method_(std::move(other.method_)),
+      page_(other.page_),
+      start_time_(other.start_time_),
+      keys_(std::move(other.keys_)),
+      numbers_(std::move(other.numbers_)) {
+  other.recorder_ = nullptr;
+}
+
+RecordedOperation::~RecordedOperation() {}
+
+RecordedOperation& RecordedOperation::operator=(RecordedOperation&& other) {
+  recorder_ = other.recorder_;
+  method_ = std::move(other.method_);
+  page_ = other.page_;
+  start_time_ = other.start_time_;
+  keys_ = std::move(other.keys_);
+  numbers_ = std::move(other.numbers_);
+  other.recorder_ = nullptr;
+  return *this;
+}
+
+void RecordedOperation::SetKey(const char* name,
+                               const fidl::Array<uint8_t>& key) {
+  if (!recorder_ || key.is_null()) {
+    return;
+  }
+  keys_.emplace_back(name, convert::ToHex(recorder_->HashKey(key)));
+}
+
+void RecordedOperation::SetNumber(const char* name, int64_t value) {
+  if (!recorder_) {
+    return;
+  }
+  numbers_.emplace_back(name, value);
+}
+
+void RecordedOperation::Done(Status status) {
+  Write(&status);
+}
+
+void RecordedOperation::Done() {
+  Write(nullptr);
+}
+
+void RecordedOperation::Write(const Status* status) {
+  if (!recorder_) {
+    return;
+  }
+  ftl::TimePoint end_time = ftl::TimePoint::Now();
+
+  rapidjson::StringBuffer string_buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(string_buffer);
+  writer.StartObject();
+  writer.Key("time_us");
+  writer.Int64((start_time_ - recorder_->start_time()).ToMicroseconds());
+  writer.Key("duration_us");
+  writer.Int64((end_time - start_time_).ToMicroseconds());
+  writer.Key("method");
+  writer.String(method_.data(), method_.size());
+  writer.Key("page");
+  writer.Uint64(page_);
+  if (status) {
+    writer.Key("status");
+    writer.Int(static_cast<int>(*status));
+  }
+  for (const auto& key : keys_) {
+    writer.Key(key.first);
+    writer.String(key.second.data(), key.second.size());
+  }
+  for (const auto& number : numbers_) {
+    writer.Key(number.first);
+    writer.Int64(number.second);
+  }
+  writer.EndObject();
+
+  std::string line(string_buffer.GetString(), string_buffer.GetSize());
+  line.push_back('\n');
+  recorder_->Write(std::move(line));
+  // An operation is only written once.
+  recorder_ = nullptr;
+}
+
+std::unique_ptr<OperationRecorder> OperationRecorder::Create(
+    const std::string& path) {
+  ftl::UniqueFD fd(HANDLE_EINTR(creat(path.c_str(), FILE_CREATE_MODE)));
+  if (!fd.is_valid()) {
+    FTL_LOG(ERROR) << "Unable to create the operation trace at " << path;
+    return nullptr;
+  }
+  std::string secret;
+  secret.resize(kSecretSize);
+  glue::RandBytes(&secret[0], secret.size());
+  return std::unique_ptr<OperationRecorder>(
+      new OperationRecorder(std::move(fd), std::move(secret)));
+}
+
+OperationRecorder::OperationRecorder(ftl::UniqueFD fd, std::string secret)
+    : fd_(std::move(fd)),
+      secret_(std::move(secret)),
+      start_time_(ftl::TimePoint::Now()) {}
+
+OperationRecorder::~OperationRecorder() {}
+
+uint64_t OperationRecorder::GetPageIndex(convert::ExtendedStringView page_id) {
+  return page_indexes_.emplace(page_id.ToString(), page_indexes_.size())
+      .first->second;
+}
+
+std::string OperationRecorder::HashKey(convert::ExtendedStringView key) const {
+  // The bytes for each position of the key only depend on the key up to that
+  // position, so that equal prefixes give equal hashes.
+  static_assert(kHashBytesPerKeyByte <= glue::SHA256StreamingHMAC::kHashSize,
+                "The hash of a key byte must fit in an HMAC.");
+  glue::SHA256StreamingHMAC hmac(secret_);
+  std::string result;
+  result.reserve(key.size() * kHashBytesPerKeyByte);
+  std::string prefix_hmac;
+  for (size_t i = 0; i < key.size(); ++i) {
+    hmac.Update(ftl::StringView(key.data() + i, 1u));
+    hmac.GetHMAC(&prefix_hmac);
+    result.append(prefix_hmac, 0u, kHashBytesPerKeyByte);
+  }
+  return result;
+}
+
+void OperationRecorder::Write(std::string line) {
+  if (!ftl::WriteFileDescriptor(fd_.get(), line.data(), line.size())) {
+    FTL_LOG(ERROR) << "Unable to write to the operation trace.";
+  }
+}
+
+PageRecorder::PageRecorder(OperationRecorder* recorder,
+                           convert::ExtendedStringView page_id)
+    : recorder_(recorder), page_index_(recorder->GetPageIndex(page_id)) {}
+
+PageRecorder::~PageRecorder() {}
+
+RecordedOperation PageRecorder::Start(ftl::StringView method) {
+  return RecordedOperation(recorder_, method, page_index_);
+}
+
+uint64_t PageRecorder::GetReferenceIndex(
+    convert::ExtendedStringView opaque_id) {
+  return reference_indexes_
+      .emplace(opaque_id.ToString(), reference_indexes_.size())
+      .first->second;
+}
+
+}  // namespace ledger
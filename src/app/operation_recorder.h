@@ -0,0 +1,164 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_APP_OPERATION_RECORDER_H_
+#define APPS_LEDGER_SRC_APP_OPERATION_RECORDER_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/convert/convert.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ledger {
+
+class OperationRecorder;
+
+// A call being recorded. A default-constructed RecordedOperation records
+// nothing, so that the callers do not need to check whether recording is
+// enabled.
+class RecordedOperation {
+ public:
+  RecordedOperation();
+  RecordedOperation(OperationRecorder* recorder,
+                    ftl::StringView method,
+                    uint64_t page);
+  RecordedOperation(RecordedOperation&& other);
+  ~RecordedOperation();
+
+  RecordedOperation& operator=(RecordedOperation&& other);
+
+  bool enabled() const { return recorder_ != nullptr; }
+
+  // Records the argument |name| as |key|, hashed. Null keys are not recorded.
+  void SetKey(const char* name, const fidl::Array<uint8_t>& key);
+  void SetNumber(const char* name, int64_t value);
+
+  // Writes the operation to the trace, as returned with |status|.
+  void Done(Status status);
+  // Writes the operation to the trace, for calls that return no status.
+  void Done();
+
+ private:
+  void Write(const Status* status);
+
+  OperationRecorder* recorder_ = nullptr;
+  std::string method_;
+  uint64_t page_ = 0u;
+  ftl::TimePoint start_time_;
+  std::vector<std::pair<const char*, std::string>> keys_;
+  std::vector<std::pair<const char*, int64_t>> numbers_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RecordedOperation);
+};
+
+// Records the FIDL calls made on the pages and their snapshots, and the change
+// notifications sent to the page watchers, so that the workload can be
+// replayed by the replay benchmark (see test/benchmark/replay).
+//
+// The recording is anonymized: keys are hashed, keeping their size and the
+// prefixes they share, and values are only recorded by their size. Pages are
+// identified by their order of appearance, and snapshots and references by
+// their order of creation on their page.
+//
+// The trace has one JSON object per call, on its own line:
+//   {"time_us": <start of the call, from the start of the recording>,
+//    "duration_us": <time until the call returned>,
+//    "method": "<interface>.<method>", "page": <page index>,
+//    "status": <returned status, if any>, <arguments>...}
+class OperationRecorder {
+ public:
+  // Returns a recorder writing to a new file at |path|, or nullptr if the file
+  // cannot be created.
+  static std::unique_ptr<OperationRecorder> Create(const std::string& path);
+  ~OperationRecorder();
+
+  // Returns the index of the page of id |page_id| in the trace.
+  uint64_t GetPageIndex(convert::ExtendedStringView page_id);
+
+  // Number of bytes of the anonymized version of a key for each byte of the
+  // key.
+  static constexpr size_t kHashBytesPerKeyByte = 8u;
+
+  // Returns the anonymized version of |key|, of kHashBytesPerKeyByte bytes for
+  // each byte of the key. Two keys get the same hash if they are equal, and the
+  // hash of a prefix of a key is a prefix of the hash of the key: the bytes for
+  // each position are taken from the HMAC-SHA256 of the prefix of the key up
+  // to that position, under a random secret.
+  std::string HashKey(convert::ExtendedStringView key) const;
+
+  ftl::TimePoint start_time() const { return start_time_; }
+
+  // Appends |line| to the trace.
+  void Write(std::string line);
+
+ private:
+  OperationRecorder(ftl::UniqueFD fd, std::string secret);
+
+  ftl::UniqueFD fd_;
+  // Random secret of the key hashes, so that they cannot be reversed, nor
+  // matched across traces.
+  const std::string secret_;
+  const ftl::TimePoint start_time_;
+  std::unordered_map<std::string, uint64_t> page_indexes_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(OperationRecorder);
+};
+
+// Records the calls made on a single page. Owned by the PageManager of the
+// page.
+class PageRecorder {
+ public:
+  PageRecorder(OperationRecorder* recorder,
+               convert::ExtendedStringView page_id);
+  ~PageRecorder();
+
+  RecordedOperation Start(ftl::StringView method);
+
+  // Snapshots are indexed in their order of creation.
+  uint64_t NewSnapshotIndex() { return snapshot_count_++; }
+  // Returns the index of the last snapshot created. Snapshots are created
+  // right before the callback of the call requesting them, which can use this
+  // to record the snapshot it created.
+  uint64_t last_snapshot_index() const { return snapshot_count_ - 1; }
+
+  // Returns the index of the reference of id |opaque_id|.
+  uint64_t GetReferenceIndex(convert::ExtendedStringView opaque_id);
+
+ private:
+  OperationRecorder* const recorder_;
+  const uint64_t page_index_;
+  uint64_t snapshot_count_ = 0u;
+  std::unordered_map<std::string, uint64_t> reference_indexes_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(PageRecorder);
+};
+
+// Returns a callback calling |callback|, after recording |operation| with the
+// status |callback| is called with. |C| is the std::function type of a FIDL
+// callback.
+template <typename C>
+C TrackOperation(RecordedOperation operation, C callback) {
+  if (!operation.enabled()) {
+    return callback;
+  }
+  return C(ftl::MakeCopyable([
+    operation = std::move(operation), callback = std::move(callback)
+  ](Status status, auto&&... results) mutable {
+    operation.Done(status);
+    callback(status, std::forward<decltype(results)>(results)...);
+  }));
+}
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_APP_OPERATION_RECORDER_H_
@@ -0,0 +1,192 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/operation_recorder.h"
+
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <rapidjson/document.h>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/strings/split_string.h"
+
+namespace ledger {
+namespace {
+
+class OperationRecorderTest : public ::testing::Test {
+ public:
+  OperationRecorderTest() {}
+  ~OperationRecorderTest() override {}
+
+  // ::testing::Test:
+  void SetUp() override {
+    ::testing::Test::SetUp();
+    path_ = tmp_dir_.path() + "/trace";
+    recorder_ = OperationRecorder::Create(path_);
+    ASSERT_TRUE(recorder_);
+  }
+
+ protected:
+  // Returns the operations written so far, one document per line.
+  std::vector<std::unique_ptr<rapidjson::Document>> ReadOperations() {
+    std::string content;
+    EXPECT_TRUE(files::ReadFileToString(path_, &content));
+    std::vector<std::unique_ptr<rapidjson::Document>> result;
+    for (ftl::StringView line :
+         ftl::SplitString(content, "\n",
+                          ftl::WhiteSpaceHandling::kKeepWhitespace,
+                          ftl::SplitResult::kSplitWantNonEmpty)) {
+      auto document = std::make_unique<rapidjson::Document>();
+      document->Parse(line.data(), line.size());
+      EXPECT_FALSE(document->HasParseError());
+      EXPECT_TRUE(document->IsObject());
+      result.push_back(std::move(document));
+    }
+    return result;
+  }
+
+  files::ScopedTempDir tmp_dir_;
+  std::string path_;
+  std::unique_ptr<OperationRecorder> recorder_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(OperationRecorderTest);
+};
+
+TEST_F(OperationRecorderTest, HashKey) {
+  const size_t width = OperationRecorder::kHashBytesPerKeyByte;
+  std::string key = recorder_->HashKey("key");
+  EXPECT_EQ(3u * width, key.size());
+  EXPECT_EQ(key, recorder_->HashKey("key"));
+  EXPECT_NE(recorder_->HashKey("key_12345678"),
+            recorder_->HashKey("kez_12345678"));
+  EXPECT_EQ(key.substr(0, 2u * width), recorder_->HashKey("ke"));
+  EXPECT_EQ(key, recorder_->HashKey("key_suffix").substr(0, 3u * width));
+  EXPECT_EQ("", recorder_->HashKey(""));
+
+  // The hashes cannot be matched across traces.
+  std::unique_ptr<OperationRecorder> other_recorder =
+      OperationRecorder::Create(tmp_dir_.path() + "/other_trace");
+  ASSERT_TRUE(other_recorder);
+  EXPECT_NE(key, other_recorder->HashKey("key"));
+}
+
+TEST_F(OperationRecorderTest, HashKeyNoCollision) {
+  const size_t width = OperationRecorder::kHashBytesPerKeyByte;
+  // Keys that only differ in their last byte.
+  std::set<std::string> last_byte_hashes;
+  std::set<std::string> hashes;
+  for (int c = 0; c < 256; ++c) {
+    std::string hash =
+        recorder_->HashKey("prefix" + std::string(1, static_cast<char>(c)));
+    last_byte_hashes.insert(hash.substr(6u * width));
+    hashes.insert(std::move(hash));
+  }
+  EXPECT_EQ(256u, last_byte_hashes.size());
+
+  // Keys of all sizes, from a small alphabet to share many prefixes.
+  std::set<std::string> keys;
+  std::string key;
+  for (size_t i = 0; i < 10000; ++i) {
+    key = key.substr(0, i % 7) +
+          std::string(1, static_cast<char>('a' + i % 3)) +
+          std::to_string(i % 11);
+    keys.insert(key);
+  }
+  for (const auto& key : keys) {
+    hashes.insert(recorder_->HashKey(key));
+  }
+  EXPECT_EQ(256u + keys.size(), hashes.size());
+}
+
+TEST_F(OperationRecorderTest, PageIndexes) {
+  EXPECT_EQ(0u, recorder_->GetPageIndex("page1"));
+  EXPECT_EQ(1u, recorder_->GetPageIndex("page2"));
+  EXPECT_EQ(0u, recorder_->GetPageIndex("page1"));
+
+  PageRecorder page_recorder(recorder_.get(), "page2");
+  EXPECT_EQ(0u, page_recorder.GetReferenceIndex("reference1"));
+  EXPECT_EQ(1u, page_recorder.GetReferenceIndex("reference2"));
+  EXPECT_EQ(0u, page_recorder.GetReferenceIndex("reference1"));
+  EXPECT_EQ(0u, page_recorder.NewSnapshotIndex());
+  EXPECT_EQ(1u, page_recorder.NewSnapshotIndex());
+  EXPECT_EQ(1u, page_recorder.last_snapshot_index());
+}
+
+TEST_F(OperationRecorderTest, WriteOperations) {
+  PageRecorder page_recorder(recorder_.get(), "page");
+
+  RecordedOperation put = page_recorder.Start("Page.Put");
+  put.SetKey("key", convert::ToArray("key"));
+  put.SetKey("null_key", nullptr);
+  put.SetNumber("value_size", 42);
+  put.Done(Status::OK);
+  // An operation is only written once.
+  put.Done(Status::OK);
+
+  RecordedOperation on_change = page_recorder.Start("PageWatcher.OnChange");
+  on_change.Done();
+
+  // Operations that are not recorded are not written.
+  RecordedOperation not_recorded;
+  not_recorded.SetNumber("value_size", 42);
+  not_recorded.Done(Status::OK);
+
+  auto operations = ReadOperations();
+  ASSERT_EQ(2u, operations.size());
+
+  const rapidjson::Document& put_document = *operations[0];
+  EXPECT_EQ("Page.Put", std::string(put_document["method"].GetString()));
+  EXPECT_EQ(0u, put_document["page"].GetUint64());
+  EXPECT_EQ(static_cast<int>(Status::OK), put_document["status"].GetInt());
+  EXPECT_EQ(convert::ToHex(recorder_->HashKey("key")),
+            std::string(put_document["key"].GetString()));
+  EXPECT_FALSE(put_document.HasMember("null_key"));
+  EXPECT_EQ(42, put_document["value_size"].GetInt64());
+  EXPECT_TRUE(put_document.HasMember("time_us"));
+  EXPECT_TRUE(put_document.HasMember("duration_us"));
+
+  const rapidjson::Document& on_change_document = *operations[1];
+  EXPECT_EQ("PageWatcher.OnChange",
+            std::string(on_change_document["method"].GetString()));
+  EXPECT_FALSE(on_change_document.HasMember("status"));
+}
+
+TEST_F(OperationRecorderTest, TrackOperation) {
+  PageRecorder page_recorder(recorder_.get(), "page");
+
+  bool called = false;
+  Status status = Status::OK;
+  std::string value;
+  std::function<void(Status, std::string)> callback =
+      TrackOperation(page_recorder.Start("PageSnapshot.GetInline"),
+                     std::function<void(Status, std::string)>(
+                         [&called, &status, &value](Status s, std::string v) {
+                           called = true;
+                           status = s;
+                           value = std::move(v);
+                         }));
+  EXPECT_TRUE(ReadOperations().empty());
+
+  callback(Status::KEY_NOT_FOUND, "value");
+  EXPECT_TRUE(called);
+  EXPECT_EQ(Status::KEY_NOT_FOUND, status);
+  EXPECT_EQ("value", value);
+
+  auto operations = ReadOperations();
+  ASSERT_EQ(1u, operations.size());
+  EXPECT_EQ(static_cast<int>(Status::KEY_NOT_FOUND),
+            (*operations[0])["status"].GetInt());
+}
+
+}  // namespace
+}  // namespace ledger
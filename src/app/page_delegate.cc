@@ -4,23 +4,45 @@
 
 #include "apps/ledger/src/app/page_delegate.h"
 
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "apps/ledger/src/app/constants.h"
+#include "apps/ledger/src/app/diff_utils.h"
 #include "apps/ledger/src/app/page_manager.h"
 #include "apps/ledger/src/app/page_snapshot_impl.h"
 #include "apps/ledger/src/app/page_utils.h"
 #include "apps/ledger/src/callback/waiter.h"
 #include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/storage/public/constants.h"
 #include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/functional/make_copyable.h"
 #include "lib/mtl/socket/strings.h"
 
 namespace ledger {
+namespace {
 
-PageDelegate::PageDelegate(coroutine::CoroutineService* coroutine_service,
+// Retrieves the id of the commit identified by |token|, as returned by
+// |GetChangesSince|. A null token identifies the initial, empty commit of the
+// page. Returns false if |token| is not a valid token.
+bool CommitIdFromToken(const fidl::Array<uint8_t>& token,
+                       storage::CommitId* commit_id) {
+  if (token.is_null()) {
+    *commit_id = storage::kFirstPageCommitId.ToString();
+    return true;
+  }
+  if (token.size() != storage::kCommitIdSize) {
+    return false;
+  }
+  *commit_id = convert::ToString(token);
+  return true;
+}
+
+}  // namespace
+
+PageDelegate::PageDelegate(Environment* environment,
                            PageManager* manager,
                            storage::PageStorage* storage,
                            fidl::InterfaceRequest<Page> request,
@@ -28,8 +50,8 @@ PageDelegate::PageDelegate(coroutine::CoroutineService* coroutine_service,
     : manager_(manager),
       storage_(storage),
       request_(std::move(request)),
-      interface_(this),
-      branch_tracker_(coroutine_service, manager, storage),
+      interface_(this, manager->recorder()),
+      branch_tracker_(environment, manager, storage),
       watcher_set_(watchers) {
   interface_.set_on_empty([this] {
     operation_serializer_.Serialize(
@@ -62,42 +84,166 @@ void PageDelegate::GetId(const Page::GetIdCallback& callback) {
 }
 
 // GetSnapshot(PageSnapshot& snapshot, PageWatcher& watcher) => (Status status);
+// GetSnapshotWithWatcherOptions(PageSnapshot& snapshot,
+//                               array<uint8>? key_prefix,
+//                               PageWatcher? watcher,
+//                               WatcherOptions? watcher_options)
+//   => (Status status);
 void PageDelegate::GetSnapshot(
     fidl::InterfaceRequest<PageSnapshot> snapshot_request,
     fidl::Array<uint8_t> key_prefix,
     fidl::InterfaceHandle<PageWatcher> watcher,
+    WatcherOptionsPtr watcher_options,
     const Page::GetSnapshotCallback& callback) {
   // TODO(qsr): Update this so that only |GetCurrentCommitId| is done in a the
   // operation serializer.
   operation_serializer_.Serialize(
       callback, ftl::MakeCopyable([
         this, snapshot_request = std::move(snapshot_request),
-        key_prefix = std::move(key_prefix), watcher = std::move(watcher)
+        key_prefix = std::move(key_prefix), watcher = std::move(watcher),
+        watcher_options = std::move(watcher_options)
       ](Page::GetSnapshotCallback callback) mutable {
-        storage_->GetCommit(
-            GetCurrentCommitId(),
-            ftl::MakeCopyable([
-              this, snapshot_request = std::move(snapshot_request),
-              key_prefix = std::move(key_prefix), watcher = std::move(watcher),
-              callback = std::move(callback)
-            ](storage::Status status,
-              std::unique_ptr<const storage::Commit> commit) mutable {
-              if (status != storage::Status::OK) {
-                callback(PageUtils::ConvertStatus(status));
-                return;
-              }
-              std::string prefix = convert::ToString(key_prefix);
-              if (watcher) {
-                PageWatcherPtr watcher_ptr =
-                    PageWatcherPtr::Create(std::move(watcher));
-                branch_tracker_.RegisterPageWatcher(std::move(watcher_ptr),
-                                                    commit->Clone(), prefix);
-              }
-              manager_->BindPageSnapshot(std::move(commit),
-                                         std::move(snapshot_request),
-                                         std::move(prefix));
-              callback(Status::OK);
-            }));
+        // The commit identified by the resume token, if any, is retrieved
+        // together with the current one.
+        bool resume = watcher && watcher_options &&
+                      !watcher_options->resume_token.is_null();
+        storage::CommitId resume_commit_id;
+        if (resume && !CommitIdFromToken(watcher_options->resume_token,
+                                         &resume_commit_id)) {
+          callback(Status::INVALID_TOKEN);
+          return;
+        }
+        auto waiter = callback::Waiter<
+            storage::Status,
+            std::unique_ptr<const storage::Commit>>::Create(storage::Status::OK);
+        storage_->GetCommit(GetCurrentCommitId(), waiter->NewCallback());
+        if (resume) {
+          storage_->GetCommit(resume_commit_id, waiter->NewCallback());
+        }
+        waiter->Finalize(ftl::MakeCopyable([
+          this, resume, snapshot_request = std::move(snapshot_request),
+          key_prefix = std::move(key_prefix), watcher = std::move(watcher),
+          watcher_options = std::move(watcher_options),
+          callback = std::move(callback)
+        ](storage::Status status,
+          std::vector<std::unique_ptr<const storage::Commit>> commits) mutable {
+          if (status == storage::Status::NOT_FOUND && resume) {
+            // The current commit is always present: the resume token is
+            // unknown.
+            callback(Status::INVALID_TOKEN);
+            return;
+          }
+          if (status != storage::Status::OK) {
+            callback(PageUtils::ConvertStatus(status));
+            return;
+          }
+          std::unique_ptr<const storage::Commit> commit = std::move(commits[0]);
+          std::string prefix = convert::ToString(key_prefix);
+          if (watcher) {
+            PageWatcherPtr watcher_ptr =
+                PageWatcherPtr::Create(std::move(watcher));
+            if (resume) {
+              branch_tracker_.RegisterPageWatcher(
+                  std::move(watcher_ptr), std::move(commits[1]), prefix,
+                  std::move(watcher_options), commit->Clone());
+            } else {
+              branch_tracker_.RegisterPageWatcher(
+                  std::move(watcher_ptr), commit->Clone(), prefix,
+                  std::move(watcher_options));
+            }
+          }
+          manager_->BindPageSnapshot(std::move(commit),
+                                     std::move(snapshot_request),
+                                     std::move(prefix));
+          callback(Status::OK);
+        }));
+      }));
+}
+
+// GetChangesSince(array<uint8>? token, array<uint8>? page_token)
+//   => (Status status, PageChange? change, array<uint8>? next_page_token,
+//       array<uint8>? new_token);
+void PageDelegate::GetChangesSince(
+    fidl::Array<uint8_t> token,
+    fidl::Array<uint8_t> page_token,
+    const Page::GetChangesSinceCallback& callback) {
+  // The serializer only forwards the status of the operation: the other
+  // results are held here until the operation completes.
+  struct Result {
+    PageChangePtr change;
+    fidl::Array<uint8_t> next_page_token;
+    fidl::Array<uint8_t> new_token;
+  };
+  auto result = std::make_shared<Result>();
+  operation_serializer_.Serialize(
+      [result, callback](Status status) {
+        callback(status, std::move(result->change),
+                 std::move(result->next_page_token),
+                 std::move(result->new_token));
+      },
+      ftl::MakeCopyable([
+        this, token = std::move(token), page_token = std::move(page_token),
+        result
+      ](StatusCallback callback) mutable {
+        storage::CommitId base_id;
+        if (!CommitIdFromToken(token, &base_id)) {
+          callback(Status::INVALID_TOKEN);
+          return;
+        }
+        // A page token is the id of the commit up to which changes are
+        // returned, followed by the first key of the page.
+        storage::CommitId target_id;
+        std::string min_key;
+        if (page_token.is_null()) {
+          target_id = GetCurrentCommitId();
+        } else {
+          std::string page_token_str = convert::ToString(page_token);
+          if (page_token_str.size() < storage::kCommitIdSize) {
+            callback(Status::INVALID_TOKEN);
+            return;
+          }
+          target_id = page_token_str.substr(0, storage::kCommitIdSize);
+          min_key = page_token_str.substr(storage::kCommitIdSize);
+        }
+
+        auto waiter = callback::Waiter<
+            storage::Status,
+            std::unique_ptr<const storage::Commit>>::Create(storage::Status::OK);
+        storage_->GetCommit(base_id, waiter->NewCallback());
+        storage_->GetCommit(target_id, waiter->NewCallback());
+        waiter->Finalize([
+          storage = storage_, target_id, min_key = std::move(min_key), result,
+          callback = std::move(callback)
+        ](storage::Status status,
+          std::vector<std::unique_ptr<const storage::Commit>> commits) {
+          if (status != storage::Status::OK) {
+            callback(status == storage::Status::NOT_FOUND
+                         ? Status::INVALID_TOKEN
+                         : PageUtils::ConvertStatus(status));
+            return;
+          }
+          diff_utils::ComputePageChange(
+              storage, *commits[0], *commits[1], "", std::move(min_key),
+              diff_utils::PaginationBehavior::BY_SIZE,
+              [target_id, result, callback](
+                  Status status,
+                  std::pair<PageChangePtr, std::string> page_change) {
+                if (status != Status::OK) {
+                  callback(status);
+                  return;
+                }
+                const std::string& next_key = page_change.second;
+                result->change = std::move(page_change.first);
+                result->new_token = convert::ToArray(target_id);
+                if (next_key.empty()) {
+                  callback(Status::OK);
+                } else {
+                  result->next_page_token =
+                      convert::ToArray(target_id + next_key);
+                  callback(Status::PARTIAL_RESULT);
+                }
+              });
+        });
       }));
 }
 
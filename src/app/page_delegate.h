@@ -15,6 +15,7 @@
 #include "apps/ledger/src/app/page_impl.h"
 #include "apps/ledger/src/app/sync_watcher_set.h"
 #include "apps/ledger/src/callback/operation_serializer.h"
+#include "apps/ledger/src/environment/environment.h"
 #include "apps/ledger/src/fidl_helpers/bound_interface.h"
 #include "apps/ledger/src/storage/public/data_source.h"
 #include "apps/ledger/src/storage/public/journal.h"
@@ -35,7 +36,7 @@ class PageManager;
 // |set_on_empty()|).
 class PageDelegate {
  public:
-  PageDelegate(coroutine::CoroutineService* coroutine_service,
+  PageDelegate(Environment* environment,
                PageManager* manager,
                storage::PageStorage* storage,
                fidl::InterfaceRequest<Page> request,
@@ -54,8 +55,13 @@ class PageDelegate {
   void GetSnapshot(fidl::InterfaceRequest<PageSnapshot> snapshot_request,
                    fidl::Array<uint8_t> key_prefix,
                    fidl::InterfaceHandle<PageWatcher> watcher,
+                   WatcherOptionsPtr watcher_options,
                    const Page::GetSnapshotCallback& callback);
 
+  void GetChangesSince(fidl::Array<uint8_t> token,
+                       fidl::Array<uint8_t> page_token,
+                       const Page::GetChangesSinceCallback& callback);
+
   void Put(fidl::Array<uint8_t> key,
            fidl::Array<uint8_t> value,
            const Page::PutCallback& callback);
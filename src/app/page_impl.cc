@@ -7,11 +7,13 @@
 #include "apps/ledger/src/app/page_delegate.h"
 #include "apps/ledger/src/callback/trace_callback.h"
 #include "apps/tracing/lib/trace/event.h"
+#include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/logging.h"
 
 namespace ledger {
 
-PageImpl::PageImpl(PageDelegate* delegate) : delegate_(delegate) {}
+PageImpl::PageImpl(PageDelegate* delegate, PageRecorder* recorder)
+    : delegate_(delegate), recorder_(recorder) {}
 
 PageImpl::~PageImpl() {}
 
@@ -27,9 +29,40 @@ void PageImpl::GetSnapshot(
     fidl::Array<uint8_t> key_prefix,
     fidl::InterfaceHandle<PageWatcher> watcher,
     const GetSnapshotCallback& callback) {
-  auto timed_callback = TRACE_CALLBACK(callback, "ledger", "page_get_snapshot");
-  delegate_->GetSnapshot(std::move(snapshot_request), std::move(key_prefix),
-                         std::move(watcher), std::move(timed_callback));
+  GetSnapshotInternal(std::move(snapshot_request), std::move(key_prefix),
+                      std::move(watcher), nullptr, callback);
+}
+
+// GetSnapshotWithWatcherOptions(PageSnapshot& snapshot,
+//                               array<uint8>? key_prefix,
+//                               PageWatcher? watcher,
+//                               WatcherOptions? watcher_options)
+//   => (Status status);
+void PageImpl::GetSnapshotWithWatcherOptions(
+    fidl::InterfaceRequest<PageSnapshot> snapshot_request,
+    fidl::Array<uint8_t> key_prefix,
+    fidl::InterfaceHandle<PageWatcher> watcher,
+    WatcherOptionsPtr watcher_options,
+    const GetSnapshotWithWatcherOptionsCallback& callback) {
+  GetSnapshotInternal(std::move(snapshot_request), std::move(key_prefix),
+                      std::move(watcher), std::move(watcher_options),
+                      callback);
+}
+
+// GetChangesSince(array<uint8>? token, array<uint8>? page_token)
+//   => (Status status, PageChange? change, array<uint8>? next_page_token,
+//       array<uint8>? new_token);
+void PageImpl::GetChangesSince(fidl::Array<uint8_t> token,
+                               fidl::Array<uint8_t> page_token,
+                               const GetChangesSinceCallback& callback) {
+  RecordedOperation operation = Record("Page.GetChangesSince");
+  operation.SetNumber("token", !token.is_null());
+  operation.SetNumber("page_token", !page_token.is_null());
+  auto timed_callback =
+      TRACE_CALLBACK(TrackOperation(std::move(operation), callback), "ledger",
+                     "page_get_changes_since");
+  delegate_->GetChangesSince(std::move(token), std::move(page_token),
+                             std::move(timed_callback));
 }
 
 // Put(array<uint8> key, array<uint8> value) => (Status status);
@@ -45,8 +78,13 @@ void PageImpl::PutWithPriority(fidl::Array<uint8_t> key,
                                fidl::Array<uint8_t> value,
                                Priority priority,
                                const PutWithPriorityCallback& callback) {
+  RecordedOperation operation = Record("Page.PutWithPriority");
+  operation.SetKey("key", key);
+  operation.SetNumber("value_size", value.size());
+  operation.SetNumber("priority", static_cast<int64_t>(priority));
   auto timed_callback =
-      TRACE_CALLBACK(callback, "ledger", "page_put_with_priority");
+      TRACE_CALLBACK(TrackOperation(std::move(operation), callback), "ledger",
+                     "page_put_with_priority");
   delegate_->PutWithPriority(std::move(key), std::move(value), priority,
                              std::move(timed_callback));
 }
@@ -57,8 +95,16 @@ void PageImpl::PutReference(fidl::Array<uint8_t> key,
                             ReferencePtr reference,
                             Priority priority,
                             const PutReferenceCallback& callback) {
+  RecordedOperation operation = Record("Page.PutReference");
+  if (operation.enabled() && reference) {
+    operation.SetKey("key", key);
+    operation.SetNumber("reference",
+                        recorder_->GetReferenceIndex(reference->opaque_id));
+    operation.SetNumber("priority", static_cast<int64_t>(priority));
+  }
   auto timed_callback =
-      TRACE_CALLBACK(callback, "ledger", "page_put_reference");
+      TRACE_CALLBACK(TrackOperation(std::move(operation), callback), "ledger",
+                     "page_put_reference");
   delegate_->PutReference(std::move(key), std::move(reference), priority,
                           std::move(timed_callback));
 }
@@ -66,7 +112,11 @@ void PageImpl::PutReference(fidl::Array<uint8_t> key,
 // Delete(array<uint8> key) => (Status status);
 void PageImpl::Delete(fidl::Array<uint8_t> key,
                       const DeleteCallback& callback) {
-  auto timed_callback = TRACE_CALLBACK(callback, "ledger", "page_delete");
+  RecordedOperation operation = Record("Page.Delete");
+  operation.SetKey("key", key);
+  auto timed_callback =
+      TRACE_CALLBACK(TrackOperation(std::move(operation), callback), "ledger",
+                     "page_delete");
   delegate_->Delete(std::move(key), std::move(timed_callback));
 }
 
@@ -76,8 +126,11 @@ void PageImpl::CreateReferenceFromSocket(
     uint64_t size,
     mx::socket data,
     const CreateReferenceFromSocketCallback& callback) {
+  RecordedOperation operation = Record("Page.CreateReferenceFromSocket");
+  operation.SetNumber("size", size);
   auto timed_callback =
-      TRACE_CALLBACK(callback, "ledger", "page_create_reference_from_socket");
+      TRACE_CALLBACK(TrackReference(std::move(operation), callback), "ledger",
+                     "page_create_reference_from_socket");
   delegate_->CreateReference(storage::DataSource::Create(std::move(data), size),
                              std::move(timed_callback));
 }
@@ -87,28 +140,39 @@ void PageImpl::CreateReferenceFromSocket(
 void PageImpl::CreateReferenceFromVmo(
     mx::vmo data,
     const CreateReferenceFromSocketCallback& callback) {
+  RecordedOperation operation = Record("Page.CreateReferenceFromVmo");
+  uint64_t size;
+  if (operation.enabled() && data.get_size(&size) == MX_OK) {
+    operation.SetNumber("size", size);
+  }
   auto timed_callback =
-      TRACE_CALLBACK(callback, "ledger", "page_create_reference_from_vmo");
+      TRACE_CALLBACK(TrackReference(std::move(operation), callback), "ledger",
+                     "page_create_reference_from_vmo");
   delegate_->CreateReference(storage::DataSource::Create(std::move(data)),
                              std::move(timed_callback));
 }
 
 // StartTransaction() => (Status status);
 void PageImpl::StartTransaction(const StartTransactionCallback& callback) {
-  auto timed_callback =
-      TRACE_CALLBACK(callback, "ledger", "page_start_transaction");
+  auto timed_callback = TRACE_CALLBACK(
+      TrackOperation(Record("Page.StartTransaction"), callback), "ledger",
+      "page_start_transaction");
   delegate_->StartTransaction(std::move(timed_callback));
 }
 
 // Commit() => (Status status);
 void PageImpl::Commit(const CommitCallback& callback) {
-  auto timed_callback = TRACE_CALLBACK(callback, "ledger", "page_commit");
+  auto timed_callback =
+      TRACE_CALLBACK(TrackOperation(Record("Page.Commit"), callback), "ledger",
+                     "page_commit");
   delegate_->Commit(std::move(timed_callback));
 }
 
 // Rollback() => (Status status);
 void PageImpl::Rollback(const RollbackCallback& callback) {
-  auto timed_callback = TRACE_CALLBACK(callback, "ledger", "page_rollback");
+  auto timed_callback =
+      TRACE_CALLBACK(TrackOperation(Record("Page.Rollback"), callback),
+                     "ledger", "page_rollback");
   delegate_->Rollback(std::move(timed_callback));
 }
 
@@ -119,4 +183,64 @@ void PageImpl::SetSyncStateWatcher(
   delegate_->SetSyncStateWatcher(std::move(watcher), callback);
 }
 
+RecordedOperation PageImpl::Record(ftl::StringView method) {
+  if (!recorder_) {
+    return RecordedOperation();
+  }
+  return recorder_->Start(method);
+}
+
+void PageImpl::GetSnapshotInternal(
+    fidl::InterfaceRequest<PageSnapshot> snapshot_request,
+    fidl::Array<uint8_t> key_prefix,
+    fidl::InterfaceHandle<PageWatcher> watcher,
+    WatcherOptionsPtr watcher_options,
+    const GetSnapshotCallback& callback) {
+  GetSnapshotCallback recorded_callback = callback;
+  RecordedOperation operation = Record("Page.GetSnapshot");
+  if (operation.enabled()) {
+    operation.SetKey("key_prefix", key_prefix);
+    operation.SetNumber("watcher", static_cast<bool>(watcher));
+    if (watcher_options) {
+      operation.SetNumber("min_delivery_interval_ms",
+                          watcher_options->min_delivery_interval_ms);
+      operation.SetNumber("max_batch_size", watcher_options->max_batch_size);
+    }
+    recorded_callback = ftl::MakeCopyable([
+      recorder = recorder_, operation = std::move(operation), callback
+    ](Status status) mutable {
+      // The snapshot is bound right before the callback is called.
+      if (status == Status::OK) {
+        operation.SetNumber("snapshot", recorder->last_snapshot_index());
+      }
+      operation.Done(status);
+      callback(status);
+    });
+  }
+  auto timed_callback = TRACE_CALLBACK(std::move(recorded_callback), "ledger",
+                                       "page_get_snapshot");
+  delegate_->GetSnapshot(std::move(snapshot_request), std::move(key_prefix),
+                         std::move(watcher), std::move(watcher_options),
+                         std::move(timed_callback));
+}
+
+std::function<void(Status, ReferencePtr)> PageImpl::TrackReference(
+    RecordedOperation operation,
+    std::function<void(Status, ReferencePtr)> callback) {
+  if (!operation.enabled()) {
+    return callback;
+  }
+  return ftl::MakeCopyable([
+    recorder = recorder_, operation = std::move(operation),
+    callback = std::move(callback)
+  ](Status status, ReferencePtr reference) mutable {
+    if (reference) {
+      operation.SetNumber("reference",
+                          recorder->GetReferenceIndex(reference->opaque_id));
+    }
+    operation.Done(status);
+    callback(status, std::move(reference));
+  });
+}
+
 }  // namespace ledger
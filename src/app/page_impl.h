@@ -5,8 +5,12 @@
 #ifndef APPS_LEDGER_SRC_APP_PAGE_IMPL_H_
 #define APPS_LEDGER_SRC_APP_PAGE_IMPL_H_
 
+#include <functional>
+
 #include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/app/operation_recorder.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
 
 namespace ledger {
 class PageDelegate;
@@ -14,7 +18,8 @@ class PageDelegate;
 // An implementation of the |Page| FIDL interface.
 class PageImpl : public Page {
  public:
-  explicit PageImpl(PageDelegate* delegate);
+  // |recorder| may be null, if the operations are not recorded.
+  PageImpl(PageDelegate* delegate, PageRecorder* recorder);
   ~PageImpl() override;
 
  private:
@@ -26,6 +31,17 @@ class PageImpl : public Page {
                    fidl::InterfaceHandle<PageWatcher> watcher,
                    const GetSnapshotCallback& callback) override;
 
+  void GetSnapshotWithWatcherOptions(
+      fidl::InterfaceRequest<PageSnapshot> snapshot_request,
+      fidl::Array<uint8_t> key_prefix,
+      fidl::InterfaceHandle<PageWatcher> watcher,
+      WatcherOptionsPtr watcher_options,
+      const GetSnapshotWithWatcherOptionsCallback& callback) override;
+
+  void GetChangesSince(fidl::Array<uint8_t> token,
+                       fidl::Array<uint8_t> page_token,
+                       const GetChangesSinceCallback& callback) override;
+
   void Put(fidl::Array<uint8_t> key,
            fidl::Array<uint8_t> value,
            const PutCallback& callback) override;
@@ -62,7 +78,23 @@ class PageImpl : public Page {
       fidl::InterfaceHandle<SyncWatcher> watcher,
       const SetSyncStateWatcherCallback& callback) override;
 
+  RecordedOperation Record(ftl::StringView method);
+
+  void GetSnapshotInternal(
+      fidl::InterfaceRequest<PageSnapshot> snapshot_request,
+      fidl::Array<uint8_t> key_prefix,
+      fidl::InterfaceHandle<PageWatcher> watcher,
+      WatcherOptionsPtr watcher_options,
+      const GetSnapshotCallback& callback);
+
+  // Returns |callback|, recording |operation| together with the reference it
+  // is called with.
+  std::function<void(Status, ReferencePtr)> TrackReference(
+      RecordedOperation operation,
+      std::function<void(Status, ReferencePtr)> callback);
+
   PageDelegate* delegate_;
+  PageRecorder* const recorder_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(PageImpl);
 };
@@ -7,6 +7,7 @@
 #include <algorithm>
 
 #include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/logging.h"
 
 namespace ledger {
@@ -16,6 +17,7 @@ PageManager::PageManager(
     std::unique_ptr<storage::PageStorage> page_storage,
     std::unique_ptr<cloud_sync::PageSyncContext> page_sync_context,
     std::unique_ptr<MergeResolver> merge_resolver,
+    PageStorageState page_storage_state,
     ftl::TimeDelta sync_timeout)
     : environment_(environment),
       page_storage_(std::move(page_storage)),
@@ -23,25 +25,36 @@ PageManager::PageManager(
       merge_resolver_(std::move(merge_resolver)),
       sync_timeout_(sync_timeout),
       weak_factory_(this) {
+  if (environment_->operation_recorder()) {
+    recorder_ = std::make_unique<PageRecorder>(
+        environment_->operation_recorder(), page_storage_->GetId());
+  }
   pages_.set_on_empty([this] { CheckEmpty(); });
   snapshots_.set_on_empty([this] { CheckEmpty(); });
 
   if (page_sync_context_) {
     page_sync_context_->page_sync->SetSyncWatcher(&watchers_);
     page_sync_context_->page_sync->SetOnIdle([this] { CheckEmpty(); });
-    page_sync_context_->page_sync->SetOnBacklogDownloaded(
-        [this] { OnSyncBacklogDownloaded(); });
+    if (page_storage_state == PageStorageState::NEEDS_SYNC) {
+      TRACE_ASYNC_BEGIN("ledger", "page_sync_catch_up",
+                        reinterpret_cast<uintptr_t>(this));
+      page_sync_context_->page_sync->SetOnBacklogDownloaded(
+          [this] { OnSyncBacklogDownloaded(); });
+      environment_->main_runner()->PostDelayedTask(
+          [weak_this = weak_factory_.GetWeakPtr()]() {
+            if (weak_this && !weak_this->sync_backlog_downloaded_) {
+              FTL_LOG(INFO) << "Initial sync will continue in background, "
+                            << "in the meantime binding to local page data "
+                            << "(might be stale or empty).";
+              weak_this->OnSyncBacklogDownloaded();
+            }
+          },
+          sync_timeout_);
+    } else {
+      // The sync keeps the page up to date, there is no backlog to wait for.
+      sync_backlog_downloaded_ = true;
+    }
     page_sync_context_->page_sync->Start();
-    environment_->main_runner()->PostDelayedTask(
-        [weak_this = weak_factory_.GetWeakPtr()]() {
-          if (weak_this && !weak_this->sync_backlog_downloaded_) {
-            FTL_LOG(INFO) << "Initial sync will continue in background, "
-                          << "in the meantime binding to local page data "
-                          << "(might be stale or empty).";
-            weak_this->OnSyncBacklogDownloaded();
-          }
-        },
-        sync_timeout_);
   } else {
     sync_backlog_downloaded_ = true;
   }
@@ -50,6 +63,10 @@ PageManager::PageManager(
 }
 
 PageManager::~PageManager() {
+  if (!sync_backlog_downloaded_) {
+    TRACE_ASYNC_END("ledger", "page_sync_catch_up",
+                    reinterpret_cast<uintptr_t>(this));
+  }
   for (const auto& request : page_requests_) {
     request.second(Status::INTERNAL_ERROR);
   }
@@ -60,7 +77,7 @@ void PageManager::BindPage(fidl::InterfaceRequest<Page> page_request,
                            std::function<void(Status)> on_done) {
   if (sync_backlog_downloaded_) {
     pages_
-        .emplace(environment_->coroutine_service(), this, page_storage_.get(),
+        .emplace(environment_, this, page_storage_.get(),
                  std::move(page_request), &watchers_)
         .Init(std::move(on_done));
     return;
@@ -73,7 +90,13 @@ void PageManager::BindPageSnapshot(
     fidl::InterfaceRequest<PageSnapshot> snapshot_request,
     std::string key_prefix) {
   snapshots_.emplace(std::move(snapshot_request), page_storage_.get(),
-                     std::move(commit), std::move(key_prefix));
+                     std::move(commit), std::move(key_prefix),
+                     recorder_.get());
+}
+
+std::unique_ptr<storage::PageStorage> PageManager::ReleasePageStorage() {
+  page_sync_context_.reset();
+  return std::move(page_storage_);
 }
 
 void PageManager::CheckEmpty() {
@@ -88,6 +111,9 @@ void PageManager::OnSyncBacklogDownloaded() {
   if (sync_backlog_downloaded_) {
     FTL_LOG(INFO) << "Initial sync in background finished. "
                   << "Clients will receive a change notification.";
+  } else {
+    TRACE_ASYNC_END("ledger", "page_sync_catch_up",
+                    reinterpret_cast<uintptr_t>(this));
   }
   sync_backlog_downloaded_ = true;
   for (auto& page_request : page_requests_) {
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "apps/ledger/src/app/merging/merge_resolver.h"
+#include "apps/ledger/src/app/operation_recorder.h"
 #include "apps/ledger/src/app/page_delegate.h"
 #include "apps/ledger/src/app/page_snapshot_impl.h"
 #include "apps/ledger/src/app/sync_watcher_set.h"
@@ -35,12 +36,25 @@ namespace ledger {
 // |on_empty_callback|.
 class PageManager {
  public:
+  // Whether the page storage needs to catch up with the cloud before the pages
+  // are bound.
+  enum class PageStorageState {
+    // The pages are bound once the sync downloaded the backlog of remote
+    // commits, or after |sync_timeout|.
+    NEEDS_SYNC,
+    // The page storage is already up to date, for instance because it was
+    // synced in the background. The pages are bound right away.
+    UP_TO_DATE,
+  };
+
   // Both |page_storage| and |page_sync| are owned by PageManager and are
   // deleted when it goes away.
   PageManager(Environment* environment,
               std::unique_ptr<storage::PageStorage> page_storage,
               std::unique_ptr<cloud_sync::PageSyncContext> page_sync_context,
               std::unique_ptr<MergeResolver> merge_resolver,
+              PageStorageState page_storage_state =
+                  PageStorageState::NEEDS_SYNC,
               ftl::TimeDelta sync_timeout = ftl::TimeDelta::FromSeconds(5));
   ~PageManager();
 
@@ -55,6 +69,20 @@ class PageManager {
                         fidl::InterfaceRequest<PageSnapshot> snapshot_request,
                         std::string key_prefix);
 
+  // Stops the sync of the page and hands the page storage over to the caller,
+  // so that it outlives this PageManager. This PageManager must be deleted
+  // right after this call.
+  std::unique_ptr<storage::PageStorage> ReleasePageStorage();
+
+  // Returns an estimate of the memory, in bytes, held by the page storage.
+  uint64_t GetApproximateMemoryUsage() {
+    return page_storage_->GetApproximateMemoryUsage();
+  }
+
+  // Returns the recorder of the operations made on this page, or nullptr if
+  // they are not recorded.
+  PageRecorder* recorder() { return recorder_.get(); }
+
   void set_on_empty(const ftl::Closure& on_empty_callback) {
     on_empty_callback_ = on_empty_callback;
   }
@@ -68,6 +96,7 @@ class PageManager {
   std::unique_ptr<cloud_sync::PageSyncContext> page_sync_context_;
   std::unique_ptr<MergeResolver> merge_resolver_;
   const ftl::TimeDelta sync_timeout_;
+  std::unique_ptr<PageRecorder> recorder_;
   callback::AutoCleanableSet<
       fidl_helpers::BoundInterface<PageSnapshot, PageSnapshotImpl>>
       snapshots_;
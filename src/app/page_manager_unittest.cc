@@ -270,6 +270,7 @@ TEST_F(PageManagerTest, DelayBindingUntilSyncTimeout) {
 
   PageManager page_manager(&environment_, std::move(storage),
                            std::move(page_sync_context), std::move(merger),
+                           PageManager::PageStorageState::NEEDS_SYNC,
                            ftl::TimeDelta::FromSeconds(0));
 
   EXPECT_NE(nullptr, fake_page_sync_ptr->watcher);
@@ -292,6 +293,31 @@ TEST_F(PageManagerTest, DelayBindingUntilSyncTimeout) {
   EXPECT_TRUE(called);
 }
 
+TEST_F(PageManagerTest, NoDelayBindingWhenStorageUpToDate) {
+  auto fake_page_sync = std::make_unique<FakePageSync>();
+  auto fake_page_sync_ptr = fake_page_sync.get();
+  auto page_sync_context = std::make_unique<cloud_sync::PageSyncContext>();
+  page_sync_context->page_sync = std::move(fake_page_sync);
+  auto storage = std::make_unique<storage::fake::FakePageStorage>(page_id_);
+  auto merger = GetDummyResolver(&environment_, storage.get());
+
+  PageManager page_manager(&environment_, std::move(storage),
+                           std::move(page_sync_context), std::move(merger),
+                           PageManager::PageStorageState::UP_TO_DATE);
+
+  EXPECT_NE(nullptr, fake_page_sync_ptr->watcher);
+  EXPECT_TRUE(fake_page_sync_ptr->start_called);
+  EXPECT_FALSE(fake_page_sync_ptr->on_backlog_downloaded_callback);
+
+  // The page is bound without waiting for the sync backlog.
+  Status status;
+  PagePtr page;
+  page_manager.BindPage(page.NewRequest(),
+                        callback::Capture(MakeQuitTask(), &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+}
+
 TEST_F(PageManagerTest, ExitWhenSyncFinishes) {
   auto fake_page_sync = std::make_unique<FakePageSync>();
   auto fake_page_sync_ptr = fake_page_sync.get();
@@ -306,6 +332,7 @@ TEST_F(PageManagerTest, ExitWhenSyncFinishes) {
 
   PageManager page_manager(&environment_, std::move(storage),
                            std::move(page_sync_context), std::move(merger),
+                           PageManager::PageStorageState::NEEDS_SYNC,
                            ftl::TimeDelta::FromSeconds(0));
 
   EXPECT_NE(nullptr, fake_page_sync_ptr->watcher);
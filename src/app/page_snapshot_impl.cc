@@ -231,26 +231,37 @@ void FillEntries(
 PageSnapshotImpl::PageSnapshotImpl(
     storage::PageStorage* page_storage,
     std::unique_ptr<const storage::Commit> commit,
-    std::string key_prefix)
+    std::string key_prefix,
+    PageRecorder* recorder)
     : page_storage_(page_storage),
       commit_(std::move(commit)),
-      key_prefix_(std::move(key_prefix)) {}
+      key_prefix_(std::move(key_prefix)),
+      recorder_(recorder),
+      snapshot_index_(recorder ? recorder->NewSnapshotIndex() : 0u) {}
 
 PageSnapshotImpl::~PageSnapshotImpl() {}
 
 void PageSnapshotImpl::GetEntries(fidl::Array<uint8_t> key_start,
                                   fidl::Array<uint8_t> token,
                                   const GetEntriesCallback& callback) {
+  RecordedOperation operation = Record("PageSnapshot.GetEntries");
+  operation.SetKey("key_start", key_start);
+  operation.SetNumber("token", !token.is_null());
   FillEntries<Entry>(page_storage_, key_prefix_, commit_.get(),
-                     std::move(key_start), std::move(token), callback);
+                     std::move(key_start), std::move(token),
+                     TrackOperation(std::move(operation), callback));
 }
 
 void PageSnapshotImpl::GetEntriesInline(
     fidl::Array<uint8_t> key_start,
     fidl::Array<uint8_t> token,
     const GetEntriesInlineCallback& callback) {
+  RecordedOperation operation = Record("PageSnapshot.GetEntriesInline");
+  operation.SetKey("key_start", key_start);
+  operation.SetNumber("token", !token.is_null());
   FillEntries<InlinedEntry>(page_storage_, key_prefix_, commit_.get(),
-                            std::move(key_start), std::move(token), callback);
+                            std::move(key_start), std::move(token),
+                            TrackOperation(std::move(operation), callback));
 }
 
 void PageSnapshotImpl::GetKeys(fidl::Array<uint8_t> key_start,
@@ -269,7 +280,12 @@ void PageSnapshotImpl::GetKeys(fidl::Array<uint8_t> key_start,
     std::string next_token = "";
   };
 
-  auto timed_callback = TRACE_CALLBACK(callback, "ledger", "snapshot_get_keys");
+  RecordedOperation operation = Record("PageSnapshot.GetKeys");
+  operation.SetKey("key_start", key_start);
+  operation.SetNumber("token", !token.is_null());
+  auto timed_callback =
+      TRACE_CALLBACK(TrackOperation(std::move(operation), callback), "ledger",
+                     "snapshot_get_keys");
 
   auto context = std::make_unique<Context>();
   auto on_next = ftl::MakeCopyable(
@@ -308,7 +324,11 @@ void PageSnapshotImpl::GetKeys(fidl::Array<uint8_t> key_start,
 
 void PageSnapshotImpl::Get(fidl::Array<uint8_t> key,
                            const GetCallback& callback) {
-  auto timed_callback = TRACE_CALLBACK(callback, "ledger", "snapshot_get");
+  RecordedOperation operation = Record("PageSnapshot.Get");
+  operation.SetKey("key", key);
+  auto timed_callback =
+      TRACE_CALLBACK(TrackOperation(std::move(operation), callback), "ledger",
+                     "snapshot_get");
 
   page_storage_->GetEntryFromCommit(*commit_, convert::ToString(key), [
     this, callback = std::move(timed_callback)
@@ -327,8 +347,11 @@ void PageSnapshotImpl::Get(fidl::Array<uint8_t> key,
 
 void PageSnapshotImpl::GetInline(fidl::Array<uint8_t> key,
                                  const GetInlineCallback& callback) {
+  RecordedOperation operation = Record("PageSnapshot.GetInline");
+  operation.SetKey("key", key);
   auto timed_callback =
-      TRACE_CALLBACK(callback, "ledger", "snapshot_get_inline");
+      TRACE_CALLBACK(TrackOperation(std::move(operation), callback), "ledger",
+                     "snapshot_get_inline");
 
   page_storage_->GetEntryFromCommit(*commit_, convert::ToString(key), [
     this, callback = std::move(timed_callback)
@@ -357,7 +380,11 @@ void PageSnapshotImpl::GetInline(fidl::Array<uint8_t> key,
 
 void PageSnapshotImpl::Fetch(fidl::Array<uint8_t> key,
                              const FetchCallback& callback) {
-  auto timed_callback = TRACE_CALLBACK(callback, "ledger", "snapshot_fetch");
+  RecordedOperation operation = Record("PageSnapshot.Fetch");
+  operation.SetKey("key", key);
+  auto timed_callback =
+      TRACE_CALLBACK(TrackOperation(std::move(operation), callback), "ledger",
+                     "snapshot_fetch");
 
   page_storage_->GetEntryFromCommit(*commit_, convert::ToString(key), [
     this, callback = std::move(timed_callback)
@@ -378,8 +405,13 @@ void PageSnapshotImpl::FetchPartial(fidl::Array<uint8_t> key,
                                     int64_t offset,
                                     int64_t max_size,
                                     const FetchPartialCallback& callback) {
+  RecordedOperation operation = Record("PageSnapshot.FetchPartial");
+  operation.SetKey("key", key);
+  operation.SetNumber("offset", offset);
+  operation.SetNumber("max_size", max_size);
   auto timed_callback =
-      TRACE_CALLBACK(callback, "ledger", "snapshot_fetch_partial");
+      TRACE_CALLBACK(TrackOperation(std::move(operation), callback), "ledger",
+                     "snapshot_fetch_partial");
 
   page_storage_->GetEntryFromCommit(*commit_, convert::ToString(key), [
     this, offset, max_size, callback = std::move(timed_callback)
@@ -397,4 +429,13 @@ void PageSnapshotImpl::FetchPartial(fidl::Array<uint8_t> key,
   });
 }
 
+RecordedOperation PageSnapshotImpl::Record(ftl::StringView method) {
+  if (!recorder_) {
+    return RecordedOperation();
+  }
+  RecordedOperation operation = recorder_->Start(method);
+  operation.SetNumber("snapshot", snapshot_index_);
+  return operation;
+}
+
 }  // namespace ledger
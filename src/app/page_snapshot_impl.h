@@ -8,8 +8,10 @@
 #include <memory>
 
 #include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/app/operation_recorder.h"
 #include "apps/ledger/src/storage/public/commit.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
+#include "lib/ftl/strings/string_view.h"
 #include "lib/ftl/tasks/task_runner.h"
 
 namespace ledger {
@@ -17,9 +19,11 @@ namespace ledger {
 // An implementation of the |PageSnapshot| FIDL interface.
 class PageSnapshotImpl : public PageSnapshot {
  public:
+  // |recorder| may be null, if the operations are not recorded.
   PageSnapshotImpl(storage::PageStorage* page_storage,
                    std::unique_ptr<const storage::Commit> commit,
-                   std::string key_prefix);
+                   std::string key_prefix,
+                   PageRecorder* recorder);
   ~PageSnapshotImpl() override;
 
  private:
@@ -42,9 +46,14 @@ class PageSnapshotImpl : public PageSnapshot {
                     int64_t max_size,
                     const FetchPartialCallback& callback) override;
 
+  RecordedOperation Record(ftl::StringView method);
+
   storage::PageStorage* page_storage_;
   std::unique_ptr<const storage::Commit> commit_;
   const std::string key_prefix_;
+  PageRecorder* const recorder_;
+  // Index of this snapshot in the recorded operations.
+  const uint64_t snapshot_index_;
 };
 
 }  // namespace ledger
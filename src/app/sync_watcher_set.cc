@@ -38,6 +38,14 @@ SyncState ConvertToSyncState(cloud_sync::UploadSyncState upload) {
   }
 }
 
+// Returns whether |lhs| and |rhs| are reported the same way to the clients, as
+// the queue position is not part of the FIDL interface.
+bool IsSameClientState(
+    const cloud_sync::SyncStateWatcher::SyncStateContainer& lhs,
+    const cloud_sync::SyncStateWatcher::SyncStateContainer& rhs) {
+  return lhs.download == rhs.download && lhs.upload == rhs.upload;
+}
+
 }  // namespace
 
 class SyncWatcherSet::SyncWatcherContainer
@@ -54,7 +62,7 @@ class SyncWatcherSet::SyncWatcherContainer
   }
 
   void Notify(SyncStateContainer sync_state) override {
-    if (sync_state == pending_) {
+    if (IsSameClientState(sync_state, pending_)) {
       return;
     }
     pending_ = sync_state;
@@ -70,7 +78,8 @@ class SyncWatcherSet::SyncWatcherContainer
 
  private:
   void SendIfPending() {
-    if (!watcher_ || notification_in_progress_ || last_ == pending_) {
+    if (!watcher_ || notification_in_progress_ ||
+        IsSameClientState(last_, pending_)) {
       return;
     }
     Send();
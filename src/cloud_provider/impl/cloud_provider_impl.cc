@@ -5,6 +5,7 @@
 #include "apps/ledger/src/cloud_provider/impl/cloud_provider_impl.h"
 
 #include "apps/ledger/src/cloud_provider/impl/encoding.h"
+#include "apps/ledger/src/cloud_provider/impl/object_pack.h"
 #include "apps/ledger/src/cloud_provider/impl/timestamp_conversions.h"
 #include "apps/ledger/src/firebase/encoding.h"
 #include "apps/ledger/src/firebase/status.h"
@@ -19,11 +20,23 @@ namespace cloud_provider {
 namespace {
 // The root path under which all commits are stored.
 constexpr ftl::StringView kCommitRoot = "commits";
+// Prefix of the cloud storage keys of the object packs, keeping them apart from
+// the keys of the objects.
+constexpr ftl::StringView kPackKeyPrefix = "pack_";
+
+std::string GetPackKey(ObjectIdView pack_id) {
+  std::string key = kPackKeyPrefix.ToString();
+  firebase::AppendEncodedKey(pack_id, &key);
+  return key;
+}
 }  // namespace
 
 CloudProviderImpl::CloudProviderImpl(firebase::Firebase* firebase,
-                                     gcs::CloudStorage* cloud_storage)
-    : firebase_(firebase), cloud_storage_(cloud_storage) {}
+                                     gcs::CloudStorage* cloud_storage,
+                                     bool compress_commits)
+    : firebase_(firebase),
+      cloud_storage_(cloud_storage),
+      compress_commits_(compress_commits) {}
 
 CloudProviderImpl::~CloudProviderImpl() {}
 
@@ -32,10 +45,10 @@ void CloudProviderImpl::AddCommits(
     std::vector<Commit> commits,
     const std::function<void(Status)>& callback) {
   std::string encoded_batch;
-  bool ok = EncodeCommits(commits, &encoded_batch);
+  bool ok = EncodeCommits(commits, &encoded_batch, compress_commits_);
   FTL_DCHECK(ok);
 
-  firebase_->Patch(kCommitRoot.ToString(), GetQueryParams(auth_token, ""),
+  firebase_->Patch(kCommitRoot.ToString(), GetQueryParams(auth_token, "", 0u),
                    encoded_batch, [callback](firebase::Status status) {
                      callback(ConvertFirebaseStatus(status));
                    });
@@ -46,7 +59,7 @@ void CloudProviderImpl::WatchCommits(const std::string& auth_token,
                                      CommitWatcher* watcher) {
   watchers_[watcher] = std::make_unique<WatchClientImpl>(
       firebase_, kCommitRoot.ToString(),
-      GetQueryParams(auth_token, min_timestamp), watcher);
+      GetQueryParams(auth_token, min_timestamp, 0u), watcher);
 }
 
 void CloudProviderImpl::UnwatchCommits(CommitWatcher* watcher) {
@@ -56,29 +69,28 @@ void CloudProviderImpl::UnwatchCommits(CommitWatcher* watcher) {
 void CloudProviderImpl::GetCommits(
     const std::string& auth_token,
     const std::string& min_timestamp,
+    size_t max_count,
     std::function<void(Status, std::vector<Record>)> callback) {
-  firebase_->Get(
-      kCommitRoot.ToString(), GetQueryParams(auth_token, min_timestamp),
-      [callback](firebase::Status status, const rapidjson::Value& value) {
+  // The commits are decoded as they are received, so that the raw response is
+  // never held in memory as a whole.
+  firebase_->GetStream(
+      kCommitRoot.ToString(),
+      GetQueryParams(auth_token, min_timestamp, max_count),
+      [ this, callback = std::move(callback) ](firebase::Status status,
+                                               mx::socket data) {
         if (status != firebase::Status::OK) {
           callback(ConvertFirebaseStatus(status), std::vector<Record>());
           return;
         }
-        if (value.IsNull()) {
-          // No commits synced for this page yet.
-          callback(Status::OK, std::vector<Record>());
-          return;
-        }
-        if (!value.IsObject()) {
-          callback(Status::PARSE_ERROR, std::vector<Record>());
-          return;
-        }
-        std::vector<Record> records;
-        if (!DecodeMultipleCommitsFromValue(value, &records)) {
-          callback(Status::PARSE_ERROR, std::vector<Record>());
-          return;
-        }
-        callback(Status::OK, std::move(records));
+        auto& drainer = commits_drainers_.emplace();
+        drainer.Start(std::move(data), [callback](bool success,
+                                                  std::vector<Record> records) {
+          if (!success) {
+            callback(Status::PARSE_ERROR, std::vector<Record>());
+            return;
+          }
+          callback(Status::OK, std::move(records));
+        });
       });
 }
 
@@ -99,31 +111,81 @@ void CloudProviderImpl::AddObject(const std::string& auth_token,
 void CloudProviderImpl::GetObject(
     const std::string& auth_token,
     ObjectIdView object_id,
+    ledger::RequestPriority priority,
     std::function<void(Status status, uint64_t size, mx::socket data)>
         callback) {
   cloud_storage_->DownloadObject(
-      auth_token, firebase::EncodeKey(object_id),
+      auth_token, firebase::EncodeKey(object_id), priority,
       [callback = std::move(callback)](gcs::Status status, uint64_t size,
                                        mx::socket data) {
         callback(ConvertGcsStatus(status), size, std::move(data));
       });
 }
 
+void CloudProviderImpl::AddObjectPack(const std::string& auth_token,
+                                      ObjectIdView pack_id,
+                                      std::map<ObjectId, Data> objects,
+                                      std::function<void(Status)> callback) {
+  mx::vmo data;
+  if (!mtl::VmoFromString(EncodeObjectPack(objects), &data)) {
+    callback(Status::INTERNAL_ERROR);
+    return;
+  }
+  cloud_storage_->UploadObject(
+      auth_token, GetPackKey(pack_id), std::move(data),
+      [callback = std::move(callback)](gcs::Status status) {
+        callback(ConvertGcsStatus(status));
+      });
+}
+
+void CloudProviderImpl::GetObjectPack(
+    const std::string& auth_token,
+    ObjectIdView pack_id,
+    std::function<void(Status, std::map<ObjectId, Data>)> callback) {
+  cloud_storage_->DownloadObject(
+      auth_token, GetPackKey(pack_id), ledger::RequestPriority::NORMAL,
+      [ this, callback = std::move(callback) ](gcs::Status status, uint64_t size,
+                                               mx::socket data) mutable {
+        if (status != gcs::Status::OK) {
+          callback(ConvertGcsStatus(status), std::map<ObjectId, Data>());
+          return;
+        }
+        auto& drainer = drainers_.emplace();
+        drainer.Start(std::move(data), [ callback = std::move(callback),
+                                         size ](std::string pack) {
+          std::map<ObjectId, Data> objects;
+          if (pack.size() != size || !DecodeObjectPack(pack, &objects)) {
+            callback(Status::PARSE_ERROR, std::map<ObjectId, Data>());
+            return;
+          }
+          callback(Status::OK, std::move(objects));
+        });
+      });
+}
+
 std::vector<std::string> CloudProviderImpl::GetQueryParams(
     const std::string& auth_token,
-    const std::string& min_timestamp) {
+    const std::string& min_timestamp,
+    size_t max_count) {
   std::vector<std::string> result;
 
   if (!auth_token.empty()) {
     result.push_back("auth=" + auth_token);
   }
 
-  if (!min_timestamp.empty()) {
+  if (!min_timestamp.empty() || max_count) {
     result.emplace_back("orderBy=\"timestamp\"");
+  }
+
+  if (!min_timestamp.empty()) {
     result.push_back("startAt=" + ftl::NumberToString(
                                       BytesToServerTimestamp(min_timestamp)));
   }
 
+  if (max_count) {
+    result.push_back("limitToFirst=" + ftl::NumberToString(max_count));
+  }
+
   return result;
 }
 
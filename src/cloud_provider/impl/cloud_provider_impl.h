@@ -9,21 +9,27 @@
 #include <memory>
 #include <string>
 
+#include "apps/ledger/src/callback/auto_cleanable.h"
+#include "apps/ledger/src/cloud_provider/impl/commits_socket_drainer.h"
 #include "apps/ledger/src/cloud_provider/impl/watch_client_impl.h"
 #include "apps/ledger/src/cloud_provider/public/cloud_provider.h"
 #include "apps/ledger/src/cloud_provider/public/types.h"
 #include "apps/ledger/src/firebase/firebase.h"
 #include "apps/ledger/src/firebase/watch_client.h"
 #include "apps/ledger/src/gcs/cloud_storage.h"
+#include "apps/ledger/src/glue/socket/socket_drainer_client.h"
 #include "mx/socket.h"
 #include "mx/vmo.h"
 
 namespace cloud_provider {
 
+// If |compress_commits| is true, the content of the uploaded commits is
+// compressed when that makes it smaller.
 class CloudProviderImpl : public CloudProvider {
  public:
   CloudProviderImpl(firebase::Firebase* firebase,
-                    gcs::CloudStorage* cloud_storage);
+                    gcs::CloudStorage* cloud_storage,
+                    bool compress_commits = false);
   ~CloudProviderImpl() override;
 
   // CloudProvider:
@@ -40,6 +46,7 @@ class CloudProviderImpl : public CloudProvider {
   void GetCommits(
       const std::string& auth_token,
       const std::string& min_timestamp,
+      size_t max_count,
       std::function<void(Status, std::vector<Record>)> callback) override;
 
   void AddObject(const std::string& auth_token,
@@ -50,20 +57,39 @@ class CloudProviderImpl : public CloudProvider {
   void GetObject(
       const std::string& auth_token,
       ObjectIdView object_id,
+      ledger::RequestPriority priority,
       std::function<void(Status status, uint64_t size, mx::socket data)>
           callback) override;
 
+  void AddObjectPack(const std::string& auth_token,
+                     ObjectIdView pack_id,
+                     std::map<ObjectId, Data> objects,
+                     std::function<void(Status)> callback) override;
+
+  void GetObjectPack(
+      const std::string& auth_token,
+      ObjectIdView pack_id,
+      std::function<void(Status, std::map<ObjectId, Data>)> callback) override;
+
  private:
   // Returns the Firebase query params.
   //
   // If |min_timestamp| is not empty, the resulting query params filter the
   // commits so that only commits not older than |min_timestamp| are returned.
+  // If |max_count| is not 0, they limit the result to the |max_count| oldest
+  // commits.
   std::vector<std::string> GetQueryParams(const std::string& auth_token,
-                                          const std::string& min_timestamp);
+                                          const std::string& min_timestamp,
+                                          size_t max_count);
 
   firebase::Firebase* const firebase_;
   gcs::CloudStorage* const cloud_storage_;
+  const bool compress_commits_;
   std::map<CommitWatcher*, std::unique_ptr<WatchClientImpl>> watchers_;
+  // Drainers reading the downloaded object packs.
+  callback::AutoCleanableSet<glue::SocketDrainerClient> drainers_;
+  // Drainers decoding the retrieved commits.
+  callback::AutoCleanableSet<CommitsSocketDrainer> commits_drainers_;
 };
 
 }  // namespace cloud_provider
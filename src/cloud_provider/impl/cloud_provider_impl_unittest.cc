@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/cloud_provider/impl/object_pack.h"
 #include "apps/ledger/src/cloud_provider/impl/timestamp_conversions.h"
 #include "apps/ledger/src/firebase/encoding.h"
 #include "apps/ledger/src/firebase/firebase.h"
@@ -27,6 +28,8 @@
 #include "mx/vmo.h"
 
 #include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
 
 namespace cloud_provider {
 namespace {
@@ -55,10 +58,12 @@ class CloudProviderImplTest : public test::TestWithMessageLoop,
   void DownloadObject(
       std::string auth_token,
       const std::string& key,
+      ledger::RequestPriority priority,
       std::function<void(gcs::Status status, uint64_t size, mx::socket data)>
           callback) override {
     download_auth_tokens_.push_back(std::move(auth_token));
     download_keys_.push_back(key);
+    download_priorities_.push_back(priority);
     message_loop_.task_runner()->PostTask(
         [ this, callback = std::move(callback) ] {
           callback(download_status_, download_response_size_,
@@ -81,6 +86,23 @@ class CloudProviderImplTest : public test::TestWithMessageLoop,
         });
   }
 
+  void GetStream(const std::string& key,
+                 const std::vector<std::string>& query_params,
+                 std::function<void(firebase::Status status, mx::socket data)>
+                     callback) override {
+    get_keys_.push_back(key);
+    get_queries_.push_back(query_params);
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    get_response_->Accept(writer);
+    message_loop_.task_runner()->PostTask([
+      callback = std::move(callback),
+      response = std::string(buffer.GetString(), buffer.GetSize())
+    ] {
+      callback(firebase::Status::OK, mtl::WriteStringToSocket(response));
+    });
+  }
+
   void Put(const std::string& key,
            const std::vector<std::string>& /*query_params*/,
            const std::string& data,
@@ -150,6 +172,7 @@ class CloudProviderImplTest : public test::TestWithMessageLoop,
   // These members keep track of calls made on the GCS client.
   std::vector<std::string> download_auth_tokens_;
   std::vector<std::string> download_keys_;
+  std::vector<ledger::RequestPriority> download_priorities_;
   std::vector<std::string> upload_auth_tokens_;
   std::vector<std::string> upload_keys_;
   std::vector<mx::vmo> upload_data_;
@@ -570,7 +593,7 @@ TEST_F(CloudProviderImplTest, GetCommits) {
   Status status;
   std::vector<Record> records;
   cloud_provider_->GetCommits(
-      "this-is-a-token", ServerTimestampToBytes(42),
+      "this-is-a-token", ServerTimestampToBytes(42), 0u,
       callback::Capture(MakeQuitTask(), &status, &records));
   EXPECT_FALSE(RunLoopWithTimeout());
   EXPECT_EQ(Status::OK, status);
@@ -619,7 +642,7 @@ TEST_F(CloudProviderImplTest, GetCommitsBatch) {
   Status status;
   std::vector<Record> records;
   cloud_provider_->GetCommits(
-      "", ServerTimestampToBytes(42),
+      "", ServerTimestampToBytes(42), 0u,
       callback::Capture(MakeQuitTask(), &status, &records));
   EXPECT_FALSE(RunLoopWithTimeout());
   EXPECT_EQ(Status::OK, status);
@@ -644,7 +667,7 @@ TEST_F(CloudProviderImplTest, GetCommitsWhenThereAreNone) {
   Status status;
   std::vector<Record> records;
   cloud_provider_->GetCommits(
-      "", ServerTimestampToBytes(42),
+      "", ServerTimestampToBytes(42), 0u,
       callback::Capture(MakeQuitTask(), &status, &records));
   EXPECT_FALSE(RunLoopWithTimeout());
 
@@ -652,6 +675,34 @@ TEST_F(CloudProviderImplTest, GetCommitsWhenThereAreNone) {
   EXPECT_TRUE(records.empty());
 }
 
+TEST_F(CloudProviderImplTest, GetCommitsWithLimit) {
+  std::string get_response_content = "null";
+  get_response_ = std::make_unique<rapidjson::Document>();
+  get_response_->Parse(get_response_content.c_str(),
+                       get_response_content.size());
+
+  Status status;
+  std::vector<Record> records;
+  cloud_provider_->GetCommits(
+      "", "", 10u, callback::Capture(MakeQuitTask(), &status, &records));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+
+  cloud_provider_->GetCommits(
+      "", ServerTimestampToBytes(42), 10u,
+      callback::Capture(MakeQuitTask(), &status, &records));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+
+  ASSERT_EQ(2u, get_queries_.size());
+  EXPECT_EQ((std::vector<std::string>{"orderBy=\"timestamp\"",
+                                      "limitToFirst=10"}),
+            get_queries_[0]);
+  EXPECT_EQ((std::vector<std::string>{"orderBy=\"timestamp\"", "startAt=42",
+                                      "limitToFirst=10"}),
+            get_queries_[1]);
+}
+
 TEST_F(CloudProviderImplTest, AddObject) {
   mx::vmo data;
   ASSERT_TRUE(mtl::VmoFromString("bazinga", &data));
@@ -680,7 +731,7 @@ TEST_F(CloudProviderImplTest, GetObject) {
   uint64_t size;
   mx::socket data;
   cloud_provider_->GetObject(
-      "this-is-a-token", "object_id",
+      "this-is-a-token", "object_id", ledger::RequestPriority::INTERACTIVE,
       callback::Capture(MakeQuitTask(), &status, &size, &data));
   EXPECT_FALSE(RunLoopWithTimeout());
 
@@ -693,6 +744,9 @@ TEST_F(CloudProviderImplTest, GetObject) {
 
   EXPECT_EQ(std::vector<std::string>{"this-is-a-token"}, download_auth_tokens_);
   EXPECT_EQ(std::vector<std::string>{"object_idV"}, download_keys_);
+  EXPECT_EQ(std::vector<ledger::RequestPriority>{
+                ledger::RequestPriority::INTERACTIVE},
+            download_priorities_);
 }
 
 TEST_F(CloudProviderImplTest, GetObjectNotFound) {
@@ -703,7 +757,7 @@ TEST_F(CloudProviderImplTest, GetObjectNotFound) {
   uint64_t size;
   mx::socket data;
   cloud_provider_->GetObject(
-      "", "object_id",
+      "", "object_id", ledger::RequestPriority::NORMAL,
       callback::Capture(MakeQuitTask(), &status, &size, &data));
   EXPECT_FALSE(RunLoopWithTimeout());
 
@@ -711,5 +765,58 @@ TEST_F(CloudProviderImplTest, GetObjectNotFound) {
   EXPECT_EQ(0u, size);
 }
 
+TEST_F(CloudProviderImplTest, AddObjectPack) {
+  std::map<ObjectId, Data> objects{{"object_a", "data_a"},
+                                   {"object_b", "data_b"}};
+
+  Status status;
+  cloud_provider_->AddObjectPack("this-is-a-token", "pack_id", objects,
+                                 callback::Capture(MakeQuitTask(), &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(std::vector<std::string>{"this-is-a-token"}, upload_auth_tokens_);
+  EXPECT_EQ(std::vector<std::string>{"pack_pack_idV"}, upload_keys_);
+
+  std::string uploaded_content;
+  ASSERT_TRUE(mtl::StringFromVmo(upload_data_[0], &uploaded_content));
+  EXPECT_EQ(EncodeObjectPack(objects), uploaded_content);
+}
+
+TEST_F(CloudProviderImplTest, GetObjectPack) {
+  std::map<ObjectId, Data> objects{{"object_a", "data_a"},
+                                   {"object_b", "data_b"}};
+  std::string content = EncodeObjectPack(objects);
+  download_response_ = mtl::WriteStringToSocket(content);
+  download_response_size_ = content.size();
+
+  Status status;
+  std::map<ObjectId, Data> pack_objects;
+  cloud_provider_->GetObjectPack(
+      "this-is-a-token", "pack_id",
+      callback::Capture(MakeQuitTask(), &status, &pack_objects));
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(objects, pack_objects);
+  EXPECT_EQ(std::vector<std::string>{"this-is-a-token"}, download_auth_tokens_);
+  EXPECT_EQ(std::vector<std::string>{"pack_pack_idV"}, download_keys_);
+}
+
+TEST_F(CloudProviderImplTest, GetObjectPackParseError) {
+  std::string content = "bazinga";
+  download_response_ = mtl::WriteStringToSocket(content);
+  download_response_size_ = content.size();
+
+  Status status;
+  std::map<ObjectId, Data> pack_objects;
+  cloud_provider_->GetObjectPack(
+      "", "pack_id", callback::Capture(MakeQuitTask(), &status, &pack_objects));
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(Status::PARSE_ERROR, status);
+  EXPECT_TRUE(pack_objects.empty());
+}
+
 }  // namespace
 }  // namespace cloud_provider
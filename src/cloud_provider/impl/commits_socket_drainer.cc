@@ -0,0 +1,41 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_provider/impl/commits_socket_drainer.h"
+
+#include <utility>
+
+namespace cloud_provider {
+
+CommitsSocketDrainer::CommitsSocketDrainer() : drainer_(this) {}
+
+CommitsSocketDrainer::~CommitsSocketDrainer() {}
+
+void CommitsSocketDrainer::Start(
+    mx::socket source,
+    std::function<void(bool success, std::vector<Record> records)> callback) {
+  callback_ = std::move(callback);
+  drainer_.Start(std::move(source));
+}
+
+void CommitsSocketDrainer::OnDataAvailable(const void* data,
+                                           size_t num_bytes) {
+  // Errors are sticky: they are reported once all the data is received.
+  decoder_.Decode(ftl::StringView(static_cast<const char*>(data), num_bytes));
+}
+
+void CommitsSocketDrainer::OnDataComplete() {
+  std::vector<Record> records;
+  bool success = decoder_.Finish(&records);
+  if (destruction_sentinel_.DestructedWhile([ this, success, &records ] {
+        callback_(success, std::move(records));
+      })) {
+    return;
+  }
+  if (on_empty_callback_) {
+    on_empty_callback_();
+  }
+}
+
+}  // namespace cloud_provider
@@ -0,0 +1,53 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_COMMITS_SOCKET_DRAINER_H_
+#define APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_COMMITS_SOCKET_DRAINER_H_
+
+#include <functional>
+#include <vector>
+
+#include "apps/ledger/src/callback/destruction_sentinel.h"
+#include "apps/ledger/src/cloud_provider/impl/encoding.h"
+#include "apps/ledger/src/cloud_provider/public/record.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/mtl/socket/socket_drainer.h"
+
+namespace cloud_provider {
+
+// Drains a socket carrying the JSON representation of an object holding
+// commits in Firebase Realtime Database, decoding the commits as they arrive.
+// |callback| is called with the decoded commits, or with false if the data is
+// malformed or incomplete.
+class CommitsSocketDrainer : public mtl::SocketDrainer::Client {
+ public:
+  CommitsSocketDrainer();
+  ~CommitsSocketDrainer() override;
+
+  void Start(mx::socket source,
+             std::function<void(bool success, std::vector<Record> records)>
+                 callback);
+
+  void set_on_empty(ftl::Closure on_empty_callback) {
+    on_empty_callback_ = std::move(on_empty_callback);
+  }
+
+ private:
+  void OnDataAvailable(const void* data, size_t num_bytes) override;
+
+  void OnDataComplete() override;
+
+  std::function<void(bool, std::vector<Record>)> callback_;
+  StreamingCommitsDecoder decoder_;
+  mtl::SocketDrainer drainer_;
+  ftl::Closure on_empty_callback_;
+  callback::DestructionSentinel destruction_sentinel_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CommitsSocketDrainer);
+};
+
+}  // namespace cloud_provider
+
+#endif  // APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_COMMITS_SOCKET_DRAINER_H_
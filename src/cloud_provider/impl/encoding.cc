@@ -4,13 +4,18 @@
 
 #include "apps/ledger/src/cloud_provider/impl/encoding.h"
 
+#include <string.h>
+
 #include <algorithm>
+#include <limits>
 
 #include "apps/ledger/src/cloud_provider/impl/timestamp_conversions.h"
 #include "apps/ledger/src/firebase/encoding.h"
+#include "apps/ledger/src/glue/compression/gzip.h"
 #include "lib/ftl/logging.h"
 
 #include <rapidjson/document.h>
+#include <rapidjson/reader.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
@@ -21,24 +26,55 @@ namespace {
 const char kIdKey[] = "id";
 const char kContentKey[] = "content";
 const char kObjectsKey[] = "objects";
+const char kPackKey[] = "pack";
+const char kCompressionKey[] = "compression";
+const char kGzipCompression[] = "gzip";
 const char kTimestampKey[] = "timestamp";
 const char kBatchPositionKey[] = "batch_position";
 const char kBatchSizeKey[] = "batch_size";
+const char kNullLiteral[] = "null";
+
+bool IsJsonWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+void SortRecords(std::vector<Record>* records) {
+  std::sort(records->begin(), records->end(),
+            [](const Record& lhs, const Record& rhs) {
+              if (lhs.timestamp != rhs.timestamp) {
+                return BytesToServerTimestamp(lhs.timestamp) <
+                       BytesToServerTimestamp(rhs.timestamp);
+              }
+              return lhs.batch_position < rhs.batch_position;
+            });
+}
 
 void WriteCommit(rapidjson::Writer<rapidjson::StringBuffer>* writer,
                  const Commit& commit,
                  std::string encoded_id,
                  int batch_position,
-                 int batch_size) {
+                 int batch_size,
+                 bool compress_content) {
+  std::string compressed_content;
+  bool compressed = compress_content &&
+                    glue::GzipCompress(commit.content, &compressed_content) &&
+                    compressed_content.size() < commit.content.size();
+
   writer->StartObject();
   {
     writer->Key(kIdKey);
     writer->String(encoded_id.c_str(), encoded_id.size());
 
     writer->Key(kContentKey);
-    std::string content = firebase::EncodeValue(commit.content);
+    std::string content = firebase::EncodeValue(
+        compressed ? compressed_content : commit.content);
     writer->String(content.c_str(), content.size());
 
+    if (compressed) {
+      writer->Key(kCompressionKey);
+      writer->String(kGzipCompression);
+    }
+
     if (!commit.storage_objects.empty()) {
       writer->Key(kObjectsKey);
       writer->StartObject();
@@ -53,6 +89,12 @@ void WriteCommit(rapidjson::Writer<rapidjson::StringBuffer>* writer,
       writer->EndObject();
     }
 
+    if (!commit.pack_id.empty()) {
+      writer->Key(kPackKey);
+      std::string pack_id = firebase::EncodeValue(commit.pack_id);
+      writer->String(pack_id.c_str(), pack_id.size());
+    }
+
     writer->Key(kTimestampKey);
     // Placeholder that Firebase will replace with server timestamp. See
     // https://firebase.google.com/docs/database/rest/save-data.
@@ -72,10 +114,212 @@ void WriteCommit(rapidjson::Writer<rapidjson::StringBuffer>* writer,
   writer->EndObject();
 }
 
+// SAX handler decoding the commit held as the only member of a JSON object,
+// with the same rules as DecodeCommitFromValue().
+class CommitHandler
+    : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, CommitHandler> {
+ public:
+  CommitHandler() {}
+
+  bool StartObject() {
+    if (skipped_depth_ > 0u) {
+      ++skipped_depth_;
+      return true;
+    }
+    switch (depth_) {
+      case 0u:
+      case 1u:
+        ++depth_;
+        return true;
+      case 2u:
+        if (key_ == kObjectsKey) {
+          ++depth_;
+          return true;
+        }
+        return Skip();
+      default:
+        return false;
+    }
+  }
+
+  bool EndObject(rapidjson::SizeType /*member_count*/) {
+    if (skipped_depth_ > 0u) {
+      --skipped_depth_;
+      return true;
+    }
+    if (--depth_ == 1u) {
+      commit_done_ = true;
+    }
+    return true;
+  }
+
+  bool StartArray() {
+    if (skipped_depth_ > 0u) {
+      ++skipped_depth_;
+      return true;
+    }
+    return depth_ == 2u && Skip();
+  }
+
+  bool EndArray(rapidjson::SizeType /*element_count*/) {
+    FTL_DCHECK(skipped_depth_ > 0u);
+    --skipped_depth_;
+    return true;
+  }
+
+  bool Key(const char* str, rapidjson::SizeType length, bool /*copy*/) {
+    if (skipped_depth_ > 0u) {
+      return true;
+    }
+    switch (depth_) {
+      case 1u:
+        return ++member_count_ == 1u;
+      case 2u:
+        key_.assign(str, length);
+        return true;
+      case 3u:
+        return firebase::Decode(ftl::StringView(str, length), &object_id_);
+      default:
+        return false;
+    }
+  }
+
+  bool String(const char* str, rapidjson::SizeType length, bool /*copy*/) {
+    if (skipped_depth_ > 0u) {
+      return true;
+    }
+    ftl::StringView value(str, length);
+    if (depth_ == 3u) {
+      return firebase::Decode(value, &storage_objects_[object_id_]);
+    }
+    if (depth_ != 2u) {
+      return false;
+    }
+    if (key_ == kIdKey) {
+      has_id_ = true;
+      return firebase::Decode(value, &commit_id_);
+    }
+    if (key_ == kContentKey) {
+      has_content_ = true;
+      return firebase::Decode(value, &content_);
+    }
+    if (key_ == kCompressionKey) {
+      // Only gzip is supported.
+      compressed_ = true;
+      return value == kGzipCompression;
+    }
+    if (key_ == kPackKey) {
+      return firebase::Decode(value, &pack_id_);
+    }
+    return IsIgnoredKey();
+  }
+
+  bool Int(int value) { return Number(value, true); }
+  bool Uint(unsigned value) {
+    constexpr unsigned kMaxInt = std::numeric_limits<int>::max();
+    return Number(value, value <= kMaxInt);
+  }
+  bool Int64(int64_t value) { return Number(value, false); }
+  bool Uint64(uint64_t value) {
+    if (value > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+      return Default();
+    }
+    return Number(value, false);
+  }
+
+  // Called for the values not handled above.
+  bool Default() {
+    if (skipped_depth_ > 0u) {
+      return true;
+    }
+    return depth_ == 2u && IsIgnoredKey();
+  }
+
+  // Returns the decoded record, or nullptr if the commit is not valid.
+  std::unique_ptr<Record> TakeRecord() {
+    if (!commit_done_ || !has_id_ || !has_content_ || !has_timestamp_) {
+      return nullptr;
+    }
+    if (compressed_) {
+      Data decompressed_content;
+      if (!glue::GzipDecompress(content_, &decompressed_content)) {
+        return nullptr;
+      }
+      content_.swap(decompressed_content);
+    }
+    Commit commit(std::move(commit_id_), std::move(content_),
+                  std::move(storage_objects_));
+    commit.pack_id = std::move(pack_id_);
+    return std::make_unique<Record>(std::move(commit),
+                                    ServerTimestampToBytes(timestamp_),
+                                    batch_position_, batch_size_);
+  }
+
+ private:
+  bool Number(int64_t value, bool is_int) {
+    if (skipped_depth_ > 0u) {
+      return true;
+    }
+    if (depth_ != 2u) {
+      return false;
+    }
+    if (key_ == kTimestampKey) {
+      has_timestamp_ = true;
+      timestamp_ = value;
+    } else if (key_ == kBatchPositionKey && is_int) {
+      batch_position_ = static_cast<int>(value);
+    } else if (key_ == kBatchSizeKey && is_int) {
+      batch_size_ = static_cast<int>(value);
+    }
+    return IsIgnoredKey() || key_ == kTimestampKey;
+  }
+
+  // Skips the container value of the current key.
+  bool Skip() {
+    if (!IsIgnoredKey()) {
+      return false;
+    }
+    skipped_depth_ = 1u;
+    return true;
+  }
+
+  // Returns whether the value of the current key can have any type, and is
+  // ignored unless it has the expected one.
+  bool IsIgnoredKey() const {
+    return key_ != kIdKey && key_ != kContentKey && key_ != kCompressionKey &&
+           key_ != kPackKey && key_ != kObjectsKey && key_ != kTimestampKey;
+  }
+
+  // Depth in the objects: 1 in the wrapping object, 2 in the commit, 3 in its
+  // storage objects.
+  size_t depth_ = 0u;
+  // Depth in a value that is not decoded.
+  size_t skipped_depth_ = 0u;
+  size_t member_count_ = 0u;
+  bool commit_done_ = false;
+  std::string key_;
+
+  bool has_id_ = false;
+  bool has_content_ = false;
+  bool compressed_ = false;
+  bool has_timestamp_ = false;
+  CommitId commit_id_;
+  Data content_;
+  std::map<ObjectId, Data> storage_objects_;
+  ObjectId object_id_;
+  ObjectId pack_id_;
+  int64_t timestamp_ = 0;
+  int batch_position_ = 0;
+  int batch_size_ = 1;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CommitHandler);
+};
+
 }  // namespace
 
 bool EncodeCommits(const std::vector<Commit>& commits,
-                   std::string* output_json) {
+                   std::string* output_json,
+                   bool compress_content) {
   rapidjson::StringBuffer string_buffer;
   rapidjson::Writer<rapidjson::StringBuffer> writer(string_buffer);
 
@@ -85,7 +329,7 @@ bool EncodeCommits(const std::vector<Commit>& commits,
       std::string encoded_id = firebase::EncodeValue(commits[i].id);
       writer.Key(encoded_id.c_str(), encoded_id.size());
       WriteCommit(&writer, commits[i], std::move(encoded_id), i,
-                  commits.size());
+                  commits.size(), compress_content);
     }
   }
   writer.EndObject();
@@ -134,15 +378,7 @@ bool DecodeMultipleCommitsFromValue(const rapidjson::Value& value,
     records.push_back(std::move(*record));
   }
 
-  std::sort(records.begin(), records.end(),
-            [](const Record& lhs, const Record& rhs) {
-              if (lhs.timestamp != rhs.timestamp) {
-                return BytesToServerTimestamp(lhs.timestamp) <
-                       BytesToServerTimestamp(rhs.timestamp);
-              }
-              return lhs.batch_position < rhs.batch_position;
-            });
-
+  SortRecords(&records);
   output_records->swap(records);
   return true;
 }
@@ -165,6 +401,19 @@ bool DecodeCommitFromValue(const rapidjson::Value& value,
     return false;
   }
 
+  if (value.HasMember(kCompressionKey)) {
+    // Only gzip is supported.
+    if (!value[kCompressionKey].IsString() ||
+        value[kCompressionKey].GetString() != std::string(kGzipCompression)) {
+      return false;
+    }
+    Data decompressed_content;
+    if (!glue::GzipDecompress(commit_content, &decompressed_content)) {
+      return false;
+    }
+    commit_content.swap(decompressed_content);
+  }
+
   std::map<ObjectId, Data> storage_objects;
   if (value.HasMember(kObjectsKey)) {
     for (auto& it : value[kObjectsKey].GetObject()) {
@@ -182,6 +431,13 @@ bool DecodeCommitFromValue(const rapidjson::Value& value,
     }
   }
 
+  ObjectId pack_id;
+  if (value.HasMember(kPackKey) &&
+      (!value[kPackKey].IsString() ||
+       !firebase::Decode(value[kPackKey], &pack_id))) {
+    return false;
+  }
+
   if (!value.HasMember(kTimestampKey) || !value[kTimestampKey].IsNumber()) {
     return false;
   }
@@ -196,13 +452,163 @@ bool DecodeCommitFromValue(const rapidjson::Value& value,
     batch_size = value[kBatchSizeKey].GetInt();
   }
 
+  Commit commit(std::move(commit_id), std::move(commit_content),
+                std::move(storage_objects));
+  commit.pack_id = std::move(pack_id);
   auto record = std::make_unique<Record>(
-      Commit(std::move(commit_id), std::move(commit_content),
-             std::move(storage_objects)),
+      std::move(commit),
       ServerTimestampToBytes(value[kTimestampKey].GetInt64()), batch_position,
       batch_size);
   output_record->swap(record);
   return true;
 }
 
+StreamingCommitsDecoder::StreamingCommitsDecoder() {}
+
+StreamingCommitsDecoder::~StreamingCommitsDecoder() {}
+
+bool StreamingCommitsDecoder::Decode(ftl::StringView chunk) {
+  // Position in |chunk| of the start of the data of the current member.
+  size_t member_start = 0u;
+  for (size_t i = 0; i < chunk.size(); ++i) {
+    char c = chunk[i];
+    switch (state_) {
+      case State::START:
+        if (c == '{') {
+          state_ = State::FIRST_MEMBER_OR_END;
+        } else if (c == kNullLiteral[0]) {
+          state_ = State::NULL_LITERAL;
+          position_ = 1u;
+        } else if (!IsJsonWhitespace(c)) {
+          return Fail();
+        }
+        break;
+      case State::NULL_LITERAL:
+        if (c != kNullLiteral[position_]) {
+          return Fail();
+        }
+        if (++position_ == strlen(kNullLiteral)) {
+          state_ = State::DONE;
+        }
+        break;
+      case State::FIRST_MEMBER_OR_END:
+      case State::NEXT_MEMBER_OR_END:
+      case State::MEMBER:
+        if (IsJsonWhitespace(c)) {
+          break;
+        }
+        if (c == '}' && state_ != State::MEMBER) {
+          state_ = State::DONE;
+        } else if (c == ',' && state_ == State::NEXT_MEMBER_OR_END) {
+          state_ = State::MEMBER;
+        } else if (c == '"' && state_ != State::NEXT_MEMBER_OR_END) {
+          state_ = State::KEY;
+          buffer_ = "{";
+          member_start = i;
+        } else {
+          return Fail();
+        }
+        break;
+      case State::KEY:
+        if (escaped_) {
+          escaped_ = false;
+        } else if (c == '\\') {
+          escaped_ = true;
+        } else if (c == '"') {
+          state_ = State::COLON;
+        }
+        break;
+      case State::COLON:
+        if (c == ':') {
+          state_ = State::VALUE_START;
+        } else if (!IsJsonWhitespace(c)) {
+          return Fail();
+        }
+        break;
+      case State::VALUE_START:
+        // Commits are represented as objects.
+        if (c == '{') {
+          state_ = State::VALUE;
+          position_ = 1u;
+        } else if (!IsJsonWhitespace(c)) {
+          return Fail();
+        }
+        break;
+      case State::VALUE:
+        if (in_string_) {
+          if (escaped_) {
+            escaped_ = false;
+          } else if (c == '\\') {
+            escaped_ = true;
+          } else if (c == '"') {
+            in_string_ = false;
+          }
+        } else if (c == '"') {
+          in_string_ = true;
+        } else if (c == '{' || c == '[') {
+          ++position_;
+        } else if ((c == '}' || c == ']') && --position_ == 0u) {
+          buffer_.append(chunk.data() + member_start, i + 1 - member_start);
+          buffer_.push_back('}');
+          if (!DecodeMember()) {
+            return Fail();
+          }
+          // The capacity of the buffer is reused for the next commit.
+          buffer_.clear();
+          state_ = State::NEXT_MEMBER_OR_END;
+        }
+        break;
+      case State::DONE:
+        if (!IsJsonWhitespace(c)) {
+          return Fail();
+        }
+        break;
+      case State::ERROR:
+        return false;
+    }
+  }
+
+  if (state_ == State::KEY || state_ == State::COLON ||
+      state_ == State::VALUE_START || state_ == State::VALUE) {
+    // The current member continues in the next chunk.
+    buffer_.append(chunk.data() + member_start, chunk.size() - member_start);
+  }
+  return true;
+}
+
+bool StreamingCommitsDecoder::Finish(std::vector<Record>* output_records) {
+  FTL_DCHECK(output_records);
+  if (state_ != State::DONE) {
+    return Fail();
+  }
+  SortRecords(&records_);
+  output_records->swap(records_);
+  records_.clear();
+  return true;
+}
+
+bool StreamingCommitsDecoder::DecodeMember() {
+  // The member is decoded as it is parsed, without building its DOM.
+  CommitHandler handler;
+  rapidjson::Reader reader;
+  rapidjson::StringStream stream(buffer_.c_str());
+  if (reader.Parse(stream, handler).IsError()) {
+    return false;
+  }
+
+  std::unique_ptr<Record> record = handler.TakeRecord();
+  if (!record) {
+    return false;
+  }
+  records_.push_back(std::move(*record));
+  return true;
+}
+
+bool StreamingCommitsDecoder::Fail() {
+  state_ = State::ERROR;
+  buffer_.clear();
+  records_.clear();
+  return false;
+}
+
 }  // namespace cloud_provider
@@ -6,10 +6,13 @@
 #define APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_ENCODING_H_
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "apps/ledger/src/cloud_provider/public/commit.h"
 #include "apps/ledger/src/cloud_provider/public/record.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
 
 #include <rapidjson/document.h>
 
@@ -23,8 +26,12 @@ namespace cloud_provider {
 //
 // For each commit, in addition to the commit content, a timestamp placeholder
 // is added, making Firebase tag the commit with a server timestamp.
+//
+// If |compress_content| is true, the content of each commit that shrinks when
+// compressed is stored gzip-compressed, and the commit is flagged as such.
 bool EncodeCommits(const std::vector<Commit>& commits,
-                   std::string* output_json);
+                   std::string* output_json,
+                   bool compress_content = false);
 
 // Decodes multiple commits from the JSON representation of an object holding
 // them in Firebase Realtime Database. If successful, the method returns true,
@@ -39,6 +46,60 @@ bool DecodeCommitFromValue(const rapidjson::Value& value,
 bool DecodeMultipleCommitsFromValue(const rapidjson::Value& value,
                                     std::vector<Record>* output_records);
 
+// Decodes multiple commits from the JSON representation of an object holding
+// them in Firebase Realtime Database, as the representation is received.
+//
+// Each commit is decoded as soon as its data is complete, and its data is then
+// released: at any time, only the data of the commit being received is held in
+// addition to the decoded records.
+class StreamingCommitsDecoder {
+ public:
+  StreamingCommitsDecoder();
+  ~StreamingCommitsDecoder();
+
+  // Decodes the next |chunk| of the representation. Returns false if the data
+  // is malformed, in which case no further calls can be made.
+  bool Decode(ftl::StringView chunk);
+
+  // Completes the decoding. Returns false if the data is malformed or
+  // incomplete. Otherwise, |output_records| contains the decoded commits along
+  // with their timestamps, in the order of the timestamps.
+  bool Finish(std::vector<Record>* output_records);
+
+  // Returns the size of the data of the commit being received.
+  size_t buffered_size() const { return buffer_.size(); }
+
+ private:
+  enum class State {
+    START,
+    NULL_LITERAL,
+    FIRST_MEMBER_OR_END,
+    NEXT_MEMBER_OR_END,
+    MEMBER,
+    KEY,
+    COLON,
+    VALUE_START,
+    VALUE,
+    DONE,
+    ERROR,
+  };
+
+  // Decodes the commit of the member held in |buffer_|.
+  bool DecodeMember();
+  bool Fail();
+
+  State state_ = State::START;
+  // Position in the null literal, or depth in the commit value.
+  size_t position_ = 0u;
+  bool in_string_ = false;
+  bool escaped_ = false;
+  // Data of the member being received, wrapped in an object.
+  std::string buffer_;
+  std::vector<Record> records_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(StreamingCommitsDecoder);
+};
+
 }  // namespace cloud_provider
 
 #endif  // APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_ENCODING_H_
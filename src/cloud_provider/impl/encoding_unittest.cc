@@ -121,6 +121,57 @@ TEST(EncodingTest, EncodeDecodeZeroByte) {
   EXPECT_EQ(ServerTimestampToBytes(42), output_records.front().timestamp);
 }
 
+TEST(EncodingTest, EncodeDecodePackId) {
+  Commit commit("id", "content", std::map<ObjectId, Data>{});
+  commit.pack_id = "pack\0"_s;
+  Commit original_commit = commit.Clone();
+  std::vector<Commit> commits;
+  commits.push_back(std::move(commit));
+
+  std::string encoded;
+  EXPECT_TRUE(EncodeCommits(commits, &encoded));
+  std::string pattern = "{\".sv\":\"timestamp\"}";
+  encoded.replace(encoded.find(pattern), pattern.size(), "42");
+
+  std::vector<Record> records;
+  EXPECT_TRUE(DecodeMultipleCommits(encoded, &records));
+  ASSERT_EQ(1u, records.size());
+  EXPECT_EQ(original_commit, records.front().commit);
+  EXPECT_EQ("pack\0"_s, records.front().commit.pack_id);
+}
+
+TEST(EncodingTest, EncodeDecodeCompressed) {
+  std::string content;
+  for (size_t i = 0; i < 100; ++i) {
+    content.append("content");
+  }
+  std::vector<Commit> commits;
+  // The content of the first commit does not shrink when compressed.
+  commits.emplace_back("id_1", "content_1", std::map<ObjectId, Data>{});
+  commits.emplace_back("id_2", content, std::map<ObjectId, Data>{});
+
+  std::string encoded;
+  EXPECT_TRUE(EncodeCommits(commits, &encoded, true));
+  EXPECT_LT(encoded.size(), content.size());
+  std::string pattern = "{\".sv\":\"timestamp\"}";
+  encoded.replace(encoded.find(pattern), pattern.size(), "42");
+  encoded.replace(encoded.find(pattern), pattern.size(), "43");
+
+  std::vector<Record> records;
+  EXPECT_TRUE(DecodeMultipleCommits(encoded, &records));
+  ASSERT_EQ(2u, records.size());
+  EXPECT_EQ(commits[0], records[0].commit);
+  EXPECT_EQ(commits[1], records[1].commit);
+}
+
+TEST(EncodingTest, DecodeUnknownCompression) {
+  std::string json =
+      "{\"id_1V\":{\"id\":\"id_1V\",\"content\":\"content_1V\","
+      "\"compression\":\"unknown\",\"timestamp\":42}}";
+  std::vector<Record> records;
+  EXPECT_FALSE(DecodeMultipleCommits(json, &records));
+}
+
 TEST(EncodingTest, EncodeDecodeBatch) {
   std::vector<Commit> commits;
   commits.emplace_back("id_1", "content_1", std::map<ObjectId, Data>{});
@@ -145,5 +196,118 @@ TEST(EncodingTest, EncodeDecodeBatch) {
   EXPECT_EQ(2u, records[1].batch_size);
 }
 
+// Feeds |json| to a StreamingCommitsDecoder in chunks of |chunk_size| bytes.
+bool DecodeByChunks(ftl::StringView json,
+                    size_t chunk_size,
+                    std::vector<Record>* records) {
+  StreamingCommitsDecoder decoder;
+  for (size_t i = 0; i < json.size(); i += chunk_size) {
+    if (!decoder.Decode(json.substr(i, chunk_size))) {
+      return false;
+    }
+  }
+  return decoder.Finish(records);
+}
+
+TEST(EncodingTest, StreamingDecode) {
+  std::vector<Commit> commits;
+  commits.emplace_back(
+      "id_1", "content_1",
+      std::map<ObjectId, Data>{{"object_a", "data_a"}, {"object_b", "{}"}});
+  commits.emplace_back("id_2", "\"content}]\"\\", std::map<ObjectId, Data>{});
+  commits.emplace_back("id_3", "content_3", std::map<ObjectId, Data>{});
+
+  std::string encoded;
+  EXPECT_TRUE(EncodeCommits(commits, &encoded));
+  std::string pattern = "{\".sv\":\"timestamp\"}";
+  encoded.replace(encoded.find(pattern), pattern.size(), "43");
+  encoded.replace(encoded.find(pattern), pattern.size(), "42");
+  encoded.replace(encoded.find(pattern), pattern.size(), "44");
+  encoded = " \n" + encoded + "\n";
+
+  for (size_t chunk_size : {1u, 3u, 16u, 1024u}) {
+    std::vector<Record> records;
+    EXPECT_TRUE(DecodeByChunks(encoded, chunk_size, &records));
+    ASSERT_EQ(3u, records.size());
+    // Verify that commits are ordered by timestamp.
+    EXPECT_EQ(commits[1], records[0].commit);
+    EXPECT_EQ(ServerTimestampToBytes(42), records[0].timestamp);
+    EXPECT_EQ(commits[0], records[1].commit);
+    EXPECT_EQ(ServerTimestampToBytes(43), records[1].timestamp);
+    EXPECT_EQ(commits[2], records[2].commit);
+    EXPECT_EQ(ServerTimestampToBytes(44), records[2].timestamp);
+  }
+}
+
+// Verifies that the streaming decoder decodes the members of the commits like
+// DecodeMultipleCommits().
+TEST(EncodingTest, StreamingDecodeLikeDocument) {
+  std::vector<Commit> commits;
+  commits.emplace_back("id_1", std::string(1000, 'a'),
+                       std::map<ObjectId, Data>{{"object_a", "data_a"}});
+  commits[0].pack_id = "pack";
+  commits.emplace_back("id_2", "content_2", std::map<ObjectId, Data>{});
+
+  std::string encoded;
+  EXPECT_TRUE(EncodeCommits(commits, &encoded, true));
+  std::string pattern = "{\".sv\":\"timestamp\"}";
+  encoded.replace(encoded.find(pattern), pattern.size(), "43");
+  encoded.replace(encoded.find(pattern), pattern.size(), "42");
+  // Unknown members are ignored.
+  pattern = "\"batch_size\":";
+  encoded.replace(encoded.find(pattern), pattern.size(),
+                  "\"extra\":{\"a\":[1,{\"b\":null}],\"c\":1.5},"
+                  "\"batch_size\":");
+
+  std::vector<Record> expected_records;
+  ASSERT_TRUE(DecodeMultipleCommits(encoded, &expected_records));
+  ASSERT_EQ(2u, expected_records.size());
+  EXPECT_EQ(commits[0], expected_records[1].commit);
+  EXPECT_EQ("pack", expected_records[1].commit.pack_id);
+
+  for (size_t chunk_size : {1u, 7u, 1024u}) {
+    std::vector<Record> records;
+    EXPECT_TRUE(DecodeByChunks(encoded, chunk_size, &records));
+    ASSERT_EQ(expected_records.size(), records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+      EXPECT_EQ(expected_records[i].commit, records[i].commit);
+      EXPECT_EQ(expected_records[i].commit.pack_id, records[i].commit.pack_id);
+      EXPECT_EQ(expected_records[i].timestamp, records[i].timestamp);
+      EXPECT_EQ(expected_records[i].batch_position,
+                records[i].batch_position);
+      EXPECT_EQ(expected_records[i].batch_size, records[i].batch_size);
+    }
+  }
+}
+
+TEST(EncodingTest, StreamingDecodeEmpty) {
+  for (const auto& json : {"null", "{}", " { } "}) {
+    std::vector<Record> records;
+    EXPECT_TRUE(DecodeByChunks(json, 1u, &records));
+    EXPECT_TRUE(records.empty());
+  }
+}
+
+TEST(EncodingTest, StreamingDecodeInvalid) {
+  for (const auto& json :
+       {"", "nul", "nulll", "[]", "{\"id_1V\":42}", "{\"id_1V\":{}}",
+        "{\"id_1V\":{\"id\":\"id_1V\",\"content\":\"content_1V\","
+        "\"timestamp\":42}", "{,}", "{} {}",
+        // Missing timestamp.
+        "{\"id_1V\":{\"id\":\"id_1V\",\"content\":\"content_1V\"}}",
+        // Wrong member types.
+        "{\"id_1V\":{\"id\":1,\"content\":\"content_1V\",\"timestamp\":42}}",
+        "{\"id_1V\":{\"id\":\"id_1V\",\"content\":\"content_1V\","
+        "\"timestamp\":\"42\"}}",
+        "{\"id_1V\":{\"id\":\"id_1V\",\"content\":\"content_1V\","
+        "\"objects\":{\"object_aV\":42},\"timestamp\":42}}",
+        // Unsupported compression.
+        "{\"id_1V\":{\"id\":\"id_1V\",\"content\":\"content_1V\","
+        "\"compression\":\"zstd\",\"timestamp\":42}}"}) {
+    std::vector<Record> records;
+    EXPECT_FALSE(DecodeByChunks(json, 1u, &records)) << json;
+  }
+}
+
 }  // namespace
 }  // namespace cloud_provider
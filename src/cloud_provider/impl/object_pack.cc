@@ -0,0 +1,118 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_provider/impl/object_pack.h"
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/logging.h"
+
+namespace cloud_provider {
+
+namespace {
+
+constexpr ftl::StringView kPackHeader = "LPK1";
+
+void AppendSize(size_t size, std::string* output) {
+  FTL_DCHECK(size <= std::numeric_limits<uint32_t>::max());
+  for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+    output->push_back(static_cast<char>((size >> (8 * i)) & 0xff));
+  }
+}
+
+bool ReadSize(ftl::StringView* input, size_t* size) {
+  if (input->size() < sizeof(uint32_t)) {
+    return false;
+  }
+  uint32_t result = 0;
+  for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+    result |= static_cast<uint32_t>(static_cast<uint8_t>((*input)[i]))
+              << (8 * i);
+  }
+  *input = input->substr(sizeof(uint32_t));
+  *size = result;
+  return true;
+}
+
+bool ReadBytes(ftl::StringView* input, size_t size, ftl::StringView* bytes) {
+  if (input->size() < size) {
+    return false;
+  }
+  *bytes = input->substr(0, size);
+  *input = input->substr(size);
+  return true;
+}
+
+}  // namespace
+
+std::string EncodeObjectPack(const std::map<ObjectId, Data>& objects) {
+  size_t pack_size = kPackHeader.size() + sizeof(uint32_t);
+  for (const auto& object : objects) {
+    pack_size += 2 * sizeof(uint32_t) + object.first.size() +
+                 object.second.size();
+  }
+
+  std::string pack;
+  pack.reserve(pack_size);
+  pack.append(kPackHeader.data(), kPackHeader.size());
+  AppendSize(objects.size(), &pack);
+  for (const auto& object : objects) {
+    AppendSize(object.first.size(), &pack);
+    pack.append(object.first);
+    AppendSize(object.second.size(), &pack);
+  }
+  for (const auto& object : objects) {
+    pack.append(object.second);
+  }
+  FTL_DCHECK(pack.size() == pack_size);
+  return pack;
+}
+
+bool DecodeObjectPack(ftl::StringView pack, std::map<ObjectId, Data>* objects) {
+  ftl::StringView header;
+  if (!ReadBytes(&pack, kPackHeader.size(), &header) ||
+      header != kPackHeader) {
+    return false;
+  }
+
+  size_t count;
+  if (!ReadSize(&pack, &count)) {
+    return false;
+  }
+  // Each index entry takes at least two sizes.
+  if (count > pack.size() / (2 * sizeof(uint32_t))) {
+    return false;
+  }
+
+  std::vector<std::pair<ftl::StringView, size_t>> index;
+  index.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    size_t id_size;
+    ftl::StringView id;
+    size_t data_size;
+    if (!ReadSize(&pack, &id_size) || !ReadBytes(&pack, id_size, &id) ||
+        !ReadSize(&pack, &data_size)) {
+      return false;
+    }
+    index.emplace_back(id, data_size);
+  }
+
+  std::map<ObjectId, Data> result;
+  for (const auto& entry : index) {
+    ftl::StringView data;
+    if (!ReadBytes(&pack, entry.second, &data)) {
+      return false;
+    }
+    result[entry.first.ToString()] = data.ToString();
+  }
+  if (!pack.empty()) {
+    return false;
+  }
+  objects->swap(result);
+  return true;
+}
+
+}  // namespace cloud_provider
@@ -0,0 +1,35 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_OBJECT_PACK_H_
+#define APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_OBJECT_PACK_H_
+
+#include <map>
+#include <string>
+
+#include "apps/ledger/src/cloud_provider/public/types.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace cloud_provider {
+
+// Object packs bundle storage objects in a single cloud object, so that they
+// can be uploaded and retrieved with a single request.
+//
+// A pack is made of a header, an index listing the id and content size of each
+// object, and the concatenated contents of the objects:
+//
+//   "LPK1" <object count> (<id size> <id> <content size>)* <content>*
+//
+// All sizes and counts are encoded as 32-bit little-endian integers.
+
+// Encodes the given objects in a pack.
+std::string EncodeObjectPack(const std::map<ObjectId, Data>& objects);
+
+// Decodes the objects of the given pack. Returns false if |pack| is not a
+// valid pack.
+bool DecodeObjectPack(ftl::StringView pack, std::map<ObjectId, Data>* objects);
+
+}  // namespace cloud_provider
+
+#endif  // APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_OBJECT_PACK_H_
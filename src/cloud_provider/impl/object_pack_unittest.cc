@@ -0,0 +1,60 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_provider/impl/object_pack.h"
+
+#include "gtest/gtest.h"
+
+namespace cloud_provider {
+namespace {
+
+// Allows to create correct std::strings with \0 bytes inside from C-style
+// string constants.
+std::string operator"" _s(const char* str, size_t size) {
+  return std::string(str, size);
+}
+
+TEST(ObjectPackTest, Encode) {
+  std::map<ObjectId, Data> objects{{"a", "xyz"}, {"bc", ""}};
+  EXPECT_EQ(
+      "LPK1\2\0\0\0"
+      "\1\0\0\0a\3\0\0\0"
+      "\2\0\0\0bc\0\0\0\0"
+      "xyz"_s,
+      EncodeObjectPack(objects));
+}
+
+TEST(ObjectPackTest, EncodeDecode) {
+  std::map<ObjectId, Data> objects{{"object_a", "data_a"},
+                                   {"object_b", std::string(1000, 'b')},
+                                   {"object\0c"_s, "data\0c"_s},
+                                   {"object_d", ""}};
+
+  std::map<ObjectId, Data> decoded;
+  EXPECT_TRUE(DecodeObjectPack(EncodeObjectPack(objects), &decoded));
+  EXPECT_EQ(objects, decoded);
+
+  EXPECT_TRUE(DecodeObjectPack(EncodeObjectPack({}), &decoded));
+  EXPECT_TRUE(decoded.empty());
+}
+
+TEST(ObjectPackTest, DecodeInvalid) {
+  std::string pack = EncodeObjectPack({{"object_a", "data_a"}});
+  std::map<ObjectId, Data> decoded;
+
+  EXPECT_FALSE(DecodeObjectPack("", &decoded));
+  EXPECT_FALSE(DecodeObjectPack("LPK2" + pack.substr(4), &decoded));
+  // Truncated packs.
+  for (size_t size = 0; size < pack.size(); ++size) {
+    EXPECT_FALSE(DecodeObjectPack(pack.substr(0, size), &decoded));
+  }
+  // Trailing data.
+  EXPECT_FALSE(DecodeObjectPack(pack + "x", &decoded));
+  // Object count larger than the pack.
+  EXPECT_FALSE(DecodeObjectPack("LPK1\xff\xff\xff\xff"_s, &decoded));
+  EXPECT_TRUE(decoded.empty());
+}
+
+}  // namespace
+}  // namespace cloud_provider
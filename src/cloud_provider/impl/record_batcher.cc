@@ -0,0 +1,67 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_provider/impl/record_batcher.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace cloud_provider {
+
+RecordBatcher::RecordBatcher() {}
+
+RecordBatcher::~RecordBatcher() {}
+
+bool RecordBatcher::AddRecord(Record record) {
+  if (!batch_timestamp_.empty()) {
+    // There is a pending batch already, verify that the new commits is part of
+    // it.
+    if (record.timestamp != batch_timestamp_) {
+      FTL_LOG(ERROR) << "Two batches of commits are intermixed. "
+                     << "This should not have happened, please file a bug.";
+      return false;
+    }
+
+    // Received record is for the current batch.
+    if (record.batch_size != batch_size_) {
+      FTL_LOG(ERROR) << "The size of the commit batch is inconsistent. "
+                     << "This should not have happened, please file a bug.";
+      return false;
+    }
+  } else {
+    // There is no pending batch, start a new one.
+    FTL_DCHECK(batch_.empty());
+    batch_timestamp_ = record.timestamp;
+    batch_size_ = record.batch_size;
+    batch_.reserve(batch_size_);
+  }
+
+  // Add the new commit to the batch.
+  batch_.push_back(std::move(record));
+  return true;
+}
+
+bool RecordBatcher::IsBatchComplete() const {
+  return !batch_.empty() && batch_.size() == batch_size_;
+}
+
+std::vector<Record> RecordBatcher::TakeBatch() {
+  FTL_DCHECK(IsBatchComplete());
+  std::sort(batch_.begin(), batch_.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs.batch_position < rhs.batch_position;
+  });
+  std::vector<Record> result = std::move(batch_);
+  Reset();
+  return result;
+}
+
+void RecordBatcher::Reset() {
+  batch_.clear();
+  batch_timestamp_.clear();
+  batch_size_ = 0u;
+}
+
+}  // namespace cloud_provider
@@ -0,0 +1,50 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_RECORD_BATCHER_H_
+#define APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_RECORD_BATCHER_H_
+
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/cloud_provider/public/record.h"
+#include "lib/ftl/macros.h"
+
+namespace cloud_provider {
+
+// Groups the records received one by one from the cloud into the batches in
+// which the commits were added.
+class RecordBatcher {
+ public:
+  RecordBatcher();
+  ~RecordBatcher();
+
+  // Adds |record| to the current batch, starting a new one if needed. Returns
+  // false if |record| is not consistent with the current batch.
+  bool AddRecord(Record record);
+
+  // Returns true if all the records of the current batch were added.
+  bool IsBatchComplete() const;
+
+  // Returns the records of the current batch, ordered by their position in the
+  // batch, and starts a new batch. The current batch must be complete.
+  std::vector<Record> TakeBatch();
+
+  // Drops the records of the current batch.
+  void Reset();
+
+ private:
+  // Records of the current pending batch.
+  std::vector<Record> batch_;
+  // Timestamp of the current pending batch.
+  std::string batch_timestamp_;
+  // Total size of the current pending batch.
+  size_t batch_size_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RecordBatcher);
+};
+
+}  // namespace cloud_provider
+
+#endif  // APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_RECORD_BATCHER_H_
@@ -0,0 +1,65 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_provider/impl/record_batcher.h"
+
+#include "gtest/gtest.h"
+
+namespace cloud_provider {
+namespace {
+
+Record MakeRecord(std::string id,
+                  std::string timestamp,
+                  int position,
+                  int size) {
+  return Record(Commit(std::move(id), "content", {}), std::move(timestamp),
+                position, size);
+}
+
+TEST(RecordBatcherTest, SingleRecordBatches) {
+  RecordBatcher batcher;
+  EXPECT_FALSE(batcher.IsBatchComplete());
+
+  EXPECT_TRUE(batcher.AddRecord(MakeRecord("id1", "1", 0, 1)));
+  EXPECT_TRUE(batcher.IsBatchComplete());
+  std::vector<Record> batch = batcher.TakeBatch();
+  ASSERT_EQ(1u, batch.size());
+  EXPECT_EQ("id1", batch[0].commit.id);
+  EXPECT_FALSE(batcher.IsBatchComplete());
+
+  EXPECT_TRUE(batcher.AddRecord(MakeRecord("id2", "2", 0, 1)));
+  EXPECT_TRUE(batcher.IsBatchComplete());
+  batch = batcher.TakeBatch();
+  ASSERT_EQ(1u, batch.size());
+  EXPECT_EQ("id2", batch[0].commit.id);
+}
+
+TEST(RecordBatcherTest, OrdersBatch) {
+  RecordBatcher batcher;
+  EXPECT_TRUE(batcher.AddRecord(MakeRecord("id3", "1", 2, 3)));
+  EXPECT_TRUE(batcher.AddRecord(MakeRecord("id1", "1", 0, 3)));
+  EXPECT_FALSE(batcher.IsBatchComplete());
+  EXPECT_TRUE(batcher.AddRecord(MakeRecord("id2", "1", 1, 3)));
+  EXPECT_TRUE(batcher.IsBatchComplete());
+
+  std::vector<Record> batch = batcher.TakeBatch();
+  ASSERT_EQ(3u, batch.size());
+  EXPECT_EQ("id1", batch[0].commit.id);
+  EXPECT_EQ("id2", batch[1].commit.id);
+  EXPECT_EQ("id3", batch[2].commit.id);
+}
+
+TEST(RecordBatcherTest, InconsistentRecords) {
+  RecordBatcher batcher;
+  EXPECT_TRUE(batcher.AddRecord(MakeRecord("id1", "1", 0, 2)));
+  EXPECT_FALSE(batcher.AddRecord(MakeRecord("id2", "2", 1, 2)));
+  EXPECT_FALSE(batcher.AddRecord(MakeRecord("id2", "1", 1, 3)));
+
+  batcher.Reset();
+  EXPECT_TRUE(batcher.AddRecord(MakeRecord("id2", "2", 0, 1)));
+  EXPECT_TRUE(batcher.IsBatchComplete());
+}
+
+}  // namespace
+}  // namespace cloud_provider
@@ -85,51 +85,17 @@ void WatchClientImpl::Handle(const std::string& path,
 }
 
 void WatchClientImpl::ProcessRecord(Record record) {
-  if (!batch_timestamp_.empty()) {
-    // There is a pending batch already, verify that the new commits is part of
-    // it.
-    if (record.timestamp != batch_timestamp_) {
-      FTL_LOG(ERROR) << "Two batches of commits are intermixed. "
-                     << "This should not have happened, please file a bug.";
-      HandleError();
-      return;
-    }
-
-    // Received record is for the current batch.
-    if (record.batch_size != batch_size_) {
-      FTL_LOG(ERROR) << "The size of the commit batch is inconsistent. "
-                     << "This should not have happened, please file a bug.";
-      HandleError();
-      return;
-    }
-  } else {
-    // There is no pending batch, start a new one.
-    FTL_DCHECK(batch_.empty());
-    batch_timestamp_ = record.timestamp;
-    batch_size_ = record.batch_size;
-    batch_.reserve(batch_size_);
+  if (!batcher_.AddRecord(std::move(record))) {
+    HandleError();
+    return;
   }
 
-  // Add the new commit to the batch.
-  batch_.push_back(std::move(record));
-
   // If the batch is complete, commit.
-  if (batch_.size() == batch_size_) {
-    CommitBatch();
+  if (batcher_.IsBatchComplete()) {
+    commit_watcher_->OnRemoteCommits(batcher_.TakeBatch());
   }
 }
 
-void WatchClientImpl::CommitBatch() {
-  FTL_DCHECK(batch_.size() == batch_size_);
-  std::sort(batch_.begin(), batch_.end(), [](const auto& lhs, const auto& rhs) {
-    return lhs.batch_position < rhs.batch_position;
-  });
-  commit_watcher_->OnRemoteCommits(std::move(batch_));
-  batch_.clear();
-  batch_timestamp_.clear();
-  batch_size_ = 0;
-}
-
 void WatchClientImpl::OnCancel() {
   FTL_LOG(ERROR) << "Firebase cancelled the watch request.";
   HandleError();
@@ -7,6 +7,7 @@
 
 #include <vector>
 
+#include "apps/ledger/src/cloud_provider/impl/record_batcher.h"
 #include "apps/ledger/src/cloud_provider/public/commit_watcher.h"
 #include "apps/ledger/src/cloud_provider/public/record.h"
 #include "apps/ledger/src/firebase/firebase.h"
@@ -39,8 +40,6 @@ class WatchClientImpl : public firebase::WatchClient {
 
   void ProcessRecord(Record record);
 
-  void CommitBatch();
-
   void HandleDecodingError(const std::string& path,
                            const rapidjson::Value& value,
                            const char error_description[]);
@@ -49,12 +48,7 @@ class WatchClientImpl : public firebase::WatchClient {
   firebase::Firebase* const firebase_;
   CommitWatcher* const commit_watcher_;
   bool errored_ = false;
-  // Commits of the current pending batch.
-  std::vector<Record> batch_;
-  // Timestamp of the current pending batch.
-  std::string batch_timestamp_;
-  // Total size of the current pending batch.
-  size_t batch_size_;
+  RecordBatcher batcher_;
 };
 
 }  // namespace cloud_provider
@@ -6,6 +6,7 @@
 #define APPS_LEDGER_SRC_CLOUD_PROVIDER_PUBLIC_CLOUD_PROVIDER_H_
 
 #include <functional>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -13,6 +14,7 @@
 #include "apps/ledger/src/cloud_provider/public/commit_watcher.h"
 #include "apps/ledger/src/cloud_provider/public/record.h"
 #include "apps/ledger/src/cloud_provider/public/types.h"
+#include "apps/ledger/src/network/network_service.h"
 #include "lib/ftl/macros.h"
 #include "mx/socket.h"
 #include "mx/vmo.h"
@@ -70,11 +72,17 @@ class CloudProvider {
   // Retrieves commits not older than the given |min_timestamp|.  Passing empty
   // |min_timestamp| retrieves all commits.
   //
+  // If |max_count| is not 0, only the |max_count| oldest of these commits are
+  // retrieved. The commits sharing the timestamp of the last retrieved one may
+  // then be only partially retrieved, so the next ones must be queried
+  // starting at that timestamp.
+  //
   // The result is a vector of pairs of the retrieved commits and their
   // corresponding server timestamps.
   virtual void GetCommits(
       const std::string& auth_token,
       const std::string& min_timestamp,
+      size_t max_count,
       std::function<void(Status, std::vector<Record>)> callback) = 0;
 
   // Uploads the given object to the cloud under the given id.
@@ -86,12 +94,29 @@ class CloudProvider {
   // Retrieves the object of the given id from the cloud. The size of the object
   // is passed to the callback along with the socket handle, so that the client
   // can verify that all data was streamed when draining the socket.
+  // |priority| is the priority of the underlying network request.
   virtual void GetObject(
       const std::string& auth_token,
       ObjectIdView object_id,
+      ledger::RequestPriority priority,
       std::function<void(Status status, uint64_t size, mx::socket data)>
           callback) = 0;
 
+  // Uploads the given objects to the cloud, bundled in a single pack stored
+  // under |pack_id|. This takes one request regardless of the number of
+  // objects. The objects of a pack can only be retrieved through
+  // GetObjectPack(), so the commits referencing them should carry |pack_id|.
+  virtual void AddObjectPack(const std::string& auth_token,
+                             ObjectIdView pack_id,
+                             std::map<ObjectId, Data> objects,
+                             std::function<void(Status)> callback) = 0;
+
+  // Retrieves the objects of the pack of the given id from the cloud.
+  virtual void GetObjectPack(
+      const std::string& auth_token,
+      ObjectIdView pack_id,
+      std::function<void(Status, std::map<ObjectId, Data>)> callback) = 0;
+
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(CloudProvider);
 };
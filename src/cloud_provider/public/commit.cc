@@ -25,7 +25,7 @@ Commit& Commit::operator=(Commit&& other) = default;
 
 bool Commit::operator==(const Commit& other) const {
   return id == other.id && content == other.content &&
-         storage_objects == other.storage_objects;
+         storage_objects == other.storage_objects && pack_id == other.pack_id;
 }
 
 Commit Commit::Clone() const {
@@ -33,6 +33,7 @@ Commit Commit::Clone() const {
   clone.id = id;
   clone.content = content;
   clone.storage_objects = storage_objects;
+  clone.pack_id = pack_id;
   return clone;
 }
 
@@ -36,6 +36,10 @@ struct Commit {
   // The inline storage objects.
   std::map<ObjectId, Data> storage_objects;
 
+  // The id of the object pack holding the storage objects uploaded along with
+  // the commit, or empty if there is none. See CloudProvider::AddObjectPack().
+  ObjectId pack_id;
+
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(Commit);
 };
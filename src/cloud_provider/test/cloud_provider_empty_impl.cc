@@ -29,6 +29,7 @@ void CloudProviderEmptyImpl::UnwatchCommits(CommitWatcher* /*watcher*/) {
 void CloudProviderEmptyImpl::GetCommits(
     const std::string& /*auth_token*/,
     const std::string& /*min_timestamp*/,
+    size_t /*max_count*/,
     std::function<void(Status, std::vector<Record>)> /*callback*/) {
   FTL_NOTIMPLEMENTED();
 }
@@ -44,10 +45,26 @@ void CloudProviderEmptyImpl::AddObject(
 void CloudProviderEmptyImpl::GetObject(
     const std::string& /*auth_token*/,
     ObjectIdView /*object_id*/,
+    ledger::RequestPriority /*priority*/,
     std::function<void(Status status, uint64_t size, mx::socket data)>
     /*callback*/) {
   FTL_NOTIMPLEMENTED();
 }
 
+void CloudProviderEmptyImpl::AddObjectPack(
+    const std::string& /*auth_token*/,
+    ObjectIdView /*pack_id*/,
+    std::map<ObjectId, Data> /*objects*/,
+    std::function<void(Status)> /*callback*/) {
+  FTL_NOTIMPLEMENTED();
+}
+
+void CloudProviderEmptyImpl::GetObjectPack(
+    const std::string& /*auth_token*/,
+    ObjectIdView /*pack_id*/,
+    std::function<void(Status, std::map<ObjectId, Data>)> /*callback*/) {
+  FTL_NOTIMPLEMENTED();
+}
+
 }  // namespace test
 }  // namespace cloud_provider
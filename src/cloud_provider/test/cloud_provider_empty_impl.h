@@ -6,6 +6,7 @@
 #define APPS_LEDGER_SRC_CLOUD_PROVIDER_TEST_CLOUD_PROVIDER_EMPTY_IMPL_H_
 
 #include <functional>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -36,6 +37,7 @@ class CloudProviderEmptyImpl : public CloudProvider {
   void GetCommits(
       const std::string& auth_token,
       const std::string& min_timestamp,
+      size_t max_count,
       std::function<void(Status, std::vector<Record>)> callback) override;
 
   void AddObject(const std::string& auth_token,
@@ -46,8 +48,19 @@ class CloudProviderEmptyImpl : public CloudProvider {
   void GetObject(
       const std::string& auth_token,
       ObjectIdView object_id,
+      ledger::RequestPriority priority,
       std::function<void(Status status, uint64_t size, mx::socket data)>
           callback) override;
+
+  void AddObjectPack(const std::string& auth_token,
+                     ObjectIdView pack_id,
+                     std::map<ObjectId, Data> objects,
+                     std::function<void(Status)> callback) override;
+
+  void GetObjectPack(
+      const std::string& auth_token,
+      ObjectIdView pack_id,
+      std::function<void(Status, std::map<ObjectId, Data>)> callback) override;
 };
 
 }  // namespace test
@@ -68,6 +68,33 @@ TEST_F(AggregatorTest, AggregateTwo) {
   EXPECT_EQ(UPLOAD_IN_PROGRESS, base_watcher->states.rbegin()->upload);
 }
 
+TEST_F(AggregatorTest, AggregateQueuePositions) {
+  std::unique_ptr<RecordingWatcher> base_watcher =
+      std::make_unique<RecordingWatcher>();
+
+  Aggregator aggregator(base_watcher.get());
+
+  std::unique_ptr<SyncStateWatcher> watcher1 = aggregator.GetNewStateWatcher();
+  std::unique_ptr<SyncStateWatcher> watcher2 = aggregator.GetNewStateWatcher();
+
+  SyncStateWatcher::SyncStateContainer state(CATCH_UP_DOWNLOAD,
+                                             WAIT_CATCH_UP_DOWNLOAD);
+  state.queue_position = 5u;
+  watcher1->Notify(state);
+  EXPECT_EQ(5u, base_watcher->states.rbegin()->queue_position);
+
+  state.queue_position = 2u;
+  watcher2->Notify(state);
+  EXPECT_EQ(2u, base_watcher->states.rbegin()->queue_position);
+
+  // The admitted page no longer counts.
+  watcher2->Notify(CATCH_UP_DOWNLOAD, WAIT_CATCH_UP_DOWNLOAD);
+  EXPECT_EQ(5u, base_watcher->states.rbegin()->queue_position);
+
+  watcher1->Notify(CATCH_UP_DOWNLOAD, WAIT_CATCH_UP_DOWNLOAD);
+  EXPECT_EQ(0u, base_watcher->states.rbegin()->queue_position);
+}
+
 }  // namespace
 
 }  // namespace cloud_sync
@@ -5,17 +5,40 @@
 #include "apps/ledger/src/cloud_sync/impl/batch_upload.h"
 
 #include <algorithm>
-#include <unordered_set>
+#include <functional>
+#include <iterator>
 #include <utility>
 
+#include "apps/ledger/src/callback/waiter.h"
 #include "apps/ledger/src/cloud_provider/public/commit.h"
 #include "apps/ledger/src/cloud_provider/public/types.h"
+#include "apps/ledger/src/glue/crypto/hash.h"
 #include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/logging.h"
 #include "lib/mtl/vmo/strings.h"
 
 namespace cloud_sync {
 
+namespace {
+
+// Id of the trace event measuring the upload latency of a commit.
+uint64_t GetCommitTraceId(const storage::CommitId& commit_id) {
+  return std::hash<storage::CommitId>()(commit_id);
+}
+
+// Returns the id of the object pack holding the given objects. As object ids
+// are computed from the content of the objects, so is the pack id.
+cloud_provider::ObjectId ComputePackId(
+    const std::map<cloud_provider::ObjectId, cloud_provider::Data>& objects) {
+  std::string object_ids;
+  for (const auto& object : objects) {
+    object_ids.append(object.first);
+  }
+  return glue::SHA256Hash(object_ids);
+}
+
+}  // namespace
+
 BatchUpload::BatchUpload(
     storage::PageStorage* storage,
     cloud_provider::CloudProvider* cloud_provider,
@@ -23,19 +46,28 @@ BatchUpload::BatchUpload(
     std::vector<std::unique_ptr<const storage::Commit>> commits,
     ftl::Closure on_done,
     ftl::Closure on_error,
-    unsigned int max_concurrent_uploads)
+    unsigned int max_concurrent_uploads,
+    size_t max_packed_object_size,
+    size_t max_pack_size)
     : storage_(storage),
       cloud_provider_(cloud_provider),
       auth_provider_(auth_provider),
       commits_(std::move(commits)),
       on_done_(std::move(on_done)),
       on_error_(std::move(on_error)),
-      max_concurrent_uploads_(max_concurrent_uploads) {
+      max_concurrent_uploads_(max_concurrent_uploads),
+      max_packed_object_size_(max_packed_object_size),
+      max_pack_size_(max_pack_size) {
   TRACE_ASYNC_BEGIN("ledger", "batch_upload",
                     reinterpret_cast<uintptr_t>(this));
   FTL_DCHECK(storage_);
   FTL_DCHECK(cloud_provider_);
   FTL_DCHECK(auth_provider_);
+  for (const auto& commit : commits_) {
+    commit_ids_.insert(commit->GetId());
+    TRACE_ASYNC_BEGIN("ledger", "commit_upload",
+                      GetCommitTraceId(commit->GetId()));
+  }
 }
 
 BatchUpload::~BatchUpload() {
@@ -46,38 +78,101 @@ void BatchUpload::Start() {
   FTL_DCHECK(!started_);
   FTL_DCHECK(!errored_);
   started_ = true;
-  RefreshAuthToken([this] {
-    storage_->GetUnsyncedPieces(
-        [this](storage::Status status,
-               std::vector<storage::ObjectId> object_ids) {
-          FTL_DCHECK(status == storage::Status::OK);
-          for (auto& object_id : object_ids) {
-            remaining_object_ids_.push(std::move(object_id));
-          }
-          StartObjectUpload();
-        });
-  });
+  RefreshAuthToken([this] { Resume(); });
 }
 
 void BatchUpload::Retry() {
   FTL_DCHECK(started_);
   FTL_DCHECK(errored_);
   errored_ = false;
-  RefreshAuthToken([this] { StartObjectUpload(); });
+  error_reported_ = false;
+  RefreshAuthToken([this] { Resume(); });
+}
+
+void BatchUpload::AddCommits(
+    std::vector<std::unique_ptr<const storage::Commit>> commits) {
+  FTL_DCHECK(started_);
+  for (auto& commit : commits) {
+    if (!commit_ids_.insert(commit->GetId()).second) {
+      continue;
+    }
+    TRACE_ASYNC_BEGIN("ledger", "commit_upload",
+                      GetCommitTraceId(commit->GetId()));
+    commits_.push_back(std::move(commit));
+  }
+  // If an error occurred, the new commits are uploaded on retry.
+  StartObjectUpload();
+}
+
+void BatchUpload::Resume() {
+  if (!object_upload_in_progress_) {
+    StartObjectUpload();
+  } else if (!listing_objects_) {
+    ContinueObjectUpload();
+  }
+  UploadCommits();
 }
 
 void BatchUpload::StartObjectUpload() {
-  FTL_DCHECK(current_uploads_ == 0u);
-  // If there are no unsynced objects left, upload the commits.
-  if (remaining_object_ids_.empty()) {
-    FilterAndUploadCommits();
+  if (errored_ || refreshing_token_ || object_upload_in_progress_ ||
+      ready_commits_ == commits_.size()) {
+    return;
+  }
+
+  // The unsynced objects in storage cover all the commits added so far.
+  object_upload_in_progress_ = true;
+  object_upload_commits_ = commits_.size();
+  listing_objects_ = true;
+  storage_->GetUnsyncedPieces([this](
+      storage::Status status, std::vector<storage::ObjectId> object_ids) {
+    FTL_DCHECK(status == storage::Status::OK);
+    listing_objects_ = false;
+    for (auto& object_id : object_ids) {
+      remaining_object_ids_.push(std::move(object_id));
+    }
+    ContinueObjectUpload();
+  });
+}
+
+void BatchUpload::ContinueObjectUpload() {
+  FTL_DCHECK(object_upload_in_progress_);
+  // Objects are usually read synchronously from storage, and small objects
+  // are then added to the pack right away. Calls made while the loop below
+  // starts the next uploads are handled by the loop itself, so that the stack
+  // does not grow with the number of objects.
+  if (starting_uploads_) {
+    return;
+  }
+  if (errored_) {
+    CheckError();
     return;
   }
 
-  while (current_uploads_ < max_concurrent_uploads_ &&
+  starting_uploads_ = true;
+  while (!errored_ && current_uploads_ < max_concurrent_uploads_ &&
          !remaining_object_ids_.empty()) {
     UploadNextObject();
   }
+  starting_uploads_ = false;
+  if (errored_) {
+    CheckError();
+    return;
+  }
+  if (current_uploads_ > 0u || !remaining_object_ids_.empty()) {
+    return;
+  }
+  if (!pack_objects_.empty()) {
+    UploadPack();
+    return;
+  }
+
+  // All the referenced objects are uploaded, the commits can be uploaded.
+  object_upload_in_progress_ = false;
+  pack_full_ = false;
+  ready_commits_ = std::max(ready_commits_, object_upload_commits_);
+  // Upload the objects of the commits added in the meantime, if any.
+  StartObjectUpload();
+  UploadCommits();
 }
 
 void BatchUpload::UploadNextObject() {
@@ -96,6 +191,28 @@ void BatchUpload::UploadNextObject() {
 }
 
 void BatchUpload::UploadObject(std::unique_ptr<const storage::Object> object) {
+  if (max_packed_object_size_ > 0u && !pack_full_) {
+    ftl::StringView content;
+    auto status = object->GetData(&content);
+    // TODO(ppi): LE-225 Handle disk IO errors.
+    FTL_DCHECK(status == storage::Status::OK);
+    if (content.size() <= max_packed_object_size_) {
+      // The object is uploaded in the pack of this batch, once the other ones
+      // are uploaded.
+      pack_objects_[object->GetId()] = content.ToString();
+      pack_size_ += content.size();
+      current_uploads_--;
+      if (pack_size_ >= max_pack_size_) {
+        // Commits reference a single pack: upload it now, and upload the
+        // following small objects of this batch individually.
+        pack_full_ = true;
+        UploadPack();
+      }
+      ContinueObjectUpload();
+      return;
+    }
+  }
+
   mx::vmo data;
   auto status = object->GetVmo(&data);
   // TODO(ppi): LE-225 Handle disk IO errors.
@@ -106,113 +223,168 @@ void BatchUpload::UploadObject(std::unique_ptr<const storage::Object> object) {
       auth_token_, object->GetId(), std::move(data),
       [ this, id = std::move(id) ](cloud_provider::Status status) mutable {
         FTL_DCHECK(current_uploads_ > 0);
-        current_uploads_--;
 
         if (status != cloud_provider::Status::OK) {
+          current_uploads_--;
           errored_ = true;
           // Re-enqueue the object for another upload attempt.
           remaining_object_ids_.push(std::move(id));
-
-          if (current_uploads_ == 0u) {
-            on_error_();
-          }
+          CheckError();
           return;
         }
 
         // Uploading the object succeeded.
         storage_->MarkPieceSynced(id, [this](storage::Status status) {
           FTL_DCHECK(status == storage::Status::OK);
-
-          // Notify the user about the error once all pending uploads of the
-          // recent retry complete.
-          if (errored_ && current_uploads_ == 0u) {
-            on_error_();
-            return;
-          }
-
-          if (current_uploads_ == 0 && remaining_object_ids_.empty()) {
-            // All the referenced objects are uploaded, upload the commits.
-            FilterAndUploadCommits();
-            return;
-          }
-
-          if (!errored_ && !remaining_object_ids_.empty()) {
-            UploadNextObject();
-          }
+          current_uploads_--;
+          ContinueObjectUpload();
         });
       });
 }
 
-void BatchUpload::FilterAndUploadCommits() {
-  // Remove all commits that have been synced since this upload object was
-  // created. This will happen if a merge is executed on multiple devices at the
-  // same time.
-  storage_->GetUnsyncedCommits(
-      [this](storage::Status status,
-             std::vector<std::unique_ptr<const storage::Commit>> commits) {
-        std::unordered_set<storage::CommitId> commit_ids;
-        commit_ids.reserve(commits.size());
-        std::transform(
-            commits.begin(), commits.end(),
-            std::inserter(commit_ids, commit_ids.begin()),
-            [](const std::unique_ptr<const storage::Commit>& commit) {
-              return commit->GetId();
-            });
-
-        commits_.erase(
-            std::remove_if(
-                commits_.begin(), commits_.end(),
-                [&commit_ids](
-                    const std::unique_ptr<const storage::Commit>& commit) {
-                  return commit_ids.count(commit->GetId()) == 0;
-                }),
-            commits_.end());
+void BatchUpload::UploadPack() {
+  FTL_DCHECK(current_uploads_ < max_concurrent_uploads_);
+  current_uploads_++;
+  cloud_provider::ObjectId pack_id = ComputePackId(pack_objects_);
+  // Keep the objects, to upload them again on retry.
+  cloud_provider_->AddObjectPack(auth_token_, pack_id, pack_objects_, [
+    this, pack_id
+  ](cloud_provider::Status status) {
+    FTL_DCHECK(current_uploads_ > 0);
 
-        UploadCommits();
-      });
+    if (status != cloud_provider::Status::OK) {
+      current_uploads_--;
+      errored_ = true;
+      CheckError();
+      return;
+    }
+
+    auto waiter =
+        callback::StatusWaiter<storage::Status>::Create(storage::Status::OK);
+    for (const auto& object : pack_objects_) {
+      storage_->MarkPieceSynced(object.first, waiter->NewCallback());
+    }
+    waiter->Finalize([ this, pack_id ](storage::Status status) {
+      FTL_DCHECK(status == storage::Status::OK);
+      // The objects of the commits covered by this object upload are all
+      // uploaded by now: the commits not ready yet reference the pack.
+      for (size_t i = ready_commits_; i < object_upload_commits_; ++i) {
+        commit_pack_ids_[commits_[i]->GetId()] = pack_id;
+      }
+      pack_objects_.clear();
+      pack_size_ = 0u;
+      current_uploads_--;
+      ContinueObjectUpload();
+    });
+  });
 }
 
 void BatchUpload::UploadCommits() {
-  FTL_DCHECK(!errored_);
+  if (errored_ || refreshing_token_ || commit_upload_in_progress_) {
+    return;
+  }
+
+  if (ready_commits_ == 0u) {
+    if (commits_.empty() && !object_upload_in_progress_) {
+      // This object can be deleted in the on_done_() callback, don't do
+      // anything after the call.
+      on_done_();
+    }
+    return;
+  }
+
+  // Skip the commits that have been synced since they were added to this
+  // upload. This will happen if a merge is executed on multiple devices at the
+  // same time.
   std::vector<cloud_provider::Commit> commits;
-  std::vector<storage::CommitId> ids;
-  for (auto& storage_commit : commits_) {
-    storage::CommitId id = storage_commit->GetId();
-    cloud_provider::Commit commit(
-        id, storage_commit->GetStorageBytes().ToString(),
+  for (size_t i = 0; i < ready_commits_; ++i) {
+    const storage::CommitId& id = commits_[i]->GetId();
+    bool is_synced;
+    storage::Status status = storage_->IsCommitSynced(id, &is_synced);
+    FTL_DCHECK(status == storage::Status::OK);
+    if (is_synced) {
+      TRACE_ASYNC_END("ledger", "commit_upload", GetCommitTraceId(id));
+      continue;
+    }
+    commits.emplace_back(
+        id, commits_[i]->GetStorageBytes().ToString(),
         std::map<cloud_provider::ObjectId, cloud_provider::Data>{});
-    commits.push_back(std::move(commit));
-    ids.push_back(std::move(id));
+    auto pack_it = commit_pack_ids_.find(id);
+    if (pack_it != commit_pack_ids_.end()) {
+      commits.back().pack_id = pack_it->second;
+    }
+    uploading_commits_.push_back(std::move(commits_[i]));
   }
+  commits_.erase(commits_.begin(), commits_.begin() + ready_commits_);
+  object_upload_commits_ -= std::min(object_upload_commits_, ready_commits_);
+  ready_commits_ = 0u;
+
+  if (commits.empty()) {
+    UploadCommits();
+    return;
+  }
+
+  commit_upload_in_progress_ = true;
   cloud_provider_->AddCommits(
-      auth_token_, std::move(commits),
-      [ this, commit_ids = std::move(ids) ](cloud_provider::Status status) {
-        // UploadCommit() is called as a last step of a so-far-successful upload
-        // attempt, so we couldn't have failed before.
-        FTL_DCHECK(!errored_);
+      auth_token_, std::move(commits), [this](cloud_provider::Status status) {
+        commit_upload_in_progress_ = false;
         if (status != cloud_provider::Status::OK) {
           errored_ = true;
-          on_error_();
+          // Put the commits back, to upload them again on retry.
+          size_t count = uploading_commits_.size();
+          commits_.insert(commits_.begin(),
+                          std::make_move_iterator(uploading_commits_.begin()),
+                          std::make_move_iterator(uploading_commits_.end()));
+          uploading_commits_.clear();
+          ready_commits_ += count;
+          if (object_upload_in_progress_) {
+            object_upload_commits_ += count;
+          }
+          CheckError();
           return;
         }
-        for (auto& id : commit_ids) {
-          auto ret = storage_->MarkCommitSynced(id);
+
+        for (auto& commit : uploading_commits_) {
+          commit_pack_ids_.erase(commit->GetId());
+          auto ret = storage_->MarkCommitSynced(commit->GetId());
           FTL_DCHECK(ret == storage::Status::OK);
+          TRACE_ASYNC_END("ledger", "commit_upload",
+                          GetCommitTraceId(commit->GetId()));
+        }
+        uploaded_commits_ += uploading_commits_.size();
+        TRACE_COUNTER("ledger", "uploaded_commits",
+                      reinterpret_cast<uintptr_t>(this), "count",
+                      uploaded_commits_);
+        uploading_commits_.clear();
+
+        if (errored_) {
+          CheckError();
+          return;
         }
-        // This object can be deleted in the on_done_() callback, don't do
-        // anything after the call.
-        on_done_();
+        UploadCommits();
       });
 }
 
+void BatchUpload::CheckError() {
+  if (!errored_ || error_reported_ || refreshing_token_ ||
+      current_uploads_ > 0u || listing_objects_ ||
+      commit_upload_in_progress_) {
+    return;
+  }
+  error_reported_ = true;
+  on_error_();
+}
+
 void BatchUpload::RefreshAuthToken(ftl::Closure on_refreshed) {
+  refreshing_token_ = true;
   auth_token_requests_.emplace(auth_provider_->GetFirebaseToken([
     this, on_refreshed = std::move(on_refreshed)
   ](AuthStatus auth_status, std::string auth_token) {
+    refreshing_token_ = false;
     if (auth_status != AuthStatus::OK) {
       FTL_LOG(ERROR) << "Failed to retrieve the auth token for upload.";
       errored_ = true;
-      on_error_();
+      CheckError();
       return;
     }
 
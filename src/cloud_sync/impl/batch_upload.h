@@ -6,8 +6,11 @@
 #define APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_BATCH_UPLOAD_H_
 
 #include <functional>
+#include <map>
 #include <memory>
 #include <queue>
+#include <string>
+#include <unordered_set>
 
 #include "apps/ledger/src/callback/cancellable.h"
 #include "apps/ledger/src/cloud_provider/public/cloud_provider.h"
@@ -28,6 +31,18 @@ namespace cloud_sync {
 // The commits in the batch are uploaded in one network request once all objects
 // are uploaded.
 //
+// More commits can be appended to a running upload with AddCommits(). They
+// form the next batch: its objects are uploaded while the commits of the
+// current batch are being acknowledged, and its commits are uploaded right
+// after. Commits already synced when their batch is uploaded are skipped.
+//
+// If |max_packed_object_size| is not 0, the objects not larger than it are
+// not uploaded individually: once the other objects of a batch are uploaded,
+// they are uploaded together in a single object pack, which the commits of the
+// batch reference. Once the objects of the pack reach |max_pack_size| bytes,
+// the pack is uploaded right away, and the remaining small objects of the
+// batch are uploaded individually.
+//
 // Usage: call Start() to kick off the upload. |on_done| is called after the
 // upload is successfully completed. |on_error| will be called at most once
 // after each error. Each time after |on_error| is called the client can
@@ -47,7 +62,9 @@ class BatchUpload {
               std::vector<std::unique_ptr<const storage::Commit>> commits,
               ftl::Closure on_done,
               ftl::Closure on_error,
-              unsigned int max_concurrent_uploads = 10);
+              unsigned int max_concurrent_uploads = 10,
+              size_t max_packed_object_size = 0u,
+              size_t max_pack_size = 1024 * 1024);
   ~BatchUpload();
 
   // Starts a new upload attempt. Results are reported through |on_done|
@@ -58,29 +75,56 @@ class BatchUpload {
   // is called, the client can retry by calling this method.
   void Retry();
 
+  // Appends the given commits to the upload. Commits already part of the
+  // upload are ignored. Must be called after Start() and before |on_done| is
+  // called.
+  void AddCommits(std::vector<std::unique_ptr<const storage::Commit>> commits);
+
  private:
+  // Resumes the upload after the auth token is refreshed.
+  void Resume();
+
+  // Starts uploading the objects of the commits whose objects have not been
+  // uploaded yet, if no such upload is already in progress.
   void StartObjectUpload();
 
+  // Continues the upload of the objects, and uploads the commits once all
+  // objects are uploaded.
+  void ContinueObjectUpload();
+
   void UploadNextObject();
 
   // Uploads the given object.
   void UploadObject(std::unique_ptr<const storage::Object> object);
 
-  // Filters already synced commits.
-  void FilterAndUploadCommits();
+  // Uploads the objects accumulated in |pack_objects_| as an object pack.
+  void UploadPack();
 
-  // Uploads the commits.
+  // Uploads the commits whose objects are uploaded, unless commits are
+  // already being uploaded. Calls |on_done_| when everything is uploaded.
   void UploadCommits();
 
+  // Calls |on_error_| if an error occurred and no request is pending anymore.
+  void CheckError();
+
   void RefreshAuthToken(ftl::Closure on_refreshed);
 
   storage::PageStorage* const storage_;
   cloud_provider::CloudProvider* const cloud_provider_;
   AuthProvider* const auth_provider_;
+  // Commits not yet uploaded, in upload order. The objects of the first
+  // |ready_commits_| commits are already uploaded.
   std::vector<std::unique_ptr<const storage::Commit>> commits_;
+  size_t ready_commits_ = 0u;
+  // Commits being uploaded.
+  std::vector<std::unique_ptr<const storage::Commit>> uploading_commits_;
+  // Ids of all the commits of this upload.
+  std::unordered_set<storage::CommitId> commit_ids_;
   ftl::Closure on_done_;
   ftl::Closure on_error_;
   const unsigned int max_concurrent_uploads_;
+  const size_t max_packed_object_size_;
+  const size_t max_pack_size_;
 
   // Auth token to be used for uploading the objects and the commit. It is
   // refreshed each time Start() or Retry() is called.
@@ -89,11 +133,38 @@ class BatchUpload {
   // All remaining object ids to be uploaded along with this batch of commits.
   std::queue<storage::ObjectId> remaining_object_ids_;
 
+  // Objects to upload in the object pack of the current object upload, and
+  // their total size.
+  std::map<cloud_provider::ObjectId, cloud_provider::Data> pack_objects_;
+  size_t pack_size_ = 0u;
+  // Set once the pack of the current object upload is full.
+  bool pack_full_ = false;
+  // Id of the object pack referenced by each commit not uploaded yet.
+  std::map<storage::CommitId, cloud_provider::ObjectId> commit_pack_ids_;
+
   // Number of object uploads currently in progress.
   unsigned int current_uploads_ = 0u;
 
+  // Set while uploading objects. |object_upload_commits_| is the number of
+  // commits of |commits_| whose objects are covered by this upload.
+  bool object_upload_in_progress_ = false;
+  size_t object_upload_commits_ = 0u;
+  // Set while listing the unsynced objects.
+  bool listing_objects_ = false;
+  // Set while ContinueObjectUpload() starts the next object uploads.
+  bool starting_uploads_ = false;
+  // Set while uploading commits.
+  bool commit_upload_in_progress_ = false;
+
   bool started_ = false;
   bool errored_ = false;
+  // Set while waiting for an auth token.
+  bool refreshing_token_ = false;
+  // Set once |on_error_| has been called for the current error.
+  bool error_reported_ = false;
+
+  // Number of commits uploaded so far.
+  uint64_t uploaded_commits_ = 0u;
 
   // Pending auth token requests to be cancelled when this class goes away.
   callback::CancellableContainer auth_token_requests_;
@@ -19,6 +19,7 @@
 #include "apps/ledger/src/test/test_with_message_loop.h"
 #include "gtest/gtest.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_printf.h"
 #include "lib/ftl/strings/string_view.h"
 #include "lib/mtl/tasks/message_loop.h"
 #include "lib/mtl/vmo/strings.h"
@@ -115,6 +116,7 @@ class TestPageStorage : public storage::test::PageStorageEmptyImpl {
   void MarkPieceSynced(storage::ObjectIdView object_id,
                        std::function<void(storage::Status)> callback) override {
     objects_marked_as_synced.insert(object_id.ToString());
+    unsynced_objects_to_return.erase(object_id.ToString());
     callback(storage::Status::OK);
   }
 
@@ -131,6 +133,16 @@ class TestPageStorage : public storage::test::PageStorageEmptyImpl {
     return storage::Status::OK;
   }
 
+  storage::Status IsCommitSynced(const storage::CommitId& commit_id,
+                                 bool* is_synced) override {
+    *is_synced = std::none_of(
+        unsynced_commits.begin(), unsynced_commits.end(),
+        [&commit_id](const std::unique_ptr<const storage::Commit>& commit) {
+          return commit->GetId() == commit_id;
+        });
+    return storage::Status::OK;
+  }
+
   std::unique_ptr<TestCommit> NewCommit(std::string id, std::string content) {
     auto commit =
         std::make_unique<TestCommit>(std::move(id), std::move(content));
@@ -165,8 +177,15 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
       std::move(commits.begin(), commits.end(),
                 std::back_inserter(received_commits));
     }
-    message_loop_->task_runner()->PostTask(
-        [this, callback]() { callback(commit_status_to_return); });
+    ftl::Closure report_result = [ callback,
+                                   status = commit_status_to_return ] {
+      callback(status);
+    };
+    if (delay_add_commits_callbacks) {
+      pending_add_commits_callbacks.push_back(std::move(report_result));
+    } else {
+      message_loop_->task_runner()->PostTask(std::move(report_result));
+    }
   }
 
   void AddObject(
@@ -195,6 +214,19 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
     }
   }
 
+  void AddObjectPack(
+      const std::string& auth_token,
+      cloud_provider::ObjectIdView pack_id,
+      std::map<cloud_provider::ObjectId, cloud_provider::Data> objects,
+      std::function<void(cloud_provider::Status)> callback) override {
+    add_object_pack_calls++;
+    if (object_status_to_return == cloud_provider::Status::OK) {
+      received_packs[pack_id.ToString()] = std::move(objects);
+    }
+    message_loop_->task_runner()->PostTask(
+        [ callback, status = object_status_to_return ] { callback(status); });
+  }
+
   void RunPendingCallbacks() {
     for (auto& callback : pending_add_object_callbacks) {
       callback();
@@ -202,17 +234,30 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
     pending_add_object_callbacks.clear();
   }
 
+  void RunPendingAddCommitsCallbacks() {
+    for (auto& callback : pending_add_commits_callbacks) {
+      callback();
+    }
+    pending_add_commits_callbacks.clear();
+  }
+
   bool delay_add_object_callbacks = false;
   std::vector<ftl::Closure> pending_add_object_callbacks;
   cloud_provider::Status object_status_to_return = cloud_provider::Status::OK;
   bool reset_object_status_after_call = false;
   cloud_provider::Status commit_status_to_return = cloud_provider::Status::OK;
+  bool delay_add_commits_callbacks = false;
+  std::vector<ftl::Closure> pending_add_commits_callbacks;
   unsigned int add_object_calls = 0u;
+  unsigned int add_object_pack_calls = 0u;
   unsigned int add_commits_calls = 0u;
   std::vector<std::string> received_commit_tokens;
   std::vector<cloud_provider::Commit> received_commits;
   std::vector<std::string> received_object_tokens;
   std::map<cloud_provider::ObjectId, std::string> received_objects;
+  std::map<cloud_provider::ObjectId,
+           std::map<cloud_provider::ObjectId, cloud_provider::Data>>
+      received_packs;
 
  private:
   mtl::MessageLoop* message_loop_;
@@ -235,7 +280,9 @@ class BatchUploadTest : public ::test::TestWithMessageLoop {
 
   std::unique_ptr<BatchUpload> MakeBatchUpload(
       std::vector<std::unique_ptr<const storage::Commit>> commits,
-      unsigned int max_concurrent_uploads = 10) {
+      unsigned int max_concurrent_uploads = 10,
+      size_t max_packed_object_size = 0u,
+      size_t max_pack_size = 1024 * 1024) {
     return std::make_unique<BatchUpload>(&storage_, &cloud_provider_,
                                          &auth_provider_, std::move(commits),
                                          [this] {
@@ -246,7 +293,9 @@ class BatchUploadTest : public ::test::TestWithMessageLoop {
                                            error_calls_++;
                                            message_loop_.PostQuitTask();
                                          },
-                                         max_concurrent_uploads);
+                                         max_concurrent_uploads,
+                                         max_packed_object_size,
+                                         max_pack_size);
   }
 
  private:
@@ -627,6 +676,187 @@ TEST_F(BatchUploadTest, DoNotUploadSyncedCommitsOnRetry) {
   EXPECT_EQ(0u, cloud_provider_.received_commits.size());
 }
 
+// Verifies that the objects of commits added to a running upload are uploaded
+// while the previous commits are being acknowledged.
+TEST_F(BatchUploadTest, PipelineAddedCommits) {
+  std::vector<std::unique_ptr<const storage::Commit>> commits;
+  commits.push_back(storage_.NewCommit("id1", "content1"));
+  storage_.unsynced_objects_to_return["obj_id1"] =
+      std::make_unique<TestObject>("obj_id1", "obj_data1");
+
+  auto batch_upload = MakeBatchUpload(std::move(commits));
+
+  cloud_provider_.delay_add_commits_callbacks = true;
+  batch_upload->Start();
+  EXPECT_TRUE(RunLoopUntil(
+      [this] { return cloud_provider_.add_commits_calls == 1u; }));
+
+  std::vector<std::unique_ptr<const storage::Commit>> more_commits;
+  more_commits.push_back(storage_.NewCommit("id2", "content2"));
+  // Commits already part of the upload are ignored.
+  more_commits.push_back(std::make_unique<TestCommit>("id1", "content1"));
+  storage_.unsynced_objects_to_return["obj_id2"] =
+      std::make_unique<TestObject>("obj_id2", "obj_data2");
+  batch_upload->AddCommits(std::move(more_commits));
+
+  EXPECT_TRUE(RunLoopUntil([this] {
+    return storage_.objects_marked_as_synced.count("obj_id2") == 1u;
+  }));
+  EXPECT_EQ(1u, cloud_provider_.add_commits_calls);
+  EXPECT_EQ(0u, storage_.commits_marked_as_synced.size());
+
+  cloud_provider_.delay_add_commits_callbacks = false;
+  cloud_provider_.RunPendingAddCommitsCallbacks();
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1u, done_calls_);
+  EXPECT_EQ(0u, error_calls_);
+
+  EXPECT_EQ(2u, cloud_provider_.add_commits_calls);
+  ASSERT_EQ(2u, cloud_provider_.received_commits.size());
+  EXPECT_EQ("id1", cloud_provider_.received_commits[0].id);
+  EXPECT_EQ("id2", cloud_provider_.received_commits[1].id);
+  EXPECT_EQ(2u, storage_.commits_marked_as_synced.size());
+  EXPECT_EQ(2u, storage_.objects_marked_as_synced.size());
+}
+
+// Verifies that the small objects are uploaded in a single object pack,
+// referenced by the commits.
+TEST_F(BatchUploadTest, ObjectPack) {
+  std::vector<std::unique_ptr<const storage::Commit>> commits;
+  commits.push_back(storage_.NewCommit("id1", "content1"));
+  commits.push_back(storage_.NewCommit("id2", "content2"));
+
+  storage_.unsynced_objects_to_return["obj_id1"] =
+      std::make_unique<TestObject>("obj_id1", "obj_data1");
+  storage_.unsynced_objects_to_return["obj_id2"] =
+      std::make_unique<TestObject>("obj_id2", "obj_data2");
+  std::string large_data(20, 'a');
+  storage_.unsynced_objects_to_return["obj_id3"] =
+      std::make_unique<TestObject>("obj_id3", large_data);
+
+  auto batch_upload = MakeBatchUpload(std::move(commits), 10, 10);
+
+  batch_upload->Start();
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1u, done_calls_);
+  EXPECT_EQ(0u, error_calls_);
+
+  // The large object is uploaded on its own.
+  EXPECT_EQ(1u, cloud_provider_.add_object_calls);
+  EXPECT_EQ(large_data, cloud_provider_.received_objects["obj_id3"]);
+
+  EXPECT_EQ(1u, cloud_provider_.add_object_pack_calls);
+  ASSERT_EQ(1u, cloud_provider_.received_packs.size());
+  const auto& pack = *cloud_provider_.received_packs.begin();
+  EXPECT_EQ((std::map<cloud_provider::ObjectId, cloud_provider::Data>{
+                {"obj_id1", "obj_data1"}, {"obj_id2", "obj_data2"}}),
+            pack.second);
+
+  ASSERT_EQ(2u, cloud_provider_.received_commits.size());
+  EXPECT_EQ(pack.first, cloud_provider_.received_commits[0].pack_id);
+  EXPECT_EQ(pack.first, cloud_provider_.received_commits[1].pack_id);
+
+  EXPECT_EQ(3u, storage_.objects_marked_as_synced.size());
+  EXPECT_EQ(2u, storage_.commits_marked_as_synced.size());
+}
+
+// Verifies that a failed object pack upload is retried.
+// Verifies that packing many objects does not grow the stack with the number
+// of objects, as they are read synchronously.
+TEST_F(BatchUploadTest, ObjectPackManyObjects) {
+  std::vector<std::unique_ptr<const storage::Commit>> commits;
+  commits.push_back(storage_.NewCommit("id", "content"));
+
+  const size_t object_count = 100000;
+  for (size_t i = 0; i < object_count; ++i) {
+    std::string id = ftl::StringPrintf("obj_id%06zu", i);
+    storage_.unsynced_objects_to_return[id] =
+        std::make_unique<TestObject>(id, "obj_data");
+  }
+
+  auto batch_upload =
+      MakeBatchUpload(std::move(commits), 10, 10, 100 * object_count);
+
+  batch_upload->Start();
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1u, done_calls_);
+  EXPECT_EQ(0u, error_calls_);
+
+  EXPECT_EQ(0u, cloud_provider_.add_object_calls);
+  EXPECT_EQ(1u, cloud_provider_.add_object_pack_calls);
+  ASSERT_EQ(1u, cloud_provider_.received_packs.size());
+  EXPECT_EQ(object_count,
+            cloud_provider_.received_packs.begin()->second.size());
+  EXPECT_EQ(object_count, storage_.objects_marked_as_synced.size());
+}
+
+// Verifies that the pack is uploaded once it reaches its maximum size, and that
+// the following objects are uploaded individually.
+TEST_F(BatchUploadTest, ObjectPackMaxSize) {
+  std::vector<std::unique_ptr<const storage::Commit>> commits;
+  commits.push_back(storage_.NewCommit("id1", "content1"));
+  commits.push_back(storage_.NewCommit("id2", "content2"));
+
+  for (size_t i = 1; i <= 4; ++i) {
+    std::string id = ftl::StringPrintf("obj_id%zu", i);
+    storage_.unsynced_objects_to_return[id] =
+        std::make_unique<TestObject>(id, ftl::StringPrintf("obj_data%zu", i));
+  }
+
+  // The pack is full after its third object.
+  auto batch_upload = MakeBatchUpload(std::move(commits), 10, 10, 25);
+
+  batch_upload->Start();
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1u, done_calls_);
+  EXPECT_EQ(0u, error_calls_);
+
+  EXPECT_EQ(1u, cloud_provider_.add_object_pack_calls);
+  ASSERT_EQ(1u, cloud_provider_.received_packs.size());
+  const auto& pack = *cloud_provider_.received_packs.begin();
+  EXPECT_EQ(3u, pack.second.size());
+  EXPECT_EQ(1u, cloud_provider_.add_object_calls);
+  ASSERT_EQ(1u, cloud_provider_.received_objects.size());
+  EXPECT_EQ(0u, pack.second.count(
+                    cloud_provider_.received_objects.begin()->first));
+
+  ASSERT_EQ(2u, cloud_provider_.received_commits.size());
+  EXPECT_EQ(pack.first, cloud_provider_.received_commits[0].pack_id);
+  EXPECT_EQ(pack.first, cloud_provider_.received_commits[1].pack_id);
+
+  EXPECT_EQ(4u, storage_.objects_marked_as_synced.size());
+  EXPECT_EQ(2u, storage_.commits_marked_as_synced.size());
+}
+
+TEST_F(BatchUploadTest, FailedObjectPackUpload) {
+  std::vector<std::unique_ptr<const storage::Commit>> commits;
+  commits.push_back(storage_.NewCommit("id", "content"));
+  storage_.unsynced_objects_to_return["obj_id1"] =
+      std::make_unique<TestObject>("obj_id1", "obj_data1");
+
+  auto batch_upload = MakeBatchUpload(std::move(commits), 10, 10);
+
+  cloud_provider_.object_status_to_return =
+      cloud_provider::Status::NETWORK_ERROR;
+  batch_upload->Start();
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(0u, done_calls_);
+  EXPECT_EQ(1u, error_calls_);
+  EXPECT_EQ(0u, cloud_provider_.add_commits_calls);
+  EXPECT_EQ(0u, storage_.objects_marked_as_synced.size());
+
+  cloud_provider_.object_status_to_return = cloud_provider::Status::OK;
+  batch_upload->Retry();
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1u, done_calls_);
+  EXPECT_EQ(2u, cloud_provider_.add_object_pack_calls);
+  ASSERT_EQ(1u, cloud_provider_.received_packs.size());
+  ASSERT_EQ(1u, cloud_provider_.received_commits.size());
+  EXPECT_EQ(cloud_provider_.received_packs.begin()->first,
+            cloud_provider_.received_commits[0].pack_id);
+  EXPECT_EQ(1u, storage_.objects_marked_as_synced.size());
+}
+
 }  // namespace
 
 }  // namespace cloud_sync
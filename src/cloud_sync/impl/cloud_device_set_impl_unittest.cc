@@ -29,6 +29,13 @@ class FakeFirebase : public firebase::Firebase {
     callback(returned_status, document);
   }
 
+  void GetStream(const std::string& /*key*/,
+                 const std::vector<std::string>& /*query_params*/,
+                 std::function<void(firebase::Status status, mx::socket data)>
+                 /*callback*/) override {
+    FTL_NOTREACHED();
+  }
+
   void Put(const std::string& /*key*/,
            const std::vector<std::string>& query_params,
            const std::string& data,
@@ -5,6 +5,8 @@
 #ifndef APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_CONSTANTS_H_
 #define APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_CONSTANTS_H_
 
+#include <stddef.h>
+
 #include "lib/ftl/strings/string_view.h"
 
 namespace cloud_sync {
@@ -12,6 +14,21 @@ namespace cloud_sync {
 // Key for the timestamp metadata in the SyncMetadata KV store.
 constexpr ftl::StringView kTimestampKey = "timestamp";
 
+// Prefix of the keys recording, in the SyncMetadata KV store, the object pack
+// holding each object downloaded in a pack.
+constexpr ftl::StringView kObjectPackKeyPrefix = "object_pack/";
+
+// Maximum size of the objects uploaded in object packs. Larger objects are
+// uploaded individually.
+constexpr size_t kMaxPackedObjectSize = 4096;
+
+// Maximum total size of the objects of an object pack.
+constexpr size_t kMaxObjectPackSize = 1024 * 1024;
+
+// Maximum number of remote commits retrieved, and added to storage, at a time
+// when downloading the backlog of remote commits.
+constexpr size_t kBacklogBatchSize = 500;
+
 }  // namespace cloud_sync
 
 #endif  // APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_CONSTANTS_H_
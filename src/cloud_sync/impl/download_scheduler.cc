@@ -0,0 +1,226 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/download_scheduler.h"
+
+#include "apps/ledger/src/glue/socket/socket_pair.h"
+#include "apps/ledger/src/glue/socket/socket_writer.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "lib/ftl/logging.h"
+
+namespace cloud_sync {
+
+DownloadScheduler::DownloadScheduler(size_t max_in_flight)
+    : max_in_flight_(max_in_flight), weak_factory_(this) {
+  FTL_DCHECK(max_in_flight_ > 0);
+}
+
+DownloadScheduler::~DownloadScheduler() {}
+
+void DownloadScheduler::GetObject(const void* client,
+                                  std::string object_id,
+                                  storage::DownloadPriority priority,
+                                  Download download,
+                                  Callback callback) {
+  RequestKey key(client, std::move(object_id));
+  auto it = requests_.find(key);
+  if (it != requests_.end()) {
+    Request& request = it->second;
+    request.callbacks.push_back(std::move(callback));
+    ++deduplicated_requests_;
+    if (!request.in_flight &&
+        priority == storage::DownloadPriority::INTERACTIVE &&
+        request.priority == storage::DownloadPriority::BACKGROUND) {
+      // Promote the queued request. Its entry in the background queue is
+      // skipped when popped.
+      request.priority = priority;
+      interactive_queue_.emplace_back(key, request.id);
+      StartDownloads();
+    }
+    return;
+  }
+
+  Request& request = requests_[key];
+  request.id = next_request_id_++;
+  request.priority = priority;
+  request.download = std::move(download);
+  request.callbacks.push_back(std::move(callback));
+  if (priority == storage::DownloadPriority::INTERACTIVE) {
+    interactive_queue_.emplace_back(std::move(key), request.id);
+  } else {
+    background_queue_.emplace_back(std::move(key), request.id);
+  }
+  ++queued_count_;
+  StartDownloads();
+  ReportMetrics();
+}
+
+void DownloadScheduler::CancelRequests(const void* client) {
+  auto it = requests_.lower_bound(RequestKey(client, ""));
+  while (it != requests_.end() && it->first.first == client) {
+    if (!it->second.in_flight) {
+      --queued_count_;
+    } else if (it->second.download) {
+      // The download of the request is running. Its result will be ignored.
+      OnDownloadStopped();
+    }
+    it = requests_.erase(it);
+  }
+  StartDownloads();
+  ReportMetrics();
+}
+
+double DownloadScheduler::GetThroughput() const {
+  ftl::TimeDelta busy_time = busy_time_;
+  if (in_flight_count_ > 0) {
+    busy_time = busy_time + (ftl::TimePoint::Now() - busy_since_);
+  }
+  if (busy_time <= ftl::TimeDelta::Zero()) {
+    return 0;
+  }
+  return downloaded_bytes_ / busy_time.ToSecondsF();
+}
+
+void DownloadScheduler::StartDownloads() {
+  RequestKey key;
+  while (in_flight_count_ < max_in_flight_ &&
+         (PopRequest(&interactive_queue_, &key) ||
+          PopRequest(&background_queue_, &key))) {
+    StartDownload(key, &requests_[key]);
+  }
+}
+
+bool DownloadScheduler::PopRequest(
+    std::deque<std::pair<RequestKey, uint64_t>>* queue,
+    RequestKey* key) {
+  while (!queue->empty()) {
+    auto entry = std::move(queue->front());
+    queue->pop_front();
+    auto it = requests_.find(entry.first);
+    // Skip the entries of cancelled, already started or promoted requests.
+    if (it == requests_.end() || it->second.id != entry.second ||
+        it->second.in_flight ||
+        (queue == &background_queue_ &&
+         it->second.priority != storage::DownloadPriority::BACKGROUND)) {
+      continue;
+    }
+    *key = std::move(entry.first);
+    return true;
+  }
+  return false;
+}
+
+void DownloadScheduler::StartDownload(const RequestKey& key,
+                                      Request* request) {
+  FTL_DCHECK(!request->in_flight);
+  request->in_flight = true;
+  --queued_count_;
+  if (in_flight_count_ == 0) {
+    busy_since_ = ftl::TimePoint::Now();
+  }
+  ++in_flight_count_;
+
+  // The download may complete synchronously and delete the request, so run a
+  // copy of it.
+  Download download = request->download;
+  download([
+    weak_this = weak_factory_.GetWeakPtr(), key, request_id = request->id
+  ](storage::Status status, uint64_t size, mx::socket data) {
+    if (weak_this) {
+      weak_this->OnDownloadDone(key, request_id, status, size,
+                                std::move(data));
+    }
+  });
+}
+
+void DownloadScheduler::OnDownloadDone(RequestKey key,
+                                       uint64_t request_id,
+                                       storage::Status status,
+                                       uint64_t size,
+                                       mx::socket data) {
+  auto it = requests_.find(key);
+  if (it == requests_.end() || it->second.id != request_id ||
+      !it->second.download) {
+    // The request was cancelled.
+    return;
+  }
+  Request& request = it->second;
+  // Mark the download as done: it no longer counts against the limit.
+  request.download = nullptr;
+  OnDownloadStopped();
+
+  if (status != storage::Status::OK) {
+    std::vector<Callback> callbacks = std::move(request.callbacks);
+    requests_.erase(it);
+    for (auto& callback : callbacks) {
+      callback(status, 0u, mx::socket());
+    }
+    StartDownloads();
+    ReportMetrics();
+    return;
+  }
+
+  ++completed_downloads_;
+  downloaded_bytes_ += size;
+  if (request.callbacks.size() == 1u) {
+    Callback callback = std::move(request.callbacks.front());
+    requests_.erase(it);
+    callback(status, size, std::move(data));
+    StartDownloads();
+    ReportMetrics();
+    return;
+  }
+
+  // The data can only be streamed once. Buffer it, so that it can be handed
+  // to every callback. Callbacks added in the meantime are served as well.
+  auto& drainer = drainers_.emplace();
+  drainer.Start(std::move(data), [
+    weak_this = weak_factory_.GetWeakPtr(), key = std::move(key), request_id,
+    size
+  ](std::string data) mutable {
+    if (weak_this) {
+      weak_this->DispatchData(std::move(key), request_id, size,
+                              std::move(data));
+    }
+  });
+  StartDownloads();
+  ReportMetrics();
+}
+
+void DownloadScheduler::DispatchData(RequestKey key,
+                                     uint64_t request_id,
+                                     uint64_t size,
+                                     std::string data) {
+  auto it = requests_.find(key);
+  if (it == requests_.end() || it->second.id != request_id) {
+    return;
+  }
+  std::vector<Callback> callbacks = std::move(it->second.callbacks);
+  requests_.erase(it);
+  for (auto& callback : callbacks) {
+    glue::SocketPair socket_pair;
+    // StringSocketWriter deletes itself when done.
+    auto writer = new glue::StringSocketWriter();
+    writer->Start(data, std::move(socket_pair.socket2));
+    callback(storage::Status::OK, size, std::move(socket_pair.socket1));
+  }
+}
+
+void DownloadScheduler::OnDownloadStopped() {
+  FTL_DCHECK(in_flight_count_ > 0);
+  --in_flight_count_;
+  if (in_flight_count_ == 0) {
+    busy_time_ = busy_time_ + (ftl::TimePoint::Now() - busy_since_);
+  }
+}
+
+void DownloadScheduler::ReportMetrics() {
+  TRACE_COUNTER("ledger", "download_scheduler",
+                reinterpret_cast<uintptr_t>(this), "queue_depth",
+                static_cast<uint64_t>(queued_count_), "in_flight",
+                static_cast<uint64_t>(in_flight_count_), "downloaded_bytes",
+                downloaded_bytes_);
+}
+
+}  // namespace cloud_sync
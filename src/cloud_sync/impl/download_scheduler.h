@@ -0,0 +1,131 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_DOWNLOAD_SCHEDULER_H_
+#define APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_DOWNLOAD_SCHEDULER_H_
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mx/socket.h>
+
+#include "apps/ledger/src/callback/auto_cleanable.h"
+#include "apps/ledger/src/glue/socket/socket_drainer_client.h"
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace cloud_sync {
+
+// Schedules the object downloads of all the pages synced for a user.
+//
+// At most |max_in_flight| downloads run at the same time. The other ones are
+// queued: INTERACTIVE downloads, that a client is waiting on, run before
+// BACKGROUND ones, and downloads of the same priority run in the order in
+// which they were requested. Concurrent requests of a client for the same
+// object share a single download.
+//
+// Each client, typically a PageSyncImpl, must call CancelRequests() before it
+// goes away: its callbacks are then dropped and its in-flight downloads stop
+// counting against the limit.
+class DownloadScheduler {
+ public:
+  using Callback =
+      std::function<void(storage::Status status, uint64_t size, mx::socket)>;
+  // Runs a download. |callback| must be called exactly once, with the final
+  // result of the download, unless the client cancels its requests first.
+  using Download = std::function<void(Callback callback)>;
+
+  explicit DownloadScheduler(size_t max_in_flight = 10);
+  ~DownloadScheduler();
+
+  // Requests the object |object_id| on behalf of |client|. If |client| has no
+  // pending request for the same object, |download| is queued, and is run
+  // once there is room for it. |callback| is called with the result.
+  void GetObject(const void* client,
+                 std::string object_id,
+                 storage::DownloadPriority priority,
+                 Download download,
+                 Callback callback);
+
+  // Drops all the pending requests of |client|.
+  void CancelRequests(const void* client);
+
+  // Number of downloads waiting for a slot.
+  size_t queue_depth() const { return queued_count_; }
+  // Number of downloads currently running.
+  size_t in_flight() const { return in_flight_count_; }
+  // Number of requests that were served by the download of another request.
+  uint64_t deduplicated_requests() const { return deduplicated_requests_; }
+  // Number of successful downloads and their total size.
+  uint64_t completed_downloads() const { return completed_downloads_; }
+  uint64_t downloaded_bytes() const { return downloaded_bytes_; }
+  // Bytes downloaded per second while at least one download was running.
+  double GetThroughput() const;
+
+ private:
+  using RequestKey = std::pair<const void*, std::string>;
+
+  struct Request {
+    uint64_t id;
+    storage::DownloadPriority priority;
+    Download download;
+    std::vector<Callback> callbacks;
+    bool in_flight = false;
+  };
+
+  // Starts queued downloads while there is room for them.
+  void StartDownloads();
+  // Pops the next queued request from |queue|. Returns false if there is none.
+  bool PopRequest(std::deque<std::pair<RequestKey, uint64_t>>* queue,
+                  RequestKey* key);
+  void StartDownload(const RequestKey& key, Request* request);
+  void OnDownloadDone(RequestKey key,
+                      uint64_t request_id,
+                      storage::Status status,
+                      uint64_t size,
+                      mx::socket data);
+  // Hands the downloaded |data| to every callback of the request.
+  void DispatchData(RequestKey key,
+                    uint64_t request_id,
+                    uint64_t size,
+                    std::string data);
+  void OnDownloadStopped();
+  void ReportMetrics();
+
+  const size_t max_in_flight_;
+  uint64_t next_request_id_ = 0;
+  std::map<RequestKey, Request> requests_;
+  std::deque<std::pair<RequestKey, uint64_t>> interactive_queue_;
+  std::deque<std::pair<RequestKey, uint64_t>> background_queue_;
+
+  size_t queued_count_ = 0;
+  size_t in_flight_count_ = 0;
+  uint64_t deduplicated_requests_ = 0;
+  uint64_t completed_downloads_ = 0;
+  uint64_t downloaded_bytes_ = 0;
+  // Time spent with at least one download running, not counting the current
+  // busy period, which started at |busy_since_|.
+  ftl::TimeDelta busy_time_;
+  ftl::TimePoint busy_since_;
+
+  // Drainers buffering the objects requested more than once.
+  callback::AutoCleanableSet<glue::SocketDrainerClient> drainers_;
+
+  // This must be the last member of this class.
+  ftl::WeakPtrFactory<DownloadScheduler> weak_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(DownloadScheduler);
+};
+
+}  // namespace cloud_sync
+
+#endif  // APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_DOWNLOAD_SCHEDULER_H_
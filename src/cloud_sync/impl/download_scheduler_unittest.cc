@@ -0,0 +1,172 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/download_scheduler.h"
+
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+#include "lib/mtl/socket/strings.h"
+
+namespace cloud_sync {
+namespace {
+
+class DownloadSchedulerTest : public ::test::TestWithMessageLoop {
+ public:
+  DownloadSchedulerTest() {}
+  ~DownloadSchedulerTest() override {}
+
+ protected:
+  // Returns a download recording its object id in |started_|, and waiting
+  // for the test to complete it with CompleteDownload().
+  DownloadScheduler::Download MakeDownload(std::string object_id) {
+    return [ this, object_id = std::move(object_id) ](
+        DownloadScheduler::Callback callback) {
+      started_.push_back(object_id);
+      pending_.push_back(std::move(callback));
+    };
+  }
+
+  void CompleteDownload(size_t index, const std::string& content) {
+    DownloadScheduler::Callback callback = std::move(pending_[index]);
+    callback(storage::Status::OK, content.size(),
+             mtl::WriteStringToSocket(content));
+  }
+
+  DownloadScheduler::Callback MakeCallback(std::vector<std::string>* results) {
+    return [results](storage::Status status, uint64_t size, mx::socket data) {
+      std::string content;
+      EXPECT_EQ(storage::Status::OK, status);
+      EXPECT_TRUE(mtl::BlockingCopyToString(std::move(data), &content));
+      EXPECT_EQ(size, content.size());
+      results->push_back(content);
+    };
+  }
+
+  std::vector<std::string> started_;
+  std::vector<DownloadScheduler::Callback> pending_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(DownloadSchedulerTest);
+};
+
+TEST_F(DownloadSchedulerTest, LimitsInFlightDownloads) {
+  DownloadScheduler scheduler(2);
+  std::vector<std::string> results;
+  for (const auto& id : {"a", "b", "c"}) {
+    scheduler.GetObject(this, id, storage::DownloadPriority::BACKGROUND,
+                        MakeDownload(id), MakeCallback(&results));
+  }
+  EXPECT_EQ(std::vector<std::string>({"a", "b"}), started_);
+  EXPECT_EQ(2u, scheduler.in_flight());
+  EXPECT_EQ(1u, scheduler.queue_depth());
+
+  CompleteDownload(0, "content_a");
+  EXPECT_EQ(std::vector<std::string>({"content_a"}), results);
+  EXPECT_EQ(std::vector<std::string>({"a", "b", "c"}), started_);
+  EXPECT_EQ(2u, scheduler.in_flight());
+  EXPECT_EQ(0u, scheduler.queue_depth());
+
+  CompleteDownload(1, "content_b");
+  CompleteDownload(2, "content_c");
+  EXPECT_EQ(0u, scheduler.in_flight());
+  EXPECT_EQ(3u, scheduler.completed_downloads());
+  EXPECT_EQ(27u, scheduler.downloaded_bytes());
+}
+
+TEST_F(DownloadSchedulerTest, InteractiveBeforeBackground) {
+  DownloadScheduler scheduler(1);
+  std::vector<std::string> results;
+  scheduler.GetObject(this, "a", storage::DownloadPriority::BACKGROUND,
+                      MakeDownload("a"), MakeCallback(&results));
+  scheduler.GetObject(this, "b", storage::DownloadPriority::BACKGROUND,
+                      MakeDownload("b"), MakeCallback(&results));
+  scheduler.GetObject(this, "c", storage::DownloadPriority::BACKGROUND,
+                      MakeDownload("c"), MakeCallback(&results));
+  scheduler.GetObject(this, "d", storage::DownloadPriority::INTERACTIVE,
+                      MakeDownload("d"), MakeCallback(&results));
+  // Requesting a queued background object interactively promotes it.
+  scheduler.GetObject(this, "c", storage::DownloadPriority::INTERACTIVE,
+                      MakeDownload("c"), MakeCallback(&results));
+  EXPECT_EQ(1u, scheduler.deduplicated_requests());
+
+  for (size_t i = 0; i < 4; ++i) {
+    CompleteDownload(i, "content");
+  }
+  EXPECT_EQ(std::vector<std::string>({"a", "d", "c", "b"}), started_);
+}
+
+TEST_F(DownloadSchedulerTest, DeduplicatesRequests) {
+  DownloadScheduler scheduler(1);
+  std::vector<std::string> results;
+  scheduler.GetObject(this, "a", storage::DownloadPriority::BACKGROUND,
+                      MakeDownload("a"), MakeCallback(&results));
+  scheduler.GetObject(this, "a", storage::DownloadPriority::INTERACTIVE,
+                      MakeDownload("a"), MakeCallback(&results));
+  // Requests of different clients are not shared.
+  int other_client;
+  scheduler.GetObject(&other_client, "a",
+                      storage::DownloadPriority::BACKGROUND, MakeDownload("a"),
+                      MakeCallback(&results));
+  EXPECT_EQ(1u, scheduler.deduplicated_requests());
+
+  CompleteDownload(0, "content");
+  EXPECT_TRUE(RunLoopUntil([&results] { return results.size() == 2u; }));
+  EXPECT_EQ(std::vector<std::string>({"content", "content"}), results);
+
+  EXPECT_EQ(2u, started_.size());
+  CompleteDownload(1, "content");
+  EXPECT_EQ(3u, results.size());
+  EXPECT_EQ(2u, scheduler.completed_downloads());
+}
+
+TEST_F(DownloadSchedulerTest, ReportsErrors) {
+  DownloadScheduler scheduler(1);
+  std::vector<storage::Status> statuses;
+  for (size_t i = 0; i < 2; ++i) {
+    scheduler.GetObject(
+        this, "a", storage::DownloadPriority::BACKGROUND, MakeDownload("a"),
+        [&statuses](storage::Status status, uint64_t /*size*/,
+                     mx::socket data) {
+          statuses.push_back(status);
+          EXPECT_FALSE(data);
+        });
+  }
+  pending_[0](storage::Status::IO_ERROR, 0u, mx::socket());
+  EXPECT_EQ(std::vector<storage::Status>(2, storage::Status::IO_ERROR),
+            statuses);
+  EXPECT_EQ(0u, scheduler.in_flight());
+  EXPECT_EQ(0u, scheduler.completed_downloads());
+}
+
+TEST_F(DownloadSchedulerTest, CancelRequests) {
+  DownloadScheduler scheduler(1);
+  std::vector<std::string> results;
+  int other_client;
+  scheduler.GetObject(this, "a", storage::DownloadPriority::BACKGROUND,
+                      MakeDownload("a"), MakeCallback(&results));
+  scheduler.GetObject(this, "b", storage::DownloadPriority::BACKGROUND,
+                      MakeDownload("b"), MakeCallback(&results));
+  scheduler.GetObject(&other_client, "c",
+                      storage::DownloadPriority::BACKGROUND, MakeDownload("c"),
+                      MakeCallback(&results));
+  EXPECT_EQ(2u, scheduler.queue_depth());
+
+  // Cancelling frees the slot of the running download of |this|, and drops its
+  // queued download.
+  scheduler.CancelRequests(this);
+  EXPECT_EQ(std::vector<std::string>({"a", "c"}), started_);
+  EXPECT_EQ(1u, scheduler.in_flight());
+  EXPECT_EQ(0u, scheduler.queue_depth());
+
+  CompleteDownload(0, "content_a");
+  CompleteDownload(1, "content_c");
+  EXPECT_EQ(std::vector<std::string>({"content_c"}), results);
+  EXPECT_EQ(0u, scheduler.in_flight());
+}
+
+}  // namespace
+}  // namespace cloud_sync
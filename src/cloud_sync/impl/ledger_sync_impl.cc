@@ -16,10 +16,14 @@ namespace cloud_sync {
 
 LedgerSyncImpl::LedgerSyncImpl(ledger::Environment* environment,
                                const UserConfig* user_config,
+                               DownloadScheduler* download_scheduler,
+                               SyncScheduler* sync_scheduler,
                                ftl::StringView app_id,
                                std::unique_ptr<SyncStateWatcher> watcher)
     : environment_(environment),
       user_config_(user_config),
+      download_scheduler_(download_scheduler),
+      sync_scheduler_(sync_scheduler),
       app_gcs_prefix_(GetGcsPrefixForApp(user_config->user_id, app_id)),
       app_firebase_path_(GetFirebasePathForApp(user_config->user_id, app_id)),
       app_firebase_(std::make_unique<firebase::FirebaseImpl>(
@@ -29,6 +33,17 @@ LedgerSyncImpl::LedgerSyncImpl(ledger::Environment* environment,
       user_watcher_(std::move(watcher)),
       aggregator_(user_watcher_.get()) {
   FTL_DCHECK(!user_config->server_id.empty());
+  if (user_config->use_multiplexed_watch) {
+    // The multiplexer watches the location of this Ledger instance as a key of
+    // the user location, as requests need a non-empty key.
+    user_firebase_ = std::make_unique<firebase::FirebaseImpl>(
+        environment_->network_service(), user_config->server_id,
+        GetFirebasePathForUser(user_config->user_id));
+    watch_multiplexer_ = std::make_unique<WatchMultiplexer>(
+        environment_->main_runner(), user_firebase_.get(),
+        firebase::EncodeKey(app_id), user_config->auth_provider,
+        std::make_unique<backoff::ExponentialBackoff>());
+  }
 }
 
 LedgerSyncImpl::~LedgerSyncImpl() {
@@ -42,6 +57,37 @@ LedgerSyncImpl::~LedgerSyncImpl() {
 std::unique_ptr<PageSyncContext> LedgerSyncImpl::CreatePageContext(
     storage::PageStorage* page_storage,
     ftl::Closure error_callback) {
+  // Page syncs are created for the pages that clients connect to.
+  return CreatePageContext(page_storage, std::move(error_callback),
+                           SyncScheduler::Priority::ACTIVE);
+}
+
+std::unique_ptr<PageSyncContext> LedgerSyncImpl::CreateBackgroundPageContext(
+    storage::PageStorage* page_storage,
+    ftl::Closure error_callback) {
+  return CreatePageContext(page_storage, std::move(error_callback),
+                           SyncScheduler::Priority::BACKGROUND);
+}
+
+size_t LedgerSyncImpl::GetMaxBackgroundSyncedPages() {
+  return user_config_->max_background_synced_pages;
+}
+
+void LedgerSyncImpl::EnableUpload() {
+  if (upload_enabled_) {
+    return;
+  }
+
+  upload_enabled_ = true;
+  for (auto page_sync : active_page_syncs_) {
+    page_sync->EnableUpload();
+  }
+}
+
+std::unique_ptr<PageSyncContext> LedgerSyncImpl::CreatePageContext(
+    storage::PageStorage* page_storage,
+    ftl::Closure error_callback,
+    SyncScheduler::Priority priority) {
   FTL_DCHECK(page_storage);
 
   auto result = std::make_unique<PageSyncContext>();
@@ -51,14 +97,23 @@ std::unique_ptr<PageSyncContext> LedgerSyncImpl::CreatePageContext(
   result->cloud_storage = std::make_unique<gcs::CloudStorageImpl>(
       environment_->main_runner(), environment_->network_service(),
       user_config_->server_id,
-      GetGcsPrefixForPage(app_gcs_prefix_, page_storage->GetId()));
+      GetGcsPrefixForPage(app_gcs_prefix_, page_storage->GetId()),
+      user_config_->use_compression ? environment_->GetIORunner() : nullptr);
   result->cloud_provider = std::make_unique<cloud_provider::CloudProviderImpl>(
-      result->firebase.get(), result->cloud_storage.get());
+      result->firebase.get(), result->cloud_storage.get(),
+      user_config_->use_compression);
   auto page_sync = std::make_unique<PageSyncImpl>(
       environment_->main_runner(), page_storage, result->cloud_provider.get(),
       user_config_->auth_provider,
       std::make_unique<backoff::ExponentialBackoff>(), error_callback,
-      aggregator_.GetNewStateWatcher());
+      aggregator_.GetNewStateWatcher(), download_scheduler_);
+  if (user_config_->use_object_packs) {
+    page_sync->EnableObjectPacks();
+  }
+  if (watch_multiplexer_) {
+    page_sync->SetWatchMultiplexer(watch_multiplexer_.get());
+  }
+  page_sync->SetSyncScheduler(sync_scheduler_, priority);
   if (upload_enabled_) {
     page_sync->EnableUpload();
   }
@@ -70,15 +125,4 @@ std::unique_ptr<PageSyncContext> LedgerSyncImpl::CreatePageContext(
   return result;
 }
 
-void LedgerSyncImpl::EnableUpload() {
-  if (upload_enabled_) {
-    return;
-  }
-
-  upload_enabled_ = true;
-  for (auto page_sync : active_page_syncs_) {
-    page_sync->EnableUpload();
-  }
-}
-
 }  // namespace cloud_sync
@@ -9,7 +9,10 @@
 #include <unordered_set>
 
 #include "apps/ledger/src/cloud_sync/impl/aggregator.h"
+#include "apps/ledger/src/cloud_sync/impl/download_scheduler.h"
 #include "apps/ledger/src/cloud_sync/impl/page_sync_impl.h"
+#include "apps/ledger/src/cloud_sync/impl/sync_scheduler.h"
+#include "apps/ledger/src/cloud_sync/impl/watch_multiplexer.h"
 #include "apps/ledger/src/cloud_sync/public/ledger_sync.h"
 #include "apps/ledger/src/cloud_sync/public/sync_state_watcher.h"
 #include "apps/ledger/src/cloud_sync/public/user_config.h"
@@ -23,6 +26,8 @@ class LedgerSyncImpl : public LedgerSync {
  public:
   LedgerSyncImpl(ledger::Environment* environment,
                  const UserConfig* user_config,
+                 DownloadScheduler* download_scheduler,
+                 SyncScheduler* sync_scheduler,
                  ftl::StringView app_id,
                  std::unique_ptr<SyncStateWatcher> watcher);
   ~LedgerSyncImpl() override;
@@ -30,6 +35,10 @@ class LedgerSyncImpl : public LedgerSync {
   std::unique_ptr<PageSyncContext> CreatePageContext(
       storage::PageStorage* page_storage,
       ftl::Closure error_callback) override;
+  std::unique_ptr<PageSyncContext> CreateBackgroundPageContext(
+      storage::PageStorage* page_storage,
+      ftl::Closure error_callback) override;
+  size_t GetMaxBackgroundSyncedPages() override;
 
   // Enables upload. Has no effect if this method has already been called.
   void EnableUpload();
@@ -43,14 +52,26 @@ class LedgerSyncImpl : public LedgerSync {
   }
 
  private:
+  std::unique_ptr<PageSyncContext> CreatePageContext(
+      storage::PageStorage* page_storage,
+      ftl::Closure error_callback,
+      SyncScheduler::Priority priority);
+
   ledger::Environment* const environment_;
   const UserConfig* const user_config_;
+  DownloadScheduler* const download_scheduler_;
+  SyncScheduler* const sync_scheduler_;
   bool upload_enabled_ = false;
   const std::string app_gcs_prefix_;
   // Firebase path under which the data of this Ledger instance is stored.
   const std::string app_firebase_path_;
   // Firebase instance scoped to |app_path_|.
   std::unique_ptr<firebase::Firebase> app_firebase_;
+  // Firebase instance scoped to the data of the user, and the multiplexer
+  // watching the commits of all pages through it. Only set if
+  // |user_config_->use_multiplexed_watch| is true.
+  std::unique_ptr<firebase::Firebase> user_firebase_;
+  std::unique_ptr<WatchMultiplexer> watch_multiplexer_;
   std::unordered_set<PageSyncImpl*> active_page_syncs_;
   // Called on destruction.
   std::function<void()> on_delete_;
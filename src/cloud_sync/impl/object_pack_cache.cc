@@ -0,0 +1,215 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/object_pack_cache.h"
+
+#include <memory>
+#include <utility>
+
+#include "apps/ledger/src/callback/waiter.h"
+#include "apps/ledger/src/cloud_sync/impl/constants.h"
+#include "apps/ledger/src/glue/socket/socket_pair.h"
+#include "apps/ledger/src/glue/socket/socket_writer.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/concatenate.h"
+
+namespace cloud_sync {
+
+namespace {
+
+// Maximum number of packs kept in memory to serve objects requested after
+// ClearObjects().
+constexpr size_t kMaxCachedPacks = 4u;
+
+std::string GetObjectPackKey(storage::ObjectIdView object_id) {
+  return ftl::Concatenate({kObjectPackKeyPrefix, object_id});
+}
+
+mx::socket WriteObjectToSocket(std::string data) {
+  glue::SocketPair socket_pair;
+  // StringSocketWriter deletes itself when done.
+  auto writer = new glue::StringSocketWriter();
+  writer->Start(std::move(data), std::move(socket_pair.socket2));
+  return std::move(socket_pair.socket1);
+}
+
+}  // namespace
+
+ObjectPackCache::ObjectPackCache(storage::PageStorage* storage,
+                                 cloud_provider::CloudProvider* cloud_provider)
+    : storage_(storage), cloud_provider_(cloud_provider) {}
+
+ObjectPackCache::~ObjectPackCache() {}
+
+void ObjectPackCache::FetchPacks(
+    const std::string& auth_token,
+    const std::set<cloud_provider::ObjectId>& pack_ids,
+    std::function<void(cloud_provider::Status)> callback) {
+  auto waiter = callback::StatusWaiter<cloud_provider::Status>::Create(
+      cloud_provider::Status::OK);
+  for (const auto& pack_id : pack_ids) {
+    cloud_provider_->GetObjectPack(auth_token, pack_id, [
+      this, pack_id, callback = waiter->NewCallback()
+    ](cloud_provider::Status status,
+      std::map<cloud_provider::ObjectId, cloud_provider::Data> objects) {
+      if (status != cloud_provider::Status::OK) {
+        callback(status);
+        return;
+      }
+      AddPackObjects(pack_id, std::move(objects), std::move(callback));
+    });
+  }
+  waiter->Finalize(std::move(callback));
+}
+
+void ObjectPackCache::ClearObjects() {
+  std::set<storage::ObjectId> served_object_ids;
+  served_object_ids.swap(served_object_ids_);
+  std::map<storage::ObjectId, bool> object_ids;
+  for (const auto& object : objects_) {
+    object_ids[object.first] = false;
+  }
+  for (const auto& object_id : served_object_ids) {
+    object_ids[object_id] = true;
+  }
+  objects_.clear();
+
+  // Objects that are not in storage yet, such as the lazy values not requested
+  // so far, keep their pack metadata.
+  for (const auto& object : object_ids) {
+    const storage::ObjectId& object_id = object.first;
+    bool served = object.second;
+    storage_->GetPiece(object_id, [ this, object_id, served ](
+                                      storage::Status status,
+                                      std::unique_ptr<const storage::Object>
+                                      /*object*/) {
+      if (status == storage::Status::NOT_FOUND) {
+        if (served) {
+          // The object is still being added to storage.
+          served_object_ids_.insert(object_id);
+        }
+        return;
+      }
+      if (status != storage::Status::OK) {
+        FTL_LOG(ERROR) << "Failed to read object " << object_id
+                       << " from storage: " << status;
+        return;
+      }
+      storage_->DeleteSyncMetadata(
+          GetObjectPackKey(object_id), [](storage::Status status) {
+            if (status != storage::Status::OK) {
+              FTL_LOG(ERROR)
+                  << "Failed to delete the object pack metadata: " << status;
+            }
+          });
+    });
+  }
+}
+
+void ObjectPackCache::GetObject(const std::string& auth_token,
+                                storage::ObjectIdView object_id,
+                                Callback callback) {
+  auto it = objects_.find(object_id.ToString());
+  if (it != objects_.end()) {
+    callback(cloud_provider::Status::OK, it->second.size(),
+             WriteObjectToSocket(it->second));
+    return;
+  }
+
+  std::string pack_id;
+  storage::Status status =
+      storage_->GetSyncMetadata(GetObjectPackKey(object_id), &pack_id);
+  if (status == storage::Status::NOT_FOUND) {
+    callback(cloud_provider::Status::NOT_FOUND, 0u, mx::socket());
+    return;
+  }
+  if (status != storage::Status::OK) {
+    FTL_LOG(ERROR) << "Failed to read the object pack metadata: " << status;
+    callback(cloud_provider::Status::INTERNAL_ERROR, 0u, mx::socket());
+    return;
+  }
+
+  GetObjectFromPack(auth_token, pack_id, object_id.ToString(),
+                    std::move(callback));
+}
+
+void ObjectPackCache::GetObjectFromPack(const std::string& auth_token,
+                                        const cloud_provider::ObjectId& pack_id,
+                                        storage::ObjectId object_id,
+                                        Callback callback) {
+  for (auto it = cached_packs_.begin(); it != cached_packs_.end(); ++it) {
+    if (it->first == pack_id) {
+      cached_packs_.splice(cached_packs_.begin(), cached_packs_, it);
+      ServeObject(it->second, object_id, callback);
+      return;
+    }
+  }
+
+  auto& requests = pending_requests_[pack_id];
+  requests.emplace_back(std::move(object_id), std::move(callback));
+  if (requests.size() > 1u) {
+    // The pack is already being downloaded.
+    return;
+  }
+
+  cloud_provider_->GetObjectPack(auth_token, pack_id, [this, pack_id](
+      cloud_provider::Status status,
+      std::map<cloud_provider::ObjectId, cloud_provider::Data> objects) {
+    auto requests = std::move(pending_requests_[pack_id]);
+    pending_requests_.erase(pack_id);
+    if (status != cloud_provider::Status::OK) {
+      for (const auto& request : requests) {
+        request.second(status, 0u, mx::socket());
+      }
+      return;
+    }
+
+    for (const auto& request : requests) {
+      ServeObject(objects, request.first, request.second);
+    }
+    cached_packs_.emplace_front(pack_id, std::move(objects));
+    if (cached_packs_.size() > kMaxCachedPacks) {
+      cached_packs_.pop_back();
+    }
+  });
+}
+
+void ObjectPackCache::ServeObject(
+    const std::map<cloud_provider::ObjectId, cloud_provider::Data>& objects,
+    const storage::ObjectId& object_id,
+    const Callback& callback) {
+  auto it = objects.find(object_id);
+  if (it == objects.end()) {
+    callback(cloud_provider::Status::NOT_FOUND, 0u, mx::socket());
+    return;
+  }
+  served_object_ids_.insert(object_id);
+  callback(cloud_provider::Status::OK, it->second.size(),
+           WriteObjectToSocket(it->second));
+}
+
+void ObjectPackCache::AddPackObjects(
+    const cloud_provider::ObjectId& pack_id,
+    std::map<cloud_provider::ObjectId, cloud_provider::Data> objects,
+    std::function<void(cloud_provider::Status)> callback) {
+  auto waiter =
+      callback::StatusWaiter<storage::Status>::Create(storage::Status::OK);
+  for (auto& object : objects) {
+    storage_->SetSyncMetadata(GetObjectPackKey(object.first), pack_id,
+                              waiter->NewCallback());
+    objects_[object.first] = std::move(object.second);
+  }
+  waiter->Finalize(
+      [callback = std::move(callback)](storage::Status status) {
+        if (status != storage::Status::OK) {
+          FTL_LOG(ERROR) << "Failed to record the object pack metadata: "
+                         << status;
+          callback(cloud_provider::Status::INTERNAL_ERROR);
+          return;
+        }
+        callback(cloud_provider::Status::OK);
+      });
+}
+
+}  // namespace cloud_sync
@@ -0,0 +1,100 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_OBJECT_PACK_CACHE_H_
+#define APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_OBJECT_PACK_CACHE_H_
+
+#include <functional>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mx/socket.h>
+
+#include "apps/ledger/src/cloud_provider/public/cloud_provider.h"
+#include "apps/ledger/src/storage/public/page_storage.h"
+#include "lib/ftl/macros.h"
+
+namespace cloud_sync {
+
+// Retrieves the object packs referenced by remote commits, and serves the
+// objects they hold.
+//
+// The objects of the packs fetched with FetchPacks() are kept in memory until
+// ClearObjects() is called, so that storage can read them while adding the
+// commits referencing them. The pack holding each object is also recorded in
+// the sync metadata of the page until the object is in storage: objects that
+// are not needed to add the commits, such as lazy values, are retrieved from
+// their pack when requested later. The last packs retrieved this way are kept,
+// so that the objects of a pack are not all downloaded with their own copy of
+// the pack.
+class ObjectPackCache {
+ public:
+  using Callback = std::function<
+      void(cloud_provider::Status status, uint64_t size, mx::socket data)>;
+
+  ObjectPackCache(storage::PageStorage* storage,
+                  cloud_provider::CloudProvider* cloud_provider);
+  ~ObjectPackCache();
+
+  // Retrieves the packs of the given ids and keeps their objects in memory.
+  void FetchPacks(const std::string& auth_token,
+                  const std::set<cloud_provider::ObjectId>& pack_ids,
+                  std::function<void(cloud_provider::Status)> callback);
+
+  // Drops the objects kept in memory, and the pack metadata of the objects
+  // retrieved from packs that are now in storage.
+  void ClearObjects();
+
+  // Retrieves the object of the given id from its pack. |callback| is called
+  // with NOT_FOUND if the object is not part of a known pack.
+  void GetObject(const std::string& auth_token,
+                 storage::ObjectIdView object_id,
+                 Callback callback);
+
+ private:
+  // Keeps the given objects of the pack |pack_id| in memory, and records their
+  // pack in the sync metadata.
+  void AddPackObjects(const cloud_provider::ObjectId& pack_id,
+                      std::map<cloud_provider::ObjectId, cloud_provider::Data>
+                          objects,
+                      std::function<void(cloud_provider::Status)> callback);
+
+  // Serves the object |object_id| from the cached pack |pack_id|, downloading
+  // the pack if needed.
+  void GetObjectFromPack(const std::string& auth_token,
+                         const cloud_provider::ObjectId& pack_id,
+                         storage::ObjectId object_id,
+                         Callback callback);
+
+  // Serves the object |object_id| from the given pack.
+  void ServeObject(
+      const std::map<cloud_provider::ObjectId, cloud_provider::Data>& objects,
+      const storage::ObjectId& object_id,
+      const Callback& callback);
+
+  storage::PageStorage* const storage_;
+  cloud_provider::CloudProvider* const cloud_provider_;
+  std::map<storage::ObjectId, std::string> objects_;
+  // The objects served from the cached packs, whose pack metadata is dropped
+  // once they are in storage.
+  std::set<storage::ObjectId> served_object_ids_;
+  // The last retrieved packs, the most recent first.
+  std::list<std::pair<cloud_provider::ObjectId,
+                      std::map<cloud_provider::ObjectId, cloud_provider::Data>>>
+      cached_packs_;
+  // The packs being downloaded, and the requests waiting for them.
+  std::map<cloud_provider::ObjectId,
+           std::vector<std::pair<storage::ObjectId, Callback>>>
+      pending_requests_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ObjectPackCache);
+};
+
+}  // namespace cloud_sync
+
+#endif  // APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_OBJECT_PACK_CACHE_H_
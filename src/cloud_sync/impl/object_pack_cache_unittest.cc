@@ -0,0 +1,215 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/object_pack_cache.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/cloud_provider/test/cloud_provider_empty_impl.h"
+#include "apps/ledger/src/cloud_sync/impl/constants.h"
+#include "apps/ledger/src/storage/test/page_storage_empty_impl.h"
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/macros.h"
+#include "lib/mtl/socket/strings.h"
+
+namespace cloud_sync {
+namespace {
+
+// Fake implementation of storage::PageStorage, holding the sync metadata.
+// Only the objects of |local_object_ids| are found in storage.
+class TestPageStorage : public storage::test::PageStorageEmptyImpl {
+ public:
+  TestPageStorage() = default;
+  ~TestPageStorage() override = default;
+
+  void GetPiece(storage::ObjectIdView object_id,
+                std::function<void(storage::Status,
+                                   std::unique_ptr<const storage::Object>)>
+                    callback) override {
+    if (local_object_ids.count(object_id.ToString()) == 0u) {
+      callback(storage::Status::NOT_FOUND, nullptr);
+      return;
+    }
+    // The content of the object is not used.
+    callback(storage::Status::OK, nullptr);
+  }
+
+  void SetSyncMetadata(ftl::StringView key,
+                       ftl::StringView value,
+                       std::function<void(storage::Status)> callback) override {
+    sync_metadata[key.ToString()] = value.ToString();
+    callback(storage::Status::OK);
+  }
+
+  void DeleteSyncMetadata(
+      ftl::StringView key,
+      std::function<void(storage::Status)> callback) override {
+    sync_metadata.erase(key.ToString());
+    callback(storage::Status::OK);
+  }
+
+  storage::Status GetSyncMetadata(ftl::StringView key,
+                                  std::string* value) override {
+    auto it = sync_metadata.find(key.ToString());
+    if (it == sync_metadata.end()) {
+      return storage::Status::NOT_FOUND;
+    }
+    *value = it->second;
+    return storage::Status::OK;
+  }
+
+  std::set<storage::ObjectId> local_object_ids;
+  std::map<std::string, std::string> sync_metadata;
+};
+
+// Fake implementation of cloud_provider::CloudProvider, serving the packs of
+// |packs|.
+class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
+ public:
+  TestCloudProvider() = default;
+  ~TestCloudProvider() override = default;
+
+  void GetObjectPack(
+      const std::string& /*auth_token*/,
+      cloud_provider::ObjectIdView pack_id,
+      std::function<void(
+          cloud_provider::Status,
+          std::map<cloud_provider::ObjectId, cloud_provider::Data>)> callback)
+      override {
+    get_object_pack_calls++;
+    auto it = packs.find(pack_id.ToString());
+    if (it == packs.end()) {
+      callback(cloud_provider::Status::NOT_FOUND, {});
+      return;
+    }
+    callback(cloud_provider::Status::OK, it->second);
+  }
+
+  std::map<cloud_provider::ObjectId,
+           std::map<cloud_provider::ObjectId, cloud_provider::Data>>
+      packs;
+  unsigned int get_object_pack_calls = 0u;
+};
+
+class ObjectPackCacheTest : public ::test::TestWithMessageLoop {
+ public:
+  ObjectPackCacheTest() : cache_(&storage_, &cloud_provider_) {
+    cloud_provider_.packs["pack1"] = {{"obj_id1", "obj_data1"},
+                                      {"obj_id2", "obj_data2"}};
+    cloud_provider_.packs["pack2"] = {{"obj_id3", "obj_data3"}};
+  }
+  ~ObjectPackCacheTest() override {}
+
+ protected:
+  // Retrieves the given object from |cache_|. Returns its content, or an empty
+  // string if it cannot be retrieved.
+  std::string GetObject(storage::ObjectIdView object_id,
+                        cloud_provider::Status expected_status =
+                            cloud_provider::Status::OK) {
+    cloud_provider::Status status;
+    uint64_t size;
+    mx::socket data;
+    cache_.GetObject("auth_token", object_id,
+                     callback::Capture(MakeQuitTask(), &status, &size, &data));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(expected_status, status);
+    if (status != cloud_provider::Status::OK) {
+      return "";
+    }
+    std::string content;
+    EXPECT_TRUE(mtl::BlockingCopyToString(std::move(data), &content));
+    EXPECT_EQ(size, content.size());
+    return content;
+  }
+
+  TestPageStorage storage_;
+  TestCloudProvider cloud_provider_;
+  ObjectPackCache cache_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(ObjectPackCacheTest);
+};
+
+TEST_F(ObjectPackCacheTest, FetchPacks) {
+  cloud_provider::Status status;
+  cache_.FetchPacks("auth_token", {"pack1", "pack2"},
+                    callback::Capture(MakeQuitTask(), &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(cloud_provider::Status::OK, status);
+  EXPECT_EQ(2u, cloud_provider_.get_object_pack_calls);
+
+  // The pack of each object is recorded.
+  EXPECT_EQ(3u, storage_.sync_metadata.size());
+  EXPECT_EQ("pack1", storage_.sync_metadata[kObjectPackKeyPrefix.ToString() +
+                                           "obj_id2"]);
+  EXPECT_EQ("pack2", storage_.sync_metadata[kObjectPackKeyPrefix.ToString() +
+                                           "obj_id3"]);
+
+  // The fetched objects are served from memory.
+  EXPECT_EQ("obj_data1", GetObject("obj_id1"));
+  EXPECT_EQ("obj_data3", GetObject("obj_id3"));
+  EXPECT_EQ(2u, cloud_provider_.get_object_pack_calls);
+
+  // Once cleared, the objects are retrieved from their pack again, which is
+  // then kept.
+  cache_.ClearObjects();
+  EXPECT_EQ("obj_data2", GetObject("obj_id2"));
+  EXPECT_EQ(3u, cloud_provider_.get_object_pack_calls);
+  EXPECT_EQ("obj_data1", GetObject("obj_id1"));
+  EXPECT_EQ(3u, cloud_provider_.get_object_pack_calls);
+}
+
+TEST_F(ObjectPackCacheTest, DeleteMetadataOfLocalObjects) {
+  cloud_provider::Status status;
+  cache_.FetchPacks("auth_token", {"pack1", "pack2"},
+                    callback::Capture(MakeQuitTask(), &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(cloud_provider::Status::OK, status);
+  EXPECT_EQ(3u, storage_.sync_metadata.size());
+
+  // Only the objects added to storage lose their pack metadata.
+  storage_.local_object_ids.insert("obj_id1");
+  cache_.ClearObjects();
+  EXPECT_EQ(2u, storage_.sync_metadata.size());
+  EXPECT_EQ(0u, storage_.sync_metadata.count(kObjectPackKeyPrefix.ToString() +
+                                             "obj_id1"));
+
+  // An object served later loses its pack metadata once it is in storage.
+  EXPECT_EQ("obj_data3", GetObject("obj_id3"));
+  cache_.ClearObjects();
+  EXPECT_EQ(2u, storage_.sync_metadata.size());
+  storage_.local_object_ids.insert("obj_id3");
+  cache_.ClearObjects();
+  EXPECT_EQ(1u, storage_.sync_metadata.size());
+  EXPECT_EQ("pack1", storage_.sync_metadata[kObjectPackKeyPrefix.ToString() +
+                                           "obj_id2"]);
+}
+
+TEST_F(ObjectPackCacheTest, FetchPacksError) {
+  cloud_provider::Status status;
+  cache_.FetchPacks("auth_token", {"pack1", "unknown_pack"},
+                    callback::Capture(MakeQuitTask(), &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(cloud_provider::Status::NOT_FOUND, status);
+}
+
+TEST_F(ObjectPackCacheTest, UnknownObject) {
+  GetObject("obj_id1", cloud_provider::Status::NOT_FOUND);
+  EXPECT_EQ(0u, cloud_provider_.get_object_pack_calls);
+
+  // The objects recorded in the sync metadata are retrieved from their pack.
+  storage_.sync_metadata[kObjectPackKeyPrefix.ToString() + "obj_id3"] =
+      "pack2";
+  EXPECT_EQ("obj_data3", GetObject("obj_id3"));
+  EXPECT_EQ(1u, cloud_provider_.get_object_pack_calls);
+}
+
+}  // namespace
+}  // namespace cloud_sync
@@ -12,25 +12,48 @@
 
 #include "apps/ledger/src/cloud_sync/impl/constants.h"
 #include "apps/ledger/src/storage/public/types.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/logging.h"
 
 namespace cloud_sync {
 
+namespace {
+
+// Objects fetched in the background still take precedence over uploads.
+ledger::RequestPriority GetRequestPriority(
+    storage::DownloadPriority priority) {
+  switch (priority) {
+    case storage::DownloadPriority::INTERACTIVE:
+      return ledger::RequestPriority::INTERACTIVE;
+    case storage::DownloadPriority::BACKGROUND:
+      return ledger::RequestPriority::NORMAL;
+  }
+}
+
+}  // namespace
+
 PageSyncImpl::PageSyncImpl(ftl::RefPtr<ftl::TaskRunner> task_runner,
                            storage::PageStorage* storage,
                            cloud_provider::CloudProvider* cloud_provider,
                            AuthProvider* auth_provider,
                            std::unique_ptr<backoff::Backoff> backoff,
                            ftl::Closure on_error,
-                           std::unique_ptr<SyncStateWatcher> ledger_watcher)
+                           std::unique_ptr<SyncStateWatcher> ledger_watcher,
+                           DownloadScheduler* download_scheduler)
     : task_runner_(std::move(task_runner)),
       storage_(storage),
       cloud_provider_(cloud_provider),
       auth_provider_(auth_provider),
       backoff_(std::move(backoff)),
       on_error_(std::move(on_error)),
+      owned_download_scheduler_(download_scheduler
+                                    ? nullptr
+                                    : std::make_unique<DownloadScheduler>()),
+      download_scheduler_(download_scheduler ? download_scheduler
+                                             : owned_download_scheduler_.get()),
       log_prefix_("Page " + convert::ToHex(storage->GetId()) + " sync: "),
+      object_packs_(storage, cloud_provider),
       ledger_watcher_(std::move(ledger_watcher)),
       weak_factory_(this) {
   FTL_DCHECK(storage_);
@@ -39,12 +62,15 @@ PageSyncImpl::PageSyncImpl(ftl::RefPtr<ftl::TaskRunner> task_runner,
 }
 
 PageSyncImpl::~PageSyncImpl() {
+  download_scheduler_->CancelRequests(this);
+  ReleaseSyncSlot();
+
   // Remove the watchers and the delegate, if they were not already removed on
   // hard error.
   if (!errored_) {
     storage_->SetSyncDelegate(nullptr);
     storage_->RemoveCommitWatcher(this);
-    cloud_provider_->UnwatchCommits(this);
+    UnwatchRemoteCommits();
   }
 
   if (on_delete_) {
@@ -61,11 +87,39 @@ void PageSyncImpl::EnableUpload() {
   StartUpload();
 }
 
+void PageSyncImpl::EnableObjectPacks() {
+  FTL_DCHECK(!started_);
+  object_packs_enabled_ = true;
+}
+
+void PageSyncImpl::SetWatchMultiplexer(WatchMultiplexer* watch_multiplexer) {
+  FTL_DCHECK(!started_);
+  watch_multiplexer_ = watch_multiplexer;
+}
+
+void PageSyncImpl::SetBacklogBatchSize(size_t batch_size) {
+  FTL_DCHECK(!started_);
+  FTL_DCHECK(batch_size > 0);
+  backlog_batch_size_ = batch_size;
+}
+
+void PageSyncImpl::SetSyncScheduler(SyncScheduler* sync_scheduler,
+                                    SyncScheduler::Priority priority) {
+  FTL_DCHECK(!started_);
+  FTL_DCHECK(sync_scheduler);
+  sync_scheduler_ = sync_scheduler;
+  sync_priority_ = priority;
+}
+
 void PageSyncImpl::Start() {
   FTL_DCHECK(!started_);
   started_ = true;
   storage_->SetSyncDelegate(this);
 
+  if (sync_scheduler_) {
+    ScheduleSync();
+    return;
+  }
   StartDownload();
 }
 
@@ -94,12 +148,12 @@ void PageSyncImpl::SetOnBacklogDownloaded(ftl::Closure on_backlog_downloaded) {
 void PageSyncImpl::SetSyncWatcher(SyncStateWatcher* watcher) {
   page_watcher_ = watcher;
   if (page_watcher_) {
-    page_watcher_->Notify(download_state_, upload_state_);
+    page_watcher_->Notify(GetSyncState());
   }
 }
 
 void PageSyncImpl::OnNewCommits(
-    const std::vector<std::unique_ptr<const storage::Commit>>& /*commits*/,
+    const std::vector<std::unique_ptr<const storage::Commit>>& commits,
     storage::ChangeSource source) {
   // Only upload the locally created commits.
   // TODO(ppi): revisit this when we have p2p sync, too.
@@ -108,38 +162,66 @@ void PageSyncImpl::OnNewCommits(
   }
 
   commits_to_upload_ = true;
-  UploadUnsyncedCommits();
+  if (!batch_upload_ || !batch_upload_accepts_commits_) {
+    UploadUnsyncedCommits();
+    return;
+  }
+
+  // Pipeline the new commits behind the ones being uploaded, instead of
+  // waiting for the current upload to finish and listing all the unsynced
+  // commits again. This is only done while the new commits extend the single
+  // head the upload started from: any other commit is left to the next listing
+  // of the unsynced commits, which checks the heads again.
+  std::vector<std::unique_ptr<const storage::Commit>> new_commits;
+  for (const auto& commit : commits) {
+    std::vector<storage::CommitIdView> parent_ids = commit->GetParentIds();
+    if (parent_ids.size() != 1u || parent_ids[0] != upload_head_) {
+      batch_upload_accepts_commits_ = false;
+      break;
+    }
+    upload_head_ = commit->GetId();
+    new_commits.push_back(commit->Clone());
+  }
+  if (!new_commits.empty()) {
+    batch_upload_->AddCommits(std::move(new_commits));
+  }
 }
 
 void PageSyncImpl::GetObject(
     storage::ObjectIdView object_id,
+    storage::DownloadPriority priority,
     std::function<void(storage::Status status, uint64_t size, mx::socket data)>
         callback) {
-  GetAuthToken([ this, object_id = object_id.ToString(),
+  download_scheduler_->GetObject(
+      this, object_id.ToString(), priority,
+      [ this, object_id = object_id.ToString(), priority ](
+          DownloadScheduler::Callback callback) {
+        DownloadObject(object_id, GetRequestPriority(priority),
+                       std::move(callback));
+      },
+      std::move(callback));
+}
+
+void PageSyncImpl::DownloadObject(std::string object_id,
+                                  ledger::RequestPriority priority,
+                                  DownloadScheduler::Callback callback) {
+  GetAuthToken([ this, object_id = std::move(object_id), priority,
                  callback ](std::string auth_token) mutable {
-    cloud_provider_->GetObject(auth_token, object_id, [
-      this, object_id, callback = std::move(callback)
+    // Look for the object in the known object packs first.
+    object_packs_.GetObject(auth_token, object_id, [
+      this, auth_token, object_id, priority, callback = std::move(callback)
     ](cloud_provider::Status status, uint64_t size, mx::socket data) mutable {
-      if (status == cloud_provider::Status::NETWORK_ERROR) {
-        FTL_LOG(WARNING)
-            << log_prefix_
-            << "GetObject() failed due to a connection error, retrying.";
-        Retry([
-          this, object_id = std::move(object_id), callback = std::move(callback)
-        ] { GetObject(object_id, callback); });
-        return;
-      }
-
-      backoff_->Reset();
-      if (status != cloud_provider::Status::OK) {
-        FTL_LOG(WARNING) << log_prefix_
-                         << "Fetching remote object failed with status: "
-                         << status;
-        callback(storage::Status::IO_ERROR, 0, mx::socket());
+      if (status != cloud_provider::Status::NOT_FOUND) {
+        OnObjectDownloaded(std::move(object_id), priority, std::move(callback),
+                           status, size, std::move(data));
         return;
       }
-
-      callback(storage::Status::OK, size, std::move(data));
+      cloud_provider_->GetObject(auth_token, object_id, priority, [
+        this, object_id, priority, callback = std::move(callback)
+      ](cloud_provider::Status status, uint64_t size, mx::socket data) mutable {
+        OnObjectDownloaded(std::move(object_id), priority, std::move(callback),
+                           status, size, std::move(data));
+      });
     });
   },
                [this, callback] {
@@ -150,6 +232,35 @@ void PageSyncImpl::GetObject(
                });
 }
 
+void PageSyncImpl::OnObjectDownloaded(std::string object_id,
+                                      ledger::RequestPriority priority,
+                                      DownloadScheduler::Callback callback,
+                                      cloud_provider::Status status,
+                                      uint64_t size,
+                                      mx::socket data) {
+  if (status == cloud_provider::Status::NETWORK_ERROR) {
+    FTL_LOG(WARNING)
+        << log_prefix_
+        << "GetObject() failed due to a connection error, retrying.";
+    Retry([
+      this, object_id = std::move(object_id), priority,
+      callback = std::move(callback)
+    ] { DownloadObject(object_id, priority, callback); });
+    return;
+  }
+
+  backoff_->Reset();
+  if (status != cloud_provider::Status::OK) {
+    FTL_LOG(WARNING) << log_prefix_
+                     << "Fetching remote object failed with status: "
+                     << status;
+    callback(storage::Status::IO_ERROR, 0, mx::socket());
+    return;
+  }
+
+  callback(storage::Status::OK, size, std::move(data));
+}
+
 void PageSyncImpl::OnRemoteCommits(
     std::vector<cloud_provider::Record> records) {
   if (batch_download_) {
@@ -166,7 +277,7 @@ void PageSyncImpl::OnRemoteCommits(
 void PageSyncImpl::OnConnectionError() {
   FTL_DCHECK(remote_watch_set_);
   // Reset the watcher and schedule a retry.
-  cloud_provider_->UnwatchCommits(this);
+  UnwatchRemoteCommits();
   remote_watch_set_ = false;
   FTL_LOG(WARNING)
       << log_prefix_
@@ -177,8 +288,9 @@ void PageSyncImpl::OnConnectionError() {
 void PageSyncImpl::OnTokenExpired() {
   FTL_DCHECK(remote_watch_set_);
   // Reset the watcher and schedule a retry.
-  cloud_provider_->UnwatchCommits(this);
+  UnwatchRemoteCommits();
   remote_watch_set_ = false;
+  auth_provider_->InvalidateFirebaseToken(remote_watch_auth_token_);
   FTL_LOG(INFO) << log_prefix_ << "Firebase token expired, refreshing.";
   Retry([this] { SetRemoteWatcher(true); });
 }
@@ -188,6 +300,63 @@ void PageSyncImpl::OnMalformedNotification() {
   HandleError("Received a malformed remote commit notification.");
 }
 
+void PageSyncImpl::ScheduleSync() {
+  SetState(CATCH_UP_DOWNLOAD, WAIT_CATCH_UP_DOWNLOAD);
+  if (sync_priority_ != SyncScheduler::Priority::BACKGROUND) {
+    RequestSyncSlot(sync_priority_);
+    return;
+  }
+
+  storage_->GetUnsyncedCommits(
+      [this](storage::Status status,
+             std::vector<std::unique_ptr<const storage::Commit>> commits) {
+        if (status != storage::Status::OK) {
+          SetDownloadState(DOWNLOAD_ERROR);
+          HandleError("Failed to retrieve the unsynced commits");
+          return;
+        }
+        RequestSyncSlot(commits.empty()
+                            ? SyncScheduler::Priority::BACKGROUND
+                            : SyncScheduler::Priority::PENDING_COMMITS);
+      });
+}
+
+void PageSyncImpl::RequestSyncSlot(SyncScheduler::Priority priority) {
+  sync_scheduled_ = true;
+  waiting_for_sync_slot_ = true;
+  TRACE_ASYNC_BEGIN("ledger", "sync_slot_wait",
+                    reinterpret_cast<uintptr_t>(this));
+  sync_scheduler_->Schedule(this, priority,
+                            [this] {
+                              EndSyncSlotWait();
+                              queue_position_ = 0u;
+                              StartDownload();
+                            },
+                            [this](size_t position) {
+                              queue_position_ = position;
+                              NotifyStateWatcher();
+                            });
+}
+
+void PageSyncImpl::ReleaseSyncSlot() {
+  if (!sync_scheduled_) {
+    return;
+  }
+  sync_scheduled_ = false;
+  queue_position_ = 0u;
+  EndSyncSlotWait();
+  sync_scheduler_->Release(this);
+}
+
+void PageSyncImpl::EndSyncSlotWait() {
+  if (!waiting_for_sync_slot_) {
+    return;
+  }
+  waiting_for_sync_slot_ = false;
+  TRACE_ASYNC_END("ledger", "sync_slot_wait",
+                  reinterpret_cast<uintptr_t>(this));
+}
+
 void PageSyncImpl::StartDownload() {
   // Retrieve the server-side timestamp of the last commit we received.
   std::string last_commit_ts;
@@ -210,15 +379,18 @@ void PageSyncImpl::StartDownload() {
   }
 
   SetState(CATCH_UP_DOWNLOAD, WAIT_CATCH_UP_DOWNLOAD);
+  DownloadBacklog(std::move(last_commit_ts), backlog_batch_size_);
+}
 
+void PageSyncImpl::DownloadBacklog(std::string min_timestamp,
+                                   size_t batch_size) {
   GetAuthToken(
-      [ this,
-        last_commit_ts = std::move(last_commit_ts) ](std::string auth_token) {
-        // TODO(ppi): handle pagination when the response is huge.
+      [ this, min_timestamp, batch_size ](std::string auth_token) {
         cloud_provider_->GetCommits(
-            auth_token, last_commit_ts,
-            [this](cloud_provider::Status cloud_status,
-                   std::vector<cloud_provider::Record> records) {
+            auth_token, min_timestamp, batch_size,
+            [this, min_timestamp, batch_size](
+                cloud_provider::Status cloud_status,
+                std::vector<cloud_provider::Record> records) {
               if (cloud_status != cloud_provider::Status::OK) {
                 // Fetching the remote commits failed, schedule a retry.
                 FTL_LOG(WARNING)
@@ -226,30 +398,59 @@ void PageSyncImpl::StartDownload() {
                     << "fetching the remote commits failed due to a "
                     << "connection error, status: " << cloud_status
                     << ", retrying.";
-                Retry([this] { StartDownload(); });
+                Retry([this, min_timestamp, batch_size] {
+                  DownloadBacklog(min_timestamp, batch_size);
+                });
                 return;
               }
               backoff_->Reset();
 
+              // If the batch is full, there are more commits to retrieve.
+              // The commits sharing the last timestamp may be cut: they are
+              // left for the next batch, as commits uploaded together must be
+              // added to storage together.
+              bool last_batch = records.size() < batch_size;
+              std::string next_timestamp;
+              if (!last_batch) {
+                next_timestamp = records.back().timestamp;
+                auto first_cut = std::find_if(
+                    records.begin(), records.end(),
+                    [&next_timestamp](const cloud_provider::Record& record) {
+                      return record.timestamp == next_timestamp;
+                    });
+                if (first_cut == records.begin()) {
+                  // All the retrieved commits share the same timestamp.
+                  // Retrieve them again along with the following ones.
+                  DownloadBacklog(min_timestamp, 2 * batch_size);
+                  return;
+                }
+                records.erase(first_cut, records.end());
+              }
+
               if (records.empty()) {
                 // If there is no remote commits to add, announce that we're
                 // done.
                 FTL_VLOG(1) << log_prefix_
                             << "initial sync finished, no new remote commits";
                 BacklogDownloaded();
-              } else {
-                FTL_VLOG(1) << log_prefix_ << "retrieved " << records.size()
-                            << " (possibly) new remote commits, "
-                            << "adding them to storage.";
-                // If not, fire the backlog download callback when the remote
-                // commits are downloaded.
-                const auto record_count = records.size();
-                DownloadBatch(std::move(records), [this, record_count] {
-                  FTL_VLOG(1) << log_prefix_ << "initial sync finished, added "
-                              << record_count << " remote commits.";
-                  BacklogDownloaded();
-                });
+                return;
               }
+
+              FTL_VLOG(1) << log_prefix_ << "retrieved " << records.size()
+                          << " (possibly) new remote commits, "
+                          << "adding them to storage.";
+              // Fire the backlog download callback, or retrieve the next
+              // batch, when the remote commits are added.
+              DownloadBatch(std::move(records), [
+                this, last_batch, next_timestamp = std::move(next_timestamp)
+              ] {
+                if (last_batch) {
+                  FTL_VLOG(1) << log_prefix_ << "initial sync finished.";
+                  BacklogDownloaded();
+                  return;
+                }
+                DownloadBacklog(next_timestamp, backlog_batch_size_);
+              });
             });
       },
       [this] {
@@ -262,6 +463,9 @@ void PageSyncImpl::StartUpload() {
   if (!upload_enabled_ || !download_list_retrieved_) {
     // Only start uploading when the backlog is downloaded and upload is
     // enabled.
+    if (download_list_retrieved_) {
+      LocalBacklogUploaded();
+    }
     CheckIdle();
     return;
   }
@@ -274,13 +478,28 @@ void PageSyncImpl::StartUpload() {
 void PageSyncImpl::DownloadBatch(std::vector<cloud_provider::Record> records,
                                  ftl::Closure on_done) {
   FTL_DCHECK(!batch_download_);
+  // Local commits created from now on may depend on the downloaded ones: they
+  // have to wait for the heads to be checked again before being uploaded.
+  batch_upload_accepts_commits_ = false;
+  std::set<cloud_provider::ObjectId> pack_ids;
+  for (const auto& record : records) {
+    if (!record.commit.pack_id.empty()) {
+      pack_ids.insert(record.commit.pack_id);
+    }
+  }
   batch_download_ = std::make_unique<BatchDownload>(
       storage_, std::move(records), [ this, on_done = std::move(on_done) ] {
+        object_packs_.ClearObjects();
         if (on_done) {
           on_done();
         }
         batch_download_.reset();
 
+        if (!download_list_retrieved_) {
+          // The backlog is still being downloaded, batch by batch.
+          return;
+        }
+
         if (commits_to_download_.empty()) {
           SetDownloadState(DOWNLOAD_IDLE);
           UploadUnsyncedCommits();
@@ -291,10 +510,53 @@ void PageSyncImpl::DownloadBatch(std::vector<cloud_provider::Record> records,
         DownloadBatch(std::move(commits), nullptr);
       },
       [this] {
+        object_packs_.ClearObjects();
         SetDownloadState(DOWNLOAD_ERROR);
         HandleError("Failed to persist a remote commit in storage");
       });
-  batch_download_->Start();
+  if (pack_ids.empty()) {
+    batch_download_->Start();
+    return;
+  }
+  // Retrieve the object packs first, so that the objects needed to add the
+  // commits are not downloaded one by one.
+  FetchObjectPacks(std::move(pack_ids), [this] { batch_download_->Start(); });
+}
+
+void PageSyncImpl::FetchObjectPacks(std::set<cloud_provider::ObjectId> pack_ids,
+                                    ftl::Closure on_done) {
+  GetAuthToken(
+      [ this, pack_ids = std::move(pack_ids),
+        on_done = std::move(on_done) ](std::string auth_token) mutable {
+        object_packs_.FetchPacks(auth_token, pack_ids, [
+          this, pack_ids, on_done = std::move(on_done)
+        ](cloud_provider::Status status) mutable {
+          if (status == cloud_provider::Status::NETWORK_ERROR) {
+            FTL_LOG(WARNING)
+                << log_prefix_
+                << "fetching the object packs failed due to a connection "
+                << "error, retrying.";
+            Retry([
+              this, pack_ids = std::move(pack_ids), on_done = std::move(on_done)
+            ]() mutable {
+              FetchObjectPacks(std::move(pack_ids), std::move(on_done));
+            });
+            return;
+          }
+          if (status != cloud_provider::Status::OK) {
+            SetDownloadState(DOWNLOAD_ERROR);
+            HandleError("Failed to retrieve the object packs.");
+            return;
+          }
+          backoff_->Reset();
+          on_done();
+        });
+      },
+      [this] {
+        SetDownloadState(DOWNLOAD_ERROR);
+        HandleError(
+            "Failed to retrieve the auth token to download object packs.");
+      });
 }
 
 void PageSyncImpl::SetRemoteWatcher(bool is_retry) {
@@ -308,14 +570,25 @@ void PageSyncImpl::SetRemoteWatcher(bool is_retry) {
     return;
   }
 
+  if (watch_multiplexer_) {
+    // The multiplexer handles the auth token and the reconnections.
+    watch_multiplexer_->WatchCommits(storage_->GetId(), last_commit_ts,
+                                     cloud_provider_, this);
+    remote_watch_set_ = true;
+    CheckCaughtUp();
+    return;
+  }
+
   GetAuthToken(
       [ this, is_retry,
         last_commit_ts = std::move(last_commit_ts) ](std::string auth_token) {
         cloud_provider_->WatchCommits(auth_token, last_commit_ts, this);
         remote_watch_set_ = true;
+        remote_watch_auth_token_ = std::move(auth_token);
         if (is_retry) {
           FTL_LOG(INFO) << log_prefix_ << "Cloud watcher re-established";
         }
+        CheckCaughtUp();
       },
       [this] {
         HandleError(
@@ -323,9 +596,18 @@ void PageSyncImpl::SetRemoteWatcher(bool is_retry) {
       });
 }
 
+void PageSyncImpl::UnwatchRemoteCommits() {
+  if (watch_multiplexer_) {
+    watch_multiplexer_->UnwatchCommits(this);
+  } else {
+    cloud_provider_->UnwatchCommits(this);
+  }
+}
+
 void PageSyncImpl::UploadUnsyncedCommits() {
   if (!commits_to_upload_) {
     SetUploadState(UPLOAD_IDLE);
+    LocalBacklogUploaded();
     CheckIdle();
     return;
   }
@@ -364,6 +646,7 @@ void PageSyncImpl::VerifyUnsyncedCommits(
   if (commits.empty()) {
     SetUploadState(UPLOAD_IDLE);
     commits_to_upload_ = false;
+    LocalBacklogUploaded();
     CheckIdle();
     return;
   }
@@ -394,6 +677,7 @@ void PageSyncImpl::VerifyUnsyncedCommits(
       // Too many local heads.
       commits_to_upload_ = false;
       SetUploadState(WAIT_TOO_MANY_LOCAL_HEADS);
+      LocalBacklogUploaded();
       CheckIdle();
       return;
     }
@@ -407,6 +691,12 @@ void PageSyncImpl::HandleUnsyncedCommits(
     std::vector<std::unique_ptr<const storage::Commit>> commits) {
   FTL_DCHECK(!batch_upload_);
   FTL_DCHECK(commits_to_upload_);
+  // The commits are sorted by generation: the last one is the single head.
+  upload_head_ = commits.back()->GetId();
+  // While the page holds a sync slot, the commits made during the upload of the
+  // initial backlog are not appended to it, so that a page committing
+  // continuously still catches up and releases its slot.
+  batch_upload_accepts_commits_ = local_backlog_uploaded_ || !sync_scheduled_;
   batch_upload_ =
       std::make_unique<BatchUpload>(
           storage_, cloud_provider_, auth_provider_, std::move(commits),
@@ -414,6 +704,7 @@ void PageSyncImpl::HandleUnsyncedCommits(
             // Upload succeeded, reset the backoff delay.
             backoff_->Reset();
             batch_upload_.reset();
+            LocalBacklogUploaded();
             UploadUnsyncedCommits();
           },
           [this] {
@@ -421,11 +712,15 @@ void PageSyncImpl::HandleUnsyncedCommits(
                 << log_prefix_
                 << "commit upload failed due to a connection error, retrying.";
             SetUploadState(UPLOAD_PENDING);
+            // List the unsynced commits again on retry.
+            batch_upload_accepts_commits_ = false;
             Retry([this] {
               batch_upload_.reset();
               UploadUnsyncedCommits();
             });
-          });
+          },
+          10, object_packs_enabled_ ? kMaxPackedObjectSize : 0u,
+          kMaxObjectPackSize);
   batch_upload_->Start();
 }
 
@@ -435,21 +730,40 @@ void PageSyncImpl::HandleError(const char error_description[]) {
     storage_->RemoveCommitWatcher(this);
   }
   if (remote_watch_set_) {
-    cloud_provider_->UnwatchCommits(this);
+    UnwatchRemoteCommits();
   }
   storage_->SetSyncDelegate(nullptr);
+  ReleaseSyncSlot();
   on_error_();
   errored_ = true;
 }
 
 void PageSyncImpl::CheckIdle() {
   if (IsIdle()) {
+    ReleaseSyncSlot();
     if (on_idle_) {
       on_idle_();
     }
   }
 }
 
+void PageSyncImpl::LocalBacklogUploaded() {
+  if (local_backlog_uploaded_) {
+    return;
+  }
+  local_backlog_uploaded_ = true;
+  CheckCaughtUp();
+}
+
+void PageSyncImpl::CheckCaughtUp() {
+  // The page caught up with the cloud: let the other pages sync, even if it
+  // keeps uploading new local commits.
+  if (download_list_retrieved_ && remote_watch_set_ &&
+      local_backlog_uploaded_) {
+    ReleaseSyncSlot();
+  }
+}
+
 void PageSyncImpl::BacklogDownloaded() {
   download_list_retrieved_ = true;
   SetDownloadState(DOWNLOAD_IDLE);
@@ -461,6 +775,10 @@ void PageSyncImpl::BacklogDownloaded() {
 }
 
 void PageSyncImpl::Retry(ftl::Closure callable) {
+  ftl::TimeDelta delay = backoff_->GetNext();
+  if (sync_scheduler_) {
+    delay = sync_scheduler_->GetRetryDelay(delay);
+  }
   task_runner_->PostDelayedTask(
       [
         weak_this = weak_factory_.GetWeakPtr(), callable = std::move(callable)
@@ -469,18 +787,24 @@ void PageSyncImpl::Retry(ftl::Closure callable) {
           callable();
         }
       },
-      backoff_->GetNext());
+      delay);
 }
 
 void PageSyncImpl::NotifyStateWatcher() {
   if (ledger_watcher_) {
-    ledger_watcher_->Notify(download_state_, upload_state_);
+    ledger_watcher_->Notify(GetSyncState());
   }
   if (page_watcher_) {
-    page_watcher_->Notify(download_state_, upload_state_);
+    page_watcher_->Notify(GetSyncState());
   }
 }
 
+SyncStateWatcher::SyncStateContainer PageSyncImpl::GetSyncState() const {
+  SyncStateWatcher::SyncStateContainer state(download_state_, upload_state_);
+  state.queue_position = queue_position_;
+  return state;
+}
+
 void PageSyncImpl::SetDownloadState(DownloadSyncState sync_state) {
   download_state_ = sync_state;
   NotifyStateWatcher();
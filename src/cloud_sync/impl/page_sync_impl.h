@@ -7,6 +7,7 @@
 
 #include <functional>
 #include <queue>
+#include <set>
 
 #include "apps/ledger/src/backoff/backoff.h"
 #include "apps/ledger/src/callback/cancellable.h"
@@ -14,6 +15,11 @@
 #include "apps/ledger/src/cloud_provider/public/commit_watcher.h"
 #include "apps/ledger/src/cloud_sync/impl/batch_download.h"
 #include "apps/ledger/src/cloud_sync/impl/batch_upload.h"
+#include "apps/ledger/src/cloud_sync/impl/constants.h"
+#include "apps/ledger/src/cloud_sync/impl/download_scheduler.h"
+#include "apps/ledger/src/cloud_sync/impl/object_pack_cache.h"
+#include "apps/ledger/src/cloud_sync/impl/sync_scheduler.h"
+#include "apps/ledger/src/cloud_sync/impl/watch_multiplexer.h"
 #include "apps/ledger/src/cloud_sync/public/auth_provider.h"
 #include "apps/ledger/src/cloud_sync/public/page_sync.h"
 #include "apps/ledger/src/cloud_sync/public/sync_state_watcher.h"
@@ -41,7 +47,10 @@ namespace cloud_sync {
 // In order to track which remote commits were already fetched, we keep track of
 // the server-side timestamp of the last commit we added to storage. As this
 // information needs to be persisted through reboots, we store the timestamp
-// itself in storage using a dedicated API (Get/SetSyncMetadata()).
+// itself in storage using a dedicated API (Get/SetSyncMetadata()). The backlog
+// is retrieved and added to storage in batches of bounded size, and the
+// timestamp is updated after each batch, so that an interrupted download
+// resumes where it stopped.
 //
 // Recoverable errors (such as network errors) are automatically retried with
 // the given backoff policy, using the given task runner to schedule the tasks.
@@ -52,6 +61,26 @@ namespace cloud_sync {
 // Unrecoverable errors (such as internal errors accessing the storage) cause
 // the page sync to stop, in which case the client is notified using the given
 // error callback.
+//
+// Object downloads go through the given download scheduler, which can be
+// shared with the other pages of the user. If none is given, the page uses its
+// own.
+//
+// Remote commits can reference an object pack holding some of their objects.
+// The packs are retrieved before the commits are added to storage, and the
+// objects they hold are then served from them. Local commits are uploaded with
+// their small objects packed once EnableObjectPacks() is called.
+//
+// Remote commits are watched through the cloud provider of the page, unless a
+// watch multiplexer shared with the other pages is set with
+// SetWatchMultiplexer().
+//
+// If a sync scheduler shared with the other pages is set with
+// SetSyncScheduler(), the page waits to be admitted by it before catching up
+// with the cloud, and releases its slot once caught up, that is once the
+// backlog of remote commits is downloaded, the remote watcher is set and the
+// backlog of local commits is uploaded. Its retries are then spread by the
+// scheduler.
 class PageSyncImpl : public PageSync,
                      public storage::CommitWatcher,
                      public storage::PageSyncDelegate,
@@ -63,7 +92,8 @@ class PageSyncImpl : public PageSync,
                AuthProvider* auth_provider,
                std::unique_ptr<backoff::Backoff> backoff,
                ftl::Closure on_error,
-               std::unique_ptr<SyncStateWatcher> ledger_watcher = nullptr);
+               std::unique_ptr<SyncStateWatcher> ledger_watcher = nullptr,
+               DownloadScheduler* download_scheduler = nullptr);
   ~PageSyncImpl() override;
 
   // |on_delete| will be called when this class is deleted.
@@ -75,6 +105,26 @@ class PageSyncImpl : public PageSync,
   // Enables upload. Has no effect if this method has already been called.
   void EnableUpload();
 
+  // Enables uploading the small objects in object packs. Must be called before
+  // Start().
+  void EnableObjectPacks();
+
+  // Watches the remote commits through |watch_multiplexer| instead of a
+  // dedicated stream. |watch_multiplexer| must outlive this object. Must be
+  // called before Start().
+  void SetWatchMultiplexer(WatchMultiplexer* watch_multiplexer);
+
+  // Sets the maximum number of remote commits retrieved at a time when
+  // downloading the backlog. Must be called before Start().
+  void SetBacklogBatchSize(size_t batch_size);
+
+  // Waits to be admitted by |sync_scheduler| at the given priority before
+  // catching up with the cloud. Pages scheduled with the BACKGROUND priority
+  // are promoted to PENDING_COMMITS if they have local commits to upload.
+  // |sync_scheduler| must outlive this object. Must be called before Start().
+  void SetSyncScheduler(SyncScheduler* sync_scheduler,
+                        SyncScheduler::Priority priority);
+
   // PageSync:
   void Start() override;
 
@@ -93,6 +143,7 @@ class PageSyncImpl : public PageSync,
 
   // storage::PageSyncDelegate:
   void GetObject(storage::ObjectIdView object_id,
+                 storage::DownloadPriority priority,
                  std::function<void(storage::Status status,
                                     uint64_t size,
                                     mx::socket data)> callback) override;
@@ -107,10 +158,23 @@ class PageSyncImpl : public PageSync,
   void OnMalformedNotification() override;
 
  private:
+  // Waits to be admitted by the sync scheduler, then starts the download.
+  void ScheduleSync();
+  void RequestSyncSlot(SyncScheduler::Priority priority);
+  // Releases the slot of the sync scheduler, if any.
+  void ReleaseSyncSlot();
+  // Traces the end of the wait for a slot of the sync scheduler, if waiting.
+  void EndSyncSlotWait();
+
   // Downloads the initial backlog of remote commits, and sets up the remote
   // watcher upon success.
   void StartDownload();
 
+  // Retrieves the remote commits not older than |min_timestamp|, at most
+  // |batch_size| of them, and adds them to storage. Proceeds with the next
+  // ones until the whole backlog is downloaded.
+  void DownloadBacklog(std::string min_timestamp, size_t batch_size);
+
   // Uploads the initial backlog of local unsynced commits, and sets up the
   // storage watcher upon success.
   void StartUpload();
@@ -120,6 +184,23 @@ class PageSyncImpl : public PageSync,
                      ftl::Closure on_done);
 
   void SetRemoteWatcher(bool is_retry);
+  void UnwatchRemoteCommits();
+
+  // Retrieves the given object packs, retrying on network errors.
+  void FetchObjectPacks(std::set<cloud_provider::ObjectId> pack_ids,
+                        ftl::Closure on_done);
+
+  // Downloads the given object from the cloud provider, retrying on network
+  // errors.
+  void DownloadObject(std::string object_id,
+                      ledger::RequestPriority priority,
+                      DownloadScheduler::Callback callback);
+  void OnObjectDownloaded(std::string object_id,
+                          ledger::RequestPriority priority,
+                          DownloadScheduler::Callback callback,
+                          cloud_provider::Status status,
+                          uint64_t size,
+                          mx::socket data);
 
   void UploadUnsyncedCommits();
   void VerifyUnsyncedCommits(
@@ -133,6 +214,11 @@ class PageSyncImpl : public PageSync,
 
   void CheckIdle();
 
+  // Marks the initial backlog of local commits as uploaded.
+  void LocalBacklogUploaded();
+  // Releases the sync slot if the page caught up with the cloud.
+  void CheckCaughtUp();
+
   void BacklogDownloaded();
 
   // Schedules the given closure to execute after the delay determined by
@@ -141,6 +227,7 @@ class PageSyncImpl : public PageSync,
 
   // Notify the state watcher of a change of synchronization state.
   void NotifyStateWatcher();
+  SyncStateWatcher::SyncStateContainer GetSyncState() const;
   void SetDownloadState(DownloadSyncState sync_state);
   void SetUploadState(UploadSyncState sync_state);
   void SetState(DownloadSyncState download_state, UploadSyncState upload_state);
@@ -156,6 +243,8 @@ class PageSyncImpl : public PageSync,
   AuthProvider* const auth_provider_;
   const std::unique_ptr<backoff::Backoff> backoff_;
   const ftl::Closure on_error_;
+  const std::unique_ptr<DownloadScheduler> owned_download_scheduler_;
+  DownloadScheduler* const download_scheduler_;
   const std::string log_prefix_;
 
   ftl::Closure on_idle_;
@@ -165,6 +254,8 @@ class PageSyncImpl : public PageSync,
   // Track which watchers are set, so that we know which to unset on hard error.
   bool local_watch_set_ = false;
   bool remote_watch_set_ = false;
+  // Auth token with which the remote watcher was set.
+  std::string remote_watch_auth_token_;
   // Set to true on unrecoverable error. This indicates that PageSyncImpl is in
   // broken state.
   bool errored_ = false;
@@ -172,11 +263,34 @@ class PageSyncImpl : public PageSync,
   // ensures that sync is not reported as idle until the commits to be
   // downloaded are retrieved.
   bool download_list_retrieved_ = false;
+  // Set to true when the backlog of local commits present when the download
+  // completed is uploaded.
+  bool local_backlog_uploaded_ = false;
   // Set to true when upload is enabled.
   bool upload_enabled_ = false;
+  // Set to true when the small objects are uploaded in object packs.
+  bool object_packs_enabled_ = false;
+  size_t backlog_batch_size_ = kBacklogBatchSize;
+  WatchMultiplexer* watch_multiplexer_ = nullptr;
+  SyncScheduler* sync_scheduler_ = nullptr;
+  SyncScheduler::Priority sync_priority_ = SyncScheduler::Priority::ACTIVE;
+  // Set to true while the page is scheduled by |sync_scheduler_|, that is from
+  // the start until it caught up with the cloud.
+  bool sync_scheduled_ = false;
+  // Set to true while the page waits to be admitted by |sync_scheduler_|.
+  bool waiting_for_sync_slot_ = false;
+  // Position in the queue of |sync_scheduler_|, or 0 if not waiting.
+  size_t queue_position_ = 0u;
+
+  // Object packs referenced by the remote commits.
+  ObjectPackCache object_packs_;
 
   // Current batch of local commits being uploaded.
   std::unique_ptr<BatchUpload> batch_upload_;
+  // Set when new local commits can be appended to |batch_upload_|, that is
+  // when they are children of |upload_head_|, the last commit of the upload.
+  bool batch_upload_accepts_commits_ = false;
+  storage::CommitId upload_head_;
   // Set to true when there are new commits to upload
   bool commits_to_upload_ = false;
   // The current batch of remote commits being downloaded.
@@ -4,7 +4,10 @@
 
 #include "apps/ledger/src/cloud_sync/impl/page_sync_impl.h"
 
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -42,15 +45,26 @@ class TestCommit : public storage::test::CommitEmptyImpl {
   }
 
   std::unique_ptr<Commit> Clone() const override {
-    return std::make_unique<TestCommit>(id, content);
+    auto commit = std::make_unique<TestCommit>(id, content);
+    commit->parent_ids = parent_ids;
+    return commit;
   }
 
   const storage::CommitId& GetId() const override { return id; }
 
+  std::vector<storage::CommitIdView> GetParentIds() const override {
+    std::vector<storage::CommitIdView> result;
+    for (const auto& parent_id : parent_ids) {
+      result.emplace_back(parent_id);
+    }
+    return result;
+  }
+
   ftl::StringView GetStorageBytes() const override { return content; }
 
   storage::CommitId id;
   std::string content;
+  std::vector<storage::CommitId> parent_ids;
 };
 
 // Fake implementation of storage::PageStorage. Injects the data that PageSync
@@ -159,6 +173,7 @@ class TestPageStorage : public storage::test::PageStorageEmptyImpl {
       std::function<void(storage::Status,
                          std::vector<std::unique_ptr<const storage::Commit>>)>
           callback) override {
+    get_unsynced_commits_calls++;
     if (should_fail_get_unsynced_commits) {
       callback(storage::Status::IO_ERROR, {});
       return;
@@ -187,6 +202,16 @@ class TestPageStorage : public storage::test::PageStorageEmptyImpl {
     return storage::Status::OK;
   }
 
+  storage::Status IsCommitSynced(const storage::CommitId& commit_id,
+                                 bool* is_synced) override {
+    *is_synced = std::none_of(
+        unsynced_commits_to_return.begin(), unsynced_commits_to_return.end(),
+        [&commit_id](const std::unique_ptr<const storage::Commit>& commit) {
+          return commit->GetId() == commit_id;
+        });
+    return storage::Status::OK;
+  }
+
   void SetSyncMetadata(ftl::StringView key,
                        ftl::StringView value,
                        std::function<void(storage::Status)> callback) override {
@@ -194,6 +219,21 @@ class TestPageStorage : public storage::test::PageStorageEmptyImpl {
     callback(storage::Status::OK);
   }
 
+  void DeleteSyncMetadata(
+      ftl::StringView key,
+      std::function<void(storage::Status)> callback) override {
+    sync_metadata.erase(key.ToString());
+    callback(storage::Status::OK);
+  }
+
+  // The objects of the received commits are not added to storage.
+  void GetPiece(storage::ObjectIdView /*object_id*/,
+                std::function<void(storage::Status,
+                                   std::unique_ptr<const storage::Object>)>
+                    callback) override {
+    callback(storage::Status::NOT_FOUND, nullptr);
+  }
+
   storage::Status GetSyncMetadata(ftl::StringView key,
                                   std::string* value) override {
     auto it = sync_metadata.find(key.ToString());
@@ -218,6 +258,7 @@ class TestPageStorage : public storage::test::PageStorageEmptyImpl {
   bool should_delay_add_commit_confirmation = false;
   std::vector<ftl::Closure> delayed_add_commit_confirmations;
   unsigned int add_commits_from_sync_calls = 0u;
+  unsigned int get_unsynced_commits_calls = 0u;
 
   std::set<storage::CommitId> commits_marked_as_synced;
   bool watcher_set = false;
@@ -248,6 +289,9 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
       std::move(commits.begin(), commits.end(),
                 std::back_inserter(received_commits));
     }
+    if (on_add_commits) {
+      on_add_commits();
+    }
     message_loop_->task_runner()->PostTask(
         [this, callback]() { callback(commit_status_to_return); });
   }
@@ -277,13 +321,17 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
     watcher_removed = true;
   }
 
+  // Returns the records of |records_to_return| starting at the first one of
+  // |min_timestamp|, at most |max_count| of them.
   void GetCommits(const std::string& auth_token,
-                  const std::string& /*min_timestamp*/,
+                  const std::string& min_timestamp,
+                  size_t max_count,
                   std::function<void(cloud_provider::Status,
                                      std::vector<cloud_provider::Record>)>
                       callback) override {
     get_commits_calls++;
     get_commits_auth_tokens.push_back(auth_token);
+    get_commits_min_timestamps.push_back(min_timestamp);
     if (should_fail_get_commits) {
       message_loop_->task_runner()->PostTask([callback]() {
         callback(cloud_provider::Status::NETWORK_ERROR, {});
@@ -291,18 +339,35 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
       return;
     }
 
-    message_loop_->task_runner()->PostTask([this, callback]() {
-      callback(cloud_provider::Status::OK, std::move(records_to_return));
-    });
+    auto it = std::find_if(records_to_return.begin(), records_to_return.end(),
+                           [&min_timestamp](const cloud_provider::Record& r) {
+                             return r.timestamp == min_timestamp;
+                           });
+    if (it == records_to_return.end()) {
+      it = records_to_return.begin();
+    }
+    std::vector<cloud_provider::Record> records;
+    for (; it != records_to_return.end() &&
+           (!max_count || records.size() < max_count);
+         ++it) {
+      records.emplace_back(it->commit.Clone(), it->timestamp,
+                           it->batch_position, it->batch_size);
+    }
+    message_loop_->task_runner()->PostTask(ftl::MakeCopyable(
+        [ callback, records = std::move(records) ]() mutable {
+          callback(cloud_provider::Status::OK, std::move(records));
+        }));
   }
 
   void GetObject(const std::string& auth_token,
                  cloud_provider::ObjectIdView object_id,
+                 ledger::RequestPriority priority,
                  std::function<void(cloud_provider::Status status,
                                     uint64_t size,
                                     mx::socket data)> callback) override {
     get_object_calls++;
     get_object_auth_tokens.push_back(auth_token);
+    get_object_priorities.push_back(priority);
     if (should_fail_get_object) {
       message_loop_->task_runner()->PostTask([callback]() {
         callback(cloud_provider::Status::NETWORK_ERROR, 0, mx::socket());
@@ -318,20 +383,42 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
         });
   }
 
+  void GetObjectPack(
+      const std::string& /*auth_token*/,
+      cloud_provider::ObjectIdView pack_id,
+      std::function<void(
+          cloud_provider::Status,
+          std::map<cloud_provider::ObjectId, cloud_provider::Data>)> callback)
+      override {
+    get_object_pack_calls++;
+    message_loop_->task_runner()->PostTask(
+        [ this, pack_id = pack_id.ToString(), callback ]() {
+          callback(cloud_provider::Status::OK, packs_to_return[pack_id]);
+        });
+  }
+
   bool should_fail_get_commits = false;
   bool should_fail_get_object = false;
+  // Called when commits are uploaded, before the upload completes.
+  ftl::Closure on_add_commits;
   std::vector<cloud_provider::Record> records_to_return;
   std::vector<cloud_provider::Record> notifications_to_deliver;
   cloud_provider::Status commit_status_to_return = cloud_provider::Status::OK;
   std::unordered_map<std::string, std::string> objects_to_return;
+  std::map<cloud_provider::ObjectId,
+           std::map<cloud_provider::ObjectId, cloud_provider::Data>>
+      packs_to_return;
 
   std::vector<std::string> watch_commits_auth_tokens;
   std::vector<std::string> watch_call_min_timestamps;
   unsigned int add_commits_calls = 0u;
   unsigned int get_commits_calls = 0u;
   std::vector<std::string> get_commits_auth_tokens;
+  std::vector<std::string> get_commits_min_timestamps;
   unsigned int get_object_calls = 0u;
   std::vector<std::string> get_object_auth_tokens;
+  std::vector<ledger::RequestPriority> get_object_priorities;
+  unsigned int get_object_pack_calls = 0u;
   std::vector<cloud_provider::Commit> received_commits;
   bool watcher_removed = false;
   cloud_provider::CommitWatcher* watcher_ = nullptr;
@@ -674,6 +761,36 @@ TEST_F(PageSyncImplTest, UploadExistingAndNewCommits) {
   EXPECT_EQ(1u, storage_.commits_marked_as_synced.count("id2"));
 }
 
+// Verifies that the local commits created during an upload are appended to it,
+// without listing the unsynced commits again.
+TEST_F(PageSyncImplTest, PipelineNewCommits) {
+  storage_.NewCommit("id1", "content1");
+
+  bool commit_added = false;
+  message_loop_.SetAfterTaskCallback([this, &commit_added] {
+    if (!commit_added && cloud_provider_.add_commits_calls == 1u) {
+      // The upload of the first commit is not acknowledged yet.
+      commit_added = true;
+      auto commit = storage_.NewCommit("id2", "content2");
+      commit->parent_ids.push_back("id1");
+      page_sync_->OnNewCommits(commit->AsList(), storage::ChangeSource::LOCAL);
+    }
+  });
+  page_sync_->SetOnIdle(MakeQuitTask());
+  StartPageSync();
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_TRUE(commit_added);
+  EXPECT_EQ(2u, cloud_provider_.add_commits_calls);
+  ASSERT_EQ(2u, cloud_provider_.received_commits.size());
+  EXPECT_EQ("id1", cloud_provider_.received_commits[0].id);
+  EXPECT_EQ("id2", cloud_provider_.received_commits[1].id);
+  EXPECT_EQ(1u, storage_.commits_marked_as_synced.count("id2"));
+  // The unsynced commits are only listed when sync starts, and once the upload
+  // is done.
+  EXPECT_EQ(2u, storage_.get_unsynced_commits_calls);
+}
+
 // Verifies that failing uploads are retried. In production the retries are
 // delayed, here we set the delays to 0.
 TEST_F(PageSyncImplTest, RetryUpload) {
@@ -773,6 +890,65 @@ TEST_F(PageSyncImplTest, DownloadBacklog) {
             cloud_provider_.get_commits_auth_tokens);
 }
 
+// Verifies that a long backlog is retrieved and saved in storage in batches,
+// without splitting the commits sharing a timestamp.
+TEST_F(PageSyncImplTest, DownloadBacklogInBatches) {
+  cloud_provider_.records_to_return.emplace_back(
+      cloud_provider::Commit("id1", "content1", {}), "42");
+  cloud_provider_.records_to_return.emplace_back(
+      cloud_provider::Commit("id2", "content2", {}), "43", 0, 2);
+  cloud_provider_.records_to_return.emplace_back(
+      cloud_provider::Commit("id3", "content3", {}), "43", 1, 2);
+  cloud_provider_.records_to_return.emplace_back(
+      cloud_provider::Commit("id4", "content4", {}), "44");
+  cloud_provider_.records_to_return.emplace_back(
+      cloud_provider::Commit("id5", "content5", {}), "45");
+
+  std::vector<std::string> timestamps;
+  page_sync_->SetBacklogBatchSize(2u);
+  page_sync_->SetOnBacklogDownloaded(MakeQuitTask());
+  StartPageSync();
+  message_loop_.SetAfterTaskCallback([this, &timestamps] {
+    auto it = storage_.sync_metadata.find(kTimestampKey.ToString());
+    if (it != storage_.sync_metadata.end() &&
+        (timestamps.empty() || timestamps.back() != it->second)) {
+      timestamps.push_back(it->second);
+    }
+  });
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(5u, storage_.received_commits.size());
+  EXPECT_EQ(3u, storage_.add_commits_from_sync_calls);
+  // The second batch only holds commits of timestamp 43, which could continue
+  // past it: it is retrieved again with a larger batch size.
+  EXPECT_EQ((std::vector<std::string>{"", "43", "43", "45"}),
+            cloud_provider_.get_commits_min_timestamps);
+  // The timestamp is persisted after each batch.
+  EXPECT_EQ((std::vector<std::string>{"42", "44", "45"}), timestamps);
+}
+
+// Verifies that the download of the backlog resumes at the persisted
+// timestamp.
+TEST_F(PageSyncImplTest, DownloadBacklogResume) {
+  storage_.sync_metadata[kTimestampKey.ToString()] = "43";
+  cloud_provider_.records_to_return.emplace_back(
+      cloud_provider::Commit("id1", "content1", {}), "42");
+  cloud_provider_.records_to_return.emplace_back(
+      cloud_provider::Commit("id2", "content2", {}), "43");
+  cloud_provider_.records_to_return.emplace_back(
+      cloud_provider::Commit("id3", "content3", {}), "44");
+
+  page_sync_->SetOnBacklogDownloaded(MakeQuitTask());
+  StartPageSync();
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(std::vector<std::string>{"43"},
+            cloud_provider_.get_commits_min_timestamps);
+  EXPECT_EQ(2u, storage_.received_commits.size());
+  EXPECT_EQ(0u, storage_.received_commits.count("id1"));
+  EXPECT_EQ("44", storage_.sync_metadata[kTimestampKey.ToString()]);
+}
+
 // Verifies that if auth provider fails to provide the auth token, the error
 // callback is called.
 TEST_F(PageSyncImplTest, DownloadBacklogAuthError) {
@@ -862,6 +1038,7 @@ TEST_F(PageSyncImplTest, ReceiveNotifications) {
 // Verify that we retry setting the remote watcher on connection errors
 // and when the auth token expires.
 TEST_F(PageSyncImplTest, RetryRemoteWatcher) {
+  auth_provider_.token_to_return = "some-token";
   StartPageSync();
   EXPECT_EQ(0u, storage_.received_commits.size());
 
@@ -875,6 +1052,8 @@ TEST_F(PageSyncImplTest, RetryRemoteWatcher) {
   }));
 
   page_sync_->OnTokenExpired();
+  EXPECT_EQ(std::vector<std::string>{"some-token"},
+            auth_provider_.invalidated_tokens);
   EXPECT_TRUE(RunLoopUntil([this] {
     return cloud_provider_.watch_call_min_timestamps.size() == 3u;
   }));
@@ -1010,6 +1189,80 @@ TEST_F(PageSyncImplTest, DownloadIdleCallback) {
   EXPECT_TRUE(page_sync_->IsIdle());
 }
 
+// Verifies that a page waits to be admitted by the sync scheduler before
+// catching up with the cloud, reports its position in the queue meanwhile, and
+// releases its slot once caught up.
+TEST_F(PageSyncImplTest, WaitForSyncScheduler) {
+  SyncScheduler sync_scheduler(message_loop_.task_runner(), 1);
+  int other_page;
+  bool other_page_admitted = false;
+  sync_scheduler.Schedule(
+      &other_page, SyncScheduler::Priority::ACTIVE,
+      [&other_page_admitted] { other_page_admitted = true; }, [](size_t) {});
+  EXPECT_TRUE(other_page_admitted);
+
+  page_sync_->SetSyncScheduler(&sync_scheduler,
+                               SyncScheduler::Priority::ACTIVE);
+  page_sync_->SetOnIdle(MakeQuitTask());
+  StartPageSync();
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(100)));
+
+  EXPECT_EQ(0u, cloud_provider_.get_commits_calls);
+  EXPECT_EQ(1u, sync_scheduler.GetQueuePosition(page_sync_.get()));
+  ASSERT_FALSE(state_watcher_->states.empty());
+  EXPECT_EQ(CATCH_UP_DOWNLOAD, state_watcher_->states.back().download);
+  EXPECT_EQ(1u, state_watcher_->states.back().queue_position);
+
+  sync_scheduler.Release(&other_page);
+  EXPECT_EQ(0u, state_watcher_->states.back().queue_position);
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(1u, cloud_provider_.get_commits_calls);
+  EXPECT_EQ(0u, sync_scheduler.in_flight());
+}
+
+// Verifies that a page releases its sync slot once it caught up with the
+// cloud, even if it keeps committing and never gets idle.
+TEST_F(PageSyncImplTest, ReleaseSyncSchedulerOnceCaughtUp) {
+  SyncScheduler sync_scheduler(message_loop_.task_runner(), 1);
+  storage_.NewCommit("id0", "content0");
+  page_sync_->SetSyncScheduler(&sync_scheduler,
+                               SyncScheduler::Priority::ACTIVE);
+  StartPageSync();
+  EXPECT_EQ(1u, sync_scheduler.in_flight());
+
+  int other_page;
+  bool other_page_admitted = false;
+  bool page_idle_on_admission = true;
+  sync_scheduler.Schedule(&other_page, SyncScheduler::Priority::ACTIVE,
+                          [this, &other_page_admitted,
+                           &page_idle_on_admission] {
+                            other_page_admitted = true;
+                            page_idle_on_admission = page_sync_->IsIdle();
+                          },
+                          [](size_t) {});
+  EXPECT_FALSE(other_page_admitted);
+
+  // Make a new local commit during each upload, so that there always is one
+  // more to upload.
+  int commit_count = 0;
+  cloud_provider_.on_add_commits = [this, &commit_count] {
+    std::string id = "id" + std::to_string(++commit_count);
+    message_loop_.task_runner()->PostTask([this, id] {
+      auto commit = storage_.NewCommit(id, "content");
+      page_sync_->OnNewCommits(commit->AsList(), storage::ChangeSource::LOCAL);
+    });
+  };
+
+  EXPECT_TRUE(RunLoopUntil([&other_page_admitted] {
+    return other_page_admitted;
+  }));
+  EXPECT_FALSE(page_idle_on_admission);
+  EXPECT_EQ(1u, sync_scheduler.in_flight());
+  EXPECT_EQ(0u, error_callback_calls_);
+  cloud_provider_.on_add_commits = nullptr;
+}
+
 // Verifies that sync correctly fetches objects from the cloud provider.
 TEST_F(PageSyncImplTest, GetObject) {
   cloud_provider_.objects_to_return["object_id"] = "content";
@@ -1021,12 +1274,16 @@ TEST_F(PageSyncImplTest, GetObject) {
   mx::socket data;
   page_sync_->GetObject(
       storage::ObjectIdView("object_id"),
+      storage::DownloadPriority::INTERACTIVE,
       callback::Capture(MakeQuitTask(), &status, &size, &data));
   EXPECT_FALSE(RunLoopWithTimeout());
 
   EXPECT_EQ(storage::Status::OK, status);
   EXPECT_EQ(std::vector<std::string>{"some-token"},
             cloud_provider_.get_object_auth_tokens);
+  EXPECT_EQ(std::vector<ledger::RequestPriority>{
+                ledger::RequestPriority::INTERACTIVE},
+            cloud_provider_.get_object_priorities);
   EXPECT_EQ(7u, size);
   std::string content;
   EXPECT_TRUE(mtl::BlockingCopyToString(std::move(data), &content));
@@ -1049,6 +1306,7 @@ TEST_F(PageSyncImplTest, GetObjectAuthError) {
   mx::socket data;
   page_sync_->GetObject(
       storage::ObjectIdView("object_id"),
+      storage::DownloadPriority::INTERACTIVE,
       callback::Capture(MakeQuitTask(), &status, &size, &data));
   EXPECT_FALSE(RunLoopWithTimeout());
 
@@ -1075,6 +1333,7 @@ TEST_F(PageSyncImplTest, RetryGetObject) {
   mx::socket data;
   page_sync_->GetObject(
       storage::ObjectIdView("object_id"),
+      storage::DownloadPriority::INTERACTIVE,
       callback::Capture(MakeQuitTask(), &status, &size, &data));
   EXPECT_FALSE(RunLoopWithTimeout());
 
@@ -1086,6 +1345,41 @@ TEST_F(PageSyncImplTest, RetryGetObject) {
   EXPECT_EQ("content", content);
 }
 
+// Verifies that the object packs referenced by remote commits are retrieved,
+// and that the objects they hold are then served from them.
+TEST_F(PageSyncImplTest, DownloadObjectPack) {
+  cloud_provider::Commit commit("id1", "content1", {});
+  commit.pack_id = "pack";
+  cloud_provider_.records_to_return.emplace_back(std::move(commit), "42");
+  cloud_provider_.packs_to_return["pack"] = {{"object_id", "content"}};
+
+  page_sync_->SetOnBacklogDownloaded(MakeQuitTask());
+  StartPageSync();
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(1u, storage_.received_commits.size());
+  EXPECT_EQ(1u, cloud_provider_.get_object_pack_calls);
+  EXPECT_EQ("pack",
+            storage_.sync_metadata[kObjectPackKeyPrefix.ToString() +
+                                   "object_id"]);
+
+  storage::Status status;
+  uint64_t size;
+  mx::socket data;
+  page_sync_->GetObject(
+      storage::ObjectIdView("object_id"),
+      storage::DownloadPriority::INTERACTIVE,
+      callback::Capture(MakeQuitTask(), &status, &size, &data));
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(storage::Status::OK, status);
+  EXPECT_EQ(0u, cloud_provider_.get_object_calls);
+  EXPECT_EQ(7u, size);
+  std::string content;
+  EXPECT_TRUE(mtl::BlockingCopyToString(std::move(data), &content));
+  EXPECT_EQ("content", content);
+}
+
 // Verifies that uploads are paused until EnableUpload is called.
 TEST_F(PageSyncImplTest, UploadIsPaused) {
   storage_.NewCommit("id1", "content1");
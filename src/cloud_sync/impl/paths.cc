@@ -36,8 +36,10 @@ std::string GetGcsPrefixForApp(ftl::StringView user_id,
 
 std::string GetGcsPrefixForPage(ftl::StringView app_path,
                                 ftl::StringView page_id) {
-  return ftl::Concatenate(
-      {app_path, kGcsSeparator, firebase::EncodeKey(page_id), kGcsSeparator});
+  std::string prefix = ftl::Concatenate({app_path, kGcsSeparator});
+  firebase::AppendEncodedKey(page_id, &prefix);
+  prefix.append(kGcsSeparator);
+  return prefix;
 }
 
 std::string GetFirebasePathForUser(ftl::StringView user_id) {
@@ -60,8 +62,9 @@ std::string GetFirebasePathForApp(ftl::StringView user_id,
 
 std::string GetFirebasePathForPage(ftl::StringView app_path,
                                    ftl::StringView page_id) {
-  return ftl::Concatenate(
-      {app_path, kFirebaseSeparator, firebase::EncodeKey(page_id)});
+  std::string path = ftl::Concatenate({app_path, kFirebaseSeparator});
+  firebase::AppendEncodedKey(page_id, &path);
+  return path;
 }
 
 }  // namespace cloud_sync
@@ -0,0 +1,179 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/sync_scheduler.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "apps/tracing/lib/trace/event.h"
+#include "lib/ftl/logging.h"
+
+namespace cloud_sync {
+
+SyncScheduler::SyncScheduler(ftl::RefPtr<ftl::TaskRunner> task_runner,
+                             size_t max_concurrent_syncs,
+                             ftl::TimeDelta retry_interval,
+                             std::function<uint64_t()> seed_generator)
+    : task_runner_(std::move(task_runner)),
+      max_concurrent_syncs_(max_concurrent_syncs),
+      retry_interval_(retry_interval),
+      rng_(seed_generator()),
+      weak_factory_(this) {
+  FTL_DCHECK(max_concurrent_syncs_ > 0);
+  FTL_DCHECK(retry_interval_ >= ftl::TimeDelta::Zero());
+}
+
+SyncScheduler::~SyncScheduler() {}
+
+void SyncScheduler::Schedule(const void* client,
+                             Priority priority,
+                             ftl::Closure on_admitted,
+                             std::function<void(size_t)> on_position_changed) {
+  FTL_DCHECK(clients_.find(client) == clients_.end());
+  Client& entry = clients_[client];
+  entry.priority = priority;
+  entry.on_admitted = std::move(on_admitted);
+  entry.on_position_changed = std::move(on_position_changed);
+  GetQueue(priority).push_back(client);
+  AdmitClients();
+
+  auto it = clients_.find(client);
+  if (it != clients_.end() && !it->second.admitted) {
+    it->second.position = GetQueuePosition(client);
+    it->second.on_position_changed(it->second.position);
+    // The clients of lower priority moved back in the queue.
+    SchedulePositionsUpdate();
+  }
+  ReportMetrics();
+}
+
+void SyncScheduler::Release(const void* client) {
+  auto it = clients_.find(client);
+  if (it == clients_.end()) {
+    return;
+  }
+  if (it->second.admitted) {
+    --in_flight_count_;
+  } else {
+    std::deque<const void*>& queue = GetQueue(it->second.priority);
+    queue.erase(std::find(queue.begin(), queue.end(), client));
+  }
+  clients_.erase(it);
+  SchedulePositionsUpdate();
+  AdmitClients();
+  ReportMetrics();
+}
+
+size_t SyncScheduler::GetQueuePosition(const void* client) const {
+  size_t offset = 0u;
+  for (const std::deque<const void*>* queue :
+       {&active_queue_, &pending_commits_queue_, &background_queue_}) {
+    auto it = std::find(queue->begin(), queue->end(), client);
+    if (it != queue->end()) {
+      return offset + (it - queue->begin()) + 1;
+    }
+    offset += queue->size();
+  }
+  return 0u;
+}
+
+ftl::TimeDelta SyncScheduler::GetRetryDelay(ftl::TimeDelta delay) {
+  ftl::TimePoint now = ftl::TimePoint::Now();
+  ftl::TimePoint retry_time = std::max(now + delay, next_retry_time_);
+  next_retry_time_ = retry_time + retry_interval_;
+
+  std::uniform_int_distribution<int64_t> distribution(
+      0, std::max<int64_t>(retry_interval_.ToMilliseconds() - 1, 0));
+  return retry_time - now +
+         ftl::TimeDelta::FromMilliseconds(distribution(rng_));
+}
+
+std::deque<const void*>& SyncScheduler::GetQueue(Priority priority) {
+  switch (priority) {
+    case Priority::ACTIVE:
+      return active_queue_;
+    case Priority::PENDING_COMMITS:
+      return pending_commits_queue_;
+    case Priority::BACKGROUND:
+      return background_queue_;
+  }
+}
+
+void SyncScheduler::AdmitClients() {
+  while (in_flight_count_ < max_concurrent_syncs_) {
+    std::deque<const void*>* queue = nullptr;
+    for (std::deque<const void*>* candidate :
+         {&active_queue_, &pending_commits_queue_, &background_queue_}) {
+      if (!candidate->empty()) {
+        queue = candidate;
+        break;
+      }
+    }
+    if (!queue) {
+      return;
+    }
+
+    const void* client = queue->front();
+    queue->pop_front();
+    Client& entry = clients_[client];
+    entry.admitted = true;
+    entry.position = 0u;
+    ++in_flight_count_;
+    SchedulePositionsUpdate();
+    // |on_admitted| can release clients, including this one.
+    ftl::Closure on_admitted = std::move(entry.on_admitted);
+    on_admitted();
+  }
+}
+
+void SyncScheduler::SchedulePositionsUpdate() {
+  if (positions_update_pending_ || queue_depth() == 0u) {
+    return;
+  }
+  positions_update_pending_ = true;
+  task_runner_->PostTask([weak_this = weak_factory_.GetWeakPtr()] {
+    if (weak_this) {
+      weak_this->UpdatePositions();
+    }
+  });
+}
+
+void SyncScheduler::UpdatePositions() {
+  positions_update_pending_ = false;
+
+  // Compute all the positions before notifying the clients, as they can
+  // change the queue when notified.
+  std::vector<std::pair<const void*, size_t>> changes;
+  size_t position = 0u;
+  for (const std::deque<const void*>* queue :
+       {&active_queue_, &pending_commits_queue_, &background_queue_}) {
+    for (const void* client : *queue) {
+      ++position;
+      Client& entry = clients_[client];
+      if (entry.position != position) {
+        entry.position = position;
+        changes.emplace_back(client, position);
+      }
+    }
+  }
+
+  for (const auto& change : changes) {
+    auto it = clients_.find(change.first);
+    if (it == clients_.end() || it->second.position != change.second) {
+      continue;
+    }
+    auto on_position_changed = it->second.on_position_changed;
+    on_position_changed(change.second);
+  }
+}
+
+void SyncScheduler::ReportMetrics() {
+  TRACE_COUNTER("ledger", "sync_scheduler", reinterpret_cast<uintptr_t>(this),
+                "queue_depth", static_cast<uint64_t>(queue_depth()),
+                "in_flight", static_cast<uint64_t>(in_flight_count_));
+}
+
+}  // namespace cloud_sync
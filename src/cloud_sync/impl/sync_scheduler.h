@@ -0,0 +1,120 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_SYNC_SCHEDULER_H_
+#define APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_SYNC_SCHEDULER_H_
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <random>
+
+#include "apps/ledger/src/glue/crypto/rand.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace cloud_sync {
+
+// Admits the pages of a user to sync under a global limit.
+//
+// When it starts, a page catches up with the cloud: it downloads the backlog of
+// remote commits, sets the remote watcher and uploads the backlog of local
+// commits. At most |max_concurrent_syncs| pages do so at the same time. The
+// other ones are queued and admitted by decreasing priority, in the order in
+// which they were scheduled within a priority. Once caught up, a page releases
+// its slot and keeps syncing without one.
+//
+// The retries of all the pages are also spread over time, so that they do not
+// hit the server at the same time after a connection loss.
+class SyncScheduler {
+ public:
+  enum class Priority {
+    // Clients are connected to the page.
+    ACTIVE,
+    // The page has local commits waiting to be uploaded.
+    PENDING_COMMITS,
+    // Other pages.
+    BACKGROUND,
+  };
+
+  SyncScheduler(
+      ftl::RefPtr<ftl::TaskRunner> task_runner,
+      size_t max_concurrent_syncs = 10,
+      ftl::TimeDelta retry_interval = ftl::TimeDelta::FromMilliseconds(10),
+      std::function<uint64_t()> seed_generator = glue::RandUint64);
+  ~SyncScheduler();
+
+  // Schedules the sync of |client|, which must not already be scheduled.
+  // |on_admitted| is called once |client| is admitted, possibly synchronously.
+  // Until then, |on_position_changed| is called with the position of |client|
+  // in the queue, starting at 1, each time it changes.
+  void Schedule(const void* client,
+                Priority priority,
+                ftl::Closure on_admitted,
+                std::function<void(size_t)> on_position_changed);
+
+  // Releases the slot of |client|, or removes it from the queue if it was not
+  // admitted yet. Has no effect if |client| is not scheduled.
+  void Release(const void* client);
+
+  // Returns the position of |client| in the queue, starting at 1, or 0 if it
+  // is not queued.
+  size_t GetQueuePosition(const void* client) const;
+
+  // Returns the delay after which to retry a request that a client would
+  // otherwise retry after |delay|. The retries are at least |retry_interval|
+  // apart, at a random point of their interval.
+  ftl::TimeDelta GetRetryDelay(ftl::TimeDelta delay);
+
+  // Number of pages waiting for a slot.
+  size_t queue_depth() const { return clients_.size() - in_flight_count_; }
+  // Number of pages currently admitted.
+  size_t in_flight() const { return in_flight_count_; }
+
+ private:
+  struct Client {
+    Priority priority;
+    ftl::Closure on_admitted;
+    std::function<void(size_t)> on_position_changed;
+    size_t position = 0u;
+    bool admitted = false;
+  };
+
+  std::deque<const void*>& GetQueue(Priority priority);
+  // Admits queued clients while there is room for them.
+  void AdmitClients();
+  // Notifies the queued clients of their new positions, once the current
+  // changes to the queue are done.
+  void SchedulePositionsUpdate();
+  void UpdatePositions();
+  void ReportMetrics();
+
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  const size_t max_concurrent_syncs_;
+  const ftl::TimeDelta retry_interval_;
+  std::default_random_engine rng_;
+
+  std::map<const void*, Client> clients_;
+  std::deque<const void*> active_queue_;
+  std::deque<const void*> pending_commits_queue_;
+  std::deque<const void*> background_queue_;
+  size_t in_flight_count_ = 0u;
+  bool positions_update_pending_ = false;
+  // Earliest time at which the next retry can run.
+  ftl::TimePoint next_retry_time_;
+
+  // This must be the last member of this class.
+  ftl::WeakPtrFactory<SyncScheduler> weak_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SyncScheduler);
+};
+
+}  // namespace cloud_sync
+
+#endif  // APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_SYNC_SCHEDULER_H_
@@ -0,0 +1,137 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/sync_scheduler.h"
+
+#include <map>
+#include <vector>
+
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+
+namespace cloud_sync {
+namespace {
+
+class SyncSchedulerTest : public ::test::TestWithMessageLoop {
+ public:
+  SyncSchedulerTest() {}
+  ~SyncSchedulerTest() override {}
+
+ protected:
+  // Schedules the client of the given index, recording its admission in
+  // |admitted_| and its positions in |positions_|.
+  void Schedule(SyncScheduler* scheduler,
+                size_t index,
+                SyncScheduler::Priority priority) {
+    scheduler->Schedule(&clients_[index], priority,
+                        [this, index] { admitted_.push_back(index); },
+                        [this, index](size_t position) {
+                          positions_[index].push_back(position);
+                        });
+  }
+
+  void Release(SyncScheduler* scheduler, size_t index) {
+    scheduler->Release(&clients_[index]);
+  }
+
+  size_t GetQueuePosition(SyncScheduler* scheduler, size_t index) {
+    return scheduler->GetQueuePosition(&clients_[index]);
+  }
+
+  char clients_[10];
+  std::vector<size_t> admitted_;
+  std::map<size_t, std::vector<size_t>> positions_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(SyncSchedulerTest);
+};
+
+TEST_F(SyncSchedulerTest, LimitsConcurrentSyncs) {
+  SyncScheduler scheduler(message_loop_.task_runner(), 2);
+  for (size_t i = 0; i < 3; ++i) {
+    Schedule(&scheduler, i, SyncScheduler::Priority::ACTIVE);
+  }
+  EXPECT_EQ((std::vector<size_t>{0, 1}), admitted_);
+  EXPECT_EQ(2u, scheduler.in_flight());
+  EXPECT_EQ(1u, scheduler.queue_depth());
+  EXPECT_EQ(1u, GetQueuePosition(&scheduler, 2));
+  EXPECT_EQ(std::vector<size_t>{1}, positions_[2]);
+
+  Release(&scheduler, 0);
+  EXPECT_EQ((std::vector<size_t>{0, 1, 2}), admitted_);
+  EXPECT_EQ(0u, scheduler.queue_depth());
+
+  Release(&scheduler, 1);
+  Release(&scheduler, 2);
+  EXPECT_EQ(0u, scheduler.in_flight());
+}
+
+TEST_F(SyncSchedulerTest, AdmitsByPriority) {
+  SyncScheduler scheduler(message_loop_.task_runner(), 1);
+  Schedule(&scheduler, 0, SyncScheduler::Priority::BACKGROUND);
+  Schedule(&scheduler, 1, SyncScheduler::Priority::BACKGROUND);
+  Schedule(&scheduler, 2, SyncScheduler::Priority::PENDING_COMMITS);
+  Schedule(&scheduler, 3, SyncScheduler::Priority::ACTIVE);
+  Schedule(&scheduler, 4, SyncScheduler::Priority::BACKGROUND);
+  EXPECT_EQ(std::vector<size_t>{0}, admitted_);
+  EXPECT_EQ(1u, GetQueuePosition(&scheduler, 3));
+  EXPECT_EQ(2u, GetQueuePosition(&scheduler, 2));
+  EXPECT_EQ(3u, GetQueuePosition(&scheduler, 1));
+  EXPECT_EQ(4u, GetQueuePosition(&scheduler, 4));
+
+  for (size_t index : {0, 3, 2, 1}) {
+    Release(&scheduler, index);
+  }
+  EXPECT_EQ((std::vector<size_t>{0, 3, 2, 1, 4}), admitted_);
+}
+
+TEST_F(SyncSchedulerTest, NotifiesQueuePositions) {
+  SyncScheduler scheduler(message_loop_.task_runner(), 1);
+  Schedule(&scheduler, 0, SyncScheduler::Priority::ACTIVE);
+  Schedule(&scheduler, 1, SyncScheduler::Priority::BACKGROUND);
+  Schedule(&scheduler, 2, SyncScheduler::Priority::BACKGROUND);
+  Schedule(&scheduler, 3, SyncScheduler::Priority::ACTIVE);
+  EXPECT_TRUE(positions_[0].empty());
+  EXPECT_EQ(std::vector<size_t>{1}, positions_[1]);
+  EXPECT_EQ(std::vector<size_t>{2}, positions_[2]);
+  EXPECT_EQ(std::vector<size_t>{1}, positions_[3]);
+
+  // The other clients are notified once the queue settles.
+  EXPECT_TRUE(RunLoopUntil([this] { return positions_[2].size() == 2u; }));
+  EXPECT_EQ((std::vector<size_t>{1, 2}), positions_[1]);
+  EXPECT_EQ((std::vector<size_t>{2, 3}), positions_[2]);
+
+  // Removing a queued client moves the following ones forward.
+  Release(&scheduler, 1);
+  EXPECT_TRUE(RunLoopUntil([this] { return positions_[2].size() == 3u; }));
+  EXPECT_EQ((std::vector<size_t>{2, 3, 2}), positions_[2]);
+  EXPECT_EQ(std::vector<size_t>{1}, positions_[3]);
+
+  Release(&scheduler, 0);
+  EXPECT_EQ((std::vector<size_t>{0, 3}), admitted_);
+  EXPECT_TRUE(RunLoopUntil([this] { return positions_[2].size() == 4u; }));
+  EXPECT_EQ(1u, positions_[2].back());
+}
+
+TEST_F(SyncSchedulerTest, SpreadsRetries) {
+  const ftl::TimeDelta kInterval = ftl::TimeDelta::FromSeconds(1);
+  // Leeway for the time elapsed during the test.
+  const ftl::TimeDelta kLeeway = ftl::TimeDelta::FromMilliseconds(500);
+  SyncScheduler scheduler(message_loop_.task_runner(), 1, kInterval);
+
+  for (int i = 0; i < 3; ++i) {
+    ftl::TimeDelta delay = scheduler.GetRetryDelay(ftl::TimeDelta::Zero());
+    EXPECT_GE(delay, kInterval * i - kLeeway);
+    EXPECT_LT(delay, kInterval * (i + 1));
+  }
+
+  // Retries that are already far apart are not delayed further.
+  ftl::TimeDelta delay =
+      scheduler.GetRetryDelay(ftl::TimeDelta::FromSeconds(10));
+  EXPECT_GE(delay, ftl::TimeDelta::FromSeconds(10));
+  EXPECT_LT(delay, ftl::TimeDelta::FromSeconds(11));
+}
+
+}  // namespace
+}  // namespace cloud_sync
@@ -29,6 +29,9 @@ UserSyncImpl::UserSyncImpl(ledger::Environment* environment,
                            ftl::Closure on_version_mismatch)
     : environment_(environment),
       user_config_(std::move(user_config)),
+      download_scheduler_(user_config_.max_concurrent_downloads),
+      sync_scheduler_(environment_->main_runner(),
+                      user_config_.max_concurrent_page_syncs),
       backoff_(std::move(backoff)),
       on_version_mismatch_(std::move(on_version_mismatch)),
       aggregator_(watcher),
@@ -45,7 +48,9 @@ std::unique_ptr<LedgerSync> UserSyncImpl::CreateLedgerSync(
   FTL_DCHECK(started_);
 
   auto result = std::make_unique<LedgerSyncImpl>(
-      environment_, &user_config_, app_id, aggregator_.GetNewStateWatcher());
+      environment_, &user_config_, &download_scheduler_, &sync_scheduler_,
+      app_id,
+      aggregator_.GetNewStateWatcher());
   result->set_on_delete([ this, ledger_sync = result.get() ]() {
     active_ledger_syncs_.erase(ledger_sync);
   });
@@ -14,7 +14,9 @@
 #include "apps/ledger/src/callback/cancellable.h"
 #include "apps/ledger/src/cloud_sync/impl/aggregator.h"
 #include "apps/ledger/src/cloud_sync/impl/cloud_device_set_impl.h"
+#include "apps/ledger/src/cloud_sync/impl/download_scheduler.h"
 #include "apps/ledger/src/cloud_sync/impl/ledger_sync_impl.h"
+#include "apps/ledger/src/cloud_sync/impl/sync_scheduler.h"
 #include "apps/ledger/src/environment/environment.h"
 #include "apps/ledger/src/firebase/firebase.h"
 #include "lib/ftl/memory/weak_ptr.h"
@@ -58,6 +60,10 @@ class UserSyncImpl : public UserSync {
 
   ledger::Environment* environment_;
   const UserConfig user_config_;
+  // Schedules the object downloads of all the pages of the user.
+  DownloadScheduler download_scheduler_;
+  // Schedules the sync of all the pages of the user.
+  SyncScheduler sync_scheduler_;
   std::unique_ptr<backoff::Backoff> backoff_;
   ftl::Closure on_version_mismatch_;
 
@@ -0,0 +1,395 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/watch_multiplexer.h"
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <utility>
+
+#include "apps/ledger/src/cloud_provider/impl/encoding.h"
+#include "apps/ledger/src/cloud_provider/impl/timestamp_conversions.h"
+#include "apps/ledger/src/firebase/encoding.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/split_string.h"
+
+namespace cloud_sync {
+
+namespace {
+// Key under which the commits of a page are stored.
+constexpr char kCommitsKey[] = "commits";
+}  // namespace
+
+struct WatchMultiplexer::PageWatch {
+  uint64_t registration_id;
+  cloud_provider::CommitWatcher* watcher;
+  cloud_provider::CloudProvider* cloud_provider;
+  // Commits older than this timestamp are not delivered to |watcher|. Updated
+  // to the timestamp of each batch delivered.
+  std::string min_timestamp;
+  // Whether the commits added before the registration are being retrieved.
+  // The commits received in the meantime are held in |held_records|.
+  bool catching_up = false;
+  std::vector<cloud_provider::Record> held_records;
+  cloud_provider::RecordBatcher batcher;
+};
+
+WatchMultiplexer::WatchMultiplexer(ftl::RefPtr<ftl::TaskRunner> task_runner,
+                                   firebase::Firebase* firebase,
+                                   std::string key,
+                                   AuthProvider* auth_provider,
+                                   std::unique_ptr<backoff::Backoff> backoff)
+    : task_runner_(std::move(task_runner)),
+      firebase_(firebase),
+      key_(std::move(key)),
+      auth_provider_(auth_provider),
+      backoff_(std::move(backoff)),
+      weak_factory_(this) {
+  FTL_DCHECK(firebase_);
+  FTL_DCHECK(auth_provider_);
+}
+
+WatchMultiplexer::~WatchMultiplexer() {
+  FTL_DCHECK(pages_.empty());
+  Disconnect();
+}
+
+void WatchMultiplexer::WatchCommits(
+    convert::ExtendedStringView page_id,
+    const std::string& min_timestamp,
+    cloud_provider::CloudProvider* cloud_provider,
+    cloud_provider::CommitWatcher* watcher) {
+  std::string page_key = firebase::EncodeKey(page_id);
+  FTL_DCHECK(pages_.find(page_key) == pages_.end());
+
+  auto page_watch = std::make_unique<PageWatch>();
+  page_watch->registration_id = next_registration_id_++;
+  page_watch->watcher = watcher;
+  page_watch->cloud_provider = cloud_provider;
+  page_watch->min_timestamp = min_timestamp;
+  PageWatch* page_watch_ptr = page_watch.get();
+  pages_[page_key] = std::move(page_watch);
+
+  switch (state_) {
+    case State::IDLE:
+      Connect();
+      break;
+    case State::WAITING_TO_RECONNECT:
+    case State::CONNECTING:
+      // The current data of the page will be received once the stream is
+      // established.
+      break;
+    case State::CONNECTED:
+      CatchUp(page_key, page_watch_ptr);
+      break;
+  }
+}
+
+void WatchMultiplexer::UnwatchCommits(cloud_provider::CommitWatcher* watcher) {
+  auto it = std::find_if(pages_.begin(), pages_.end(),
+                         [watcher](const auto& entry) {
+                           return entry.second->watcher == watcher;
+                         });
+  if (it == pages_.end()) {
+    return;
+  }
+  pages_.erase(it);
+  if (pages_.empty()) {
+    Disconnect();
+  }
+}
+
+void WatchMultiplexer::OnPut(const std::string& path,
+                             const rapidjson::Value& value) {
+  Handle(path, value);
+}
+
+void WatchMultiplexer::OnPatch(const std::string& path,
+                               const rapidjson::Value& value) {
+  Handle(path, value);
+}
+
+void WatchMultiplexer::OnCancel() {
+  Reconnect("Firebase cancelled the watch request.");
+}
+
+void WatchMultiplexer::OnAuthRevoked(const std::string& reason) {
+  FTL_LOG(INFO) << "Remote watcher needs a new token: " << reason;
+  auth_provider_->InvalidateFirebaseToken(auth_token_);
+  Reconnect("Firebase token expired.");
+}
+
+void WatchMultiplexer::OnMalformedEvent() {
+  // Firebase already prints out debug info before calling here.
+  Reconnect("Received a malformed event.");
+}
+
+void WatchMultiplexer::OnConnectionError() {
+  // Firebase already prints out debug info before calling here.
+  Reconnect("Connection error in the remote commit watcher.");
+}
+
+void WatchMultiplexer::Connect() {
+  state_ = State::CONNECTING;
+  uint64_t connection_id = ++connection_id_;
+  auto request = auth_provider_->GetFirebaseToken(
+      [this, connection_id](AuthStatus auth_status, std::string auth_token) {
+        if (connection_id != connection_id_ || state_ != State::CONNECTING) {
+          return;
+        }
+        if (auth_status != AuthStatus::OK) {
+          Reconnect("Failed to retrieve the auth token.");
+          return;
+        }
+        auth_token_ = std::move(auth_token);
+        std::vector<std::string> query_params;
+        if (!auth_token_.empty()) {
+          query_params.push_back("auth=" + auth_token_);
+        }
+        firebase_->Watch(key_, query_params, this);
+      });
+  auth_token_requests_.emplace(request);
+}
+
+void WatchMultiplexer::Disconnect() {
+  if (state_ == State::CONNECTING || state_ == State::CONNECTED) {
+    firebase_->UnWatch(this);
+  }
+  state_ = State::IDLE;
+  ++connection_id_;
+  auth_token_.clear();
+}
+
+void WatchMultiplexer::Reconnect(const char reason[]) {
+  FTL_LOG(WARNING) << reason << " Re-establishing the shared cloud watcher.";
+  Disconnect();
+  // The pending batches are received again once the stream is re-established.
+  for (auto& entry : pages_) {
+    entry.second->batcher.Reset();
+  }
+  if (pages_.empty()) {
+    return;
+  }
+
+  state_ = State::WAITING_TO_RECONNECT;
+  task_runner_->PostDelayedTask(
+      [ weak_this = weak_factory_.GetWeakPtr(),
+        connection_id = connection_id_ ] {
+        if (weak_this && weak_this->connection_id_ == connection_id &&
+            weak_this->state_ == State::WAITING_TO_RECONNECT) {
+          weak_this->Connect();
+        }
+      },
+      backoff_->GetNext());
+}
+
+void WatchMultiplexer::Handle(const std::string& path,
+                              const rapidjson::Value& value) {
+  if (state_ != State::CONNECTING && state_ != State::CONNECTED) {
+    return;
+  }
+
+  if (path.empty() || path.front() != '/') {
+    FTL_LOG(ERROR) << "Received a notification with an invalid path: " << path;
+    Reconnect("Received a malformed notification.");
+    return;
+  }
+
+  if (path == "/") {
+    // The first event after setting up the watcher carries the current data
+    // of all the pages, null if there is none.
+    if (state_ == State::CONNECTING) {
+      state_ = State::CONNECTED;
+      backoff_->Reset();
+      FTL_LOG(INFO) << "Shared cloud watcher established";
+    }
+    if (value.IsNull()) {
+      return;
+    }
+    if (!value.IsObject()) {
+      Reconnect("Received data that is not a dictionary.");
+      return;
+    }
+    std::vector<ftl::StringView> sub_path;
+    for (auto it = value.MemberBegin(); it != value.MemberEnd(); ++it) {
+      HandlePageValue(it->name.GetString(), sub_path, it->value);
+      if (state_ != State::CONNECTED) {
+        return;
+      }
+    }
+    return;
+  }
+
+  std::vector<ftl::StringView> elements =
+      ftl::SplitString(ftl::StringView(path).substr(1), "/",
+                       ftl::WhiteSpaceHandling::kKeepWhitespace,
+                       ftl::SplitResult::kSplitWantAll);
+  std::string page_key = elements.front().ToString();
+  elements.erase(elements.begin());
+  HandlePageValue(page_key, elements, value);
+}
+
+void WatchMultiplexer::HandlePageValue(
+    const std::string& page_key,
+    const std::vector<ftl::StringView>& sub_path,
+    const rapidjson::Value& value) {
+  if (pages_.find(page_key) == pages_.end()) {
+    // Nobody is watching this page.
+    return;
+  }
+
+  if (value.IsNull()) {
+    return;
+  }
+
+  std::vector<cloud_provider::Record> records;
+  if (sub_path.empty()) {
+    // The notification carries all the data of the page.
+    if (!value.IsObject()) {
+      HandlePageError(page_key, "received data is not a dictionary");
+      return;
+    }
+    if (!value.HasMember(kCommitsKey)) {
+      return;
+    }
+    if (!cloud_provider::DecodeMultipleCommitsFromValue(
+            value[kCommitsKey], &records)) {
+      HandlePageError(page_key, "failed to decode a collection of commits");
+      return;
+    }
+  } else if (sub_path[0] != kCommitsKey) {
+    // The notification is about other data of the page.
+    return;
+  } else if (sub_path.size() == 1) {
+    if (!cloud_provider::DecodeMultipleCommitsFromValue(value, &records)) {
+      HandlePageError(page_key, "failed to decode a collection of commits");
+      return;
+    }
+  } else if (sub_path.size() == 2) {
+    std::unique_ptr<cloud_provider::Record> record;
+    if (!cloud_provider::DecodeCommitFromValue(value, &record)) {
+      HandlePageError(page_key, "failed to decode the commit");
+      return;
+    }
+    records.push_back(std::move(*record));
+  } else {
+    // Commits are immutable, they are only added as a whole.
+    HandlePageError(page_key, "invalid path");
+    return;
+  }
+
+  ProcessRecords(page_key, std::move(records));
+}
+
+void WatchMultiplexer::CatchUp(const std::string& page_key,
+                               PageWatch* page_watch) {
+  page_watch->catching_up = true;
+  page_watch->cloud_provider->GetCommits(
+      auth_token_, page_watch->min_timestamp, 0u,
+      [
+        weak_this = weak_factory_.GetWeakPtr(), page_key,
+        registration_id = page_watch->registration_id
+      ](cloud_provider::Status status,
+        std::vector<cloud_provider::Record> records) {
+        if (weak_this) {
+          weak_this->OnCaughtUp(page_key, registration_id, status,
+                                std::move(records));
+        }
+      });
+}
+
+void WatchMultiplexer::OnCaughtUp(const std::string& page_key,
+                                  uint64_t registration_id,
+                                  cloud_provider::Status status,
+                                  std::vector<cloud_provider::Record> records) {
+  auto it = pages_.find(page_key);
+  if (it == pages_.end() || it->second->registration_id != registration_id) {
+    return;
+  }
+  PageWatch* page_watch = it->second.get();
+
+  if (status != cloud_provider::Status::OK) {
+    FTL_LOG(WARNING) << "Failed to retrieve the commits of a page added before "
+                     << "its registration: " << status;
+    cloud_provider::CommitWatcher* watcher = page_watch->watcher;
+    pages_.erase(it);
+    watcher->OnConnectionError();
+    if (pages_.empty()) {
+      Disconnect();
+    }
+    return;
+  }
+
+  // Deliver the retrieved commits, followed by the ones received in the
+  // meantime that were not retrieved.
+  std::set<std::string> retrieved_ids;
+  for (const auto& record : records) {
+    retrieved_ids.insert(record.commit.id);
+  }
+  for (auto& record : page_watch->held_records) {
+    if (retrieved_ids.count(record.commit.id) == 0) {
+      records.push_back(std::move(record));
+    }
+  }
+  page_watch->held_records.clear();
+  page_watch->catching_up = false;
+  ProcessRecords(page_key, std::move(records));
+}
+
+void WatchMultiplexer::ProcessRecords(
+    const std::string& page_key,
+    std::vector<cloud_provider::Record> records) {
+  auto it = pages_.find(page_key);
+  FTL_DCHECK(it != pages_.end());
+  PageWatch* page_watch = it->second.get();
+  if (page_watch->catching_up) {
+    std::move(records.begin(), records.end(),
+              std::back_inserter(page_watch->held_records));
+    return;
+  }
+
+  for (auto& record : records) {
+    if (!page_watch->min_timestamp.empty() &&
+        cloud_provider::BytesToServerTimestamp(record.timestamp) <
+            cloud_provider::BytesToServerTimestamp(
+                page_watch->min_timestamp)) {
+      // The commit was already delivered.
+      continue;
+    }
+
+    if (!page_watch->batcher.AddRecord(std::move(record))) {
+      HandlePageError(page_key, "inconsistent batch of commits");
+      return;
+    }
+    if (!page_watch->batcher.IsBatchComplete()) {
+      continue;
+    }
+
+    std::vector<cloud_provider::Record> batch = page_watch->batcher.TakeBatch();
+    page_watch->min_timestamp = batch.front().timestamp;
+    uint64_t registration_id = page_watch->registration_id;
+    page_watch->watcher->OnRemoteCommits(std::move(batch));
+    // The watcher might have been unregistered by the call.
+    it = pages_.find(page_key);
+    if (it == pages_.end() || it->second->registration_id != registration_id) {
+      return;
+    }
+  }
+}
+
+void WatchMultiplexer::HandlePageError(const std::string& page_key,
+                                       const char error_description[]) {
+  FTL_LOG(ERROR) << "Error processing received commits: " << error_description;
+  auto it = pages_.find(page_key);
+  FTL_DCHECK(it != pages_.end());
+  cloud_provider::CommitWatcher* watcher = it->second->watcher;
+  pages_.erase(it);
+  watcher->OnMalformedNotification();
+  if (pages_.empty()) {
+    Disconnect();
+  }
+}
+
+}  // namespace cloud_sync
@@ -0,0 +1,155 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_WATCH_MULTIPLEXER_H_
+#define APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_WATCH_MULTIPLEXER_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/backoff/backoff.h"
+#include "apps/ledger/src/callback/cancellable.h"
+#include "apps/ledger/src/cloud_provider/impl/record_batcher.h"
+#include "apps/ledger/src/cloud_provider/public/cloud_provider.h"
+#include "apps/ledger/src/cloud_provider/public/commit_watcher.h"
+#include "apps/ledger/src/cloud_provider/public/record.h"
+#include "apps/ledger/src/cloud_sync/public/auth_provider.h"
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/firebase/firebase.h"
+#include "apps/ledger/src/firebase/watch_client.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+#include <rapidjson/document.h>
+
+namespace cloud_sync {
+
+// Watches the remote commits of all the pages of a Ledger instance through a
+// single Firebase stream, and dispatches them to the commit watchers of the
+// pages.
+//
+// The stream is opened at the Firebase location holding the data of all the
+// pages, once the first watcher is registered, and closed when the last one
+// is unregistered. Each notification is routed to the watcher of the page
+// whose path it carries.
+//
+// Connection errors and token expiration are handled here, by reconnecting
+// with a single backoff: the watchers are not notified about them. Upon
+// reconnection, each watcher only receives the commits not older than the
+// last batch delivered to it.
+class WatchMultiplexer : public firebase::WatchClient {
+ public:
+  // |firebase| and |key| designate the Firebase location under which the data
+  // of each page is stored, under the key returned by firebase::EncodeKey().
+  WatchMultiplexer(ftl::RefPtr<ftl::TaskRunner> task_runner,
+                   firebase::Firebase* firebase,
+                   std::string key,
+                   AuthProvider* auth_provider,
+                   std::unique_ptr<backoff::Backoff> backoff);
+  ~WatchMultiplexer() override;
+
+  // Registers |watcher| to be notified about the commits of the page
+  // |page_id| not older than |min_timestamp|, with the same semantics as
+  // cloud_provider::CloudProvider::WatchCommits().
+  //
+  // If the stream is already established, the commits added before the
+  // registration are retrieved through |cloud_provider|, the cloud provider
+  // of the page. |watcher| is then notified about a connection error if they
+  // cannot be retrieved.
+  void WatchCommits(convert::ExtendedStringView page_id,
+                    const std::string& min_timestamp,
+                    cloud_provider::CloudProvider* cloud_provider,
+                    cloud_provider::CommitWatcher* watcher);
+
+  // Unregisters the given watcher. No methods on the watcher will be called
+  // after this returns.
+  void UnwatchCommits(cloud_provider::CommitWatcher* watcher);
+
+  // Returns true if the stream is established.
+  bool IsConnected() const { return state_ == State::CONNECTED; }
+
+  // firebase::WatchClient:
+  void OnPut(const std::string& path, const rapidjson::Value& value) override;
+  void OnPatch(const std::string& path, const rapidjson::Value& value) override;
+  void OnCancel() override;
+  void OnAuthRevoked(const std::string& reason) override;
+  void OnMalformedEvent() override;
+  void OnConnectionError() override;
+
+ private:
+  enum class State {
+    // No watcher is registered.
+    IDLE,
+    // The stream is interrupted, and will be re-established after a delay.
+    WAITING_TO_RECONNECT,
+    // The stream is being established.
+    CONNECTING,
+    // The stream is established and the current data was received.
+    CONNECTED,
+  };
+
+  struct PageWatch;
+
+  void Connect();
+  void Disconnect();
+  // Closes the stream and schedules its re-establishment.
+  void Reconnect(const char reason[]);
+
+  void Handle(const std::string& path, const rapidjson::Value& value);
+  // Handles a notification about the data of the page stored under
+  // |page_key|. |sub_path| is the path of the notification relative to the
+  // data of the page.
+  void HandlePageValue(const std::string& page_key,
+                       const std::vector<ftl::StringView>& sub_path,
+                       const rapidjson::Value& value);
+
+  // Retrieves the commits of the page added before its registration.
+  void CatchUp(const std::string& page_key, PageWatch* page_watch);
+  void OnCaughtUp(const std::string& page_key,
+                  uint64_t registration_id,
+                  cloud_provider::Status status,
+                  std::vector<cloud_provider::Record> records);
+
+  // Delivers the batches of |records| that are complete to the watcher of
+  // the page stored under |page_key|.
+  void ProcessRecords(const std::string& page_key,
+                      std::vector<cloud_provider::Record> records);
+
+  // Unregisters the watcher of the given page, and notifies it about a
+  // malformed notification.
+  void HandlePageError(const std::string& page_key,
+                       const char error_description[]);
+
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  firebase::Firebase* const firebase_;
+  const std::string key_;
+  AuthProvider* const auth_provider_;
+  const std::unique_ptr<backoff::Backoff> backoff_;
+
+  State state_ = State::IDLE;
+  // Incremented each time the stream is (re-)established, so that the
+  // callbacks of the previous attempts are ignored.
+  uint64_t connection_id_ = 0u;
+  // Auth token with which the current stream was established.
+  std::string auth_token_;
+  // Registered pages, indexed by the key under which their data is stored.
+  std::map<std::string, std::unique_ptr<PageWatch>> pages_;
+  uint64_t next_registration_id_ = 0u;
+
+  callback::CancellableContainer auth_token_requests_;
+
+  // This must be the last member of this class.
+  ftl::WeakPtrFactory<WatchMultiplexer> weak_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(WatchMultiplexer);
+};
+
+}  // namespace cloud_sync
+
+#endif  // APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_WATCH_MULTIPLEXER_H_
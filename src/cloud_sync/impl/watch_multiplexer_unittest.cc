@@ -0,0 +1,440 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/watch_multiplexer.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/backoff/test/test_backoff.h"
+#include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/cloud_provider/impl/cloud_provider_impl.h"
+#include "apps/ledger/src/cloud_provider/impl/encoding.h"
+#include "apps/ledger/src/cloud_provider/impl/timestamp_conversions.h"
+#include "apps/ledger/src/cloud_provider/test/cloud_provider_empty_impl.h"
+#include "apps/ledger/src/cloud_sync/test/test_auth_provider.h"
+#include "apps/ledger/src/firebase/encoding.h"
+#include "apps/ledger/src/firebase/firebase_impl.h"
+#include "apps/ledger/src/network/network_service_impl.h"
+#include "apps/ledger/src/test/cloud_server/fake_cloud_network_service.h"
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+
+#include <rapidjson/document.h>
+
+namespace cloud_sync {
+namespace {
+
+std::vector<cloud_provider::Commit> MakeCommits(
+    const std::vector<std::string>& ids) {
+  std::vector<cloud_provider::Commit> commits;
+  for (const auto& id : ids) {
+    commits.emplace_back(id, "content_" + id,
+                         std::map<cloud_provider::ObjectId,
+                                  cloud_provider::Data>{});
+  }
+  return commits;
+}
+
+// Returns the JSON representation of a batch of the given commits, as stored
+// by Firebase with the given server timestamp.
+std::string MakeCommitsJson(const std::vector<std::string>& ids,
+                            int64_t timestamp) {
+  std::string json;
+  EXPECT_TRUE(cloud_provider::EncodeCommits(MakeCommits(ids), &json));
+  const std::string placeholder = "{\".sv\":\"timestamp\"}";
+  const std::string timestamp_str = std::to_string(timestamp);
+  for (size_t pos = json.find(placeholder); pos != std::string::npos;
+       pos = json.find(placeholder, pos + timestamp_str.size())) {
+    json.replace(pos, placeholder.size(), timestamp_str);
+  }
+  return json;
+}
+
+// Returns the JSON representation of the given commit, as stored by Firebase
+// with the given server timestamp.
+std::string MakeCommitJson(const std::string& id, int64_t timestamp) {
+  std::string json = MakeCommitsJson({id}, timestamp);
+  // Strip the enclosing dictionary and the key of the commit.
+  size_t start = json.find(':') + 1;
+  return json.substr(start, json.size() - start - 1);
+}
+
+// Returns the JSON representation of the union of the two given dictionaries.
+std::string MergeJson(const std::string& json1, const std::string& json2) {
+  return json1.substr(0, json1.size() - 1) + "," + json2.substr(1);
+}
+
+class TestCommitWatcher : public cloud_provider::CommitWatcher {
+ public:
+  TestCommitWatcher() {}
+  ~TestCommitWatcher() override {}
+
+  // cloud_provider::CommitWatcher:
+  void OnRemoteCommits(std::vector<cloud_provider::Record> records) override {
+    for (const auto& record : records) {
+      commit_ids.push_back(record.commit.id);
+    }
+    ++batch_count;
+  }
+
+  void OnConnectionError() override { ++connection_error_count; }
+
+  void OnTokenExpired() override { ++token_expired_count; }
+
+  void OnMalformedNotification() override { ++malformed_notification_count; }
+
+  std::vector<std::string> commit_ids;
+  int batch_count = 0;
+  int connection_error_count = 0;
+  int token_expired_count = 0;
+  int malformed_notification_count = 0;
+};
+
+class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
+ public:
+  TestCloudProvider() {}
+  ~TestCloudProvider() override {}
+
+  void GetCommits(const std::string& auth_token,
+                  const std::string& min_timestamp,
+                  size_t max_count,
+                  std::function<void(cloud_provider::Status,
+                                     std::vector<cloud_provider::Record>)>
+                      callback) override {
+    get_commits_min_timestamps.push_back(min_timestamp);
+    get_commits_callback = std::move(callback);
+  }
+
+  std::vector<std::string> get_commits_min_timestamps;
+  std::function<void(cloud_provider::Status,
+                     std::vector<cloud_provider::Record>)>
+      get_commits_callback;
+};
+
+class WatchMultiplexerTest : public ::test::TestWithMessageLoop,
+                             public firebase::Firebase {
+ public:
+  WatchMultiplexerTest()
+      : auth_provider_(message_loop_.task_runner()),
+        backoff_(new backoff::test::TestBackoff()),
+        multiplexer_(message_loop_.task_runner(),
+                     this,
+                     "app",
+                     &auth_provider_,
+                     std::unique_ptr<backoff::Backoff>(backoff_)) {
+    auth_provider_.token_to_return = "some-token";
+  }
+  ~WatchMultiplexerTest() override {}
+
+  // firebase::Firebase:
+  void Get(const std::string& /*key*/,
+           const std::vector<std::string>& /*query_params*/,
+           std::function<void(firebase::Status status,
+                              const rapidjson::Value& value)> /*callback*/)
+      override {
+    FAIL();
+  }
+
+  void GetStream(
+      const std::string& /*key*/,
+      const std::vector<std::string>& /*query_params*/,
+      std::function<void(firebase::Status status, mx::socket data)>
+      /*callback*/) override {
+    FAIL();
+  }
+
+  void Put(const std::string& /*key*/,
+           const std::vector<std::string>& /*query_params*/,
+           const std::string& /*data*/,
+           std::function<void(firebase::Status status)> /*callback*/) override {
+    FAIL();
+  }
+
+  void Patch(
+      const std::string& /*key*/,
+      const std::vector<std::string>& /*query_params*/,
+      const std::string& /*data*/,
+      std::function<void(firebase::Status status)> /*callback*/) override {
+    FAIL();
+  }
+
+  void Delete(
+      const std::string& /*key*/,
+      const std::vector<std::string>& /*query_params*/,
+      std::function<void(firebase::Status status)> /*callback*/) override {
+    FAIL();
+  }
+
+  void Watch(const std::string& key,
+             const std::vector<std::string>& query_params,
+             firebase::WatchClient* watch_client) override {
+    watch_keys_.push_back(key);
+    watch_queries_.push_back(query_params);
+    watch_client_ = watch_client;
+  }
+
+  void UnWatch(firebase::WatchClient* watch_client) override {
+    EXPECT_EQ(watch_client_, watch_client);
+    watch_client_ = nullptr;
+    ++unwatch_count_;
+  }
+
+ protected:
+  // Runs the loop until the multiplexer sets up its Firebase watcher.
+  bool RunUntilWatched() {
+    return RunLoopUntil([this] { return watch_client_ != nullptr; });
+  }
+
+  void SendPut(const std::string& path, const std::string& json) {
+    ASSERT_TRUE(watch_client_);
+    rapidjson::Document document;
+    document.Parse(json.c_str(), json.size());
+    ASSERT_FALSE(document.HasParseError());
+    watch_client_->OnPut(path, document);
+  }
+
+  void SendPatch(const std::string& path, const std::string& json) {
+    ASSERT_TRUE(watch_client_);
+    rapidjson::Document document;
+    document.Parse(json.c_str(), json.size());
+    ASSERT_FALSE(document.HasParseError());
+    watch_client_->OnPatch(path, document);
+  }
+
+  std::string PageKey(const std::string& page_id) {
+    return firebase::EncodeKey(page_id);
+  }
+
+  test::TestAuthProvider auth_provider_;
+  backoff::test::TestBackoff* backoff_;
+  TestCloudProvider cloud_provider_;
+  WatchMultiplexer multiplexer_;
+
+  std::vector<std::string> watch_keys_;
+  std::vector<std::vector<std::string>> watch_queries_;
+  firebase::WatchClient* watch_client_ = nullptr;
+  int unwatch_count_ = 0;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(WatchMultiplexerTest);
+};
+
+TEST_F(WatchMultiplexerTest, DispatchesInitialData) {
+  TestCommitWatcher watcher1;
+  TestCommitWatcher watcher2;
+  multiplexer_.WatchCommits("page1", "", &cloud_provider_, &watcher1);
+  multiplexer_.WatchCommits(
+      "page2", cloud_provider::ServerTimestampToBytes(50), &cloud_provider_,
+      &watcher2);
+  ASSERT_TRUE(RunUntilWatched());
+  EXPECT_EQ(std::vector<std::string>{"app"}, watch_keys_);
+  EXPECT_EQ(std::vector<std::string>{"auth=some-token"}, watch_queries_[0]);
+  EXPECT_FALSE(multiplexer_.IsConnected());
+
+  SendPut("/", "{\"" + PageKey("page1") + "\":{\"commits\":" +
+               MakeCommitsJson({"a"}, 42) + "},\"" + PageKey("page2") +
+               "\":{\"commits\":" + MakeCommitsJson({"b"}, 42) + "},\"" +
+               PageKey("page3") + "\":{\"commits\":" +
+               MakeCommitsJson({"c"}, 42) + "}}");
+  EXPECT_TRUE(multiplexer_.IsConnected());
+  EXPECT_EQ(1, backoff_->reset_count);
+
+  // The commit of page2 is older than its minimum timestamp, and nobody
+  // watches page3.
+  EXPECT_EQ(std::vector<std::string>{"a"}, watcher1.commit_ids);
+  EXPECT_TRUE(watcher2.commit_ids.empty());
+
+  multiplexer_.UnwatchCommits(&watcher1);
+  EXPECT_EQ(0, unwatch_count_);
+  multiplexer_.UnwatchCommits(&watcher2);
+  EXPECT_EQ(1, unwatch_count_);
+  EXPECT_FALSE(multiplexer_.IsConnected());
+}
+
+TEST_F(WatchMultiplexerTest, RoutesNotificationsByPath) {
+  TestCommitWatcher watcher1;
+  TestCommitWatcher watcher2;
+  multiplexer_.WatchCommits("page1", "", &cloud_provider_, &watcher1);
+  multiplexer_.WatchCommits("page2", "", &cloud_provider_, &watcher2);
+  ASSERT_TRUE(RunUntilWatched());
+  SendPut("/", "null");
+
+  SendPatch("/" + PageKey("page1") + "/commits",
+            MakeCommitsJson({"a", "b"}, 42));
+  SendPut("/" + PageKey("page2") + "/commits/" + firebase::EncodeKey("c"),
+          MakeCommitJson("c", 43));
+  SendPut("/" + PageKey("page2") + "/other", "{\"some\":\"data\"}");
+
+  EXPECT_EQ(2, watcher1.batch_count);
+  EXPECT_EQ(std::vector<std::string>({"a", "b"}), watcher1.commit_ids);
+  EXPECT_EQ(std::vector<std::string>{"c"}, watcher2.commit_ids);
+
+  multiplexer_.UnwatchCommits(&watcher1);
+  multiplexer_.UnwatchCommits(&watcher2);
+}
+
+TEST_F(WatchMultiplexerTest, MalformedPageData) {
+  TestCommitWatcher watcher1;
+  TestCommitWatcher watcher2;
+  multiplexer_.WatchCommits("page1", "", &cloud_provider_, &watcher1);
+  multiplexer_.WatchCommits("page2", "", &cloud_provider_, &watcher2);
+  ASSERT_TRUE(RunUntilWatched());
+  SendPut("/", "null");
+
+  // Only the watcher of the page is affected.
+  SendPatch("/" + PageKey("page1") + "/commits", "{\"a\":42}");
+  EXPECT_EQ(1, watcher1.malformed_notification_count);
+  SendPatch("/" + PageKey("page2") + "/commits", MakeCommitsJson({"b"}, 42));
+  EXPECT_EQ(std::vector<std::string>{"b"}, watcher2.commit_ids);
+  EXPECT_EQ(0, watcher2.malformed_notification_count);
+  EXPECT_TRUE(multiplexer_.IsConnected());
+
+  multiplexer_.UnwatchCommits(&watcher2);
+  EXPECT_EQ(1, unwatch_count_);
+}
+
+TEST_F(WatchMultiplexerTest, ReconnectsOnConnectionError) {
+  TestCommitWatcher watcher;
+  multiplexer_.WatchCommits("page", "", &cloud_provider_, &watcher);
+  ASSERT_TRUE(RunUntilWatched());
+  SendPut("/", "{\"" + PageKey("page") + "\":{\"commits\":" +
+               MakeCommitsJson({"a"}, 42) + "}}");
+  EXPECT_EQ(std::vector<std::string>{"a"}, watcher.commit_ids);
+
+  watch_client_->OnConnectionError();
+  EXPECT_EQ(1, unwatch_count_);
+  EXPECT_FALSE(multiplexer_.IsConnected());
+  ASSERT_TRUE(RunUntilWatched());
+  EXPECT_EQ(1, backoff_->get_next_count);
+  EXPECT_EQ(2u, watch_keys_.size());
+
+  // The commits already delivered are skipped on reconnection.
+  SendPut("/", "{\"" + PageKey("page") + "\":{\"commits\":" +
+                   MergeJson(MakeCommitsJson({"a"}, 42),
+                             MakeCommitsJson({"b"}, 43)) +
+                   "}}");
+  EXPECT_EQ(0, watcher.connection_error_count);
+  EXPECT_EQ(std::vector<std::string>({"a", "b"}), watcher.commit_ids);
+
+  multiplexer_.UnwatchCommits(&watcher);
+}
+
+TEST_F(WatchMultiplexerTest, CatchesUpWhenConnected) {
+  TestCommitWatcher watcher1;
+  multiplexer_.WatchCommits("page1", "", &cloud_provider_, &watcher1);
+  ASSERT_TRUE(RunUntilWatched());
+  SendPut("/", "null");
+
+  TestCommitWatcher watcher2;
+  multiplexer_.WatchCommits("page2", cloud_provider::ServerTimestampToBytes(40),
+                            &cloud_provider_, &watcher2);
+  ASSERT_TRUE(cloud_provider_.get_commits_callback);
+  EXPECT_EQ(
+      std::vector<std::string>{cloud_provider::ServerTimestampToBytes(40)},
+      cloud_provider_.get_commits_min_timestamps);
+
+  // Commits received while catching up are held.
+  SendPatch("/" + PageKey("page2") + "/commits", MakeCommitsJson({"b"}, 43));
+  EXPECT_TRUE(watcher2.commit_ids.empty());
+
+  std::vector<cloud_provider::Record> records;
+  records.emplace_back(
+      cloud_provider::Commit("a", "content_a",
+                             std::map<cloud_provider::ObjectId,
+                                      cloud_provider::Data>{}),
+      cloud_provider::ServerTimestampToBytes(42));
+  cloud_provider_.get_commits_callback(cloud_provider::Status::OK,
+                                       std::move(records));
+  EXPECT_EQ(std::vector<std::string>({"a", "b"}), watcher2.commit_ids);
+
+  multiplexer_.UnwatchCommits(&watcher1);
+  multiplexer_.UnwatchCommits(&watcher2);
+}
+
+TEST_F(WatchMultiplexerTest, CatchUpError) {
+  TestCommitWatcher watcher1;
+  multiplexer_.WatchCommits("page1", "", &cloud_provider_, &watcher1);
+  ASSERT_TRUE(RunUntilWatched());
+  SendPut("/", "null");
+
+  TestCommitWatcher watcher2;
+  multiplexer_.WatchCommits("page2", "", &cloud_provider_, &watcher2);
+  ASSERT_TRUE(cloud_provider_.get_commits_callback);
+  cloud_provider_.get_commits_callback(cloud_provider::Status::NETWORK_ERROR,
+                                       {});
+  EXPECT_EQ(1, watcher2.connection_error_count);
+  EXPECT_EQ(0, watcher1.connection_error_count);
+  EXPECT_TRUE(multiplexer_.IsConnected());
+
+  multiplexer_.UnwatchCommits(&watcher1);
+}
+
+// Verifies the multiplexer against the fake Firebase server, as the pages
+// synced by LedgerSyncImpl use it.
+class WatchMultiplexerServerTest : public ::test::TestWithMessageLoop {
+ public:
+  WatchMultiplexerServerTest()
+      : network_service_(message_loop_.task_runner(),
+                         [this] {
+                           network::NetworkServicePtr result;
+                           fake_network_service_.AddBinding(
+                               result.NewRequest());
+                           return result;
+                         }),
+        auth_provider_(message_loop_.task_runner()) {}
+  ~WatchMultiplexerServerTest() override {}
+
+ protected:
+  ledger::FakeCloudNetworkService fake_network_service_;
+  ledger::NetworkServiceImpl network_service_;
+  test::TestAuthProvider auth_provider_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(WatchMultiplexerServerTest);
+};
+
+TEST_F(WatchMultiplexerServerTest, WatchesAllPages) {
+  firebase::FirebaseImpl user_firebase(&network_service_, "server", "user");
+  firebase::FirebaseImpl page1_firebase(
+      &network_service_, "server", "user/app/" + firebase::EncodeKey("p1"));
+  firebase::FirebaseImpl page2_firebase(
+      &network_service_, "server", "user/app/" + firebase::EncodeKey("p2"));
+  cloud_provider::CloudProviderImpl page1_provider(&page1_firebase, nullptr);
+  cloud_provider::CloudProviderImpl page2_provider(&page2_firebase, nullptr);
+
+  cloud_provider::Status status;
+  page1_provider.AddCommits(
+      "", MakeCommits({"a"}),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(cloud_provider::Status::OK, status);
+
+  WatchMultiplexer multiplexer(message_loop_.task_runner(), &user_firebase,
+                               "app", &auth_provider_,
+                               std::make_unique<backoff::test::TestBackoff>());
+  TestCommitWatcher watcher1;
+  TestCommitWatcher watcher2;
+  multiplexer.WatchCommits("p1", "", &page1_provider, &watcher1);
+  multiplexer.WatchCommits("p2", "", &page2_provider, &watcher2);
+  EXPECT_TRUE(RunLoopUntil([&watcher1] { return watcher1.batch_count == 1; }));
+  EXPECT_EQ(std::vector<std::string>{"a"}, watcher1.commit_ids);
+  EXPECT_TRUE(watcher2.commit_ids.empty());
+
+  page2_provider.AddCommits("", MakeCommits({"b", "c"}),
+                            [](cloud_provider::Status status) {
+                              EXPECT_EQ(cloud_provider::Status::OK, status);
+                            });
+  EXPECT_TRUE(RunLoopUntil([&watcher2] { return watcher2.batch_count == 1; }));
+  EXPECT_EQ(std::vector<std::string>({"b", "c"}), watcher2.commit_ids);
+  EXPECT_EQ(std::vector<std::string>{"a"}, watcher1.commit_ids);
+
+  multiplexer.UnwatchCommits(&watcher1);
+  multiplexer.UnwatchCommits(&watcher2);
+}
+
+}  // namespace
+}  // namespace cloud_sync
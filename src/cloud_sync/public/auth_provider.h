@@ -32,6 +32,11 @@ class AuthProvider {
   virtual ftl::RefPtr<callback::Cancellable> GetFirebaseToken(
       std::function<void(AuthStatus, std::string)> callback) = 0;
 
+  // Notifies that |firebase_token|, previously returned by
+  // GetFirebaseToken(), was rejected by the server as expired. The next calls
+  // to GetFirebaseToken() return a new token.
+  virtual void InvalidateFirebaseToken(const std::string& firebase_token) = 0;
+
   // Retrieves the Firebase user ID of the user.
   virtual ftl::RefPtr<callback::Cancellable> GetFirebaseUserId(
       std::function<void(AuthStatus, std::string)> callback) = 0;
@@ -41,6 +41,20 @@ class LedgerSync {
       storage::PageStorage* page_storage,
       ftl::Closure error_callback) = 0;
 
+  // Creates a new page sync along with its context for a page that no client
+  // is connected to, so that the page stays up to date while it is closed. Such
+  // page syncs catch up with the cloud after the ones of the open pages.
+  //
+  // The provided |error_callback| is called when sync is stopped due to an
+  // unrecoverable error.
+  virtual std::unique_ptr<PageSyncContext> CreateBackgroundPageContext(
+      storage::PageStorage* page_storage,
+      ftl::Closure error_callback) = 0;
+
+  // Returns the maximum number of recently used pages that keep syncing in the
+  // background once closed.
+  virtual size_t GetMaxBackgroundSyncedPages() = 0;
+
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(LedgerSync);
 };
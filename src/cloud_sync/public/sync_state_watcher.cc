@@ -20,6 +20,10 @@ void SyncStateWatcher::SyncStateContainer::Merge(SyncStateContainer other) {
   if (other.upload > this->upload) {
     upload = other.upload;
   }
+  if (other.queue_position != 0u &&
+      (queue_position == 0u || other.queue_position < queue_position)) {
+    queue_position = other.queue_position;
+  }
 }
 
 void SyncStateWatcher::Notify(DownloadSyncState download,
@@ -29,7 +33,8 @@ void SyncStateWatcher::Notify(DownloadSyncState download,
 
 bool operator==(const SyncStateWatcher::SyncStateContainer& lhs,
                 const SyncStateWatcher::SyncStateContainer& rhs) {
-  return lhs.download == rhs.download && lhs.upload == rhs.upload;
+  return lhs.download == rhs.download && lhs.upload == rhs.upload &&
+         lhs.queue_position == rhs.queue_position;
 }
 
 bool operator!=(const SyncStateWatcher::SyncStateContainer& lhs,
@@ -5,6 +5,8 @@
 #ifndef APPS_LEDGER_SRC_CLOUD_SYNC_PUBLIC_SYNC_STATE_WATCHER_H_
 #define APPS_LEDGER_SRC_CLOUD_SYNC_PUBLIC_SYNC_STATE_WATCHER_H_
 
+#include <stddef.h>
+
 namespace cloud_sync {
 // Detail of the download part of the synchronization state.
 enum DownloadSyncState {
@@ -33,6 +35,9 @@ class SyncStateWatcher {
   struct SyncStateContainer {
     DownloadSyncState download = DOWNLOAD_IDLE;
     UploadSyncState upload = UPLOAD_IDLE;
+    // Position in the queue of the pages waiting to sync, starting at 1, or 0
+    // if not waiting. Merging keeps the position closest to the front.
+    size_t queue_position = 0u;
 
     SyncStateContainer(DownloadSyncState download, UploadSyncState upload);
     SyncStateContainer();
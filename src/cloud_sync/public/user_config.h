@@ -25,6 +25,33 @@ struct UserConfig {
   AuthProvider* auth_provider;
   // Guard which checks that the cloud was not erased since the previous sync.
   std::unique_ptr<CloudDeviceSet> cloud_device_set;
+  // Maximum number of object downloads running at the same time, across all
+  // the pages of the user.
+  size_t max_concurrent_downloads = 10;
+  // Maximum number of pages catching up with the cloud at the same time,
+  // across all the pages of the user.
+  size_t max_concurrent_page_syncs = 10;
+  // Maximum number of recently used pages of each Ledger instance that keep
+  // syncing in the background once no client is connected to them, so that
+  // they are up to date when reopened.
+  size_t max_background_synced_pages = 5;
+  // Whether the small objects of the uploaded commits are bundled in object
+  // packs. Devices running a version of Ledger that predates object packs
+  // cannot download such objects, so this must only be enabled once all the
+  // devices of the user can read them. Packed objects are downloaded in any
+  // case.
+  bool use_object_packs = false;
+  // Whether the uploaded objects and commits are compressed. Devices running a
+  // version of Ledger that predates compression cannot read the compressed
+  // commits, and read the compressed objects only if the server decompresses
+  // them, so this must only be enabled once all the devices of the user can
+  // read them. Compressed data is downloaded in any case.
+  bool use_compression = false;
+  // Whether the remote commits of all the pages of a Ledger instance are
+  // watched through a single stream, instead of one stream per synced page.
+  // The stream delivers the data of all the pages of the instance each time
+  // it is (re-)established, which only pays off with many synced pages.
+  bool use_multiplexed_watch = false;
 };
 
 }  // namespace cloud_sync
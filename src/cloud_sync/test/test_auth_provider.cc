@@ -25,6 +25,11 @@ ftl::RefPtr<callback::Cancellable> TestAuthProvider::GetFirebaseToken(
   return cancellable;
 }
 
+void TestAuthProvider::InvalidateFirebaseToken(
+    const std::string& firebase_token) {
+  invalidated_tokens.push_back(firebase_token);
+}
+
 ftl::RefPtr<callback::Cancellable> TestAuthProvider::GetFirebaseUserId(
     std::function<void(AuthStatus, std::string)> callback) {
   auto cancellable = callback::CancellableImpl::Create([] {});
@@ -5,6 +5,9 @@
 #ifndef APPS_LEDGER_SRC_CLOUD_SYNC_TEST_TEST_AUTH_PROVIDER_H_
 #define APPS_LEDGER_SRC_CLOUD_SYNC_TEST_TEST_AUTH_PROVIDER_H_
 
+#include <string>
+#include <vector>
+
 #include "apps/ledger/src/cloud_sync/public/auth_provider.h"
 
 #include "lib/ftl/tasks/task_runner.h"
@@ -20,6 +23,8 @@ class TestAuthProvider : public AuthProvider {
   ftl::RefPtr<callback::Cancellable> GetFirebaseToken(
       std::function<void(AuthStatus, std::string)> callback) override;
 
+  void InvalidateFirebaseToken(const std::string& firebase_token) override;
+
   ftl::RefPtr<callback::Cancellable> GetFirebaseUserId(
       std::function<void(AuthStatus, std::string)> callback) override;
 
@@ -29,6 +34,8 @@ class TestAuthProvider : public AuthProvider {
 
   std::string user_id_to_return;
 
+  std::vector<std::string> invalidated_tokens;
+
  private:
   ftl::RefPtr<ftl::TaskRunner> task_runner_;
 };
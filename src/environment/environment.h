@@ -15,6 +15,8 @@
 
 namespace ledger {
 
+class OperationRecorder;
+
 // Environment for the ledger application.
 class Environment {
  public:
@@ -30,9 +32,33 @@ class Environment {
   }
 
   // Returns a TaskRunner allowing to access the I/O thread. The I/O thread
-  // should be used to access the file system.
+  // should be used to access the file system, and for other blocking work that
+  // must not delay the main thread, such as compressing the synced data.
   const ftl::RefPtr<ftl::TaskRunner> GetIORunner();
 
+  // Returns the recorder of the operations made on the pages, or nullptr if
+  // they are not recorded.
+  OperationRecorder* operation_recorder() { return operation_recorder_; }
+  void SetOperationRecorder(OperationRecorder* operation_recorder) {
+    operation_recorder_ = operation_recorder;
+  }
+
+  // Whether the data uploaded to the cloud is compressed. See
+  // cloud_sync::UserConfig::use_compression.
+  bool sync_compression_enabled() { return sync_compression_enabled_; }
+  void SetSyncCompressionEnabled() { sync_compression_enabled_ = true; }
+
+  // Whether the small objects uploaded to the cloud are bundled in object
+  // packs. See cloud_sync::UserConfig::use_object_packs.
+  bool object_packs_enabled() { return object_packs_enabled_; }
+  void SetObjectPacksEnabled() { object_packs_enabled_ = true; }
+
+  // Whether the remote commits of all the pages of a Ledger instance are
+  // watched through a single stream. See
+  // cloud_sync::UserConfig::use_multiplexed_watch.
+  bool multiplexed_watch_enabled() { return multiplexed_watch_enabled_; }
+  void SetMultiplexedWatchEnabled() { multiplexed_watch_enabled_ = true; }
+
   // Flags only for testing.
   void SetTriggerCloudErasedForTesting();
 
@@ -48,6 +74,11 @@ class Environment {
   std::thread io_thread_;
   ftl::RefPtr<ftl::TaskRunner> io_runner_;
 
+  OperationRecorder* operation_recorder_ = nullptr;
+  bool sync_compression_enabled_ = false;
+  bool object_packs_enabled_ = false;
+  bool multiplexed_watch_enabled_ = false;
+
   // Flags only for testing.
   bool trigger_cloud_erased_for_testing_ = false;
 
@@ -4,50 +4,124 @@
 
 #include "apps/ledger/src/firebase/encoding.h"
 
-#include "apps/ledger/src/glue/crypto/base64.h"
+#include <stdint.h>
+
+#include "apps/ledger/src/third_party/modp_b64/modp_b64.h"
+#include "lib/ftl/logging.h"
 #include "lib/ftl/strings/utf_codecs.h"
 
 namespace firebase {
 
 namespace {
 
-// Returns true iff the given value can be put in Firebase without encoding.
-// Firebase requires the values to be valid UTF-8 JSON strings. JSON disallows
-// control characters in strings. We disallow backslash and double quote to
-// avoid reasoning about escaping. Note: this is a stop-gap solution, see
-// LE-118.
-bool CanValueBeVerbatim(ftl::StringView bytes) {
-  // Once encryption is in place this won't be useful. Until then, storing valid
-  // utf8 strings verbatim simplifies debugging.
-  if (!ftl::IsStringUTF8(bytes)) {
-    return false;
+// Classes of the bytes of a string put in Firebase.
+enum ByteClass : uint8_t {
+  // Allowed verbatim in both keys and values.
+  ALLOWED = 0,
+  // Not allowed in keys, but allowed in values. See
+  // https://firebase.google.com/docs/database/rest/structure-data.
+  ILLEGAL_IN_KEY = 1,
+  // Not allowed verbatim. Firebase requires the values to be valid UTF-8 JSON
+  // strings, and JSON disallows control characters in strings. We disallow
+  // backslash and double quote to avoid reasoning about escaping.
+  ILLEGAL = 2,
+  // First byte of a multi-byte UTF-8 sequence, or an invalid byte.
+  NON_ASCII = 3,
+};
+
+constexpr ByteClass GetByteClass(uint8_t byte) {
+  if (byte >= 0x80) {
+    return NON_ASCII;
+  }
+  if (byte <= 31 || byte == 127 || byte == '\"' || byte == '\\') {
+    return ILLEGAL;
+  }
+  switch (byte) {
+    case '.':
+    case '$':
+    case '#':
+    case '[':
+    case ']':
+    case '/':
+    case '+':
+      return ILLEGAL_IN_KEY;
+    default:
+      return ALLOWED;
+  }
+}
+
+struct ByteClassTable {
+  ByteClass classes[256];
+};
+
+constexpr ByteClassTable MakeByteClassTable() {
+  ByteClassTable table = {};
+  for (size_t i = 0; i < 256; ++i) {
+    table.classes[i] = GetByteClass(static_cast<uint8_t>(i));
   }
+  return table;
+}
 
-  for (const char& byte : bytes) {
-    if ((0 <= byte && byte <= 31) || byte == 127 || byte == '\"' ||
-        byte == '\\') {
+// Lookup table of the class of each byte, computed at compile time.
+constexpr ByteClassTable kByteClassTable = MakeByteClassTable();
+
+// Returns true iff the given bytes can be put in Firebase without encoding, in
+// a single pass over the data. Bytes of class |max_allowed_class| or lower are
+// accepted.
+//
+// Once encryption is in place this won't be useful. Until then, storing valid
+// utf8 strings verbatim simplifies debugging.
+bool CanBeVerbatim(ftl::StringView bytes, ByteClass max_allowed_class) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(bytes.data());
+  const size_t size = bytes.size();
+  size_t i = 0;
+  while (i < size) {
+    ByteClass byte_class = kByteClassTable.classes[data[i]];
+    if (byte_class <= max_allowed_class) {
+      ++i;
+      continue;
+    }
+    if (byte_class != NON_ASCII) {
+      return false;
+    }
+    // A multi-byte UTF-8 sequence only contains non-ASCII bytes, so the string
+    // is valid UTF-8 iff each of its runs of non-ASCII bytes is.
+    size_t run_start = i;
+    while (i < size && data[i] >= 0x80) {
+      ++i;
+    }
+    if (!ftl::IsStringUTF8(bytes.substr(run_start, i - run_start))) {
       return false;
     }
   }
-
   return true;
 }
 
-// Characters that are not allowed to appear in a Firebase key (but may appear
-// in a value). See
-// https://firebase.google.com/docs/database/rest/structure-data.
-const char kIllegalKeyChars[] = ".$#[]/+";
+bool CanValueBeVerbatim(ftl::StringView bytes) {
+  return CanBeVerbatim(bytes, ILLEGAL_IN_KEY);
+}
 
-// Encodes the given bytes for storage in Firebase. We use the same encoding
-// function for both values and keys for simplicity, yielding values that can be
-// always safely used as either. Note: this is a stop-gap solution, see LE-118.
-std::string Encode(ftl::StringView s, bool verbatim) {
+// Appends the encoding of the given bytes for storage in Firebase to |output|.
+// We use the same encoding function for both values and keys for simplicity,
+// yielding values that can be always safely used as either.
+void AppendEncoded(ftl::StringView bytes, bool verbatim, std::string* output) {
   if (verbatim) {
-    return s.ToString() + "V";
+    output->reserve(output->size() + bytes.size() + 1);
+    output->append(bytes.data(), bytes.size());
+    output->push_back('V');
+    return;
   }
 
-  std::string encoded;
-  return glue::Base64UrlEncode(s) + "B";
+  // The bundled modp_b64 is configured with the base64url alphabet, so the
+  // result can be used as a Firebase key as is.
+  size_t offset = output->size();
+  size_t encoded_size = modp_b64_encode_strlen(bytes.size());
+  output->resize(offset + encoded_size + 1);
+  // modp_b64_encode() writes a final '\0', which is overwritten by the suffix.
+  size_t written =
+      modp_b64_encode(&(*output)[offset], bytes.data(), bytes.size());
+  FTL_DCHECK(written == encoded_size);
+  (*output)[offset + encoded_size] = 'B';
 }
 
 }  // namespace
@@ -55,23 +129,28 @@ std::string Encode(ftl::StringView s, bool verbatim) {
 // Returns true if the given value can be used as a Firebase key without
 // encoding.
 bool CanKeyBeVerbatim(ftl::StringView bytes) {
-  if (!CanValueBeVerbatim(bytes)) {
-    return false;
-  }
-
-  if (bytes.find_first_of(std::string(kIllegalKeyChars)) != std::string::npos) {
-    return false;
-  }
-
-  return true;
+  return CanBeVerbatim(bytes, ALLOWED);
 }
 
 std::string EncodeKey(convert::ExtendedStringView bytes) {
-  return Encode(bytes, CanKeyBeVerbatim(bytes));
+  std::string result;
+  AppendEncodedKey(bytes, &result);
+  return result;
 }
 
 std::string EncodeValue(convert::ExtendedStringView bytes) {
-  return Encode(bytes, CanValueBeVerbatim(bytes));
+  std::string result;
+  AppendEncodedValue(bytes, &result);
+  return result;
+}
+
+void AppendEncodedKey(convert::ExtendedStringView bytes, std::string* output) {
+  AppendEncoded(bytes, CanKeyBeVerbatim(bytes), output);
+}
+
+void AppendEncodedValue(convert::ExtendedStringView bytes,
+                        std::string* output) {
+  AppendEncoded(bytes, CanValueBeVerbatim(bytes), output);
 }
 
 bool Decode(convert::ExtendedStringView input, std::string* output) {
@@ -82,12 +161,19 @@ bool Decode(convert::ExtendedStringView input, std::string* output) {
   ftl::StringView data = input.substr(0, input.size() - 1);
 
   if (input.back() == 'V') {
-    *output = data.ToString();
+    output->assign(data.data(), data.size());
     return true;
   }
 
   if (input.back() == 'B') {
-    return glue::Base64UrlDecode(data, output);
+    output->resize(modp_b64_decode_len(data.size()));
+    size_t output_length =
+        modp_b64_decode(&(*output)[0], data.data(), data.size());
+    if (output_length == MODP_B64_ERROR) {
+      return false;
+    }
+    output->resize(output_length);
+    return true;
   }
 
   return false;
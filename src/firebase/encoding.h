@@ -15,24 +15,26 @@ namespace firebase {
 // encoding.
 bool CanKeyBeVerbatim(ftl::StringView bytes);
 
-// Warning: this is a naive solution which needs multiple passes and copies of
-// the data each time. To be optimized if we are going to use this in the target
-// implementation - see LE-118.
-
 // These methods encode the given bytes as a valid Firebase key / value.
 //
 // Strings that are already valid Firebase keys / values are encoded as:
 // "<original string>V" ("V" standing for "verbatim". This saves bytes (compared
 // to base64) and allows to make sense of the data upon manual inspection.
 //
-// Strings that are not valid Firebase keys / values are encoded as base64 with
-// slashes replaced with backslashes and "B" added at the end.
+// Strings that are not valid Firebase keys / values are encoded as base64url
+// with "B" added at the end.
 std::string EncodeKey(convert::ExtendedStringView bytes);
 std::string EncodeValue(convert::ExtendedStringView bytes);
 
+// Same as above, but appends the encoded bytes to |output|, allowing callers
+// building a larger string to avoid an intermediate copy.
+void AppendEncodedKey(convert::ExtendedStringView bytes, std::string* output);
+void AppendEncodedValue(convert::ExtendedStringView bytes,
+                        std::string* output);
+
 // Returns true iff the key or value was correctly decoded and stored in |out|.
 // We don't need separate methods for keys and values, as the decoding algorithm
-// is identical.
+// is identical. The content of |out| is unspecified if the decoding fails.
 bool Decode(convert::ExtendedStringView input, std::string* output);
 
 }  // namespace firebase
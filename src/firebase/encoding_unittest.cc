@@ -3,11 +3,13 @@
 // found in the LICENSE file.
 
 #include "apps/ledger/src/firebase/encoding.h"
+#include "apps/ledger/src/glue/crypto/base64.h"
 #include "apps/ledger/src/glue/crypto/rand.h"
 #include "gtest/gtest.h"
 #include "lib/ftl/strings/utf_codecs.h"
 
 #include <string>
+#include <vector>
 
 namespace firebase {
 namespace {
@@ -63,6 +65,26 @@ bool IsValidValue(const std::string s) {
   return true;
 }
 
+// Reference implementation of the encoding, checking each condition in a
+// separate pass.
+std::string ReferenceEncode(ftl::StringView bytes, bool is_key) {
+  bool verbatim = ftl::IsStringUTF8(bytes);
+  for (const char& byte : bytes) {
+    if ((0 <= byte && byte <= 31) || byte == 127 || byte == '\"' ||
+        byte == '\\') {
+      verbatim = false;
+    }
+  }
+  if (is_key &&
+      bytes.find_first_of(std::string(".$#[]/+")) != std::string::npos) {
+    verbatim = false;
+  }
+  if (verbatim) {
+    return bytes.ToString() + "V";
+  }
+  return glue::Base64UrlEncode(bytes) + "B";
+}
+
 TEST(EncodingTest, BackAndForth) {
   std::string s;
   std::string ret_key;
@@ -232,5 +254,51 @@ TEST(EncodingTest, ValidValues) {
   EXPECT_EQ(original, decoded);
 }
 
+TEST(EncodingTest, MatchesReferenceEncoding) {
+  std::vector<std::string> inputs = {
+      "", "abc", "abc/", "a.b", "$", "leśna łączka", "\xFF", "\xC5",
+      "\xC5\x9B", "ś\xFF", "a\xE2\x82\xAC" "b", "\xED\xA0\x80",
+      "\xEF\xBF\xBF", "ok\x7F", "tab\t", "\xC5 \x9B"};
+  for (size_t i = 0; i < 1000; ++i) {
+    // Pick the bytes among a small alphabet of special characters, so that
+    // all the cases are covered.
+    const char alphabet[] = "a/.\"\\\x01\x7F\xC5\x9B\xE2\x82\xAC\xFF";
+    std::string input;
+    size_t size = glue::RandUint64() % 8;
+    for (size_t j = 0; j < size; ++j) {
+      input.push_back(alphabet[glue::RandUint64() % (sizeof(alphabet) - 1)]);
+    }
+    inputs.push_back(input);
+  }
+
+  for (const auto& input : inputs) {
+    EXPECT_EQ(ReferenceEncode(input, true), EncodeKey(input));
+    EXPECT_EQ(ReferenceEncode(input, false), EncodeValue(input));
+    EXPECT_EQ(ReferenceEncode(input, true).back() == 'V',
+              CanKeyBeVerbatim(input));
+  }
+}
+
+TEST(EncodingTest, Append) {
+  std::string output = "prefix/";
+  AppendEncodedKey("abc", &output);
+  EXPECT_EQ("prefix/abcV", output);
+  AppendEncodedKey("abc/", &output);
+  EXPECT_EQ("prefix/abcVYWJjLw==B", output);
+  AppendEncodedValue("abc/", &output);
+  EXPECT_EQ("prefix/abcVYWJjLw==Babc/V", output);
+  AppendEncodedValue("\xFF", &output);
+  EXPECT_EQ("prefix/abcVYWJjLw==Babc/V_w==B", output);
+}
+
+TEST(EncodingTest, DecodeErrors) {
+  std::string output;
+  EXPECT_FALSE(Decode("", &output));
+  EXPECT_FALSE(Decode("abc", &output));
+  EXPECT_FALSE(Decode("a!c=B", &output));
+  EXPECT_TRUE(Decode("B", &output));
+  EXPECT_EQ("", output);
+}
+
 }  // namespace
 }  // namespace firebase
@@ -4,6 +4,8 @@
 
 #include "apps/ledger/src/firebase/event_stream.h"
 
+#include <string.h>
+
 #include <utility>
 
 #include "lib/ftl/logging.h"
@@ -29,15 +31,27 @@ void EventStream::OnDataAvailable(const void* data, size_t num_bytes) {
   const char* current = static_cast<const char*>(data);
   const char* const end = current + num_bytes;
   while (current < end) {
-    const char* newline = std::find(current, end, '\n');
-    pending_line_.append(current, newline - current);
-    current = newline;
-    if (newline != end) {
-      if (!ProcessLine(pending_line_))
+    const char* newline =
+        static_cast<const char*>(memchr(current, '\n', end - current));
+    if (!newline) {
+      pending_line_.append(current, end - current);
+      return;
+    }
+
+    ftl::StringView line(current, newline - current);
+    current = newline + 1;
+    if (pending_line_.empty()) {
+      if (!ProcessLine(line)) {
         return;
-      pending_line_.clear();
-      ++current;
+      }
+      continue;
+    }
+
+    pending_line_.append(line.data(), line.size());
+    if (!ProcessLine(pending_line_)) {
+      return;
     }
+    pending_line_.clear();
   }
 }
 
@@ -61,7 +75,7 @@ bool EventStream::ProcessLine(ftl::StringView line) {
     }
 
     if (destruction_sentinel_.DestructedWhile(
-            [this] { event_callback_(Status::OK, event_type_, data_); })) {
+            [this] { event_callback_(Status::OK, event_type_, &data_); })) {
       return false;
     }
     event_type_.clear();
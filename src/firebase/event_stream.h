@@ -18,9 +18,12 @@
 namespace firebase {
 
 // TODO(ppi): Use a client interface instead.
+//
+// |data| is only valid for the duration of the call. The callback may modify
+// it, e.g. to parse it in situ.
 using EventCallback = void(Status status,
                            const std::string& event,
-                           const std::string& data);
+                           std::string* data);
 using CompletionCallback = void();
 
 // Socket drainer that parses a stream of Server-Sent Events.
@@ -49,8 +52,11 @@ class EventStream : public mtl::SocketDrainer::Client {
   std::function<EventCallback> event_callback_;
   std::function<CompletionCallback> completion_callback_;
 
-  // Unprocessed part of the current line.
+  // Unprocessed part of the current line, if it spans multiple chunks of data.
+  // The lines received in a single chunk are processed in place.
   std::string pending_line_;
+  // Data of the current event. It is cleared without releasing its memory
+  // after each event, so that it is reused by the next one.
   std::string data_;
   std::string event_type_;
 
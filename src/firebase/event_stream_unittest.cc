@@ -5,8 +5,10 @@
 #include "apps/ledger/src/firebase/event_stream.h"
 
 #include <memory>
+#include <random>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "apps/ledger/src/glue/socket/socket_pair.h"
 #include "gtest/gtest.h"
@@ -25,15 +27,28 @@ class EventStreamTest : public ::testing::Test {
   // ApplicationTestBase:
   void SetUp() override {
     ::testing::Test::SetUp();
+    ResetStream();
+  }
+
+  void TearDown() override {
+    producer_socket_.reset();
+    ::testing::Test::TearDown();
+  }
+
+  // Replaces the event stream with a new one, and clears the recorded events.
+  void ResetStream() {
+    status_.clear();
+    events_.clear();
+    data_.clear();
     glue::SocketPair socket;
     producer_socket_ = std::move(socket.socket1);
     event_stream_ = std::make_unique<EventStream>();
     event_stream_->Start(std::move(socket.socket2),
                          [this](Status status, const std::string& event,
-                                const std::string& data) {
+                                std::string* data) {
                            status_.push_back(status);
                            events_.push_back(event);
-                           data_.push_back(data);
+                           data_.push_back(*data);
                            if (delete_on_event_) {
                              event_stream_.reset();
                            }
@@ -41,9 +56,24 @@ class EventStreamTest : public ::testing::Test {
                          []() {});
   }
 
-  void TearDown() override {
-    producer_socket_.reset();
-    ::testing::Test::TearDown();
+  // Feeds |data| to a new event stream, cut in chunks at random positions,
+  // and returns the received events and their data.
+  std::vector<std::pair<std::string, std::string>> FeedInRandomChunks(
+      const std::string& data,
+      std::mt19937* generator) {
+    ResetStream();
+    size_t position = 0;
+    while (position < data.size()) {
+      size_t size = 1 + (*generator)() % 32;
+      Feed(data.substr(position, size));
+      position += size;
+    }
+    Done();
+    std::vector<std::pair<std::string, std::string>> result;
+    for (size_t i = 0; i < events_.size(); ++i) {
+      result.emplace_back(events_[i], data_[i]);
+    }
+    return result;
   }
 
   void Feed(const std::string& data) {
@@ -189,5 +219,71 @@ TEST_F(EventStreamTest, DeleteOnEvent) {
   EXPECT_EQ("bazinga", data_[0]);
 }
 
+TEST_F(EventStreamTest, LineSpanningManyChunks) {
+  Feed("event: abc\ndata: ");
+  for (size_t i = 0; i < 100; ++i) {
+    Feed("x");
+  }
+  Feed("\n\nevent: cde\ndata: 42\n\n");
+  Done();
+
+  EXPECT_EQ(2u, status_.size());
+  EXPECT_EQ("abc", events_[0]);
+  EXPECT_EQ(std::string(100, 'x'), data_[0]);
+  EXPECT_EQ("cde", events_[1]);
+  EXPECT_EQ("42", data_[1]);
+}
+
+// Feeds streams of well-formed events cut at random positions, and verifies
+// that the events are the same as when the stream is fed at once.
+TEST_F(EventStreamTest, FuzzChunking) {
+  std::mt19937 generator(42);
+  const std::vector<std::string> lines = {
+      "event: put",
+      "event: patch",
+      "data: {\"path\":\"/\",\"data\":null}",
+      "data: 42",
+      "data:",
+      ": comment",
+      "unknown: field",
+      "data: a: b",
+  };
+  for (size_t i = 0; i < 100; ++i) {
+    std::string stream;
+    size_t line_count = generator() % 50;
+    for (size_t j = 0; j < line_count; ++j) {
+      stream += generator() % 4 == 0 ? "" : lines[generator() % lines.size()];
+      stream += "\n";
+    }
+    auto expected = FeedInRandomChunks(stream, &generator);
+    // Feed the stream at once.
+    ResetStream();
+    Feed(stream);
+    Done();
+    ASSERT_EQ(expected.size(), events_.size());
+    for (size_t j = 0; j < expected.size(); ++j) {
+      EXPECT_EQ(expected[j].first, events_[j]);
+      EXPECT_EQ(expected[j].second, data_[j]);
+    }
+  }
+}
+
+// Feeds streams of random bytes cut at random positions, and verifies that
+// the parser behaves consistently regardless of the chunking.
+TEST_F(EventStreamTest, FuzzRandomBytes) {
+  std::mt19937 generator(1337);
+  const char alphabet[] = "\n\n\n::  adeintv\0\xFF";
+  for (size_t i = 0; i < 20; ++i) {
+    std::string stream;
+    size_t size = generator() % 200;
+    for (size_t j = 0; j < size; ++j) {
+      stream.push_back(alphabet[generator() % (sizeof(alphabet) - 1)]);
+    }
+    auto first = FeedInRandomChunks(stream, &generator);
+    auto second = FeedInRandomChunks(stream, &generator);
+    EXPECT_EQ(first, second);
+  }
+}
+
 }  // namespace
 }  // namespace firebase
@@ -9,6 +9,8 @@
 #include <string>
 #include <vector>
 
+#include <mx/socket.h>
+
 #include "apps/ledger/src/firebase/status.h"
 #include "apps/ledger/src/firebase/watch_client.h"
 #include "lib/ftl/macros.h"
@@ -36,6 +38,14 @@ class Firebase {
       std::function<void(Status status, const rapidjson::Value& value)>
           callback) = 0;
 
+  // Retrieves the JSON representation of the data under the given path, like
+  // Get(), but hands it out as a stream rather than parsing it. This allows
+  // large responses to be processed as they are received.
+  virtual void GetStream(
+      const std::string& key,
+      const std::vector<std::string>& query_params,
+      std::function<void(Status status, mx::socket data)> callback) = 0;
+
   // Overwrites the data under the given path. Data needs to be a valid JSON
   // object or JSON primitive value.
   // https://firebase.google.com/docs/database/rest/save-data
@@ -103,6 +103,19 @@ void FirebaseImpl::Get(
   Request(BuildRequestUrl(key, query_params), "GET", "", request_callback);
 }
 
+void FirebaseImpl::GetStream(
+    const std::string& key,
+    const std::vector<std::string>& query_params,
+    std::function<void(Status status, mx::socket data)> callback) {
+  requests_.emplace(network_service_->Request(
+      MakeRequest(BuildRequestUrl(key, query_params), "GET", ""),
+      [ this, callback = std::move(callback) ](
+          network::URLResponsePtr response) {
+        OnStreamResponse(callback, std::move(response));
+      },
+      ledger::RequestPriority::NORMAL));
+}
+
 void FirebaseImpl::Put(const std::string& key,
                        const std::vector<std::string>& query_params,
                        const std::string& data,
@@ -146,7 +159,8 @@ void FirebaseImpl::Watch(const std::string& key,
       MakeRequest(BuildRequestUrl(key, query_params), "GET", "", true),
       [this, watch_client](network::URLResponsePtr response) {
         OnStream(watch_client, std::move(response));
-      }));
+      },
+      ledger::RequestPriority::NORMAL));
 }
 
 void FirebaseImpl::UnWatch(WatchClient* watch_client) {
@@ -190,16 +204,34 @@ void FirebaseImpl::Request(
       MakeRequest(url, method, message),
       [this, callback](network::URLResponsePtr response) {
         OnResponse(callback, std::move(response));
-      }));
+      },
+      ledger::RequestPriority::NORMAL));
 }
 
 void FirebaseImpl::OnResponse(
     const std::function<void(Status status, std::string response)>& callback,
     network::URLResponsePtr response) {
+  OnStreamResponse(
+      [this, callback](Status status, mx::socket data) {
+        if (status != Status::OK) {
+          callback(status, "");
+          return;
+        }
+        auto& drainer = drainers_.emplace();
+        drainer.Start(
+            std::move(data),
+            [callback](const std::string& body) { callback(Status::OK, body); });
+      },
+      std::move(response));
+}
+
+void FirebaseImpl::OnStreamResponse(
+    const std::function<void(Status status, mx::socket data)>& callback,
+    network::URLResponsePtr response) {
   if (response->error) {
     FTL_LOG(ERROR) << response->url << " error "
                    << response->error->description;
-    callback(Status::NETWORK_ERROR, "");
+    callback(Status::NETWORK_ERROR, mx::socket());
     return;
   }
 
@@ -213,16 +245,13 @@ void FirebaseImpl::OnResponse(
                     FTL_LOG(ERROR)
                         << url << " error " << status_line << ":" << std::endl
                         << body;
-                    callback(Status::SERVER_ERROR, "");
+                    callback(Status::SERVER_ERROR, mx::socket());
                   });
     return;
   }
 
   FTL_DCHECK(response->body->is_stream());
-  auto& drainer = drainers_.emplace();
-  drainer.Start(
-      std::move(response->body->get_stream()),
-      [callback](const std::string& body) { callback(Status::OK, body); });
+  callback(Status::OK, std::move(response->body->get_stream()));
 }
 
 void FirebaseImpl::OnStream(WatchClient* watch_client,
@@ -257,7 +286,7 @@ void FirebaseImpl::OnStream(WatchClient* watch_client,
   watch_data_[watch_client]->event_stream->Start(
       std::move(response->body->get_stream()),
       [this, watch_client](Status status, const std::string& event,
-                           const std::string& data) {
+                           std::string* data) {
         OnStreamEvent(watch_client, status, event, data);
       },
       [this, watch_client]() { OnStreamComplete(watch_client); });
@@ -272,12 +301,14 @@ void FirebaseImpl::OnStreamComplete(WatchClient* watch_client) {
 void FirebaseImpl::OnStreamEvent(WatchClient* watch_client,
                                  Status /*status*/,
                                  const std::string& event,
-                                 const std::string& payload) {
+                                 std::string* payload) {
   if (event == "put" || event == "patch") {
+    // Parse the payload in situ, avoiding copies of its strings. The payload
+    // is no longer readable afterwards, so it is not logged on errors.
     rapidjson::Document parsed_payload;
-    parsed_payload.Parse(payload.c_str(), payload.size());
+    parsed_payload.ParseInsitu(&(*payload)[0]);
     if (parsed_payload.HasParseError()) {
-      HandleMalformedEvent(watch_client, event, payload,
+      HandleMalformedEvent(watch_client, event, "",
                            "failed to parse the event payload");
       return;
     }
@@ -285,18 +316,18 @@ void FirebaseImpl::OnStreamEvent(WatchClient* watch_client,
     // Both 'put' and 'patch' events must carry a dictionary of "path" and
     // "data".
     if (!parsed_payload.IsObject()) {
-      HandleMalformedEvent(watch_client, event, payload,
+      HandleMalformedEvent(watch_client, event, "",
                            "event payload doesn't appear to be an object");
       return;
     }
     if (!parsed_payload.HasMember("path") ||
         !parsed_payload["path"].IsString()) {
-      HandleMalformedEvent(watch_client, event, payload,
+      HandleMalformedEvent(watch_client, event, "",
                            "event payload doesn't contain the `path` string");
       return;
     }
     if (!parsed_payload.HasMember("data")) {
-      HandleMalformedEvent(watch_client, event, payload,
+      HandleMalformedEvent(watch_client, event, "",
                            "event payload doesn't contain the `data` member");
       return;
     }
@@ -308,7 +339,7 @@ void FirebaseImpl::OnStreamEvent(WatchClient* watch_client,
       // In case of patch, data must be a dictionary itself.
       if (!parsed_payload["data"].IsObject()) {
         HandleMalformedEvent(
-            watch_client, event, payload,
+            watch_client, event, "",
             "event payload `data` member doesn't appear to be an object");
         return;
       }
@@ -323,20 +354,22 @@ void FirebaseImpl::OnStreamEvent(WatchClient* watch_client,
   } else if (event == "cancel") {
     watch_client->OnCancel();
   } else if (event == "auth_revoked") {
-    watch_client->OnAuthRevoked(payload);
+    watch_client->OnAuthRevoked(*payload);
   } else {
-    HandleMalformedEvent(watch_client, event, payload,
+    HandleMalformedEvent(watch_client, event, *payload,
                          "unrecognized event type");
   }
 }
 
 void FirebaseImpl::HandleMalformedEvent(WatchClient* watch_client,
                                         const std::string& event,
-                                        const std::string& payload,
+                                        ftl::StringView payload,
                                         const char error_description[]) {
   FTL_LOG(ERROR) << "Error processing a Firebase event: " << error_description;
   FTL_LOG(ERROR) << "Event: " << event;
-  FTL_LOG(ERROR) << "Data: " << payload;
+  if (!payload.empty()) {
+    FTL_LOG(ERROR) << "Data: " << payload;
+  }
   watch_client->OnMalformedEvent();
 }
 
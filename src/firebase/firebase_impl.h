@@ -18,6 +18,7 @@
 #include "apps/ledger/src/firebase/watch_client.h"
 #include "apps/ledger/src/glue/socket/socket_drainer_client.h"
 #include "apps/ledger/src/network/network_service.h"
+#include "lib/ftl/strings/string_view.h"
 
 #include <rapidjson/document.h>
 
@@ -42,6 +43,10 @@ class FirebaseImpl : public Firebase {
            const std::vector<std::string>& query_params,
            std::function<void(Status status, const rapidjson::Value& value)>
                callback) override;
+  void GetStream(
+      const std::string& key,
+      const std::vector<std::string>& query_params,
+      std::function<void(Status status, mx::socket data)> callback) override;
   void Put(const std::string& key,
            const std::vector<std::string>& query_params,
            const std::string& data,
@@ -77,18 +82,26 @@ class FirebaseImpl : public Firebase {
       const std::function<void(Status status, std::string response)>& callback,
       network::URLResponsePtr response);
 
+  // Hands out the body of the given response if the request succeeded.
+  void OnStreamResponse(
+      const std::function<void(Status status, mx::socket data)>& callback,
+      network::URLResponsePtr response);
+
   void OnStream(WatchClient* watch_client, network::URLResponsePtr response);
 
   void OnStreamComplete(WatchClient* watch_client);
 
+  // Parses |payload| in situ, modifying it.
   void OnStreamEvent(WatchClient* watch_client,
                      Status status,
                      const std::string& event,
-                     const std::string& payload);
+                     std::string* payload);
 
+  // Logs the error and notifies |watch_client|. |payload| is not logged if
+  // empty.
   void HandleMalformedEvent(WatchClient* watch_client,
                             const std::string& event,
-                            const std::string& payload,
+                            ftl::StringView payload,
                             const char error_description[]);
 
   ledger::NetworkService* const network_service_;
@@ -116,6 +116,43 @@ TEST_F(FirebaseImplTest, GetError) {
   EXPECT_FALSE(RunLoopWithTimeout());
 }
 
+TEST_F(FirebaseImplTest, GetStream) {
+  fake_network_service_.SetStringResponse("{\"key\":\"content\"}", 200);
+  Status status;
+  mx::socket data;
+  firebase_.GetStream("bazinga", {},
+                      [this, &status, &data](Status s, mx::socket d) {
+                        status = s;
+                        data = std::move(d);
+                        message_loop_.PostQuitTask();
+                      });
+
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  std::string content;
+  EXPECT_TRUE(mtl::BlockingCopyToString(std::move(data), &content));
+  EXPECT_EQ("{\"key\":\"content\"}", content);
+  EXPECT_EQ("https://example.firebaseio.com/pre/fix/bazinga.json",
+            fake_network_service_.GetRequest()->url);
+  EXPECT_EQ("GET", fake_network_service_.GetRequest()->method);
+}
+
+TEST_F(FirebaseImplTest, GetStreamError) {
+  fake_network_service_.SetStringResponse("\"content\"", 404);
+  Status status = Status::OK;
+  mx::socket data;
+  firebase_.GetStream("bazinga", {},
+                      [this, &status, &data](Status s, mx::socket d) {
+                        status = s;
+                        data = std::move(d);
+                        message_loop_.PostQuitTask();
+                      });
+
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::SERVER_ERROR, status);
+  EXPECT_FALSE(data);
+}
+
 TEST_F(FirebaseImplTest, GetWithSingleQueryParam) {
   fake_network_service_.SetStringResponse("content", 200);
   firebase_.Get("bazinga", {"orderBy=\"timestamp\""},
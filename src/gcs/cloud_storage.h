@@ -9,6 +9,7 @@
 #include <string>
 
 #include "apps/ledger/src/gcs/status.h"
+#include "apps/ledger/src/network/network_service.h"
 #include "lib/ftl/macros.h"
 #include "mx/socket.h"
 #include "mx/vmo.h"
@@ -25,9 +26,12 @@ class CloudStorage {
                             mx::vmo data,
                             std::function<void(Status)> callback) = 0;
 
+  // Downloads the object stored under |key|. |priority| is the priority of
+  // the network request.
   virtual void DownloadObject(
       std::string auth_token,
       const std::string& key,
+      ledger::RequestPriority priority,
       std::function<void(Status status, uint64_t size, mx::socket data)>
           callback) = 0;
 
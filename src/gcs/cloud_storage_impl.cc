@@ -6,9 +6,13 @@
 
 #include <fcntl.h>
 
+#include <algorithm>
 #include <string>
 
+#include "apps/ledger/src/glue/compression/gzip.h"
 #include "apps/ledger/src/glue/socket/socket_pair.h"
+#include "apps/ledger/src/glue/socket/socket_writer.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/fidl/cpp/bindings/array.h"
 #include "lib/ftl/files/eintr_wrapper.h"
 #include "lib/ftl/files/file.h"
@@ -23,6 +27,7 @@
 #include "lib/ftl/strings/string_view.h"
 #include "lib/mtl/socket/files.h"
 #include "lib/mtl/vmo/file.h"
+#include "lib/mtl/vmo/strings.h"
 
 namespace gcs {
 
@@ -30,6 +35,15 @@ namespace {
 
 const char kAuthorizationHeader[] = "authorization";
 const char kContentLengthHeader[] = "content-length";
+const char kContentEncodingHeader[] = "content-encoding";
+const char kAcceptEncodingHeader[] = "accept-encoding";
+const char kGzipEncoding[] = "gzip";
+
+// Objects smaller than this are not worth compressing.
+constexpr uint64_t kMinCompressedSize = 128u;
+
+// Size of the chunks in which objects are read when compressed.
+constexpr uint64_t kCompressionChunkSize = 64 * 1024;
 
 constexpr ftl::StringView kApiEndpoint =
     "https://firebasestorage.googleapis.com/v0/b/";
@@ -46,11 +60,16 @@ network::HttpHeaderPtr GetHeader(
   return nullptr;
 }
 
+network::HttpHeaderPtr MakeHeader(const std::string& name,
+                                  const std::string& value) {
+  network::HttpHeaderPtr header = network::HttpHeader::New();
+  header->name = name;
+  header->value = value;
+  return header;
+}
+
 network::HttpHeaderPtr MakeAuthorizationHeader(const std::string& auth_token) {
-  network::HttpHeaderPtr authorization_header = network::HttpHeader::New();
-  authorization_header->name = kAuthorizationHeader;
-  authorization_header->value = "Bearer " + auth_token;
-  return authorization_header;
+  return MakeHeader(kAuthorizationHeader, "Bearer " + auth_token);
 }
 
 void RunUploadObjectCallback(std::function<void(Status)> callback,
@@ -64,6 +83,42 @@ void RunUploadObjectCallback(std::function<void(Status)> callback,
   callback(status);
 }
 
+// Compresses |data|, of size |data_size|, one chunk at a time. Returns false,
+// possibly before compressing all of it, if |data| does not shrink.
+bool CompressVmo(const mx::vmo& data,
+                 uint64_t data_size,
+                 mx::vmo* compressed_data,
+                 uint64_t* compressed_size) {
+  TRACE_DURATION("ledger", "gcs_compress");
+  glue::GzipStream stream(glue::GzipStream::Mode::COMPRESS);
+  std::string chunk;
+  std::string compressed_content;
+  uint64_t offset = 0u;
+  while (offset < data_size) {
+    chunk.resize(std::min(kCompressionChunkSize, data_size - offset));
+    size_t read_size;
+    mx_status_t status = data.read(&chunk[0], offset, chunk.size(), &read_size);
+    if (status != MX_OK || read_size != chunk.size()) {
+      FTL_LOG(ERROR) << "Unable to read the vmo, uploading it uncompressed.";
+      return false;
+    }
+    offset += read_size;
+    if (!stream.Update(chunk, &compressed_content) ||
+        compressed_content.size() >= data_size) {
+      return false;
+    }
+  }
+  if (!stream.Finish(&compressed_content) ||
+      compressed_content.size() >= data_size) {
+    return false;
+  }
+  if (!mtl::VmoFromString(compressed_content, compressed_data)) {
+    return false;
+  }
+  *compressed_size = compressed_content.size();
+  return true;
+}
+
 std::string GetUrlPrefix(const std::string& firebase_id,
                          const std::string& cloud_prefix) {
   return ftl::Concatenate(
@@ -72,13 +127,17 @@ std::string GetUrlPrefix(const std::string& firebase_id,
 
 }  // namespace
 
-CloudStorageImpl::CloudStorageImpl(ftl::RefPtr<ftl::TaskRunner> task_runner,
-                                   ledger::NetworkService* network_service,
-                                   const std::string& firebase_id,
-                                   const std::string& cloud_prefix)
+CloudStorageImpl::CloudStorageImpl(
+    ftl::RefPtr<ftl::TaskRunner> task_runner,
+    ledger::NetworkService* network_service,
+    const std::string& firebase_id,
+    const std::string& cloud_prefix,
+    ftl::RefPtr<ftl::TaskRunner> compression_runner)
     : task_runner_(std::move(task_runner)),
       network_service_(network_service),
-      url_prefix_(GetUrlPrefix(firebase_id, cloud_prefix)) {}
+      url_prefix_(GetUrlPrefix(firebase_id, cloud_prefix)),
+      compression_runner_(std::move(compression_runner)),
+      weak_factory_(this) {}
 
 CloudStorageImpl::~CloudStorageImpl() {}
 
@@ -95,10 +154,55 @@ void CloudStorageImpl::UploadObject(std::string auth_token,
     callback(Status::INTERNAL_ERROR);
     return;
   }
+  uploaded_bytes_ += data_size;
+  if (!compression_runner_ || data_size < kMinCompressedSize) {
+    StartUpload(std::move(auth_token), std::move(url), std::move(data),
+                data_size, false, std::move(callback));
+    return;
+  }
+
+  // The object is uploaded once compressed, as the request needs to know
+  // whether it shrinks and its final size.
+  compression_runner_->PostTask(ftl::MakeCopyable([
+    task_runner = task_runner_, weak_this = weak_factory_.GetWeakPtr(),
+    auth_token = std::move(auth_token), url = std::move(url),
+    data = std::move(data), data_size, callback = std::move(callback)
+  ]() mutable {
+    mx::vmo compressed_data;
+    uint64_t compressed_size;
+    bool compressed =
+        CompressVmo(data, data_size, &compressed_data, &compressed_size);
+    if (compressed) {
+      data = std::move(compressed_data);
+      data_size = compressed_size;
+    }
+    task_runner->PostTask(ftl::MakeCopyable([
+      weak_this = std::move(weak_this), auth_token = std::move(auth_token),
+      url = std::move(url), data = std::move(data), data_size, compressed,
+      callback = std::move(callback)
+    ]() mutable {
+      if (weak_this) {
+        weak_this->StartUpload(std::move(auth_token), std::move(url),
+                               std::move(data), data_size, compressed,
+                               std::move(callback));
+      }
+    }));
+  }));
+}
+
+void CloudStorageImpl::StartUpload(std::string auth_token,
+                                   std::string url,
+                                   mx::vmo data,
+                                   uint64_t data_size,
+                                   bool compressed,
+                                   std::function<void(Status)> callback) {
+  sent_bytes_ += data_size;
+  TRACE_COUNTER("ledger", "gcs_upload", reinterpret_cast<uintptr_t>(this),
+                "object_bytes", uploaded_bytes_, "sent_bytes", sent_bytes_);
 
   auto request_factory = ftl::MakeCopyable([
     auth_token = std::move(auth_token), url = std::move(url),
-    task_runner = task_runner_, data = std::move(data), data_size
+    task_runner = task_runner_, data = std::move(data), data_size, compressed
   ] {
     network::URLRequestPtr request(network::URLRequest::New());
     request->url = url;
@@ -116,6 +220,11 @@ void CloudStorageImpl::UploadObject(std::string auth_token,
     content_length_header->value = ftl::NumberToString(data_size);
     request->headers.push_back(std::move(content_length_header));
 
+    if (compressed) {
+      request->headers.push_back(
+          MakeHeader(kContentEncodingHeader, kGzipEncoding));
+    }
+
     mx::vmo duplicated_data;
     data.duplicate(MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER | MX_RIGHT_READ,
                    &duplicated_data);
@@ -124,21 +233,26 @@ void CloudStorageImpl::UploadObject(std::string auth_token,
     return request;
   });
 
-  Request(std::move(request_factory), [callback = std::move(callback)](
-                                          Status status, network::URLResponsePtr
-                                                             response) mutable {
-    RunUploadObjectCallback(std::move(callback), status, std::move(response));
-  });
+  // Uploads are not waited on by the user: leave the room to other requests.
+  Request(std::move(request_factory), ledger::RequestPriority::BACKGROUND,
+          [callback = std::move(callback)](
+              Status status, network::URLResponsePtr response) mutable {
+            RunUploadObjectCallback(std::move(callback), status,
+                                    std::move(response));
+          });
 }
 
 void CloudStorageImpl::DownloadObject(
     std::string auth_token,
     const std::string& key,
+    ledger::RequestPriority priority,
     std::function<void(Status status, uint64_t size, mx::socket data)>
         callback) {
   std::string url = GetDownloadUrl(key);
 
-  Request([ auth_token = std::move(auth_token), url = std::move(url) ] {
+  auto request_factory = [
+    auth_token = std::move(auth_token), url = std::move(url)
+  ] {
     network::URLRequestPtr request(network::URLRequest::New());
     request->url = url;
     request->method = "GET";
@@ -146,13 +260,17 @@ void CloudStorageImpl::DownloadObject(
     if (!auth_token.empty()) {
       request->headers.push_back(MakeAuthorizationHeader(auth_token));
     }
+    request->headers.push_back(
+        MakeHeader(kAcceptEncodingHeader, kGzipEncoding));
     return request;
-  },
-          [ this, callback = std::move(callback) ](
-              Status status, network::URLResponsePtr response) mutable {
-            OnDownloadResponseReceived(std::move(callback), status,
-                                       std::move(response));
-          });
+  };
+
+  Request(std::move(request_factory), priority, [
+    this, callback = std::move(callback)
+  ](Status status, network::URLResponsePtr response) mutable {
+    OnDownloadResponseReceived(std::move(callback), status,
+                               std::move(response));
+  });
 }
 
 std::string CloudStorageImpl::GetDownloadUrl(ftl::StringView key) {
@@ -167,13 +285,16 @@ std::string CloudStorageImpl::GetUploadUrl(ftl::StringView key) {
 
 void CloudStorageImpl::Request(
     std::function<network::URLRequestPtr()> request_factory,
+    ledger::RequestPriority priority,
     std::function<void(Status status, network::URLResponsePtr response)>
         callback) {
-  requests_.emplace(network_service_->Request(std::move(request_factory), [
-    this, callback = std::move(callback)
-  ](network::URLResponsePtr response) mutable {
-    OnResponse(std::move(callback), std::move(response));
-  }));
+  requests_.emplace(network_service_->Request(
+      std::move(request_factory),
+      [ this, callback = std::move(callback) ](
+          network::URLResponsePtr response) mutable {
+        OnResponse(std::move(callback), std::move(response));
+      },
+      priority));
 }
 
 void CloudStorageImpl::OnResponse(
@@ -227,7 +348,53 @@ void CloudStorageImpl::OnDownloadResponseReceived(
 
   network::URLBodyPtr body = std::move(response->body);
   FTL_DCHECK(body->is_stream());
+  received_bytes_ += expected_file_size;
+
+  network::HttpHeaderPtr encoding_header =
+      GetHeader(response->headers, kContentEncodingHeader);
+  if (encoding_header) {
+    if (encoding_header->value.get() != kGzipEncoding) {
+      FTL_LOG(ERROR) << "Unsupported content encoding: "
+                     << encoding_header->value.get();
+      callback(Status::PARSE_ERROR, 0u, mx::socket());
+      return;
+    }
+    DecompressDownload(std::move(callback), std::move(body->get_stream()));
+    return;
+  }
+
+  downloaded_bytes_ += expected_file_size;
+  TRACE_COUNTER("ledger", "gcs_download", reinterpret_cast<uintptr_t>(this),
+                "received_bytes", received_bytes_, "object_bytes",
+                downloaded_bytes_);
   callback(Status::OK, expected_file_size, std::move(body->get_stream()));
 }
 
+void CloudStorageImpl::DecompressDownload(
+    std::function<void(Status status, uint64_t size, mx::socket data)>
+        callback,
+    mx::socket data) {
+  // The size of the decompressed object is only known once it is entirely
+  // received, so it is decompressed as it arrives and then handed out.
+  auto& drainer = drainers_.emplace();
+  drainer.Start(std::move(data), [ this, callback = std::move(callback) ](
+                                     bool success, std::string content) {
+    if (!success) {
+      FTL_LOG(ERROR) << "Unable to decompress the downloaded object.";
+      callback(Status::PARSE_ERROR, 0u, mx::socket());
+      return;
+    }
+    downloaded_bytes_ += content.size();
+    TRACE_COUNTER("ledger", "gcs_download", reinterpret_cast<uintptr_t>(this),
+                  "received_bytes", received_bytes_, "object_bytes",
+                  downloaded_bytes_);
+    uint64_t size = content.size();
+    glue::SocketPair socket_pair;
+    // StringSocketWriter deletes itself when done.
+    auto writer = new glue::StringSocketWriter();
+    writer->Start(std::move(content), std::move(socket_pair.socket2));
+    callback(Status::OK, size, std::move(socket_pair.socket1));
+  });
+}
+
 }  // namespace gcs
@@ -8,9 +8,12 @@
 #include <functional>
 #include <vector>
 
+#include "apps/ledger/src/callback/auto_cleanable.h"
 #include "apps/ledger/src/callback/cancellable.h"
 #include "apps/ledger/src/gcs/cloud_storage.h"
+#include "apps/ledger/src/glue/compression/gzip_socket_drainer.h"
 #include "apps/ledger/src/network/network_service.h"
+#include "lib/ftl/memory/weak_ptr.h"
 #include "lib/ftl/tasks/task_runner.h"
 #include "mx/socket.h"
 #include "mx/vmo.h"
@@ -19,12 +22,21 @@ namespace gcs {
 
 // Implementation of the CloudStorage interface that uses Firebase Storage as
 // the backend.
+//
+// If |compression_runner| is not null, objects that shrink when compressed are
+// uploaded gzip-compressed, with a gzip content encoding. They are compressed
+// on |compression_runner|, so that the thread of |task_runner| is not blocked
+// by the compression of large objects. Downloads accept the gzip content
+// encoding and decompress such objects, so that they are only decompressed on
+// the device. Clients that do not accept the gzip encoding are served the
+// decompressed objects by the server.
 class CloudStorageImpl : public CloudStorage {
  public:
   CloudStorageImpl(ftl::RefPtr<ftl::TaskRunner> task_runner,
                    ledger::NetworkService* network_service,
                    const std::string& firebase_id,
-                   const std::string& cloud_prefix);
+                   const std::string& cloud_prefix,
+                   ftl::RefPtr<ftl::TaskRunner> compression_runner = nullptr);
   ~CloudStorageImpl() override;
 
   // CloudStorage implementation.
@@ -36,6 +48,7 @@ class CloudStorageImpl : public CloudStorage {
   void DownloadObject(
       std::string auth_token,
       const std::string& key,
+      ledger::RequestPriority priority,
       std::function<void(Status status, uint64_t size, mx::socket data)>
           callback) override;
 
@@ -45,6 +58,7 @@ class CloudStorageImpl : public CloudStorage {
   std::string GetUploadUrl(ftl::StringView key);
 
   void Request(std::function<network::URLRequestPtr()> request_factory,
+               ledger::RequestPriority priority,
                std::function<void(Status status,
                                   network::URLResponsePtr response)> callback);
   void OnResponse(
@@ -58,10 +72,36 @@ class CloudStorageImpl : public CloudStorage {
       Status status,
       network::URLResponsePtr response);
 
+  // Uploads |data|, of size |data_size|. |compressed| indicates whether |data|
+  // is gzip-compressed.
+  void StartUpload(std::string auth_token,
+                   std::string url,
+                   mx::vmo data,
+                   uint64_t data_size,
+                   bool compressed,
+                   std::function<void(Status)> callback);
+
+  void DecompressDownload(
+      std::function<void(Status status, uint64_t size, mx::socket data)>
+          callback,
+      mx::socket data);
+
   ftl::RefPtr<ftl::TaskRunner> task_runner_;
   ledger::NetworkService* const network_service_;
   const std::string url_prefix_;
+  ftl::RefPtr<ftl::TaskRunner> compression_runner_;
   callback::CancellableContainer requests_;
+  callback::AutoCleanableSet<glue::GzipSocketDrainer> drainers_;
+
+  // Total size of the uploaded objects, before and after compression.
+  uint64_t uploaded_bytes_ = 0u;
+  uint64_t sent_bytes_ = 0u;
+  // Total size of the downloaded objects, before and after decompression.
+  uint64_t received_bytes_ = 0u;
+  uint64_t downloaded_bytes_ = 0u;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<CloudStorageImpl> weak_factory_;
 };
 
 }  // namespace gcs
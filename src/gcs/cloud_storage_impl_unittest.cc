@@ -6,19 +6,23 @@
 
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 
 #include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/glue/compression/gzip.h"
 #include "apps/ledger/src/network/fake_network_service.h"
 #include "apps/ledger/src/test/test_with_message_loop.h"
 #include "apps/network/services/network_service.fidl.h"
 #include "gtest/gtest.h"
 #include "lib/ftl/files/file.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/functional/auto_call.h"
 #include "lib/ftl/macros.h"
 #include "lib/ftl/strings/string_number_conversions.h"
 #include "lib/mtl/socket/strings.h"
 #include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/threading/create_thread.h"
 #include "lib/mtl/vmo/strings.h"
 
 namespace gcs {
@@ -35,6 +39,14 @@ network::HttpHeaderPtr GetHeader(
   return nullptr;
 }
 
+network::HttpHeaderPtr MakeHeader(const std::string& name,
+                                  const std::string& value) {
+  network::HttpHeaderPtr header = network::HttpHeader::New();
+  header->name = name;
+  header->value = value;
+  return header;
+}
+
 class CloudStorageImplTest : public test::TestWithMessageLoop {
  public:
   CloudStorageImplTest()
@@ -48,17 +60,19 @@ class CloudStorageImplTest : public test::TestWithMessageLoop {
  protected:
   void SetResponse(const std::string& body,
                    int64_t content_length,
-                   uint32_t status_code) {
+                   uint32_t status_code,
+                   const std::string& content_encoding = "") {
     network::URLResponsePtr server_response = network::URLResponse::New();
     server_response->body = network::URLBody::New();
     server_response->body->set_stream(mtl::WriteStringToSocket(body));
     server_response->status_code = status_code;
 
-    network::HttpHeaderPtr content_length_header = network::HttpHeader::New();
-    content_length_header->name = "content-length";
-    content_length_header->value = ftl::NumberToString(content_length);
-
-    server_response->headers.push_back(std::move(content_length_header));
+    server_response->headers.push_back(
+        MakeHeader("content-length", ftl::NumberToString(content_length)));
+    if (!content_encoding.empty()) {
+      server_response->headers.push_back(
+          MakeHeader("content-encoding", content_encoding));
+    }
 
     fake_network_service_.SetResponse(std::move(server_response));
   }
@@ -94,6 +108,8 @@ TEST_F(CloudStorageImplTest, TestUpload) {
       "/v0/b/project.appspot.com/o/prefixhello-world",
       fake_network_service_.GetRequest()->url);
   EXPECT_EQ("POST", fake_network_service_.GetRequest()->method);
+  EXPECT_EQ(ledger::RequestPriority::BACKGROUND,
+            fake_network_service_.GetRequestPriority());
   EXPECT_TRUE(fake_network_service_.GetRequest()->body->is_buffer());
   std::string sent_content;
   EXPECT_TRUE(mtl::StringFromVmo(
@@ -147,7 +163,7 @@ TEST_F(CloudStorageImplTest, TestDownload) {
   Status status;
   uint64_t size;
   mx::socket data;
-  gcs_.DownloadObject("", "hello-world",
+  gcs_.DownloadObject("", "hello-world", ledger::RequestPriority::INTERACTIVE,
                       callback::Capture(MakeQuitTask(), &status, &size, &data));
   ASSERT_FALSE(RunLoopWithTimeout());
 
@@ -157,6 +173,8 @@ TEST_F(CloudStorageImplTest, TestDownload) {
       "/v0/b/project.appspot.com/o/prefixhello-world?alt=media",
       fake_network_service_.GetRequest()->url);
   EXPECT_EQ("GET", fake_network_service_.GetRequest()->method);
+  EXPECT_EQ(ledger::RequestPriority::INTERACTIVE,
+            fake_network_service_.GetRequestPriority());
 
   std::string downloaded_content;
   EXPECT_TRUE(mtl::BlockingCopyToString(std::move(data), &downloaded_content));
@@ -172,6 +190,7 @@ TEST_F(CloudStorageImplTest, TestDownloadAuth) {
   uint64_t size;
   mx::socket data;
   gcs_.DownloadObject("this-is-a-token", "hello-world",
+                      ledger::RequestPriority::NORMAL,
                       callback::Capture(MakeQuitTask(), &status, &size, &data));
   ASSERT_FALSE(RunLoopWithTimeout());
 
@@ -187,7 +206,7 @@ TEST_F(CloudStorageImplTest, TestDownloadNotFound) {
   Status status;
   uint64_t size;
   mx::socket data;
-  gcs_.DownloadObject("", "whoa",
+  gcs_.DownloadObject("", "whoa", ledger::RequestPriority::NORMAL,
                       callback::Capture(MakeQuitTask(), &status, &size, &data));
   ASSERT_FALSE(RunLoopWithTimeout());
 
@@ -206,7 +225,7 @@ TEST_F(CloudStorageImplTest, TestDownloadWithResponseBodyTooShort) {
   Status status;
   uint64_t size;
   mx::socket data;
-  gcs_.DownloadObject("", "hello-world",
+  gcs_.DownloadObject("", "hello-world", ledger::RequestPriority::NORMAL,
                       callback::Capture(MakeQuitTask(), &status, &size, &data));
   ASSERT_FALSE(RunLoopWithTimeout());
 
@@ -220,5 +239,114 @@ TEST_F(CloudStorageImplTest, TestDownloadWithResponseBodyTooShort) {
   EXPECT_EQ(3u, downloaded_content.size());
 }
 
+TEST_F(CloudStorageImplTest, TestUploadCompressed) {
+  // Compress on another thread, as the Ledger does.
+  ftl::RefPtr<ftl::TaskRunner> compression_runner;
+  std::thread compression_thread = mtl::CreateThread(&compression_runner);
+  auto quit_compression_thread = ftl::MakeAutoCall([&] {
+    compression_runner->PostTask(
+        [] { mtl::MessageLoop::GetCurrent()->QuitNow(); });
+    compression_thread.join();
+  });
+  CloudStorageImpl gcs(message_loop_.task_runner(), &fake_network_service_,
+                       "project", "prefix", compression_runner);
+  // The content spans several of the chunks in which it is compressed.
+  std::string content;
+  for (size_t i = 0; i < 20000; ++i) {
+    content.append("Hello World\n");
+  }
+  mx::vmo data;
+  ASSERT_TRUE(mtl::VmoFromString(content, &data));
+
+  SetResponse("", 0, 200);
+  Status status;
+  gcs.UploadObject("", "hello-world", std::move(data),
+                   callback::Capture(MakeQuitTask(), &status));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+
+  network::HttpHeaderPtr encoding_header = GetHeader(
+      fake_network_service_.GetRequest()->headers, "content-encoding");
+  ASSERT_TRUE(encoding_header);
+  EXPECT_EQ("gzip", encoding_header->value);
+
+  std::string sent_content;
+  EXPECT_TRUE(mtl::StringFromVmo(
+      fake_network_service_.GetRequest()->body->get_buffer(), &sent_content));
+  EXPECT_LT(sent_content.size(), content.size());
+  std::string decompressed_content;
+  EXPECT_TRUE(glue::GzipDecompress(sent_content, &decompressed_content));
+  EXPECT_EQ(content, decompressed_content);
+
+  network::HttpHeaderPtr content_length_header =
+      GetHeader(fake_network_service_.GetRequest()->headers, "content-length");
+  ASSERT_TRUE(content_length_header);
+  EXPECT_EQ(ftl::NumberToString(sent_content.size()),
+            content_length_header->value);
+}
+
+TEST_F(CloudStorageImplTest, TestUploadIncompressible) {
+  CloudStorageImpl gcs(message_loop_.task_runner(), &fake_network_service_,
+                       "project", "prefix", message_loop_.task_runner());
+  std::string content = "Hello World\n";
+  mx::vmo data;
+  ASSERT_TRUE(mtl::VmoFromString(content, &data));
+
+  SetResponse("", 0, 200);
+  Status status;
+  gcs.UploadObject("", "hello-world", std::move(data),
+                   callback::Capture(MakeQuitTask(), &status));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+
+  // Objects that do not shrink are uploaded as they are.
+  EXPECT_FALSE(GetHeader(fake_network_service_.GetRequest()->headers,
+                         "content-encoding"));
+  std::string sent_content;
+  EXPECT_TRUE(mtl::StringFromVmo(
+      fake_network_service_.GetRequest()->body->get_buffer(), &sent_content));
+  EXPECT_EQ(content, sent_content);
+}
+
+TEST_F(CloudStorageImplTest, TestDownloadCompressed) {
+  const std::string content = "Hello World\n";
+  std::string compressed_content;
+  ASSERT_TRUE(glue::GzipCompress(content, &compressed_content));
+  SetResponse(compressed_content, compressed_content.size(), 200, "gzip");
+
+  Status status;
+  uint64_t size;
+  mx::socket data;
+  gcs_.DownloadObject("", "hello-world", ledger::RequestPriority::NORMAL,
+                      callback::Capture(MakeQuitTask(), &status, &size, &data));
+  ASSERT_FALSE(RunLoopWithTimeout());
+
+  network::HttpHeaderPtr accept_encoding_header = GetHeader(
+      fake_network_service_.GetRequest()->headers, "accept-encoding");
+  ASSERT_TRUE(accept_encoding_header);
+  EXPECT_EQ("gzip", accept_encoding_header->value);
+
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(content.size(), size);
+  std::string downloaded_content;
+  EXPECT_TRUE(mtl::BlockingCopyToString(std::move(data), &downloaded_content));
+  EXPECT_EQ(content, downloaded_content);
+}
+
+TEST_F(CloudStorageImplTest, TestDownloadInvalidCompressedData) {
+  const std::string content = "Hello World\n";
+  SetResponse(content, content.size(), 200, "gzip");
+
+  Status status;
+  uint64_t size;
+  mx::socket data;
+  gcs_.DownloadObject("", "hello-world", ledger::RequestPriority::NORMAL,
+                      callback::Capture(MakeQuitTask(), &status, &size, &data));
+  ASSERT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(Status::PARSE_ERROR, status);
+  EXPECT_FALSE(data);
+}
+
 }  // namespace
 }  // namespace gcs
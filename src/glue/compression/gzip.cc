@@ -0,0 +1,134 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/glue/compression/gzip.h"
+
+#include <zlib.h>
+
+#include "lib/ftl/logging.h"
+
+namespace glue {
+
+namespace {
+
+// Window size of the deflate algorithm. Adding 16 selects the gzip format.
+constexpr int kGzipWindowBits = 15 + 16;
+constexpr int kMemLevel = 8;
+constexpr size_t kChunkSize = 16 * 1024;
+
+}  // namespace
+
+struct GzipStream::Context {
+  z_stream stream;
+  bool done = false;
+};
+
+GzipStream::GzipStream(Mode mode)
+    : mode_(mode), context_(std::make_unique<Context>()) {
+  z_stream* stream = &context_->stream;
+  stream->zalloc = Z_NULL;
+  stream->zfree = Z_NULL;
+  stream->opaque = Z_NULL;
+  stream->next_in = Z_NULL;
+  stream->avail_in = 0;
+  int result;
+  if (mode_ == Mode::COMPRESS) {
+    result = deflateInit2(stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                          kGzipWindowBits, kMemLevel, Z_DEFAULT_STRATEGY);
+  } else {
+    result = inflateInit2(stream, kGzipWindowBits);
+  }
+  FTL_DCHECK(result == Z_OK);
+}
+
+GzipStream::~GzipStream() {
+  if (mode_ == Mode::COMPRESS) {
+    deflateEnd(&context_->stream);
+  } else {
+    inflateEnd(&context_->stream);
+  }
+}
+
+bool GzipStream::Update(ftl::StringView data, std::string* output) {
+  return Process(data, false, output);
+}
+
+bool GzipStream::Finish(std::string* output) {
+  return Process(ftl::StringView(), true, output);
+}
+
+bool GzipStream::Process(ftl::StringView data,
+                         bool finish,
+                         std::string* output) {
+  if (errored_) {
+    return false;
+  }
+  z_stream* stream = &context_->stream;
+  stream->next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream->avail_in = data.size();
+
+  char buffer[kChunkSize];
+  while (!context_->done) {
+    stream->next_out = reinterpret_cast<Bytef*>(buffer);
+    stream->avail_out = kChunkSize;
+    int result;
+    if (mode_ == Mode::COMPRESS) {
+      result = deflate(stream, finish ? Z_FINISH : Z_NO_FLUSH);
+    } else {
+      result = inflate(stream, Z_NO_FLUSH);
+    }
+    output->append(buffer, kChunkSize - stream->avail_out);
+
+    if (result == Z_STREAM_END) {
+      context_->done = true;
+      break;
+    }
+    if (result == Z_BUF_ERROR) {
+      // No progress is possible: all the input has been consumed.
+      break;
+    }
+    if (result != Z_OK) {
+      errored_ = true;
+      return false;
+    }
+    if (stream->avail_in == 0 && stream->avail_out != 0 && !finish) {
+      break;
+    }
+  }
+
+  if (stream->avail_in != 0) {
+    // Data after the end of the gzip stream.
+    errored_ = true;
+    return false;
+  }
+  if (finish && !context_->done) {
+    // The gzip stream is truncated.
+    errored_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool GzipCompress(ftl::StringView data, std::string* output) {
+  GzipStream stream(GzipStream::Mode::COMPRESS);
+  std::string result;
+  if (!stream.Update(data, &result) || !stream.Finish(&result)) {
+    return false;
+  }
+  output->swap(result);
+  return true;
+}
+
+bool GzipDecompress(ftl::StringView data, std::string* output) {
+  GzipStream stream(GzipStream::Mode::DECOMPRESS);
+  std::string result;
+  if (!stream.Update(data, &result) || !stream.Finish(&result)) {
+    return false;
+  }
+  output->swap(result);
+  return true;
+}
+
+}  // namespace glue
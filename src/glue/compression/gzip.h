@@ -0,0 +1,50 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_GLUE_COMPRESSION_GZIP_H_
+#define APPS_LEDGER_SRC_GLUE_COMPRESSION_GZIP_H_
+
+#include <memory>
+#include <string>
+
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace glue {
+
+// Compresses or decompresses data in the gzip format, one chunk at a time.
+class GzipStream {
+ public:
+  enum class Mode { COMPRESS, DECOMPRESS };
+
+  explicit GzipStream(Mode mode);
+  ~GzipStream();
+
+  // Processes |data|, appending the produced bytes to |output|. Returns false
+  // if the data cannot be processed, e.g. when decompressing invalid data.
+  bool Update(ftl::StringView data, std::string* output);
+  // Appends the remaining bytes to |output|. Returns false if the stream is
+  // invalid, e.g. when decompressing truncated data.
+  bool Finish(std::string* output);
+
+ private:
+  bool Process(ftl::StringView data, bool finish, std::string* output);
+
+  struct Context;
+  const Mode mode_;
+  std::unique_ptr<Context> context_;
+  bool errored_ = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(GzipStream);
+};
+
+// Compresses |data| in the gzip format.
+bool GzipCompress(ftl::StringView data, std::string* output);
+
+// Decompresses |data|, in the gzip format.
+bool GzipDecompress(ftl::StringView data, std::string* output);
+
+}  // namespace glue
+
+#endif  // APPS_LEDGER_SRC_GLUE_COMPRESSION_GZIP_H_
@@ -0,0 +1,40 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/glue/compression/gzip_socket_drainer.h"
+
+#include <utility>
+
+namespace glue {
+
+GzipSocketDrainer::GzipSocketDrainer()
+    : stream_(GzipStream::Mode::DECOMPRESS), drainer_(this) {}
+
+GzipSocketDrainer::~GzipSocketDrainer() {}
+
+void GzipSocketDrainer::Start(
+    mx::socket source,
+    std::function<void(bool success, std::string data)> callback) {
+  callback_ = std::move(callback);
+  drainer_.Start(std::move(source));
+}
+
+void GzipSocketDrainer::OnDataAvailable(const void* data, size_t num_bytes) {
+  // Errors are sticky: they are reported once all the data is received.
+  stream_.Update(ftl::StringView(static_cast<const char*>(data), num_bytes),
+                 &data_);
+}
+
+void GzipSocketDrainer::OnDataComplete() {
+  bool success = stream_.Finish(&data_);
+  if (destruction_sentinel_.DestructedWhile(
+          [this, success] { callback_(success, std::move(data_)); })) {
+    return;
+  }
+  if (on_empty_callback_) {
+    on_empty_callback_();
+  }
+}
+
+}  // namespace glue
@@ -0,0 +1,51 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_GLUE_COMPRESSION_GZIP_SOCKET_DRAINER_H_
+#define APPS_LEDGER_SRC_GLUE_COMPRESSION_GZIP_SOCKET_DRAINER_H_
+
+#include <functional>
+#include <string>
+
+#include "apps/ledger/src/callback/destruction_sentinel.h"
+#include "apps/ledger/src/glue/compression/gzip.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/mtl/socket/socket_drainer.h"
+
+namespace glue {
+
+// Drains a socket carrying gzip data, decompressing the data as it arrives.
+// |callback| is called with the decompressed data, or with false if the data
+// is not valid gzip data.
+class GzipSocketDrainer : public mtl::SocketDrainer::Client {
+ public:
+  GzipSocketDrainer();
+  ~GzipSocketDrainer() override;
+
+  void Start(mx::socket source,
+             std::function<void(bool success, std::string data)> callback);
+
+  void set_on_empty(ftl::Closure on_empty_callback) {
+    on_empty_callback_ = std::move(on_empty_callback);
+  }
+
+ private:
+  void OnDataAvailable(const void* data, size_t num_bytes) override;
+
+  void OnDataComplete() override;
+
+  std::function<void(bool, std::string)> callback_;
+  GzipStream stream_;
+  std::string data_;
+  mtl::SocketDrainer drainer_;
+  ftl::Closure on_empty_callback_;
+  callback::DestructionSentinel destruction_sentinel_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(GzipSocketDrainer);
+};
+
+}  // namespace glue
+
+#endif  // APPS_LEDGER_SRC_GLUE_COMPRESSION_GZIP_SOCKET_DRAINER_H_
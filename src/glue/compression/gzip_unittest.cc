@@ -0,0 +1,71 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/glue/compression/gzip.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace glue {
+namespace {
+
+std::string MakeData() {
+  std::string data;
+  for (size_t i = 0; i < 10000; ++i) {
+    data.append("{\"key\": \"value" + std::to_string(i % 10) + "\"}");
+  }
+  return data;
+}
+
+TEST(GzipTest, CompressDecompress) {
+  for (const std::string& data : {std::string(), std::string("data"),
+                                  MakeData()}) {
+    std::string compressed;
+    ASSERT_TRUE(GzipCompress(data, &compressed));
+    std::string decompressed;
+    ASSERT_TRUE(GzipDecompress(compressed, &decompressed));
+    EXPECT_EQ(data, decompressed);
+  }
+}
+
+TEST(GzipTest, CompressRepetitiveData) {
+  std::string data = MakeData();
+  std::string compressed;
+  ASSERT_TRUE(GzipCompress(data, &compressed));
+  EXPECT_LT(compressed.size(), data.size() / 10);
+}
+
+TEST(GzipTest, DecompressByChunks) {
+  std::string data = MakeData();
+  std::string compressed;
+  ASSERT_TRUE(GzipCompress(data, &compressed));
+
+  GzipStream stream(GzipStream::Mode::DECOMPRESS);
+  std::string decompressed;
+  ftl::StringView view = compressed;
+  for (size_t i = 0; i < view.size(); i += 7) {
+    ASSERT_TRUE(stream.Update(view.substr(i, 7), &decompressed));
+  }
+  ASSERT_TRUE(stream.Finish(&decompressed));
+  EXPECT_EQ(data, decompressed);
+}
+
+TEST(GzipTest, DecompressInvalidData) {
+  std::string compressed;
+  ASSERT_TRUE(GzipCompress("data", &compressed));
+  std::string decompressed;
+
+  EXPECT_FALSE(GzipDecompress("", &decompressed));
+  EXPECT_FALSE(GzipDecompress("data", &decompressed));
+  // Truncated data.
+  EXPECT_FALSE(GzipDecompress(
+      ftl::StringView(compressed).substr(0, compressed.size() - 1),
+      &decompressed));
+  // Trailing data.
+  EXPECT_FALSE(GzipDecompress(compressed + "data", &decompressed));
+}
+
+}  // namespace
+}  // namespace glue
@@ -4,6 +4,8 @@
 
 #include "apps/ledger/src/glue/crypto/hash.h"
 
+#include <openssl/digest.h>
+#include <openssl/hmac.h>
 #include <openssl/sha.h>
 
 #include "lib/ftl/logging.h"
@@ -40,4 +42,38 @@ std::string SHA256Hash(ftl::StringView data) {
   return result;
 }
 
+struct SHA256StreamingHMAC::Context {
+  HMAC_CTX hmac;
+};
+
+SHA256StreamingHMAC::SHA256StreamingHMAC(ftl::StringView key)
+    : context_(std::make_unique<Context>()) {
+  HMAC_CTX_init(&context_->hmac);
+  int result = HMAC_Init_ex(&context_->hmac, key.data(), key.size(),
+                            EVP_sha256(), nullptr);
+  FTL_CHECK(result == 1);
+}
+
+SHA256StreamingHMAC::~SHA256StreamingHMAC() {
+  HMAC_CTX_cleanup(&context_->hmac);
+}
+
+void SHA256StreamingHMAC::Update(ftl::StringView data) {
+  HMAC_Update(&context_->hmac, reinterpret_cast<const uint8_t*>(data.data()),
+              data.size());
+}
+
+void SHA256StreamingHMAC::GetHMAC(std::string* output) const {
+  // Finish a copy of the context, so that the data can still be extended.
+  HMAC_CTX hmac;
+  HMAC_CTX_init(&hmac);
+  int result = HMAC_CTX_copy_ex(&hmac, &context_->hmac);
+  FTL_CHECK(result == 1);
+  output->resize(kHashSize);
+  unsigned int size;
+  HMAC_Final(&hmac, reinterpret_cast<uint8_t*>(&(*output)[0]), &size);
+  FTL_DCHECK(size == kHashSize);
+  HMAC_CTX_cleanup(&hmac);
+}
+
 }  // namespace glue
@@ -31,6 +31,27 @@ class SHA256StreamingHash {
 
 std::string SHA256Hash(ftl::StringView data);
 
+// HMAC-SHA256 of data given in pieces. The HMAC of the data given so far can be
+// retrieved at any point, so that the HMACs of all the prefixes of some data
+// are computed in a single pass.
+class SHA256StreamingHMAC {
+ public:
+  constexpr static size_t kHashSize = 32;
+
+  explicit SHA256StreamingHMAC(ftl::StringView key);
+  ~SHA256StreamingHMAC();
+  void Update(ftl::StringView data);
+  // Returns the HMAC of the data given so far in |output|. More data can be
+  // given afterwards.
+  void GetHMAC(std::string* output) const;
+
+ private:
+  struct Context;
+  std::unique_ptr<Context> context_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SHA256StreamingHMAC);
+};
+
 }  // namespace glue
 
 #endif  // APPS_LEDGER_SRC_GLUE_CRYPTO_HASH_H_
@@ -45,7 +45,9 @@ void FakeNetworkService::SetStringResponse(const std::string& body,
 
 ftl::RefPtr<callback::Cancellable> FakeNetworkService::Request(
     std::function<network::URLRequestPtr()> request_factory,
-    std::function<void(network::URLResponsePtr)> callback) {
+    std::function<void(network::URLResponsePtr)> callback,
+    RequestPriority priority) {
+  priority_received_ = priority;
   std::unique_ptr<bool> cancelled = std::make_unique<bool>(false);
 
   bool* cancelled_ptr = cancelled.get();
@@ -18,6 +18,8 @@ class FakeNetworkService : public NetworkService {
   ~FakeNetworkService() override;
 
   network::URLRequest* GetRequest();
+  // Returns the priority of the last request received.
+  RequestPriority GetRequestPriority() { return priority_received_; }
   void ResetRequest();
 
   void SetResponse(network::URLResponsePtr response);
@@ -30,9 +32,11 @@ class FakeNetworkService : public NetworkService {
   // NetworkService
   ftl::RefPtr<callback::Cancellable> Request(
       std::function<network::URLRequestPtr()> request_factory,
-      std::function<void(network::URLResponsePtr)> callback) override;
+      std::function<void(network::URLResponsePtr)> callback,
+      RequestPriority priority) override;
 
   network::URLRequestPtr request_received_;
+  RequestPriority priority_received_ = RequestPriority::NORMAL;
   network::URLResponsePtr response_to_return_;
   ftl::RefPtr<ftl::TaskRunner> task_runner_;
 
@@ -13,6 +13,17 @@
 
 namespace ledger {
 
+// Priority of a network request. When requests wait for a connection, the ones
+// of higher priority are started first.
+enum class RequestPriority {
+  // A client is waiting on the result, e.g. to fetch a lazy value.
+  INTERACTIVE,
+  // Regular sync traffic.
+  NORMAL,
+  // Bulk transfers that nobody waits on, e.g. object uploads.
+  BACKGROUND,
+};
+
 // Abstraction for the network service. It will reconnect to the network service
 // application in case of disconnection, as well as handle 307 and 308
 // redirections.
@@ -21,10 +32,12 @@ class NetworkService {
   NetworkService() {}
   virtual ~NetworkService() {}
 
-  // Starts a url network request.
+  // Starts a url network request. The request is considered done once the
+  // response headers are received: its body is streamed afterwards.
   virtual ftl::RefPtr<callback::Cancellable> Request(
       std::function<network::URLRequestPtr()> request_factory,
-      std::function<void(network::URLResponsePtr)> callback) = 0;
+      std::function<void(network::URLResponsePtr)> callback,
+      RequestPriority priority) = 0;
 
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(NetworkService);
@@ -4,12 +4,16 @@
 
 #include "apps/ledger/src/network/network_service_impl.h"
 
+#include <algorithm>
+#include <set>
 #include <utility>
 
 #include "apps/ledger/src/callback/cancellable_helper.h"
 #include "apps/ledger/src/callback/destruction_sentinel.h"
 #include "apps/ledger/src/callback/trace_callback.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/strings/ascii.h"
+#include "lib/ftl/strings/string_view.h"
 
 namespace ledger {
 
@@ -18,11 +22,50 @@ const int32_t kInvalidArgument = -4;
 const int32_t kTooManyRedirectErrorCode = -310;
 const int32_t kInvalidResponseErrorCode = -320;
 
+namespace {
+// Returns the host part of |url|, or |url| itself if it cannot be parsed.
+std::string GetHost(ftl::StringView url) {
+  size_t start = url.find("://");
+  if (start == ftl::StringView::npos) {
+    return url.ToString();
+  }
+  start += 3;
+  size_t end = start;
+  while (end < url.size() && url[end] != '/' && url[end] != '?' &&
+         url[end] != '#') {
+    ++end;
+  }
+  return url.substr(start, end - start).ToString();
+}
+}  // namespace
+
 class NetworkServiceImpl::RunningRequest {
  public:
-  explicit RunningRequest(
-      std::function<network::URLRequestPtr()> request_factory)
-      : request_factory_(std::move(request_factory)), redirect_count_(0u) {}
+  // |request| is the request built by |request_factory| to schedule this
+  // request. It is used when the request is first started.
+  RunningRequest(std::function<network::URLRequestPtr()> request_factory,
+                 network::URLRequestPtr request,
+                 RequestPriority priority)
+      : request_factory_(std::move(request_factory)),
+        host_(request ? GetHost(request->url.get()) : ""),
+        priority_(priority),
+        request_(std::move(request)),
+        redirect_count_(0u) {}
+
+  ~RunningRequest() {
+    if (on_deleted_) {
+      on_deleted_();
+    }
+  }
+
+  const std::string& host() const { return host_; }
+  RequestPriority priority() const { return priority_; }
+  bool in_flight() const { return in_flight_; }
+  void set_in_flight() { in_flight_ = true; }
+
+  void set_on_deleted(ftl::Closure on_deleted) {
+    on_deleted_ = std::move(on_deleted);
+  }
 
   void Cancel() {
     FTL_DCHECK(on_empty_callback_);
@@ -65,7 +108,7 @@ class NetworkServiceImpl::RunningRequest {
     if (!network_service_)
       return;
 
-    auto request = request_factory_();
+    auto request = request_ ? std::move(request_) : request_factory_();
 
     if (!request) {
       callback_(NewErrorResponse(kInvalidArgument,
@@ -149,6 +192,11 @@ class NetworkServiceImpl::RunningRequest {
   }
 
   std::function<network::URLRequestPtr()> request_factory_;
+  const std::string host_;
+  const RequestPriority priority_;
+  network::URLRequestPtr request_;
+  bool in_flight_ = false;
+  ftl::Closure on_deleted_;
   std::function<void(network::URLResponsePtr)> callback_;
   ftl::Closure on_empty_callback_;
   std::string next_url_;
@@ -160,27 +208,44 @@ class NetworkServiceImpl::RunningRequest {
 
 NetworkServiceImpl::NetworkServiceImpl(
     ftl::RefPtr<ftl::TaskRunner> task_runner,
-    std::function<network::NetworkServicePtr()> network_service_factory)
+    std::function<network::NetworkServicePtr()> network_service_factory,
+    size_t max_in_flight_per_host)
     : task_runner_(std::move(task_runner)),
       network_service_factory_(std::move(network_service_factory)),
-      weak_factory_(this) {}
+      max_in_flight_per_host_(max_in_flight_per_host),
+      weak_factory_(this) {
+  FTL_DCHECK(max_in_flight_per_host_ > 0);
+}
 
-NetworkServiceImpl::~NetworkServiceImpl() {}
+NetworkServiceImpl::~NetworkServiceImpl() {
+  // The remaining requests are deleted along with this class.
+  for (auto& request : running_requests_) {
+    request.set_on_deleted(nullptr);
+  }
+}
 
 ftl::RefPtr<callback::Cancellable> NetworkServiceImpl::Request(
     std::function<network::URLRequestPtr()> request_factory,
-    std::function<void(network::URLResponsePtr)> callback) {
-  RunningRequest& request =
-      running_requests_.emplace(std::move(request_factory));
+    std::function<void(network::URLResponsePtr)> callback,
+    RequestPriority priority) {
+  // Build the request right away, to know its host. The network service is
+  // obtained first, as it would be to start the request.
+  if (!in_backoff_) {
+    GetNetworkService();
+  }
+  network::URLRequestPtr url_request = request_factory();
+  RunningRequest& request = running_requests_.emplace(
+      std::move(request_factory), std::move(url_request), priority);
 
   auto cancellable =
       callback::CancellableImpl::Create([&request]() { request.Cancel(); });
 
   request.set_callback(cancellable->WrapCallback(
       TRACE_CALLBACK(std::move(callback), "ledger", "network_request")));
-  if (!in_backoff_) {
-    request.SetNetworkService(GetNetworkService());
-  }
+  request.set_on_deleted([this, &request] { OnRequestDeleted(&request); });
+  queues_[static_cast<size_t>(priority)][request.host()].push_back(&request);
+  ++queue_depth_;
+  StartQueuedRequests(request.host());
 
   return cancellable;
 }
@@ -217,8 +282,113 @@ void NetworkServiceImpl::RetryGetNetworkService() {
   }
   network::NetworkService* network_service = GetNetworkService();
   for (auto& request : running_requests_) {
-    request.SetNetworkService(network_service);
+    if (request.in_flight()) {
+      request.SetNetworkService(network_service);
+    }
+  }
+  StartQueuedRequests();
+}
+
+size_t NetworkServiceImpl::GetMaxInFlight(RequestPriority priority) const {
+  switch (priority) {
+    case RequestPriority::INTERACTIVE:
+      return max_in_flight_per_host_;
+    case RequestPriority::NORMAL:
+      return std::max<size_t>(max_in_flight_per_host_ - 1, 1u);
+    case RequestPriority::BACKGROUND:
+      return std::max<size_t>(max_in_flight_per_host_ / 2, 1u);
+  }
+}
+
+void NetworkServiceImpl::StartQueuedRequests() {
+  if (in_backoff_) {
+    return;
   }
+  // Starting a request can delete other ones, so the hosts are collected
+  // first.
+  std::set<std::string> hosts;
+  for (const auto& queues : queues_) {
+    for (const auto& entry : queues) {
+      hosts.insert(entry.first);
+    }
+  }
+  for (const auto& host : hosts) {
+    StartHostRequests(host);
+  }
+  TRACE_COUNTER("ledger", "network_requests", reinterpret_cast<uintptr_t>(this),
+                "queue_depth", static_cast<uint64_t>(queue_depth_),
+                "in_flight", static_cast<uint64_t>(in_flight_count_));
+}
+
+void NetworkServiceImpl::StartQueuedRequests(std::string host) {
+  if (in_backoff_) {
+    return;
+  }
+  StartHostRequests(host);
+  TRACE_COUNTER("ledger", "network_requests", reinterpret_cast<uintptr_t>(this),
+                "queue_depth", static_cast<uint64_t>(queue_depth_),
+                "in_flight", static_cast<uint64_t>(in_flight_count_));
+}
+
+void NetworkServiceImpl::StartHostRequests(const std::string& host) {
+  for (auto& queues : queues_) {
+    // Starting a request can delete other ones, so the queue is looked up
+    // again for each request. All the requests of a queue have the same limit:
+    // the queue is left as soon as its first request cannot start.
+    while (true) {
+      auto it = queues.find(host);
+      if (it == queues.end()) {
+        break;
+      }
+      RunningRequest* request = it->second.front();
+      if (in_flight_per_host_[host] >= GetMaxInFlight(request->priority())) {
+        break;
+      }
+      it->second.pop_front();
+      if (it->second.empty()) {
+        queues.erase(it);
+      }
+      --queue_depth_;
+      StartRequest(request);
+    }
+  }
+}
+
+void NetworkServiceImpl::StartRequest(RunningRequest* request) {
+  request->set_in_flight();
+  ++in_flight_per_host_[request->host()];
+  ++in_flight_count_;
+  request->SetNetworkService(GetNetworkService());
+}
+
+void NetworkServiceImpl::OnRequestDeleted(RunningRequest* request) {
+  if (!request->in_flight()) {
+    auto& queues = queues_[static_cast<size_t>(request->priority())];
+    auto it = queues.find(request->host());
+    FTL_DCHECK(it != queues.end());
+    auto& queue = it->second;
+    queue.erase(std::find(queue.begin(), queue.end(), request));
+    if (queue.empty()) {
+      queues.erase(it);
+    }
+    --queue_depth_;
+    return;
+  }
+
+  auto it = in_flight_per_host_.find(request->host());
+  FTL_DCHECK(it != in_flight_per_host_.end() && it->second > 0);
+  if (--it->second == 0) {
+    in_flight_per_host_.erase(it);
+  }
+  --in_flight_count_;
+  // The request is being deleted from |running_requests_|: start the next
+  // ones asynchronously. Only the requests to the same host can use the slot.
+  task_runner_->PostTask(
+      [ weak_this = weak_factory_.GetWeakPtr(), host = request->host() ] {
+        if (weak_this) {
+          weak_this->StartQueuedRequests(host);
+        }
+      });
 }
 
 }  // namespace ledger
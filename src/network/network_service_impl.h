@@ -5,6 +5,10 @@
 #ifndef APPS_LEDGER_SRC_NETWORK_NETWORK_SERVICE_IMPL_H_
 #define APPS_LEDGER_SRC_NETWORK_NETWORK_SERVICE_IMPL_H_
 
+#include <deque>
+#include <map>
+#include <string>
+
 #include "apps/ledger/src/backoff/exponential_backoff.h"
 #include "apps/ledger/src/callback/auto_cleanable.h"
 #include "apps/ledger/src/network/network_service.h"
@@ -14,16 +18,31 @@
 
 namespace ledger {
 
+// Implementation of NetworkService using the system network service.
+//
+// At most |max_in_flight_per_host| requests to a given host are in flight at a
+// time. The other ones are queued, and started by decreasing priority, in the
+// order in which they were made within a priority. Lower priorities leave
+// room for higher ones: NORMAL requests can only take all but one of the slots
+// of a host, and BACKGROUND ones half of them, so that a saturating upload
+// does not delay the requests that a client waits on.
 class NetworkServiceImpl : public NetworkService {
  public:
   NetworkServiceImpl(
       ftl::RefPtr<ftl::TaskRunner> task_runner,
-      std::function<network::NetworkServicePtr()> network_service_factory);
+      std::function<network::NetworkServicePtr()> network_service_factory,
+      size_t max_in_flight_per_host = 6);
   ~NetworkServiceImpl() override;
 
   ftl::RefPtr<callback::Cancellable> Request(
       std::function<network::URLRequestPtr()> request_factory,
-      std::function<void(network::URLResponsePtr)> callback) override;
+      std::function<void(network::URLResponsePtr)> callback,
+      RequestPriority priority) override;
+
+  // Number of requests waiting for a slot.
+  size_t queue_depth() const { return queue_depth_; }
+  // Number of requests currently in flight.
+  size_t in_flight() const { return in_flight_count_; }
 
  private:
   class RunningRequest;
@@ -32,6 +51,20 @@ class NetworkServiceImpl : public NetworkService {
 
   void RetryGetNetworkService();
 
+  // Returns the number of requests of the given priority that can be in
+  // flight to a single host.
+  size_t GetMaxInFlight(RequestPriority priority) const;
+  // Starts the queued requests for which there is room.
+  void StartQueuedRequests();
+  // Starts the queued requests to |host| for which there is room.
+  void StartQueuedRequests(std::string host);
+  // Same as |StartQueuedRequests(host)|, without tracing the queue depth.
+  void StartHostRequests(const std::string& host);
+  void StartRequest(RunningRequest* request);
+  // Called when |request| is deleted, either because it completed or because
+  // it was cancelled.
+  void OnRequestDeleted(RunningRequest* request);
+
   ftl::RefPtr<ftl::TaskRunner> task_runner_;
   backoff::ExponentialBackoff backoff_;
   bool in_backoff_ = false;
@@ -39,6 +72,16 @@ class NetworkServiceImpl : public NetworkService {
   network::NetworkServicePtr network_service_;
   callback::AutoCleanableSet<RunningRequest> running_requests_;
 
+  const size_t max_in_flight_per_host_;
+  // Queued requests, indexed by priority, then by host. Hosts without queued
+  // requests of a priority have no entry for it, and a completed request
+  // only needs to look at the queues of its host.
+  std::map<std::string, std::deque<RunningRequest*>> queues_[3];
+  size_t queue_depth_ = 0u;
+  // Number of requests in flight per host.
+  std::map<std::string, size_t> in_flight_per_host_;
+  size_t in_flight_count_ = 0u;
+
   // Must be the last member field.
   ftl::WeakPtrFactory<NetworkServiceImpl> weak_factory_;
 };
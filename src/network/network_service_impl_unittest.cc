@@ -4,7 +4,9 @@
 
 #include "apps/ledger/src/network/network_service_impl.h"
 
+#include <algorithm>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -58,14 +60,55 @@ class FakeURLLoader : public network::URLLoader {
   FTL_DISALLOW_COPY_AND_ASSIGN(FakeURLLoader);
 };
 
+// Url loader that holds the url request it receives, and only returns a
+// response once Respond() is called.
+class HoldingURLLoader : public network::URLLoader {
+ public:
+  explicit HoldingURLLoader(fidl::InterfaceRequest<network::URLLoader> request)
+      : binding_(this, std::move(request)) {}
+  ~HoldingURLLoader() override {}
+
+  bool started() const { return !!request_received_; }
+  const std::string& url() const { return request_received_->url.get(); }
+
+  void Respond(uint32_t status_code) {
+    FTL_DCHECK(callback_);
+    auto response = network::URLResponse::New();
+    response->status_code = status_code;
+    callback_(std::move(response));
+    callback_ = nullptr;
+  }
+
+  // URLLoader:
+  void Start(network::URLRequestPtr request,
+             const StartCallback& callback) override {
+    request_received_ = std::move(request);
+    callback_ = callback;
+  }
+  void FollowRedirect(const FollowRedirectCallback& /*callback*/) override {}
+  void QueryStatus(const QueryStatusCallback& /*callback*/) override {}
+
+ private:
+  fidl::Binding<network::URLLoader> binding_;
+  network::URLRequestPtr request_received_;
+  StartCallback callback_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(HoldingURLLoader);
+};
+
 // Fake implementation of network service, allowing to inspect the last request
 // passed to any url loader and set the response that url loaders need to
 // return. Response is moved out when url request starts, and needs to be set
 // each time.
+//
+// If |hold_responses| is true, url loaders instead hold the requests until
+// HoldingURLLoader::Respond() is called on the loaders returned by
+// held_loaders().
 class FakeNetworkService : public network::NetworkService {
  public:
-  explicit FakeNetworkService(fidl::InterfaceRequest<NetworkService> request)
-      : binding_(this, std::move(request)) {}
+  FakeNetworkService(fidl::InterfaceRequest<NetworkService> request,
+                     bool hold_responses)
+      : binding_(this, std::move(request)), hold_responses_(hold_responses) {}
   ~FakeNetworkService() override {}
 
   network::URLRequest* GetRequest() { return request_received_.get(); }
@@ -74,9 +117,18 @@ class FakeNetworkService : public network::NetworkService {
     response_to_return_ = std::move(response);
   }
 
+  const std::vector<std::unique_ptr<HoldingURLLoader>>& held_loaders() {
+    return held_loaders_;
+  }
+
   // NetworkService:
   void CreateURLLoader(
       fidl::InterfaceRequest<network::URLLoader> loader) override {
+    if (hold_responses_) {
+      held_loaders_.push_back(
+          std::make_unique<HoldingURLLoader>(std::move(loader)));
+      return;
+    }
     FTL_DCHECK(response_to_return_);
     loaders_.push_back(std::make_unique<FakeURLLoader>(
         std::move(loader), std::move(response_to_return_), &request_received_));
@@ -114,7 +166,9 @@ class FakeNetworkService : public network::NetworkService {
 
  private:
   fidl::Binding<NetworkService> binding_;
+  const bool hold_responses_;
   std::vector<std::unique_ptr<FakeURLLoader>> loaders_;
+  std::vector<std::unique_ptr<HoldingURLLoader>> held_loaders_;
   network::URLRequestPtr request_received_;
   network::URLResponsePtr response_to_return_;
 
@@ -174,8 +228,8 @@ class NetworkServiceImplTest : public test::TestWithMessageLoop {
  private:
   network::NetworkServicePtr NewNetworkService() {
     network::NetworkServicePtr result;
-    fake_network_service_ =
-        std::make_unique<FakeNetworkService>(result.NewRequest());
+    fake_network_service_ = std::make_unique<FakeNetworkService>(
+        result.NewRequest(), hold_responses_);
     if (response_) {
       fake_network_service_->SetResponse(std::move(response_));
     }
@@ -186,8 +240,22 @@ class NetworkServiceImplTest : public test::TestWithMessageLoop {
   NetworkServiceImpl network_service_;
   std::unique_ptr<FakeNetworkService> fake_network_service_;
   network::URLResponsePtr response_;
+  // Must be set before the first request to hold the responses.
+  bool hold_responses_ = false;
 };
 
+// Returns the urls of the requests started by the given loaders, in order.
+std::vector<std::string> GetStartedUrls(
+    const std::vector<std::unique_ptr<HoldingURLLoader>>& loaders) {
+  std::vector<std::string> result;
+  for (const auto& loader : loaders) {
+    if (loader->started()) {
+      result.push_back(loader->url());
+    }
+  }
+  return result;
+}
+
 TEST_F(NetworkServiceImplTest, SimpleRequest) {
   bool callback_destroyed = false;
   network::URLResponsePtr response;
@@ -204,7 +272,8 @@ TEST_F(NetworkServiceImplTest, SimpleRequest) {
       ](network::URLResponsePtr received_response) {
         response = std::move(received_response);
         message_loop_.PostQuitTask();
-      });
+      },
+      RequestPriority::NORMAL);
   EXPECT_FALSE(callback_destroyed);
   EXPECT_FALSE(RunLoopWithTimeout());
 
@@ -230,7 +299,8 @@ TEST_F(NetworkServiceImplTest, CancelRequest) {
       ](network::URLResponsePtr) {
         received_response = true;
         message_loop_.PostQuitTask();
-      });
+      },
+      RequestPriority::NORMAL);
 
   message_loop_.task_runner()->PostTask([cancel] { cancel->Cancel(); });
   cancel = nullptr;
@@ -254,7 +324,8 @@ TEST_F(NetworkServiceImplTest, NetworkDeleted) {
       [this, &response](network::URLResponsePtr received_response) {
         response = std::move(received_response);
         message_loop_.PostQuitTask();
-      });
+      },
+      RequestPriority::NORMAL);
   EXPECT_FALSE(RunLoopWithTimeout());
 
   EXPECT_TRUE(response);
@@ -278,7 +349,8 @@ TEST_F(NetworkServiceImplTest, Redirection) {
       [this, &response](network::URLResponsePtr received_response) {
         response = std::move(received_response);
         message_loop_.PostQuitTask();
-      });
+      },
+      RequestPriority::NORMAL);
   EXPECT_FALSE(RunLoopWithTimeout());
 
   EXPECT_TRUE(response);
@@ -301,12 +373,156 @@ TEST_F(NetworkServiceImplTest, CancelOnCallback) {
         message_loop_.PostQuitTask();
         request->Cancel();
         request = nullptr;
-      });
+      },
+      RequestPriority::NORMAL);
   EXPECT_FALSE(response);
   EXPECT_FALSE(RunLoopWithTimeout());
 
   EXPECT_TRUE(response);
 }
 
+// Verifies that an interactive request is started right away while uploads
+// saturate the connections to the same host, and that the queued uploads are
+// started in order as the previous ones complete.
+TEST_F(NetworkServiceImplTest, InteractiveRequestUnderUploadLoad) {
+  hold_responses_ = true;
+  const size_t kUploadCount = 20;
+  size_t completed_uploads = 0;
+  for (size_t i = 0; i < kUploadCount; ++i) {
+    network_service_.Request(
+        [this, i] {
+          return NewRequest("POST",
+                            "http://example.com/upload/" + std::to_string(i));
+        },
+        [&completed_uploads](network::URLResponsePtr) { ++completed_uploads; },
+        RequestPriority::BACKGROUND);
+  }
+  // Uploads only take half of the slots of the host.
+  EXPECT_EQ(3u, network_service_.in_flight());
+  EXPECT_EQ(kUploadCount - 3, network_service_.queue_depth());
+  EXPECT_TRUE(RunLoopUntil([this] {
+    return GetStartedUrls(fake_network_service_->held_loaders()).size() == 3u;
+  }));
+
+  network::URLResponsePtr response;
+  size_t completed_uploads_before_response = 0;
+  network_service_.Request(
+      [this] { return NewRequest("GET", "http://example.com/object"); },
+      [this, &response, &completed_uploads,
+       &completed_uploads_before_response](
+          network::URLResponsePtr received_response) {
+        response = std::move(received_response);
+        completed_uploads_before_response = completed_uploads;
+        message_loop_.PostQuitTask();
+      },
+      RequestPriority::INTERACTIVE);
+  // The interactive request does not wait for any upload.
+  EXPECT_EQ(4u, network_service_.in_flight());
+  EXPECT_EQ(kUploadCount - 3, network_service_.queue_depth());
+  EXPECT_TRUE(RunLoopUntil([this] {
+    return GetStartedUrls(fake_network_service_->held_loaders()).size() == 4u;
+  }));
+  const auto& loaders = fake_network_service_->held_loaders();
+  EXPECT_EQ("http://example.com/object", loaders[3]->url());
+
+  loaders[3]->Respond(200);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_TRUE(response);
+  EXPECT_EQ(200u, response->status_code);
+  EXPECT_EQ(0u, completed_uploads_before_response);
+
+  // Complete the uploads one at a time: each completion starts the next
+  // queued upload.
+  for (size_t i = 0; i < kUploadCount; ++i) {
+    size_t loader_index = i < 3 ? i : i + 1;
+    ASSERT_LT(loader_index, loaders.size());
+    EXPECT_EQ("http://example.com/upload/" + std::to_string(i),
+              loaders[loader_index]->url());
+    loaders[loader_index]->Respond(200);
+    EXPECT_TRUE(RunLoopUntil([&completed_uploads, &loaders, i, kUploadCount] {
+      return completed_uploads == i + 1 &&
+             GetStartedUrls(loaders).size() ==
+                 std::min(kUploadCount, i + 4) + 1;
+    }));
+  }
+  EXPECT_EQ(0u, network_service_.in_flight());
+  EXPECT_EQ(0u, network_service_.queue_depth());
+}
+
+// Verifies that requests to different hosts do not wait on each other.
+TEST_F(NetworkServiceImplTest, PerHostLimit) {
+  hold_responses_ = true;
+  for (size_t i = 0; i < 4; ++i) {
+    network_service_.Request(
+        [this] { return NewRequest("POST", "http://example.com/upload"); },
+        [](network::URLResponsePtr) {}, RequestPriority::BACKGROUND);
+  }
+  EXPECT_EQ(3u, network_service_.in_flight());
+  EXPECT_EQ(1u, network_service_.queue_depth());
+
+  network_service_.Request(
+      [this] { return NewRequest("POST", "http://example.org/upload"); },
+      [](network::URLResponsePtr) {}, RequestPriority::BACKGROUND);
+  EXPECT_EQ(4u, network_service_.in_flight());
+  EXPECT_EQ(1u, network_service_.queue_depth());
+}
+
+// Verifies that a backlog of requests to a saturated host does not delay the
+// requests to other hosts.
+TEST_F(NetworkServiceImplTest, BacklogOnSaturatedHost) {
+  hold_responses_ = true;
+  const size_t kBacklogSize = 1000;
+  for (size_t i = 0; i < kBacklogSize; ++i) {
+    network_service_.Request(
+        [this] { return NewRequest("POST", "http://example.com/upload"); },
+        [](network::URLResponsePtr) {}, RequestPriority::BACKGROUND);
+  }
+  EXPECT_EQ(3u, network_service_.in_flight());
+  EXPECT_EQ(kBacklogSize - 3, network_service_.queue_depth());
+
+  for (size_t i = 0; i < 3; ++i) {
+    network_service_.Request(
+        [this] { return NewRequest("GET", "http://example.org/object"); },
+        [](network::URLResponsePtr) {}, RequestPriority::NORMAL);
+  }
+  EXPECT_EQ(6u, network_service_.in_flight());
+  EXPECT_EQ(kBacklogSize - 3, network_service_.queue_depth());
+}
+
+// Verifies that cancelling a queued request removes it from the queue.
+TEST_F(NetworkServiceImplTest, CancelQueuedRequest) {
+  hold_responses_ = true;
+  std::vector<ftl::RefPtr<callback::Cancellable>> requests;
+  std::vector<bool> callback_destroyed(5, false);
+  for (size_t i = 0; i < 5; ++i) {
+    requests.push_back(network_service_.Request(
+        [this, i] {
+          return NewRequest("POST",
+                            "http://example.com/upload/" + std::to_string(i));
+        },
+        [destroy_watcher = DestroyWatcher::Create([&callback_destroyed, i] {
+          callback_destroyed[i] = true;
+        })](network::URLResponsePtr) {},
+        RequestPriority::BACKGROUND));
+  }
+  EXPECT_EQ(2u, network_service_.queue_depth());
+
+  requests[3]->Cancel();
+  EXPECT_EQ(1u, network_service_.queue_depth());
+
+  EXPECT_TRUE(RunLoopUntil([this] {
+    return GetStartedUrls(fake_network_service_->held_loaders()).size() == 3u;
+  }));
+  fake_network_service_->held_loaders()[0]->Respond(200);
+  EXPECT_TRUE(RunLoopUntil([this] {
+    return GetStartedUrls(fake_network_service_->held_loaders()).size() == 4u;
+  }));
+  EXPECT_EQ("http://example.com/upload/4",
+            fake_network_service_->held_loaders()[3]->url());
+  EXPECT_EQ(0u, network_service_.queue_depth());
+  EXPECT_TRUE(callback_destroyed[3]);
+  EXPECT_FALSE(callback_destroyed[4]);
+}
+
 }  // namespace
 }  // namespace ledger
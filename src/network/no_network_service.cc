@@ -17,7 +17,8 @@ NoNetworkService::~NoNetworkService() {}
 
 ftl::RefPtr<callback::Cancellable> NoNetworkService::Request(
     std::function<network::URLRequestPtr()> /*request_factory*/,
-    std::function<void(network::URLResponsePtr)> callback) {
+    std::function<void(network::URLResponsePtr)> callback,
+    RequestPriority /*priority*/) {
   auto cancellable = callback::CancellableImpl::Create([] {});
 
   task_runner_->PostTask([callback = cancellable->WrapCallback(callback)] {
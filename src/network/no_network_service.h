@@ -20,7 +20,8 @@ class NoNetworkService : public NetworkService {
   // NetworkService:
   ftl::RefPtr<callback::Cancellable> Request(
       std::function<network::URLRequestPtr()> request_factory,
-      std::function<void(network::URLResponsePtr)> callback) override;
+      std::function<void(network::URLResponsePtr)> callback,
+      RequestPriority priority) override;
 
  private:
   ftl::RefPtr<ftl::TaskRunner> task_runner_;
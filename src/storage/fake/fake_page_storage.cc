@@ -53,6 +53,10 @@ PageId FakePageStorage::GetId() {
   return page_id_;
 }
 
+uint64_t FakePageStorage::GetApproximateMemoryUsage() {
+  return approximate_memory_usage_;
+}
+
 void FakePageStorage::GetHeadCommitIds(
     std::function<void(Status, std::vector<CommitId>)> callback) {
   std::vector<CommitId> commit_ids;
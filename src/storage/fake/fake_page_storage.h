@@ -27,6 +27,7 @@ class FakePageStorage : public test::PageStorageEmptyImpl {
 
   // PageStorage:
   PageId GetId() override;
+  uint64_t GetApproximateMemoryUsage() override;
   void GetHeadCommitIds(
       std::function<void(Status, std::vector<CommitId>)> callback) override;
   void GetCommit(CommitIdView commit_id,
@@ -63,6 +64,9 @@ class FakePageStorage : public test::PageStorageEmptyImpl {
 
   // For testing:
   void set_autocommit(bool autocommit) { autocommit_ = autocommit; }
+  void set_approximate_memory_usage(uint64_t approximate_memory_usage) {
+    approximate_memory_usage_ = approximate_memory_usage;
+  }
   const std::map<std::string, std::unique_ptr<FakeJournalDelegate>>&
   GetJournals() const;
   const std::map<ObjectId, std::string, convert::StringViewComparator>&
@@ -75,6 +79,7 @@ class FakePageStorage : public test::PageStorageEmptyImpl {
   void SendNextObject();
 
   bool autocommit_ = true;
+  uint64_t approximate_memory_usage_ = 0u;
 
   std::default_random_engine rng_;
   std::map<std::string, std::unique_ptr<FakeJournalDelegate>> journals_;
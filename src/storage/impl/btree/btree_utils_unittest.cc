@@ -6,6 +6,7 @@
 #include <stdio.h>
 
 #include <algorithm>
+#include <map>
 
 #include "apps/ledger/src/callback/capture.h"
 #include "apps/ledger/src/coroutine/coroutine_impl.h"
@@ -57,10 +58,12 @@ class TrackGetObjectFakePageStorage : public fake::FakePageStorage {
                  std::function<void(Status, std::unique_ptr<const Object>)>
                      callback) override {
     object_requests.insert(object_id.ToString());
+    object_locations[object_id.ToString()] = location;
     fake::FakePageStorage::GetObject(object_id, location, callback);
   }
 
   std::set<ObjectId> object_requests;
+  std::map<ObjectId, Location> object_locations;
 };
 
 class BTreeUtilsTest : public StorageTest {
@@ -756,6 +759,60 @@ TEST_F(BTreeUtilsTest, GetObjectsFromSync) {
   }
 }
 
+TEST_F(BTreeUtilsTest, GetChangedObjectsFromSync) {
+  // Expected layout (XX is key "keyXX"):
+  //                 [03, 07]
+  //            /       |            \
+  // [00, 01, 02]  [04, 05, 06] [08, 09, 10, 11]
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(11, &entries));
+  ObjectId base_root_id = CreateTree(entries);
+
+  // Update the value of key02: only the root and its first child change.
+  std::unique_ptr<const Object> object;
+  ASSERT_TRUE(AddObject("new_object", &object));
+  Entry updated_entry = entries[2].entry;
+  updated_entry.object_id = object->GetId();
+  updated_entry.priority = KeyPriority::EAGER;
+  std::vector<EntryChange> changes = {EntryChange{updated_entry, false}};
+
+  Status status;
+  ObjectId root_id;
+  std::unordered_set<ObjectId> new_nodes;
+  ApplyChanges(
+      &coroutine_service_, &fake_storage_, base_root_id,
+      std::make_unique<EntryChangeIterator>(changes.begin(), changes.end()),
+      callback::Capture(MakeQuitTask(), &status, &root_id, &new_nodes),
+      &kTestNodeLevelCalculator);
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+  ASSERT_EQ(2u, new_nodes.size());
+
+  fake_storage_.object_requests.clear();
+  fake_storage_.object_locations.clear();
+  GetChangedObjectsFromSync(&coroutine_service_, &fake_storage_, base_root_id,
+                            root_id,
+                            callback::Capture(MakeQuitTask(), &status));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+
+  // The new value and the new nodes are requested, and so are the nodes of the
+  // base tree on the path to the change. Shared subtrees and the values they
+  // contain are skipped.
+  EXPECT_EQ(1u, fake_storage_.object_requests.count(object->GetId()));
+  for (const ObjectId& node_id : new_nodes) {
+    EXPECT_EQ(1u, fake_storage_.object_requests.count(node_id));
+  }
+  // Nodes and values are all downloaded in the background.
+  for (const auto& request : fake_storage_.object_locations) {
+    EXPECT_EQ(PageStorage::Location::BACKGROUND_NETWORK, request.second);
+  }
+  for (const EntryChange& change : entries) {
+    EXPECT_EQ(0u, fake_storage_.object_requests.count(change.entry.object_id));
+  }
+  EXPECT_EQ(5u, fake_storage_.object_requests.size());
+}
+
 TEST_F(BTreeUtilsTest, ForEachEmptyTree) {
   std::vector<EntryChange> entries = {};
   ObjectId root_id = CreateTree(entries);
@@ -630,7 +630,8 @@ void ApplyChanges(
     page_storage, root_id = root_id.ToString(), changes = std::move(changes),
     callback = std::move(callback), node_level_calculator
   ](coroutine::CoroutineHandler * handler) mutable {
-    SynchronousStorage storage(page_storage, handler);
+    SynchronousStorage storage(page_storage, PageStorage::Location::NETWORK,
+                               handler);
 
     NodeBuilder root;
     Status status = NodeBuilder::FromId(&storage, std::move(root_id), &root);
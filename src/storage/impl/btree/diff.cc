@@ -4,6 +4,8 @@
 
 #include "apps/ledger/src/storage/impl/btree/diff.h"
 
+#include "apps/ledger/src/callback/waiter.h"
+
 #include "apps/ledger/src/storage/impl/btree/internal_helper.h"
 #include "apps/ledger/src/storage/impl/btree/iterator.h"
 #include "apps/ledger/src/storage/impl/btree/synchronous_storage.h"
@@ -292,6 +294,27 @@ Status ForEachDiffInternal(SynchronousStorage* storage,
   return Status::OK;
 }
 
+// Same as |ForEachDiff|, retrieving the tree nodes from |location|.
+void ForEachDiffFrom(coroutine::CoroutineService* coroutine_service,
+                     PageStorage* page_storage,
+                     PageStorage::Location location,
+                     ObjectIdView base_root_id,
+                     ObjectIdView other_root_id,
+                     std::string min_key,
+                     std::function<bool(EntryChange)> on_next,
+                     std::function<void(Status)> on_done) {
+  coroutine_service->StartCoroutine([
+    page_storage, location, base_root_id, other_root_id,
+    on_next = std::move(on_next), min_key = std::move(min_key),
+    on_done = std::move(on_done)
+  ](coroutine::CoroutineHandler * handler) mutable {
+    SynchronousStorage storage(page_storage, location, handler);
+
+    on_done(ForEachDiffInternal(&storage, base_root_id, other_root_id,
+                                std::move(min_key), on_next));
+  });
+}
+
 }  // namespace
 
 void ForEachDiff(coroutine::CoroutineService* coroutine_service,
@@ -301,15 +324,43 @@ void ForEachDiff(coroutine::CoroutineService* coroutine_service,
                  std::string min_key,
                  std::function<bool(EntryChange)> on_next,
                  std::function<void(Status)> on_done) {
-  coroutine_service->StartCoroutine([
-    page_storage, base_root_id, other_root_id, on_next = std::move(on_next),
-    min_key = std::move(min_key), on_done = std::move(on_done)
-  ](coroutine::CoroutineHandler * handler) mutable {
-    SynchronousStorage storage(page_storage, handler);
+  ForEachDiffFrom(coroutine_service, page_storage,
+                  PageStorage::Location::NETWORK, base_root_id, other_root_id,
+                  std::move(min_key), std::move(on_next), std::move(on_done));
+}
 
-    on_done(ForEachDiffInternal(&storage, base_root_id, other_root_id,
-                                std::move(min_key), on_next));
-  });
+void GetChangedObjectsFromSync(coroutine::CoroutineService* coroutine_service,
+                               PageStorage* page_storage,
+                               ObjectIdView base_root_id,
+                               ObjectIdView root_id,
+                               std::function<void(Status)> callback) {
+  // Tree nodes on the path to the changes are retrieved, from the network in
+  // the background if needed, while computing the diff. Only the values need
+  // to be requested explicitly.
+  auto waiter = callback::Waiter<Status, std::unique_ptr<const Object>>::Create(
+      Status::OK);
+  auto on_next = [page_storage, waiter](EntryChange change) {
+    if (!change.deleted && change.entry.priority == KeyPriority::EAGER) {
+      page_storage->GetObject(change.entry.object_id,
+                              PageStorage::Location::BACKGROUND_NETWORK,
+                              waiter->NewCallback());
+    }
+    return true;
+  };
+  auto on_done =
+      [ callback = std::move(callback), waiter ](Status status) mutable {
+    if (status != Status::OK) {
+      callback(status);
+      return;
+    }
+    waiter->Finalize([callback = std::move(callback)](
+        Status s, std::vector<std::unique_ptr<const Object>> objects) {
+      callback(s);
+    });
+  };
+  ForEachDiffFrom(coroutine_service, page_storage,
+                  PageStorage::Location::BACKGROUND_NETWORK, base_root_id,
+                  root_id, "", std::move(on_next), std::move(on_done));
 }
 
 }  // namespace btree
@@ -27,6 +27,21 @@ void ForEachDiff(coroutine::CoroutineService* coroutine_service,
                  std::function<bool(EntryChange)> on_next,
                  std::function<void(Status)> on_done);
 
+// Tries to download the tree nodes and values with |EAGER| priority of the tree
+// with root |root_id| that are not part of the tree with root |base_root_id|.
+// Subtrees shared by both trees are skipped without being read, so the cost is
+// proportional to the size of the diff between the two trees rather than to
+// the size of the tree. The nodes of both trees on the path to the changes are
+// read, and the ones that are not available locally, including nodes of the
+// base tree, are downloaded. To do this |PageStorage::GetObject| is called for
+// all these nodes and for the changed values, with |BACKGROUND_NETWORK|
+// location.
+void GetChangedObjectsFromSync(coroutine::CoroutineService* coroutine_service,
+                               PageStorage* page_storage,
+                               ObjectIdView base_root_id,
+                               ObjectIdView root_id,
+                               std::function<void(Status)> callback);
+
 }  // namespace btree
 }  // namespace storage
 
@@ -33,6 +33,25 @@ Status ForEachEntryInternal(
   return Status::OK;
 }
 
+// Same as |ForEachEntry|, retrieving the tree nodes from |location|.
+void ForEachEntryFrom(coroutine::CoroutineService* coroutine_service,
+                      PageStorage* page_storage,
+                      PageStorage::Location location,
+                      ObjectIdView root_id,
+                      std::string min_key,
+                      std::function<bool(EntryAndNodeId)> on_next,
+                      std::function<void(Status)> on_done) {
+  FTL_DCHECK(!root_id.empty());
+  coroutine_service->StartCoroutine([
+    page_storage, location, root_id, min_key = std::move(min_key),
+    on_next = std::move(on_next), on_done = std::move(on_done)
+  ](coroutine::CoroutineHandler * handler) {
+    SynchronousStorage storage(page_storage, location, handler);
+
+    on_done(ForEachEntryInternal(&storage, root_id, min_key, on_next));
+  });
+}
+
 }  // namespace
 
 BTreeIterator::BTreeIterator(SynchronousStorage* storage) : storage_(storage) {}
@@ -198,7 +217,8 @@ void GetObjectsFromSync(coroutine::CoroutineService* coroutine_service,
           Status::OK);
   auto on_next = [page_storage, waiter_](EntryAndNodeId e) {
     if (e.entry.priority == KeyPriority::EAGER) {
-      page_storage->GetObject(e.entry.object_id, PageStorage::Location::NETWORK,
+      page_storage->GetObject(e.entry.object_id,
+                              PageStorage::Location::BACKGROUND_NETWORK,
                               waiter_->NewCallback());
     }
     return true;
@@ -214,8 +234,10 @@ void GetObjectsFromSync(coroutine::CoroutineService* coroutine_service,
       callback(s);
     });
   };
-  ForEachEntry(coroutine_service, page_storage, root_id, "", std::move(on_next),
-               std::move(on_done));
+  // Tree nodes are downloaded in the background, like the values.
+  ForEachEntryFrom(coroutine_service, page_storage,
+                   PageStorage::Location::BACKGROUND_NETWORK, root_id, "",
+                   std::move(on_next), std::move(on_done));
 }
 
 void ForEachEntry(coroutine::CoroutineService* coroutine_service,
@@ -224,15 +246,9 @@ void ForEachEntry(coroutine::CoroutineService* coroutine_service,
                   std::string min_key,
                   std::function<bool(EntryAndNodeId)> on_next,
                   std::function<void(Status)> on_done) {
-  FTL_DCHECK(!root_id.empty());
-  coroutine_service->StartCoroutine([
-    page_storage, root_id, min_key = std::move(min_key),
-    on_next = std::move(on_next), on_done = std::move(on_done)
-  ](coroutine::CoroutineHandler * handler) {
-    SynchronousStorage storage(page_storage, handler);
-
-    on_done(ForEachEntryInternal(&storage, root_id, min_key, on_next));
-  });
+  ForEachEntryFrom(coroutine_service, page_storage,
+                   PageStorage::Location::NETWORK, root_id, std::move(min_key),
+                   std::move(on_next), std::move(on_done));
 }
 
 }  // namespace btree
@@ -104,7 +104,7 @@ void GetObjectIds(coroutine::CoroutineService* coroutine_service,
 
 // Tries to download all tree nodes and values with |EAGER| priority that are
 // not locally available from sync. To do this |PageStorage::GetObject| is
-// called for all corresponding objects.
+// called for all corresponding objects, with |BACKGROUND_NETWORK| location.
 void GetObjectsFromSync(coroutine::CoroutineService* coroutine_service,
                         PageStorage* page_storage,
                         ObjectIdView root_id,
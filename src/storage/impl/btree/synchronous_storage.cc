@@ -8,8 +8,9 @@ namespace storage {
 namespace btree {
 
 SynchronousStorage::SynchronousStorage(PageStorage* page_storage,
+                                       PageStorage::Location location,
                                        coroutine::CoroutineHandler* handler)
-    : page_storage_(page_storage), handler_(handler) {}
+    : page_storage_(page_storage), location_(location), handler_(handler) {}
 
 Status SynchronousStorage::TreeNodeFromId(
     ObjectIdView object_id,
@@ -20,7 +21,8 @@ Status SynchronousStorage::TreeNodeFromId(
           [this, &object_id](
               std::function<void(Status, std::unique_ptr<const TreeNode>)>
                   callback) {
-            TreeNode::FromId(page_storage_, object_id, std::move(callback));
+            TreeNode::FromId(page_storage_, object_id, location_,
+                             std::move(callback));
           },
           &status, result)) {
     return Status::ILLEGAL_STATE;
@@ -35,7 +37,8 @@ Status SynchronousStorage::TreeNodesFromIds(
       callback::Waiter<Status, std::unique_ptr<const TreeNode>>::Create(
           Status::OK);
   for (const auto& object_id : object_ids) {
-    TreeNode::FromId(page_storage_, object_id, waiter->NewCallback());
+    TreeNode::FromId(page_storage_, object_id, location_,
+                     waiter->NewCallback());
   }
   Status status;
   if (coroutine::SyncCall(
@@ -18,10 +18,12 @@ namespace storage {
 namespace btree {
 
 // Wrapper for TreeNode and PageStorage that uses coroutines to make
-// asynchronous calls look like synchronous ones.
+// asynchronous calls look like synchronous ones. Tree nodes are retrieved from
+// |location|.
 class SynchronousStorage {
  public:
   SynchronousStorage(PageStorage* page_storage,
+                     PageStorage::Location location,
                      coroutine::CoroutineHandler* handler);
 
   PageStorage* page_storage() { return page_storage_; }
@@ -40,6 +42,7 @@ class SynchronousStorage {
 
  private:
   PageStorage* page_storage_;
+  const PageStorage::Location location_;
   coroutine::CoroutineHandler* handler_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(SynchronousStorage);
@@ -38,9 +38,9 @@ TreeNode::~TreeNode() {}
 void TreeNode::FromId(
     PageStorage* page_storage,
     ObjectIdView id,
+    PageStorage::Location location,
     std::function<void(Status, std::unique_ptr<const TreeNode>)> callback) {
-  std::unique_ptr<const Object> object;
-  page_storage->GetObject(id, PageStorage::Location::NETWORK, [
+  page_storage->GetObject(id, location, [
     page_storage, callback = std::move(callback)
   ](Status status, std::unique_ptr<const Object> object) {
     if (status != Status::OK) {
@@ -23,10 +23,12 @@ class TreeNode {
   ~TreeNode();
 
   // Creates a |TreeNode| object for an existing node and calls the given
-  // |callback| with the returned status and node.
+  // |callback| with the returned status and node. |location| is passed to
+  // |PageStorage::GetObject| to retrieve the node.
   static void FromId(
       PageStorage* page_storage,
       ObjectIdView id,
+      PageStorage::Location location,
       std::function<void(Status, std::unique_ptr<const TreeNode>)> callback);
 
   // Creates a |TreeNode| object with the given entries and children. An empty
@@ -68,12 +68,14 @@ TEST_F(TreeNodeTest, CreateGetTreeNode) {
   Status status;
   std::unique_ptr<const TreeNode> found_node;
   TreeNode::FromId(&fake_storage_, node->GetId(),
+                   PageStorage::Location::LOCAL,
                    callback::Capture(MakeQuitTask(), &status, &found_node));
   EXPECT_FALSE(RunLoopWithTimeout());
   EXPECT_EQ(Status::OK, status);
   EXPECT_NE(nullptr, found_node);
 
   TreeNode::FromId(&fake_storage_, RandomObjectId(),
+                   PageStorage::Location::LOCAL,
                    callback::Capture(MakeQuitTask(), &status, &found_node));
   EXPECT_FALSE(RunLoopWithTimeout());
   EXPECT_EQ(Status::NOT_FOUND, status);
@@ -120,7 +120,10 @@ std::unique_ptr<Commit> CommitImpl::FromContentAndParents(
   }
   uint64_t generation = parent_generation + 1;
 
-  // Sort commit ids for uniqueness.
+  // Sort commit ids for uniqueness. Together with the timestamp computation
+  // below, this ensures that the id of a merge commit only depends on its
+  // content and on its parents: devices concurrently merging the same commits
+  // produce the same merge commit.
   std::sort(parent_commits.begin(), parent_commits.end(),
             [](const std::unique_ptr<const Commit>& c1,
                const std::unique_ptr<const Commit>& c2) {
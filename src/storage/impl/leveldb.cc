@@ -4,6 +4,7 @@
 
 #include "apps/ledger/src/storage/impl/leveldb.h"
 
+#include <string>
 #include <utility>
 
 #include "apps/ledger/src/cobalt/cobalt.h"
@@ -11,6 +12,7 @@
 #include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/files/directory.h"
 #include "lib/ftl/files/path.h"
+#include "lib/ftl/strings/string_number_conversions.h"
 
 namespace storage {
 
@@ -182,6 +184,16 @@ Status LevelDb::Init() {
   return Status::OK;
 }
 
+uint64_t LevelDb::GetApproximateMemoryUsage() {
+  std::string value;
+  uint64_t memory_usage;
+  if (!db_->GetProperty("leveldb.approximate-memory-usage", &value) ||
+      !ftl::StringToNumberWithError(value, &memory_usage)) {
+    return 0u;
+  }
+  return memory_usage;
+}
+
 std::unique_ptr<Db::Batch> LevelDb::StartBatch() {
   auto db_batch = std::make_unique<leveldb::WriteBatch>();
   active_batches_count_++;
@@ -22,6 +22,10 @@ class LevelDb : public Db {
 
   Status Init();
 
+  // Returns an estimate of the memory, in bytes, used by the database for its
+  // memtables and caches.
+  uint64_t GetApproximateMemoryUsage();
+
   // Db:
   std::unique_ptr<Batch> StartBatch() override;
   Status Get(convert::ExtendedStringView key, std::string* value) override;
@@ -126,6 +126,11 @@ class PageDbMutator {
                                  ftl::StringView key,
                                  ftl::StringView value) = 0;
 
+  // Deletes the opaque sync metadata associated with this page for the given
+  // key.
+  virtual Status DeleteSyncMetadata(coroutine::CoroutineHandler* handler,
+                                    ftl::StringView key) = 0;
+
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(PageDbMutator);
 };
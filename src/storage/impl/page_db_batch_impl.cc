@@ -203,6 +203,12 @@ Status PageDbBatchImpl::SetSyncMetadata(
   return batch_->Put(SyncMetadataRow::GetKeyFor(key), value);
 }
 
+Status PageDbBatchImpl::DeleteSyncMetadata(
+    coroutine::CoroutineHandler* /*handler*/,
+    ftl::StringView key) {
+  return batch_->Delete(SyncMetadataRow::GetKeyFor(key));
+}
+
 Status PageDbBatchImpl::Execute() {
   return batch_->Execute();
 }
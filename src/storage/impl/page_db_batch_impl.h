@@ -73,6 +73,8 @@ class PageDbBatchImpl : public PageDb::Batch {
   Status SetSyncMetadata(coroutine::CoroutineHandler* handler,
                          ftl::StringView key,
                          ftl::StringView value) override;
+  Status DeleteSyncMetadata(coroutine::CoroutineHandler* handler,
+                            ftl::StringView key) override;
 
   Status Execute() override;
 
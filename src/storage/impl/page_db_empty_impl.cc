@@ -146,6 +146,12 @@ Status PageDbEmptyImpl::SetSyncMetadata(
   return Status::NOT_IMPLEMENTED;
 }
 
+Status PageDbEmptyImpl::DeleteSyncMetadata(
+    coroutine::CoroutineHandler* /*handler*/,
+    ftl::StringView /*key*/) {
+  return Status::NOT_IMPLEMENTED;
+}
+
 Status PageDbEmptyImpl::Execute() {
   return Status::NOT_IMPLEMENTED;
 }
@@ -82,6 +82,8 @@ class PageDbEmptyImpl : public PageDb, public PageDb::Batch {
   Status SetSyncMetadata(coroutine::CoroutineHandler* handler,
                          ftl::StringView key,
                          ftl::StringView value) override;
+  Status DeleteSyncMetadata(coroutine::CoroutineHandler* handler,
+                            ftl::StringView key) override;
 
   // PageDb::Batch:
   Status Execute() override;
@@ -125,6 +125,10 @@ Status PageDbImpl::Init() {
   return db_.Init();
 }
 
+uint64_t PageDbImpl::GetApproximateMemoryUsage() {
+  return db_.GetApproximateMemoryUsage();
+}
+
 std::unique_ptr<PageDb::Batch> PageDbImpl::StartBatch() {
   return std::make_unique<PageDbBatchImpl>(db_.StartBatch(), this,
                                            coroutine_service_, page_storage_);
@@ -364,4 +368,11 @@ Status PageDbImpl::SetSyncMetadata(coroutine::CoroutineHandler* handler,
   return batch->Execute();
 }
 
+Status PageDbImpl::DeleteSyncMetadata(coroutine::CoroutineHandler* handler,
+                                      ftl::StringView key) {
+  auto batch = StartBatch();
+  batch->DeleteSyncMetadata(handler, key);
+  return batch->Execute();
+}
+
 }  // namespace storage
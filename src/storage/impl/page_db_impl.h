@@ -27,6 +27,9 @@ class PageDbImpl : public PageDb {
              std::string db_path);
   ~PageDbImpl() override;
 
+  // Returns an estimate of the memory, in bytes, used by the database.
+  uint64_t GetApproximateMemoryUsage();
+
   Status Init() override;
   std::unique_ptr<PageDb::Batch> StartBatch() override;
   Status GetHeads(std::vector<CommitId>* heads) override;
@@ -92,6 +95,8 @@ class PageDbImpl : public PageDb {
   Status SetSyncMetadata(coroutine::CoroutineHandler* handler,
                          ftl::StringView key,
                          ftl::StringView value) override;
+  Status DeleteSyncMetadata(coroutine::CoroutineHandler* handler,
+                            ftl::StringView key) override;
 
  private:
   coroutine::CoroutineService* const coroutine_service_;
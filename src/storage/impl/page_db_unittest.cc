@@ -368,6 +368,10 @@ TEST_F(PageDbTest, SyncMetadata) {
       EXPECT_EQ(Status::OK, page_db_.SetSyncMetadata(handler, key, value));
       EXPECT_EQ(Status::OK, page_db_.GetSyncMetadata(key, &returned_value));
       EXPECT_EQ(value, returned_value);
+
+      EXPECT_EQ(Status::OK, page_db_.DeleteSyncMetadata(handler, key));
+      EXPECT_EQ(Status::NOT_FOUND,
+                page_db_.GetSyncMetadata(key, &returned_value));
     }
   });
 }
@@ -14,6 +14,7 @@
 #include <algorithm>
 #include <iterator>
 #include <map>
+#include <set>
 #include <utility>
 
 #include "apps/ledger/src/callback/trace_callback.h"
@@ -72,6 +73,33 @@ struct StringPointerComparator {
   }
 };
 
+// Returns the id of the closest ancestor of |commit| that is not part of
+// |batch|, or an empty id if the ancestors of |commit| in |batch| have no parent
+// outside of it. Commits received from sync are all ordered after their parents,
+// so such an ancestor is either already present locally or missing.
+CommitId FindAncestorOutsideBatch(
+    const Commit& commit,
+    const std::map<const CommitId*, const Commit*, StringPointerComparator>&
+        batch) {
+  std::vector<const Commit*> to_visit = {&commit};
+  std::set<const Commit*> visited;
+  while (!to_visit.empty()) {
+    const Commit* current = to_visit.back();
+    to_visit.pop_back();
+    if (!visited.insert(current).second) {
+      continue;
+    }
+    for (const auto& parent_id : current->GetParentIds()) {
+      auto it = batch.find(&parent_id);
+      if (it == batch.end()) {
+        return parent_id.ToString();
+      }
+      to_visit.push_back(it->second);
+    }
+  }
+  return CommitId();
+}
+
 Status RollbackJournalInternal(std::unique_ptr<Journal> journal) {
   return static_cast<JournalDBImpl*>(journal.get())->Rollback();
 }
@@ -158,6 +186,10 @@ void PageStorageImpl::SetSyncDelegate(PageSyncDelegate* page_sync) {
   page_sync_ = page_sync;
 }
 
+uint64_t PageStorageImpl::GetApproximateMemoryUsage() {
+  return db_.GetApproximateMemoryUsage();
+}
+
 void PageStorageImpl::GetHeadCommitIds(
     std::function<void(Status, std::vector<CommitId>)> callback) {
   std::vector<CommitId> commit_ids;
@@ -212,6 +244,7 @@ void PageStorageImpl::AddCommitsFromSync(
   std::vector<std::unique_ptr<const Commit>> commits;
 
   std::map<const CommitId*, const Commit*, StringPointerComparator> leaves;
+  std::map<const CommitId*, const Commit*, StringPointerComparator> batch;
   commits.reserve(ids_and_bytes.size());
 
   for (auto& id_and_bytes : ids_and_bytes) {
@@ -238,6 +271,7 @@ void PageStorageImpl::AddCommitsFromSync(
       }
     }
     leaves[&commit->GetId()] = commit.get();
+    batch[&commit->GetId()] = commit.get();
     commits.push_back(std::move(commit));
   }
 
@@ -249,8 +283,9 @@ void PageStorageImpl::AddCommitsFromSync(
   auto waiter = callback::StatusWaiter<Status>::Create(Status::OK);
   // Get all objects from sync and then add the commit objects.
   for (const auto& leaf : leaves) {
-    btree::GetObjectsFromSync(coroutine_service_, this,
-                              leaf.second->GetRootId(), waiter->NewCallback());
+    GetCommitObjectsFromSync(*leaf.second,
+                             FindAncestorOutsideBatch(*leaf.second, batch),
+                             waiter->NewCallback());
   }
 
   waiter->Finalize(ftl::MakeCopyable([
@@ -266,6 +301,36 @@ void PageStorageImpl::AddCommitsFromSync(
   }));
 }
 
+void PageStorageImpl::GetCommitObjectsFromSync(
+    const Commit& commit,
+    CommitIdView base_id,
+    std::function<void(Status)> callback) {
+  if (base_id.empty() || ContainsCommit(base_id) != Status::OK) {
+    btree::GetObjectsFromSync(coroutine_service_, this, commit.GetRootId(),
+                              std::move(callback));
+    return;
+  }
+  // Only the part of the tree of |commit| that differs from the one of
+  // |base_id| needs to be retrieved. The tree of |base_id| may not be fully
+  // available locally, in which case the nodes read to compute the difference
+  // are downloaded too. |commit| outlives |callback|, and |base| is kept alive
+  // until then.
+  GetCommit(base_id, [ this, &commit, callback = std::move(callback) ](
+                         Status status, std::unique_ptr<const Commit> base) {
+    if (status != Status::OK) {
+      callback(status);
+      return;
+    }
+    ObjectIdView base_root_id = base->GetRootId();
+    btree::GetChangedObjectsFromSync(
+        coroutine_service_, this, base_root_id, commit.GetRootId(),
+        ftl::MakeCopyable(
+            [ base = std::move(base), callback ](Status status) {
+              callback(status);
+            }));
+  });
+}
+
 void PageStorageImpl::StartCommit(
     const CommitId& commit_id,
     JournalType journal_type,
@@ -359,6 +424,11 @@ Status PageStorageImpl::MarkCommitSynced(const CommitId& commit_id) {
   return db_.MarkCommitIdSynced(commit_id);
 }
 
+Status PageStorageImpl::IsCommitSynced(const CommitId& commit_id,
+                                       bool* is_synced) {
+  return db_.IsCommitSynced(commit_id, is_synced);
+}
+
 Status PageStorageImpl::GetDeltaObjects(const CommitId& /*commit_id*/,
                                         std::vector<ObjectId>* /*objects*/) {
   return Status::NOT_IMPLEMENTED;
@@ -426,8 +496,12 @@ void PageStorageImpl::GetObject(
     callback = std::move(callback)
   ](Status status, std::unique_ptr<const Object> object) mutable {
     if (status == Status::NOT_FOUND) {
-      if (location == Location::NETWORK) {
-        GetObjectFromSync(object_id, std::move(callback));
+      if (location != Location::LOCAL) {
+        GetObjectFromSync(object_id,
+                          location == Location::NETWORK
+                              ? DownloadPriority::INTERACTIVE
+                              : DownloadPriority::BACKGROUND,
+                          std::move(callback));
       } else {
         callback(Status::NOT_FOUND, nullptr);
       }
@@ -529,6 +603,16 @@ void PageStorageImpl::SetSyncMetadata(ftl::StringView key,
   });
 }
 
+void PageStorageImpl::DeleteSyncMetadata(
+    ftl::StringView key,
+    std::function<void(Status)> callback) {
+  coroutine_service_->StartCoroutine([
+    this, key = key.ToString(), callback = std::move(callback)
+  ](coroutine::CoroutineHandler * handler) {
+    callback(db_.DeleteSyncMetadata(handler, key));
+  });
+}
+
 Status PageStorageImpl::GetSyncMetadata(ftl::StringView key,
                                         std::string* value) {
   return db_.GetSyncMetadata(key, value);
@@ -597,6 +681,12 @@ void PageStorageImpl::NotifyWatchers() {
   }
 }
 
+void PageStorageImpl::ReportMetrics() {
+  TRACE_COUNTER("ledger", "page_storage", reinterpret_cast<uintptr_t>(this),
+                "merge_commits", merge_commit_count_, "memory",
+                GetApproximateMemoryUsage());
+}
+
 Status PageStorageImpl::MarkAllPiecesLocal(coroutine::CoroutineHandler* handler,
                                            PageDb::Batch* batch,
                                            std::vector<ObjectId> object_ids) {
@@ -658,6 +748,7 @@ void PageStorageImpl::AddCommits(
     std::vector<std::unique_ptr<const Commit>> commits_to_send;
 
     std::map<CommitId, int64_t> heads_to_add;
+    uint64_t merge_commit_count = 0u;
 
     // If commits arrive out of order, some commits might be skipped. Continue
     // trying adding commits as long as at least one commit is added on each
@@ -732,6 +823,11 @@ void PageStorageImpl::AddCommits(
             }
           }
 
+          if (source == ChangeSource::LOCAL &&
+              commit->GetParentIds().size() > 1) {
+            ++merge_commit_count;
+          }
+
           // Update heads_to_add.
           heads_to_add[commit->GetId()] = commit->GetTimestamp();
 
@@ -792,6 +888,10 @@ void PageStorageImpl::AddCommits(
     }
 
     status = batch->Execute();
+    if (status == Status::OK) {
+      merge_commit_count_ += merge_commit_count;
+      ReportMetrics();
+    }
     bool notify_watchers = commits_to_send_.empty();
     commits_to_send_.emplace(source, std::move(commits_to_send));
     callback(status);
@@ -842,19 +942,22 @@ void PageStorageImpl::AddPiece(ObjectId object_id,
 }
 
 void PageStorageImpl::DownloadFullObject(ObjectIdView object_id,
+                                         DownloadPriority priority,
                                          std::function<void(Status)> callback) {
   FTL_DCHECK(page_sync_);
   FTL_DCHECK(GetObjectIdType(object_id) != ObjectIdType::INLINE);
 
-  page_sync_->GetObject(object_id, [
-    this, callback = std::move(callback), object_id = object_id.ToString()
+  page_sync_->GetObject(object_id, priority, [
+    this, priority, callback = std::move(callback),
+    object_id = object_id.ToString()
   ](Status status, uint64_t size, mx::socket data) mutable {
     if (status != Status::OK) {
       callback(status);
       return;
     }
     ReadDataSource(DataSource::Create(std::move(data), size), [
-      this, callback = std::move(callback), object_id = std::move(object_id)
+      this, priority, callback = std::move(callback),
+      object_id = std::move(object_id)
     ](Status status, std::unique_ptr<DataSource::DataChunk> chunk) mutable {
       if (status != Status::OK) {
         callback(status);
@@ -886,7 +989,7 @@ void PageStorageImpl::DownloadFullObject(ObjectIdView object_id,
         auto id_string = id.ToString();
         Status status = db_.ReadObject(id_string, nullptr);
         if (status == Status::NOT_FOUND) {
-          DownloadFullObject(id_string, waiter->NewCallback());
+          DownloadFullObject(id_string, priority, waiter->NewCallback());
           return Status::OK;
         }
         return status;
@@ -915,13 +1018,14 @@ void PageStorageImpl::DownloadFullObject(ObjectIdView object_id,
 
 void PageStorageImpl::GetObjectFromSync(
     ObjectIdView object_id,
+    DownloadPriority priority,
     std::function<void(Status, std::unique_ptr<const Object>)> callback) {
   if (!page_sync_) {
     callback(Status::NOT_CONNECTED_ERROR, nullptr);
     return;
   }
 
-  DownloadFullObject(object_id, [
+  DownloadFullObject(object_id, priority, [
     this, object_id = object_id.ToString(), callback = std::move(callback)
   ](Status status) mutable {
     if (status != Status::OK) {
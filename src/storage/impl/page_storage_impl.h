@@ -49,6 +49,7 @@ class PageStorageImpl : public PageStorage {
   // PageStorage:
   PageId GetId() override;
   void SetSyncDelegate(PageSyncDelegate* page_sync) override;
+  uint64_t GetApproximateMemoryUsage() override;
   void GetHeadCommitIds(
       std::function<void(Status, std::vector<CommitId>)> callback) override;
   void GetCommit(CommitIdView commit_id,
@@ -74,6 +75,7 @@ class PageStorageImpl : public PageStorage {
       std::function<void(Status, std::vector<std::unique_ptr<const Commit>>)>
           callback) override;
   Status MarkCommitSynced(const CommitId& commit_id) override;
+  Status IsCommitSynced(const CommitId& commit_id, bool* is_synced) override;
   Status GetDeltaObjects(const CommitId& commit_id,
                          std::vector<ObjectId>* objects) override;
   void GetUnsyncedPieces(
@@ -93,6 +95,8 @@ class PageStorageImpl : public PageStorage {
   void SetSyncMetadata(ftl::StringView key,
                        ftl::StringView value,
                        std::function<void(Status)> callback) override;
+  void DeleteSyncMetadata(ftl::StringView key,
+                          std::function<void(Status)> callback) override;
   Status GetSyncMetadata(ftl::StringView key, std::string* value) override;
 
   // Commit contents.
@@ -123,6 +127,12 @@ class PageStorageImpl : public PageStorage {
                   std::function<void(Status)> callback);
   Status ContainsCommit(CommitIdView id);
   bool IsFirstCommit(CommitIdView id);
+  // Retrieves the objects of |commit| received from sync that are not locally
+  // available. If |base_id| is the id of a commit present locally, only the
+  // objects of |commit| that are not part of |base_id| are looked for.
+  void GetCommitObjectsFromSync(const Commit& commit,
+                                CommitIdView base_id,
+                                std::function<void(Status)> callback);
   // Adds the given synced object. |object_id| will be validated against the
   // expected one based on the |data| and an |OBJECT_ID_MISSMATCH| error will be
   // returned in case of missmatch.
@@ -132,9 +142,11 @@ class PageStorageImpl : public PageStorage {
                 std::function<void(Status)> callback);
   // Download all the chunks of the object with the given id.
   void DownloadFullObject(ObjectIdView object_id,
+                          DownloadPriority priority,
                           std::function<void(Status)> callback);
   void GetObjectFromSync(
       ObjectIdView object_id,
+      DownloadPriority priority,
       std::function<void(Status, std::unique_ptr<const Object>)> callback);
   void FillBufferWithObjectContent(ObjectIdView object_id,
                                    mx::vmo vmo,
@@ -148,6 +160,9 @@ class PageStorageImpl : public PageStorage {
 
   // Notifies the registered watchers with the |commits| in commit_to_send_.
   void NotifyWatchers();
+  // Reports the number of merge commits made on this device and the memory
+  // used by the storage.
+  void ReportMetrics();
 
   coroutine::CoroutineService* const coroutine_service_;
   const PageId page_id_;
@@ -158,6 +173,7 @@ class PageStorageImpl : public PageStorage {
   std::queue<
       std::pair<ChangeSource, std::vector<std::unique_ptr<const Commit>>>>
       commits_to_send_;
+  uint64_t merge_commit_count_ = 0u;
 };
 
 }  // namespace storage
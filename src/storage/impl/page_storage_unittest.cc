@@ -97,17 +97,20 @@ class DelayingFakeSyncDelegate : public PageSyncDelegate {
 
   void GetObject(
       ObjectIdView object_id,
+      DownloadPriority priority,
       std::function<void(Status status, uint64_t size, mx::socket data)>
           callback) override {
     std::string id = object_id.ToString();
     std::string& value = id_to_value_[id];
     object_requests.insert(id);
+    object_priorities[id] = priority;
     on_get_object_([ callback = std::move(callback), value ] {
       callback(Status::OK, value.size(), mtl::WriteStringToSocket(value));
     });
   }
 
   std::set<ObjectId> object_requests;
+  std::map<ObjectId, DownloadPriority> object_priorities;
 
  private:
   std::function<void(ftl::Closure)> on_get_object_;
@@ -508,6 +511,11 @@ TEST_F(PageStorageTest, AddGetSyncedCommits) {
                 sync.object_requests.end());
     EXPECT_TRUE(sync.object_requests.find(eager_value.object_id) !=
                 sync.object_requests.end());
+    // No client is waiting on these objects: the tree node is downloaded in
+    // the background, like the value.
+    EXPECT_EQ(DownloadPriority::BACKGROUND, sync.object_priorities[root_id]);
+    EXPECT_EQ(DownloadPriority::BACKGROUND,
+              sync.object_priorities[eager_value.object_id]);
 
     // Adding the same commit twice should not request any objects from sync.
     sync.object_requests.clear();
@@ -1153,6 +1161,13 @@ TEST_F(PageStorageTest, SyncMetadata) {
     EXPECT_EQ(Status::OK, status);
     EXPECT_EQ(Status::OK, storage_->GetSyncMetadata(key, &returned_value));
     EXPECT_EQ(value, returned_value);
+
+    storage_->DeleteSyncMetadata(key,
+                                 callback::Capture(MakeQuitTask(), &status));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::OK, status);
+    EXPECT_EQ(Status::NOT_FOUND,
+              storage_->GetSyncMetadata(key, &returned_value));
   }
 }
 
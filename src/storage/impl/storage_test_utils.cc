@@ -210,7 +210,7 @@ StorageTest::~StorageTest(){};
     std::unique_ptr<const btree::TreeNode>* node) {
   Status status;
   std::unique_ptr<const btree::TreeNode> result;
-  btree::TreeNode::FromId(GetStorage(), id,
+  btree::TreeNode::FromId(GetStorage(), id, PageStorage::Location::LOCAL,
                           callback::Capture(MakeQuitTask(), &status, &result));
   if (RunLoopWithTimeout()) {
     return ::testing::AssertionFailure()
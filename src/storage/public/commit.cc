@@ -0,0 +1,19 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/public/commit.h"
+
+namespace storage {
+
+bool Commit::TimestampOrdered(const std::unique_ptr<const Commit>& commit1,
+                              const std::unique_ptr<const Commit>& commit2) {
+  int64_t timestamp1 = commit1->GetTimestamp();
+  int64_t timestamp2 = commit2->GetTimestamp();
+  if (timestamp1 != timestamp2) {
+    return timestamp1 < timestamp2;
+  }
+  return commit1->GetId() < commit2->GetId();
+}
+
+}  // namespace storage
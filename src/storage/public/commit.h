@@ -19,6 +19,13 @@ class Commit {
   Commit() {}
   virtual ~Commit() {}
 
+  // Returns whether |commit1| is ordered before |commit2| in the canonical
+  // commit order: commits are ordered by timestamp, and commits with the same
+  // timestamp are ordered by id. As both values are part of the commits
+  // themselves, all devices agree on this order.
+  static bool TimestampOrdered(const std::unique_ptr<const Commit>& commit1,
+                               const std::unique_ptr<const Commit>& commit2);
+
   // Returns a copy of the commit.
   virtual std::unique_ptr<Commit> Clone() const = 0;
 
@@ -29,6 +36,9 @@ class Commit {
   virtual std::vector<CommitIdView> GetParentIds() const = 0;
 
   // Returns the creation timestamp of this commit in nanoseconds since epoch.
+  // The timestamp of a merge commit is not the time of the merge, but is
+  // derived from its parents, so that merging the same commits always produces
+  // the same commit.
   // TODO(nellyv): Replace return value with a time/clock type.
   virtual int64_t GetTimestamp() const = 0;
 
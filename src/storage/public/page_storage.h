@@ -38,7 +38,7 @@ class PageStorage {
   };
 
   // Location where to search an object. See |GetObject| call for usage.
-  enum Location { LOCAL, NETWORK };
+  enum Location { LOCAL, NETWORK, BACKGROUND_NETWORK };
 
   PageStorage() {}
   virtual ~PageStorage() {}
@@ -50,6 +50,10 @@ class PageStorage {
   // unset a previously set value.
   virtual void SetSyncDelegate(PageSyncDelegate* page_sync) = 0;
 
+  // Returns an estimate of the memory, in bytes, held by this page storage
+  // while it is open.
+  virtual uint64_t GetApproximateMemoryUsage() = 0;
+
   // Finds the ids of all head commits. It is guaranteed that valid pages have
   // at least one head commit, even if they are empty.
   virtual void GetHeadCommitIds(
@@ -106,6 +110,8 @@ class PageStorage {
 
   // Marks the given commit as synced.
   virtual Status MarkCommitSynced(const CommitId& commit_id) = 0;
+  // Checks whether the given commit is synced.
+  virtual Status IsCommitSynced(const CommitId& commit_id, bool* is_synced) = 0;
 
   // Finds all objects introduced by the commit with the given |commit_id| and
   // adds them in the given |objects| vector. This includes all objects present
@@ -132,7 +138,8 @@ class PageStorage {
   // an error will be returned through the given |callback|. If |location| is
   // LOCAL, only local storage will be checked. If |location| is NETWORK, then
   // a network request may be made if the requested object is not present
-  // locally.
+  // locally. BACKGROUND_NETWORK is the same as NETWORK, but the network request
+  // is served after the ones of clients waiting on their objects.
   virtual void GetObject(
       ObjectIdView object_id,
       Location location,
@@ -152,6 +159,11 @@ class PageStorage {
                                ftl::StringView value,
                                std::function<void(Status)> callback) = 0;
 
+  // Deletes the opaque sync metadata associated with this page and the given
+  // |key|.
+  virtual void DeleteSyncMetadata(ftl::StringView key,
+                                  std::function<void(Status)> callback) = 0;
+
   // Retrieves the opaque sync metadata associated with this page and the given
   // |key|.
   virtual Status GetSyncMetadata(ftl::StringView key, std::string* value) = 0;
@@ -26,6 +26,7 @@ class PageSyncDelegate {
   // client can verify that all data was streamed when draining the socket.
   virtual void GetObject(
       ObjectIdView object_id,
+      DownloadPriority priority,
       std::function<void(Status status, uint64_t size, mx::socket data)>
           callback) = 0;
 
@@ -49,6 +49,10 @@ bool operator!=(const EntryChange& lhs, const EntryChange& rhs);
 
 enum class ChangeSource { LOCAL, SYNC };
 
+// Priority of an object download. INTERACTIVE downloads have a client waiting
+// on them, and are served before BACKGROUND ones.
+enum class DownloadPriority { INTERACTIVE, BACKGROUND };
+
 enum class JournalType { IMPLICIT, EXPLICIT };
 
 enum class Status {
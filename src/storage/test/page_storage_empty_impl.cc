@@ -18,6 +18,11 @@ void PageStorageEmptyImpl::SetSyncDelegate(PageSyncDelegate* /*page_sync*/) {
   FTL_NOTIMPLEMENTED();
 }
 
+uint64_t PageStorageEmptyImpl::GetApproximateMemoryUsage() {
+  FTL_NOTIMPLEMENTED();
+  return 0u;
+}
+
 void PageStorageEmptyImpl::GetHeadCommitIds(
     std::function<void(Status, std::vector<CommitId>)> callback) {
   FTL_NOTIMPLEMENTED();
@@ -90,6 +95,12 @@ Status PageStorageEmptyImpl::MarkCommitSynced(const CommitId& /*commit_id*/) {
   return Status::NOT_IMPLEMENTED;
 }
 
+Status PageStorageEmptyImpl::IsCommitSynced(const CommitId& /*commit_id*/,
+                                            bool* /*is_synced*/) {
+  FTL_NOTIMPLEMENTED();
+  return Status::NOT_IMPLEMENTED;
+}
+
 Status PageStorageEmptyImpl::GetDeltaObjects(
     const CommitId& /*commit_id*/,
     std::vector<ObjectId>* /*objects*/) {
@@ -139,6 +150,13 @@ void PageStorageEmptyImpl::SetSyncMetadata(
   callback(Status::NOT_IMPLEMENTED);
 }
 
+void PageStorageEmptyImpl::DeleteSyncMetadata(
+    ftl::StringView /*key*/,
+    std::function<void(Status)> callback) {
+  FTL_NOTIMPLEMENTED();
+  callback(Status::NOT_IMPLEMENTED);
+}
+
 Status PageStorageEmptyImpl::GetSyncMetadata(ftl::StringView /*key*/,
                                              std::string* /*value*/) {
   FTL_NOTIMPLEMENTED();
@@ -26,6 +26,8 @@ class PageStorageEmptyImpl : public PageStorage {
 
   void SetSyncDelegate(PageSyncDelegate* page_sync) override;
 
+  uint64_t GetApproximateMemoryUsage() override;
+
   void GetHeadCommitIds(
       std::function<void(Status, std::vector<CommitId>)> callback) override;
 
@@ -63,6 +65,8 @@ class PageStorageEmptyImpl : public PageStorage {
 
   Status MarkCommitSynced(const CommitId& commit_id) override;
 
+  Status IsCommitSynced(const CommitId& commit_id, bool* is_synced) override;
+
   Status GetDeltaObjects(const CommitId& commit_id,
                          std::vector<ObjectId>* objects) override;
 
@@ -89,6 +93,9 @@ class PageStorageEmptyImpl : public PageStorage {
                        ftl::StringView value,
                        std::function<void(Status)> callback) override;
 
+  void DeleteSyncMetadata(ftl::StringView key,
+                          std::function<void(Status)> callback) override;
+
   Status GetSyncMetadata(ftl::StringView key, std::string* value) override;
 
   void GetCommitContents(const Commit& commit,
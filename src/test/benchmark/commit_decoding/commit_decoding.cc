@@ -0,0 +1,192 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/commit_decoding/commit_decoding.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <rapidjson/document.h>
+
+#include "apps/ledger/src/cloud_provider/impl/encoding.h"
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/time/time_point.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace {
+constexpr ftl::StringView kCommitCountFlag = "commit-count";
+constexpr ftl::StringView kContentSizeFlag = "content-size";
+
+constexpr size_t kIdSize = 32;
+// Number of times each decoder is run.
+constexpr size_t kSampleCount = 5;
+// Size of the chunks in which the streaming decoder receives the data,
+// emulating the reads from the network socket.
+constexpr size_t kChunkSize = 64 * 1024;
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kCommitCountFlag
+            << "=<int> --" << kContentSizeFlag << "=<int>" << std::endl;
+}
+
+bool GetPositiveIntValue(const ftl::CommandLine& command_line,
+                         ftl::StringView flag,
+                         size_t* value) {
+  std::string value_str;
+  size_t found_value;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str) ||
+      !ftl::StringToNumberWithError(value_str, &found_value) ||
+      found_value <= 0) {
+    return false;
+  }
+  *value = found_value;
+  return true;
+}
+
+double ToMegabytesPerSecond(size_t bytes, ftl::TimeDelta duration) {
+  return bytes / (1024.0 * 1024.0) / duration.ToSecondsF();
+}
+
+}  // namespace
+
+namespace test {
+namespace benchmark {
+
+CommitDecodingBenchmark::CommitDecodingBenchmark(size_t commit_count,
+                                                 size_t content_size)
+    : application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      commit_count_(commit_count),
+      content_size_(content_size) {
+  FTL_DCHECK(commit_count > 0);
+  FTL_DCHECK(content_size > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_commit_decoding"});
+}
+
+void CommitDecodingBenchmark::Run() {
+  FTL_LOG(INFO) << "--commit-count=" << commit_count_
+                << " --content-size=" << content_size_;
+  std::string json = MakeBacklog();
+  FTL_LOG(INFO) << "Backlog size: " << json.size() << " bytes";
+
+  for (size_t i = 0; i < kSampleCount; ++i) {
+    RunDocumentDecoding(json);
+    RunStreamingDecoding(json);
+  }
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+std::string CommitDecodingBenchmark::MakeBacklog() {
+  std::vector<cloud_provider::Commit> commits;
+  commits.reserve(commit_count_);
+  for (size_t i = 0; i < commit_count_; ++i) {
+    commits.emplace_back(
+        convert::ToString(generator_.MakeValue(kIdSize)),
+        convert::ToString(generator_.MakeValue(content_size_)),
+        std::map<cloud_provider::ObjectId, cloud_provider::Data>{});
+  }
+  std::string encoded;
+  bool result = cloud_provider::EncodeCommits(commits, &encoded);
+  FTL_DCHECK(result);
+
+  // Replace the timestamp placeholders with server timestamps, as the server
+  // does.
+  const std::string placeholder = "{\".sv\":\"timestamp\"}";
+  std::string json;
+  json.reserve(encoded.size());
+  int64_t timestamp = 1472722368296;
+  size_t start = 0;
+  size_t found;
+  while ((found = encoded.find(placeholder, start)) != std::string::npos) {
+    json.append(encoded, start, found - start);
+    json.append(ftl::NumberToString(timestamp++));
+    start = found + placeholder.size();
+  }
+  json.append(encoded, start, std::string::npos);
+  return json;
+}
+
+void CommitDecodingBenchmark::RunDocumentDecoding(const std::string& json) {
+  ftl::TimePoint start = ftl::TimePoint::Now();
+  size_t held_bytes;
+  std::vector<cloud_provider::Record> records;
+  {
+    TRACE_DURATION("benchmark", "document_decoding");
+    rapidjson::Document document;
+    document.Parse(json.c_str(), json.size());
+    if (document.HasParseError() || !document.IsObject() ||
+        !cloud_provider::DecodeMultipleCommitsFromValue(document, &records)) {
+      FTL_LOG(ERROR) << "Unable to decode the backlog.";
+      return;
+    }
+    // The whole response and the document are held until all the commits are
+    // decoded.
+    held_bytes = json.size() + document.GetAllocator().Size();
+  }
+  ftl::TimeDelta duration = ftl::TimePoint::Now() - start;
+  FTL_DCHECK(records.size() == commit_count_);
+  TRACE_COUNTER("benchmark", "document_decoding_held_bytes", 0, "bytes",
+                static_cast<uint64_t>(held_bytes));
+  FTL_LOG(INFO) << "Document decoding: "
+                << ToMegabytesPerSecond(json.size(), duration)
+                << " MB/s, held " << held_bytes << " bytes";
+}
+
+void CommitDecodingBenchmark::RunStreamingDecoding(const std::string& json) {
+  ftl::TimePoint start = ftl::TimePoint::Now();
+  size_t max_buffered_size = 0u;
+  std::vector<cloud_provider::Record> records;
+  {
+    TRACE_DURATION("benchmark", "streaming_decoding");
+    cloud_provider::StreamingCommitsDecoder decoder;
+    ftl::StringView data = json;
+    for (size_t i = 0; i < data.size(); i += kChunkSize) {
+      if (!decoder.Decode(data.substr(i, kChunkSize))) {
+        FTL_LOG(ERROR) << "Unable to decode the backlog.";
+        return;
+      }
+      max_buffered_size = std::max(max_buffered_size, decoder.buffered_size());
+    }
+    if (!decoder.Finish(&records)) {
+      FTL_LOG(ERROR) << "Unable to decode the backlog.";
+      return;
+    }
+  }
+  ftl::TimeDelta duration = ftl::TimePoint::Now() - start;
+  FTL_DCHECK(records.size() == commit_count_);
+  // Only the current chunk and the commit being received are held.
+  size_t held_bytes = kChunkSize + max_buffered_size;
+  TRACE_COUNTER("benchmark", "streaming_decoding_held_bytes", 0, "bytes",
+                static_cast<uint64_t>(held_bytes));
+  FTL_LOG(INFO) << "Streaming decoding: "
+                << ToMegabytesPerSecond(json.size(), duration)
+                << " MB/s, held " << held_bytes << " bytes";
+}
+
+}  // namespace benchmark
+}  // namespace test
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  size_t commit_count;
+  size_t content_size;
+  if (!GetPositiveIntValue(command_line, kCommitCountFlag, &commit_count) ||
+      !GetPositiveIntValue(command_line, kContentSizeFlag, &content_size)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  test::benchmark::CommitDecodingBenchmark app(commit_count, content_size);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
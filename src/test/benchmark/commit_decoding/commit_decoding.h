@@ -0,0 +1,53 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_COMMIT_DECODING_COMMIT_DECODING_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_COMMIT_DECODING_COMMIT_DECODING_H_
+
+#include <memory>
+#include <string>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/src/test/data_generator.h"
+#include "lib/ftl/macros.h"
+
+namespace test {
+namespace benchmark {
+
+// Benchmark that measures the cost of decoding a backlog of commits retrieved
+// from the cloud, comparing the decoding of the whole response into a JSON
+// document with the decoding of the response as it is received.
+//
+// Both decoders are run on the same backlog of |commit-count| commits. The
+// number of bytes held by each decoder, in addition to the decoded commits, is
+// logged along with the decoding throughput.
+//
+// Parameters:
+//   --commit-count=<int> the number of commits in the backlog
+//   --content-size=<int> the size of the content of a single commit in bytes
+class CommitDecodingBenchmark {
+ public:
+  CommitDecodingBenchmark(size_t commit_count, size_t content_size);
+
+  void Run();
+
+ private:
+  // Returns the JSON representation of the backlog, as Firebase returns it.
+  std::string MakeBacklog();
+
+  void RunDocumentDecoding(const std::string& json);
+  void RunStreamingDecoding(const std::string& json);
+
+  test::DataGenerator generator_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const size_t commit_count_;
+  const size_t content_size_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CommitDecodingBenchmark);
+};
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_COMMIT_DECODING_COMMIT_DECODING_H_
@@ -4,31 +4,72 @@
 
 #include "apps/ledger/src/test/benchmark/convergence/convergence.h"
 
+#include <stdlib.h>
+
 #include <iostream>
+#include <map>
 
-#include "apps/ledger/src/callback/waiter.h"
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/ledger/src/test/benchmark/lib/logging.h"
 #include "apps/ledger/src/test/get_ledger.h"
 #include "apps/tracing/lib/trace/event.h"
 #include "apps/tracing/lib/trace/provider.h"
+#include "lib/fidl/cpp/bindings/binding.h"
 #include "lib/ftl/command_line.h"
 #include "lib/ftl/files/directory.h"
-#include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/logging.h"
 #include "lib/ftl/strings/string_number_conversions.h"
 #include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/vmo/strings.h"
 
 namespace {
-constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/sync";
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/convergence";
+constexpr ftl::StringView kLedgerName = "convergence";
 constexpr ftl::StringView kEntryCountFlag = "entry-count";
 constexpr ftl::StringView kValueSizeFlag = "value-size";
-constexpr ftl::StringView kServerIdFlag = "server-id";
+constexpr ftl::StringView kDeviceCountFlag = "device-count";
+constexpr ftl::StringView kPageCountFlag = "page-count";
+constexpr ftl::StringView kWriteRateFlag = "write-rate";
+constexpr ftl::StringView kConflictRateFlag = "conflict-rate";
+constexpr ftl::StringView kLatencyFlag = "latency-ms";
+constexpr ftl::StringView kBandwidthFlag = "bandwidth";
+constexpr ftl::StringView kLossRateFlag = "loss-rate";
 
 void PrintUsage(const char* executable_name) {
   std::cout << "Usage: " << executable_name << " --" << kEntryCountFlag
-            << "=<int> --" << kValueSizeFlag << "=<int> --" << kServerIdFlag
-            << "=<string>" << std::endl;
+            << "=<int> --" << kValueSizeFlag << "=<int> [--"
+            << kDeviceCountFlag << "=<int>] [--" << kPageCountFlag
+            << "=<int>] [--" << kWriteRateFlag << "=<int>] [--"
+            << kConflictRateFlag << "=<double>] [--" << kLatencyFlag
+            << "=<int>] [--" << kBandwidthFlag << "=<int>] [--"
+            << kLossRateFlag << "=<double>]" << std::endl;
+}
+
+// Parses the optional flag |flag| into |value|, leaving it unchanged if the
+// flag is absent. Returns false if the flag is present but invalid.
+template <typename T>
+bool GetOptionalNumber(const ftl::CommandLine& command_line,
+                       ftl::StringView flag,
+                       T* value) {
+  std::string value_str;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str)) {
+    return true;
+  }
+  return ftl::StringToNumberWithError(value_str, value);
+}
+
+// Parses the optional rate flag |flag| into |value|, leaving it unchanged if
+// the flag is absent. Returns false if the flag is not a number in [0, 1).
+bool GetOptionalRate(const ftl::CommandLine& command_line,
+                     ftl::StringView flag,
+                     double* value) {
+  std::string value_str;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str)) {
+    return true;
+  }
+  char* end;
+  *value = strtod(value_str.c_str(), &end);
+  return *end == '\0' && *value >= 0.0 && *value < 1.0;
 }
 
 constexpr size_t kKeySize = 100;
@@ -38,136 +79,179 @@ constexpr size_t kKeySize = 100;
 namespace test {
 namespace benchmark {
 
+// A page, as seen by one of the devices.
+class ConvergenceBenchmark::DevicePage : public ledger::PageWatcher {
+ public:
+  explicit DevicePage(ftl::Closure on_change)
+      : on_change_(std::move(on_change)), binding_(this) {}
+  ~DevicePage() override {}
+
+  fidl::InterfaceHandle<ledger::PageWatcher> NewBinding() {
+    return binding_.NewBinding();
+  }
+
+  const std::map<std::string, std::string>& entries() const {
+    return entries_;
+  }
+
+  ledger::PagePtr page;
+
+  // ledger::PageWatcher:
+  void OnChange(ledger::PageChangePtr page_change,
+                ledger::ResultState /*result_state*/,
+                const OnChangeCallback& callback) override {
+    for (auto& change : page_change->changes) {
+      std::string value;
+      if (!mtl::StringFromVmo(change->value, &value)) {
+        FTL_LOG(ERROR) << "Unable to read the value.";
+        mtl::MessageLoop::GetCurrent()->PostQuitTask();
+        return;
+      }
+      entries_[convert::ToString(change->key)] = std::move(value);
+    }
+    callback(nullptr);
+    on_change_();
+  }
+
+ private:
+  const ftl::Closure on_change_;
+  fidl::Binding<ledger::PageWatcher> binding_;
+  std::map<std::string, std::string> entries_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(DevicePage);
+};
+
+struct ConvergenceBenchmark::Device {
+  std::unique_ptr<FakeCloudLedger> instance;
+  ledger::LedgerPtr ledger;
+  std::vector<std::unique_ptr<DevicePage>> pages;
+};
+
 ConvergenceBenchmark::ConvergenceBenchmark(int entry_count,
                                            int value_size,
-                                           std::string server_id)
+                                           int device_count,
+                                           int page_count,
+                                           int write_rate,
+                                           double conflict_rate,
+                                           ledger::NetworkConditions conditions)
     : application_context_(app::ApplicationContext::CreateFromStartupInfo()),
-      token_provider_impl_("",
-                           "sync_user",
-                           "sync_user@google.com",
-                           "client_id"),
       entry_count_(entry_count),
       value_size_(value_size),
-      server_id_(std::move(server_id)),
-      alpha_watcher_binding_(this),
-      beta_watcher_binding_(this),
-      alpha_tmp_dir_(kStoragePath),
-      beta_tmp_dir_(kStoragePath) {
+      page_count_(page_count),
+      write_rate_(write_rate),
+      conflict_distribution_(conflict_rate),
+      cloud_(conditions),
+      tmp_dir_(kStoragePath),
+      devices_(device_count),
+      expected_keys_(page_count) {
   FTL_DCHECK(entry_count > 0);
   FTL_DCHECK(value_size > 0);
+  FTL_DCHECK(device_count > 0);
+  FTL_DCHECK(page_count > 0);
+  FTL_DCHECK(write_rate >= 0);
   tracing::InitializeTracer(application_context_.get(),
                             {"benchmark_ledger_convergence"});
 }
 
+ConvergenceBenchmark::~ConvergenceBenchmark() {}
+
 void ConvergenceBenchmark::Run() {
-  // Name of the storage directory currently identifies the user. Ensure the
-  // most nested directory has the same name to make the ledgers sync.
-  std::string alpha_path = alpha_tmp_dir_.path() + "/sync_user";
-  bool ret = files::CreateDirectory(alpha_path);
-  FTL_DCHECK(ret);
-
-  std::string beta_path = beta_tmp_dir_.path() + "/sync_user";
-  ret = files::CreateDirectory(beta_path);
-  FTL_DCHECK(ret);
-
-  ledger::Status status = test::GetLedger(
-      mtl::MessageLoop::GetCurrent(), application_context_.get(),
-      &alpha_controller_, &token_provider_impl_, "sync", alpha_path,
-      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &alpha_ledger_);
-  QuitOnError(status, "alpha ledger");
-  status = test::GetLedger(
-      mtl::MessageLoop::GetCurrent(), application_context_.get(),
-      &beta_controller_, &token_provider_impl_, "sync", beta_path,
-      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &beta_ledger_);
-  QuitOnError(status, "beta ledger");
+  std::vector<fidl::Array<uint8_t>> page_ids(page_count_);
+  for (size_t i = 0; i < devices_.size(); ++i) {
+    // Each device has its own storage.
+    std::string path = tmp_dir_.path() + "/" + ftl::NumberToString(i);
+    bool ret = files::CreateDirectory(path);
+    FTL_DCHECK(ret);
 
-  ledger::PagePtr page;
-  fidl::Array<uint8_t> id;
-  status = test::GetPageEnsureInitialized(mtl::MessageLoop::GetCurrent(),
-                                          &alpha_ledger_, nullptr, &page, &id);
-  QuitOnError(status, "alpha page initialization");
-  page_id_ = id.Clone();
-  alpha_page_ = std::move(page);
-  beta_ledger_->GetPage(std::move(id), beta_page_.NewRequest(),
-                        benchmark::QuitOnErrorCallback("GetPage"));
-
-  // Register both watchers. We don't actually need the snapshots.
-  auto waiter =
-      callback::StatusWaiter<ledger::Status>::Create(ledger::Status::OK);
-  ledger::PageSnapshotPtr alpha_snapshot;
-  alpha_page_->GetSnapshot(alpha_snapshot.NewRequest(), nullptr,
-                           alpha_watcher_binding_.NewBinding(),
-                           waiter->NewCallback());
-  ledger::PageSnapshotPtr beta_snapshot;
-  beta_page_->GetSnapshot(beta_snapshot.NewRequest(), nullptr,
-                          beta_watcher_binding_.NewBinding(),
-                          waiter->NewCallback());
-  waiter->Finalize([this](ledger::Status status) {
-    if (benchmark::QuitOnError(status, "GetSnapshot")) {
+    devices_[i] = std::make_unique<Device>();
+    Device* device = devices_[i].get();
+    device->instance = std::make_unique<FakeCloudLedger>(&cloud_, path);
+    ledger::Status status =
+        device->instance->GetLedger(kLedgerName.ToString(), &device->ledger);
+    if (QuitOnError(status, "GetLedger")) {
       return;
     }
-    Start(0);
-  });
-}
 
-void ConvergenceBenchmark::Start(int step) {
-  if (step == entry_count_) {
-    ShutDown();
-    return;
+    for (auto& page_id : page_ids) {
+      auto page = std::make_unique<DevicePage>([this] { CheckConvergence(); });
+      // The first device creates the pages.
+      status = test::GetPageEnsureInitialized(
+          mtl::MessageLoop::GetCurrent(), &device->ledger, page_id.Clone(),
+          &page->page, &page_id);
+      if (QuitOnError(status, "GetPage")) {
+        return;
+      }
+      ledger::PageSnapshotPtr snapshot;
+      page->page->GetSnapshot(snapshot.NewRequest(), nullptr,
+                              page->NewBinding(),
+                              QuitOnErrorCallback("GetSnapshot"));
+      device->pages.push_back(std::move(page));
+    }
   }
 
-  {
-    fidl::Array<uint8_t> key = generator_.MakeKey(2 * step, kKeySize);
-    // Insert each key twice, as we will receive two notifications - one on the
-    // sender side (each page client sees their own changes), and one on the
-    // receiving side.
-    remaining_keys_.insert(convert::ToString(key));
-    remaining_keys_.insert(convert::ToString(key));
-    fidl::Array<uint8_t> value = generator_.MakeValue(value_size_);
-    alpha_page_->Put(std::move(key), std::move(value),
-                     benchmark::QuitOnErrorCallback("Put"));
+  TRACE_ASYNC_BEGIN("benchmark", "convergence", 0);
+  for (int i = 0; i < entry_count_; ++i) {
+    if (write_rate_ == 0) {
+      Write(i);
+      continue;
+    }
+    mtl::MessageLoop::GetCurrent()->task_runner()->PostDelayedTask(
+        [this, i] { Write(i); },
+        ftl::TimeDelta::FromMicroseconds(i * 1000000ll / write_rate_));
   }
+}
 
-  {
-    fidl::Array<uint8_t> key = generator_.MakeKey(2 * step + 1, kKeySize);
-    // Insert each key twice, as we will receive two notifications - one on the
-    // sender side (each page client sees their own changes), and one on the
-    // receiving side.
-    remaining_keys_.insert(convert::ToString(key));
-    remaining_keys_.insert(convert::ToString(key));
-    fidl::Array<uint8_t> value = generator_.MakeValue(value_size_);
-    beta_page_->Put(std::move(key), std::move(value),
-                    benchmark::QuitOnErrorCallback("Put"));
+void ConvergenceBenchmark::Write(int index) {
+  // The writes of a device go to each page in turn.
+  size_t page_index = index % page_count_;
+  std::unordered_set<std::string>& page_keys = expected_keys_[page_index];
+  fidl::Array<uint8_t> conflicting_key;
+  if (conflict_distribution_(rng_)) {
+    // All the devices write the same key.
+    conflicting_key = generator_.MakeKey(index * devices_.size(), kKeySize);
+    page_keys.insert(convert::ToString(conflicting_key));
   }
-
-  TRACE_ASYNC_BEGIN("benchmark", "convergence", step);
-  // Persist the current step, so that we know which async event to end in
-  // OnChange().
-  current_step_ = step;
+  for (size_t i = 0; i < devices_.size(); ++i) {
+    fidl::Array<uint8_t> key =
+        conflicting_key ? conflicting_key.Clone()
+                        : generator_.MakeKey(index * devices_.size() + i,
+                                             kKeySize);
+    page_keys.insert(convert::ToString(key));
+    devices_[i]->pages[page_index]->page->Put(
+        std::move(key), generator_.MakeValue(value_size_),
+        QuitOnErrorCallback("Put"));
+  }
+  ++write_count_;
+  CheckConvergence();
 }
 
-void ConvergenceBenchmark::OnChange(ledger::PageChangePtr page_change,
-                                    ledger::ResultState result_state,
-                                    const OnChangeCallback& callback) {
-  FTL_DCHECK(result_state == ledger::ResultState::COMPLETED);
-  for (auto& change : page_change->changes) {
-    auto find_one = remaining_keys_.find(convert::ToString(change->key));
-    remaining_keys_.erase(find_one);
+void ConvergenceBenchmark::CheckConvergence() {
+  if (converged_ || write_count_ < entry_count_ || !IsConverged()) {
+    return;
   }
-  if (remaining_keys_.empty()) {
-    TRACE_ASYNC_END("benchmark", "convergence", current_step_);
-    Start(current_step_ + 1);
+  converged_ = true;
+  TRACE_ASYNC_END("benchmark", "convergence", 0);
+  ShutDown();
+}
+
+bool ConvergenceBenchmark::IsConverged() const {
+  for (int page_index = 0; page_index < page_count_; ++page_index) {
+    const std::map<std::string, std::string>& reference =
+        devices_[0]->pages[page_index]->entries();
+    if (reference.size() != expected_keys_[page_index].size()) {
+      return false;
+    }
+    for (size_t i = 1; i < devices_.size(); ++i) {
+      if (devices_[i]->pages[page_index]->entries() != reference) {
+        return false;
+      }
+    }
   }
-  callback(nullptr);
+  return true;
 }
 
 void ConvergenceBenchmark::ShutDown() {
-  alpha_controller_->Kill();
-  alpha_controller_.WaitForIncomingResponseWithTimeout(
-      ftl::TimeDelta::FromSeconds(5));
-  beta_controller_->Kill();
-  beta_controller_.WaitForIncomingResponseWithTimeout(
-      ftl::TimeDelta::FromSeconds(5));
+  // The devices are deleted along with the benchmark, once the loop quits.
   mtl::MessageLoop::GetCurrent()->PostQuitTask();
 }
 }  // namespace benchmark
@@ -180,7 +264,12 @@ int main(int argc, const char** argv) {
   int entry_count;
   std::string value_size_str;
   int value_size;
-  std::string server_id;
+  int device_count = 2;
+  int page_count = 1;
+  int write_rate = 0;
+  double conflict_rate = 0.0;
+  int latency_ms = 0;
+  ledger::NetworkConditions conditions;
   if (!command_line.GetOptionValue(kEntryCountFlag.ToString(),
                                    &entry_count_str) ||
       !ftl::StringToNumberWithError(entry_count_str, &entry_count) ||
@@ -189,13 +278,28 @@ int main(int argc, const char** argv) {
                                    &value_size_str) ||
       !ftl::StringToNumberWithError(value_size_str, &value_size) ||
       value_size <= 0 ||
-      !command_line.GetOptionValue(kServerIdFlag.ToString(), &server_id)) {
+      !GetOptionalNumber(command_line, kDeviceCountFlag, &device_count) ||
+      device_count <= 0 ||
+      !GetOptionalNumber(command_line, kPageCountFlag, &page_count) ||
+      page_count <= 0 ||
+      !GetOptionalNumber(command_line, kWriteRateFlag, &write_rate) ||
+      write_rate < 0 ||
+      !GetOptionalRate(command_line, kConflictRateFlag, &conflict_rate) ||
+      !GetOptionalNumber(command_line, kLatencyFlag, &latency_ms) ||
+      latency_ms < 0 ||
+      !GetOptionalNumber(command_line, kBandwidthFlag,
+                         &conditions.bandwidth) ||
+      !GetOptionalRate(command_line, kLossRateFlag, &conditions.loss_rate)) {
     PrintUsage(argv[0]);
     return -1;
   }
+  conditions.latency = ftl::TimeDelta::FromMilliseconds(latency_ms);
 
   mtl::MessageLoop loop;
-  test::benchmark::ConvergenceBenchmark app(entry_count, value_size, server_id);
+  test::benchmark::ConvergenceBenchmark app(entry_count, value_size,
+                                            device_count, page_count,
+                                            write_rate, conflict_rate,
+                                            conditions);
   loop.task_runner()->PostTask([&app] { app.Run(); });
   loop.Run();
   return 0;
@@ -6,13 +6,15 @@
 #define APPS_LEDGER_SRC_TEST_BENCHMARK_CONVERGENCE_CONVERGENCE_H_
 
 #include <memory>
+#include <random>
 #include <unordered_set>
+#include <vector>
 
 #include "application/lib/app/application_context.h"
 #include "apps/ledger/services/public/ledger.fidl.h"
-#include "apps/ledger/src/fidl_helpers/bound_interface_set.h"
+#include "apps/ledger/src/test/benchmark/lib/fake_cloud_ledger.h"
+#include "apps/ledger/src/test/cloud_server/network_conditions.h"
 #include "apps/ledger/src/test/data_generator.h"
-#include "apps/ledger/src/test/fake_token_provider.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
 
 namespace test {
@@ -21,51 +23,70 @@ namespace benchmark {
 // Benchmark that measures the time it takes to sync and reconcile concurrent
 // writes.
 //
-// In this scenario there is two devices. At each step, both devices make a
-// concurrent write, and we measure the time until both changes are visible to
-// both devices.
+// In this scenario, devices running in-process sync a set of pages through the
+// fake cloud. Each device writes entries on all the pages concurrently, and we
+// measure the time from the first write until all the devices have the same
+// content on all the pages.
+//
+// The merge commits made and the memory used by each page of each device are
+// recorded by the "page_storage" counter of the "ledger" trace category, and
+// the bytes transferred by the "network" counter of the "cloud_server" one.
 //
 // Parameters:
 //   --entry-count=<int> the number of entries to be put by each device
 //   --value-size=<int> the size of a single value in bytes
-//   --server-id=<string> the ID of the Firebase instance ot use for syncing
-class ConvergenceBenchmark : public ledger::PageWatcher {
+//   --device-count=<int> (optional) the number of devices, 2 by default
+//   --page-count=<int> (optional) the number of pages, 1 by default
+//   --write-rate=<int> (optional) the number of writes per second of each
+//     device, spread over the pages. 0, the default, writes all the entries at
+//     once
+//   --conflict-rate=<double> (optional) the fraction of the writes that write
+//     a key also written concurrently by all the other devices
+//   --latency-ms=<int> (optional) the latency of the simulated network
+//   --bandwidth=<int> (optional) the bandwidth of the simulated network in
+//     bytes per second, in each direction
+//   --loss-rate=<double> (optional) the fraction of the requests that are lost
+class ConvergenceBenchmark {
  public:
-  ConvergenceBenchmark(int entry_count, int value_size, std::string server_id);
+  ConvergenceBenchmark(int entry_count,
+                       int value_size,
+                       int device_count,
+                       int page_count,
+                       int write_rate,
+                       double conflict_rate,
+                       ledger::NetworkConditions conditions);
+  ~ConvergenceBenchmark();
 
   void Run();
 
-  // ledger::PageWatcher:
-  void OnChange(ledger::PageChangePtr page_change,
-                ledger::ResultState result_state,
-                const OnChangeCallback& callback) override;
-
  private:
-  void Start(int step);
+  class DevicePage;
+  struct Device;
+
+  // Makes the |index|-th write of each device.
+  void Write(int index);
+  // Ends the benchmark if all the writes are done and all the devices have the
+  // same content.
+  void CheckConvergence();
+  bool IsConverged() const;
 
   void ShutDown();
 
   test::DataGenerator generator_;
   std::unique_ptr<app::ApplicationContext> application_context_;
-  ledger::fidl_helpers::BoundInterfaceSet<modular::auth::TokenProvider,
-                                          test::FakeTokenProvider>
-      token_provider_impl_;
   const int entry_count_;
   const int value_size_;
-  std::string server_id_;
-  fidl::Binding<ledger::PageWatcher> alpha_watcher_binding_;
-  fidl::Binding<ledger::PageWatcher> beta_watcher_binding_;
-  files::ScopedTempDir alpha_tmp_dir_;
-  files::ScopedTempDir beta_tmp_dir_;
-  app::ApplicationControllerPtr alpha_controller_;
-  app::ApplicationControllerPtr beta_controller_;
-  ledger::LedgerPtr alpha_ledger_;
-  ledger::LedgerPtr beta_ledger_;
-  fidl::Array<uint8_t> page_id_;
-  ledger::PagePtr alpha_page_;
-  ledger::PagePtr beta_page_;
-  std::unordered_multiset<std::string> remaining_keys_;
-  int current_step_ = -1;
+  const int page_count_;
+  const int write_rate_;
+  std::default_random_engine rng_;
+  std::bernoulli_distribution conflict_distribution_;
+  FakeCloud cloud_;
+  files::ScopedTempDir tmp_dir_;
+  std::vector<std::unique_ptr<Device>> devices_;
+  // Keys expected on each page once all the writes are done.
+  std::vector<std::unordered_set<std::string>> expected_keys_;
+  int write_count_ = 0;
+  bool converged_ = false;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(ConvergenceBenchmark);
 };
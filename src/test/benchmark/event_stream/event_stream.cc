@@ -0,0 +1,147 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/event_stream/event_stream.h"
+
+#include <iostream>
+
+#include <rapidjson/document.h>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/firebase/encoding.h"
+#include "apps/ledger/src/glue/socket/socket_pair.h"
+#include "apps/ledger/src/glue/socket/socket_writer.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/concatenate.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace {
+constexpr ftl::StringView kEventCountFlag = "event-count";
+constexpr ftl::StringView kContentSizeFlag = "content-size";
+
+constexpr size_t kIdSize = 32;
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kEventCountFlag
+            << "=<int> --" << kContentSizeFlag << "=<int>" << std::endl;
+}
+
+bool GetPositiveIntValue(const ftl::CommandLine& command_line,
+                         ftl::StringView flag,
+                         size_t* value) {
+  std::string value_str;
+  size_t found_value;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str) ||
+      !ftl::StringToNumberWithError(value_str, &found_value) ||
+      found_value <= 0) {
+    return false;
+  }
+  *value = found_value;
+  return true;
+}
+
+}  // namespace
+
+namespace test {
+namespace benchmark {
+
+EventStreamBenchmark::EventStreamBenchmark(size_t event_count,
+                                           size_t content_size)
+    : application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      event_count_(event_count),
+      content_size_(content_size) {
+  FTL_DCHECK(event_count > 0);
+  FTL_DCHECK(content_size > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_event_stream"});
+}
+
+void EventStreamBenchmark::Run() {
+  FTL_LOG(INFO) << "--event-count=" << event_count_
+                << " --content-size=" << content_size_;
+  std::string stream = MakeStream();
+  stream_size_ = stream.size();
+
+  glue::SocketPair socket_pair;
+  event_stream_ = std::make_unique<firebase::EventStream>();
+  start_time_ = ftl::TimePoint::Now();
+  TRACE_ASYNC_BEGIN("benchmark", "event_stream", 0);
+  event_stream_->Start(
+      std::move(socket_pair.socket2),
+      [this](firebase::Status status, const std::string& event,
+             std::string* data) { OnEvent(status, event, data); },
+      [this] { OnComplete(); });
+  // StringSocketWriter deletes itself when done.
+  auto writer = new glue::StringSocketWriter();
+  writer->Start(std::move(stream), std::move(socket_pair.socket1));
+}
+
+std::string EventStreamBenchmark::MakeStream() {
+  std::string stream;
+  for (size_t i = 0; i < event_count_; ++i) {
+    std::string id =
+        firebase::EncodeKey(convert::ToString(generator_.MakeValue(kIdSize)));
+    std::string content = firebase::EncodeValue(
+        convert::ToString(generator_.MakeValue(content_size_)));
+    stream.append(ftl::Concatenate(
+        {"event: put\ndata: {\"path\":\"/", id, "\",\"data\":{\"id\":\"", id,
+         "\",\"content\":\"", content, "\",\"timestamp\":",
+         ftl::NumberToString(1472722368296 + i), "}}\n\n"}));
+  }
+  return stream;
+}
+
+void EventStreamBenchmark::OnEvent(firebase::Status status,
+                                   const std::string& event,
+                                   std::string* data) {
+  FTL_DCHECK(status == firebase::Status::OK);
+  FTL_DCHECK(event == "put");
+  // Parse the payload as FirebaseImpl does.
+  rapidjson::Document parsed_data;
+  parsed_data.ParseInsitu(&(*data)[0]);
+  if (parsed_data.HasParseError() || !parsed_data.IsObject()) {
+    FTL_LOG(ERROR) << "Unable to parse the event payload.";
+    return;
+  }
+  ++received_events_;
+}
+
+void EventStreamBenchmark::OnComplete() {
+  TRACE_ASYNC_END("benchmark", "event_stream", 0);
+  double seconds = (ftl::TimePoint::Now() - start_time_).ToSecondsF();
+  if (received_events_ != event_count_) {
+    FTL_LOG(ERROR) << "Received " << received_events_ << " events out of "
+                   << event_count_;
+  }
+  FTL_LOG(INFO) << "Processed " << received_events_ / seconds
+                << " events/s, " << stream_size_ / (1024.0 * 1024.0) / seconds
+                << " MB/s";
+  event_stream_.reset();
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+}  // namespace test
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  size_t event_count;
+  size_t content_size;
+  if (!GetPositiveIntValue(command_line, kEventCountFlag, &event_count) ||
+      !GetPositiveIntValue(command_line, kContentSizeFlag, &content_size)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  test::benchmark::EventStreamBenchmark app(event_count, content_size);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
@@ -0,0 +1,60 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_EVENT_STREAM_EVENT_STREAM_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_EVENT_STREAM_EVENT_STREAM_H_
+
+#include <memory>
+#include <string>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/src/firebase/event_stream.h"
+#include "apps/ledger/src/test/data_generator.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace test {
+namespace benchmark {
+
+// Benchmark that measures the throughput of the parsing of a stream of
+// Firebase events, as received by a cloud watcher on a busy page.
+//
+// The stream is made of |event-count| "put" events, each carrying a commit
+// notification. The payload of each event is parsed as JSON, as FirebaseImpl
+// does. The number of events processed per second is logged.
+//
+// Parameters:
+//   --event-count=<int> the number of events in the stream
+//   --content-size=<int> the size of the content of each commit in bytes
+class EventStreamBenchmark {
+ public:
+  EventStreamBenchmark(size_t event_count, size_t content_size);
+
+  void Run();
+
+ private:
+  // Returns the stream of events, as Firebase sends it.
+  std::string MakeStream();
+
+  void OnEvent(firebase::Status status,
+               const std::string& event,
+               std::string* data);
+  void OnComplete();
+
+  test::DataGenerator generator_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const size_t event_count_;
+  const size_t content_size_;
+  size_t stream_size_ = 0;
+  size_t received_events_ = 0;
+  ftl::TimePoint start_time_;
+  std::unique_ptr<firebase::EventStream> event_stream_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(EventStreamBenchmark);
+};
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_EVENT_STREAM_EVENT_STREAM_H_
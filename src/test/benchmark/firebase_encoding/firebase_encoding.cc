@@ -0,0 +1,181 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/firebase_encoding/firebase_encoding.h"
+
+#include <iostream>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/firebase/encoding.h"
+#include "apps/ledger/src/glue/crypto/base64.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/strings/utf_codecs.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace {
+constexpr ftl::StringView kInputCountFlag = "input-count";
+constexpr ftl::StringView kInputSizeFlag = "input-size";
+
+// Number of times each implementation is run.
+constexpr size_t kSampleCount = 10;
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kInputCountFlag
+            << "=<int> --" << kInputSizeFlag << "=<int>" << std::endl;
+}
+
+bool GetPositiveIntValue(const ftl::CommandLine& command_line,
+                         ftl::StringView flag,
+                         size_t* value) {
+  std::string value_str;
+  size_t found_value;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str) ||
+      !ftl::StringToNumberWithError(value_str, &found_value) ||
+      found_value <= 0) {
+    return false;
+  }
+  *value = found_value;
+  return true;
+}
+
+// Reference implementation of firebase::EncodeKey(), checking each condition
+// in a separate pass and copying the data.
+std::string ReferenceEncodeKey(ftl::StringView bytes) {
+  bool verbatim = ftl::IsStringUTF8(bytes);
+  for (const char& byte : bytes) {
+    if ((0 <= byte && byte <= 31) || byte == 127 || byte == '\"' ||
+        byte == '\\') {
+      verbatim = false;
+    }
+  }
+  if (bytes.find_first_of(std::string(".$#[]/+")) != std::string::npos) {
+    verbatim = false;
+  }
+  if (verbatim) {
+    return bytes.ToString() + "V";
+  }
+  return glue::Base64UrlEncode(bytes) + "B";
+}
+
+// Reference implementation of firebase::Decode().
+bool ReferenceDecode(ftl::StringView input, std::string* output) {
+  if (input.empty()) {
+    return false;
+  }
+  ftl::StringView data = input.substr(0, input.size() - 1);
+  if (input.back() == 'V') {
+    *output = data.ToString();
+    return true;
+  }
+  if (input.back() == 'B') {
+    return glue::Base64UrlDecode(data, output);
+  }
+  return false;
+}
+
+}  // namespace
+
+namespace test {
+namespace benchmark {
+
+FirebaseEncodingBenchmark::FirebaseEncodingBenchmark(size_t input_count,
+                                                     size_t input_size)
+    : application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      input_count_(input_count),
+      input_size_(input_size) {
+  FTL_DCHECK(input_count > 0);
+  FTL_DCHECK(input_size > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_firebase_encoding"});
+}
+
+void FirebaseEncodingBenchmark::Run() {
+  FTL_LOG(INFO) << "--input-count=" << input_count_
+                << " --input-size=" << input_size_;
+  inputs_.reserve(input_count_);
+  for (size_t i = 0; i < input_count_; ++i) {
+    inputs_.push_back(convert::ToString(
+        i % 2 == 0 ? generator_.MakeCompressibleValue(input_size_)
+                   : generator_.MakeValue(input_size_)));
+  }
+  std::vector<std::string> encoded;
+  encoded.reserve(input_count_);
+  for (const auto& input : inputs_) {
+    encoded.push_back(firebase::EncodeKey(input));
+  }
+
+  for (size_t i = 0; i < kSampleCount; ++i) {
+    RunReferenceEncoding();
+    RunEncoding();
+    RunReferenceDecoding(encoded);
+    RunDecoding(encoded);
+  }
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+void FirebaseEncodingBenchmark::RunReferenceEncoding() {
+  size_t total_size = 0;
+  TRACE_DURATION("benchmark", "reference_encode");
+  for (const auto& input : inputs_) {
+    total_size += ReferenceEncodeKey(input).size();
+  }
+  FTL_DCHECK(total_size > 0);
+}
+
+void FirebaseEncodingBenchmark::RunEncoding() {
+  size_t total_size = 0;
+  TRACE_DURATION("benchmark", "encode");
+  std::string output;
+  for (const auto& input : inputs_) {
+    output.clear();
+    firebase::AppendEncodedKey(input, &output);
+    total_size += output.size();
+  }
+  FTL_DCHECK(total_size > 0);
+}
+
+void FirebaseEncodingBenchmark::RunReferenceDecoding(
+    const std::vector<std::string>& encoded) {
+  TRACE_DURATION("benchmark", "reference_decode");
+  std::string output;
+  for (const auto& input : encoded) {
+    bool result = ReferenceDecode(input, &output);
+    FTL_DCHECK(result);
+  }
+}
+
+void FirebaseEncodingBenchmark::RunDecoding(
+    const std::vector<std::string>& encoded) {
+  TRACE_DURATION("benchmark", "decode");
+  std::string output;
+  for (const auto& input : encoded) {
+    bool result = firebase::Decode(input, &output);
+    FTL_DCHECK(result);
+  }
+}
+
+}  // namespace benchmark
+}  // namespace test
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  size_t input_count;
+  size_t input_size;
+  if (!GetPositiveIntValue(command_line, kInputCountFlag, &input_count) ||
+      !GetPositiveIntValue(command_line, kInputSizeFlag, &input_size)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  test::benchmark::FirebaseEncodingBenchmark app(input_count, input_size);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
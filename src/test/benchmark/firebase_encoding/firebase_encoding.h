@@ -0,0 +1,53 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_FIREBASE_ENCODING_FIREBASE_ENCODING_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_FIREBASE_ENCODING_FIREBASE_ENCODING_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/src/test/data_generator.h"
+#include "lib/ftl/macros.h"
+
+namespace test {
+namespace benchmark {
+
+// Benchmark that measures the time taken to encode and decode Firebase keys
+// and values, comparing the implementation in firebase/encoding.h with the
+// reference multi-pass implementation it replaced.
+//
+// Half of the inputs are text, that is encoded verbatim, and the other half
+// are random bytes, that are encoded in base64.
+//
+// Parameters:
+//   --input-count=<int> the number of inputs to encode
+//   --input-size=<int> the size of a single input in bytes
+class FirebaseEncodingBenchmark {
+ public:
+  FirebaseEncodingBenchmark(size_t input_count, size_t input_size);
+
+  void Run();
+
+ private:
+  void RunReferenceEncoding();
+  void RunEncoding();
+  void RunReferenceDecoding(const std::vector<std::string>& encoded);
+  void RunDecoding(const std::vector<std::string>& encoded);
+
+  test::DataGenerator generator_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const size_t input_count_;
+  const size_t input_size_;
+  std::vector<std::string> inputs_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FirebaseEncodingBenchmark);
+};
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_FIREBASE_ENCODING_FIREBASE_ENCODING_H_
@@ -0,0 +1,411 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/get/get.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/test/benchmark/lib/logging.h"
+#include "apps/ledger/src/test/get_ledger.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/random/rand.h"
+#include "lib/ftl/strings/concatenate.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/vmo/strings.h"
+
+namespace {
+
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/get";
+
+constexpr ftl::StringView kEntryCountFlag = "entry-count";
+constexpr ftl::StringView kKeySizeFlag = "key-size";
+constexpr ftl::StringView kValueSizeFlag = "value-size";
+constexpr ftl::StringView kScanCountFlag = "scan-count";
+constexpr ftl::StringView kSelectivityFlag = "selectivity";
+constexpr ftl::StringView kLazyFlag = "lazy";
+constexpr ftl::StringView kSeedFlag = "seed";
+
+constexpr size_t kMaxInlineDataSize = MX_CHANNEL_MAX_MSG_BYTES * 9 / 10;
+
+// Prefixes of the keys matching, or not, the listings.
+constexpr ftl::StringView kMatchingPrefix = "m";
+constexpr ftl::StringView kOtherPrefix = "o";
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kEntryCountFlag
+            << "=<int> --" << kKeySizeFlag << "=<int> --" << kValueSizeFlag
+            << "=<int> [--" << kScanCountFlag << "=<int>] [--"
+            << kSelectivityFlag << "=<int>] [--" << kLazyFlag << "=<int>] [--"
+            << kSeedFlag << "=<int>]" << std::endl;
+}
+
+bool GetPositiveIntValue(const ftl::CommandLine& command_line,
+                         ftl::StringView flag,
+                         int* value) {
+  std::string value_str;
+  int found_value;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str) ||
+      !ftl::StringToNumberWithError(value_str, &found_value) ||
+      found_value <= 0) {
+    return false;
+  }
+  *value = found_value;
+  return true;
+}
+
+// Reads the optional percentage |flag| into |value|, leaving it unchanged if
+// the flag is absent.
+bool GetPercentageValue(const ftl::CommandLine& command_line,
+                        ftl::StringView flag,
+                        int* value) {
+  std::string value_str;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str)) {
+    return true;
+  }
+  int found_value;
+  if (!ftl::StringToNumberWithError(value_str, &found_value) ||
+      found_value < 0 || found_value > 100) {
+    return false;
+  }
+  *value = found_value;
+  return true;
+}
+
+}  // namespace
+
+namespace test {
+namespace benchmark {
+
+GetBenchmark::GetBenchmark(int entry_count,
+                           int key_size,
+                           int value_size,
+                           int scan_count,
+                           int selectivity,
+                           int lazy_percentage,
+                           uint64_t seed)
+    : generator_(seed),
+      rng_(seed),
+      tmp_dir_(kStoragePath),
+      application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      token_provider_impl_("",
+                           "sync_user",
+                           "sync_user@google.com",
+                           "client_id"),
+      entry_count_(entry_count),
+      key_size_(key_size),
+      value_size_(value_size),
+      scan_count_(scan_count),
+      selectivity_(selectivity),
+      lazy_percentage_(lazy_percentage),
+      inline_values_(static_cast<size_t>(value_size) <= kMaxInlineDataSize) {
+  FTL_DCHECK(entry_count > 0);
+  FTL_DCHECK(key_size > 1);
+  FTL_DCHECK(value_size > 0);
+  FTL_DCHECK(scan_count > 0);
+  FTL_DCHECK(selectivity >= 0 && selectivity <= 100);
+  FTL_DCHECK(lazy_percentage >= 0 && lazy_percentage <= 100);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_get"});
+}
+
+void GetBenchmark::Run() {
+  FTL_LOG(INFO) << "--entry-count=" << entry_count_
+                << " --key-size=" << key_size_
+                << " --value-size=" << value_size_
+                << " --scan-count=" << scan_count_
+                << " --selectivity=" << selectivity_
+                << " --lazy=" << lazy_percentage_;
+  ledger::LedgerPtr ledger;
+  ledger::Status status = test::GetLedger(
+      mtl::MessageLoop::GetCurrent(), application_context_.get(),
+      &application_controller_, &token_provider_impl_, "get", tmp_dir_.path(),
+      test::SyncState::DISABLED, "", &ledger);
+  QuitOnError(status, "GetLedger");
+
+  fidl::Array<uint8_t> id;
+  status = test::GetPageEnsureInitialized(mtl::MessageLoop::GetCurrent(),
+                                          &ledger, nullptr, &page_, &id);
+  QuitOnError(status, "GetPageEnsureInitialized");
+
+  keys_.reserve(entry_count_);
+  for (int i = 0; i < entry_count_; ++i) {
+    // Spread the entries matching the prefix over the whole page.
+    ftl::StringView prefix =
+        i % 100 < selectivity_ ? kMatchingPrefix : kOtherPrefix;
+    keys_.push_back(convert::ToArray(ftl::Concatenate(
+        {prefix, convert::ExtendedStringView(
+                     generator_.MakeKey(i, key_size_ - prefix.size()))})));
+  }
+
+  page_->StartTransaction([this](ledger::Status status) {
+    if (benchmark::QuitOnError(status, "Page::StartTransaction")) {
+      return;
+    }
+    AddEntries(0, [this] {
+      page_->Commit([this](ledger::Status status) {
+        if (benchmark::QuitOnError(status, "Page::Commit")) {
+          return;
+        }
+        GetSnapshots();
+      });
+    });
+  });
+}
+
+void GetBenchmark::AddEntries(int i, ftl::Closure on_done) {
+  if (i == entry_count_) {
+    on_done();
+    return;
+  }
+  ledger::Priority priority = i % 100 < lazy_percentage_
+                                  ? ledger::Priority::LAZY
+                                  : ledger::Priority::EAGER;
+  fidl::Array<uint8_t> value = generator_.MakeValue(value_size_);
+  auto next = [this, i, on_done](ledger::Status status) {
+    if (benchmark::QuitOnError(status, "Page::Put")) {
+      return;
+    }
+    AddEntries(i + 1, on_done);
+  };
+  if (inline_values_) {
+    page_->PutWithPriority(keys_[i].Clone(), std::move(value), priority, next);
+    return;
+  }
+  mx::vmo vmo;
+  FTL_CHECK(mtl::VmoFromString(convert::ToString(value), &vmo));
+  page_->CreateReferenceFromVmo(
+      std::move(vmo),
+      [this, i, priority, next](ledger::Status status,
+                                ledger::ReferencePtr reference) {
+        if (benchmark::QuitOnError(status, "Page::CreateReferenceFromVmo")) {
+          return;
+        }
+        page_->PutReference(keys_[i].Clone(), std::move(reference), priority,
+                            next);
+      });
+}
+
+void GetBenchmark::GetSnapshots() {
+  page_->GetSnapshot(snapshot_.NewRequest(), nullptr, nullptr,
+                     benchmark::QuitOnErrorCallback("Page::GetSnapshot"));
+  fidl::Array<uint8_t> prefix;
+  if (selectivity_ < 100) {
+    prefix = convert::ToArray(kMatchingPrefix);
+  }
+  page_->GetSnapshot(prefix_snapshot_.NewRequest(), std::move(prefix), nullptr,
+                     [this](ledger::Status status) {
+                       if (benchmark::QuitOnError(status,
+                                                  "Page::GetSnapshot")) {
+                         return;
+                       }
+                       std::shuffle(keys_.begin(), keys_.end(), rng_);
+                       RunPointReads(PointRead::GET, 0, [this] {
+                         RunPointReads(PointRead::GET_INLINE, 0, [this] {
+                           RunPointReads(PointRead::FETCH_PARTIAL, 0, [this] {
+                             RunScans(Scan::GET_ENTRIES, 0, [this] {
+                               RunScans(Scan::GET_ENTRIES_INLINE, 0, [this] {
+                                 RunScans(Scan::GET_KEYS, 0,
+                                          [this] { ShutDown(); });
+                               });
+                             });
+                           });
+                         });
+                       });
+                     });
+}
+
+void GetBenchmark::RunPointReads(PointRead method,
+                                 size_t i,
+                                 ftl::Closure on_done) {
+  if (i == keys_.size() ||
+      (method == PointRead::GET_INLINE && !inline_values_)) {
+    on_done();
+    return;
+  }
+
+  auto next = [this, method, i, on_done] {
+    RunPointReads(method, i + 1, on_done);
+  };
+  switch (method) {
+    case PointRead::GET:
+      TRACE_ASYNC_BEGIN("benchmark", "get", i);
+      snapshot_->Get(keys_[i].Clone(),
+                     [i, next](ledger::Status status, mx::vmo /*value*/) {
+                       if (benchmark::QuitOnError(status,
+                                                  "PageSnapshot::Get")) {
+                         return;
+                       }
+                       TRACE_ASYNC_END("benchmark", "get", i);
+                       next();
+                     });
+      break;
+    case PointRead::GET_INLINE:
+      TRACE_ASYNC_BEGIN("benchmark", "get_inline", i);
+      snapshot_->GetInline(
+          keys_[i].Clone(),
+          [i, next](ledger::Status status, fidl::Array<uint8_t> /*value*/) {
+            if (benchmark::QuitOnError(status, "PageSnapshot::GetInline")) {
+              return;
+            }
+            TRACE_ASYNC_END("benchmark", "get_inline", i);
+            next();
+          });
+      break;
+    case PointRead::FETCH_PARTIAL:
+      // Read the second half of the value.
+      TRACE_ASYNC_BEGIN("benchmark", "fetch_partial", i);
+      snapshot_->FetchPartial(
+          keys_[i].Clone(), value_size_ / 2, -1,
+          [i, next](ledger::Status status, mx::vmo /*buffer*/) {
+            if (benchmark::QuitOnError(status, "PageSnapshot::FetchPartial")) {
+              return;
+            }
+            TRACE_ASYNC_END("benchmark", "fetch_partial", i);
+            next();
+          });
+      break;
+  }
+}
+
+void GetBenchmark::RunScans(Scan method, int i, ftl::Closure on_done) {
+  if (i == scan_count_ ||
+      (method == Scan::GET_ENTRIES_INLINE && !inline_values_)) {
+    on_done();
+    return;
+  }
+  switch (method) {
+    case Scan::GET_ENTRIES:
+      TRACE_ASYNC_BEGIN("benchmark", "get_entries", i);
+      break;
+    case Scan::GET_ENTRIES_INLINE:
+      TRACE_ASYNC_BEGIN("benchmark", "get_entries_inline", i);
+      break;
+    case Scan::GET_KEYS:
+      TRACE_ASYNC_BEGIN("benchmark", "get_keys", i);
+      break;
+  }
+  ContinueScan(method, i, nullptr, std::move(on_done));
+}
+
+void GetBenchmark::ContinueScan(Scan method,
+                                int i,
+                                fidl::Array<uint8_t> token,
+                                ftl::Closure on_done) {
+  auto on_page = [this, method, i, on_done](ledger::Status status,
+                                            fidl::Array<uint8_t> next_token,
+                                            ftl::StringView description) {
+    if (status != ledger::Status::PARTIAL_RESULT &&
+        benchmark::QuitOnError(status, description)) {
+      return;
+    }
+    if (next_token) {
+      ContinueScan(method, i, std::move(next_token), on_done);
+      return;
+    }
+    switch (method) {
+      case Scan::GET_ENTRIES:
+        TRACE_ASYNC_END("benchmark", "get_entries", i);
+        break;
+      case Scan::GET_ENTRIES_INLINE:
+        TRACE_ASYNC_END("benchmark", "get_entries_inline", i);
+        break;
+      case Scan::GET_KEYS:
+        TRACE_ASYNC_END("benchmark", "get_keys", i);
+        break;
+    }
+    RunScans(method, i + 1, on_done);
+  };
+  switch (method) {
+    case Scan::GET_ENTRIES:
+      prefix_snapshot_->GetEntries(
+          nullptr, std::move(token),
+          [on_page](ledger::Status status,
+                    fidl::Array<ledger::EntryPtr> /*entries*/,
+                    fidl::Array<uint8_t> next_token) {
+            on_page(status, std::move(next_token), "PageSnapshot::GetEntries");
+          });
+      break;
+    case Scan::GET_ENTRIES_INLINE:
+      prefix_snapshot_->GetEntriesInline(
+          nullptr, std::move(token),
+          [on_page](ledger::Status status,
+                    fidl::Array<ledger::InlinedEntryPtr> /*entries*/,
+                    fidl::Array<uint8_t> next_token) {
+            on_page(status, std::move(next_token),
+                    "PageSnapshot::GetEntriesInline");
+          });
+      break;
+    case Scan::GET_KEYS:
+      prefix_snapshot_->GetKeys(
+          nullptr, std::move(token),
+          [on_page](ledger::Status status,
+                    fidl::Array<fidl::Array<uint8_t>> /*keys*/,
+                    fidl::Array<uint8_t> next_token) {
+            on_page(status, std::move(next_token), "PageSnapshot::GetKeys");
+          });
+      break;
+  }
+}
+
+void GetBenchmark::ShutDown() {
+  // Shut down the Ledger process first as it relies on |tmp_dir_| storage.
+  application_controller_->Kill();
+  application_controller_.WaitForIncomingResponseWithTimeout(
+      ftl::TimeDelta::FromSeconds(5));
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+}  // namespace test
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  int entry_count;
+  int key_size;
+  int value_size;
+  int scan_count = 10;
+  int selectivity = 100;
+  int lazy_percentage = 0;
+  std::string scan_count_str;
+  if (!GetPositiveIntValue(command_line, kEntryCountFlag, &entry_count) ||
+      !GetPositiveIntValue(command_line, kKeySizeFlag, &key_size) ||
+      key_size < 2 ||
+      !GetPositiveIntValue(command_line, kValueSizeFlag, &value_size) ||
+      (command_line.GetOptionValue(kScanCountFlag.ToString(),
+                                   &scan_count_str) &&
+       !GetPositiveIntValue(command_line, kScanCountFlag, &scan_count)) ||
+      !GetPercentageValue(command_line, kSelectivityFlag, &selectivity) ||
+      !GetPercentageValue(command_line, kLazyFlag, &lazy_percentage)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  int seed;
+  std::string seed_str;
+  if (command_line.GetOptionValue(kSeedFlag.ToString(), &seed_str)) {
+    if (!ftl::StringToNumberWithError(seed_str, &seed)) {
+      PrintUsage(argv[0]);
+      return -1;
+    }
+  } else {
+    seed = ftl::RandUint64();
+  }
+
+  mtl::MessageLoop loop;
+  test::benchmark::GetBenchmark app(entry_count, key_size, value_size,
+                                    scan_count, selectivity, lazy_percentage,
+                                    seed);
+  // TODO(nellyv): A delayed task is necessary because of US-257.
+  loop.task_runner()->PostDelayedTask([&app] { app.Run(); },
+                                      ftl::TimeDelta::FromSeconds(1));
+  loop.Run();
+  return 0;
+}
@@ -0,0 +1,115 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_GET_GET_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_GET_GET_H_
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/fidl_helpers/bound_interface_set.h"
+#include "apps/ledger/src/test/data_generator.h"
+#include "apps/ledger/src/test/fake_token_provider.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace test {
+namespace benchmark {
+
+// Benchmark that measures the performance of the read operations of
+// PageSnapshot.
+//
+// The page is first filled with --entry-count entries. Then each key is read
+// once, in a random order, with Get(), GetInline() and FetchPartial(), and the
+// entries matching a key prefix are listed --scan-count times with
+// GetEntries(), GetEntriesInline() and GetKeys(). GetInline() and
+// GetEntriesInline() are skipped if the values do not fit in a FIDL message.
+//
+// Parameters:
+//   --entry-count=<int> the number of entries in the page
+//   --key-size=<int> the size of a single key in bytes, at least 2
+//   --value-size=<int> the size of a single value in bytes
+//   --scan-count=<int> (optional) the number of times the entries are listed,
+//     10 by default
+//   --selectivity=<int> (optional) the percentage of the entries matching the
+//     key prefix of the listings, 100 by default
+//   --lazy=<int> (optional) the percentage of the entries put with the LAZY
+//     priority, 0 by default
+//   --seed=<int> (optional) the seed for key and value generation
+class GetBenchmark {
+ public:
+  GetBenchmark(int entry_count,
+               int key_size,
+               int value_size,
+               int scan_count,
+               int selectivity,
+               int lazy_percentage,
+               uint64_t seed);
+
+  void Run();
+
+ private:
+  enum class PointRead {
+    GET,
+    GET_INLINE,
+    FETCH_PARTIAL,
+  };
+
+  enum class Scan {
+    GET_ENTRIES,
+    GET_ENTRIES_INLINE,
+    GET_KEYS,
+  };
+
+  // Adds the entries to the page, starting at the |i|-th one.
+  void AddEntries(int i, ftl::Closure on_done);
+  void GetSnapshots();
+
+  // Reads the keys starting at the |i|-th one with |method|, then calls
+  // |on_done|.
+  void RunPointReads(PointRead method, size_t i, ftl::Closure on_done);
+  // Lists the entries matching the prefix with |method| |scan_count_| times,
+  // starting at the |i|-th time, then calls |on_done|.
+  void RunScans(Scan method, int i, ftl::Closure on_done);
+  // Lists the remaining entries of a scan from |token|.
+  void ContinueScan(Scan method,
+                    int i,
+                    fidl::Array<uint8_t> token,
+                    ftl::Closure on_done);
+
+  void ShutDown();
+
+  test::DataGenerator generator_;
+  std::default_random_engine rng_;
+
+  files::ScopedTempDir tmp_dir_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  ledger::fidl_helpers::BoundInterfaceSet<modular::auth::TokenProvider,
+                                          test::FakeTokenProvider>
+      token_provider_impl_;
+  const int entry_count_;
+  const int key_size_;
+  const int value_size_;
+  const int scan_count_;
+  const int selectivity_;
+  const int lazy_percentage_;
+  const bool inline_values_;
+
+  app::ApplicationControllerPtr application_controller_;
+  ledger::PagePtr page_;
+  // Snapshot of the whole page, used by the point reads.
+  ledger::PageSnapshotPtr snapshot_;
+  // Snapshot of the entries matching the prefix, used by the scans.
+  ledger::PageSnapshotPtr prefix_snapshot_;
+  std::vector<fidl::Array<uint8_t>> keys_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(GetBenchmark);
+};
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_GET_GET_H_
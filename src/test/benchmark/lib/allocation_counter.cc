@@ -0,0 +1,65 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/lib/allocation_counter.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> allocations(0u);
+std::atomic<uint64_t> allocated_bytes(0u);
+
+void* CountedAllocate(size_t size) {
+  allocations.fetch_add(1u, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  // malloc(0) may return nullptr, which operator new must not.
+  void* result = malloc(size ? size : 1);
+  if (!result) {
+    abort();
+  }
+  return result;
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+  return CountedAllocate(size);
+}
+
+void* operator new[](size_t size) {
+  return CountedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t /*size*/) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t /*size*/) noexcept {
+  free(ptr);
+}
+
+namespace test {
+namespace benchmark {
+
+AllocationCount GetAllocationCount() {
+  AllocationCount count;
+  count.allocations = allocations.load(std::memory_order_relaxed);
+  count.bytes = allocated_bytes.load(std::memory_order_relaxed);
+  return count;
+}
+
+}  // namespace benchmark
+}  // namespace test
@@ -0,0 +1,26 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_LIB_ALLOCATION_COUNTER_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_LIB_ALLOCATION_COUNTER_H_
+
+#include <stdint.h>
+
+namespace test {
+namespace benchmark {
+
+// Counts of the heap allocations made through operator new since the start of
+// the process. Linking allocation_counter.cc into a binary replaces the global
+// operator new and delete for the whole binary.
+struct AllocationCount {
+  uint64_t allocations = 0u;
+  uint64_t bytes = 0u;
+};
+
+AllocationCount GetAllocationCount();
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_LIB_ALLOCATION_COUNTER_H_
@@ -0,0 +1,146 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/lib/fake_cloud_ledger.h"
+
+#include "apps/ledger/src/app/erase_remote_repository_operation.h"
+#include "apps/ledger/src/app/ledger_repository_factory_impl.h"
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/environment/environment.h"
+#include "apps/ledger/src/network/network_service_impl.h"
+#include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/logging.h"
+#include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/threading/create_thread.h"
+
+namespace test {
+namespace benchmark {
+namespace {
+constexpr ftl::StringView kServerId = "fake-cloud";
+constexpr ftl::TimeDelta kTimeout = ftl::TimeDelta::FromSeconds(10);
+}  // namespace
+
+FakeCloud::FakeCloud(ledger::NetworkConditions conditions) {
+  thread_ = mtl::CreateThread(&task_runner_);
+  task_runner_->PostTask([this, conditions] {
+    network_service_ =
+        std::make_unique<ledger::FakeCloudNetworkService>(conditions);
+    token_provider_impl_ = std::make_unique<
+        ledger::fidl_helpers::BoundInterfaceSet<modular::auth::TokenProvider,
+                                                test::FakeTokenProvider>>(
+        "", "sync_user", "sync_user@google.com", "client_id");
+  });
+}
+
+FakeCloud::~FakeCloud() {
+  task_runner_->PostTask([this] {
+    mtl::MessageLoop::GetCurrent()->QuitNow();
+    token_provider_impl_.reset();
+    network_service_.reset();
+  });
+  thread_.join();
+}
+
+network::NetworkServicePtr FakeCloud::ConnectNetworkService() {
+  network::NetworkServicePtr network_service;
+  task_runner_->PostTask(ftl::MakeCopyable([
+    this, request = network_service.NewRequest()
+  ]() mutable { network_service_->AddBinding(std::move(request)); }));
+  return network_service;
+}
+
+modular::auth::TokenProviderPtr FakeCloud::ConnectTokenProvider() {
+  modular::auth::TokenProviderPtr token_provider;
+  task_runner_->PostTask(ftl::MakeCopyable([
+    this, request = token_provider.NewRequest()
+  ]() mutable { token_provider_impl_->AddBinding(std::move(request)); }));
+  return token_provider;
+}
+
+class FakeCloudLedger::RepositoryFactoryContainer
+    : public ledger::LedgerRepositoryFactoryImpl::Delegate {
+ public:
+  RepositoryFactoryContainer(
+      ftl::RefPtr<ftl::TaskRunner> task_runner,
+      std::function<network::NetworkServicePtr()> network_factory,
+      fidl::InterfaceRequest<ledger::LedgerRepositoryFactory> request)
+      : network_service_(task_runner, std::move(network_factory)),
+        environment_(task_runner, &network_service_),
+        factory_impl_(
+            this,
+            &environment_,
+            ledger::LedgerRepositoryFactoryImpl::ConfigPersistence::FORGET),
+        factory_binding_(&factory_impl_, std::move(request)) {}
+  ~RepositoryFactoryContainer() override {}
+
+ private:
+  // LedgerRepositoryFactoryImpl::Delegate:
+  void EraseRepository(
+      ledger::EraseRemoteRepositoryOperation /*operation*/,
+      std::function<void(bool)> callback) override {
+    FTL_NOTIMPLEMENTED();
+    callback(true);
+  }
+
+  ledger::NetworkServiceImpl network_service_;
+  ledger::Environment environment_;
+  ledger::LedgerRepositoryFactoryImpl factory_impl_;
+  fidl::Binding<ledger::LedgerRepositoryFactory> factory_binding_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RepositoryFactoryContainer);
+};
+
+FakeCloudLedger::FakeCloudLedger(FakeCloud* cloud, std::string repository_path)
+    : cloud_(cloud), repository_path_(std::move(repository_path)) {
+  thread_ = mtl::CreateThread(&task_runner_);
+  task_runner_->PostTask(ftl::MakeCopyable([
+    this, request = repository_factory_.NewRequest()
+  ]() mutable {
+    factory_container_ = std::make_unique<RepositoryFactoryContainer>(
+        task_runner_, [this] { return cloud_->ConnectNetworkService(); },
+        std::move(request));
+  }));
+}
+
+FakeCloudLedger::~FakeCloudLedger() {
+  repository_.reset();
+  repository_factory_.reset();
+  task_runner_->PostTask([this] {
+    mtl::MessageLoop::GetCurrent()->QuitNow();
+    factory_container_.reset();
+  });
+  thread_.join();
+}
+
+ledger::Status FakeCloudLedger::GetLedger(std::string ledger_name,
+                                          ledger::LedgerPtr* ledger) {
+  ledger::Status status = ledger::Status::UNKNOWN_ERROR;
+  if (!repository_) {
+    ledger::FirebaseConfigPtr firebase_config = ledger::FirebaseConfig::New();
+    firebase_config->server_id = kServerId.ToString();
+    firebase_config->api_key = "api_key";
+    repository_factory_->GetRepository(
+        repository_path_, std::move(firebase_config),
+        cloud_->ConnectTokenProvider(), repository_.NewRequest(),
+        [&status](ledger::Status s) { status = s; });
+    if (!repository_factory_.WaitForIncomingResponseWithTimeout(kTimeout)) {
+      FTL_LOG(ERROR) << "GetRepository timed out.";
+      return ledger::Status::UNKNOWN_ERROR;
+    }
+    if (status != ledger::Status::OK) {
+      return status;
+    }
+  }
+
+  repository_->GetLedger(convert::ToArray(ledger_name), ledger->NewRequest(),
+                         [&status](ledger::Status s) { status = s; });
+  if (!repository_.WaitForIncomingResponseWithTimeout(kTimeout)) {
+    FTL_LOG(ERROR) << "GetLedger timed out.";
+    return ledger::Status::UNKNOWN_ERROR;
+  }
+  return status;
+}
+
+}  // namespace benchmark
+}  // namespace test
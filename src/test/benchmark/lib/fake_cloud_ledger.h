@@ -0,0 +1,83 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_LIB_FAKE_CLOUD_LEDGER_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_LIB_FAKE_CLOUD_LEDGER_H_
+
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "apps/ledger/services/internal/internal.fidl.h"
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/fidl_helpers/bound_interface_set.h"
+#include "apps/ledger/src/test/cloud_server/fake_cloud_network_service.h"
+#include "apps/ledger/src/test/cloud_server/network_conditions.h"
+#include "apps/ledger/src/test/fake_token_provider.h"
+#include "apps/modular/services/auth/token_provider.fidl.h"
+#include "apps/network/services/network_service.fidl.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace test {
+namespace benchmark {
+
+// Fake cloud served in-process, on its own thread, behind a simulated network.
+// Sync benchmarks using it need neither a Firebase instance nor a network
+// connection, and run under reproducible network conditions.
+class FakeCloud {
+ public:
+  explicit FakeCloud(ledger::NetworkConditions conditions);
+  ~FakeCloud();
+
+  // Returns a new connection to the simulated network.
+  network::NetworkServicePtr ConnectNetworkService();
+  // Returns a new connection to the token provider of the benchmark user.
+  modular::auth::TokenProviderPtr ConnectTokenProvider();
+
+ private:
+  std::thread thread_;
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  std::unique_ptr<ledger::FakeCloudNetworkService> network_service_;
+  std::unique_ptr<
+      ledger::fidl_helpers::BoundInterfaceSet<modular::auth::TokenProvider,
+                                              test::FakeTokenProvider>>
+      token_provider_impl_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FakeCloud);
+};
+
+// Ledger instance running in-process, on its own thread, and syncing through a
+// FakeCloud. Instances with different repository paths behave as separate
+// devices. An instance started on the repository path of a deleted one behaves
+// as the same device restarting.
+class FakeCloudLedger {
+ public:
+  // |cloud| must outlive this instance.
+  FakeCloudLedger(FakeCloud* cloud, std::string repository_path);
+  ~FakeCloudLedger();
+
+  // Connects to the ledger of the given name, waiting for the repository to be
+  // ready.
+  ledger::Status GetLedger(std::string ledger_name, ledger::LedgerPtr* ledger);
+
+ private:
+  class RepositoryFactoryContainer;
+
+  FakeCloud* const cloud_;
+  const std::string repository_path_;
+  std::thread thread_;
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  std::unique_ptr<RepositoryFactoryContainer> factory_container_;
+  ledger::LedgerRepositoryFactoryPtr repository_factory_;
+  ledger::LedgerRepositoryPtr repository_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FakeCloudLedger);
+};
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_LIB_FAKE_CLOUD_LEDGER_H_
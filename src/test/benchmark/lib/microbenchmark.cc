@@ -0,0 +1,337 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/lib/microbenchmark.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+
+namespace test {
+namespace benchmark {
+
+namespace {
+
+constexpr ftl::StringView kFilterFlag = "filter";
+constexpr ftl::StringView kMinTimeFlag = "min-time-ms";
+constexpr ftl::StringView kJsonFlag = "json";
+
+constexpr int64_t kDefaultMinTimeMs = 500;
+constexpr uint64_t kMaxIterations = 1000000000u;
+
+AllocationCount operator-(const AllocationCount& a, const AllocationCount& b) {
+  AllocationCount result;
+  result.allocations = a.allocations - b.allocations;
+  result.bytes = a.bytes - b.bytes;
+  return result;
+}
+
+AllocationCount& operator+=(AllocationCount& a, const AllocationCount& b) {
+  a.allocations += b.allocations;
+  a.bytes += b.bytes;
+  return a;
+}
+
+// Returns the number of iterations of the next calibration run, after a run
+// of |iterations| iterations lasted |elapsed|.
+uint64_t GetNextIterations(uint64_t iterations,
+                           ftl::TimeDelta elapsed,
+                           ftl::TimeDelta min_time) {
+  double multiplier = 10.0;
+  // Only extrapolate from runs that are long enough to be significant.
+  if (elapsed.ToNanoseconds() * 10 > min_time.ToNanoseconds()) {
+    multiplier = 1.4 * min_time.ToSecondsF() / elapsed.ToSecondsF();
+  }
+  uint64_t next = static_cast<uint64_t>(iterations * multiplier);
+  return std::min(std::max(next, iterations + 1), kMaxIterations);
+}
+
+}  // namespace
+
+MicrobenchmarkState::MicrobenchmarkState(std::vector<int64_t> args,
+                                         uint64_t iterations)
+    : args_(std::move(args)), iterations_(iterations) {
+  FTL_DCHECK(iterations > 0u);
+}
+
+MicrobenchmarkState::~MicrobenchmarkState() {}
+
+bool MicrobenchmarkState::KeepRunning() {
+  FTL_DCHECK(!finished_ && error_.empty());
+  if (!started_) {
+    started_ = true;
+    ResumeTiming();
+  }
+  if (completed_iterations_ < iterations_) {
+    ++completed_iterations_;
+    return true;
+  }
+  PauseTiming();
+  finished_ = true;
+  return false;
+}
+
+void MicrobenchmarkState::PauseTiming() {
+  FTL_DCHECK(!paused_);
+  // Read the clock before the allocation counters, and the reverse in
+  // |ResumeTiming()|, to keep them out of the measured time.
+  ftl::TimePoint now = ftl::TimePoint::Now();
+  AllocationCount allocation_count = GetAllocationCount();
+  elapsed_ = elapsed_ + (now - start_time_);
+  allocation_count_ += allocation_count - start_allocation_count_;
+  paused_ = true;
+}
+
+void MicrobenchmarkState::ResumeTiming() {
+  FTL_DCHECK(paused_);
+  paused_ = false;
+  start_allocation_count_ = GetAllocationCount();
+  start_time_ = ftl::TimePoint::Now();
+}
+
+int64_t MicrobenchmarkState::arg(size_t index) const {
+  FTL_DCHECK(index < args_.size());
+  return args_[index];
+}
+
+void MicrobenchmarkState::SkipWithError(std::string message) {
+  FTL_DCHECK(!message.empty());
+  error_ = std::move(message);
+}
+
+Microbenchmark::Microbenchmark(
+    std::string name,
+    std::function<void(MicrobenchmarkState*)> function)
+    : name_(std::move(name)), function_(std::move(function)) {}
+
+Microbenchmark::~Microbenchmark() {}
+
+Microbenchmark* Microbenchmark::ArgNames(std::vector<std::string> arg_names) {
+  arg_names_ = std::move(arg_names);
+  return this;
+}
+
+Microbenchmark* Microbenchmark::Args(std::vector<int64_t> args) {
+  args_.push_back(std::move(args));
+  return this;
+}
+
+Microbenchmark* Microbenchmark::ArgsProduct(
+    std::vector<std::vector<int64_t>> values) {
+  std::vector<std::vector<int64_t>> product = {{}};
+  for (const auto& arg_values : values) {
+    std::vector<std::vector<int64_t>> next;
+    for (const auto& prefix : product) {
+      for (int64_t value : arg_values) {
+        next.push_back(prefix);
+        next.back().push_back(value);
+      }
+    }
+    product = std::move(next);
+  }
+  for (auto& args : product) {
+    args_.push_back(std::move(args));
+  }
+  return this;
+}
+
+std::string Microbenchmark::GetRunName(const std::vector<int64_t>& args) const {
+  std::string result = name_;
+  for (size_t i = 0; i < args.size(); ++i) {
+    result.append("/");
+    if (i < arg_names_.size()) {
+      result.append(arg_names_[i]);
+      result.append(":");
+    }
+    result.append(ftl::NumberToString(args[i]));
+  }
+  return result;
+}
+
+std::vector<int64_t> MicrobenchmarkRange(int64_t min, int64_t max, int mult) {
+  FTL_DCHECK(min > 0 && min <= max && mult > 1);
+  std::vector<int64_t> result;
+  for (int64_t value = min; value < max; value *= mult) {
+    result.push_back(value);
+  }
+  result.push_back(max);
+  return result;
+}
+
+struct MicrobenchmarkRunner::Result {
+  std::string name;
+  uint64_t iterations = 0u;
+  double time_ns = 0.0;
+  double allocations = 0.0;
+  double allocated_bytes = 0.0;
+  double items_per_second = 0.0;
+  double bytes_per_second = 0.0;
+  std::string error;
+};
+
+MicrobenchmarkRunner::MicrobenchmarkRunner() {}
+
+MicrobenchmarkRunner::~MicrobenchmarkRunner() {}
+
+Microbenchmark* MicrobenchmarkRunner::Add(
+    std::string name,
+    std::function<void(MicrobenchmarkState*)> function) {
+  benchmarks_.push_back(
+      std::make_unique<Microbenchmark>(std::move(name), std::move(function)));
+  return benchmarks_.back().get();
+}
+
+int MicrobenchmarkRunner::Run(const ftl::CommandLine& command_line) {
+  std::string filter;
+  command_line.GetOptionValue(kFilterFlag.ToString(), &filter);
+
+  int64_t min_time_ms = kDefaultMinTimeMs;
+  std::string min_time_str;
+  if (command_line.GetOptionValue(kMinTimeFlag.ToString(), &min_time_str) &&
+      (!ftl::StringToNumberWithError(min_time_str, &min_time_ms) ||
+       min_time_ms <= 0)) {
+    FTL_LOG(ERROR) << "Invalid --" << kMinTimeFlag << ": " << min_time_str;
+    return -1;
+  }
+  ftl::TimeDelta min_time = ftl::TimeDelta::FromMilliseconds(min_time_ms);
+
+  printf("%-60s %12s %14s %12s %14s\n", "Benchmark", "Iterations", "Time (ns)",
+         "Allocs", "Alloc bytes");
+  std::vector<Result> results;
+  bool success = true;
+  for (const auto& benchmark : benchmarks_) {
+    std::vector<std::vector<int64_t>> runs = benchmark->args();
+    if (runs.empty()) {
+      runs.emplace_back();
+    }
+    for (const auto& args : runs) {
+      std::string name = benchmark->GetRunName(args);
+      if (name.find(filter) == std::string::npos) {
+        continue;
+      }
+      Result result;
+      result.name = std::move(name);
+      if (!RunOne(*benchmark, args, min_time, &result)) {
+        printf("%-60s ERROR: %s\n", result.name.c_str(), result.error.c_str());
+        success = false;
+      } else {
+        printf("%-60s %12" PRIu64 " %14.0f %12.1f %14.0f\n",
+               result.name.c_str(), result.iterations, result.time_ns,
+               result.allocations, result.allocated_bytes);
+      }
+      fflush(stdout);
+      results.push_back(std::move(result));
+    }
+  }
+
+  std::string json_path;
+  if (command_line.GetOptionValue(kJsonFlag.ToString(), &json_path) &&
+      !WriteJson(json_path, command_line.argv0(), results)) {
+    FTL_LOG(ERROR) << "Unable to write the results to " << json_path;
+    return -1;
+  }
+  return success ? 0 : -1;
+}
+
+bool MicrobenchmarkRunner::RunOne(const Microbenchmark& benchmark,
+                                  const std::vector<int64_t>& args,
+                                  ftl::TimeDelta min_time,
+                                  Result* result) {
+  uint64_t iterations = 1u;
+  while (true) {
+    MicrobenchmarkState state(args, iterations);
+    benchmark.Run(&state);
+    if (!state.error().empty()) {
+      result->error = state.error();
+      return false;
+    }
+    if (!state.finished()) {
+      result->error = "the benchmark did not complete its iterations";
+      return false;
+    }
+    if (state.elapsed() < min_time && iterations < kMaxIterations) {
+      iterations = GetNextIterations(iterations, state.elapsed(), min_time);
+      continue;
+    }
+
+    double seconds = state.elapsed().ToSecondsF();
+    result->iterations = iterations;
+    result->time_ns = seconds * 1e9 / iterations;
+    result->allocations =
+        static_cast<double>(state.allocation_count().allocations) / iterations;
+    result->allocated_bytes =
+        static_cast<double>(state.allocation_count().bytes) / iterations;
+    if (seconds > 0) {
+      result->items_per_second = state.items_processed() / seconds;
+      result->bytes_per_second = state.bytes_processed() / seconds;
+    }
+    return true;
+  }
+}
+
+bool MicrobenchmarkRunner::WriteJson(const std::string& path,
+                                     const std::string& executable,
+                                     const std::vector<Result>& results) {
+  rapidjson::StringBuffer string_buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(string_buffer);
+
+  writer.StartObject();
+
+  writer.Key("context");
+  writer.StartObject();
+  writer.Key("executable");
+  writer.String(executable.c_str());
+  writer.EndObject();
+
+  writer.Key("benchmarks");
+  writer.StartArray();
+  for (const auto& result : results) {
+    writer.StartObject();
+    writer.Key("name");
+    writer.String(result.name.c_str());
+    if (!result.error.empty()) {
+      writer.Key("error_message");
+      writer.String(result.error.c_str());
+      writer.EndObject();
+      continue;
+    }
+    writer.Key("iterations");
+    writer.Uint64(result.iterations);
+    writer.Key("real_time");
+    writer.Double(result.time_ns);
+    writer.Key("time_unit");
+    writer.String("ns");
+    writer.Key("allocs_per_iteration");
+    writer.Double(result.allocations);
+    writer.Key("alloc_bytes_per_iteration");
+    writer.Double(result.allocated_bytes);
+    if (result.items_per_second > 0) {
+      writer.Key("items_per_second");
+      writer.Double(result.items_per_second);
+    }
+    if (result.bytes_per_second > 0) {
+      writer.Key("bytes_per_second");
+      writer.Double(result.bytes_per_second);
+    }
+    writer.EndObject();
+  }
+  writer.EndArray();
+
+  writer.EndObject();
+
+  return files::WriteFile(path, string_buffer.GetString(),
+                          string_buffer.GetSize());
+}
+
+}  // namespace benchmark
+}  // namespace test
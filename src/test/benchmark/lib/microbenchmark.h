@@ -0,0 +1,159 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_LIB_MICROBENCHMARK_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_LIB_MICROBENCHMARK_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/test/benchmark/lib/allocation_counter.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace test {
+namespace benchmark {
+
+// State of a single run of a microbenchmark. Only the code inside the
+// |KeepRunning()| loop is measured:
+//
+//   void BenchmarkFoo(MicrobenchmarkState* state) {
+//     Foo foo(state->arg(0));
+//     while (state->KeepRunning()) {
+//       foo.Bar();
+//     }
+//   }
+class MicrobenchmarkState {
+ public:
+  MicrobenchmarkState(std::vector<int64_t> args, uint64_t iterations);
+  ~MicrobenchmarkState();
+
+  // Returns true as long as the measured code must be run again.
+  bool KeepRunning();
+
+  // Excludes the code run between the two calls from the measurements.
+  void PauseTiming();
+  void ResumeTiming();
+
+  int64_t arg(size_t index) const;
+
+  // Reports the number of items, or bytes, processed by all the iterations, to
+  // compute the throughput.
+  void SetItemsProcessed(uint64_t items) { items_processed_ = items; }
+  void SetBytesProcessed(uint64_t bytes) { bytes_processed_ = bytes; }
+
+  // Marks the run as failed. The microbenchmark must return without calling
+  // |KeepRunning()| again.
+  void SkipWithError(std::string message);
+
+  uint64_t iterations() const { return iterations_; }
+  bool finished() const { return finished_; }
+  const std::string& error() const { return error_; }
+  ftl::TimeDelta elapsed() const { return elapsed_; }
+  const AllocationCount& allocation_count() const { return allocation_count_; }
+  uint64_t items_processed() const { return items_processed_; }
+  uint64_t bytes_processed() const { return bytes_processed_; }
+
+ private:
+  const std::vector<int64_t> args_;
+  const uint64_t iterations_;
+  uint64_t completed_iterations_ = 0u;
+  bool started_ = false;
+  bool finished_ = false;
+  bool paused_ = true;
+  std::string error_;
+
+  ftl::TimePoint start_time_;
+  AllocationCount start_allocation_count_;
+  ftl::TimeDelta elapsed_;
+  AllocationCount allocation_count_;
+  uint64_t items_processed_ = 0u;
+  uint64_t bytes_processed_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MicrobenchmarkState);
+};
+
+// A microbenchmark function, and the sets of arguments it is run with.
+class Microbenchmark {
+ public:
+  Microbenchmark(std::string name,
+                 std::function<void(MicrobenchmarkState*)> function);
+  ~Microbenchmark();
+
+  // Names the arguments in the reported results.
+  Microbenchmark* ArgNames(std::vector<std::string> arg_names);
+  // Adds a run with the given arguments.
+  Microbenchmark* Args(std::vector<int64_t> args);
+  // Adds a run for each combination of the given values of the arguments.
+  Microbenchmark* ArgsProduct(std::vector<std::vector<int64_t>> values);
+
+  const std::string& name() const { return name_; }
+  const std::vector<std::vector<int64_t>>& args() const { return args_; }
+
+  // Returns the name of the run with the given arguments.
+  std::string GetRunName(const std::vector<int64_t>& args) const;
+
+  void Run(MicrobenchmarkState* state) const { function_(state); }
+
+ private:
+  const std::string name_;
+  const std::function<void(MicrobenchmarkState*)> function_;
+  std::vector<std::string> arg_names_;
+  std::vector<std::vector<int64_t>> args_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Microbenchmark);
+};
+
+// Returns |min|, then multiples of |min| by powers of |mult| up to |max|.
+// |max| is always included.
+std::vector<int64_t> MicrobenchmarkRange(int64_t min, int64_t max, int mult);
+
+// Runs a set of microbenchmarks, calibrating the number of iterations of each
+// run so that it lasts at least a minimum time, and reports the time and the
+// heap allocations per iteration.
+//
+// Parameters:
+//   --filter=<string> (optional) only runs the microbenchmarks whose run name
+//     contains the given string
+//   --min-time-ms=<int> (optional) the minimum duration of a run, 500 by
+//     default
+//   --json=<path> (optional) writes the results in JSON to the given file, in
+//     addition to the standard output
+class MicrobenchmarkRunner {
+ public:
+  MicrobenchmarkRunner();
+  ~MicrobenchmarkRunner();
+
+  Microbenchmark* Add(std::string name,
+                      std::function<void(MicrobenchmarkState*)> function);
+
+  // Runs the microbenchmarks and returns the exit code of the binary.
+  int Run(const ftl::CommandLine& command_line);
+
+ private:
+  struct Result;
+
+  bool RunOne(const Microbenchmark& benchmark,
+              const std::vector<int64_t>& args,
+              ftl::TimeDelta min_time,
+              Result* result);
+  bool WriteJson(const std::string& path,
+                 const std::string& executable,
+                 const std::vector<Result>& results);
+
+  std::vector<std::unique_ptr<Microbenchmark>> benchmarks_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MicrobenchmarkRunner);
+};
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_LIB_MICROBENCHMARK_H_
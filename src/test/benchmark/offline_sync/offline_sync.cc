@@ -0,0 +1,463 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/offline_sync/offline_sync.h"
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <unordered_set>
+
+#include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/test/benchmark/lib/logging.h"
+#include "apps/ledger/src/test/get_ledger.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/fidl/cpp/bindings/binding.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/time/time_point.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace {
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/offline_sync";
+constexpr ftl::StringView kLedgerName = "offline_sync";
+constexpr ftl::StringView kScenarioFlag = "scenario";
+constexpr ftl::StringView kIterationCountFlag = "iteration-count";
+constexpr ftl::StringView kEntryCountFlag = "entry-count";
+constexpr ftl::StringView kValueSizeFlag = "value-size";
+constexpr ftl::StringView kLatencyFlag = "latency-ms";
+constexpr ftl::StringView kBandwidthFlag = "bandwidth";
+constexpr ftl::StringView kLossRateFlag = "loss-rate";
+
+constexpr ftl::StringView kUploadScenario = "upload";
+constexpr ftl::StringView kPipelineScenario = "pipeline";
+constexpr ftl::StringView kDownloadScenario = "download";
+constexpr ftl::StringView kConvergenceScenario = "convergence";
+constexpr ftl::StringView kBacklogScenario = "backlog";
+
+constexpr size_t kKeySize = 100;
+constexpr ftl::TimeDelta kTimeout = ftl::TimeDelta::FromSeconds(10);
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kScenarioFlag << "=("
+            << kUploadScenario << "|" << kPipelineScenario << "|"
+            << kDownloadScenario << "|"
+            << kConvergenceScenario << "|" << kBacklogScenario << ") --"
+            << kIterationCountFlag << "=<int> --" << kEntryCountFlag
+            << "=<int> --" << kValueSizeFlag << "=<int> [--" << kLatencyFlag
+            << "=<int>] [--" << kBandwidthFlag << "=<int>] [--"
+            << kLossRateFlag << "=<double>]" << std::endl;
+}
+
+// Parses the optional flag |flag| into |value|, leaving it unchanged if the
+// flag is absent. Returns false if the flag is present but invalid.
+template <typename T>
+bool GetOptionalNumber(const ftl::CommandLine& command_line,
+                       ftl::StringView flag,
+                       T* value) {
+  std::string value_str;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str)) {
+    return true;
+  }
+  return ftl::StringToNumberWithError(value_str, value);
+}
+
+}  // namespace
+
+namespace test {
+namespace benchmark {
+
+// A device connected to the benchmark page. It keeps track of the keys of the
+// page and of the upload of its own commits.
+class OfflineSyncBenchmark::Device : public ledger::PageWatcher,
+                                     public ledger::SyncWatcher {
+ public:
+  Device(FakeCloud* cloud, std::string repository_path)
+      : instance_(cloud, std::move(repository_path)),
+        page_watcher_binding_(this),
+        sync_watcher_binding_(this) {}
+  ~Device() override {}
+
+  // Connects to the page of the given id, or to a new page if |page_id| is
+  // null. Returns false, after posting a quit task, on error.
+  bool Connect(fidl::Array<uint8_t> page_id) {
+    ledger::Status status =
+        instance_.GetLedger(kLedgerName.ToString(), &ledger_);
+    if (QuitOnError(status, "GetLedger")) {
+      return false;
+    }
+    status = test::GetPageEnsureInitialized(mtl::MessageLoop::GetCurrent(),
+                                            &ledger_, std::move(page_id),
+                                            &page_, &page_id_);
+    if (QuitOnError(status, "GetPage")) {
+      return false;
+    }
+
+    ledger::PageSnapshotPtr snapshot;
+    page_->GetSnapshot(snapshot.NewRequest(), nullptr,
+                       page_watcher_binding_.NewBinding(),
+                       callback::Capture([] {}, &status));
+    if (!page_.WaitForIncomingResponseWithTimeout(kTimeout) ||
+        QuitOnError(status, "GetSnapshot")) {
+      return false;
+    }
+    page_->SetSyncStateWatcher(sync_watcher_binding_.NewBinding(),
+                               callback::Capture([] {}, &status));
+    if (!page_.WaitForIncomingResponseWithTimeout(kTimeout) ||
+        QuitOnError(status, "SetSyncStateWatcher")) {
+      return false;
+    }
+
+    // Record the keys already present, the watcher sends the following ones.
+    fidl::Array<uint8_t> token;
+    do {
+      fidl::Array<fidl::Array<uint8_t>> keys;
+      snapshot->GetKeys(nullptr, std::move(token),
+                        callback::Capture([] {}, &status, &keys, &token));
+      if (!snapshot.WaitForIncomingResponseWithTimeout(kTimeout) ||
+          (status != ledger::Status::PARTIAL_RESULT &&
+           QuitOnError(status, "GetKeys"))) {
+        return false;
+      }
+      for (const auto& key : keys) {
+        keys_.insert(convert::ToString(key));
+      }
+    } while (token);
+    return true;
+  }
+
+  // Commits the keys of indexes [begin, end) in a single transaction, and
+  // calls |on_uploaded| once all the commits made so far are uploaded. If
+  // |on_uploaded| is null, the previous one is kept.
+  void Commit(test::DataGenerator* generator,
+              int begin,
+              int end,
+              int value_size,
+              ftl::Closure on_uploaded) {
+    if (on_uploaded) {
+      on_uploaded_ = std::move(on_uploaded);
+    }
+    upload_started_ = false;
+    ++pending_commits_;
+    page_->StartTransaction(QuitOnErrorCallback("StartTransaction"));
+    for (int i = begin; i < end; ++i) {
+      page_->Put(generator->MakeKey(i, kKeySize),
+                 generator->MakeValue(value_size), QuitOnErrorCallback("Put"));
+    }
+    std::function<void(ledger::Status)> on_error =
+        QuitOnErrorCallback("Commit");
+    page_->Commit([this, on_error](ledger::Status status) {
+      --pending_commits_;
+      on_error(status);
+    });
+  }
+
+  const fidl::Array<uint8_t>& page_id() const { return page_id_; }
+
+  size_t key_count() const { return keys_.size(); }
+
+  void set_on_keys_changed(ftl::Closure on_keys_changed) {
+    on_keys_changed_ = std::move(on_keys_changed);
+  }
+
+  // ledger::PageWatcher:
+  void OnChange(ledger::PageChangePtr page_change,
+                ledger::ResultState /*result_state*/,
+                const OnChangeCallback& callback) override {
+    for (const auto& change : page_change->changes) {
+      keys_.insert(convert::ToString(change->key));
+    }
+    callback(nullptr);
+    if (on_keys_changed_) {
+      // |on_keys_changed_| can be replaced while running.
+      ftl::Closure on_keys_changed = on_keys_changed_;
+      on_keys_changed();
+    }
+  }
+
+  // ledger::SyncWatcher:
+  void SyncStateChanged(ledger::SyncState /*download_status*/,
+                        ledger::SyncState upload_status,
+                        const SyncStateChangedCallback& callback) override {
+    callback();
+    if (!on_uploaded_) {
+      return;
+    }
+    // The upload is done once the state goes back to idle.
+    if (upload_status != ledger::SyncState::IDLE) {
+      upload_started_ = true;
+      return;
+    }
+    // A commit that is not made yet will start a new upload.
+    if (upload_started_ && pending_commits_ == 0u) {
+      ftl::Closure on_uploaded = std::move(on_uploaded_);
+      on_uploaded_ = nullptr;
+      on_uploaded();
+    }
+  }
+
+ private:
+  FakeCloudLedger instance_;
+  ledger::LedgerPtr ledger_;
+  ledger::PagePtr page_;
+  fidl::Array<uint8_t> page_id_;
+  fidl::Binding<ledger::PageWatcher> page_watcher_binding_;
+  fidl::Binding<ledger::SyncWatcher> sync_watcher_binding_;
+  std::unordered_set<std::string> keys_;
+  ftl::Closure on_keys_changed_;
+  ftl::Closure on_uploaded_;
+  bool upload_started_ = false;
+  // Number of commits whose Commit() call did not return yet.
+  size_t pending_commits_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Device);
+};
+
+OfflineSyncBenchmark::OfflineSyncBenchmark(Scenario scenario,
+                                           int iteration_count,
+                                           int entry_count,
+                                           int value_size,
+                                           ledger::NetworkConditions conditions)
+    : application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      scenario_(scenario),
+      iteration_count_(iteration_count),
+      entry_count_(entry_count),
+      value_size_(value_size),
+      cloud_(conditions) {
+  FTL_DCHECK(iteration_count > 0);
+  FTL_DCHECK(entry_count > 0);
+  FTL_DCHECK(value_size > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_offline_sync"});
+  for (size_t i = 0; i < 2; ++i) {
+    storages_.push_back(std::make_unique<files::ScopedTempDir>(kStoragePath));
+  }
+  devices_.resize(storages_.size());
+}
+
+OfflineSyncBenchmark::~OfflineSyncBenchmark() {}
+
+void OfflineSyncBenchmark::Run() {
+  if (!StartDevice(0)) {
+    return;
+  }
+  page_id_ = devices_[0]->page_id().Clone();
+
+  switch (scenario_) {
+    case Scenario::UPLOAD:
+      RunUpload(0);
+      break;
+    case Scenario::PIPELINE:
+      RunPipeline();
+      break;
+    case Scenario::DOWNLOAD:
+      UploadAll(0, [this] { RunDownload(); });
+      break;
+    case Scenario::CONVERGENCE:
+      if (!StartDevice(1)) {
+        return;
+      }
+      RunConvergence(0);
+      break;
+    case Scenario::BACKLOG:
+      if (!StartDevice(1)) {
+        return;
+      }
+      // The second device goes offline while the first one commits.
+      devices_[1].reset();
+      UploadAll(0, [this] { RunBacklog(); });
+      break;
+  }
+}
+
+bool OfflineSyncBenchmark::StartDevice(size_t index) {
+  devices_[index] = std::make_unique<Device>(&cloud_, storages_[index]->path());
+  return devices_[index]->Connect(page_id_.Clone());
+}
+
+void OfflineSyncBenchmark::RunUpload(int iteration) {
+  if (iteration == iteration_count_) {
+    ShutDown();
+    return;
+  }
+  TRACE_ASYNC_BEGIN("benchmark", "upload", iteration);
+  devices_[0]->Commit(&generator_, iteration * entry_count_,
+                      (iteration + 1) * entry_count_, value_size_,
+                      [this, iteration] {
+                        TRACE_ASYNC_END("benchmark", "upload", iteration);
+                        RunUpload(iteration + 1);
+                      });
+}
+
+void OfflineSyncBenchmark::UploadAll(int iteration, ftl::Closure on_done) {
+  if (iteration == iteration_count_) {
+    on_done();
+    return;
+  }
+  devices_[0]->Commit(&generator_, iteration * entry_count_,
+                      (iteration + 1) * entry_count_, value_size_,
+                      [this, iteration, on_done] {
+                        UploadAll(iteration + 1, on_done);
+                      });
+}
+
+void OfflineSyncBenchmark::RunPipeline() {
+  TRACE_ASYNC_BEGIN("benchmark", "pipeline", 0);
+  ftl::TimePoint start_time = ftl::TimePoint::Now();
+  for (int i = 0; i < iteration_count_; ++i) {
+    // Only the last commit waits for the upload, of all the commits.
+    ftl::Closure on_uploaded;
+    if (i == iteration_count_ - 1) {
+      on_uploaded = [this, start_time] {
+        TRACE_ASYNC_END("benchmark", "pipeline", 0);
+        double seconds = (ftl::TimePoint::Now() - start_time).ToSecondsF();
+        TRACE_COUNTER("benchmark", "upload_rate", 0, "commits_per_second",
+                      static_cast<uint64_t>(iteration_count_ / seconds));
+        ShutDown();
+      };
+    }
+    devices_[0]->Commit(&generator_, i * entry_count_, (i + 1) * entry_count_,
+                        value_size_, std::move(on_uploaded));
+  }
+}
+
+void OfflineSyncBenchmark::RunDownload() {
+  // Opening the page on a new device waits for the initial download, so it is
+  // part of the measure.
+  TRACE_ASYNC_BEGIN("benchmark", "download", 0);
+  if (!StartDevice(1)) {
+    return;
+  }
+  WaitForKeys(1, iteration_count_ * entry_count_, [this] {
+    TRACE_ASYNC_END("benchmark", "download", 0);
+    ShutDown();
+  });
+}
+
+void OfflineSyncBenchmark::RunConvergence(int iteration) {
+  if (iteration == iteration_count_) {
+    ShutDown();
+    return;
+  }
+  TRACE_ASYNC_BEGIN("benchmark", "convergence", iteration);
+  int device_count = devices_.size();
+  for (int i = 0; i < device_count; ++i) {
+    int begin = (iteration * device_count + i) * entry_count_;
+    devices_[i]->Commit(&generator_, begin, begin + entry_count_, value_size_,
+                        [] {});
+  }
+  size_t key_count = (iteration + 1) * device_count * entry_count_;
+  WaitForKeys(0, key_count, [this, iteration, key_count] {
+    WaitForKeys(1, key_count, [this, iteration] {
+      TRACE_ASYNC_END("benchmark", "convergence", iteration);
+      RunConvergence(iteration + 1);
+    });
+  });
+}
+
+void OfflineSyncBenchmark::RunBacklog() {
+  TRACE_ASYNC_BEGIN("benchmark", "backlog", 0);
+  if (!StartDevice(1)) {
+    return;
+  }
+  WaitForKeys(1, iteration_count_ * entry_count_, [this] {
+    TRACE_ASYNC_END("benchmark", "backlog", 0);
+    ShutDown();
+  });
+}
+
+void OfflineSyncBenchmark::WaitForKeys(size_t index,
+                                       size_t key_count,
+                                       ftl::Closure on_done) {
+  Device* device = devices_[index].get();
+  if (device->key_count() >= key_count) {
+    device->set_on_keys_changed(nullptr);
+    on_done();
+    return;
+  }
+  device->set_on_keys_changed([this, index, key_count, on_done] {
+    WaitForKeys(index, key_count, on_done);
+  });
+}
+
+void OfflineSyncBenchmark::ShutDown() {
+  // The devices are deleted along with the benchmark, once the loop quits.
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+}  // namespace test
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  std::string scenario_str;
+  std::string iteration_count_str;
+  int iteration_count;
+  std::string entry_count_str;
+  int entry_count;
+  std::string value_size_str;
+  int value_size;
+  int latency_ms = 0;
+  ledger::NetworkConditions conditions;
+  if (!command_line.GetOptionValue(kScenarioFlag.ToString(), &scenario_str) ||
+      !command_line.GetOptionValue(kIterationCountFlag.ToString(),
+                                   &iteration_count_str) ||
+      !ftl::StringToNumberWithError(iteration_count_str, &iteration_count) ||
+      iteration_count <= 0 ||
+      !command_line.GetOptionValue(kEntryCountFlag.ToString(),
+                                   &entry_count_str) ||
+      !ftl::StringToNumberWithError(entry_count_str, &entry_count) ||
+      entry_count <= 0 ||
+      !command_line.GetOptionValue(kValueSizeFlag.ToString(),
+                                   &value_size_str) ||
+      !ftl::StringToNumberWithError(value_size_str, &value_size) ||
+      value_size <= 0 ||
+      !GetOptionalNumber(command_line, kLatencyFlag, &latency_ms) ||
+      latency_ms < 0 ||
+      !GetOptionalNumber(command_line, kBandwidthFlag,
+                         &conditions.bandwidth)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  std::string loss_rate_str;
+  if (command_line.GetOptionValue(kLossRateFlag.ToString(), &loss_rate_str)) {
+    conditions.loss_rate = std::strtod(loss_rate_str.c_str(), nullptr);
+    if (conditions.loss_rate < 0.0 || conditions.loss_rate >= 1.0) {
+      std::cerr << "--" << kLossRateFlag << " must be in [0, 1)" << std::endl;
+      PrintUsage(argv[0]);
+      return -1;
+    }
+  }
+  conditions.latency = ftl::TimeDelta::FromMilliseconds(latency_ms);
+
+  test::benchmark::OfflineSyncBenchmark::Scenario scenario;
+  if (scenario_str == kUploadScenario) {
+    scenario = test::benchmark::OfflineSyncBenchmark::Scenario::UPLOAD;
+  } else if (scenario_str == kPipelineScenario) {
+    scenario = test::benchmark::OfflineSyncBenchmark::Scenario::PIPELINE;
+  } else if (scenario_str == kDownloadScenario) {
+    scenario = test::benchmark::OfflineSyncBenchmark::Scenario::DOWNLOAD;
+  } else if (scenario_str == kConvergenceScenario) {
+    scenario = test::benchmark::OfflineSyncBenchmark::Scenario::CONVERGENCE;
+  } else if (scenario_str == kBacklogScenario) {
+    scenario = test::benchmark::OfflineSyncBenchmark::Scenario::BACKLOG;
+  } else {
+    std::cerr << "Unknown option " << scenario_str << " for "
+              << kScenarioFlag.ToString() << std::endl;
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  test::benchmark::OfflineSyncBenchmark app(
+      scenario, iteration_count, entry_count, value_size, conditions);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
@@ -0,0 +1,107 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_OFFLINE_SYNC_OFFLINE_SYNC_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_OFFLINE_SYNC_OFFLINE_SYNC_H_
+
+#include <memory>
+#include <vector>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/test/benchmark/lib/fake_cloud_ledger.h"
+#include "apps/ledger/src/test/cloud_server/network_conditions.h"
+#include "apps/ledger/src/test/data_generator.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace test {
+namespace benchmark {
+
+// Benchmark that measures sync between Ledger instances running in-process
+// against the fake cloud of test/cloud_server, behind a simulated network. It
+// needs no cloud configuration, and the results only depend on the simulated
+// network conditions.
+//
+// The scenarios are:
+//   upload: a device commits --iteration-count commits, and we measure the time
+//     until each of them is uploaded.
+//   pipeline: a device makes --iteration-count commits in a row, without
+//     waiting for the previous ones to be uploaded, and we measure the time
+//     until all of them are uploaded. The "commit_upload" events of the
+//     "ledger" category give the latency of each commit, from its addition to
+//     the upload until its acknowledgement by the cloud, and the "upload_rate"
+//     counter of the "benchmark" category the resulting commits per second.
+//   download: a device uploads --iteration-count commits, then we measure the
+//     time until a new device opening the page has all of them.
+//   convergence: at each step, two devices make a concurrent commit, and we
+//     measure the time until both commits are visible to both devices.
+//   backlog: a device synced with the page goes offline while another one
+//     uploads --iteration-count commits, then we measure the time until it is
+//     caught up once back online.
+//
+// Parameters:
+//   --scenario=(upload|pipeline|download|convergence|backlog)
+//   --iteration-count=<int> the number of commits made by each device
+//   --entry-count=<int> the number of entries in each commit
+//   --value-size=<int> the size of a single value in bytes
+//   --latency-ms=<int> (optional) the latency of the simulated network
+//   --bandwidth=<int> (optional) the bandwidth of the simulated network in
+//     bytes per second, in each direction
+//   --loss-rate=<double> (optional) the fraction of the requests that are lost
+class OfflineSyncBenchmark {
+ public:
+  enum class Scenario {
+    UPLOAD,
+    PIPELINE,
+    DOWNLOAD,
+    CONVERGENCE,
+    BACKLOG,
+  };
+
+  OfflineSyncBenchmark(Scenario scenario,
+                       int iteration_count,
+                       int entry_count,
+                       int value_size,
+                       ledger::NetworkConditions conditions);
+  ~OfflineSyncBenchmark();
+
+  void Run();
+
+ private:
+  class Device;
+
+  // Starts a device on the storage of the given index, and connects it to the
+  // benchmark page.
+  bool StartDevice(size_t index);
+
+  void RunUpload(int iteration);
+  // Uploads all the commits from the first device, then calls |on_done|.
+  void UploadAll(int iteration, ftl::Closure on_done);
+  void RunPipeline();
+  void RunDownload();
+  void RunConvergence(int iteration);
+  void RunBacklog();
+  // Calls |on_done| once the device of the given index has |key_count| keys.
+  void WaitForKeys(size_t index, size_t key_count, ftl::Closure on_done);
+
+  void ShutDown();
+
+  test::DataGenerator generator_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const Scenario scenario_;
+  const int iteration_count_;
+  const int entry_count_;
+  const int value_size_;
+  FakeCloud cloud_;
+  std::vector<std::unique_ptr<files::ScopedTempDir>> storages_;
+  std::vector<std::unique_ptr<Device>> devices_;
+  fidl::Array<uint8_t> page_id_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(OfflineSyncBenchmark);
+};
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_OFFLINE_SYNC_OFFLINE_SYNC_H_
@@ -0,0 +1,221 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/page_open/page_open.h"
+
+#include <iostream>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/test/benchmark/lib/logging.h"
+#include "apps/ledger/src/test/get_ledger.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/files/directory.h"
+#include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace {
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/page_open";
+constexpr ftl::StringView kIterationCountFlag = "iteration-count";
+constexpr ftl::StringView kEditCountFlag = "edit-count";
+constexpr ftl::StringView kValueSizeFlag = "value-size";
+constexpr ftl::StringView kWaitMsFlag = "wait-ms";
+constexpr ftl::StringView kServerIdFlag = "server-id";
+
+constexpr size_t kKeySize = 100;
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kIterationCountFlag
+            << "=<int> --" << kEditCountFlag << "=<int> --" << kValueSizeFlag
+            << "=<int> --" << kWaitMsFlag << "=<int> --" << kServerIdFlag
+            << "=<string>" << std::endl;
+}
+
+}  // namespace
+
+namespace test {
+namespace benchmark {
+
+PageOpenBenchmark::PageOpenBenchmark(size_t iteration_count,
+                                     size_t edit_count,
+                                     size_t value_size,
+                                     ftl::TimeDelta wait_time,
+                                     std::string server_id)
+    : application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      iteration_count_(iteration_count),
+      edit_count_(edit_count),
+      value_size_(value_size),
+      wait_time_(wait_time),
+      server_id_(std::move(server_id)),
+      alpha_tmp_dir_(kStoragePath),
+      beta_tmp_dir_(kStoragePath),
+      token_provider_impl_("",
+                           "sync_user",
+                           "sync_user@google.com",
+                           "client_id") {
+  FTL_DCHECK(iteration_count > 0);
+  FTL_DCHECK(edit_count > 0);
+  FTL_DCHECK(value_size > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_page_open"});
+}
+
+void PageOpenBenchmark::Run() {
+  // Name of the storage directory currently identifies the user. Ensure the
+  // most nested directory has the same name to make the ledgers sync.
+  std::string alpha_path = alpha_tmp_dir_.path() + "/sync_user";
+  bool ret = files::CreateDirectory(alpha_path);
+  FTL_DCHECK(ret);
+
+  std::string beta_path = beta_tmp_dir_.path() + "/sync_user";
+  ret = files::CreateDirectory(beta_path);
+  FTL_DCHECK(ret);
+
+  ledger::LedgerPtr alpha;
+  ledger::Status status = test::GetLedger(
+      mtl::MessageLoop::GetCurrent(), application_context_.get(),
+      &alpha_controller_, &token_provider_impl_, "page_open", alpha_path,
+      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &alpha);
+  QuitOnError(status, "alpha ledger");
+
+  status = test::GetLedger(
+      mtl::MessageLoop::GetCurrent(), application_context_.get(),
+      &beta_controller_, &token_provider_impl_, "page_open", beta_path,
+      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &beta_);
+  QuitOnError(status, "beta ledger");
+
+  fidl::Array<uint8_t> id;
+  status = test::GetPageEnsureInitialized(mtl::MessageLoop::GetCurrent(),
+                                          &alpha, nullptr, &alpha_page_, &id);
+  QuitOnError(status, "alpha page initialization");
+  page_id_ = std::move(id);
+
+  // Beta uses the page once, and closes it before the remote edits start.
+  beta_->GetPage(page_id_.Clone(), beta_page_.NewRequest(),
+                 [this](ledger::Status status) {
+                   if (benchmark::QuitOnError(status, "GetPage")) {
+                     return;
+                   }
+                   beta_page_.reset();
+                   RunSingle(0);
+                 });
+}
+
+void PageOpenBenchmark::RunSingle(size_t i) {
+  if (i == iteration_count_) {
+    ShutDown();
+    return;
+  }
+
+  alpha_page_->StartTransaction(
+      benchmark::QuitOnErrorCallback("StartTransaction"));
+  for (size_t j = 0; j < edit_count_; ++j) {
+    alpha_page_->Put(generator_.MakeKey(i * edit_count_ + j, kKeySize),
+                     generator_.MakeValue(value_size_),
+                     benchmark::QuitOnErrorCallback("Put"));
+  }
+  alpha_page_->Commit([this, i](ledger::Status status) {
+    if (benchmark::QuitOnError(status, "Commit")) {
+      return;
+    }
+    mtl::MessageLoop::GetCurrent()->task_runner()->PostDelayedTask(
+        [this, i] { OpenAndRead(i); }, wait_time_);
+  });
+}
+
+void PageOpenBenchmark::OpenAndRead(size_t i) {
+  TRACE_ASYNC_BEGIN("benchmark", "page open to first read", i);
+  beta_->GetPage(page_id_.Clone(), beta_page_.NewRequest(),
+                 benchmark::QuitOnErrorCallback("GetPage"));
+
+  ledger::PageSnapshotPtr snapshot;
+  beta_page_->GetSnapshot(snapshot.NewRequest(), nullptr, nullptr,
+                          benchmark::QuitOnErrorCallback("GetSnapshot"));
+
+  ledger::PageSnapshot* snapshot_ptr = snapshot.get();
+  snapshot_ptr->Get(
+      generator_.MakeKey((i + 1) * edit_count_ - 1, kKeySize),
+      ftl::MakeCopyable([ this, i, snapshot = std::move(snapshot) ](
+          ledger::Status status, mx::vmo value) {
+        // If the edits were not received yet, don't record the end of the
+        // read, which will fail the benchmark.
+        if (status == ledger::Status::OK) {
+          TRACE_ASYNC_END("benchmark", "page open to first read", i);
+        } else if (status != ledger::Status::KEY_NOT_FOUND) {
+          benchmark::QuitOnError(status, "Get");
+          return;
+        }
+        Reopen(i);
+      }));
+}
+
+void PageOpenBenchmark::Reopen(size_t i) {
+  beta_page_.reset();
+  TRACE_ASYNC_BEGIN("benchmark", "page reopen", i);
+  beta_->GetPage(page_id_.Clone(), beta_page_.NewRequest(),
+                 [this, i](ledger::Status status) {
+                   if (benchmark::QuitOnError(status, "GetPage")) {
+                     return;
+                   }
+                   TRACE_ASYNC_END("benchmark", "page reopen", i);
+                   beta_page_.reset();
+                   RunSingle(i + 1);
+                 });
+}
+
+void PageOpenBenchmark::ShutDown() {
+  alpha_controller_->Kill();
+  alpha_controller_.WaitForIncomingResponseWithTimeout(
+      ftl::TimeDelta::FromSeconds(5));
+  beta_controller_->Kill();
+  beta_controller_.WaitForIncomingResponseWithTimeout(
+      ftl::TimeDelta::FromSeconds(5));
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+}  // namespace test
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  std::string iteration_count_str;
+  size_t iteration_count;
+  std::string edit_count_str;
+  size_t edit_count;
+  std::string value_size_str;
+  size_t value_size;
+  std::string wait_ms_str;
+  int wait_ms;
+  std::string server_id;
+  if (!command_line.GetOptionValue(kIterationCountFlag.ToString(),
+                                   &iteration_count_str) ||
+      !ftl::StringToNumberWithError(iteration_count_str, &iteration_count) ||
+      iteration_count <= 0 ||
+      !command_line.GetOptionValue(kEditCountFlag.ToString(),
+                                   &edit_count_str) ||
+      !ftl::StringToNumberWithError(edit_count_str, &edit_count) ||
+      edit_count <= 0 ||
+      !command_line.GetOptionValue(kValueSizeFlag.ToString(),
+                                   &value_size_str) ||
+      !ftl::StringToNumberWithError(value_size_str, &value_size) ||
+      value_size <= 0 ||
+      !command_line.GetOptionValue(kWaitMsFlag.ToString(), &wait_ms_str) ||
+      !ftl::StringToNumberWithError(wait_ms_str, &wait_ms) || wait_ms < 0 ||
+      !command_line.GetOptionValue(kServerIdFlag.ToString(), &server_id)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  test::benchmark::PageOpenBenchmark app(
+      iteration_count, edit_count, value_size,
+      ftl::TimeDelta::FromMilliseconds(wait_ms), server_id);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
@@ -0,0 +1,87 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_PAGE_OPEN_PAGE_OPEN_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_PAGE_OPEN_PAGE_OPEN_H_
+
+#include <memory>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/fidl_helpers/bound_interface_set.h"
+#include "apps/ledger/src/test/data_generator.h"
+#include "apps/ledger/src/test/fake_token_provider.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace test {
+namespace benchmark {
+
+// Benchmark that measures the time needed to open a page and read a remote edit
+// from it, when the page was closed while the edit was made. A first Ledger
+// instance commits |edit-count| entries to the page, and |wait-ms| later, a
+// second instance that closed the page reopens it and reads the last of these
+// entries. The time between the reopening request and the read is measured.
+// The second instance then closes the page and immediately reopens it, which
+// measures the latency of reopening a page that has no new remote edits.
+//
+// The time spent by the Ledger instances waiting for a slot of the sync
+// scheduler, and waiting for the sync of an opened page to catch up with the
+// cloud before binding it, is reported through the "sync_slot_wait" and
+// "page_sync_catch_up" trace events.
+//
+// Cloud sync needs to be configured on the device in order for the benchmark to
+// run.
+//
+// Parameters:
+//   --iteration-count=<int> the number of times the page is reopened
+//   --edit-count=<int> the number of entries committed while the page is closed
+//   --value-size=<int> the size of a single value in bytes
+//   --wait-ms=<int> the time between the remote edits and the reopening
+//   --server-id=<string> the ID of the Firebase instance ot use for syncing
+class PageOpenBenchmark {
+ public:
+  PageOpenBenchmark(size_t iteration_count,
+                    size_t edit_count,
+                    size_t value_size,
+                    ftl::TimeDelta wait_time,
+                    std::string server_id);
+
+  void Run();
+
+ private:
+  void RunSingle(size_t i);
+
+  void OpenAndRead(size_t i);
+
+  void Reopen(size_t i);
+
+  void ShutDown();
+
+  test::DataGenerator generator_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const size_t iteration_count_;
+  const size_t edit_count_;
+  const size_t value_size_;
+  const ftl::TimeDelta wait_time_;
+  std::string server_id_;
+  files::ScopedTempDir alpha_tmp_dir_;
+  files::ScopedTempDir beta_tmp_dir_;
+  app::ApplicationControllerPtr alpha_controller_;
+  app::ApplicationControllerPtr beta_controller_;
+  ledger::fidl_helpers::BoundInterfaceSet<modular::auth::TokenProvider,
+                                          test::FakeTokenProvider>
+      token_provider_impl_;
+  ledger::LedgerPtr beta_;
+  fidl::Array<uint8_t> page_id_;
+  ledger::PagePtr alpha_page_;
+  ledger::PagePtr beta_page_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(PageOpenBenchmark);
+};
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_PAGE_OPEN_PAGE_OPEN_H_
@@ -0,0 +1,605 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/replay/replay.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include <rapidjson/document.h>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/test/benchmark/lib/logging.h"
+#include "apps/ledger/src/test/get_ledger.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/random/rand.h"
+#include "lib/ftl/strings/split_string.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/vmo/strings.h"
+
+namespace {
+
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/replay";
+
+constexpr ftl::StringView kTraceFlag = "trace";
+constexpr ftl::StringView kSpeedFlag = "speed";
+constexpr ftl::StringView kSeedFlag = "seed";
+
+constexpr ftl::StringView kPageSnapshotMethodPrefix = "PageSnapshot.";
+
+// Number of bytes of the keys of the trace for each byte of the recorded keys.
+// See ledger::OperationRecorder::HashKey().
+constexpr size_t kHashBytesPerKeyByte = 8u;
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kTraceFlag
+            << "=<path> [--" << kSpeedFlag << "=<double>] [--" << kSeedFlag
+            << "=<int>]" << std::endl;
+}
+
+// Decodes the hexadecimal representation of the keys in the trace.
+bool FromHex(ftl::StringView hex, std::string* result) {
+  if (hex.size() % 2 != 0) {
+    return false;
+  }
+  std::string bytes;
+  bytes.reserve(hex.size() / 2);
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    uint8_t byte;
+    if (!ftl::StringToNumberWithError(hex.substr(i, 2), &byte,
+                                      ftl::Base::k16)) {
+      return false;
+    }
+    bytes.push_back(byte);
+  }
+  result->swap(bytes);
+  return true;
+}
+
+// Returns the |percentile|-th percentile of |values|, which must be sorted.
+int64_t GetPercentile(const std::vector<int64_t>& values, size_t percentile) {
+  if (values.empty()) {
+    return 0;
+  }
+  return values[std::min(values.size() - 1, values.size() * percentile / 100)];
+}
+
+// Returns the argument |name| of |call|, or |default_value| if the call does
+// not have it.
+template <typename C>
+int64_t GetNumber(const C& call, const std::string& name,
+                  int64_t default_value = 0) {
+  auto it = call.numbers.find(name);
+  return it == call.numbers.end() ? default_value : it->second;
+}
+
+// Returns the key |name| of |call|, or a null array if the call does not have
+// it.
+template <typename C>
+fidl::Array<uint8_t> GetKey(const C& call, const std::string& name) {
+  auto it = call.keys.find(name);
+  if (it == call.keys.end()) {
+    return nullptr;
+  }
+  return convert::ToArray(it->second);
+}
+
+}  // namespace
+
+namespace test {
+namespace benchmark {
+
+ReplayBenchmark::ReplayBenchmark(std::string trace_path,
+                                 double speed,
+                                 uint64_t seed)
+    : generator_(seed),
+      tmp_dir_(kStoragePath),
+      application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      token_provider_impl_("",
+                           "sync_user",
+                           "sync_user@google.com",
+                           "client_id"),
+      trace_path_(std::move(trace_path)),
+      speed_(speed) {
+  FTL_DCHECK(speed >= 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_replay"});
+}
+
+void ReplayBenchmark::Run() {
+  FTL_LOG(INFO) << "--trace=" << trace_path_ << " --speed=" << speed_;
+  if (!LoadTrace()) {
+    mtl::MessageLoop::GetCurrent()->PostQuitTask();
+    return;
+  }
+
+  ledger::Status status = test::GetLedger(
+      mtl::MessageLoop::GetCurrent(), application_context_.get(),
+      &application_controller_, &token_provider_impl_, "replay",
+      tmp_dir_.path(), test::SyncState::DISABLED, "", &ledger_);
+  if (QuitOnError(status, "GetLedger") || !OpenPages()) {
+    return;
+  }
+
+  TRACE_ASYNC_BEGIN("benchmark", "replay", 0);
+  start_time_ = ftl::TimePoint::Now();
+  ReplayNext();
+}
+
+void ReplayBenchmark::OnChange(ledger::PageChangePtr page_change,
+                               ledger::ResultState result_state,
+                               const OnChangeCallback& callback) {
+  ++notification_count_;
+  callback(nullptr);
+}
+
+std::string ReplayBenchmark::MapKey(const std::string& hashed_key) {
+  // Walk down the tree of the prefixes of the keys seen so far, adding the
+  // missing ones. The children of each prefix are numbered in order of
+  // appearance, which fits in a byte as they come from distinct bytes of the
+  // recorded keys.
+  std::string key;
+  key.reserve(hashed_key.size() / kHashBytesPerKeyByte);
+  uint64_t prefix = 0u;
+  for (size_t i = 0; i < hashed_key.size(); i += kHashBytesPerKeyByte) {
+    auto part =
+        std::make_pair(prefix, hashed_key.substr(i, kHashBytesPerKeyByte));
+    auto it = key_prefixes_.find(part);
+    if (it == key_prefixes_.end()) {
+      size_t child_count = key_prefix_child_counts_[prefix]++;
+      FTL_DCHECK(child_count < 256u);
+      uint64_t id = key_prefixes_.size() + 1u;
+      it = key_prefixes_
+               .emplace(std::move(part),
+                        std::make_pair(id, static_cast<char>(child_count)))
+               .first;
+    }
+    prefix = it->second.first;
+    key.push_back(it->second.second);
+  }
+  return key;
+}
+
+bool ReplayBenchmark::LoadTrace() {
+  std::string content;
+  if (!files::ReadFileToString(trace_path_, &content)) {
+    FTL_LOG(ERROR) << "Unable to read the trace at " << trace_path_;
+    return false;
+  }
+  for (ftl::StringView line : ftl::SplitString(
+           content, "\n", ftl::WhiteSpaceHandling::kTrimWhitespace,
+           ftl::SplitResult::kSplitWantNonEmpty)) {
+    rapidjson::Document document;
+    document.Parse(line.data(), line.size());
+    if (document.HasParseError() || !document.IsObject() ||
+        !document.HasMember("method") || !document["method"].IsString()) {
+      FTL_LOG(ERROR) << "Invalid operation in the trace: " << line;
+      return false;
+    }
+    Call call;
+    for (auto it = document.MemberBegin(); it != document.MemberEnd(); ++it) {
+      std::string name(it->name.GetString(), it->name.GetStringLength());
+      if (name == "method") {
+        call.method.assign(it->value.GetString(), it->value.GetStringLength());
+      } else if (it->value.IsString()) {
+        std::string hashed_key;
+        if (!FromHex(ftl::StringView(it->value.GetString(),
+                                     it->value.GetStringLength()),
+                     &hashed_key) ||
+            hashed_key.size() % kHashBytesPerKeyByte != 0u) {
+          FTL_LOG(ERROR) << "Invalid key in the trace: " << line;
+          return false;
+        }
+        call.keys[name] = MapKey(hashed_key);
+      } else if (it->value.IsInt64()) {
+        call.numbers[name] = it->value.GetInt64();
+      }
+    }
+    call.time_us = GetNumber(call, "time_us");
+    call.duration_us = GetNumber(call, "duration_us");
+    call.page = GetNumber(call, "page");
+    call.has_status = call.numbers.count("status") > 0;
+    call.status = static_cast<ledger::Status>(GetNumber(call, "status"));
+
+    // Notifications are not calls made by the client.
+    if (call.method == "PageWatcher.OnChange") {
+      ++recorded_notification_count_;
+      continue;
+    }
+    calls_.push_back(std::move(call));
+  }
+  // The operations are written when they return: replay them in the order
+  // they started.
+  std::stable_sort(calls_.begin(), calls_.end(),
+                   [](const Call& a, const Call& b) {
+                     return a.time_us < b.time_us;
+                   });
+  return true;
+}
+
+bool ReplayBenchmark::OpenPages() {
+  for (const auto& call : calls_) {
+    if (pages_.count(call.page)) {
+      continue;
+    }
+    fidl::Array<uint8_t> id;
+    ledger::Status status = test::GetPageEnsureInitialized(
+        mtl::MessageLoop::GetCurrent(), &ledger_, nullptr, &pages_[call.page],
+        &id);
+    if (QuitOnError(status, "GetPageEnsureInitialized")) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ReplayBenchmark::ReplayNext() {
+  while (next_call_ < calls_.size()) {
+    if (speed_ == 0) {
+      // Closed loop: the next call is issued when this one returns.
+      if (pending_calls_ > 0u) {
+        return;
+      }
+    } else {
+      ftl::TimePoint due_time =
+          start_time_ + ftl::TimeDelta::FromMicroseconds(static_cast<int64_t>(
+                            calls_[next_call_].time_us / speed_));
+      ftl::TimeDelta delay = due_time - ftl::TimePoint::Now();
+      if (delay > ftl::TimeDelta::Zero()) {
+        mtl::MessageLoop::GetCurrent()->task_runner()->PostDelayedTask(
+            [this] { ReplayNext(); }, delay);
+        return;
+      }
+    }
+    Issue(next_call_++);
+  }
+  CheckFinished();
+}
+
+void ReplayBenchmark::Issue(size_t i) {
+  const Call& call = calls_[i];
+  ledger::Page* page = pages_[call.page].get();
+
+  if (call.method == "Page.PutWithPriority") {
+    page->PutWithPriority(
+        GetKey(call, "key"),
+        generator_.MakeValue(GetNumber(call, "value_size")),
+        static_cast<ledger::Priority>(GetNumber(call, "priority")),
+        OnDoneCallback(i));
+  } else if (call.method == "Page.PutReference") {
+    IssuePutReference(i);
+  } else if (call.method == "Page.Delete") {
+    page->Delete(GetKey(call, "key"), OnDoneCallback(i));
+  } else if (call.method == "Page.CreateReferenceFromSocket" ||
+             call.method == "Page.CreateReferenceFromVmo") {
+    // Both are replayed from a VMO, as the data is generated up front.
+    mx::vmo vmo;
+    FTL_CHECK(mtl::VmoFromString(
+        convert::ToString(generator_.MakeValue(GetNumber(call, "size"))),
+        &vmo));
+    bool has_reference = call.numbers.count("reference") > 0;
+    PageObject reference_id(call.page, GetNumber(call, "reference"));
+    if (has_reference) {
+      pending_references_[reference_id];
+    }
+    auto on_done = OnDoneCallback(i);
+    page->CreateReferenceFromVmo(std::move(vmo), [
+      this, has_reference, reference_id, on_done
+    ](ledger::Status status, ledger::ReferencePtr reference) {
+      if (has_reference) {
+        std::vector<size_t> waiting =
+            std::move(pending_references_[reference_id]);
+        pending_references_.erase(reference_id);
+        if (status == ledger::Status::OK) {
+          references_[reference_id] = std::move(reference);
+        }
+        for (size_t put : waiting) {
+          IssuePutReference(put);
+        }
+      }
+      on_done(status);
+    });
+  } else if (call.method == "Page.StartTransaction") {
+    page->StartTransaction(OnDoneCallback(i));
+  } else if (call.method == "Page.Commit") {
+    page->Commit(OnDoneCallback(i));
+  } else if (call.method == "Page.Rollback") {
+    page->Rollback(OnDoneCallback(i));
+  } else if (call.method == "Page.GetSnapshot") {
+    ledger::PageSnapshotPtr snapshot;
+    auto snapshot_request = snapshot.NewRequest();
+    if (call.numbers.count("snapshot")) {
+      snapshots_[PageObject(call.page, GetNumber(call, "snapshot"))] =
+          std::move(snapshot);
+    }
+    ledger::PageWatcherPtr watcher;
+    if (GetNumber(call, "watcher")) {
+      watcher_bindings_.AddBinding(this, watcher.NewRequest());
+    }
+    if (call.numbers.count("min_delivery_interval_ms")) {
+      auto watcher_options = ledger::WatcherOptions::New();
+      watcher_options->min_delivery_interval_ms =
+          GetNumber(call, "min_delivery_interval_ms");
+      watcher_options->max_batch_size = GetNumber(call, "max_batch_size");
+      page->GetSnapshotWithWatcherOptions(
+          std::move(snapshot_request), GetKey(call, "key_prefix"),
+          std::move(watcher), std::move(watcher_options), OnDoneCallback(i));
+    } else {
+      page->GetSnapshot(std::move(snapshot_request),
+                        GetKey(call, "key_prefix"), std::move(watcher),
+                        OnDoneCallback(i));
+    }
+  } else if (call.method == "Page.GetChangesSince") {
+    // Tokens are specific to the commits of the recorded ledger.
+    if (GetNumber(call, "token") || GetNumber(call, "page_token")) {
+      Skip(i);
+      return;
+    }
+    auto on_done = OnDoneCallback(i);
+    page->GetChangesSince(
+        nullptr, nullptr,
+        [on_done](ledger::Status status, ledger::PageChangePtr /*change*/,
+                  fidl::Array<uint8_t> /*next_page_token*/,
+                  fidl::Array<uint8_t> /*new_token*/) { on_done(status); });
+  } else if (ftl::StringView(call.method)
+                 .substr(0, kPageSnapshotMethodPrefix.size()) ==
+             kPageSnapshotMethodPrefix) {
+    auto it =
+        snapshots_.find(PageObject(call.page, GetNumber(call, "snapshot")));
+    if (it == snapshots_.end()) {
+      // The snapshot was given to a page watcher or to a conflict resolver.
+      Skip(i);
+      return;
+    }
+    IssueSnapshotCall(i, it->second.get());
+  } else {
+    Skip(i);
+  }
+}
+
+void ReplayBenchmark::IssueSnapshotCall(size_t i,
+                                        ledger::PageSnapshot* snapshot) {
+  const Call& call = calls_[i];
+
+  if (call.method == "PageSnapshot.Get") {
+    auto on_done = OnDoneCallback(i);
+    snapshot->Get(GetKey(call, "key"),
+                  [on_done](ledger::Status status, mx::vmo /*value*/) {
+                    on_done(status);
+                  });
+    return;
+  }
+  if (call.method == "PageSnapshot.GetInline") {
+    auto on_done = OnDoneCallback(i);
+    snapshot->GetInline(
+        GetKey(call, "key"),
+        [on_done](ledger::Status status, fidl::Array<uint8_t> /*value*/) {
+          on_done(status);
+        });
+    return;
+  }
+  if (call.method == "PageSnapshot.Fetch") {
+    auto on_done = OnDoneCallback(i);
+    snapshot->Fetch(GetKey(call, "key"),
+                    [on_done](ledger::Status status, mx::vmo /*value*/) {
+                      on_done(status);
+                    });
+    return;
+  }
+  if (call.method == "PageSnapshot.FetchPartial") {
+    auto on_done = OnDoneCallback(i);
+    snapshot->FetchPartial(
+        GetKey(call, "key"), GetNumber(call, "offset"),
+        GetNumber(call, "max_size", -1),
+        [on_done](ledger::Status status, mx::vmo /*buffer*/) {
+          on_done(status);
+        });
+    return;
+  }
+
+  if (call.method != "PageSnapshot.GetEntries" &&
+      call.method != "PageSnapshot.GetEntriesInline" &&
+      call.method != "PageSnapshot.GetKeys") {
+    Skip(i);
+    return;
+  }
+
+  // Listings: a continuation uses the token returned by the previous listing
+  // of the same method on the same snapshot.
+  auto token_id = std::make_pair(
+      PageObject(call.page, GetNumber(call, "snapshot")), call.method);
+  fidl::Array<uint8_t> token;
+  if (GetNumber(call, "token")) {
+    auto it = next_tokens_.find(token_id);
+    if (it == next_tokens_.end()) {
+      // The listing completed in fewer calls than recorded.
+      Skip(i);
+      return;
+    }
+    token = std::move(it->second);
+    next_tokens_.erase(it);
+  }
+  auto on_done = OnDoneCallback(i);
+  auto on_page = [this, token_id, on_done](ledger::Status status,
+                                           fidl::Array<uint8_t> next_token) {
+    if (next_token) {
+      next_tokens_[token_id] = std::move(next_token);
+    }
+    on_done(status);
+  };
+  if (call.method == "PageSnapshot.GetEntries") {
+    snapshot->GetEntries(GetKey(call, "key_start"), std::move(token),
+                         [on_page](ledger::Status status,
+                                   fidl::Array<ledger::EntryPtr> /*entries*/,
+                                   fidl::Array<uint8_t> next_token) {
+                           on_page(status, std::move(next_token));
+                         });
+  } else if (call.method == "PageSnapshot.GetEntriesInline") {
+    snapshot->GetEntriesInline(
+        GetKey(call, "key_start"), std::move(token),
+        [on_page](ledger::Status status,
+                  fidl::Array<ledger::InlinedEntryPtr> /*entries*/,
+                  fidl::Array<uint8_t> next_token) {
+          on_page(status, std::move(next_token));
+        });
+  } else {
+    snapshot->GetKeys(GetKey(call, "key_start"), std::move(token),
+                      [on_page](ledger::Status status,
+                                fidl::Array<fidl::Array<uint8_t>> /*keys*/,
+                                fidl::Array<uint8_t> next_token) {
+                        on_page(status, std::move(next_token));
+                      });
+  }
+}
+
+void ReplayBenchmark::IssuePutReference(size_t i) {
+  const Call& call = calls_[i];
+  PageObject reference_id(call.page, GetNumber(call, "reference"));
+  if (pending_references_.count(reference_id)) {
+    // The reference is still being created.
+    pending_references_[reference_id].push_back(i);
+    return;
+  }
+  auto it = references_.find(reference_id);
+  if (!call.numbers.count("reference") || it == references_.end()) {
+    // The reference was created before the recording started.
+    Skip(i);
+    CheckFinished();
+    return;
+  }
+  pages_[call.page]->PutReference(
+      GetKey(call, "key"), it->second.Clone(),
+      static_cast<ledger::Priority>(GetNumber(call, "priority")),
+      OnDoneCallback(i));
+}
+
+void ReplayBenchmark::Skip(size_t i) {
+  ++stats_[calls_[i].method].skipped;
+}
+
+std::function<void(ledger::Status)> ReplayBenchmark::OnDoneCallback(size_t i) {
+  ++pending_calls_;
+  ftl::TimePoint start_time = ftl::TimePoint::Now();
+  return [this, i, start_time](ledger::Status status) {
+    OnDone(i, status, start_time);
+  };
+}
+
+void ReplayBenchmark::OnDone(size_t i,
+                             ledger::Status status,
+                             ftl::TimePoint start_time) {
+  const Call& call = calls_[i];
+  MethodStats& stats = stats_[call.method];
+  stats.latencies_us.push_back(
+      (ftl::TimePoint::Now() - start_time).ToMicroseconds());
+  stats.recorded_latencies_us.push_back(call.duration_us);
+  if (call.has_status && status != call.status) {
+    ++stats.status_mismatches;
+  }
+
+  FTL_DCHECK(pending_calls_ > 0u);
+  --pending_calls_;
+  if (speed_ == 0) {
+    ReplayNext();
+    return;
+  }
+  CheckFinished();
+}
+
+void ReplayBenchmark::CheckFinished() {
+  if (finished_ || next_call_ < calls_.size() || pending_calls_ > 0u ||
+      !pending_references_.empty()) {
+    return;
+  }
+  finished_ = true;
+  TRACE_ASYNC_END("benchmark", "replay", 0);
+  Report();
+  ShutDown();
+}
+
+void ReplayBenchmark::Report() {
+  printf("Replayed %zu calls in %.3f s, %zu/%zu watcher notifications\n",
+         calls_.size(), (ftl::TimePoint::Now() - start_time_).ToSecondsF(),
+         notification_count_, recorded_notification_count_);
+  printf("%-32s %8s %8s %8s %10s %10s %10s %10s %12s %12s\n", "Method",
+         "Calls", "Skipped", "Status", "p50 (us)", "p90 (us)", "p99 (us)",
+         "max (us)", "rec p50 (us)", "rec p99 (us)");
+  for (auto& entry : stats_) {
+    MethodStats& stats = entry.second;
+    std::sort(stats.latencies_us.begin(), stats.latencies_us.end());
+    std::sort(stats.recorded_latencies_us.begin(),
+              stats.recorded_latencies_us.end());
+    printf("%-32s %8zu %8zu %8zu %10" PRId64 " %10" PRId64 " %10" PRId64
+           " %10" PRId64 " %12" PRId64 " %12" PRId64 "\n",
+           entry.first.c_str(), stats.latencies_us.size(), stats.skipped,
+           stats.status_mismatches, GetPercentile(stats.latencies_us, 50),
+           GetPercentile(stats.latencies_us, 90),
+           GetPercentile(stats.latencies_us, 99),
+           stats.latencies_us.empty() ? 0 : stats.latencies_us.back(),
+           GetPercentile(stats.recorded_latencies_us, 50),
+           GetPercentile(stats.recorded_latencies_us, 99));
+  }
+  fflush(stdout);
+}
+
+void ReplayBenchmark::ShutDown() {
+  // Shut down the Ledger process first as it relies on |tmp_dir_| storage.
+  application_controller_->Kill();
+  application_controller_.WaitForIncomingResponseWithTimeout(
+      ftl::TimeDelta::FromSeconds(5));
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+}  // namespace test
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  std::string trace_path;
+  if (!command_line.GetOptionValue(kTraceFlag.ToString(), &trace_path) ||
+      trace_path.empty()) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  double speed = 1.0;
+  std::string speed_str;
+  if (command_line.GetOptionValue(kSpeedFlag.ToString(), &speed_str)) {
+    char* end;
+    speed = strtod(speed_str.c_str(), &end);
+    if (*end != '\0' || speed < 0) {
+      PrintUsage(argv[0]);
+      return -1;
+    }
+  }
+
+  int seed;
+  std::string seed_str;
+  if (command_line.GetOptionValue(kSeedFlag.ToString(), &seed_str)) {
+    if (!ftl::StringToNumberWithError(seed_str, &seed)) {
+      PrintUsage(argv[0]);
+      return -1;
+    }
+  } else {
+    seed = ftl::RandUint64();
+  }
+
+  mtl::MessageLoop loop;
+  test::benchmark::ReplayBenchmark app(std::move(trace_path), speed, seed);
+  // TODO(nellyv): A delayed task is necessary because of US-257.
+  loop.task_runner()->PostDelayedTask([&app] { app.Run(); },
+                                      ftl::TimeDelta::FromSeconds(1));
+  loop.Run();
+  return 0;
+}
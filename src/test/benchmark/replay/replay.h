@@ -0,0 +1,147 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_REPLAY_REPLAY_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_REPLAY_REPLAY_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/fidl_helpers/bound_interface_set.h"
+#include "apps/ledger/src/test/data_generator.h"
+#include "apps/ledger/src/test/fake_token_provider.h"
+#include "lib/fidl/cpp/bindings/binding_set.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace test {
+namespace benchmark {
+
+// Benchmark that replays the operations recorded by a Ledger started with
+// --record_operations=<path> against a new ledger, and reports the latency of
+// each method next to the recorded one.
+//
+// Keys are replayed from their anonymized version in the trace, mapped back to
+// keys of the recorded size that share the same prefixes, and values are
+// random data of the recorded size. A page watcher is registered for each
+// recorded one, and acknowledges the changes right away. The following calls
+// are counted but not replayed: the calls on the snapshots given to the page
+// watchers, GetChangesSince() with a token, and the continuations of the
+// listings that do not get a token at replay.
+//
+// Parameters:
+//   --trace=<path> the trace of the operations to replay
+//   --speed=<double> (optional) the speed of the replay relative to the
+//     recording, 1 by default. 0 replays each call as soon as the previous one
+//     returned.
+//   --seed=<int> (optional) the seed for value generation
+class ReplayBenchmark : public ledger::PageWatcher {
+ public:
+  ReplayBenchmark(std::string trace_path, double speed, uint64_t seed);
+
+  void Run();
+
+  // ledger::PageWatcher:
+  void OnChange(ledger::PageChangePtr page_change,
+                ledger::ResultState result_state,
+                const OnChangeCallback& callback) override;
+
+ private:
+  // A recorded call.
+  struct Call {
+    int64_t time_us = 0;
+    int64_t duration_us = 0;
+    std::string method;
+    uint64_t page = 0u;
+    bool has_status = false;
+    ledger::Status status = ledger::Status::OK;
+    // The keys of the call, decoded.
+    std::map<std::string, std::string> keys;
+    // The other numeric arguments of the call.
+    std::map<std::string, int64_t> numbers;
+  };
+
+  struct MethodStats {
+    std::vector<int64_t> latencies_us;
+    std::vector<int64_t> recorded_latencies_us;
+    size_t skipped = 0u;
+    size_t status_mismatches = 0u;
+  };
+
+  // Identifies a snapshot or a reference in the trace: the index of the page,
+  // and the index of the snapshot or reference on the page.
+  using PageObject = std::pair<uint64_t, uint64_t>;
+
+  // Returns the key to replay for the anonymized key |hashed_key|. Keys are
+  // mapped to distinct keys of their recorded size, and prefixes of keys to
+  // prefixes of their mapped keys.
+  std::string MapKey(const std::string& hashed_key);
+  bool LoadTrace();
+  bool OpenPages();
+
+  // Issues the calls that are due, and schedules the next ones.
+  void ReplayNext();
+  void Issue(size_t i);
+  void IssueSnapshotCall(size_t i, ledger::PageSnapshot* snapshot);
+  void IssuePutReference(size_t i);
+  void Skip(size_t i);
+  // Returns the callback to call when the |i|-th call, issued now, returns.
+  std::function<void(ledger::Status)> OnDoneCallback(size_t i);
+  void OnDone(size_t i, ledger::Status status, ftl::TimePoint start_time);
+  void CheckFinished();
+
+  void Report();
+  void ShutDown();
+
+  test::DataGenerator generator_;
+  files::ScopedTempDir tmp_dir_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  ledger::fidl_helpers::BoundInterfaceSet<modular::auth::TokenProvider,
+                                          test::FakeTokenProvider>
+      token_provider_impl_;
+  const std::string trace_path_;
+  const double speed_;
+
+  app::ApplicationControllerPtr application_controller_;
+  ledger::LedgerPtr ledger_;
+  fidl::BindingSet<ledger::PageWatcher> watcher_bindings_;
+
+  std::vector<Call> calls_;
+  size_t recorded_notification_count_ = 0u;
+  size_t notification_count_ = 0u;
+  size_t next_call_ = 0u;
+  size_t pending_calls_ = 0u;
+  bool finished_ = false;
+  ftl::TimePoint start_time_;
+
+  std::map<uint64_t, ledger::PagePtr> pages_;
+  std::map<PageObject, ledger::PageSnapshotPtr> snapshots_;
+  std::map<PageObject, ledger::ReferencePtr> references_;
+  // References being created, and the PutReference() calls waiting for them.
+  std::map<PageObject, std::vector<size_t>> pending_references_;
+  // Tokens returned by the last listing of each method on each snapshot.
+  std::map<std::pair<PageObject, std::string>, fidl::Array<uint8_t>>
+      next_tokens_;
+  std::map<std::string, MethodStats> stats_;
+  // The prefixes of the anonymized keys, identified by the id of their parent
+  // prefix, 0 for the empty one, and their last part. Maps each one to its own
+  // id and to the last byte of its mapped key.
+  std::map<std::pair<uint64_t, std::string>, std::pair<uint64_t, char>>
+      key_prefixes_;
+  // The number of children of each prefix.
+  std::map<uint64_t, size_t> key_prefix_child_counts_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ReplayBenchmark);
+};
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_REPLAY_REPLAY_H_
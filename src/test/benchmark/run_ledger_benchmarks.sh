@@ -11,3 +11,10 @@ set -e
 
 /system/bin/trace record --spec-file=/system/data/ledger/benchmark/put.tspec
 /system/bin/trace record --spec-file=/system/data/ledger/benchmark/transaction.tspec
+/system/bin/trace record --spec-file=/system/data/ledger/benchmark/get.tspec
+/system/bin/trace record --spec-file=/system/data/ledger/benchmark/watcher_fanout.tspec
+/system/bin/trace record --spec-file=/system/data/ledger/benchmark/offline_sync_upload.tspec
+/system/bin/trace record --spec-file=/system/data/ledger/benchmark/offline_sync_pipeline.tspec
+/system/bin/trace record --spec-file=/system/data/ledger/benchmark/offline_sync_download.tspec
+/system/bin/trace record --spec-file=/system/data/ledger/benchmark/offline_sync_convergence.tspec
+/system/bin/trace record --spec-file=/system/data/ledger/benchmark/offline_sync_backlog.tspec
@@ -0,0 +1,513 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Microbenchmarks of the storage internals: object ids, splitting, tree node
+// encoding, the B-Tree algorithms and the page database. They run directly
+// against a PageStorageImpl on a temporary directory, without FIDL, and report
+// the time and the heap allocations per iteration.
+//
+// See microbenchmark.h for the arguments.
+
+#include <inttypes.h>
+
+#include <functional>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/coroutine/coroutine_impl.h"
+#include "apps/ledger/src/storage/impl/btree/builder.h"
+#include "apps/ledger/src/storage/impl/btree/diff.h"
+#include "apps/ledger/src/storage/impl/btree/encoding.h"
+#include "apps/ledger/src/storage/impl/btree/entry_change_iterator.h"
+#include "apps/ledger/src/storage/impl/btree/iterator.h"
+#include "apps/ledger/src/storage/impl/btree/synchronous_storage.h"
+#include "apps/ledger/src/storage/impl/btree/tree_node.h"
+#include "apps/ledger/src/storage/impl/object_id.h"
+#include "apps/ledger/src/storage/impl/page_db_impl.h"
+#include "apps/ledger/src/storage/impl/page_storage_impl.h"
+#include "apps/ledger/src/storage/impl/split.h"
+#include "apps/ledger/src/storage/public/data_source.h"
+#include "apps/ledger/src/test/benchmark/lib/microbenchmark.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace test {
+namespace benchmark {
+namespace {
+
+using storage::btree::BTreeIterator;
+using storage::btree::EntryChangeIterator;
+using storage::btree::SynchronousStorage;
+
+constexpr size_t kValueSize = 100;
+constexpr size_t kChildCount = 16;
+
+// Waits for the asynchronous operation started by |operation|, which receives
+// the closure to call once the operation is done. The message loop is only run
+// if the operation does not complete synchronously.
+void Await(const std::function<void(ftl::Closure)>& operation) {
+  bool done = false;
+  bool waiting = false;
+  operation([&done, &waiting] {
+    done = true;
+    if (waiting) {
+      mtl::MessageLoop::GetCurrent()->QuitNow();
+    }
+  });
+  if (!done) {
+    waiting = true;
+    mtl::MessageLoop::GetCurrent()->Run();
+  }
+}
+
+std::string MakeValue(std::default_random_engine* rng, size_t size) {
+  std::string value;
+  value.resize(size);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  for (char& c : value) {
+    c = static_cast<char>(distribution(*rng));
+  }
+  return value;
+}
+
+std::string MakeKey(int64_t index) {
+  return ftl::StringPrintf("key%010" PRId64, index);
+}
+
+storage::EntryChange MakeEntryChange(std::default_random_engine* rng,
+                                     int64_t index) {
+  return storage::EntryChange{
+      {MakeKey(index),
+       storage::ComputeObjectId(storage::ObjectType::VALUE,
+                                MakeValue(rng, kValueSize)),
+       storage::KeyPriority::EAGER},
+      false};
+}
+
+// Returns |count| sorted changes, about half of which update the keys of a tree
+// of |tree_size| entries, the others inserting new keys.
+std::vector<storage::EntryChange> MakeChanges(std::default_random_engine* rng,
+                                              int64_t tree_size,
+                                              int64_t count) {
+  FTL_DCHECK(count <= 2 * tree_size);
+  std::uniform_int_distribution<int64_t> distribution(0, 2 * tree_size - 1);
+  std::set<int64_t> indexes;
+  while (static_cast<int64_t>(indexes.size()) < count) {
+    indexes.insert(distribution(*rng));
+  }
+  std::vector<storage::EntryChange> changes;
+  changes.reserve(count);
+  for (int64_t index : indexes) {
+    // Existing keys have even indexes, see |BuildTree()|.
+    changes.push_back(MakeEntryChange(rng, index));
+  }
+  return changes;
+}
+
+// A PageStorageImpl on a temporary directory.
+class StorageFixture {
+ public:
+  StorageFixture()
+      : page_storage_(&coroutine_service_, tmp_dir_.path(), "page_id") {}
+
+  bool Init() {
+    storage::Status status;
+    Await([this, &status](ftl::Closure on_done) {
+      page_storage_.Init(callback::Capture(on_done, &status));
+    });
+    return status == storage::Status::OK;
+  }
+
+  coroutine::CoroutineService* coroutine_service() {
+    return &coroutine_service_;
+  }
+  storage::PageStorageImpl* page_storage() { return &page_storage_; }
+  const std::string& path() { return tmp_dir_.path(); }
+
+  // Applies |changes| to the tree of root |root_id|, and sets |new_root_id|
+  // to the root of the new tree.
+  storage::Status ApplyChanges(storage::ObjectIdView root_id,
+                               const std::vector<storage::EntryChange>& changes,
+                               storage::ObjectId* new_root_id) {
+    storage::Status status;
+    std::unordered_set<storage::ObjectId> new_nodes;
+    Await([&](ftl::Closure on_done) {
+      storage::btree::ApplyChanges(
+          &coroutine_service_, &page_storage_, root_id,
+          std::make_unique<EntryChangeIterator>(changes.begin(),
+                                                changes.end()),
+          callback::Capture(on_done, &status, new_root_id, &new_nodes));
+    });
+    return status;
+  }
+
+  // Builds a tree of |size| entries, with the even keys, and sets |root_id| to
+  // its root.
+  storage::Status BuildTree(std::default_random_engine* rng,
+                            int64_t size,
+                            storage::ObjectId* root_id) {
+    storage::Status status;
+    storage::ObjectId empty_id;
+    Await([&](ftl::Closure on_done) {
+      storage::btree::TreeNode::Empty(
+          &page_storage_, callback::Capture(on_done, &status, &empty_id));
+    });
+    if (status != storage::Status::OK) {
+      return status;
+    }
+    std::vector<storage::EntryChange> changes;
+    changes.reserve(size);
+    for (int64_t i = 0; i < size; ++i) {
+      changes.push_back(MakeEntryChange(rng, 2 * i));
+    }
+    return ApplyChanges(empty_id, changes, root_id);
+  }
+
+ private:
+  files::ScopedTempDir tmp_dir_;
+  coroutine::CoroutineServiceImpl coroutine_service_;
+  storage::PageStorageImpl page_storage_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(StorageFixture);
+};
+
+void ComputeObjectId(MicrobenchmarkState* state) {
+  std::default_random_engine rng(0);
+  std::string value = MakeValue(&rng, state->arg(0));
+  while (state->KeepRunning()) {
+    storage::ComputeObjectId(storage::ObjectType::VALUE, value);
+  }
+  state->SetBytesProcessed(state->iterations() * value.size());
+}
+
+void Split(MicrobenchmarkState* state) {
+  std::default_random_engine rng(0);
+  std::string value = MakeValue(&rng, state->arg(0));
+  while (state->KeepRunning()) {
+    state->PauseTiming();
+    std::unique_ptr<storage::DataSource> source =
+        storage::DataSource::Create(value);
+    state->ResumeTiming();
+    bool error = false;
+    Await([&source, &error](ftl::Closure on_done) {
+      storage::SplitDataSource(
+          source.get(),
+          [&error, on_done](storage::IterationStatus status,
+                            storage::ObjectId /*object_id*/,
+                            std::unique_ptr<storage::DataSource::DataChunk>
+                            /*chunk*/) {
+            if (status == storage::IterationStatus::IN_PROGRESS) {
+              return;
+            }
+            error = status == storage::IterationStatus::ERROR;
+            on_done();
+          });
+    });
+    if (error) {
+      state->SkipWithError("SplitDataSource failed");
+      return;
+    }
+  }
+  state->SetBytesProcessed(state->iterations() * value.size());
+}
+
+// Returns the entries and children of a tree node of |entry_count| entries.
+void MakeNode(int64_t entry_count,
+              std::vector<storage::Entry>* entries,
+              std::vector<storage::ObjectId>* children) {
+  std::default_random_engine rng(0);
+  for (int64_t i = 0; i < entry_count; ++i) {
+    entries->push_back(MakeEntryChange(&rng, i).entry);
+  }
+  // Only some of the children of a node are usually present.
+  for (int64_t i = 0; i <= entry_count; ++i) {
+    children->push_back(
+        i % (entry_count / kChildCount + 1) == 0
+            ? storage::ComputeObjectId(storage::ObjectType::INDEX,
+                                       MakeValue(&rng, kValueSize))
+            : "");
+  }
+}
+
+void EncodeNode(MicrobenchmarkState* state) {
+  std::vector<storage::Entry> entries;
+  std::vector<storage::ObjectId> children;
+  MakeNode(state->arg(0), &entries, &children);
+  while (state->KeepRunning()) {
+    storage::btree::EncodeNode(1u, entries, children);
+  }
+  state->SetItemsProcessed(state->iterations() * entries.size());
+}
+
+void DecodeNode(MicrobenchmarkState* state) {
+  std::vector<storage::Entry> entries;
+  std::vector<storage::ObjectId> children;
+  MakeNode(state->arg(0), &entries, &children);
+  std::string data = storage::btree::EncodeNode(1u, entries, children);
+  while (state->KeepRunning()) {
+    uint8_t level;
+    std::vector<storage::Entry> res_entries;
+    std::vector<storage::ObjectId> res_children;
+    if (!storage::btree::DecodeNode(data, &level, &res_entries,
+                                    &res_children)) {
+      state->SkipWithError("DecodeNode failed");
+      return;
+    }
+  }
+  state->SetItemsProcessed(state->iterations() * entries.size());
+}
+
+void BTreeApplyChanges(MicrobenchmarkState* state) {
+  StorageFixture fixture;
+  std::default_random_engine rng(0);
+  storage::ObjectId root_id;
+  if (!fixture.Init() ||
+      fixture.BuildTree(&rng, state->arg(0), &root_id) !=
+          storage::Status::OK) {
+    state->SkipWithError("Unable to build the tree");
+    return;
+  }
+  while (state->KeepRunning()) {
+    // New values every time, so that the new nodes are not already stored.
+    state->PauseTiming();
+    std::vector<storage::EntryChange> changes =
+        MakeChanges(&rng, state->arg(0), state->arg(1));
+    state->ResumeTiming();
+    storage::ObjectId new_root_id;
+    if (fixture.ApplyChanges(root_id, changes, &new_root_id) !=
+        storage::Status::OK) {
+      state->SkipWithError("ApplyChanges failed");
+      return;
+    }
+  }
+  state->SetItemsProcessed(state->iterations() * state->arg(1));
+}
+
+void BTreeDiff(MicrobenchmarkState* state) {
+  StorageFixture fixture;
+  std::default_random_engine rng(0);
+  storage::ObjectId base_root_id;
+  storage::ObjectId other_root_id;
+  if (!fixture.Init() ||
+      fixture.BuildTree(&rng, state->arg(0), &base_root_id) !=
+          storage::Status::OK ||
+      fixture.ApplyChanges(base_root_id,
+                           MakeChanges(&rng, state->arg(0), state->arg(1)),
+                           &other_root_id) != storage::Status::OK) {
+    state->SkipWithError("Unable to build the trees");
+    return;
+  }
+  while (state->KeepRunning()) {
+    storage::Status status;
+    Await([&](ftl::Closure on_done) {
+      storage::btree::ForEachDiff(
+          fixture.coroutine_service(), fixture.page_storage(), base_root_id,
+          other_root_id, "", [](storage::EntryChange /*change*/) {
+            return true;
+          },
+          callback::Capture(on_done, &status));
+    });
+    if (status != storage::Status::OK) {
+      state->SkipWithError("ForEachDiff failed");
+      return;
+    }
+  }
+  state->SetItemsProcessed(state->iterations() * state->arg(1));
+}
+
+void BTreeIterate(MicrobenchmarkState* state) {
+  StorageFixture fixture;
+  std::default_random_engine rng(0);
+  storage::ObjectId root_id;
+  if (!fixture.Init() ||
+      fixture.BuildTree(&rng, state->arg(0), &root_id) !=
+          storage::Status::OK) {
+    state->SkipWithError("Unable to build the tree");
+    return;
+  }
+  while (state->KeepRunning()) {
+    storage::Status status = storage::Status::OK;
+    Await([&](ftl::Closure on_done) {
+      fixture.coroutine_service()->StartCoroutine(
+          [&](coroutine::CoroutineHandler* handler) {
+            SynchronousStorage storage(fixture.page_storage(),
+                                       storage::PageStorage::Location::LOCAL,
+                                       handler);
+            BTreeIterator iterator(&storage);
+            status = iterator.Init(root_id);
+            while (status == storage::Status::OK && !iterator.Finished()) {
+              status = iterator.Advance();
+            }
+            on_done();
+          });
+    });
+    if (status != storage::Status::OK) {
+      state->SkipWithError("BTreeIterator failed");
+      return;
+    }
+  }
+  state->SetItemsProcessed(state->iterations() * state->arg(0));
+}
+
+// Runs |state|'s iterations in a coroutine, calling |operation| with the
+// coroutine handler at each iteration.
+void RunInCoroutine(
+    MicrobenchmarkState* state,
+    coroutine::CoroutineService* coroutine_service,
+    const std::function<storage::Status(coroutine::CoroutineHandler*)>&
+        operation) {
+  Await([&](ftl::Closure on_done) {
+    coroutine_service->StartCoroutine(
+        [&](coroutine::CoroutineHandler* handler) {
+          while (state->KeepRunning()) {
+            if (operation(handler) != storage::Status::OK) {
+              state->SkipWithError("PageDb operation failed");
+              break;
+            }
+          }
+          on_done();
+        });
+  });
+}
+
+void PageDbWriteObject(MicrobenchmarkState* state) {
+  StorageFixture fixture;
+  storage::PageDbImpl page_db(fixture.coroutine_service(),
+                              fixture.page_storage(), fixture.path() + "/db");
+  if (page_db.Init() != storage::Status::OK) {
+    state->SkipWithError("Unable to initialize the database");
+    return;
+  }
+  std::default_random_engine rng(0);
+  std::string value = MakeValue(&rng, state->arg(0));
+  storage::ObjectId object_id =
+      storage::ComputeObjectId(storage::ObjectType::VALUE, value);
+  RunInCoroutine(state, fixture.coroutine_service(),
+                 [&](coroutine::CoroutineHandler* handler) {
+                   return page_db.WriteObject(
+                       handler, object_id,
+                       storage::DataSource::DataChunk::Create(value),
+                       storage::PageDbObjectStatus::TRANSIENT);
+                 });
+  state->SetBytesProcessed(state->iterations() * value.size());
+}
+
+void PageDbReadObject(MicrobenchmarkState* state) {
+  StorageFixture fixture;
+  storage::PageDbImpl page_db(fixture.coroutine_service(),
+                              fixture.page_storage(), fixture.path() + "/db");
+  if (page_db.Init() != storage::Status::OK) {
+    state->SkipWithError("Unable to initialize the database");
+    return;
+  }
+  std::default_random_engine rng(0);
+  std::string value = MakeValue(&rng, state->arg(0));
+  storage::ObjectId object_id =
+      storage::ComputeObjectId(storage::ObjectType::VALUE, value);
+  storage::Status status;
+  Await([&](ftl::Closure on_done) {
+    fixture.coroutine_service()->StartCoroutine(
+        [&](coroutine::CoroutineHandler* handler) {
+          status = page_db.WriteObject(
+              handler, object_id, storage::DataSource::DataChunk::Create(value),
+              storage::PageDbObjectStatus::TRANSIENT);
+          on_done();
+        });
+  });
+  if (status != storage::Status::OK) {
+    state->SkipWithError("Unable to write the object");
+    return;
+  }
+  while (state->KeepRunning()) {
+    std::unique_ptr<const storage::Object> object;
+    if (page_db.ReadObject(object_id, &object) != storage::Status::OK) {
+      state->SkipWithError("ReadObject failed");
+      return;
+    }
+  }
+  state->SetBytesProcessed(state->iterations() * value.size());
+}
+
+void PageStorageAddObject(MicrobenchmarkState* state) {
+  StorageFixture fixture;
+  if (!fixture.Init()) {
+    state->SkipWithError("Unable to initialize the storage");
+    return;
+  }
+  std::default_random_engine rng(0);
+  std::string value = MakeValue(&rng, state->arg(0));
+  while (state->KeepRunning()) {
+    state->PauseTiming();
+    std::unique_ptr<storage::DataSource> source =
+        storage::DataSource::Create(value);
+    state->ResumeTiming();
+    storage::Status status;
+    storage::ObjectId object_id;
+    Await([&](ftl::Closure on_done) {
+      fixture.page_storage()->AddObjectFromLocal(
+          std::move(source), callback::Capture(on_done, &status, &object_id));
+    });
+    if (status != storage::Status::OK) {
+      state->SkipWithError("AddObjectFromLocal failed");
+      return;
+    }
+  }
+  state->SetBytesProcessed(state->iterations() * value.size());
+}
+
+}  // namespace
+}  // namespace benchmark
+}  // namespace test
+
+int main(int argc, const char** argv) {
+  using test::benchmark::MicrobenchmarkRange;
+
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+  mtl::MessageLoop loop;
+
+  std::vector<int64_t> value_sizes = MicrobenchmarkRange(16, 1 << 20, 16);
+  std::vector<int64_t> tree_sizes = {100, 1000, 10000};
+  std::vector<int64_t> change_sizes = {1, 10, 100};
+
+  test::benchmark::MicrobenchmarkRunner runner;
+  runner.Add("compute_object_id", test::benchmark::ComputeObjectId)
+      ->ArgNames({"value_size"})
+      ->ArgsProduct({value_sizes});
+  runner.Add("split", test::benchmark::Split)
+      ->ArgNames({"value_size"})
+      ->ArgsProduct({value_sizes});
+  runner.Add("encode_node", test::benchmark::EncodeNode)
+      ->ArgNames({"entry_count"})
+      ->ArgsProduct({MicrobenchmarkRange(1, 1024, 4)});
+  runner.Add("decode_node", test::benchmark::DecodeNode)
+      ->ArgNames({"entry_count"})
+      ->ArgsProduct({MicrobenchmarkRange(1, 1024, 4)});
+  runner.Add("btree_apply_changes", test::benchmark::BTreeApplyChanges)
+      ->ArgNames({"tree_size", "change_size"})
+      ->ArgsProduct({tree_sizes, change_sizes});
+  runner.Add("btree_diff", test::benchmark::BTreeDiff)
+      ->ArgNames({"tree_size", "change_size"})
+      ->ArgsProduct({tree_sizes, change_sizes});
+  runner.Add("btree_iterate", test::benchmark::BTreeIterate)
+      ->ArgNames({"tree_size"})
+      ->ArgsProduct({tree_sizes});
+  runner.Add("page_db_write_object", test::benchmark::PageDbWriteObject)
+      ->ArgNames({"value_size"})
+      ->ArgsProduct({value_sizes});
+  runner.Add("page_db_read_object", test::benchmark::PageDbReadObject)
+      ->ArgNames({"value_size"})
+      ->ArgsProduct({value_sizes});
+  runner.Add("page_storage_add_object", test::benchmark::PageStorageAddObject)
+      ->ArgNames({"value_size"})
+      ->ArgsProduct({value_sizes});
+  return runner.Run(command_line);
+}
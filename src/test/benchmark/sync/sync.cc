@@ -25,6 +25,7 @@ constexpr ftl::StringView kEntryCountFlag = "entry-count";
 constexpr ftl::StringView kValueSizeFlag = "value-size";
 constexpr ftl::StringView kRefsFlag = "refs";
 constexpr ftl::StringView kServerIdFlag = "server-id";
+constexpr ftl::StringView kCompressibleFlag = "compressible";
 
 constexpr ftl::StringView kRefsOnFlag = "on";
 constexpr ftl::StringView kRefsOffFlag = "off";
@@ -37,7 +38,8 @@ void PrintUsage(const char* executable_name) {
   std::cout << "Usage: " << executable_name << " --" << kEntryCountFlag
             << "=<int> --" << kValueSizeFlag << "=<int> --" << kRefsFlag << "=("
             << kRefsOnFlag << "|" << kRefsOffFlag << "|" << kRefsAutoFlag
-            << ") --" << kServerIdFlag << "=<string>" << std::endl;
+            << ") --" << kServerIdFlag << "=<string> [--" << kCompressibleFlag
+            << "]" << std::endl;
 }
 
 }  // namespace
@@ -48,12 +50,14 @@ namespace benchmark {
 SyncBenchmark::SyncBenchmark(size_t entry_count,
                              size_t value_size,
                              ReferenceStrategy reference_strategy,
-                             std::string server_id)
+                             std::string server_id,
+                             bool compressible_values)
     : application_context_(app::ApplicationContext::CreateFromStartupInfo()),
       entry_count_(entry_count),
       value_size_(value_size),
       reference_strategy_(reference_strategy),
       server_id_(std::move(server_id)),
+      compressible_values_(compressible_values),
       page_watcher_binding_(this),
       alpha_tmp_dir_(kStoragePath),
       beta_tmp_dir_(kStoragePath),
@@ -67,6 +71,13 @@ SyncBenchmark::SyncBenchmark(size_t entry_count,
                             {"benchmark_ledger_sync"});
 }
 
+std::vector<std::string> SyncBenchmark::GetLedgerArguments() {
+  if (!compressible_values_) {
+    return {};
+  }
+  return {"--enable_sync_compression"};
+}
+
 void SyncBenchmark::Run() {
   // Name of the storage directory currently identifies the user. Ensure the
   // most nested directory has the same name to make the ledgers sync.
@@ -82,14 +93,16 @@ void SyncBenchmark::Run() {
   ledger::Status status = test::GetLedger(
       mtl::MessageLoop::GetCurrent(), application_context_.get(),
       &alpha_controller_, &token_provider_impl_, "sync", alpha_path,
-      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &alpha);
+      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &alpha,
+      test::Erase::KEEP_DATA, GetLedgerArguments());
   QuitOnError(status, "alpha ledger");
 
   ledger::LedgerPtr beta;
   status = test::GetLedger(
       mtl::MessageLoop::GetCurrent(), application_context_.get(),
       &beta_controller_, &token_provider_impl_, "sync", beta_path,
-      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &beta);
+      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &beta,
+      test::Erase::KEEP_DATA, GetLedgerArguments());
   QuitOnError(status, "beta ledger");
 
   fidl::Array<uint8_t> id;
@@ -129,7 +142,9 @@ void SyncBenchmark::RunSingle(size_t i) {
   }
 
   fidl::Array<uint8_t> key = generator_.MakeKey(i, kKeySize);
-  fidl::Array<uint8_t> value = generator_.MakeValue(value_size_);
+  fidl::Array<uint8_t> value =
+      compressible_values_ ? generator_.MakeCompressibleValue(value_size_)
+                           : generator_.MakeValue(value_size_);
   TRACE_ASYNC_BEGIN("benchmark", "sync latency", i);
   if (reference_strategy_ != ReferenceStrategy::OFF &&
       (reference_strategy_ == ReferenceStrategy::ON ||
@@ -164,7 +179,8 @@ void SyncBenchmark::Backlog() {
   ledger::Status status = test::GetLedger(
       mtl::MessageLoop::GetCurrent(), application_context_.get(),
       &gamma_controller_, &token_provider_impl_, "sync", gamma_path,
-      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &gamma_);
+      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &gamma_,
+      test::Erase::KEEP_DATA, GetLedgerArguments());
   QuitOnError(status, "backlog");
   TRACE_ASYNC_BEGIN("benchmark", "get and verify backlog", 0);
   gamma_->GetPage(page_id_.Clone(), gamma_page_.NewRequest(),
@@ -252,9 +268,13 @@ int main(int argc, const char** argv) {
     return -1;
   }
 
+  bool compressible_values =
+      command_line.HasOption(kCompressibleFlag.ToString());
+
   mtl::MessageLoop loop;
   test::benchmark::SyncBenchmark app(entry_count, value_size,
-                                     reference_strategy, server_id);
+                                     reference_strategy, server_id,
+                                     compressible_values);
   loop.task_runner()->PostTask([&app] { app.Run(); });
   loop.Run();
   return 0;
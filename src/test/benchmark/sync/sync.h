@@ -6,6 +6,8 @@
 #define APPS_LEDGER_SRC_TEST_BENCHMARK_SYNC_SYNC_H_
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "application/lib/app/application_context.h"
 #include "apps/ledger/services/public/ledger.fidl.h"
@@ -28,6 +30,8 @@ namespace benchmark {
 //   --entry-count=<int> the number of entries to be put
 //   --value-size=<int> the size of a single value in bytes
 //   --server-id=<string> the ID of the Firebase instance ot use for syncing
+//   --compressible (optional) use compressible values instead of random bytes,
+//     and enable the compression of the synced data
 class SyncBenchmark : public ledger::PageWatcher {
  public:
   enum class ReferenceStrategy {
@@ -39,7 +43,8 @@ class SyncBenchmark : public ledger::PageWatcher {
   SyncBenchmark(size_t entry_count,
                 size_t value_size,
                 ReferenceStrategy reference_strategy,
-                std::string server_id);
+                std::string server_id,
+                bool compressible_values);
 
   void Run();
 
@@ -49,6 +54,9 @@ class SyncBenchmark : public ledger::PageWatcher {
                 const OnChangeCallback& callback) override;
 
  private:
+  // Returns the arguments of the Ledger instances synced by the benchmark.
+  std::vector<std::string> GetLedgerArguments();
+
   void RunSingle(size_t i);
 
   void Backlog();
@@ -63,6 +71,7 @@ class SyncBenchmark : public ledger::PageWatcher {
   const size_t value_size_;
   ReferenceStrategy reference_strategy_;
   std::string server_id_;
+  const bool compressible_values_;
   fidl::Binding<ledger::PageWatcher> page_watcher_binding_;
   files::ScopedTempDir alpha_tmp_dir_;
   files::ScopedTempDir beta_tmp_dir_;
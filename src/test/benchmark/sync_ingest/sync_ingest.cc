@@ -0,0 +1,217 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/sync_ingest/sync_ingest.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/test/benchmark/lib/logging.h"
+#include "apps/ledger/src/test/get_ledger.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/files/directory.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace {
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/sync_ingest";
+constexpr ftl::StringView kPageSizeFlag = "page-size";
+constexpr ftl::StringView kCommitCountFlag = "commit-count";
+constexpr ftl::StringView kValueSizeFlag = "value-size";
+constexpr ftl::StringView kServerIdFlag = "server-id";
+
+constexpr size_t kKeySize = 100;
+// Number of entries put in each transaction when filling the page.
+constexpr size_t kPopulateTransactionSize = 100;
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kPageSizeFlag
+            << "=<int> --" << kCommitCountFlag << "=<int> --" << kValueSizeFlag
+            << "=<int> --" << kServerIdFlag << "=<string>" << std::endl;
+}
+
+}  // namespace
+
+namespace test {
+namespace benchmark {
+
+SyncIngestBenchmark::SyncIngestBenchmark(size_t page_size,
+                                         size_t commit_count,
+                                         size_t value_size,
+                                         std::string server_id)
+    : application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      page_size_(page_size),
+      commit_count_(commit_count),
+      value_size_(value_size),
+      server_id_(std::move(server_id)),
+      page_watcher_binding_(this),
+      alpha_tmp_dir_(kStoragePath),
+      beta_tmp_dir_(kStoragePath),
+      token_provider_impl_("",
+                           "sync_user",
+                           "sync_user@google.com",
+                           "client_id") {
+  FTL_DCHECK(page_size > 0);
+  FTL_DCHECK(commit_count > 0);
+  FTL_DCHECK(value_size > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_sync_ingest"});
+}
+
+void SyncIngestBenchmark::Run() {
+  // Name of the storage directory currently identifies the user. Ensure the
+  // most nested directory has the same name to make the ledgers sync.
+  std::string alpha_path = alpha_tmp_dir_.path() + "/sync_user";
+  bool ret = files::CreateDirectory(alpha_path);
+  FTL_DCHECK(ret);
+
+  std::string beta_path = beta_tmp_dir_.path() + "/sync_user";
+  ret = files::CreateDirectory(beta_path);
+  FTL_DCHECK(ret);
+
+  ledger::LedgerPtr alpha;
+  ledger::Status status = test::GetLedger(
+      mtl::MessageLoop::GetCurrent(), application_context_.get(),
+      &alpha_controller_, &token_provider_impl_, "sync_ingest", alpha_path,
+      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &alpha);
+  QuitOnError(status, "alpha ledger");
+
+  ledger::LedgerPtr beta;
+  status = test::GetLedger(
+      mtl::MessageLoop::GetCurrent(), application_context_.get(),
+      &beta_controller_, &token_provider_impl_, "sync_ingest", beta_path,
+      test::SyncState::CLOUD_SYNC_ENABLED, server_id_, &beta);
+  QuitOnError(status, "beta ledger");
+
+  fidl::Array<uint8_t> id;
+  status = test::GetPageEnsureInitialized(mtl::MessageLoop::GetCurrent(),
+                                          &alpha, nullptr, &alpha_page_, &id);
+  QuitOnError(status, "alpha page initialization");
+  beta->GetPage(std::move(id), beta_page_.NewRequest(),
+                benchmark::QuitOnErrorCallback("GetPage"));
+
+  ledger::PageSnapshotPtr snapshot;
+  beta_page_->GetSnapshot(snapshot.NewRequest(), nullptr,
+                          page_watcher_binding_.NewBinding(),
+                          [this](ledger::Status status) {
+                            if (benchmark::QuitOnError(status, "GetSnapshot")) {
+                              return;
+                            }
+                            TRACE_ASYNC_BEGIN("benchmark", "populate page", 0);
+                            Populate(0);
+                          });
+}
+
+void SyncIngestBenchmark::OnChange(ledger::PageChangePtr page_change,
+                                   ledger::ResultState result_state,
+                                   const OnChangeCallback& callback) {
+  if (!populated_) {
+    // The initial content of the page may be received in any number of
+    // changes.
+    populated_entries_ += page_change->changes.size();
+    if (populated_entries_ >= page_size_ &&
+        (result_state == ledger::ResultState::COMPLETED ||
+         result_state == ledger::ResultState::PARTIAL_COMPLETED)) {
+      populated_ = true;
+      TRACE_ASYNC_END("benchmark", "populate page", 0);
+      RunSingle(0);
+    }
+    callback(nullptr);
+    return;
+  }
+
+  FTL_DCHECK(page_change->changes.size() == 1);
+  FTL_DCHECK(result_state == ledger::ResultState::COMPLETED);
+  size_t i =
+      std::stoul(convert::ToString(page_change->changes[0]->key)) - page_size_;
+  TRACE_ASYNC_END("benchmark", "sync ingest", i);
+  RunSingle(i + 1);
+  callback(nullptr);
+}
+
+void SyncIngestBenchmark::Populate(size_t i) {
+  if (i == page_size_) {
+    // The updates start once beta received the whole page.
+    return;
+  }
+
+  size_t end = std::min(i + kPopulateTransactionSize, page_size_);
+  alpha_page_->StartTransaction(
+      benchmark::QuitOnErrorCallback("StartTransaction"));
+  for (size_t j = i; j < end; ++j) {
+    alpha_page_->Put(generator_.MakeKey(j, kKeySize),
+                     generator_.MakeValue(value_size_),
+                     benchmark::QuitOnErrorCallback("Put"));
+  }
+  alpha_page_->Commit([this, end](ledger::Status status) {
+    if (benchmark::QuitOnError(status, "Commit")) {
+      return;
+    }
+    Populate(end);
+  });
+}
+
+void SyncIngestBenchmark::RunSingle(size_t i) {
+  if (i == commit_count_) {
+    ShutDown();
+    return;
+  }
+
+  // Each commit adds a single new entry to the page.
+  TRACE_ASYNC_BEGIN("benchmark", "sync ingest", i);
+  alpha_page_->Put(generator_.MakeKey(page_size_ + i, kKeySize),
+                   generator_.MakeValue(value_size_),
+                   benchmark::QuitOnErrorCallback("Put"));
+}
+
+void SyncIngestBenchmark::ShutDown() {
+  alpha_controller_->Kill();
+  alpha_controller_.WaitForIncomingResponseWithTimeout(
+      ftl::TimeDelta::FromSeconds(5));
+  beta_controller_->Kill();
+  beta_controller_.WaitForIncomingResponseWithTimeout(
+      ftl::TimeDelta::FromSeconds(5));
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+}  // namespace test
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  std::string page_size_str;
+  size_t page_size;
+  std::string commit_count_str;
+  size_t commit_count;
+  std::string value_size_str;
+  size_t value_size;
+  std::string server_id;
+  if (!command_line.GetOptionValue(kPageSizeFlag.ToString(), &page_size_str) ||
+      !ftl::StringToNumberWithError(page_size_str, &page_size) ||
+      page_size <= 0 ||
+      !command_line.GetOptionValue(kCommitCountFlag.ToString(),
+                                   &commit_count_str) ||
+      !ftl::StringToNumberWithError(commit_count_str, &commit_count) ||
+      commit_count <= 0 ||
+      !command_line.GetOptionValue(kValueSizeFlag.ToString(),
+                                   &value_size_str) ||
+      !ftl::StringToNumberWithError(value_size_str, &value_size) ||
+      value_size <= 0 ||
+      !command_line.GetOptionValue(kServerIdFlag.ToString(), &server_id)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  test::benchmark::SyncIngestBenchmark app(page_size, commit_count, value_size,
+                                           server_id);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
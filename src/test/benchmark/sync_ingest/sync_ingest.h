@@ -0,0 +1,82 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_SYNC_INGEST_SYNC_INGEST_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_SYNC_INGEST_SYNC_INGEST_H_
+
+#include <memory>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/fidl_helpers/bound_interface_set.h"
+#include "apps/ledger/src/test/data_generator.h"
+#include "apps/ledger/src/test/fake_token_provider.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace test {
+namespace benchmark {
+
+// Benchmark that measures the time needed for a Ledger instance to receive
+// single-key commits from the cloud, depending on the size of the page they
+// modify. A first Ledger instance fills a page with |page-size| entries, and
+// once a second instance received them all, the first one updates
+// |commit-count| entries, one per commit. The time between each update and its
+// reception by the second instance is measured.
+//
+// Cloud sync needs to be configured on the device in order for the benchmark to
+// run.
+//
+// Parameters:
+//   --page-size=<int> the number of entries in the page before updates start
+//   --commit-count=<int> the number of single-key commits to be measured
+//   --value-size=<int> the size of a single value in bytes
+//   --server-id=<string> the ID of the Firebase instance ot use for syncing
+class SyncIngestBenchmark : public ledger::PageWatcher {
+ public:
+  SyncIngestBenchmark(size_t page_size,
+                      size_t commit_count,
+                      size_t value_size,
+                      std::string server_id);
+
+  void Run();
+
+  // ledger::PageWatcher:
+  void OnChange(ledger::PageChangePtr page_change,
+                ledger::ResultState result_state,
+                const OnChangeCallback& callback) override;
+
+ private:
+  void Populate(size_t i);
+
+  void RunSingle(size_t i);
+
+  void ShutDown();
+
+  test::DataGenerator generator_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const size_t page_size_;
+  const size_t commit_count_;
+  const size_t value_size_;
+  std::string server_id_;
+  fidl::Binding<ledger::PageWatcher> page_watcher_binding_;
+  files::ScopedTempDir alpha_tmp_dir_;
+  files::ScopedTempDir beta_tmp_dir_;
+  app::ApplicationControllerPtr alpha_controller_;
+  app::ApplicationControllerPtr beta_controller_;
+  ledger::fidl_helpers::BoundInterfaceSet<modular::auth::TokenProvider,
+                                          test::FakeTokenProvider>
+      token_provider_impl_;
+  ledger::PagePtr alpha_page_;
+  ledger::PagePtr beta_page_;
+  // Number of entries of the initial page content received by beta.
+  size_t populated_entries_ = 0;
+  bool populated_ = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SyncIngestBenchmark);
+};
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_SYNC_INGEST_SYNC_INGEST_H_
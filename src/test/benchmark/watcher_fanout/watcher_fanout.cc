@@ -0,0 +1,165 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/test/benchmark/watcher_fanout/watcher_fanout.h"
+
+#include <iostream>
+
+#include "apps/ledger/src/test/benchmark/lib/logging.h"
+#include "apps/ledger/src/test/get_ledger.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace {
+constexpr ftl::StringView kStoragePath =
+    "/data/benchmark/ledger/watcher_fanout";
+constexpr ftl::StringView kWatcherCountFlag = "watcher-count";
+constexpr ftl::StringView kEntryCountFlag = "entry-count";
+constexpr ftl::StringView kValueSizeFlag = "value-size";
+
+constexpr size_t kKeySize = 100;
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kWatcherCountFlag
+            << "=<int> --" << kEntryCountFlag << "=<int> --" << kValueSizeFlag
+            << "=<int>" << std::endl;
+}
+
+bool GetPositiveIntValue(const ftl::CommandLine& command_line,
+                         ftl::StringView flag,
+                         int* value) {
+  std::string value_str;
+  int found_value;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str) ||
+      !ftl::StringToNumberWithError(value_str, &found_value) ||
+      found_value <= 0) {
+    return false;
+  }
+  *value = found_value;
+  return true;
+}
+
+}  // namespace
+
+namespace test {
+namespace benchmark {
+
+WatcherFanoutBenchmark::WatcherFanoutBenchmark(int watcher_count,
+                                               int entry_count,
+                                               int value_size)
+    : tmp_dir_(kStoragePath),
+      application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      token_provider_impl_("",
+                           "sync_user",
+                           "sync_user@google.com",
+                           "client_id"),
+      watcher_count_(watcher_count),
+      entry_count_(entry_count),
+      value_size_(value_size) {
+  FTL_DCHECK(watcher_count > 0);
+  FTL_DCHECK(entry_count > 0);
+  FTL_DCHECK(value_size > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_watcher_fanout"});
+}
+
+void WatcherFanoutBenchmark::Run() {
+  FTL_LOG(INFO) << "--watcher-count=" << watcher_count_
+                << " --entry-count=" << entry_count_
+                << " --value-size=" << value_size_;
+  ledger::Status status = test::GetLedger(
+      mtl::MessageLoop::GetCurrent(), application_context_.get(),
+      &application_controller_, &token_provider_impl_, "watcher_fanout",
+      tmp_dir_.path(), test::SyncState::DISABLED, "", &ledger_);
+  QuitOnError(status, "GetLedger");
+
+  fidl::Array<uint8_t> id;
+  status = test::GetPageEnsureInitialized(mtl::MessageLoop::GetCurrent(),
+                                          &ledger_, nullptr, &page_, &id);
+  QuitOnError(status, "GetPageEnsureInitialized");
+
+  RegisterWatchers(watcher_count_);
+}
+
+void WatcherFanoutBenchmark::RegisterWatchers(int remaining_watchers) {
+  if (remaining_watchers == 0) {
+    RunSingle(0);
+    return;
+  }
+  // We don't actually need the snapshots.
+  ledger::PageSnapshotPtr snapshot;
+  ledger::PageWatcherPtr watcher;
+  watcher_bindings_.AddBinding(this, watcher.NewRequest());
+  page_->GetSnapshot(snapshot.NewRequest(), nullptr, std::move(watcher),
+                     [this, remaining_watchers](ledger::Status status) {
+                       if (benchmark::QuitOnError(status, "GetSnapshot")) {
+                         return;
+                       }
+                       RegisterWatchers(remaining_watchers - 1);
+                     });
+}
+
+void WatcherFanoutBenchmark::RunSingle(int step) {
+  if (step == entry_count_) {
+    ShutDown();
+    return;
+  }
+
+  fidl::Array<uint8_t> key = generator_.MakeKey(step, kKeySize);
+  fidl::Array<uint8_t> value = generator_.MakeValue(value_size_);
+  current_step_ = step;
+  pending_notifications_ = watcher_count_;
+  TRACE_ASYNC_BEGIN("benchmark", "watcher_fanout", step);
+  page_->Put(std::move(key), std::move(value),
+             benchmark::QuitOnErrorCallback("Put"));
+}
+
+void WatcherFanoutBenchmark::OnChange(ledger::PageChangePtr page_change,
+                                      ledger::ResultState result_state,
+                                      const OnChangeCallback& callback) {
+  FTL_DCHECK(result_state == ledger::ResultState::COMPLETED);
+  callback(nullptr);
+  FTL_DCHECK(pending_notifications_ > 0);
+  if (--pending_notifications_ > 0) {
+    return;
+  }
+  TRACE_ASYNC_END("benchmark", "watcher_fanout", current_step_);
+  RunSingle(current_step_ + 1);
+}
+
+void WatcherFanoutBenchmark::ShutDown() {
+  // Shut down the Ledger process first as it relies on |tmp_dir_| storage.
+  application_controller_->Kill();
+  application_controller_.WaitForIncomingResponseWithTimeout(
+      ftl::TimeDelta::FromSeconds(5));
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+}  // namespace test
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  int watcher_count;
+  int entry_count;
+  int value_size;
+  if (!GetPositiveIntValue(command_line, kWatcherCountFlag, &watcher_count) ||
+      !GetPositiveIntValue(command_line, kEntryCountFlag, &entry_count) ||
+      !GetPositiveIntValue(command_line, kValueSizeFlag, &value_size)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  test::benchmark::WatcherFanoutBenchmark app(watcher_count, entry_count,
+                                              value_size);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
@@ -0,0 +1,71 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_BENCHMARK_WATCHER_FANOUT_WATCHER_FANOUT_H_
+#define APPS_LEDGER_SRC_TEST_BENCHMARK_WATCHER_FANOUT_WATCHER_FANOUT_H_
+
+#include <memory>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/fidl_helpers/bound_interface_set.h"
+#include "apps/ledger/src/test/data_generator.h"
+#include "apps/ledger/src/test/fake_token_provider.h"
+#include "lib/fidl/cpp/bindings/binding_set.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace test {
+namespace benchmark {
+
+// Benchmark that measures the time it takes to notify many watchers of the
+// same page of a change.
+//
+// In this scenario, |watcher-count| watchers are registered on the page. At
+// each step, a single entry is put in the page, and we measure the time until
+// all watchers received the change.
+//
+// Parameters:
+//   --watcher-count=<int> the number of watchers registered on the page
+//   --entry-count=<int> the number of entries to be put
+//   --value-size=<int> the size of a single value in bytes
+class WatcherFanoutBenchmark : public ledger::PageWatcher {
+ public:
+  WatcherFanoutBenchmark(int watcher_count, int entry_count, int value_size);
+
+  void Run();
+
+  // ledger::PageWatcher:
+  void OnChange(ledger::PageChangePtr page_change,
+                ledger::ResultState result_state,
+                const OnChangeCallback& callback) override;
+
+ private:
+  void RegisterWatchers(int remaining_watchers);
+  void RunSingle(int step);
+
+  void ShutDown();
+
+  test::DataGenerator generator_;
+  files::ScopedTempDir tmp_dir_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  ledger::fidl_helpers::BoundInterfaceSet<modular::auth::TokenProvider,
+                                          test::FakeTokenProvider>
+      token_provider_impl_;
+  const int watcher_count_;
+  const int entry_count_;
+  const int value_size_;
+  fidl::BindingSet<ledger::PageWatcher> watcher_bindings_;
+  app::ApplicationControllerPtr application_controller_;
+  ledger::LedgerPtr ledger_;
+  ledger::PagePtr page_;
+  int current_step_ = -1;
+  int pending_notifications_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(WatcherFanoutBenchmark);
+};
+
+}  // namespace benchmark
+}  // namespace test
+
+#endif  // APPS_LEDGER_SRC_TEST_BENCHMARK_WATCHER_FANOUT_WATCHER_FANOUT_H_
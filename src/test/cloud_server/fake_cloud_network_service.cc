@@ -8,7 +8,9 @@
 
 namespace ledger {
 
-FakeCloudNetworkService::FakeCloudNetworkService() {}
+FakeCloudNetworkService::FakeCloudNetworkService(
+    NetworkConditions conditions)
+    : url_loader_(conditions) {}
 
 FakeCloudNetworkService::~FakeCloudNetworkService() {}
 
@@ -6,6 +6,7 @@
 #define APPS_LEDGER_SRC_TEST_CLOUD_SERVER_FAKE_CLOUD_NETWORK_SERVICE_H_
 
 #include "apps/ledger/src/test/cloud_server/fake_cloud_url_loader.h"
+#include "apps/ledger/src/test/cloud_server/network_conditions.h"
 #include "apps/netstack/services/net_address.fidl.h"
 #include "apps/network/services/network_service.fidl.h"
 #include "lib/fidl/cpp/bindings/binding_set.h"
@@ -14,10 +15,10 @@
 namespace ledger {
 
 // Implementation of network::NetworkService that simulates Firebase and GCS
-// servers.
+// servers, behind a simulated network with the given |conditions|.
 class FakeCloudNetworkService : public network::NetworkService {
  public:
-  FakeCloudNetworkService();
+  explicit FakeCloudNetworkService(NetworkConditions conditions = {});
   ~FakeCloudNetworkService() override;
 
   // network::NetworkService
@@ -4,7 +4,13 @@
 
 #include "apps/ledger/src/test/cloud_server/fake_cloud_url_loader.h"
 
+#include <algorithm>
+
+#include "apps/tracing/lib/trace/event.h"
+#include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/strings/string_number_conversions.h"
 #include "lib/ftl/strings/string_view.h"
+#include "lib/mtl/tasks/message_loop.h"
 #include "lib/url/gurl.h"
 
 namespace ledger {
@@ -13,6 +19,8 @@ namespace {
 constexpr ftl::StringView kFirebaseHosts = ".firebaseio.com";
 constexpr ftl::StringView kGcsPrefix =
     "https://firebasestorage.googleapis.com/v0/b/";
+// net::ERR_CONNECTION_CLOSED
+constexpr int32_t kConnectionClosedErrorCode = -100;
 
 bool StringStartsWith(ftl::StringView str, ftl::StringView value) {
   if (str.size() < value.size()) {
@@ -27,14 +35,96 @@ bool StringEndsWith(ftl::StringView str, ftl::StringView value) {
   }
   return str.substr(str.size() - value.size()) == value;
 }
+
+bool IsStreamRequest(const network::URLRequest& request) {
+  for (const auto& header : request.headers) {
+    if (header->name == "Accept" && header->value == "text/event-stream") {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t GetRequestSize(const network::URLRequest& request) {
+  uint64_t size = 0u;
+  if (request.body && request.body->is_buffer()) {
+    request.body->get_buffer().get_size(&size);
+  }
+  return size;
+}
+
+uint64_t GetResponseSize(const network::URLResponse& response) {
+  uint64_t size = 0u;
+  for (const auto& header : response.headers) {
+    if (header->name == "content-length") {
+      ftl::StringToNumberWithError(header->value.get(), &size);
+    }
+  }
+  return size;
+}
 }  // namespace
 
-FakeCloudURLLoader::FakeCloudURLLoader() {}
+FakeCloudURLLoader::FakeCloudURLLoader(NetworkConditions conditions)
+    : conditions_(conditions), rng_(conditions.seed), weak_factory_(this) {
+  FTL_DCHECK(conditions_.loss_rate >= 0.0 && conditions_.loss_rate <= 1.0);
+}
 
 FakeCloudURLLoader::~FakeCloudURLLoader() {}
 
 void FakeCloudURLLoader::Start(network::URLRequestPtr request,
                                const StartCallback& callback) {
+  if (conditions_.IsPerfect()) {
+    Serve(std::move(request), callback);
+    return;
+  }
+
+  ++request_count_;
+  ftl::RefPtr<ftl::TaskRunner> task_runner =
+      mtl::MessageLoop::GetCurrent()->task_runner();
+  bool is_stream = IsStreamRequest(*request);
+  std::bernoulli_distribution loss(conditions_.loss_rate);
+  if (!is_stream && loss(rng_)) {
+    ++lost_request_count_;
+    ReportMetrics();
+    network::URLResponsePtr response = network::URLResponse::New();
+    response->url = request->url;
+    response->error = network::NetworkError::New();
+    response->error->code = kConnectionClosedErrorCode;
+    response->error->description = "Simulated connection loss.";
+    task_runner->PostDelayedTask(
+        ftl::MakeCopyable([ callback, response = std::move(response) ]()
+                              mutable { callback(std::move(response)); }),
+        conditions_.latency);
+    return;
+  }
+
+  uint64_t request_size = GetRequestSize(*request);
+  uploaded_bytes_ += request_size;
+  ReportMetrics();
+  task_runner->PostDelayedTask(
+      ftl::MakeCopyable([
+        weak_this = weak_factory_.GetWeakPtr(), request = std::move(request),
+        callback, is_stream
+      ]() mutable {
+        if (weak_this) {
+          weak_this->ServeDelayed(std::move(request), callback, is_stream);
+        }
+      }),
+      Transfer(request_size, &upload_free_time_));
+}
+
+void FakeCloudURLLoader::FollowRedirect(
+    const FollowRedirectCallback& /*callback*/) {
+  FTL_NOTIMPLEMENTED();
+}
+
+void FakeCloudURLLoader::QueryStatus(const QueryStatusCallback& /*callback*/) {
+  FTL_NOTIMPLEMENTED();
+}
+
+void FakeCloudURLLoader::Serve(
+    network::URLRequestPtr request,
+    std::function<void(network::URLResponsePtr)> callback) {
   url::GURL url(request->url);
   FTL_DCHECK(url.is_valid());
 
@@ -58,13 +148,44 @@ void FakeCloudURLLoader::Start(network::URLRequestPtr request,
   FTL_NOTREACHED() << "Unknown URL: " << url.spec();
 }
 
-void FakeCloudURLLoader::FollowRedirect(
-    const FollowRedirectCallback& /*callback*/) {
-  FTL_NOTIMPLEMENTED();
+void FakeCloudURLLoader::ServeDelayed(
+    network::URLRequestPtr request,
+    std::function<void(network::URLResponsePtr)> callback,
+    bool is_stream) {
+  Serve(std::move(request), [this, callback,
+                             is_stream](network::URLResponsePtr response) {
+    // Streaming responses stay open for the lifetime of the request, so only
+    // their headers are delayed.
+    uint64_t response_size = is_stream ? 0u : GetResponseSize(*response);
+    downloaded_bytes_ += response_size;
+    ReportMetrics();
+    mtl::MessageLoop::GetCurrent()->task_runner()->PostDelayedTask(
+        ftl::MakeCopyable([ callback, response = std::move(response) ]()
+                              mutable { callback(std::move(response)); }),
+        Transfer(response_size, &download_free_time_));
+  });
 }
 
-void FakeCloudURLLoader::QueryStatus(const QueryStatusCallback& /*callback*/) {
-  FTL_NOTIMPLEMENTED();
+ftl::TimeDelta FakeCloudURLLoader::Transfer(uint64_t size,
+                                            ftl::TimePoint* link_free_time) {
+  ftl::TimePoint now = ftl::TimePoint::Now();
+  ftl::TimeDelta transfer_time;
+  if (conditions_.bandwidth > 0u) {
+    transfer_time = ftl::TimeDelta::FromMicroseconds(
+        size * 1000000u / conditions_.bandwidth);
+  }
+  // The transfer starts once the previous ones are done, after the latency.
+  ftl::TimePoint end =
+      std::max(now + conditions_.latency, *link_free_time) + transfer_time;
+  *link_free_time = end;
+  return end - now;
+}
+
+void FakeCloudURLLoader::ReportMetrics() {
+  TRACE_COUNTER("cloud_server", "network", reinterpret_cast<uintptr_t>(this),
+                "requests", request_count_, "lost_requests",
+                lost_request_count_, "uploaded_bytes", uploaded_bytes_,
+                "downloaded_bytes", downloaded_bytes_);
 }
 
 }  // namespace ledger
@@ -5,20 +5,29 @@
 #ifndef APPS_LEDGER_SRC_TEST_CLOUD_SERVER_FAKE_CLOUD_URL_LOADER_H_
 #define APPS_LEDGER_SRC_TEST_CLOUD_SERVER_FAKE_CLOUD_URL_LOADER_H_
 
+#include <random>
 #include <unordered_map>
 
 #include "apps/ledger/src/test/cloud_server/firebase_server.h"
 #include "apps/ledger/src/test/cloud_server/gcs_server.h"
+#include "apps/ledger/src/test/cloud_server/network_conditions.h"
 #include "apps/network/services/network_service.fidl.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ledger {
 
 // Implementation of |URLLoader| that simulate Firebase and GCS
 // servers.
+//
+// Requests and responses go through a simulated network with the given
+// |conditions|: each one is delayed by the latency, then by its transfer time
+// once the previous transfers in the same direction are done. Lost requests
+// fail with a network error without reaching the servers.
 class FakeCloudURLLoader : public network::URLLoader {
  public:
-  FakeCloudURLLoader();
+  explicit FakeCloudURLLoader(NetworkConditions conditions = {});
   ~FakeCloudURLLoader() override;
 
   // URLLoader
@@ -28,9 +37,35 @@ class FakeCloudURLLoader : public network::URLLoader {
   void QueryStatus(const QueryStatusCallback& callback) override;
 
  private:
+  // Routes |request| to the corresponding server.
+  void Serve(network::URLRequestPtr request,
+             std::function<void(network::URLResponsePtr)> callback);
+  // Serves |request| after its transfer through the simulated network, and
+  // delays the response by its own transfer.
+  void ServeDelayed(network::URLRequestPtr request,
+                    std::function<void(network::URLResponsePtr)> callback,
+                    bool is_stream);
+  // Returns the delay after which a transfer of |size| bytes starting now
+  // completes on the link that is free again at |*link_free_time|, and updates
+  // it.
+  ftl::TimeDelta Transfer(uint64_t size, ftl::TimePoint* link_free_time);
+  void ReportMetrics();
+
+  const NetworkConditions conditions_;
+  std::default_random_engine rng_;
   std::unordered_map<std::string, FirebaseServer> firebase_servers_;
   std::unordered_map<std::string, GcsServer> gcs_servers_;
 
+  ftl::TimePoint upload_free_time_;
+  ftl::TimePoint download_free_time_;
+  uint64_t request_count_ = 0u;
+  uint64_t lost_request_count_ = 0u;
+  uint64_t uploaded_bytes_ = 0u;
+  uint64_t downloaded_bytes_ = 0u;
+
+  // This must be the last member of this class.
+  ftl::WeakPtrFactory<FakeCloudURLLoader> weak_factory_;
+
   FTL_DISALLOW_COPY_AND_ASSIGN(FakeCloudURLLoader);
 };
 
@@ -4,11 +4,15 @@
 
 #include "apps/ledger/src/test/cloud_server/firebase_server.h"
 
+#include <string.h>
+
 #include <algorithm>
 #include <deque>
+#include <limits>
 #include <map>
 #include <sstream>
 #include <unordered_map>
+#include <vector>
 
 #include <magenta/syscalls.h>
 #include <rapidjson/document.h>
@@ -33,15 +37,18 @@ namespace {
 constexpr ftl::StringView kAuth = "auth";
 constexpr ftl::StringView kOrderBy = "orderBy";
 constexpr ftl::StringView kStartAt = "startAt";
+constexpr ftl::StringView kLimitToFirst = "limitToFirst";
 
-constexpr ftl::StringView kExpectedQueryParameters[] = {kAuth, kOrderBy,
-                                                        kStartAt};
+constexpr ftl::StringView kExpectedQueryParameters[] = {
+    kAuth, kOrderBy, kStartAt, kLimitToFirst};
 
 // Filter for a Firebase query. |key| is the name of the field to consider, and
-// |start_at| is the minimal value of it.
+// |start_at| is the minimal value of it. If |limit_to_first| is not 0, only
+// that many values, with the lowest values of the field, are kept.
 struct Filter {
   std::string key;
-  int64_t start_at;
+  int64_t start_at = std::numeric_limits<int64_t>::min();
+  size_t limit_to_first = 0u;
 };
 
 // Container for a socket connected to a watcher. This class handles sending a
@@ -148,9 +155,7 @@ std::string Serialize(rapidjson::Value* value, Filter* filter) {
     return buffer.GetString();
   }
 
-  rapidjson::StringBuffer string_buffer;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(string_buffer);
-  writer.StartObject();
+  std::vector<rapidjson::Value::MemberIterator> members;
   for (auto it = value->MemberBegin(); it != value->MemberEnd(); ++it) {
     if (!it->value.IsObject() || !it->value.HasMember(filter->key) ||
         !it->value[filter->key].IsInt64()) {
@@ -159,10 +164,34 @@ std::string Serialize(rapidjson::Value* value, Filter* filter) {
           << filter->key << " in " << Serialize(&it->value, nullptr);
     }
     if (it->value[filter->key].GetInt64() >= filter->start_at) {
-      writer.Key(it->name.GetString());
-      it->value.Accept(writer);
+      members.push_back(it);
     }
   }
+
+  if (filter->limit_to_first && members.size() > filter->limit_to_first) {
+    // Keep the first values when ordered by the field, then by name.
+    const std::string& key = filter->key;
+    std::sort(members.begin(), members.end(),
+              [&key](const rapidjson::Value::MemberIterator& lhs,
+                     const rapidjson::Value::MemberIterator& rhs) {
+                int64_t lhs_value = lhs->value[key].GetInt64();
+                int64_t rhs_value = rhs->value[key].GetInt64();
+                if (lhs_value != rhs_value) {
+                  return lhs_value < rhs_value;
+                }
+                return strcmp(lhs->name.GetString(), rhs->name.GetString()) <
+                       0;
+              });
+    members.resize(filter->limit_to_first);
+  }
+
+  rapidjson::StringBuffer string_buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(string_buffer);
+  writer.StartObject();
+  for (const auto& it : members) {
+    writer.Key(it->name.GetString());
+    it->value.Accept(writer);
+  }
   writer.EndObject();
   return string_buffer.GetString();
 }
@@ -213,9 +242,11 @@ std::unique_ptr<Filter> ExtractFilter(const url::GURL& url) {
     queries[UrlDecode(split[0])] = UrlDecode(split[1]);
   }
 
+  bool has_start_at = queries.count(kStartAt.ToString());
+  bool has_limit = queries.count(kLimitToFirst.ToString());
   FTL_DCHECK(queries.count(kOrderBy.ToString()) ==
-             queries.count(kStartAt.ToString()))
-      << "Both orderBy and startAt must be present.";
+             (has_start_at || has_limit ? 1u : 0u))
+      << "orderBy must be present along with startAt or limitToFirst.";
   if (!queries.count(kOrderBy.ToString())) {
     return nullptr;
   }
@@ -226,12 +257,20 @@ std::unique_ptr<Filter> ExtractFilter(const url::GURL& url) {
   FTL_DCHECK(std::find(order_by.begin(), order_by.end(), '/') == order_by.end())
       << "Not handling complex path in orderBy";
   order_by = order_by.substr(1, order_by.size() - 2);
-  std::string& start_at = queries[kStartAt.ToString()];
 
   auto result = std::make_unique<Filter>();
   result->key = order_by;
-  if (!ftl::StringToNumberWithError(start_at, &result->start_at)) {
-    FTL_NOTREACHED() << "Invalid filter, " << start_at << " is not an int.";
+  if (has_start_at) {
+    std::string& start_at = queries[kStartAt.ToString()];
+    if (!ftl::StringToNumberWithError(start_at, &result->start_at)) {
+      FTL_NOTREACHED() << "Invalid filter, " << start_at << " is not an int.";
+    }
+  }
+  if (has_limit) {
+    std::string& limit = queries[kLimitToFirst.ToString()];
+    if (!ftl::StringToNumberWithError(limit, &result->limit_to_first)) {
+      FTL_NOTREACHED() << "Invalid filter, " << limit << " is not an int.";
+    }
   }
   return result;
 }
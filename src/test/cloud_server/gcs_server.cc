@@ -4,8 +4,10 @@
 
 #include "apps/ledger/src/test/cloud_server/gcs_server.h"
 
+#include "apps/ledger/src/glue/compression/gzip.h"
 #include "apps/ledger/src/glue/socket/socket_pair.h"
 #include "apps/ledger/src/glue/socket/socket_writer.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/logging.h"
 #include "lib/ftl/strings/string_number_conversions.h"
 #include "lib/mtl/vmo/strings.h"
@@ -13,6 +15,21 @@
 
 namespace ledger {
 
+namespace {
+
+bool HasHeader(const network::URLRequestPtr& request,
+               const std::string& name,
+               const std::string& value) {
+  for (const auto& header : request->headers) {
+    if (header->name == name && header->value == value) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
 GcsServer::GcsServer() {}
 
 GcsServer::~GcsServer() {}
@@ -23,13 +40,41 @@ void GcsServer::HandleGet(
   url::GURL url(request->url);
 
   auto path = url.path();
-  if (!data_.count(path)) {
+  auto it = data_.find(path);
+  if (it == data_.end()) {
+    CountRequest(0u);
     callback(BuildResponse(request->url, Server::ResponseCode::kNotFound,
                            "No such document."));
     return;
   }
 
-  callback(BuildResponse(request->url, Server::ResponseCode::kOk, data_[path]));
+  const Object& object = it->second;
+  CountRequest(object.content.size());
+  if (!object.gzip_encoded) {
+    callback(BuildResponse(request->url, Server::ResponseCode::kOk,
+                           object.content));
+    return;
+  }
+
+  if (!HasHeader(request, "accept-encoding", "gzip")) {
+    // Serve the decompressed object, as the real server does.
+    std::string content;
+    bool decompressed = glue::GzipDecompress(object.content, &content);
+    FTL_DCHECK(decompressed);
+    callback(
+        BuildResponse(request->url, Server::ResponseCode::kOk, content));
+    return;
+  }
+
+  std::unordered_map<std::string, std::string> headers;
+  headers["content-length"] = ftl::NumberToString(object.content.size());
+  headers["content-encoding"] = "gzip";
+  glue::SocketPair sockets;
+  // StringSocketWriter deletes itself when done.
+  auto writer = new glue::StringSocketWriter();
+  writer->Start(object.content, std::move(sockets.socket2));
+  callback(BuildResponse(request->url, Server::ResponseCode::kOk,
+                         std::move(sockets.socket1), headers));
 }
 
 void GcsServer::HandlePost(
@@ -45,8 +90,18 @@ void GcsServer::HandlePost(
   if (!mtl::StringFromVmo(request->body->get_buffer(), &content)) {
     FTL_NOTREACHED() << "Unable to read vmo.";
   }
-  data_[std::move(path)] = std::move(content);
+  CountRequest(content.size());
+  Object& object = data_[std::move(path)];
+  object.content = std::move(content);
+  object.gzip_encoded = HasHeader(request, "content-encoding", "gzip");
   callback(BuildResponse(request->url, Server::ResponseCode::kOk, "Ok"));
 }
 
+void GcsServer::CountRequest(size_t bytes) {
+  ++request_count_;
+  transferred_bytes_ += bytes;
+  TRACE_COUNTER("ledger", "gcs_server", reinterpret_cast<uintptr_t>(this),
+                "requests", request_count_, "bytes", transferred_bytes_);
+}
+
 }  // namespace ledger
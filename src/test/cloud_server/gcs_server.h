@@ -16,6 +16,12 @@ namespace ledger {
 // Implementation of a google cloud storage server. This implementation is
 // partial and only handles the part of the API that the Ledger application
 // exercises.
+//
+// Objects uploaded with the gzip content encoding are served compressed to the
+// clients accepting that encoding, and decompressed to the other ones.
+//
+// The number of requests served and the number of bytes transferred are
+// reported as trace counters, so that the cost of syncing can be measured.
 class GcsServer : public Server {
  public:
   GcsServer();
@@ -29,7 +35,17 @@ class GcsServer : public Server {
       network::URLRequestPtr request,
       std::function<void(network::URLResponsePtr)> callback) override;
 
-  std::unordered_map<std::string, std::string> data_;
+  // Records a request transferring |bytes| bytes.
+  void CountRequest(size_t bytes);
+
+  struct Object {
+    std::string content;
+    bool gzip_encoded = false;
+  };
+
+  std::unordered_map<std::string, Object> data_;
+  uint64_t request_count_ = 0u;
+  uint64_t transferred_bytes_ = 0u;
 };
 
 }  // namespace ledger
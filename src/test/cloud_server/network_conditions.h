@@ -0,0 +1,36 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TEST_CLOUD_SERVER_NETWORK_CONDITIONS_H_
+#define APPS_LEDGER_SRC_TEST_CLOUD_SERVER_NETWORK_CONDITIONS_H_
+
+#include <stdint.h>
+
+#include "lib/ftl/time/time_delta.h"
+
+namespace ledger {
+
+// Conditions of the simulated network between the clients and the fake cloud.
+// The default value is a perfect network.
+struct NetworkConditions {
+  // Delay added to each request and to each response.
+  ftl::TimeDelta latency;
+  // Bytes per second transferred in each direction, or 0 for no limit.
+  uint64_t bandwidth = 0u;
+  // Fraction of the requests, between 0 and 1, that fail with a network
+  // error. Streaming requests are never lost.
+  double loss_rate = 0.0;
+  // Seed of the random generator deciding which requests are lost, so that
+  // runs are reproducible.
+  uint64_t seed = 0u;
+
+  bool IsPerfect() const {
+    return latency <= ftl::TimeDelta::Zero() && bandwidth == 0u &&
+           loss_rate <= 0.0;
+  }
+};
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_TEST_CLOUD_SERVER_NETWORK_CONDITIONS_H_
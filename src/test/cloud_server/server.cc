@@ -25,7 +25,8 @@ void Server::Serve(
         HandleGetStream(std::move(request), callback);
         return;
       }
-      if (header->name == "authorization") {
+      if (header->name == "authorization" ||
+          header->name == "accept-encoding") {
         continue;
       }
       FTL_LOG(WARNING) << "Unknown header: " << header->name << " -> "
@@ -36,4 +36,21 @@ fidl::Array<uint8_t> DataGenerator::MakeValue(size_t size) {
   return data;
 }
 
+fidl::Array<uint8_t> DataGenerator::MakeCompressibleValue(size_t size) {
+  static const char* const kWords[] = {
+      "ledger", "page",   "commit", "object", "entry", "value",
+      "key",    "sync",   "cloud",  "device", "user",  "storage",
+      "merge",  "change", "watch",  "token"};
+  constexpr size_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+  std::string data;
+  data.reserve(size + 10);
+  while (data.size() < size) {
+    data.append(kWords[generator_() % kWordCount]);
+    data.push_back(' ');
+  }
+  data.resize(size);
+  return convert::ToArray(data);
+}
+
 }  // namespace test
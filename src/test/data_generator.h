@@ -28,6 +28,10 @@ class DataGenerator {
   // Builds a random value of the given length.
   fidl::Array<uint8_t> MakeValue(size_t size);
 
+  // Builds a value of the given length made of random words of a small
+  // vocabulary, which compresses about as well as text does.
+  fidl::Array<uint8_t> MakeCompressibleValue(size_t size);
+
  private:
   std::independent_bits_engine<std::default_random_engine, CHAR_BIT, uint8_t>
       generator_;
@@ -31,7 +31,8 @@ ledger::Status GetLedger(
     SyncState sync,
     std::string server_id,
     ledger::LedgerPtr* ledger_ptr,
-    Erase erase) {
+    Erase erase,
+    const std::vector<std::string>& ledger_arguments) {
   ledger::LedgerRepositoryFactoryPtr repository_factory;
   app::ServiceProviderPtr child_services;
   auto launch_info = app::ApplicationLaunchInfo::New();
@@ -40,6 +41,9 @@ ledger::Status GetLedger(
   launch_info->arguments.push_back("--no_minfs_wait");
   launch_info->arguments.push_back("--no_persisted_config");
   launch_info->arguments.push_back("--no_statistics_reporting_for_testing");
+  for (const auto& argument : ledger_arguments) {
+    launch_info->arguments.push_back(argument);
+  }
 
   context->launcher()->CreateApplication(std::move(launch_info),
                                          controller->NewRequest());
@@ -7,6 +7,7 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "application/lib/app/application_context.h"
 #include "apps/ledger/services/public/ledger.fidl.h"
@@ -24,6 +25,8 @@ enum Erase { KEEP_DATA = 0, ERASE_CLOUD };
 // Creates a new Ledger application instance and returns a LedgerPtr connection
 // to it. If |erase_first| is true, an EraseRepository command is issued first
 // before connecting, ensuring a clean state before proceeding.
+// |ledger_arguments| are passed to the Ledger application in addition to the
+// testing ones.
 ledger::Status GetLedger(
     mtl::MessageLoop* loop,
     app::ApplicationContext* context,
@@ -35,7 +38,8 @@ ledger::Status GetLedger(
     SyncState sync,
     std::string server_id,
     ledger::LedgerPtr* ledger_ptr,
-    Erase erase = KEEP_DATA);
+    Erase erase = KEEP_DATA,
+    const std::vector<std::string>& ledger_arguments = {});
 
 // Retrieves the requested page of the given Ledger instance and calls the
 // callback only after executing a GetId() call on the page, ensuring that it is
@@ -7,6 +7,7 @@
 
 #include "apps/ledger/services/internal/internal.fidl.h"
 #include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/app/fidl/serialization_size.h"
 #include "apps/ledger/src/callback/capture.h"
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/ledger/src/test/integration/integration_test.h"
@@ -15,6 +16,7 @@
 #include "lib/fidl/cpp/bindings/binding.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_printf.h"
 
 namespace test {
 namespace integration {
@@ -146,6 +148,140 @@ TEST_F(PageIntegrationTest, MultipleLedgerConnections) {
   EXPECT_EQ(ledger::Status::OK, status);
 }
 
+TEST_F(PageIntegrationTest, GetChangesSince) {
+  auto instance = NewLedgerAppInstance();
+  ledger::PagePtr page = instance->GetTestPage();
+
+  auto callback_statusok = [](ledger::Status status) {
+    EXPECT_EQ(ledger::Status::OK, status);
+  };
+  page->Put(convert::ToArray("key-0"), convert::ToArray("value-0"),
+            callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+
+  // A null token returns the whole content of the page.
+  ledger::Status status;
+  ledger::PageChangePtr change;
+  fidl::Array<uint8_t> next_page_token;
+  fidl::Array<uint8_t> token;
+  page->GetChangesSince(
+      nullptr, nullptr,
+      callback::Capture([] {}, &status, &change, &next_page_token, &token));
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  EXPECT_EQ(ledger::Status::OK, status);
+  ASSERT_TRUE(change);
+  ASSERT_EQ(1u, change->changes.size());
+  EXPECT_EQ("key-0", convert::ToString(change->changes[0]->key));
+  EXPECT_TRUE(next_page_token.is_null());
+  ASSERT_FALSE(token.is_null());
+
+  page->Put(convert::ToArray("key-1"), convert::ToArray("value-1"),
+            callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  page->Delete(convert::ToArray("key-0"), callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+
+  // Only the changes following |token| are returned.
+  fidl::Array<uint8_t> new_token;
+  page->GetChangesSince(
+      token.Clone(), nullptr,
+      callback::Capture([] {}, &status, &change, &next_page_token, &new_token));
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  EXPECT_EQ(ledger::Status::OK, status);
+  ASSERT_TRUE(change);
+  ASSERT_EQ(1u, change->changes.size());
+  EXPECT_EQ("key-1", convert::ToString(change->changes[0]->key));
+  ASSERT_EQ(1u, change->deleted_keys.size());
+  EXPECT_EQ("key-0", convert::ToString(change->deleted_keys[0]));
+  EXPECT_FALSE(token.Equals(new_token));
+
+  // Nothing changed since |new_token|.
+  page->GetChangesSince(
+      new_token.Clone(), nullptr,
+      callback::Capture([] {}, &status, &change, &next_page_token, &token));
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  EXPECT_EQ(ledger::Status::OK, status);
+  EXPECT_FALSE(change);
+  EXPECT_TRUE(new_token.Equals(token));
+}
+
+TEST_F(PageIntegrationTest, GetChangesSincePagination) {
+  auto instance = NewLedgerAppInstance();
+  ledger::PagePtr page = instance->GetTestPage();
+
+  // Keys are large enough for the changes not to fit in a single message.
+  const size_t key_count = 2;
+  const auto key_generator = [key_count](size_t i) {
+    std::string filler(
+        ledger::fidl_serialization::kMaxInlineDataSize * 3 / 2 / key_count,
+        'k');
+    return ftl::StringPrintf("key%02" PRIuMAX "%s", i, filler.c_str());
+  };
+  auto callback_statusok = [](ledger::Status status) {
+    EXPECT_EQ(ledger::Status::OK, status);
+  };
+  page->StartTransaction(callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  for (size_t i = 0; i < key_count; ++i) {
+    page->Put(convert::ToArray(key_generator(i)), convert::ToArray("value"),
+              callback_statusok);
+    EXPECT_TRUE(page.WaitForIncomingResponse());
+  }
+  page->Commit(callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+
+  ledger::Status status;
+  ledger::PageChangePtr change;
+  fidl::Array<uint8_t> page_token;
+  fidl::Array<uint8_t> token;
+  size_t received_count = 0u;
+  size_t call_count = 0u;
+  fidl::Array<uint8_t> first_token;
+  do {
+    page->GetChangesSince(
+        nullptr, std::move(page_token),
+        callback::Capture([] {}, &status, &change, &page_token, &token));
+    EXPECT_TRUE(page.WaitForIncomingResponse());
+    ASSERT_TRUE(status == ledger::Status::OK ||
+                status == ledger::Status::PARTIAL_RESULT);
+    ASSERT_TRUE(change);
+    received_count += change->changes.size();
+    if (call_count == 0) {
+      first_token = token.Clone();
+    } else {
+      // All pages go up to the same state.
+      EXPECT_TRUE(first_token.Equals(token));
+    }
+    ++call_count;
+  } while (status == ledger::Status::PARTIAL_RESULT);
+
+  EXPECT_TRUE(page_token.is_null());
+  EXPECT_EQ(key_count, received_count);
+  EXPECT_LT(1u, call_count);
+}
+
+TEST_F(PageIntegrationTest, GetChangesSinceInvalidToken) {
+  auto instance = NewLedgerAppInstance();
+  ledger::PagePtr page = instance->GetTestPage();
+
+  ledger::Status status;
+  ledger::PageChangePtr change;
+  fidl::Array<uint8_t> next_page_token;
+  fidl::Array<uint8_t> token;
+  page->GetChangesSince(
+      convert::ToArray("invalid"), nullptr,
+      callback::Capture([] {}, &status, &change, &next_page_token, &token));
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  EXPECT_EQ(ledger::Status::INVALID_TOKEN, status);
+
+  // A well-formed token for an unknown state.
+  page->GetChangesSince(
+      RandomArray(32), nullptr,
+      callback::Capture([] {}, &status, &change, &next_page_token, &token));
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  EXPECT_EQ(ledger::Status::INVALID_TOKEN, status);
+}
+
 }  // namespace
 }  // namespace integration
 }  // namespace test
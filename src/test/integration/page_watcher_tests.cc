@@ -7,6 +7,7 @@
 
 #include "apps/ledger/services/public/ledger.fidl.h"
 #include "apps/ledger/src/app/fidl/serialization_size.h"
+#include "apps/ledger/src/callback/capture.h"
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/ledger/src/test/integration/integration_test.h"
 #include "apps/ledger/src/test/integration/test_utils.h"
@@ -634,6 +635,159 @@ TEST_F(PageWatcherIntegrationTest, PageWatcherPrefixNoChange) {
   EXPECT_EQ(0u, watcher.changes_seen);
 }
 
+TEST_F(PageWatcherIntegrationTest, PageWatcherMinDeliveryInterval) {
+  auto instance = NewLedgerAppInstance();
+  ledger::PagePtr page = instance->GetTestPage();
+  ledger::PageWatcherPtr watcher_ptr;
+  Watcher watcher(watcher_ptr.NewRequest(),
+                  [] { mtl::MessageLoop::GetCurrent()->PostQuitTask(); });
+
+  auto callback_statusok = [](ledger::Status status) {
+    EXPECT_EQ(ledger::Status::OK, status);
+  };
+  ledger::WatcherOptionsPtr options = ledger::WatcherOptions::New();
+  options->min_delivery_interval_ms = 500;
+  ledger::PageSnapshotPtr snapshot;
+  page->GetSnapshotWithWatcherOptions(snapshot.NewRequest(), nullptr,
+                                      std::move(watcher_ptr),
+                                      std::move(options), callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+
+  // The first change is sent right away.
+  page->Put(convert::ToArray("key-0"), convert::ToArray("value-0"),
+            callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1u, watcher.changes_seen);
+
+  // The following ones are delayed, and sent together.
+  page->Put(convert::ToArray("key-1"), convert::ToArray("value-1"),
+            callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  page->Put(convert::ToArray("key-2"), convert::ToArray("value-2"),
+            callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(2u, watcher.changes_seen);
+  EXPECT_EQ(ledger::ResultState::COMPLETED, watcher.last_result_state_);
+  ledger::PageChangePtr change = std::move(watcher.last_page_change_);
+  ASSERT_EQ(2u, change->changes.size());
+  EXPECT_EQ("key-1", convert::ToString(change->changes[0]->key));
+  EXPECT_EQ("key-2", convert::ToString(change->changes[1]->key));
+}
+
+TEST_F(PageWatcherIntegrationTest, PageWatcherMaxBatchSize) {
+  auto instance = NewLedgerAppInstance();
+  ledger::PagePtr page = instance->GetTestPage();
+  ledger::PageWatcherPtr watcher_ptr;
+  Watcher watcher(watcher_ptr.NewRequest(),
+                  [] { mtl::MessageLoop::GetCurrent()->PostQuitTask(); });
+
+  auto callback_statusok = [](ledger::Status status) {
+    EXPECT_EQ(ledger::Status::OK, status);
+  };
+  // The interval is longer than the test timeout: changes other than the first
+  // one are only sent because of |max_batch_size|.
+  ledger::WatcherOptionsPtr options = ledger::WatcherOptions::New();
+  options->min_delivery_interval_ms = 3600 * 1000;
+  options->max_batch_size = 3;
+  ledger::PageSnapshotPtr snapshot;
+  page->GetSnapshotWithWatcherOptions(snapshot.NewRequest(), nullptr,
+                                      std::move(watcher_ptr),
+                                      std::move(options), callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+
+  page->Put(convert::ToArray("key-0"), convert::ToArray("value-0"),
+            callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1u, watcher.changes_seen);
+
+  for (int i = 1; i <= 3; ++i) {
+    page->Put(convert::ToArray(ftl::StringPrintf("key-%d", i)),
+              convert::ToArray(ftl::StringPrintf("value-%d", i)),
+              callback_statusok);
+    EXPECT_TRUE(page.WaitForIncomingResponse());
+  }
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(2u, watcher.changes_seen);
+  ledger::PageChangePtr change = std::move(watcher.last_page_change_);
+  ASSERT_EQ(3u, change->changes.size());
+  EXPECT_EQ("key-1", convert::ToString(change->changes[0]->key));
+  EXPECT_EQ("key-3", convert::ToString(change->changes[2]->key));
+
+  // Starting a transaction flushes the delayed changes.
+  page->Put(convert::ToArray("key-4"), convert::ToArray("value-4"),
+            callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  bool transaction_started = false;
+  page->StartTransaction([&transaction_started](ledger::Status status) {
+    EXPECT_EQ(ledger::Status::OK, status);
+    transaction_started = true;
+  });
+  EXPECT_TRUE(RunLoopUntil([&transaction_started] {
+    return transaction_started;
+  }));
+  EXPECT_EQ(3u, watcher.changes_seen);
+}
+
+TEST_F(PageWatcherIntegrationTest, PageWatcherResumeToken) {
+  auto instance = NewLedgerAppInstance();
+  ledger::PagePtr page = instance->GetTestPage();
+
+  auto callback_statusok = [](ledger::Status status) {
+    EXPECT_EQ(ledger::Status::OK, status);
+  };
+  page->Put(convert::ToArray("key-0"), convert::ToArray("value-0"),
+            callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+
+  ledger::Status status;
+  ledger::PageChangePtr change;
+  fidl::Array<uint8_t> next_page_token;
+  fidl::Array<uint8_t> token;
+  page->GetChangesSince(
+      nullptr, nullptr,
+      callback::Capture([] {}, &status, &change, &next_page_token, &token));
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  EXPECT_EQ(ledger::Status::OK, status);
+
+  // Changes made while the client was not watching.
+  page->Put(convert::ToArray("key-1"), convert::ToArray("value-1"),
+            callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+
+  ledger::PageWatcherPtr watcher_ptr;
+  Watcher watcher(watcher_ptr.NewRequest(),
+                  [] { mtl::MessageLoop::GetCurrent()->PostQuitTask(); });
+  ledger::WatcherOptionsPtr options = ledger::WatcherOptions::New();
+  options->resume_token = std::move(token);
+  ledger::PageSnapshotPtr snapshot;
+  page->GetSnapshotWithWatcherOptions(snapshot.NewRequest(), nullptr,
+                                      std::move(watcher_ptr),
+                                      std::move(options), callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  // The watcher first receives the changes made since the token.
+  EXPECT_EQ(1u, watcher.changes_seen);
+  change = std::move(watcher.last_page_change_);
+  ASSERT_EQ(1u, change->changes.size());
+  EXPECT_EQ("key-1", convert::ToString(change->changes[0]->key));
+
+  page->Put(convert::ToArray("key-2"), convert::ToArray("value-2"),
+            callback_statusok);
+  EXPECT_TRUE(page.WaitForIncomingResponse());
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(2u, watcher.changes_seen);
+  change = std::move(watcher.last_page_change_);
+  ASSERT_EQ(1u, change->changes.size());
+  EXPECT_EQ("key-2", convert::ToString(change->changes[0]->key));
+}
+
 }  // namespace
 }  // namespace integration
 }  // namespace test
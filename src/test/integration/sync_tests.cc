@@ -115,6 +115,95 @@ TEST_F(SyncIntegrationTest, ConcurrentConnection) {
   ASSERT_EQ("World", convert::ToString(value));
 }
 
+// Verifies that lazy values fetched concurrently, some of them sharing the
+// same object, are all downloaded.
+TEST_F(SyncIntegrationTest, ConcurrentLazyFetch) {
+  auto instance1 = NewLedgerAppInstance();
+  auto page1 = instance1->GetTestPage();
+  fidl::Array<uint8_t> page_id;
+  page1->GetId(callback::Capture(MakeQuitTask(), &page_id));
+  ASSERT_FALSE(RunLoopWithTimeout());
+
+  constexpr size_t kEntryCount = 20;
+  const std::string shared_value(1000, 'a');
+  ledger::Status status;
+  for (size_t i = 0; i < kEntryCount; ++i) {
+    // Every other entry shares the same value.
+    std::string value =
+        i % 2 ? shared_value : std::string(1000, 'b') + std::to_string(i);
+    page1->PutWithPriority(convert::ToArray("key" + std::to_string(i)),
+                           convert::ToArray(value), ledger::Priority::LAZY,
+                           callback::Capture(MakeQuitTask(), &status));
+    ASSERT_FALSE(RunLoopWithTimeout());
+    ASSERT_EQ(ledger::Status::OK, status);
+  }
+
+  auto instance2 = NewLedgerAppInstance();
+  auto page2 = instance2->GetPage(page_id, ledger::Status::OK);
+  EXPECT_TRUE(RunLoopUntil([this, &page2] {
+    fidl::Array<ledger::EntryPtr> entries;
+    if (!GetEntries(page2.get(), &entries)) {
+      return true;
+    }
+    return entries.size() == kEntryCount;
+  }));
+
+  ledger::PageSnapshotPtr snapshot;
+  page2->GetSnapshot(snapshot.NewRequest(), nullptr, nullptr,
+                     callback::Capture(MakeQuitTask(), &status));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(ledger::Status::OK, status);
+
+  size_t fetched = 0;
+  for (size_t i = 0; i < kEntryCount; ++i) {
+    std::string expected =
+        i % 2 ? shared_value : std::string(1000, 'b') + std::to_string(i);
+    snapshot->Fetch(convert::ToArray("key" + std::to_string(i)), [
+      &fetched, expected
+    ](ledger::Status status, mx::vmo value) {
+      EXPECT_EQ(ledger::Status::OK, status);
+      std::string content;
+      EXPECT_TRUE(mtl::StringFromVmo(value, &content));
+      EXPECT_EQ(expected, content);
+      ++fetched;
+    });
+  }
+  EXPECT_TRUE(RunLoopUntil([&fetched] { return fetched == kEntryCount; }));
+}
+
+// Verifies that a burst of commits, uploaded while earlier ones are still
+// being acknowledged, is fully synced.
+TEST_F(SyncIntegrationTest, CommitBurst) {
+  auto instance1 = NewLedgerAppInstance();
+  auto page1 = instance1->GetTestPage();
+  fidl::Array<uint8_t> page_id;
+  page1->GetId(callback::Capture(MakeQuitTask(), &page_id));
+  ASSERT_FALSE(RunLoopWithTimeout());
+
+  auto instance2 = NewLedgerAppInstance();
+  auto page2 = instance2->GetPage(page_id, ledger::Status::OK);
+
+  constexpr size_t kCommitCount = 50;
+  size_t committed = 0;
+  for (size_t i = 0; i < kCommitCount; ++i) {
+    page1->Put(convert::ToArray("key" + std::to_string(i)),
+               convert::ToArray("value" + std::to_string(i)),
+               [&committed](ledger::Status status) {
+                 EXPECT_EQ(ledger::Status::OK, status);
+                 ++committed;
+               });
+  }
+  EXPECT_TRUE(RunLoopUntil([&committed] { return committed == kCommitCount; }));
+
+  EXPECT_TRUE(RunLoopUntil([this, &page2] {
+    fidl::Array<ledger::EntryPtr> entries;
+    if (!GetEntries(page2.get(), &entries)) {
+      return true;
+    }
+    return entries.size() == kCommitCount;
+  }));
+}
+
 }  // namespace
 }  // namespace integration
 }  // namespace test
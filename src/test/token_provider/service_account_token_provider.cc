@@ -230,7 +230,8 @@ void ServiceAccountTokenProvider::GetFirebaseAuthToken(
       [ this, firebase_api_key =
                   firebase_api_key.get() ](network::URLResponsePtr response) {
         HandleIdentityResponse(firebase_api_key, std::move(response));
-      }));
+      },
+      ledger::RequestPriority::INTERACTIVE));
 }
 
 void ServiceAccountTokenProvider::GetClientId(